@@ -52,6 +52,10 @@ static int doMult (void);
 static int doDiv (void);
 static int doFlat (void);
 static int doTherm (void);
+static int doStackMean (void);
+static int doStackMedian (void);
+static int doStackClip (void);
+static int stackListed (StackHow how);
 static void ac_add (FImage *fip, double c);
 static void ac_mult (FImage *fip, double c);
 static void ai_add (FImage *fip1, FImage *fip2);
@@ -81,6 +85,9 @@ static RadBox radbox[] = {
     {"Divide",		 doDiv},
     {"Divide by flat",	 doFlat,  flatCB},
     {"Subtract thermal", doTherm, thermCB},
+    {"Stack listed, mean",   doStackMean},
+    {"Stack listed, median", doStackMedian},
+    {"Stack listed, clip",   doStackClip},
 };
 
 static char hist_fld[] = "HISTORY";	/* handy FITS field name */
@@ -756,3 +763,79 @@ ai_therm (FImage *fip1, FImage *fip2, double factor)
 	    *ip1++ = (CamPixel) floor(p + 0.5);
 	}
 }
+
+static int
+doStackMean ()
+{
+	return (stackListed (STK_MEAN));
+}
+
+static int
+doStackMedian ()
+{
+	return (stackListed (STK_MEDIAN));
+}
+
+static int
+doStackClip ()
+{
+	return (stackListed (STK_CLIP));
+}
+
+/* replace the current image with the stack of its file and all those listed
+ * in the FSB, aligned to it and combined as told by how.
+ * return 0 if ok, else write msg() and return -1.
+ */
+static int
+stackListed (StackHow how)
+{
+	XmStringTable items;
+	char errmsg[1024];
+	StackOpts so;
+	FImage fim;
+	char **fns;
+	int nitems, n, nused, i;
+
+	if (!state.fimage.image || !state.fname[0]) {
+	    msg ("No image file");
+	    return (-1);
+	}
+
+	XtVaGetValues (fsb_w, XmNfileListItems, &items,
+			    XmNfileListItemCount, &nitems, NULL);
+	fns = (char **) XtMalloc ((nitems+1)*sizeof(char *));
+	fns[0] = state.fname;
+	for (n = 1, i = 0; i < nitems; i++) {
+	    char *fn;
+
+	    XmStringGetLtoR (items[i], XmSTRING_DEFAULT_CHARSET, &fn);
+	    if (strcmp (fn, state.fname))
+		fns[n++] = fn;
+	    else
+		XtFree (fn);
+	}
+	if (n < 2) {
+	    msg ("No other files listed to stack");
+	    XtFree ((char *)fns);
+	    return (-1);
+	}
+
+	memset ((void *)&so, 0, sizeof(so));
+	so.how = how;
+	nused = stackFITS (fns, n, &so, &fim, errmsg);
+	for (i = 1; i < n; i++)
+	    XtFree (fns[i]);
+	XtFree ((char *)fns);
+	if (nused < 0) {
+	    msg ("%s", errmsg);
+	    return (-1);
+	}
+
+	/* commit, then flip and correct as if just opened */
+	resetGSC();
+	resetFImage (&state.fimage);
+	memcpy ((char *)&state.fimage, (char *)&fim, sizeof(fim));
+	presentNewImage();
+
+	return (0);
+}
@@ -222,6 +222,7 @@ char *fn;
 
 	resetFImage (&state.fimage);
 	memcpy ((char *)&state.fimage, (char *)&fimage, sizeof(fimage));
+	(void) useStarList (fn, &state.fimage);	/* saves finding stars again */
 	setFName (fn);
 	addHistory (fn);
 	presentNewImage();
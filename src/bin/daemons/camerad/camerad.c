@@ -75,6 +75,7 @@ static void abandon (void);
 static void cam_fifo(char *msg);
 static int camOK (char *msg);
 static int getCoolerTemp (CCDTempInfo *tp);
+static void setCamState (CamState cs);
 static void doExpose (char *msg);
 static void cam_read(void);
 static void flipImg(void);
@@ -141,7 +142,7 @@ main (int ac, char *av[])
 	init_all();
 
 	/* init shm status */
-	telstatshmp->camstate = CAM_IDLE;
+	setCamState (CAM_IDLE);
 
 	/* go */
 	mainLoop();
@@ -392,7 +393,7 @@ static void
 abandon()
 {
 	abortExpCCD();
-	telstatshmp->camstate = CAM_IDLE;
+	setCamState (CAM_IDLE);
 	resetFImage (&fimage);
 }
 
@@ -437,12 +438,23 @@ getCoolerTemp (CCDTempInfo *tp)
 	    return (-1);
 	}
 
-	telstatshmp->camtemp = tp->t;
-	telstatshmp->coolerstatus = tp->s;
+	if (telstatshmp->camtemp != tp->t || telstatshmp->coolerstatus != tp->s) {
+	    telstatshmp->camtemp = tp->t;
+	    telstatshmp->coolerstatus = tp->s;
+	    telshm_changed (telstatshmp, TSG_BIT(TSG_CAM));
+	}
 
 	return (0);
 }
 
+/* set the camera state in shm and tell its readers */
+static void
+setCamState (CamState cs)
+{
+	telstatshmp->camstate = cs;
+	telshm_changed (telstatshmp, TSG_BIT(TSG_CAM));
+}
+
 /* return 0 if camera appears to be connected and cooling ok, else -1 */
 static int
 camOK(char msg[])
@@ -462,6 +474,7 @@ camOK(char msg[])
 	    if (setTempCCD (&tinfo, msg) < 0)
 		return (-1);
 	    telstatshmp->camtarg = DEFTEMP;
+	    telshm_changed (telstatshmp, TSG_BIT(TSG_CAM));
 	}
 
 	return (0);
@@ -579,16 +592,16 @@ doExpose (char *msg)
 
     // STO... set this stat BEFORE exposure so we don't get caught up
     // in pre-expose timing delays (i.e. FLI flush)
-	telstatshmp->camstate = CAM_EXPO;
+	setCamState (CAM_EXPO);
 
 	if (setExpCCD (&ep, buf) < 0 || startExpCCD (buf) < 0) {
-    	telstatshmp->camstate = CAM_IDLE;
+    	setCamState (CAM_IDLE);
 	    reply (-15, "Setup error: %s", buf);
 	    return;
 	}
 
 	/* yes! */
-	telstatshmp->camstate = CAM_EXPO;
+	setCamState (CAM_EXPO);
 	toTTS ("Beginning %g second exposure.", dur);
 	return;
 }
@@ -648,7 +661,7 @@ cam_read()
 	}
 
 	/* inform fifo listener the shutter is closed */
-	telstatshmp->camstate = CAM_READ;	/* set before reply */
+	setCamState (CAM_READ);	/* set before reply */
 	reply (1, "Exposure complete");
 	toTTS ("The exposure is finished. Now downloading pixels.");
 
@@ -685,7 +698,7 @@ cam_read()
 
 	/* ok! */
 	resetFImage (fip);
-	telstatshmp->camstate = CAM_IDLE;	/* set before sending message */
+	setCamState (CAM_IDLE);	/* set before sending message */
 	reply (0, "File %s created", basenm(fname));
 	toTTS ("Image is now complete.");
 }
@@ -0,0 +1,227 @@
+/* a simulated camera, run by camerad as an AUXCAM program, see ccdcamera.c.
+ *
+ * exposures take their duration, and readout a time in proportion to the
+ * pixels read, on the observatory clock, so with telescoped -v -s they go by
+ * as much faster as everything else. the pixels are a bias level plus noise,
+ * and sky too if the shutter was open. the cooler is always at its target.
+ *
+ * set up camera.cfg with DRIVER simcam and AUXCAM 1.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "P_.h"
+#include "astro.h"
+#include "circum.h"
+#include "telstatshm.h"
+#include "cliserv.h"
+#include "telenv.h"
+#include "simclock.h"
+
+#define	SC_W		2048	/* full frame width, pixels */
+#define	SC_H		2048	/* full frame height, pixels */
+#define	SC_MAXB		8	/* max binning each way */
+#define	SC_READ		4.0	/* full frame readout, secs */
+#define	SC_BIAS		1000	/* bias level, ADU */
+#define	SC_NOISE	10	/* read noise, ADU */
+#define	SC_SKY		20.0	/* sky, ADU per sec per unbinned pixel */
+#define	SC_TEMP		(-30)	/* cooler temp when on, C */
+
+static char tempfn[] = "comm/simcam.temp";	/* cooler target, if set */
+
+static void usage (char *p);
+static int crack (char *s, int *dur, int *x, int *y, int *w, int *h, int *bx,
+    int *by, int *shutter);
+static int expose (char *s);
+static void waitSecs (double secs);
+static int readTemp (void);
+static void writeTemp (char *s);
+static double gauss (void);
+
+static unsigned long long rseed = 88172645463325252ULL;
+
+int
+main (int ac, char *av[])
+{
+	char *progname = av[0];
+	int dur, x, y, w, h, bx, by, shutter;
+	TelStatShm *tsp;
+
+	if (ac < 2 || av[1][0] != '-' || av[1][2] != '\0')
+	    usage (progname);
+
+	/* keep to the observatory clock if it is up */
+	(void) open_telshm (&tsp);
+
+	switch (av[1][1]) {
+	case 'f':
+	    printf ("%d %d %d %d\n", SC_W, SC_H, SC_MAXB, SC_MAXB);
+	    break;
+	case 'g':
+	    if (ac != 3 || crack (av[2], NULL, &x, &y, &w, &h, &bx, &by,
+								&shutter) < 0)
+		usage (progname);
+	    if (x < 0 || y < 0 || w < 1 || h < 1 || x+w > SC_W || y+h > SC_H
+			    || bx < 1 || by < 1 || bx > SC_MAXB || by > SC_MAXB) {
+		printf ("Bad exposure parameters %s\n", av[2]);
+		return (1);
+	    }
+	    break;
+	case 'i':
+	    printf ("Simulated %dx%d camera\n", SC_W, SC_H);
+	    break;
+	case 'k':
+	case 's':
+	    break;		/* camerad kills -x itself; no shutter */
+	case 'T':
+	    x = readTemp();
+	    printf ("%d %s\n", x, x == SC_TEMP ? "AT" : "OFF");
+	    break;
+	case 't':
+	    if (ac != 3)
+		usage (progname);
+	    writeTemp (av[2]);
+	    break;
+	case 'x':
+	    if (ac < 3 || crack (av[2], &dur, &x, &y, &w, &h, &bx, &by,
+								&shutter) < 0)
+		usage (progname);
+	    return (expose (av[2]));
+	default:
+	    usage (progname);
+	}
+
+	return (0);
+}
+
+static void
+usage (char *p)
+{
+	fprintf (stderr, "Usage: %s {-f | -g x:y:w:h:bx:by:open | -i | -k | -s open | -T | -t temp |\n", p);
+	fprintf (stderr, "       -x dur:x:y:w:h:bx:by:open [t]}\n");
+	fprintf (stderr, "Purpose: simulated camera for camerad AUXCAM.\n");
+	exit (1);
+}
+
+/* crack [dur:]x:y:w:h:bx:by:shutter from s; dur only if dur != NULL.
+ * return 0 if ok, else -1.
+ */
+static int
+crack (char *s, int *dur, int *x, int *y, int *w, int *h, int *bx, int *by,
+int *shutter)
+{
+	if (dur)
+	    return (sscanf (s, "%d:%d:%d:%d:%d:%d:%d:%d", dur, x, y, w, h, bx,
+						    by, shutter) == 8 ? 0 : -1);
+	return (sscanf (s, "%d:%d:%d:%d:%d:%d:%d", x, y, w, h, bx, by,
+						shutter) == 7 ? 0 : -1);
+}
+
+/* take the exposure described by s, then send a heads up byte followed by
+ * the pixels, big-endian, on stdout.
+ * return 0 if ok, else -1.
+ */
+static int
+expose (char *s)
+{
+	int dur, x, y, w, h, bx, by, shutter;
+	int nw, nh, npix, i;
+	unsigned char *buf;
+	double sky;
+
+	(void) crack (s, &dur, &x, &y, &w, &h, &bx, &by, &shutter);
+	nw = w/bx;
+	nh = h/by;
+	npix = nw*nh;
+	buf = (unsigned char *) malloc (2*npix + 1);
+	if (!buf) {
+	    printf ("No memory for %d pixels\n", npix);
+	    return (-1);
+	}
+
+	/* expose, then read out */
+	waitSecs (dur/1000.0);
+	waitSecs (SC_READ*npix/((double)SC_W*SC_H));
+
+	sky = shutter ? SC_SKY*bx*by*dur/1000.0 : 0.0;
+	buf[0] = 0;		/* heads up */
+	for (i = 0; i < npix; i++) {
+	    double v = SC_BIAS + sky + SC_NOISE*gauss() + sqrt(sky)*gauss();
+	    int p = v < 0 ? 0 : v > 65535 ? 65535 : (int)(v + 0.5);
+
+	    buf[1 + 2*i] = p >> 8;
+	    buf[2 + 2*i] = p & 0xff;
+	}
+
+	i = fwrite (buf, 1, 2*npix + 1, stdout) == 2*npix + 1 ? 0 : -1;
+	fflush (stdout);
+	free ((void *)buf);
+	return (i);
+}
+
+/* wait for secs to go by on the observatory clock */
+static void
+waitSecs (double secs)
+{
+	double r = real_secs (secs);
+
+	if (r > 0)
+	    usleep ((useconds_t)(r*1e6));
+}
+
+/* return the cooler temp: SC_TEMP if it was turned on, else 20 */
+static int
+readTemp ()
+{
+	char fn[1024];
+	FILE *fp;
+	int on = 0;
+
+	telfixpath (fn, tempfn);
+	fp = fopen (fn, "r");
+	if (fp) {
+	    if (fscanf (fp, "%d", &on) != 1)
+		on = 0;
+	    fclose (fp);
+	}
+	return (on ? SC_TEMP : 20);
+}
+
+/* remember whether the cooler is on, ie, s is other than OFF */
+static void
+writeTemp (char *s)
+{
+	char fn[1024];
+	FILE *fp;
+
+	telfixpath (fn, tempfn);
+	fp = fopen (fn, "w");
+	if (fp) {
+	    fprintf (fp, "%d\n", strcmp (s, "OFF") != 0);
+	    fclose (fp);
+	}
+}
+
+/* repeatable unit normal deviate */
+static double
+gauss ()
+{
+	double u, v;
+
+	do {
+	    rseed ^= rseed << 13;
+	    rseed ^= rseed >> 7;
+	    rseed ^= rseed << 17;
+	    u = (rseed >> 11) * (1.0/9007199254740992.0);
+	} while (u == 0);
+	rseed ^= rseed << 13;
+	rseed ^= rseed >> 7;
+	rseed ^= rseed << 17;
+	v = (rseed >> 11) * (1.0/9007199254740992.0);
+	return (sqrt(-2*log(u))*cos(2*PI*v));
+}
@@ -8,6 +8,7 @@
 #include <fcntl.h>
 #include <string.h>
 #include <errno.h>
+#include <signal.h>
 #include <termios.h>
 #include <limits.h>
 #include <unistd.h>
@@ -29,6 +30,7 @@
 #include "configfile.h"
 #include "telstatshm.h"
 #include "telenv.h"
+#include "tseries.h"
 
 
 #define	NSETSKIPS	60			/* secs between clock updates */
@@ -60,6 +62,9 @@ static char telserverHost[64];
 static int telserverPort;
 
 static char *extCmd;
+static char *tsdir;
+static TSWriter *tswp;
+static volatile sig_atomic_t quit;
 static double offsetSecs = 0.0;
 static int delaySecs = 0;
 
@@ -80,6 +85,9 @@ static int llIsOff(double lt, double lg);
 static void setCfg(double lt, double lg);
 static void delay(long dsecs);
 static void delayshort(long msecs);
+static void initSeries(void);
+static void onSig (int signo);
+static void addSeries (double lt, double lg, double Mjd);
 
 static void connectTelserver(char * host, int port);
 static int getTelserverInfo(char *outbuf);
@@ -132,6 +140,12 @@ main (int ac, char *av[])
 		    gpstty = *++av;
 		    ac--;
 		    break;
+		case 'T':
+		    if (ac < 2)
+			usage(prog);
+		    tsdir = *++av;
+		    ac--;
+		    break;
 		case 'v':
 		    vflag++;
 		    break;
@@ -200,6 +214,8 @@ main (int ac, char *av[])
 	
 	if (sflag)
 	    initShm();
+	if (tsdir)
+	    initSeries();
 	if (!gpstty)
 	    setTty();
 	if (oflag)
@@ -209,11 +225,13 @@ main (int ac, char *av[])
 	    printf ("%s: Already running\n", prog);
 	    exit(0);
 	}
+	signal (SIGINT, onSig);
+	signal (SIGTERM, onSig);
 
 	/* open device and go forever */
 	gpsfd = openGps();
     ttySync(gpsfd); // do initial flush, sync
-	while (freshLine (gpsfd, buf, sizeof(buf)) == 0) {
+	while (!quit && freshLine (gpsfd, buf, sizeof(buf)) == 0) {
 	    if(0 == processLine (buf)) {	
             ttySync(gpsfd); // flush after successful read to resynch
     	    delay(delaySecs);
@@ -231,11 +249,26 @@ main (int ac, char *av[])
    	    }
 	}		
 
+	/* seal the open series block so a restart does not lose it */
+	tsClose (tswp);
+	if (quit) {
+	    daemonLog ("Exiting on signal %d\n", (int)quit);
+	    unlock_running (prog, 0);
+	    return (0);
+	}
+
 	/* we should never die */
 	daemonLog ("EOF from %s\n", prog);
 	return (1);
 }
 
+/* just note the signal; main's loop sees it and shuts down cleanly */
+static void
+onSig (int signo)
+{
+	quit = signo;
+}
+
 /* Wait for a time */
 static void delay(long dsecs)
 {
@@ -305,6 +338,7 @@ usage (char *progname)
 	fprintf(fp, " -r host:port connect to telserver at host:port for remotely shared GPS data (overrides tty and HAVEGPS)\n");
 	fprintf(fp, " -s   : update lat/long in telstatshm once\n");
 	fprintf(fp, " -t t : alternate tty. default is from %s\n",basenm(gcfn));
+	fprintf(fp, " -T d : store each fix in time series directory d, see tsq\n");
 	fprintf(fp, " -v   : verbose\n");
     fprintf(fp, " -N   : Output non-parsed lines (diagnostic)\n");
     fprintf(fp, " -w s  : delay 's' seconds between updates (default is 0)\n");
@@ -592,6 +626,10 @@ processLine (char *buf)
 	    before = 1;
 	}
 
+	/* record fix before setTime() might step the clock */
+	if (tswp)
+	    addSeries (lt, lg, Mjd);
+
 	/* set and/or report time, depending on flags */
 	setTime (Mjd);
 
@@ -608,8 +646,10 @@ processLine (char *buf)
 	    chkedLL = 1;
 	}
 
-	if (oflag)
+	if (oflag) {
+	    tsClose (tswp);
 	    exit(0);
+	}
 
     return 0;
 }
@@ -736,6 +776,36 @@ havegps()
 	}
 }
 
+/* open the time series store at tsdir, or carry on without */
+static void
+initSeries(void)
+{
+	static char *cols[] = {"lat", "lng", "clockerr"};
+	char msg[1024];
+
+	tswp = tsOpen (tsdir, cols, sizeof(cols)/sizeof(cols[0]), msg);
+	if (!tswp)
+	    daemonLog ("%s\n", msg);
+}
+
+/* add a fix at lt and lg, rads +N +E, and Mjd to the time series.
+ * columns are degrees +N and +E, and secs the computer clock is slow.
+ */
+static void
+addSeries (double lt, double lg, double Mjd)
+{
+	struct timeval tv;
+	double v[3];
+	char msg[1024];
+
+	gettimeofday (&tv, NULL);
+	v[0] = raddeg(lt);
+	v[1] = raddeg(lg);
+	v[2] = (Mjd + offsetSecs/SPD - mjd_now())*SPD;
+	if (tsAppend (tswp, tv.tv_sec + tv.tv_usec*1e-6, v, msg) < 0)
+	    daemonLog ("%s\n", msg);
+}
+
 /* get tty from config file */
 static void
 setTty (void)
@@ -0,0 +1,828 @@
+/* post-processing daemon.
+ *
+ * finishes each new image as soon as it is written: optionally applies the
+ * bias/thermal/flat corrections and bad column repairs, then writes its star
+ * list, sets the FWHM and, if catalogs are given, the WCS header fields, and
+ * rewrites the file in place. this replaces starting a postprocess script
+ * for every frame, and lets the calibration frames and catalog tiles stay
+ * in memory between frames.
+ *
+ * work arrives two ways:
+ *   each directory named on the command line is watched with inotify for
+ *     FITS files being closed after writing or moved in. these wait SETTLE
+ *     seconds in case a request for them also arrives, then are processed
+ *     with the default options. frames already queued or being processed
+ *     because they were asked for are not taken again.
+ *   lines of the form "path cook" written to the PostProcess fifo, as by
+ *     telrun, where cook is 1 to calibrate the frame, else 0.
+ *
+ * frames wait in a queue of bounded length for one of the worker threads.
+ * when the queue is full we stop reading new work, so it backs up in the
+ * kernel: writers of the fifo then find it full and may run the frame some
+ * other way. the number of frames waiting, busy, done and failed is kept in
+ * the status shared memory.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+
+#include "P_.h"
+#include "astro.h"
+#include "circum.h"
+#include "telstatshm.h"
+#include "cliserv.h"
+#include "telenv.h"
+#include "running.h"
+#include "strops.h"
+#include "fits.h"
+#include "fitscorr.h"
+#include "wcs.h"
+#include "fieldstar.h"
+
+#define	MAXTHR		16	/* max worker threads */
+#define	MAXWATCH	32	/* max watched directories */
+#define	MAXPEND		64	/* max frames settling */
+#define	NOURS		32	/* frames we wrote, remembered to ignore */
+#define	DEFSETTLE	5	/* default settle time, secs */
+#define	DEFNCORR	8	/* default correction frames kept */
+#define	DEFCATMB	64	/* default catalog cache, MB */
+#define	DEFHUNT		0.2	/* default wcs hunt radius, degrees */
+#define	POLLMS		1000	/* max wait for new work, ms */
+
+static char ppfifo[] = "comm/PostProcess.in";
+static char camcfg[] = "archive/config/camera.cfg";
+
+/* one frame to process */
+typedef struct {
+    char fn[PATH_MAX];		/* full path */
+    int cook;			/* set to calibrate */
+    time_t due;			/* when settling is over */
+} Work;
+
+/* the bounded queue of frames waiting for a worker */
+typedef struct {
+    Work *w;			/* ring of cap entries */
+    int cap;			/* max entries */
+    int head;			/* index of oldest */
+    int n;			/* entries in use */
+    pthread_mutex_t lock;
+    pthread_cond_t notempty, notfull;
+} WorkQ;
+
+/* a watched directory */
+typedef struct {
+    int wd;			/* inotify watch descriptor */
+    char dir[PATH_MAX];		/* full path */
+} Watch;
+
+static void usage (char *p);
+static void initShm (void);
+static int initFifo (void);
+static int initWatch (int ac, char *av[]);
+static void readFifo (int fd);
+static void readWatch (int fd);
+static void addWork (char *fn, int cook, int settle);
+static void chkPending (int all);
+static void dropPending (int i);
+static int isOurs (char *fn);
+static void setOurs (char *fn);
+static int isActive (char *fn);
+static void clrActive (char *fn);
+static void *worker (void *arg);
+static int process (Work *wp, char msg[]);
+static int writeInPlace (FImage *fip, char *fn, char msg[]);
+static void count (int dbusy, int ddone, int dfailed);
+static int ftsname (char *fn);
+static void onSig (int signo);
+
+static WorkQ wq;		/* frames ready for a worker */
+static Work pending[MAXPEND];	/* frames settling */
+static int npending;		/* n pending[] */
+static Watch watches[MAXWATCH];	/* watched directories */
+static int nwatches;		/* n watches[] */
+static char ours[NOURS][PATH_MAX];	/* frames we wrote lately */
+static int nextours;		/* next ours[] to reuse */
+static pthread_mutex_t ourslock = PTHREAD_MUTEX_INITIALIZER;
+static char (*active)[PATH_MAX];	/* frames queued or being processed */
+static int nactive;		/* n active[], guarded by wq.lock */
+static volatile sig_atomic_t quit;	/* set by onSig() */
+
+static int busy, done, failed;	/* counters for status */
+static pthread_mutex_t countlock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t wcslock = PTHREAD_MUTEX_INITIALIZER;
+
+static TelStatShm *telstatshmp;	/* status, or NULL if none */
+static BADCOL *badmap;		/* bad column map, or NULL */
+static int nbadmap;		/* entries in badmap[], not counting end */
+static char badmapfn[1024];	/* name of bad column map file */
+static int wantwcs;		/* set if have catalogs for wcs */
+static int wantusno;		/* set to use USNO as well as GSC */
+static double hunt = DEFHUNT;	/* wcs hunt radius, rads after setup */
+static int settle = DEFSETTLE;	/* secs watched frames wait for a request */
+static int cookwatched;		/* set to calibrate watched frames */
+static int verbose;
+static char *progname;
+
+int
+main (int ac, char *av[])
+{
+	pthread_t tid[MAXTHR];
+	struct pollfd pfd[2];
+	sigset_t sigs;
+	char *gscpath = NULL;
+	char *usnopath = NULL;
+	int ncorr = DEFNCORR;
+	int catmb = DEFCATMB;
+	int nthr = 0;
+	int qlen = 0;
+	char msg[1024];
+	char *str;
+	int i;
+
+	progname = basenm(av[0]);
+
+	/* crack arguments */
+	for (av++; --ac > 0 && *(str = *av) == '-'; av++) {
+	    char c;
+	    while ((c = *++str) != '\0')
+		switch (c) {
+		case 'C':
+		    cookwatched++;
+		    break;
+		case 'c':
+		    if (ac < 2)
+			usage (progname);
+		    ncorr = atoi (*++av);
+		    ac--;
+		    break;
+		case 'g':
+		    if (ac < 2)
+			usage (progname);
+		    gscpath = *++av;
+		    ac--;
+		    break;
+		case 'h':
+		    if (ac < 2)
+			usage (progname);
+		    hunt = atof (*++av);
+		    ac--;
+		    break;
+		case 'i':
+		    if (ac < 2)
+			usage (progname);
+		    setIpCfgPath (*++av);
+		    ac--;
+		    break;
+		case 'm':
+		    if (ac < 2)
+			usage (progname);
+		    catmb = atoi (*++av);
+		    ac--;
+		    break;
+		case 'n':
+		    if (ac < 2)
+			usage (progname);
+		    nthr = atoi (*++av);
+		    ac--;
+		    break;
+		case 'q':
+		    if (ac < 2)
+			usage (progname);
+		    qlen = atoi (*++av);
+		    ac--;
+		    break;
+		case 's':
+		    if (ac < 2)
+			usage (progname);
+		    settle = atoi (*++av);
+		    ac--;
+		    break;
+		case 'u':
+		    if (ac < 2)
+			usage (progname);
+		    usnopath = *++av;
+		    ac--;
+		    break;
+		case 'v':
+		    verbose++;
+		    break;
+		default:
+		    usage (progname);
+		}
+	}
+
+	/* only one, please */
+	if (lock_running (progname) < 0) {
+	    daemonLog ("%s: already running\n", progname);
+	    exit (0);
+	}
+
+	/* workers and queue */
+	if (nthr <= 0)
+	    nthr = (int) sysconf (_SC_NPROCESSORS_ONLN);
+	if (nthr <= 0)
+	    nthr = 1;
+	if (nthr > MAXTHR)
+	    nthr = MAXTHR;
+	if (qlen <= 0)
+	    qlen = 2*nthr;
+	wq.w = (Work *) malloc (qlen*sizeof(Work));
+	active = (char (*)[PATH_MAX]) malloc ((qlen+nthr)*sizeof(active[0]));
+	if (!wq.w || !active) {
+	    daemonLog ("No memory for %d queue entries\n", qlen);
+	    exit (1);
+	}
+	wq.cap = qlen;
+	pthread_mutex_init (&wq.lock, NULL);
+	pthread_cond_init (&wq.notempty, NULL);
+	pthread_cond_init (&wq.notfull, NULL);
+
+	/* load everything shared before any threads want it, and keep the
+	 * calibration frames and catalog tiles in memory from frame to frame.
+	 */
+	loadIpCfg();
+	readCorrectionCfg (0, camcfg);
+	setCorrCache (ncorr);
+	nbadmap = readMapFile (NULL, NULL, &badmap, badmapfn, msg);
+	if (nbadmap <= 0) {
+	    if (verbose)
+		daemonLog ("No bad column map\n");
+	    nbadmap = 0;
+	}
+	FSCacheSetup ((long)catmb*1024L*1024L);
+	if (usnopath) {
+	    if (USNOSetup (usnopath, gscpath != NULL, msg) < 0) {
+		daemonLog ("USNO: %s\n", msg);
+		exit (1);
+	    }
+	    wantusno = 1;
+	}
+	if (gscpath && GSCSetup (NULL, gscpath, msg) < 0) {
+	    daemonLog ("GSC: %s\n", msg);
+	    exit (1);
+	}
+	wantwcs = gscpath || usnopath;
+	hunt = degrad (hunt);
+
+	initShm();
+	signal (SIGPIPE, SIG_IGN);
+	signal (SIGTERM, onSig);
+	signal (SIGINT, onSig);
+
+	pfd[0].fd = initFifo();
+	pfd[1].fd = initWatch (ac, av);
+	pfd[0].events = pfd[1].events = POLLIN;
+
+	/* the workers leave the signals to us, so they break into poll() */
+	sigemptyset (&sigs);
+	sigaddset (&sigs, SIGTERM);
+	sigaddset (&sigs, SIGINT);
+	pthread_sigmask (SIG_BLOCK, &sigs, NULL);
+	for (i = 0; i < nthr; i++)
+	    if (pthread_create (&tid[i], NULL, worker, NULL)) {
+		daemonLog ("Can not start worker thread\n");
+		exit (1);
+	    }
+	pthread_sigmask (SIG_UNBLOCK, &sigs, NULL);
+	daemonLog ("Started with %d workers, %d queued max, %d watched\n",
+							nthr, qlen, nwatches);
+
+	/* gather new work, handing it to the workers as it is due, until
+	 * told to stop.
+	 */
+	while (!quit) {
+	    int n = poll (pfd, 2, npending ? POLLMS : -1);
+
+	    if (n < 0) {
+		if (errno == EINTR)
+		    continue;
+		daemonLog ("poll: %s\n", strerror(errno));
+		exit (1);
+	    }
+	    if (pfd[0].revents & POLLIN)
+		readFifo (pfd[0].fd);
+	    if (pfd[1].fd >= 0 && (pfd[1].revents & POLLIN))
+		readWatch (pfd[1].fd);
+	    chkPending (0);
+	}
+
+	/* say the queue is empty as we leave */
+	if (telstatshmp)
+	    telstatshmp->ppqueued = telstatshmp->ppbusy = 0;
+	daemonLog ("Exiting on signal %d\n", (int)quit);
+	return (0);
+}
+
+static void
+usage (char *p)
+{
+	fprintf (stderr, "Usage: %s [options] [dir ...]\n", p);
+	fprintf (stderr, "Purpose: post-process new FITS files, as announced on %s\n", ppfifo);
+	fprintf (stderr, "  or found arriving in each dir.\n");
+	fprintf (stderr, "Options:\n");
+	fprintf (stderr, " -C:       calibrate frames found in dirs; default as-is\n");
+	fprintf (stderr, " -c n:     calibration frames kept in memory; default %d\n", DEFNCORR);
+	fprintf (stderr, " -g dir:   GSC cache for WCS; no WCS without -g or -u\n");
+	fprintf (stderr, " -u dir:   USNO catalog for WCS\n");
+	fprintf (stderr, " -h degs:  WCS hunt radius; default %g\n", DEFHUNT);
+	fprintf (stderr, " -i file:  ip.cfg to use\n");
+	fprintf (stderr, " -m MB:    catalog tiles kept in memory; default %d\n", DEFCATMB);
+	fprintf (stderr, " -n n:     worker threads; default one per core\n");
+	fprintf (stderr, " -q n:     max frames waiting for a worker; default 2n\n");
+	fprintf (stderr, " -s secs:  time frames found in dirs wait for a request; default %d\n", DEFSETTLE);
+	fprintf (stderr, " -v:       log each frame\n");
+	exit (1);
+}
+
+/* connect to the status shared memory, if it is there */
+static void
+initShm ()
+{
+	if (open_telshm (&telstatshmp) < 0) {
+	    daemonLog ("No status shared memory, not reporting queue\n");
+	    telstatshmp = NULL;
+	    return;
+	}
+	count (0, 0, 0);
+}
+
+/* create if necessary and open our request fifo.
+ * open it for writing too so we never see EOF when writers come and go.
+ * return fd for reading, or exit.
+ */
+static int
+initFifo ()
+{
+	char fn[1024];
+	int fd;
+
+	telfixpath (fn, ppfifo);
+	if (mkfifo (fn, 0666) < 0 && errno != EEXIST) {
+	    daemonLog ("%s: %s\n", fn, strerror(errno));
+	    exit (1);
+	}
+	fd = open (fn, O_RDWR|O_NONBLOCK);
+	if (fd < 0) {
+	    daemonLog ("%s: %s\n", fn, strerror(errno));
+	    exit (1);
+	}
+	return (fd);
+}
+
+/* start watching each of the ac directories in av[].
+ * return the inotify fd, or -1 if none are to be watched.
+ */
+static int
+initWatch (int ac, char *av[])
+{
+	int fd;
+
+	if (ac <= 0)
+	    return (-1);
+	if (ac > MAXWATCH) {
+	    daemonLog ("Can only watch %d directories\n", MAXWATCH);
+	    exit (1);
+	}
+
+	fd = inotify_init1 (IN_NONBLOCK);
+	if (fd < 0) {
+	    daemonLog ("inotify: %s\n", strerror(errno));
+	    exit (1);
+	}
+	while (ac-- > 0) {
+	    char fn[1024];
+	    Watch *wp = &watches[nwatches];
+
+	    telfixpath (fn, *av++);
+	    if (!realpath (fn, wp->dir)) {
+		daemonLog ("%s: %s\n", fn, strerror(errno));
+		exit (1);
+	    }
+	    wp->wd = inotify_add_watch (fd, wp->dir, IN_CLOSE_WRITE|IN_MOVED_TO);
+	    if (wp->wd < 0) {
+		daemonLog ("%s: %s\n", wp->dir, strerror(errno));
+		exit (1);
+	    }
+	    nwatches++;
+	}
+	return (fd);
+}
+
+/* read and queue each complete request line on the fifo */
+static void
+readFifo (int fd)
+{
+	static char buf[4*PATH_MAX];
+	static int nbuf;
+	char *lp, *nl;
+	int n;
+
+	n = read (fd, buf+nbuf, sizeof(buf)-1-nbuf);
+	if (n <= 0)
+	    return;
+	nbuf += n;
+	buf[nbuf] = '\0';
+
+	for (lp = buf; (nl = strchr (lp, '\n')) != NULL; lp = nl+1) {
+	    char path[PATH_MAX], fn[PATH_MAX], full[PATH_MAX];
+	    int cook = 0;
+
+	    *nl = '\0';
+	    if (sscanf (lp, "%1023s %d", path, &cook) < 1)
+		continue;
+	    telfixpath (fn, path);
+	    if (!realpath (fn, full)) {
+		daemonLog ("%s: %s\n", fn, strerror(errno));
+		continue;
+	    }
+	    addWork (full, cook, 0);
+	}
+
+	/* keep any partial line for next time, or discard if hopelessly long */
+	nbuf = strlen (lp);
+	if (nbuf == sizeof(buf)-1)
+	    nbuf = 0;
+	else
+	    memmove (buf, lp, nbuf);
+}
+
+/* read the pending inotify events and start each new frame settling */
+static void
+readWatch (int fd)
+{
+	char buf[8192] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+	struct inotify_event *ep;
+	int n, i;
+
+	while ((n = read (fd, buf, sizeof(buf))) > 0) {
+	    for (i = 0; i < n; i += sizeof(*ep) + ep->len) {
+		char fn[PATH_MAX+NAME_MAX+2];
+		int w;
+
+		ep = (struct inotify_event *) &buf[i];
+		if (ep->mask & IN_Q_OVERFLOW) {
+		    daemonLog ("Too far behind, some new frames were missed\n");
+		    continue;
+		}
+		if (ep->len == 0 || !ftsname (ep->name))
+		    continue;
+		for (w = 0; w < nwatches; w++)
+		    if (watches[w].wd == ep->wd)
+			break;
+		if (w == nwatches)
+		    continue;
+		sprintf (fn, "%s/%s", watches[w].dir, ep->name);
+		if (isOurs (fn) || isActive (fn))
+		    continue;		/* our own rewrite, or already asked */
+		addWork (fn, cookwatched, settle);
+	    }
+	}
+}
+
+/* add fn to the work.
+ * if settle, it waits that many secs in pending[] for a request to replace
+ * it; else it replaces any such and goes to the queue now.
+ */
+static void
+addWork (char *fn, int cook, int settle)
+{
+	Work *wp;
+	int i;
+
+	for (i = 0; i < npending; i++)
+	    if (strcmp (pending[i].fn, fn) == 0)
+		break;
+
+	if (settle) {
+	    if (i < npending)
+		return;		/* already settling */
+	    if (npending == MAXPEND)
+		chkPending (1);
+	    wp = &pending[npending];
+	    strcpy (wp->fn, fn);
+	    wp->cook = cook;
+	    wp->due = time(NULL) + settle;
+	    pthread_mutex_lock (&countlock);
+	    npending++;
+	    pthread_mutex_unlock (&countlock);
+	    count (0, 0, 0);
+	    return;
+	}
+
+	/* forget any settling copy, the request says how */
+	if (i < npending)
+	    dropPending (i);
+
+	/* wait for room: this is what makes our writers back off */
+	pthread_mutex_lock (&wq.lock);
+	while (wq.n == wq.cap)
+	    pthread_cond_wait (&wq.notfull, &wq.lock);
+	wp = &wq.w[(wq.head + wq.n) % wq.cap];
+	strcpy (wp->fn, fn);
+	wp->cook = cook;
+	wq.n++;
+	strcpy (active[nactive++], fn);
+	pthread_cond_signal (&wq.notempty);
+	pthread_mutex_unlock (&wq.lock);
+
+	if (verbose)
+	    daemonLog ("%s: queued%s\n", basenm(fn), cook ? ", will cook" : "");
+	count (0, 0, 0);
+}
+
+/* queue each pending frame whose settling is over, or all if all */
+static void
+chkPending (int all)
+{
+	time_t now = time(NULL);
+	int i;
+
+	for (i = 0; i < npending; ) {
+	    if (all || pending[i].due <= now) {
+		Work w;
+
+		w = pending[i];
+		dropPending (i);
+		addWork (w.fn, w.cook, 0);
+	    } else
+		i++;
+	}
+}
+
+/* remove pending[i].
+ * npending is only changed here in the main thread but count() reads it.
+ */
+static void
+dropPending (int i)
+{
+	pthread_mutex_lock (&countlock);
+	pending[i] = pending[--npending];
+	pthread_mutex_unlock (&countlock);
+}
+
+/* return 1 if fn is a frame we wrote lately, and forget it, else 0 */
+static int
+isOurs (char *fn)
+{
+	int i, found = 0;
+
+	pthread_mutex_lock (&ourslock);
+	for (i = 0; i < NOURS; i++)
+	    if (strcmp (ours[i], fn) == 0) {
+		ours[i][0] = '\0';
+		found = 1;
+		break;
+	    }
+	pthread_mutex_unlock (&ourslock);
+	return (found);
+}
+
+/* remember we are about to write fn, so its event is not taken as new work */
+static void
+setOurs (char *fn)
+{
+	pthread_mutex_lock (&ourslock);
+	strcpy (ours[nextours], fn);
+	nextours = (nextours + 1) % NOURS;
+	pthread_mutex_unlock (&ourslock);
+}
+
+/* return 1 if fn is queued or being processed, else 0 */
+static int
+isActive (char *fn)
+{
+	int i, found = 0;
+
+	pthread_mutex_lock (&wq.lock);
+	for (i = 0; i < nactive; i++)
+	    if (strcmp (active[i], fn) == 0) {
+		found = 1;
+		break;
+	    }
+	pthread_mutex_unlock (&wq.lock);
+	return (found);
+}
+
+/* forget one entry for fn in active[], now a worker is done with it.
+ * there are never more than the queue plus the workers.
+ */
+static void
+clrActive (char *fn)
+{
+	int i;
+
+	pthread_mutex_lock (&wq.lock);
+	for (i = 0; i < nactive; i++)
+	    if (strcmp (active[i], fn) == 0) {
+		if (i < --nactive)
+		    strcpy (active[i], active[nactive]);
+		break;
+	    }
+	pthread_mutex_unlock (&wq.lock);
+}
+
+/* one worker thread: process frames from wq forever */
+static void *
+worker (void *arg)
+{
+	while (1) {
+	    char msg[1024];
+	    Work w;
+	    int s;
+
+	    pthread_mutex_lock (&wq.lock);
+	    while (wq.n == 0)
+		pthread_cond_wait (&wq.notempty, &wq.lock);
+	    w = wq.w[wq.head];
+	    wq.head = (wq.head + 1) % wq.cap;
+	    wq.n--;
+	    pthread_cond_signal (&wq.notfull);
+	    pthread_mutex_unlock (&wq.lock);
+
+	    count (1, 0, 0);
+	    msg[0] = '\0';
+	    s = process (&w, msg);
+	    if (s < 0)
+		daemonLog ("%s: %s\n", w.fn, msg);
+	    else if (verbose)
+		daemonLog ("%s: done%s%s\n", basenm(w.fn), msg[0] ? ": " : "",
+									msg);
+	    clrActive (w.fn);
+	    count (-1, s == 0, s < 0);
+	}
+
+	return (NULL);
+}
+
+/* process the frame wp, leaving the result in place.
+ * return 0 if ok, else -1 with reason in msg. if some step fails but the
+ * frame is still worth writing it is, and that is also reported as -1.
+ */
+static int
+process (Work *wp, char msg[])
+{
+	char buf[1024];
+	FImage fim;
+	StarRec *sr;
+	double ra, dec;
+	int nsr, i;
+	int fd, s = 0;
+
+	fd = open (wp->fn, O_RDONLY);
+	if (fd < 0) {
+	    strcpy (msg, strerror(errno));
+	    return (-1);
+	}
+	initFImage (&fim);
+	if (readFITS (fd, &fim, msg) < 0) {
+	    close (fd);
+	    return (-1);
+	}
+	close (fd);
+
+	if (wp->cook && getStringFITS (&fim, "BIASCOR", buf) < 0) {
+	    if (correctFITS (&fim, NULL, NULL, NULL, msg) < 0) {
+		resetFImage (&fim);
+		return (-1);
+	    }
+	    if (nbadmap > 0) {
+		/* removeBadColumns() scribbles on the map */
+		BADCOL *map = (BADCOL *) malloc ((nbadmap+1)*sizeof(BADCOL));
+
+		if (map) {
+		    memcpy (map, badmap, (nbadmap+1)*sizeof(BADCOL));
+		    if (removeBadColumns (&fim, map, badmapfn, buf) < 0) {
+			sprintf (msg, "bad columns: %s", buf);
+			s = -1;
+		    }
+		    free ((void *)map);
+		}
+	    }
+	}
+
+	/* measure the stars once, for the FWHM and WCS here and for later */
+	nsr = measureStarList (&fim, &sr);
+	if (nsr < 0 || writeStarList (wp->fn, &fim, sr, nsr, buf) < 0
+					    || useStarList (wp->fn, &fim) < 0) {
+	    if (nsr < 0)
+		strcpy (buf, "Error finding stars");
+	    sprintf (msg, "stars: %s", buf);
+	    s = -1;
+	}
+
+	if (setFWHMFITS (&fim, buf) < 0) {
+	    sprintf (msg, "FWHM: %s", buf);
+	    s = -1;
+	}
+
+	if (wantwcs) {
+	    /* the catalogs and the solver are not reentrant */
+	    pthread_mutex_lock (&wcslock);
+	    if (setWCSFITS (&fim, wantusno, hunt, NULL, 0, buf) < 0) {
+		sprintf (msg, "WCS: %s", buf);
+		s = -1;
+	    }
+	    pthread_mutex_unlock (&wcslock);
+	}
+
+	/* add RA/Dec to the star list if the frame now has WCS */
+	if (nsr > 0 && xy2RADec (&fim, sr[0].x, sr[0].y, &ra, &dec) == 0) {
+	    for (i = 0; i < nsr; i++)
+		if (xy2RADec (&fim, sr[i].x, sr[i].y, &sr[i].ra, &sr[i].dec) == 0)
+		    sr[i].flags |= SL_RADEC;
+	    if (writeStarList (wp->fn, &fim, sr, nsr, buf) < 0) {
+		sprintf (msg, "stars: %s", buf);
+		s = -1;
+	    }
+	}
+	if (nsr >= 0)
+	    free ((void *)sr);
+
+	if (writeInPlace (&fim, wp->fn, buf) < 0) {
+	    strcpy (msg, buf);
+	    s = -1;
+	}
+	resetFImage (&fim);
+	return (s);
+}
+
+/* write fip over fn, by way of a temp file so fn is never half done.
+ * return 0 if ok, else -1 with reason in msg.
+ */
+static int
+writeInPlace (FImage *fip, char *fn, char msg[])
+{
+	char tmp[PATH_MAX+8];
+	int fd, s;
+
+	sprintf (tmp, "%s.tmp", fn);
+	fd = open (tmp, O_WRONLY|O_CREAT|O_TRUNC, 0664);
+	if (fd < 0) {
+	    sprintf (msg, "%s: %s", tmp, strerror(errno));
+	    return (-1);
+	}
+	s = writeFITS (fd, fip, msg, 0);
+	if (close (fd) < 0 && s == 0) {
+	    sprintf (msg, "%s: %s", tmp, strerror(errno));
+	    s = -1;
+	}
+	if (s == 0) {
+	    setOurs (fn);
+	    if (rename (tmp, fn) < 0) {
+		sprintf (msg, "%s: %s", fn, strerror(errno));
+		s = -1;
+	    }
+	}
+	if (s < 0)
+	    (void) unlink (tmp);
+	return (s);
+}
+
+/* add to the counters and post them, with the queue depth, to shm */
+static void
+count (int dbusy, int ddone, int dfailed)
+{
+	pthread_mutex_lock (&countlock);
+	busy += dbusy;
+	done += ddone;
+	failed += dfailed;
+	if (telstatshmp) {
+	    pthread_mutex_lock (&wq.lock);
+	    telstatshmp->ppqueued = wq.n + npending;
+	    pthread_mutex_unlock (&wq.lock);
+	    telstatshmp->ppbusy = busy;
+	    telstatshmp->ppdone = done;
+	    telstatshmp->ppfailed = failed;
+	    telshm_changed (telstatshmp, TSG_BIT(TSG_CAM));
+	}
+	pthread_mutex_unlock (&countlock);
+}
+
+/* return 1 if fn looks like a FITS file name, else 0 */
+static int
+ftsname (char *fn)
+{
+	char *dot = strrchr (fn, '.');
+
+	return (dot && (!strcasecmp (dot, ".fts") || !strcasecmp (dot, ".fits")
+						|| !strcasecmp (dot, ".fit")));
+}
+
+/* note we have been asked to stop; main() notices when poll() returns */
+static void
+onSig (int signo)
+{
+	quit = signo;
+}
@@ -31,6 +31,7 @@
 #include "configfile.h"
 #include "strops.h"
 #include "telstatshm.h"
+#include "cliserv.h"
 #include "running.h"
 #include "csimc.h"
 #include "misc.h"
@@ -351,6 +352,7 @@ slaveMode()
 		}
 	    }
 	    memcpy (telstatshmp, &tmpshm, sizeof(TelStatShm)); /* all at once */
+	    telshm_changed (telstatshmp, 0);	/* gen[] came with it */
 	    usleep (updms*1000);
 	}
 }
@@ -252,3 +252,42 @@ else
 	select(0, NULL,NULL,NULL,&tv);
     }
 }
+
+/* read the raw position of each of the n motors mips[] over its fds[], from
+ * its encoder if it has one else from its motor, and update raw and cpos.
+ * all the queries are sent before waiting for any reply, so the nodes answer
+ * in parallel rather than one round trip after another.
+ */
+void
+csiReadRaw (MotorInfo *mips[], int fds[], int n)
+{
+	char *exprs[NNODES];
+	int vals[NNODES];
+	int i;
+
+	if (n > NNODES) {
+	    tdlog ("csiReadRaw: %d motors, max is %d\n", n, NNODES);
+	    exit(1);
+	}
+
+	for (i = 0; i < n; i++)
+	    exprs[i] = mips[i]->haveenc ? "=epos;" : "=mpos;";
+	(void) csi_rixv (n, fds, exprs, vals);
+
+	for (i = 0; i < n; i++) {
+	    MotorInfo *mip = mips[i];
+	    int raw = vals[i];
+
+	    if (mip->haveenc) {
+		double draw;
+
+		/* just change by half-step if encoder changed by 1 */
+		draw = abs(raw - mip->raw)==1 ? (raw + mip->raw)/2.0 : raw;
+		mip->raw = raw;
+		mip->cpos = (2*PI) * mip->esign * draw / mip->estep;
+	    } else {
+		mip->raw = raw;
+		mip->cpos = (2*PI) * mip->sign * mip->raw / mip->step;
+	    }
+	}
+}
@@ -941,7 +941,7 @@ d_chkWx(char *msg)
 	int wxalert;
 
 	if(wp != NULL) {
-		wxalert = (time(NULL) - wp->updtime < 30) && wp->alert;
+		wxalert = (real_secs(time_now() - wp->updtime) < 30) && wp->alert;
 	} else {
 		wxalert = 0;
 	}
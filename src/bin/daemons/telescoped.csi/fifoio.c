@@ -35,16 +35,19 @@ typedef struct {
     FifoId id;		/* cross-check with symbolic code name */
     char *name;		/* fifo name */
     void (*fp)();	/* function to call to process input from this fifo */
+    void (*bfp)();	/* function to call with typed binary frames, if any */
     int fd[2];		/* fifo descriptors once opened */
+    int binary;		/* set while handling a binary frame */
+    int binok;		/* set once a client has sent BIN_HELLO */
 } FifoInfo;
 
 /* array of info about each fifo pair we deal with.
  * N.B. must be in same order as the FifoName enum, above
  */
 static FifoInfo fifo[] = {
-    {Tel_Id,	"Tel",        tel_msg},
+    {Tel_Id,	"Tel",        tel_msg,		tel_bmsg},
     {Filter_Id,	"Filter",     filter_msg},
-    {Focus_Id,	"Focus",      focus_msg},
+    {Focus_Id,	"Focus",      focus_msg,	focus_bmsg},
     {Dome_Id, 	"Dome",       dome_msg},
     {Lights_Id, "Lights",     lights_msg},
     {Power_Id,	"Powerfail",  power_msg},
@@ -56,9 +59,11 @@ static void open_1fifo (FifoInfo *fip);
 static void close_1fifo (FifoInfo *fip);
 static void reopen_1fifo (FifoInfo *fip);
 static void set_shmtime (void);
+static void dispatch (FifoInfo *fip, BinMsg *bp);
 
-/* write a code and new message to given fifo.
- * also log with tdlog() if code is < 0.
+/* write a code and new message to given fifo: as a BM_TEXT frame if it is
+ * the direct reply to a binary frame, else as text, which bin_read() also
+ * takes. also log with tdlog() if code is < 0.
  */
 void
 fifoWrite (FifoId f, int code, char *fmt, ...)
@@ -81,7 +86,10 @@ fifoWrite (FifoId f, int code, char *fmt, ...)
 	va_end (ap);
 
 	/* send it */
-	n = serv_write (fip->fd, code, buf, errmsg);
+	if (fip->binary)
+	    n = bin_write (fip->fd, BM_TEXT, code, buf, strlen(buf)+1, errmsg);
+	else
+	    n = serv_write (fip->fd, code, buf, errmsg);
 	if (n < 0)
 	    tdlog ("%s: %s", fip->name, errmsg);
 
@@ -110,6 +118,7 @@ init_fifos()
 /* check for and dispatch all incoming messages.
  * then call all handlers for followup regardless.
  * keep telstatshmp->now_mjd as current as possible.
+ * then tell shm readers about whatever changed.
  */
 void
 chk_fifos()
@@ -145,13 +154,13 @@ chk_fifos()
 	/* dispatch any fifo messages */
 	for (fip = fifo; s > 0 && fip < &fifo[N_F]; fip++) {
 	    if (FD_ISSET (fip->fd[0], &rfdset)) {
-		char msg[MAXLINE];
+		BinMsg bm;
 		int n;
 
-		/* retreive new message */
-		n = serv_read (fip->fd, msg, sizeof(msg)-1);
+		/* retreive new message, either framing */
+		n = serv_readbin (fip->fd, &bm);
 		if (n < 0) {
-		    tdlog ("%s: read: %s", fip->name, msg);
+		    tdlog ("%s: read: %s", fip->name, bm.u.text);
 		    reopen_1fifo(fip);		/* exits if fails */
 		    break;			/* need new select() */
 		}
@@ -159,11 +168,24 @@ chk_fifos()
 		/* keep time current */
 		set_shmtime();
 		
-		/* dispatch, unless powerfail underway */
-		if (fip->id == Power_Id || chkPowerfail() < 0)
-		    (*fip->fp) (msg);
+		/* dispatch, unless powerfail underway.
+		 * only the replies made while handling a frame are framed.
+		 * a fifo has no notion of who wrote to it, so later progress
+		 * and done messages go as text, which any client can read.
+		 * frames are only taken after the hello, until reopened.
+		 */
+		fip->binary = n;
+		if (n == 0 && strcasecmp (bm.u.text, BIN_HELLO) == 0) {
+		    fip->binok = 1;
+		    fifoWrite (fip->id, 0, "%s", BIN_HELLO);
+		} else if (n == 1 && !fip->binok) {
+		    fip->binary = 0;
+		    fifoWrite (fip->id, -1, "Binary frame before %s", BIN_HELLO);
+		} else if (fip->id == Power_Id || chkPowerfail() < 0)
+		    dispatch (fip, &bm);
 		else 
 		    fifoWrite (fip->id, -1, "Power fail in progress");
+		fip->binary = 0;
 
 		/* handled this one */
 		s--;
@@ -175,6 +197,9 @@ chk_fifos()
 	    set_shmtime();			/* keep time current */
 	    (*fip->fp) (NULL);			/* general update poll */
 	}
+
+	/* announce scope and dome changes */
+	telshm_publish (telstatshmp, TSG_BIT(TSG_TEL) | TSG_BIT(TSG_DOME));
 }
 
 /* create and attach all the fifos */
@@ -214,10 +239,25 @@ reopen_1fifo (FifoInfo *fip)
 {
 	tdlog ("%s: closing", fip->name);
 	close_1fifo (fip);
+	fip->binok = 0;
 	tdlog ("%s: reopening", fip->name);
 	open_1fifo (fip);
 }
 
+/* hand a new message to the fifo's handler: text as always, typed binary
+ * frames to its binary handler if it has one.
+ */
+static void
+dispatch (FifoInfo *fip, BinMsg *bp)
+{
+	if (bp->h.type == BM_TEXT)
+	    (*fip->fp) (bp->u.text);
+	else if (fip->bfp)
+	    (*fip->bfp) (bp);
+	else
+	    fifoWrite (fip->id, -1, "No binary command %d", bp->h.type);
+}
+
 /* set current time in telstatshmp */
 static void
 set_shmtime()
@@ -676,20 +676,10 @@ readFilter ()
 	    mip->raw = vmc_rix (mip->axis, "=mpos;");
 	    mip->cpos = (2*PI) * mip->sign * mip->raw / mip->step;
 	} else {
-	
-	if(mip->haveenc) {
-            double draw;
-            int    raw;
-
-			/* just change by half-step if encoder changed by 1 */
-			raw = csi_rix (MIPSFD(mip), "=epos;");
-			draw = abs(raw - mip->raw)==1 ? (raw + mip->raw)/2.0 : raw;
-			mip->raw = raw;
-			mip->cpos = (2*PI) * mip->esign * draw / mip->estep;
-        } else {
-    	    mip->raw = csi_rix (MIPCFD(mip), "=mpos;");
-	        mip->cpos = (2*PI) * mip->sign * mip->raw / mip->step;
-        }
+	    /* N.B. motor position has always been read over the command fd */
+	    int fd = mip->haveenc ? MIPSFD(mip) : MIPCFD(mip);
+
+	    csiReadRaw (&mip, &fd, 1);
 	}
 }
 
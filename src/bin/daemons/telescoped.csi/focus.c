@@ -50,6 +50,7 @@ static void focus_stop(int first, ...);
 static void focus_auto(int first, ...);
 static void focus_offset(int first, ...);
 static void focus_jog(int first, ...);
+static int focusReady (char *msg);
 
 /* helped along by these... */
 static void initCfg(void);
@@ -81,19 +82,8 @@ char *msg;
 	    return;
 	}
 
-	if (!OMOT->have) {
-	    if (msg)
-		fifoWrite (Focus_Id, 0, "Ok, but focuser not really installed");
+	if (focusReady (msg) < 0)
 	    return;
-	}
-
-	/* setup? */
-	if(!virtual_mode) {
-		if (!MIPCFD(OMOT)) {
-		    tdlog ("Focus command before initial Reset: %s", msg?msg:"(NULL)");
-    		return;
-		}
-	}
 	
 	if (!msg)
 	    focus_poll();
@@ -111,6 +101,42 @@ char *msg;
 	    focus_offset (1, atof(msg));
 }
 
+/* called when we receive a typed binary frame from the Focus fifo */
+void
+focus_bmsg (BinMsg *bp)
+{
+	if (bp->h.type != BM_FOCUS) {
+	    fifoWrite (Focus_Id, -1, "No binary command %d", bp->h.type);
+	    return;
+	}
+	if (focusReady ("binary offset") < 0)
+	    return;
+	focus_offset (1, bp->u.focus.um);
+}
+
+/* return 0 if the focuser is installed and set up, else -1, after saying so
+ * if msg.
+ */
+static int
+focusReady (char *msg)
+{
+	if (!OMOT->have) {
+	    if (msg)
+		fifoWrite (Focus_Id, 0, "Ok, but focuser not really installed");
+	    return (-1);
+	}
+
+	/* setup? */
+	if(!virtual_mode) {
+		if (!MIPCFD(OMOT)) {
+		    tdlog ("Focus command before initial Reset: %s", msg?msg:"(NULL)");
+    		return (-1);
+		}
+	}
+
+	return (0);
+}
+
 /* no new messages.
  * goose the current objective, if any.
  */
@@ -614,19 +640,9 @@ readFocus ()
 	    mip->raw = vmc_rix (mip->axis, "=mpos;");
 	    mip->cpos = (2*PI) * mip->sign * mip->raw / mip->step;
 	} else {
-        if(mip->haveenc) {
-            double draw;
-            int    raw;
-
-			/* just change by half-step if encoder changed by 1 */
-			raw = csi_rix (MIPSFD(mip), "=epos;");
-			draw = abs(raw - mip->raw)==1 ? (raw + mip->raw)/2.0 : raw;
-			mip->raw = raw;
-			mip->cpos = (2*PI) * mip->esign * draw / mip->estep;
-        } else {
-    	    mip->raw = csi_rix (MIPSFD(mip), "=mpos;");
-	        mip->cpos = (2*PI) * mip->sign * mip->raw / mip->step;
-        }
+	    int fd = MIPSFD(mip);
+
+	    csiReadRaw (&mip, &fd, 1);
 	}
 }
 
@@ -16,6 +16,7 @@
 #include "strops.h"
 #include "csimc.h"
 #include "telenv.h"
+#include "cliserv.h"
 
 #include "teled.h"
 
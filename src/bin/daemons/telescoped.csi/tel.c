@@ -24,6 +24,7 @@
 #include "virmc.h"
 #include "cliserv.h"
 #include "tts.h"
+#include "horizon.h"
 
 #include "teled.h"
 
@@ -63,6 +64,7 @@ static int atTarget (void);
 static int trackObj (Obj *op, int first);
 static void findAxes (Now *np, Obj *op, double *xp, double *yp, double *rp);
 static int chkLimits (int wrapok, double *xp, double *yp, double *rp);
+static int chkHorizon (double alt, double az);
 static void jogTrack (int first, char dircode);
 static void jogSlew (int first, char dircode);
 static int checkAxes(void);
@@ -129,6 +131,34 @@ char *msg;
 	    tel_stop(1);
 }
 
+/* called when we receive a typed binary frame from the Tel fifo.
+ * each does just what its text form does in tel_msg().
+ */
+void
+tel_bmsg (BinMsg *bp)
+{
+	BinJog *jp = &bp->u.jog;
+
+	switch (bp->h.type) {
+	case BM_OFFSET:
+	    offsetTracking (1, bp->u.offset.ha, bp->u.offset.dec);
+	    break;
+	case BM_RADEC:
+	    tel_radecep (1, bp->u.radec.ra, bp->u.radec.dec, bp->u.radec.ep);
+	    break;
+	case BM_JOG:
+	    jp->dir[sizeof(jp->dir)-1] = '\0';
+	    if (jp->dir[0] && strspn (jp->dir, "NSEWnsew0") == strlen(jp->dir))
+		tel_jog (1, jp->dir);
+	    else
+		tel_stop(1);
+	    break;
+	default:
+	    fifoWrite (Tel_Id, -1, "No binary command %d", bp->h.type);
+	    break;
+	}
+}
+
 /* no new messages.
  * goose the current objective, if any, else just update cooked position.
  */
@@ -646,6 +676,11 @@ tel_hadec (int first, ...)
 		active_func = NULL;;
 		return;	/* Tel_Id already informed */
 	    }
+	    hadec_aa (lat, ha, dec, &alt, &az);
+	    if (chkHorizon (alt, az) < 0) {
+		active_func = NULL;
+		return;	/* Tel_Id already informed */
+	    }
 
 	    /* set new state */
 	    telstatshmp->telstate = TS_SLEWING;
@@ -660,7 +695,6 @@ tel_hadec (int first, ...)
 	    telstatshmp->DAHA = ha;
 	    telstatshmp->DADec = dec;
 	    tel_hadec2PA (ha, dec, &telstatshmp->tax, lat, &pa);
-	    hadec_aa (lat, ha, dec, &alt, &az);
 	    telstatshmp->DPA = pa;
 	    telstatshmp->Dalt = alt;
 	    telstatshmp->Daz = az;
@@ -1036,7 +1070,7 @@ trackObj (Obj *op, int first)
 	    return (-1);
 	}
 	findAxes (&now, op, &x, &y, &r);
-	if (chkLimits (1, &x, &y, &r) < 0) {
+	if (chkLimits (1, &x, &y, &r) < 0 || chkHorizon (op->s_alt, op->s_az) < 0){
 	    stopTel(0);
 	    return (-1);
 	}
@@ -1206,11 +1240,16 @@ mkCook()
 	telstatshmp->CPA = r;
 }
 
-/* read the raw values */
+/* read the raw values.
+ * all axes are queried at once, so a cycle costs one round trip, not one each.
+ */
 static void
 readRaw ()
 {
 	MotorInfo *mip;
+	MotorInfo *mips[TEL_NM];
+	int fds[TEL_NM];
+	int n = 0;
 
 	FEM(mip) {
 	    if (!mip->have)
@@ -1220,22 +1259,13 @@ readRaw ()
 			mip->raw = vmcGetPosition(mip->axis);
 			mip->cpos = (2*PI) * mip->sign * mip->raw / mip->step;
 		} else {		
-			if (mip->haveenc) {
-				double draw;
-				int raw;
-
-				/* just change by half-step if encoder changed by 1 */
-				raw = csi_rix (MIPSFD(mip), "=epos;");
-				draw = abs(raw - mip->raw)==1 ? (raw + mip->raw)/2.0 : raw;
-				mip->raw = raw;
-				mip->cpos = (2*PI) * mip->esign * draw / mip->estep;
-
-	    	} else {
-				mip->raw = csi_rix (MIPSFD(mip), "=mpos;");
-				mip->cpos = (2*PI) * mip->sign * mip->raw / mip->step;
-	    	}
+			mips[n] = mip;
+			fds[n++] = MIPSFD(mip);
 	    }
 	}
+
+	if (n > 0)
+	    csiReadRaw (mips, fds, n);
 }
 
 /* issue a stop to all telescope axes */
@@ -1392,6 +1422,26 @@ chkLimits (int wrapok, double *xp, double *yp, double *rp)
 	return (0);
 }
 
+/* check alt/az is above the local horizon profile, if one is loaded.
+ * if not, send failed message to Tel_Id and return -1, else return 0.
+ * with no profile, chkLimits() alone decides, as always.
+ */
+static int
+chkHorizon (double alt, double az)
+{
+	double hzn;
+
+	if (!hznHave())
+	    return (0);
+	hzn = hznAlt (az);
+	if (alt < hzn) {
+	    fifoWrite (Tel_Id, -6, "%.1f Alt is below the horizon, %.1f at %.1f Az",
+					raddeg(alt), raddeg(hzn), raddeg(az));
+	    return (-1);
+	}
+	return (0);
+}
+
 /* set all desireds to currents */
 static void
 dummyTarg()
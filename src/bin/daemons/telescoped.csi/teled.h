@@ -36,6 +36,7 @@ extern void csiiClose (MotorInfo *mip);
 extern int csiOpen (int addr);
 extern int csiClose (int addr);
 extern int csiIsReady (int fd);
+extern void csiReadRaw (MotorInfo *mips[], int fds[], int n);
 
 /* dome.c */
 extern void dome_msg (char *msg);
@@ -52,6 +53,7 @@ extern FilterInfo *findFilter (char name);
 
 /* focus.c */
 extern void focus_msg (char *msg);
+extern void focus_bmsg (BinMsg *bp);
 
 /* lights.c */
 extern void lights_msg (char *msg);
@@ -66,6 +68,7 @@ extern void power_msg (char *msg);
 
 /* tel.c */
 extern void tel_msg (char *msg);
+extern void tel_bmsg (BinMsg *bp);
 
 /* telescoped.c */
 extern double STOWALT, STOWAZ;
@@ -46,6 +46,10 @@
 #include "csimc.h"
 #include "misc.h"
 #include "telenv.h"
+#include "tseries.h"
+#include "simclock.h"
+#include "horizon.h"
+#include "cliserv.h"
 
 #include "teled.h"
 
@@ -66,9 +70,17 @@ static void init_shm(void);
 static void init_tz(void);
 static void on_sig(int fake);
 static void main_loop(void);
+static void init_series(void);
+static void add_series(void);
 
 static char logdir[] = "archive/logs";
 static char *progname;
+static char *tsdir;			/* time series store, if any */
+static TSWriter *tswp;			/* open on tsdir */
+static double simspeed;			/* simulated clock speed, if any */
+static double simmjd;			/* simulated clock start, if any */
+
+#define	TSDT	10			/* secs between time series rows */
 
 // Global values read from config
 double STOWALT, STOWAZ;
@@ -92,6 +104,24 @@ char *av[];
 		case 'v':	/* same thing, but mnemonic to new name */
 		    virtual_mode = 1;
 		    break;
+		case 'm':	/* simulated clock start */
+		    if (ac < 2)
+			usage();
+		    simmjd = atof(*++av);
+		    ac--;
+		    break;
+		case 's':	/* simulated clock speed */
+		    if (ac < 2)
+			usage();
+		    simspeed = atof(*++av);
+		    ac--;
+		    break;
+		case 'T':	/* time series directory */
+		    if (ac < 2)
+			usage();
+		    tsdir = *++av;
+		    ac--;
+		    break;
 		default:
 		    usage();
 		    break;
@@ -102,6 +132,12 @@ char *av[];
 	if (ac > 0)
 	    usage();
 
+	/* only simulate time with simulated hardware */
+	if ((simspeed || simmjd) && !virtual_mode)
+	    usage();
+	if (simspeed < 0 || (simmjd && !simspeed))
+	    usage();
+
 	/* only ever one */ 
 	if (lock_running(progname) < 0) {
 	    tdlog ("%s: Already running", progname);
@@ -110,6 +146,8 @@ char *av[];
 
 	/* init all subsystems once */
 	init_all();
+	if (tsdir)
+	    init_series();
 
 	/* go */
 	main_loop();
@@ -144,7 +182,7 @@ tdlog (char *fmt, ...)
 	    fp = NULL;
 
 	/* start with time stamp */
-	l = sprintf (buf, "%s: ", timestamp(time(NULL)));
+	l = sprintf (buf, "%s: ", timestamp(time_now()));
 
 	/* format the message */
 	va_start (ap, fmt);
@@ -176,6 +214,7 @@ die()
 	tdlog ("die()!");
 	allstop();
 	close_fifos();
+	tsClose (tswp);
 	unlock_running (progname, 0);
 	exit (0);
 }
@@ -209,6 +248,7 @@ init_cfg()
 	};
 	
 	Now *np = &telstatshmp->now;
+	char hznfn[1024], msg[1024];
 	int n;
 
 	n = readCfgFile (1, tscfn, tscfg, NTSCFG);
@@ -224,14 +264,64 @@ init_cfg()
 	pressure = PRESSURE;		/* we want mB */
 	elev = ELEVATION/ERAD;		/* we want earth radii*/
 
+	/* local horizon profile, if any, else flat */
+	if (hznCfg (tscfn, hznfn, msg) < 0)
+	    tdlog ("%s\n", msg);
+
 #undef NTSCFG
 }
 
 static void
 main_loop()
 {
-	while (1)
+	while (1) {
 	    chk_fifos();
+	    if (tswp)
+		add_series();
+	}
+}
+
+/* open the time series store at tsdir, or carry on without */
+static void
+init_series()
+{
+	static char *cols[] = {
+	    "telstate", "alt", "az", "ha", "dec", "domestate", "domeaz",
+	    "shutter",
+	};
+	char msg[1024];
+
+	tswp = tsOpen (tsdir, cols, sizeof(cols)/sizeof(cols[0]), msg);
+	if (!tswp)
+	    tdlog ("%s", msg);
+}
+
+/* add the scope and dome state to the time series every TSDT secs.
+ * N.B. must be same order as cols[] in init_series()
+ */
+static void
+add_series()
+{
+	static time_t last;
+	TelStatShm *tsp = telstatshmp;
+	double t = secs_now();
+	double v[8];
+	char msg[1024];
+
+	if (t < last + TSDT)
+	    return;
+	last = (time_t)t;
+
+	v[0] = tsp->telstate;
+	v[1] = raddeg(tsp->Calt);
+	v[2] = raddeg(tsp->Caz);
+	v[3] = radhr(tsp->CAHA);
+	v[4] = raddeg(tsp->CADec);
+	v[5] = tsp->domestate;
+	v[6] = raddeg(tsp->domeaz);
+	v[7] = tsp->shutterstate;
+	if (tsAppend (tswp, t, v, msg) < 0)
+	    tdlog ("%s", msg);
 }
 
 /* tell everybody to reset */
@@ -252,6 +342,9 @@ usage ()
 {
 	fprintf (stderr, "%s: [options]\n", progname);
 	fprintf (stderr, " -v: (or -h) run in virtual mode w/o actual hardware attached.\n");
+	fprintf (stderr, " -s x: with -v, run all the observatory on a clock x times real time.\n");
+	fprintf (stderr, " -m mjd: with -s, start the clock at mjd; default now.\n");
+	fprintf (stderr, " -T d: store scope and dome state in time series directory d, see tsq\n");
 	exit (1);
 }
 
@@ -264,6 +357,16 @@ init_all()
 	/* connect to the telstatshm segment */
 	init_shm();
 
+	/* start simulated time if desired, else run on real time */
+	if (simspeed) {
+	    SimClock *scp = &telstatshmp->simclock;
+
+	    simclock_start (scp, simmjd ? (simmjd - 25567.5)*SPD : secs_now(),
+								    simspeed);
+	    tdlog ("Simulated clock at %gx real time from %s", simspeed,
+						    timestamp(time_now()));
+	}
+
 	/* divine timezone */
 	init_tz();
 
@@ -325,6 +428,7 @@ init_shm()
 
 	/* handy */
 	telstatshmp = (TelStatShm *) addr;
+	simclock_attach (&telstatshmp->simclock);
 }
 
 static void
@@ -19,6 +19,9 @@
 #include <string.h>
 #include <stdio.h>
 #include <ctype.h>
+#include <math.h>
+
+#include "simclock.h"
 
 #define TRACE_ON 0
 #if TRACE_ON
@@ -191,7 +194,7 @@ void vmcResetClock(int node)
 	
 	TRACE "vmcResetClock %d\n",node);
 	
-	ftime(&pvc->timeRef);
+	pvc->timeRef = secs_now();
 }
 
 // return milliseconds elapsed since last reset for this node
@@ -204,18 +207,10 @@ long vmcGetClock(int node)
 	return oGetTime(pvc);	
 }
 
+// milliseconds since timeRef, on the simulated clock if in effect
 static long oGetTime(VCNodePtr pvc)
 {
-	struct timeb now;
-	int	dsec;
-	int	dms;
-	
-	ftime(&now);
-
-	dsec = now.time - pvc->timeRef.time;
-	dms = now.millitm - pvc->timeRef.millitm;
-
-	return dsec * 1000 + dms;
+	return (long) floor((secs_now() - pvc->timeRef) * 1000);
 }	
 
 // Set the timeout value
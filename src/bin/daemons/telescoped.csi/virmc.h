@@ -3,7 +3,6 @@
 #ifndef VIRMC_H
 #define VIRMC_H
 
-#include <sys/timeb.h>	// ftime
 
 #define mAbs(v)  ((v) < 0 ? -(v) : (v))
 #define absclamp(v,m) (v = (mAbs(v) < (m) ? (v) : (v) < 0 ? -(m) : (m)))
@@ -40,7 +39,7 @@ typedef struct
 	
 	char	iedge;				// triggered bits, like iedge of csimc
 	
-	struct timeb timeRef;		// a time reference used for millisecond clock
+	double	timeRef;			// secs_now() reference for millisecond clock
 	double * trackPath;			// allocation for path points if tracking
 	int		numTrackPts;		// number of tracking points in path
 	int		trackStart;			// ms time this path starts at
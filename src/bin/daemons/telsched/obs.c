@@ -385,6 +385,7 @@ Obs *op;
 	op->scan.shutter = CCDSO_Open;
 	op->lststart = NOTIME;
 	op->utcstart = NOTIME;
+	op->visup = op->visdown = NOTIME;
 }
 
 /* check the list of filter names in the av list of ac strings.
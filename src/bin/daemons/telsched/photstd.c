@@ -23,6 +23,7 @@
 #include "xtools.h"
 #include "telenv.h"
 #include "scan.h"
+#include "horizon.h"
 
 #include "telsched.h"
 
@@ -277,9 +278,12 @@ XtPointer call;
 	/* sort by increasing altitude */
 	qsort ((void *)sp, nsp, sizeof(PStdStar), alt_sf);
 
-	/* find lowest field rising just above MINALT to insure all stay up */
+	/* find lowest field rising just above MINALT and the horizon to
+	 * insure all stay up
+	 */
 	for (first = 0; first < nsp; first++)
-	    if (sp[first].o.s_alt > MINALT && sp[first].o.s_az < PI)
+	    if (sp[first].o.s_alt > MINALT && sp[first].o.s_az < PI
+			&& sp[first].o.s_alt > hznAlt (sp[first].o.s_az))
 		break;
 	nf = nsp - first;	/* total number of fields we can use */
 	if (nf < nfields) {
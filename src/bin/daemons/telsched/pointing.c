@@ -23,6 +23,7 @@
 #include "telenv.h"
 #include "configfile.h"
 #include "scan.h"
+#include "horizon.h"
 
 #include "telsched.h"
 
@@ -352,7 +353,7 @@ char path[])		/* where to put images */
 		objp->f_RA = ra;
 		objp->f_dec = dec;
 		obj_cir (&nowscan, objp);
-		if (objp->s_alt < MINALT)
+		if (objp->s_alt < MINALT || objp->s_alt < hznAlt (objp->s_az))
 		    continue;	/* can't see that ha/dec from here */
 		if (objp->s_alt > MAXALT)
 		    continue;	/* within the zenith hole */
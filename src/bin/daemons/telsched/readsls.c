@@ -70,7 +70,8 @@ opensls_cb (Widget w, XtPointer client, XtPointer call)
 	char *base;
 	char *str;
 	Now nowscan;
-	FILE *fp;
+	SLSMap slsmap;
+	int i;
 
 	/* get filename */
 	XmStringGetLtoR (s->value, XmSTRING_DEFAULT_CHARSET, &str);
@@ -78,8 +79,8 @@ opensls_cb (Widget w, XtPointer client, XtPointer call)
 	XtFree (str);
 	base = basenm(filename);
 
-	fp = fopen (filename, "r");
-	if (!fp) {
+	memset ((void *)&slsmap, 0, sizeof(slsmap));
+	if (slsOpen (filename, &slsmap) < 0) {
 	    msg ("%s: %s", base, strerror(errno));
 	    return;
 	}
@@ -89,10 +90,11 @@ opensls_cb (Widget w, XtPointer client, XtPointer call)
 	nowscan = now;
 	newobs = 0;
 	nnewobs = 0;
-	while (readNextSLS (fp, sp, NULL) == 0) {
+	for (i = 0; i < slsmap.nscans; i++) {
 	    double lststart;
 	    Obs *op;
 
+	    *sp = slsmap.scans[i];
 	    newobs = (Obs*)XtRealloc((char *)newobs, (nnewobs+1)*(sizeof(Obs)));
 	    op = &newobs[nnewobs++];
 	    initObs (op);
@@ -115,7 +117,7 @@ opensls_cb (Widget w, XtPointer client, XtPointer call)
 	    }
 	}
 
-	fclose (fp);
+	slsClose (&slsmap);
 
 	if (nnewobs > 0)
 	    addSchedEntries (newobs, nnewobs);
@@ -44,6 +44,8 @@
 #include "xtools.h"
 #include "misc.h"
 #include "scan.h"
+#include "viscache.h"
+#include "horizon.h"
 
 #include "telsched.h"
 
@@ -175,6 +177,9 @@ static int slopi = -1;	/* index into workop[] that is in first slod row */
 static Obs *workop;	/* malloced list of Obs in the scrolled list */
 static int nworkop;	/* number of Obs in workop[] */
 static double mjddawn, mjddusk; /* mjd of dawn and dusk today */
+static VisCache *vcp;		/* when things are up tonight, if any */
+static char viscache[] = "archive/telsched.vis";
+static char hznfn[1024];	/* horizon profile in use, else "" */
 
 /* constants for mb_cb() */
 enum {
@@ -439,8 +444,82 @@ Obs *op;
 	    n.n_mjd = mjd_day(n.n_mjd) + op->utcstart/24.0;
 	(void) obj_cir (&n, &sp->obj);
 
-	/* can always compute today's rise/set */
-	riset_cir (&n, &sp->obj, -MINALT, &op->rs);
+	/* can always compute today's rise/set, from the cache if today.
+	 * the cache file is written by the next computeAllCir(), new night
+	 * or quit, not for each one.
+	 */
+	if (vcp && mjd_day(n.n_mjd - n.n_tz/24.0) ==
+					mjd_day(now.n_mjd - now.n_tz/24.0)) {
+	    Obj *objp = &sp->obj;
+	    VisWin w;
+
+	    vc_get (vcp, &now, &objp, 1, &w, 1);
+	    op->rs = w.rs;
+	    op->visup = w.up;
+	    op->visdown = w.down;
+	} else {
+	    riset_cir (&n, &sp->obj, -MINALT, &op->rs);
+	    op->visup = op->visdown = NOTIME;
+	}
+}
+
+/* same as computeCir() for each of nop Obs at op, but with all the
+ * rise/set work for today done together, and kept in the cache for next time.
+ */
+void
+computeAllCir (op, nop)
+Obs *op;
+int nop;
+{
+	double today = mjd_day(now.n_mjd - now.n_tz/24.0);
+	Obj **objs = (Obj **) malloc (nop*sizeof(Obj *) + 1);
+	VisWin *wins = (VisWin *) malloc (nop*sizeof(VisWin) + 1);
+	int *which = (int *) malloc (nop*sizeof(int) + 1);
+	int nb = 0;
+	int i;
+
+	if (!vcp || !objs || !wins || !which) {
+	    for (i = 0; i < nop; i++)
+		computeCir (&op[i]);
+	    goto out;
+	}
+
+	for (i = 0; i < nop; i++) {
+	    Scan *sp = &op[i].scan;
+	    Now n = now;
+
+	    if (sp->ccdcalib.data == CD_NONE)
+		continue;
+
+	    if (op[i].utcstart != NOTIME)
+		n.n_mjd = mjd_day(n.n_mjd) + op[i].utcstart/24.0;
+	    (void) obj_cir (&n, &sp->obj);
+
+	    /* batch all those whose rise/set day is today, as usual */
+	    if (mjd_day(n.n_mjd - n.n_tz/24.0) == today) {
+		objs[nb] = &sp->obj;
+		which[nb++] = i;
+	    } else {
+		riset_cir (&n, &sp->obj, -MINALT, &op[i].rs);
+		op[i].visup = op[i].visdown = NOTIME;
+	    }
+	}
+
+	vc_get (vcp, &now, objs, nb, wins, 0);
+	for (i = 0; i < nb; i++) {
+	    op[which[i]].rs = wins[i].rs;
+	    op[which[i]].visup = wins[i].up;
+	    op[which[i]].visdown = wins[i].down;
+	}
+	(void) vc_save (vcp);
+
+    out:
+	if (objs)
+	    free ((void *)objs);
+	if (wins)
+	    free ((void *)wins);
+	if (which)
+	    free ((void *)which);
 }
 
 static void
@@ -914,6 +993,12 @@ init_cfg()
 	now.n_tz = -floor(radhr(now.n_lng) + .5);	/* TODO: ok guess? */
 	wlprintf (ban_w, "%s", BANNER);
 
+	/* local horizon profile, if any */
+	if (hznCfg (telschedcfg, hznfn, buf) < 0) {
+	    fprintf (stderr, "%s\n", buf);
+	    exit (1);
+	}
+
 	/* read camera.cfg */
 	n = readCfgFile (1, cameracfg, ccfg, NCCFG);
 	if (n != NCCFG) {
@@ -984,6 +1069,8 @@ quit_cb (Widget w, XtPointer client, XtPointer call)
 	}
 
 	if ((int)client == 1) {
+	    if (vcp)
+		(void) vc_save (vcp);
 	    XtCloseDisplay (XtDisplay(w));
 	    exit(0);
 	} else
@@ -1349,6 +1436,10 @@ Obs *op;
 		ACPYZ (op->yoff, "Below MINALT limit");
 		return(0);
 	    }
+	    if (alt < hznAlt (objp->s_az)) {
+		ACPYZ (op->yoff, "Below horizon");
+		return(0);
+	    }
 	    if (!IGSUN && !at_night (op->utcstart)) {
 		ACPYZ (op->yoff, "Not night then");
 		return(0);
@@ -1360,6 +1451,10 @@ Obs *op;
 		ACPYZ (op->yoff, "Never up");
 		return (0);
 	    }
+	    if (op->visup == 0) {
+		ACPYZ (op->yoff, "Never up tonight");
+		return (0);
+	    }
 	}
 
 	/* evidently ok */
@@ -1670,10 +1765,9 @@ XtPointer call;
 	watch_cursor(1);
 	
 	/* make sure all info is current before printing anything */
-	for (i = 0; i < nworkop; i++) {
-	    computeCir (&workop[i]);
+	computeAllCir (workop, nworkop);
+	for (i = 0; i < nworkop; i++)
 	    workop[i].elig = eligible(&workop[i]) ? 1 : 0;
-	}
 
 	/* listfn_w has the listing filename */
 	filename = XmTextFieldGetString (listfn_w);
@@ -1741,6 +1835,7 @@ set_newdate(Mjd)
 double Mjd;
 {
 	char buf[64], buf1[64];
+	char fn[1024];
 	int rsstatus;
 
 	now.n_mjd = Mjd;
@@ -1758,6 +1853,15 @@ double Mjd;
 	mjddawn = floor(mjddawn*24.*60. + .5)/(24.*60.);
 	mjddusk = floor(mjddusk*24.*60. + .5)/(24.*60.);
 
+	/* start the visibility cache for the new night */
+	if (vcp) {
+	    (void) vc_save (vcp);
+	    vc_close (vcp);
+	}
+	telfixpath (fn, viscache);
+	vcp = vc_open (fn, &now, mjddusk, mjddawn, MINALT,
+				hznHave() ? hznAlt : NULL, hznfn);
+
 	fs_sexa (buf, mjd_hr(mjddawn), 2, 60);
 	fs_date (buf1, mjd_day(mjddawn));
 	wlprintf (dawn_w, "%s %s", buf, buf1);
@@ -1775,10 +1879,11 @@ setElig(int start)
 	int i;
 
 	/* compute circumstances so we can set elig, unless already off */
+	if (start < nworkop)
+	    computeAllCir (&workop[start], nworkop - start);
 	for (i = start; i < nworkop; i++) {
 	    Obs *op = &workop[i];
 	    if (!op->off) {
-		computeCir (op);
 		op->elig = eligible(op);	/* sets op->yoff if returns 0 */
 		if (!op->elig)
 		    op->off = 1;
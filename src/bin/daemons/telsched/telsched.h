@@ -11,6 +11,9 @@ typedef struct {
     double lststart;	/* LSTSTART, hrs; NOTIME if don't care */
     char date[11];	/* mm/dd/yyyy UT date to run, or "" */
     RiseSet rs;		/* rise/set info */
+    double visup, visdown;	/* first and last mjd up tonight, 0 if never
+				 * up, NOTIME if not known
+				 */
     double utcstart;	/* utc when this run should start, else NOTIME
 			 * if don't care. this is only set when
 			 * lststart is set or a set of scans is sorted.
@@ -88,6 +91,7 @@ extern int searchCatEntry (Obs *op);
 extern int wantinsls (Obs *op);
 extern void addSchedEntries (Obs *newobs, int nnewobs);
 extern void computeCir (Obs *op);
+extern void computeAllCir (Obs *op, int nop);
 extern void cpyObs (Obs *dst, Obs *src);
 extern void dawnduskToday (double *mjddawnp, double *mjdduskp);
 extern void deleteAllSchedEntries (void);
@@ -12,6 +12,7 @@
 #include <fcntl.h>
 #include <string.h>
 #include <errno.h>
+#include <signal.h>
 #include <termios.h>
 #include <limits.h>
 #include <time.h>
@@ -32,12 +33,14 @@
 #include "astro.h"
 #include "circum.h"
 #include "telstatshm.h"
+#include "cliserv.h"
 #include "telenv.h"
 #include "running.h"
 #include "strops.h"
 #include "misc.h"
 #include "tts.h"
 #include "configfile.h"
+#include "tseries.h"
 
 #include "dd.h"
 
@@ -63,6 +66,9 @@ static int Rflag;
 static int sflag;
 static int vflag;
 static char *logfile;
+static char *tsdir;
+static TSWriter *tswp;
+static volatile sig_atomic_t quit;
 
 static TelStatShm *telstatshmp;
 
@@ -74,6 +80,9 @@ static void dispense (WxStats *wp, double t, double p);
 static void initShm(void);
 static void initCfg(void);
 static FILE *openLogFile(void);
+static void initSeries(void);
+static void onSig (int signo);
+static void addSeries (WxStats *wp, double t, double p);
 static void bldWdirstr (WxStats *wp);
 
 static WxStats lastwxs;
@@ -203,6 +212,12 @@ main (int ac, char *av[])
 		    tailfn = *++av;
 		    ac--;
 		    break;
+		case 'T':
+		    if (ac < 2)
+			usage(prog);
+		    tsdir = *++av;
+		    ac--;
+		    break;
 		case 'u':
 		    if (ac < 3)
 			usage(prog);
@@ -261,6 +276,10 @@ main (int ac, char *av[])
 	if (oflag)
 	    (void) alarm (osecs);
 	initCfg();
+	if (tsdir)
+	    initSeries();
+	signal (SIGINT, onSig);
+	signal (SIGTERM, onSig);
 	memset ((void *)&wxs, 0, sizeof(wxs));
 	t = TEMPERATURE;
 	p = PRESSURE;
@@ -276,7 +295,7 @@ main (int ac, char *av[])
 
 	/* forever */
 	if (fflag) {
-	    while (1) {
+	    while (!quit) {
 		fake (fake_readings, &wxs, &t, &p);
 		bldWdirstr (&wxs);
 		/* digitemp(NULL, &wxs); */
@@ -301,7 +320,7 @@ main (int ac, char *av[])
 	    } else
 		uf = NULL;
 		
-	    while (1) {
+	    while (!quit) {
 		s = -1;
 		if(Rflag) {
 			if(telserverUpdate(&wxs, &t, &p) < 0) break;
@@ -326,7 +345,16 @@ main (int ac, char *av[])
 		    dispense (&wxs, t, p);
 		sleep (LOOPDELAY);
 	    }
-	    daemonLog ("EOF from %s", prog);
+	    if (!quit)
+		daemonLog ("EOF from %s", prog);
+	}
+
+	/* seal the open series block so a restart does not lose it */
+	tsClose (tswp);
+	if (quit) {
+	    daemonLog ("Exiting on signal %d\n", (int)quit);
+	    unlock_running (prog, 0);
+	    return (0);
 	}
 
 	/* we should never die */
@@ -355,6 +383,7 @@ usage (char *progname)
 	fprintf(fp, " -R <host:port> : connect to telserver at host:port for remotely shared WX data\n");
 	fprintf(fp, " -s     : update telstatshm\n");
 	fprintf(fp, " -t f   : do not use real hw, tail last line of log file f for new values\n");
+	fprintf(fp, " -T d   : also store every reading in time series directory d, see tsq\n");
 	fprintf(fp, " -u o t : store data in file o from template file t.\n");
 	fprintf(fp, " -w t   : alternate wx tty. default is in %s\n", basenm(wcfn_def));
 	fprintf(fp, " -x t   : alternate aux tty. default is in %s\n", basenm(wcfn));
@@ -395,6 +424,9 @@ initShm()
 	}
 
 	telstatshmp = (TelStatShm *) addr;
+
+	/* keep to its clock, simulated or real */
+	simclock_attach (&telstatshmp->simclock);
 }
 
 /* create fake settings from buf
@@ -599,16 +631,23 @@ dispense (WxStats *wp, double t, double p)
 	    }
 	}
 
+	/* every reading goes to the time series, if any */
+	if (tswp)
+	    addSeries (wp, t, p);
+
 	if (sflag) {
 	    /* advertise fresh stuff in shared mem */
-	    wp->updtime = time(NULL);
+	    wp->updtime = time_now();
 	    telstatshmp->now.n_temp = t;
 	    telstatshmp->now.n_pressure = p;
 	    telstatshmp->wxs = *wp;
+	    telshm_changed (telstatshmp, TSG_BIT(TSG_WX));
 	}
 
-	if (oflag)
+	if (oflag) {
+	    tsClose (tswp);
 	    exit(0);
+	}
 
 	if (utemplate)
 	    createPage (utemplate, uoutput, wp, t, p);
@@ -687,6 +726,52 @@ openLogFile()
 	return (logfp);
 }
 
+/* just note the signal; main's loop sees it and shuts down cleanly */
+static void
+onSig (int signo)
+{
+	quit = signo;
+}
+
+/* open the time series store at tsdir, or carry on without */
+static void
+initSeries()
+{
+	static char *cols[] = {
+	    "wspeed", "wdir", "temp", "humidity", "pressure", "rain", "alert",
+	    "aux0", "aux1", "aux2",
+	};
+	char msg[1024];
+
+	tswp = tsOpen (tsdir, cols, sizeof(cols)/sizeof(cols[0]), msg);
+	if (!tswp)
+	    daemonLog ("%s\n", msg);
+}
+
+/* add the reading in wp, t and p to the time series.
+ * N.B. must be same order as cols[] in initSeries()
+ */
+static void
+addSeries (WxStats *wp, double t, double p)
+{
+	double v[10];
+	char msg[1024];
+
+	v[0] = wp->wspeed;
+	v[1] = wp->wdir;
+	v[2] = t;
+	v[3] = wp->humidity;
+	v[4] = p;
+	v[5] = wp->rain/10.;
+	v[6] = wp->alert;
+	v[7] = (wp->auxtmask&0x1) ? wp->auxt[0] : NAN;
+	v[8] = (wp->auxtmask&0x2) ? wp->auxt[1] : NAN;
+	v[9] = (wp->auxtmask&0x4) ? wp->auxt[2] : NAN;
+
+	if (tsAppend (tswp, secs_now(), v, msg) < 0)
+	    daemonLog ("%s\n", msg);
+}
+
 static void
 bldWdirstr (WxStats *wp)
 {
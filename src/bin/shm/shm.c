@@ -493,6 +493,10 @@ fillSI()
 	    buf3[0] = '\0';
 	wprintf (" Camera : Temp = %s Targ = %3dC  %s %s", buf2,
 					    telstatshmp->camtarg, buf1, buf3);
+	if (!testlock_running ("ppd"))
+	    wprintf ("   Post : %d waiting, %d busy, %d done, %d failed",
+				telstatshmp->ppqueued, telstatshmp->ppbusy,
+				telstatshmp->ppdone, telstatshmp->ppfailed);
 
 	/* current work queue, if desired */
 	if (want_queue)
@@ -160,14 +160,15 @@ chk_fifos()
  * future. this can be used by any program which does not want to be
  * subject to the polling latency.
  * N.B. a previous trigger is lost.
+ * N.B. t is on the simulated clock if in effect; the alarm is real time.
  */
 void
 setTrigger (time_t t)
 {
-	time_t tnow = time(NULL);
+	time_t tnow = time_now();
 
 	if (t > tnow)
-	    alarm (t - tnow);
+	    alarm ((unsigned) ceil (real_secs (t - tnow)));
 }
 
 /* shut down all activity */
@@ -20,6 +20,7 @@
 #include "telrun.h"
 
 static struct stat last_s;	/* last-known .sls file stat */
+static SLSMap slsmap;		/* the .sls, compiled */
 
 /* check whether the named file is materially different than last we knew.
  * if different return 0 else return -1
@@ -51,58 +52,56 @@ newSLS (char *slsfn)
 void
 markScan (char slsfn[], Scan *sp, int code)
 {
-	long offset;
-	FILE *fp;
 	Scan s;
+	int i;
 
-	fp = telfopen (slsfn, "r+");
-	if (!fp)
+	rep_mark (sp, code);
+
+	if (slsOpen (slsfn, &slsmap) < 0)
 	    return;
 
-	while (readNextSLS (fp, &s, &offset) == 0) {
+	for (i = 0; i < slsmap.nscans; i++) {
 	    /* never remark (in case several match) */
-	    if (s.status != 'N')
+	    if (slsmap.status[i] != 'N')
 		continue;
 
 	    /* force a match for and hence ignore fields we might change */
+	    s = slsmap.scans[i];
 	    s.running = sp->running;
 	    s.starttm = sp->starttm;
 	    s.status = sp->status;
 	    s.shutter = sp->shutter;
 	    if (memcmp ((void *)&s, (void *)sp, sizeof(Scan)) == 0) {
-		fseek (fp, offset, 0);
-		fputc (code, fp);
-		fflush (fp);
-		if (fstat (fileno(fp), &last_s) < 0)
-		    memset ((void *)&last_s, 0, sizeof(s));
+		if (slsMark (&slsmap, i, code) < 0
+				    || stat (slsmap.slsfn, &last_s) < 0)
+		    memset ((void *)&last_s, 0, sizeof(last_s));
+		rp_mark (i, code);
 		break;
 	    }
 	}
-
-	(void) fclose (fp);
 }
 
-/* find the first entry in slsfn marked New.
+/* find the first entry in slsfn marked New, or what to run instead of it if
+ * replanning.
  * if find such return it at *sp and return 0, else return -1.
  */
 int
 findNew (char slsfn[], Scan *sp)
 {
-	int found;
-	FILE *fp;
-
-	found = 0;
-	fp = telfopen (slsfn, "r");
-	if (fp) {
-	    while (readNextSLS (fp, sp, NULL) == 0) {
-		if (sp->status == 'N') {
-		    found = 1;
-		    break;
-		}
+	int i;
+
+	if (slsOpen (slsfn, &slsmap) < 0)
+	    return (-1);
+
+	for (i = 0; i < slsmap.nscans; i++) {
+	    if (slsmap.status[i] == 'N') {
+		if (replanning)
+		    return (rp_pick (&slsmap, i, sp));
+		*sp = slsmap.scans[i];
+		return (0);
 	    }
-	    (void) fclose (fp);
 	}
 
-	return (found ? 0 : -1);
+	return (-1);
 }
 
@@ -69,7 +69,7 @@ pr_bias (int first)
 	}
 
 	/* run this step, next is its return, done when NULL */
-	step = step ? (*(void *(*)())step)(time(NULL)) : NULL;
+	step = step ? (*(void *(*)())step)(time_now()) : NULL;
 	return (step ? 0 : -1);
 }
 
@@ -102,6 +102,8 @@ ps_wait4Start(time_t n)
 	}		
 	
 	/* go! */
+	rep_setup (sp, n);
+	rep_start (n);
 
 	/* only publish if there is no real data to be taken later */
 	if (!takedata) {
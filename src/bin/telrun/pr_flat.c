@@ -75,7 +75,7 @@ pr_flat (int first)
 	}
 
 	/* run this step, next is its return, done when NULL */
-	step = step ? (*(void *(*)())step)(time(NULL)) : NULL;
+	step = step ? (*(void *(*)())step)(time_now()) : NULL;
 	return (step ? 0 : -1);
 }
 
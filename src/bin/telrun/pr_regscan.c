@@ -8,6 +8,8 @@
 #include <string.h>
 #include <math.h>
 #include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "P_.h"
 #include "astro.h"
@@ -20,9 +22,11 @@
 
 static int pr_startPP (int first);
 static int postProcess(void);
+static int ppdRequest(Scan *sp);
 static void logStart(time_t n);
 
 static char pplog[] = "archive/logs/postprocess.log";	/* pp log file */
+static char ppfifo[] = "comm/PostProcess.in";		/* ppd requests */
 
 static time_t tmpTime;		/* used to save times from one step to next */
 static Scan bkg_scan;		/* used for background program */
@@ -53,7 +57,7 @@ pr_regscan (int first)
 	}
 
 	/* run this step, next is its return */
-	step = step ? (*(void *(*)())step)(time(NULL)) : NULL;
+	step = step ? (*(void *(*)())step)(time_now()) : NULL;
 
 	if (!step) {
 	    cscan->running = 0;
@@ -163,6 +167,7 @@ ps_wait4Start(time_t n)
 	/* go! */
 	strcpy (buf, timestamp(sp->starttm));	/* save from tlog */
 	tlog (sp, "Checking scan setup.. scheduled at %s", buf);
+	rep_setup (sp, n);
 	pr_regSetup();
 
 	/* set a trigger for the start time */
@@ -193,6 +198,8 @@ ps_wait4Setup(time_t n)
     }
 
     allok = camok && telok && filok && focok && domok;
+	if (allok)
+	    rep_ready (n);
 
 	/* trouble if not finished within SETUP */
 	if (!allok && n > tmpTime) {
@@ -222,6 +229,7 @@ ps_wait4Setup(time_t n)
 
 	/* publish */
 	logStart(n);
+	rep_start (n);
 	sp->starttm = n;		/* real start time */
 	sp->running = 1;		/* we are under way */
 
@@ -315,7 +323,7 @@ pr_startPP (int first)
 	    break;
 
 	case CAM_READ:
-	    if (time(NULL) < tmpTime)
+	    if (time_now() < tmpTime)
 		return (0);	/* stay in program q */
 	    tlog (sp, "Camera READING too long");
 	    break;
@@ -330,6 +338,8 @@ pr_startPP (int first)
 /* helper funcs */
 
 /* start the post-processing work for bkg_scan.
+ * hand it to ppd if it is running and keeping up, unless compression is
+ * wanted, which it does not do; else start a postprocess script.
  * return 0 if gets off to a good start, else -1.
  */
 static int
@@ -340,6 +350,12 @@ postProcess ()
 	char pp[1024];
 	int s;
 
+	if (!sp->compress && ppdRequest (sp) == 0) {
+	    tlog (sp, "Queued %s for ppd cor=%d", sp->imagefn,
+					    sp->ccdcalib.data == CD_COOKED);
+	    return (0);
+	}
+
 	telfixpath (pp, pplog);
 	tlog (sp, "Starting postprocess %s cor=%d scale=%d", sp->imagefn, 
 			    sp->ccdcalib.data == CD_COOKED, sp->compress);
@@ -353,6 +369,29 @@ postProcess ()
 	return (0);
 }
 
+/* send the request for sp's image to ppd.
+ * the fifo is opened without waiting so we learn at once if ppd is not
+ * reading it, or is so far behind it is full.
+ * return 0 if sent, else -1.
+ */
+static int
+ppdRequest (Scan *sp)
+{
+	char fn[1024];
+	char buf[2048];
+	int fd, n, s;
+
+	telfixpath (fn, ppfifo);
+	fd = open (fn, O_WRONLY|O_NONBLOCK);
+	if (fd < 0)
+	    return (-1);	/* ENXIO when ppd is not running */
+	n = sprintf (buf, "%s/%s %d\n", sp->imagedn, sp->imagefn,
+					    sp->ccdcalib.data == CD_COOKED);
+	s = write (fd, buf, n);	/* all or nothing up to PIPE_BUF */
+	(void) close (fd);
+	return (s == n ? 0 : -1);
+}
+
 /* log all the starting telescope particulars */
 static void
 logStart(time_t n)
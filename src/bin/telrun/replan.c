@@ -0,0 +1,366 @@
+/* pick which scan to run next once the night has gone astray, for telrun -r.
+ *
+ * telrun runs the .sls in file order, and a scan whose start window has gone
+ * by, as after a weather alert or a scan which ran long, fails. with -r, each
+ * time telrun is free the first New scan which can still start in its window
+ * keeps its time, but any gap before it is filled first: with a scan whose
+ * window has gone by if one can be done and still leave time to get to it,
+ * else with a later one moved up. if none can start in time the best of those
+ * whose window has gone by runs now. the picking is by ns_next(), see nightsched.c, from
+ * where the scope is now, with visibility worked out once per night, allowing
+ * for the horizon profile if telsched.cfg names one. scans up wind are passed
+ * over while the wind is high.
+ *
+ * only regular scans are moved; calibrations and the like keep their place.
+ * how the time goes compared with strict order is logged as it happens and
+ * summed up by rp_print().
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <time.h>
+
+#include "P_.h"
+#include "astro.h"
+#include "circum.h"
+#include "configfile.h"
+#include "telenv.h"
+#include "telstatshm.h"
+#include "scan.h"
+#include "nightsched.h"
+#include "horizon.h"
+
+#include "telrun.h"
+
+#define	RP_MARGIN	30		/* secs to spare before a kept start */
+#define	RP_WIND		40		/* kph above which to avoid up wind */
+#define	RP_WINDW	degrad(45)	/* that far either side of up wind */
+#define	RP_DOMEVEL	degrad(3)	/* dome rotation rate, rads/sec */
+#define	RP_SETTLE	5		/* secs for the mount to settle */
+
+int replanning;			/* set by -r */
+
+static double SUNDOWN, MINALT, MAXALT, MAXHA, MAXDEC;
+
+/* the night planned for, built from the .sls on first use */
+static NSNight *nnp;		/* the engine */
+static NSJob *jobs;		/* one per scan in the .sls */
+static char *skip;		/* scratch, one per scan */
+static int njobs;		/* scans in the .sls */
+static NSSite site;		/* the night and how fast things move */
+
+/* the last pick */
+typedef enum {
+    RP_STRICT, RP_LATE, RP_MOVED
+} PickKind;
+static PickKind pickkind;	/* how the scan at pickidx was picked */
+static int pickidx = -1;	/* scan picked, -1 once marked */
+static int owed = -1;		/* scan kept to its time after a gap, if any */
+
+/* totals since last rp_print() */
+static int nlate, nmoved, nlost;
+static double late, moved, lost;	/* secs of exposure in each */
+
+static int build (SLSMap *mp);
+static void night (Now *np, double *duskp, double *dawnp);
+static int regular (Scan *sp);
+static time_t deadline (Scan *sp);
+static double t2mjd (time_t t);
+
+/* read the limits and any horizon profile from telsched.cfg.
+ * exit if any trouble.
+ */
+void
+rp_init()
+{
+#define	NRCFG	(sizeof(rcfg)/sizeof(rcfg[0]))
+	static CfgEntry rcfg[] = {
+	    {"SUNDOWN",		CFG_DBL, &SUNDOWN},
+	    {"MINALT",		CFG_DBL, &MINALT},
+	    {"MAXALT",		CFG_DBL, &MAXALT},
+	    {"MAXHA",		CFG_DBL, &MAXHA},
+	    {"MAXDEC",		CFG_DBL, &MAXDEC},
+	};
+	char fn[1024], msg[1024];
+	int n;
+
+	n = readCfgFile (1, tcfn, rcfg, NRCFG);
+	if (n != NRCFG) {
+	    cfgFileError (tcfn, n, NULL, rcfg, NRCFG);
+	    exit(1);
+	}
+	if (hznCfg (tcfn, fn, msg) < 0) {
+	    daemonLog ("%s\n", msg);
+	    exit(1);
+	}
+}
+
+/* forget the night planned for, as when the .sls changes */
+void
+rp_reset()
+{
+	if (nnp)
+	    ns_close (nnp);
+	if (jobs)
+	    free ((void *)jobs);
+	if (skip)
+	    free ((void *)skip);
+	nnp = NULL;
+	jobs = NULL;
+	skip = NULL;
+	njobs = 0;
+	pickidx = owed = -1;
+}
+
+/* scan first in mp is the first marked New: put the one to run next in *sp,
+ * with its start time if moved.
+ * always return 0, as findNew().
+ */
+int
+rp_pick (SLSMap *mp, int first, Scan *sp)
+{
+	TelStatShm *tsp = telstatshmp;
+	time_t tnow = time_now();
+	double now = t2mjd (tnow), start;
+	char buf[64];
+	NSHere here;
+	int i, j, next, wxvalid;
+
+	if (!nnp || njobs != mp->nscans || now >= site.dawn)
+	    (void) build (mp);
+
+	*sp = mp->scans[first];
+	pickkind = RP_STRICT;
+	pickidx = first;
+	if (!nnp)
+	    return (0);
+	if (now < site.dusk || now >= site.dawn)
+	    return (0);
+
+	/* did the last gap cost the scan after it its time */
+	if (owed >= 0 && mp->status[owed] == 'N'
+				    && deadline (&mp->scans[owed]) < tnow) {
+	    nlost++;
+	    lost += mp->scans[owed].dur;
+	    tlog (&mp->scans[owed], "Re-planning lost %g secs: now too late",
+						    mp->scans[owed].dur);
+	}
+	owed = -1;
+
+	/* the first which can still start in its window, as strict order would */
+	for (next = first; next < mp->nscans; next++)
+	    if (mp->status[next] == 'N' && deadline (&mp->scans[next]) >= tnow)
+		break;
+	if (next == mp->nscans)
+	    next = -1;
+
+	here.now = now;
+	here.ha = tsp->CAHA;
+	here.dec = tsp->CADec;
+	here.filter = isalpha(tsp->filter) ? tsp->filter : 0;
+	here.by = next < 0 ? 0 : t2mjd (mp->scans[next].starttm - RP_MARGIN);
+	here.then = next;
+	wxvalid = real_secs(tnow - tsp->wxs.updtime) < 30;
+	if (wxvalid && tsp->wxs.wspeed >= RP_WIND) {
+	    here.avoidaz = degrad(tsp->wxs.wdir);
+	    here.avoidw = RP_WINDW;
+	} else
+	    here.avoidaz = here.avoidw = 0;
+
+	/* first those whose time has gone by, then any */
+	for (i = 0; i < njobs; i++)
+	    skip[i] = mp->status[i] != 'N' || !regular (&mp->scans[i])
+					    || deadline (&mp->scans[i]) >= tnow;
+	j = ns_next (nnp, &here, skip, &start);
+	if (j >= 0)
+	    pickkind = RP_LATE;
+	else {
+	    for (i = 0; i < njobs; i++)
+		skip[i] = mp->status[i] != 'N' || !regular (&mp->scans[i]);
+	    j = ns_next (nnp, &here, skip, &start);
+	    if (j >= 0)
+		pickkind = RP_MOVED;
+	}
+
+	if (j < 0) {
+	    /* nothing better: the next on time, else let strict order fail */
+	    if (next >= 0) {
+		*sp = mp->scans[next];
+		pickidx = next;
+	    }
+	    return (0);
+	}
+
+	*sp = mp->scans[j];
+	sp->starttm = (time_t)ceil((start - 25567.5)*SPD);
+	pickidx = j;
+	owed = next;
+	strcpy (buf, next < 0 ? "dawn" : timestamp(mp->scans[next].starttm));
+	if (pickkind == RP_LATE)
+	    tlog (sp, "Re-planned: %.1f mins after its time, done before %s",
+			(sp->starttm - mp->scans[j].starttm)/60., buf);
+	else
+	    tlog (sp, "Re-planned: %.1f mins before its time, done before %s",
+			(mp->scans[j].starttm - sp->starttm)/60., buf);
+	return (0);
+}
+
+/* scan i in the .sls has been marked with code */
+void
+rp_mark (int i, int code)
+{
+	if (i != pickidx)
+	    return;
+	if (code == 'D' && njobs > i) {
+	    if (pickkind == RP_LATE) {
+		nlate++;
+		late += jobs[i].dur;
+	    } else if (pickkind == RP_MOVED) {
+		nmoved++;
+		moved += jobs[i].dur;
+	    }
+	}
+	pickidx = -1;
+}
+
+/* log how re-planning has gone since the last time, if it did anything */
+void
+rp_print()
+{
+	if (nlate + nmoved + nlost == 0)
+	    return;
+
+	tlog (NULL, "Re-planning against strict order: %d scans recovered, %.2f hrs; %d moved up, %.2f hrs; %d lost, %.2f hrs",
+		    nlate, late/3600., nmoved, moved/3600., nlost, lost/3600.);
+
+	nlate = nmoved = nlost = 0;
+	late = moved = lost = 0;
+}
+
+/* set up nnp for the scans in mp, for the night now or next.
+ * return 0 if ok, else -1.
+ */
+static int
+build (SLSMap *mp)
+{
+	TelStatShm *tsp = telstatshmp;
+	Now n = tsp->now, *np = &n;
+	char buf[64];
+	double t0;
+	int i;
+
+	rp_reset();
+	t0 = secs_now();
+	jobs = (NSJob *) calloc (mp->nscans+1, sizeof(NSJob));
+	skip = (char *) calloc (mp->nscans+1, 1);
+	if (!jobs || !skip) {
+	    tlog (NULL, "Re-planning: no memory for %d scans", mp->nscans);
+	    rp_reset();
+	    return (-1);
+	}
+	njobs = mp->nscans;
+
+	memset ((void *)&site, 0, sizeof(site));
+	mjd = t2mjd (time_now());
+	night (np, &site.dusk, &site.dawn);
+	site.sitelat = lat;
+	site.sitelng = lng;
+	site.minalt = MINALT;
+	site.maxalt = MAXALT;
+	site.maxha = MAXHA;
+	site.maxdec = MAXDEC;
+	site.hvel = tsp->minfo[TEL_HM].maxvel;
+	site.hacc = tsp->minfo[TEL_HM].maxacc;
+	site.dvel = tsp->minfo[TEL_DM].maxvel;
+	site.dacc = tsp->minfo[TEL_DM].maxacc;
+	site.domevel = tsp->domestate != DS_ABSENT ? RP_DOMEVEL : 0;
+	if (tsp->minfo[TEL_IM].have && tsp->minfo[TEL_IM].maxvel > 0)
+	    site.filtsecs = PI/tsp->minfo[TEL_IM].maxvel;	/* half a turn */
+	site.settle = RP_SETTLE;
+	site.setup = SETUP_TO;
+	site.readout = CAMDIG_MAX;
+	site.ha0 = tsp->CAHA;
+	site.dec0 = tsp->CADec;
+
+	/* places at mid night are close enough */
+	mjd = (site.dusk + site.dawn)/2;
+	epoch = EOD;
+	for (i = 0; i < njobs; i++) {
+	    Scan s = mp->scans[i];
+	    NSJob *jp = &jobs[i];
+
+	    (void) obj_cir (np, &s.obj);
+	    jp->ra = s.obj.s_ra;
+	    jp->dec = s.obj.s_dec;
+	    if (regular (&s)) {
+		jp->ra += s.rao;
+		jp->dec += s.deco;
+	    } else
+		jp->cal = 1;
+	    jp->dur = s.dur;
+	    jp->filter = s.filter;
+	    jp->priority = s.priority;
+	}
+
+	nnp = ns_open (&site, jobs, njobs);
+	if (!nnp) {
+	    tlog (NULL, "Re-planning: no memory for %d scans", njobs);
+	    rp_reset();
+	    return (-1);
+	}
+
+	strcpy (buf, timestamp ((time_t)((site.dusk - 25567.5)*SPD)));
+	tlog (NULL, "Re-planning %d scans for the night from %s, in %.0f ms",
+				    njobs, buf, 1e3*(secs_now() - t0));
+	return (0);
+}
+
+/* find the dusk and dawn of the night np->n_mjd is in, else the next */
+static void
+night (Now *np, double *duskp, double *dawnp)
+{
+	Now day = *np;
+	int status, d;
+
+	day.n_mjd = mjd_day(np->n_mjd) - 1;
+	for (d = 0; d < 3; d++, day.n_mjd += 1) {
+	    double dawn, dusk;
+
+	    twilight_cir (&day, SUNDOWN, &dawn, &dusk, &status);
+	    if (dawn < dusk) {
+		Now tomorrow = day;
+		double tmp;
+
+		tomorrow.n_mjd += 1;
+		twilight_cir (&tomorrow, SUNDOWN, &dawn, &tmp, &status);
+	    }
+	    *duskp = dusk;
+	    *dawnp = dawn;
+	    if (np->n_mjd < dawn)
+		break;
+	}
+}
+
+/* whether sp is a plain scan of the sky, which may be moved */
+static int
+regular (Scan *sp)
+{
+	return (sp->ccdcalib.new == CT_NONE && sp->ccdcalib.data != CD_NONE);
+}
+
+/* last time sp may start, as ps_wait4Start() allows */
+static time_t
+deadline (Scan *sp)
+{
+	return (sp->starttm + sp->startdt);
+}
+
+/* t as an mjd */
+static double
+t2mjd (time_t t)
+{
+	return (25567.5 + t/SPD);
+}
@@ -0,0 +1,170 @@
+/* keep account of how the time goes while running a schedule, and report it
+ * once the schedule runs dry. most useful when replaying a schedule on the
+ * simulated clock, see simclock.c.
+ *
+ * each scan goes from setup, when the scope and friends are told where to
+ * go, to ready, when they all are, to start, when the camera is, to its end.
+ * setup to ready is slew, ready to start is waiting for the scheduled time,
+ * start to end is exposing, and any time not in a scan is idle. slack is how
+ * long before its scheduled time a scan was ready; it is negative if late.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "P_.h"
+#include "astro.h"
+#include "circum.h"
+#include "telstatshm.h"
+#include "scan.h"
+
+#include "telrun.h"
+
+/* the scan under way, if any */
+static int inscan;		/* set while a scan is between setup and end */
+static time_t tsetup, tready, tstart;
+static time_t tsched;		/* its scheduled start */
+
+/* totals since last report */
+static int ndone, nfailed, nmissed;
+static int nlate;		/* started after their scheduled time */
+static time_t tfirst, tlast;	/* first setup and last end */
+static double slew, waiting, expose;	/* total secs in each */
+static double maxslew;		/* longest slew */
+static double slack, minslack;	/* total and least slack */
+static int nslack;		/* scans in slack */
+
+static void close1 (int ok, time_t t);
+
+/* the devices have been told to get ready for sp at t.
+ * N.B. a scan may be set up again as it goes on from calibration to data.
+ */
+void
+rep_setup (Scan *sp, time_t t)
+{
+	if (inscan)
+	    return;
+	inscan = 1;
+	tsetup = t;
+	tready = tstart = 0;
+	tsched = sp->starttm;
+	if (!tfirst)
+	    tfirst = t;
+}
+
+/* all the devices came ready for the scan under way at t */
+void
+rep_ready (time_t t)
+{
+	if (inscan && !tready)
+	    tready = t;
+}
+
+/* the scan under way really started at t */
+void
+rep_start (time_t t)
+{
+	if (!inscan)
+	    return;
+	if (!tready)
+	    tready = t;
+	tstart = t;
+}
+
+/* sp has been marked with code, one of D(one) or F(ail).
+ * N.B. only scans for cscan count; background marks are later news.
+ */
+void
+rep_mark (Scan *sp, int code)
+{
+	if (sp != cscan)
+	    return;
+	if (inscan)
+	    close1 (code == 'D', time_now());
+	else if (code == 'F')
+	    nmissed++;		/* never got going */
+}
+
+/* everything has been stopped: any scan under way failed */
+void
+rep_abort ()
+{
+	if (inscan)
+	    close1 (0, time_now());
+}
+
+/* log a summary of the time since the last one, if any scans were run */
+void
+rep_print ()
+{
+	double span, idle, speed;
+	int n = ndone + nfailed;
+
+	if (n + nmissed == 0 || inscan)
+	    return;
+
+	span = tlast > tfirst ? (double)(tlast - tfirst) : 0.0;
+	idle = span - slew - waiting - expose;
+	if (idle < 0)
+	    idle = 0;
+	speed = simclock_speed();
+
+	tlog (NULL, "Run report: %d scans, %d done, %d failed, %d missed, over %.2f hrs%s",
+		    n + nmissed, ndone, nfailed, nmissed, span/3600.,
+		    speed != 1.0 ? " on the simulated clock" : "");
+	if (span > 0)
+	    tlog (NULL, "  slew %.2f hrs (%.0f%%), waiting %.2f hrs (%.0f%%), exposing %.2f hrs (%.0f%%), idle %.2f hrs (%.0f%%)",
+		    slew/3600., 100*slew/span, waiting/3600., 100*waiting/span,
+		    expose/3600., 100*expose/span, idle/3600., 100*idle/span);
+	if (n > 0)
+	    tlog (NULL, "  slew mean %.0f secs, longest %.0f secs", slew/n,
+								    maxslew);
+	if (nslack > 0)
+	    tlog (NULL, "  slack mean %.0f secs, least %.0f secs, %d started late",
+				    slack/nslack, minslack, nlate);
+
+	/* start afresh */
+	ndone = nfailed = nmissed = nlate = nslack = 0;
+	tfirst = tlast = 0;
+	slew = waiting = expose = maxslew = slack = minslack = 0;
+}
+
+/* close the scan under way at t, ok or not */
+static void
+close1 (int ok, time_t t)
+{
+	double s;
+
+	inscan = 0;
+	tlast = t;
+	if (ok)
+	    ndone++;
+	else
+	    nfailed++;
+
+	/* a scan which failed during setup only slewed */
+	if (!tready)
+	    tready = t;
+	if (!tstart)
+	    tstart = t;
+
+	s = tready - tsetup;
+	slew += s;
+	if (s > maxslew)
+	    maxslew = s;
+	waiting += tstart - tready;
+	expose += t - tstart;
+
+	if (tsched) {
+	    s = (double)(tsched - tready);
+	    if (nslack == 0 || s < minslack)
+		minslack = s;
+	    slack += s;
+	    nslack++;
+	    if (tstart > tsched)
+		nlate++;
+	}
+}
@@ -82,6 +82,9 @@ char *av[];
     char c;
     while ((c = *++str) != '\0')
       switch (c) {
+      case 'r':
+        replanning = 1;
+        break;
       default:
         usage();
         break;
@@ -109,6 +112,8 @@ char *av[];
   init_telescoped();
   init_camerad();
   init_cfg();
+  if (replanning)
+    rp_init();
   init_fifos();
   init_shm();
   telfixpath(scanfile, scanfile);
@@ -136,8 +141,10 @@ char *av[];
 
   /* go, forever */
   tlog(NULL, "%s start.", progname);
-  while (1)
+  while (1) {
     main_loop();
+    telshm_publish(telstatshmp, TSG_BIT(TSG_SCAN));
+  }
 
   return (1);
 }
@@ -191,6 +198,7 @@ void all_stop(int mark) {
   /* always cancel shm publishing */
   cscan->running = 0;
   cscan->starttm = 0;
+  rep_abort();
 
   resetPrograms();
 }
@@ -245,7 +253,7 @@ void tlog(Scan *sp, char *fmt, ...) {
 
   /* start with time stamp and source name if set */
   l = 0;
-  l = sprintf(buf + l, "%s: ", timestamp(time(NULL)));
+  l = sprintf(buf + l, "%s: ", timestamp(time_now()));
   if (sp && sp->starttm && sp->obj.o_name[0])
     l += sprintf(buf + l, "%s: ", sp->obj.o_name);
 
@@ -272,7 +280,8 @@ void tlog(Scan *sp, char *fmt, ...) {
 }
 
 static void usage() {
-  fprintf(stderr, "%s:\n", progname);
+  fprintf(stderr, "%s: [-r]\n", progname);
+  fprintf(stderr, "  -r: re-plan what to run next when scans fall behind\n");
   exit(1);
 }
 
@@ -392,6 +401,7 @@ static void main_loop() {
   if (newSLS(scanfile) == 0) {
     tlog(cscan, "New %s detected", basenm(scanfile));
     all_stop(0); /* new file -- can't mark */
+    rp_reset();
   }
 
   /* check for more work if nothing queued and stopped */
@@ -404,6 +414,9 @@ static void main_loop() {
         strcpy(buf, timestamp(s.starttm)); /* save from tlog */
         tlog(cscan, "Scheduled at %s", buf);
       }
+    } else {
+      rep_print(); /* schedule has run dry */
+      rp_print();
     }
   }
 
@@ -465,7 +478,7 @@ static void checkSun() {
 /* return -1 if weather alert is in progress, else 0 */
 static int checkWx() {
   static int last_wxalert;
-  int wxvalid = time(NULL) < telstatshmp->wxs.updtime + 30;
+  int wxvalid = real_secs(time_now() - telstatshmp->wxs.updtime) < 30;
   int wxalert = wxvalid && telstatshmp->wxs.alert;
 
   if (wxalert && !last_wxalert)
@@ -15,6 +15,7 @@ typedef int (*PrFunc)(int first);
 
 /* telrun.c */
 #define	cscan	(&telstatshmp->scan)	/* handy access to current scan */
+extern char tcfn[];
 extern char ccfn[];
 extern TelStatShm *telstatshmp;
 extern double SETUP_TO;
@@ -33,6 +34,22 @@ extern void setTrigger (time_t t);
 extern void stop_all_devices(void);
 extern void fifoWrite (int f, char *fmt, ...);
 
+/* report.c */
+extern void rep_setup (Scan *sp, time_t t);
+extern void rep_ready (time_t t);
+extern void rep_start (time_t t);
+extern void rep_mark (Scan *sp, int code);
+extern void rep_abort (void);
+extern void rep_print (void);
+
+/* replan.c */
+extern int replanning;
+extern void rp_init (void);
+extern void rp_reset (void);
+extern int rp_pick (SLSMap *mp, int first, Scan *sp);
+extern void rp_mark (int i, int code);
+extern void rp_print (void);
+
 /* fileio.c */
 extern int newSLS (char scanfn[]);
 extern int findNew (char scanfn[], Scan *sp);
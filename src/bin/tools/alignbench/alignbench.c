@@ -0,0 +1,417 @@
+/* compare phaseAlignFITS() with align2FITS() on images shifted by known
+ * amounts.
+ *
+ * each FITS file given is shifted by each of shifts[], whole and fractional,
+ * near and beyond align2FITS()'s MAXSHIFT, with fresh noise added, and both
+ * aligners are asked to find the shift. then the same on a synthetic star
+ * field larger than align2FITS() can handle at all.
+ * the speed and success rate of each are reported, and a frame shifted by a
+ * fraction of a pixel is stacked back onto its original with alignAddFrac()
+ * and alignAdd() to compare them.
+ * exit 0 if phaseAlignFITS() finds every shift within PCTOL and alignAddFrac()
+ * stacks better than alignAdd(), else 1.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "P_.h"
+#include "astro.h"
+#include "fits.h"
+
+#define	PCTOL		0.15	/* max phaseAlignFITS() error, pixels */
+#define	OLDTOL		0.5	/* max align2FITS() error, pixels */
+#define	OLDMAXSIZE	2048	/* largest image align2FITS() can take */
+#define	BIGW		3000	/* synthetic field width, pixels */
+#define	BIGH		2000	/* synthetic field height, pixels */
+#define	NBIGSTARS	1500	/* stars in synthetic field */
+#define	NOISE		10.0	/* added noise sd, counts */
+#define	STARMIN		2000	/* stack error counts pixels this far over sky */
+
+/* shifts to try, pixels */
+static double shifts[][2] = {
+    {3, -7},
+    {12.25, 4.5},
+    {-37.6, 21.3},
+    {48, -49},
+    {75.4, -12.8},
+    {-140.3, 95.7},
+    {180.5, -160.2},
+};
+#define	NSHIFTS	(sizeof(shifts)/sizeof(shifts[0]))
+
+typedef struct {
+    int n;			/* tries */
+    int nok;			/* found within tolerance */
+    double t;			/* total time, secs */
+    double maxerr;		/* worst error of those found, pixels */
+} Score;
+
+static void usage (char *p);
+static int readFile (char *fn, FImage *fip);
+static void benchImage (char *name, FImage *fip, Score *old, Score *pc);
+static int checkAdd (char *name, FImage *fip);
+static double sumResidual (CamPixel *im, CamPixel *sum, int w, int h,
+    double dx, double dy, int sky);
+static void shiftImage (FImage *fip, double dx, double dy, CamPixel *out);
+static void makeField (FImage *fip);
+static void report (char *name, Score *sp, double tol);
+static double gauss (void);
+static double urand (void);
+static double secs (void);
+
+static unsigned long long rseed = 88172645463325252ULL;
+
+int
+main (int ac, char *av[])
+{
+	Score old, pc;
+	FImage fim;
+	int bad = 0;
+
+	while ((--ac > 0) && ((*++av)[0] == '-')) {
+	    char *s;
+	    for (s = av[0]+1; *s != '\0'; s++)
+		switch (*s) {
+		default:
+		    usage ("alignbench");
+		}
+	}
+
+	memset ((void *)&old, 0, sizeof(old));
+	memset ((void *)&pc, 0, sizeof(pc));
+
+	while (ac-- > 0) {
+	    char *fn = *av++;
+
+	    if (readFile (fn, &fim) < 0) {
+		bad = 1;
+		continue;
+	    }
+	    benchImage (fn, &fim, &old, &pc);
+	    bad |= checkAdd (fn, &fim);
+	    resetFImage (&fim);
+	}
+
+	makeField (&fim);
+	benchImage ("synthetic", &fim, &old, &pc);
+	resetFImage (&fim);
+
+	printf ("overall:\n");
+	report ("align2FITS", &old, OLDTOL);
+	report ("phaseAlignFITS", &pc, PCTOL);
+	if (pc.nok < pc.n)
+	    bad = 1;
+
+	printf ("%s\n", bad ? "FAIL" : "phase alignment agrees");
+	return (bad);
+}
+
+static void
+usage (char *p)
+{
+	fprintf (stderr, "Usage: %s [file.fts ...]\n", p);
+	fprintf (stderr, "Purpose: compare phase correlation alignment with align2FITS().\n");
+	exit (1);
+}
+
+static int
+readFile (char *fn, FImage *fip)
+{
+	char msg[1024];
+	int fd;
+
+	fd = open (fn, O_RDONLY);
+	if (fd < 0) {
+	    perror (fn);
+	    return (-1);
+	}
+	initFImage (fip);
+	if (readFITS (fd, fip, msg) < 0) {
+	    fprintf (stderr, "%s: %s\n", fn, msg);
+	    close (fd);
+	    return (-1);
+	}
+	close (fd);
+	return (0);
+}
+
+/* shift fip by each of shifts[] and score how well both aligners find it,
+ * adding to the running totals in old and pc.
+ */
+static void
+benchImage (char *name, FImage *fip, Score *old, Score *pc)
+{
+	int w = fip->sw, h = fip->sh;
+	CamPixel *im2 = (CamPixel *) malloc (w*h*sizeof(CamPixel));
+	Score so, sp;
+	int i;
+
+	memset ((void *)&so, 0, sizeof(so));
+	memset ((void *)&sp, 0, sizeof(sp));
+	printf ("%s: %d x %d\n", name, w, h);
+	printf ("        shift          align2FITS        phaseAlignFITS\n");
+
+	for (i = 0; i < NSHIFTS; i++) {
+	    double dx = shifts[i][0], dy = shifts[i][1];
+	    double pdx, pdy, t, err;
+	    char obuf[64], pbuf[64];
+	    int odx, ody;
+
+	    shiftImage (fip, dx, dy, im2);
+
+	    /* align2FITS() has fixed size arrays */
+	    so.n++;
+	    if (w > OLDMAXSIZE || h > OLDMAXSIZE)
+		strcpy (obuf, "too big");
+	    else {
+		t = secs();
+		if (align2FITS (fip, (char *)im2, &odx, &ody) < 0) {
+		    so.t += secs() - t;
+		    strcpy (obuf, "failed");
+		} else {
+		    so.t += secs() - t;
+		    err = sqrt((odx-dx)*(odx-dx) + (ody-dy)*(ody-dy));
+		    sprintf (obuf, "%4d %4d", odx, ody);
+		    if (fabs(odx-dx) <= OLDTOL && fabs(ody-dy) <= OLDTOL) {
+			so.nok++;
+			if (err > so.maxerr)
+			    so.maxerr = err;
+		    } else
+			strcat (obuf, " wrong");
+		}
+	    }
+
+	    sp.n++;
+	    t = secs();
+	    if (phaseAlignFITS (fip, (char *)im2, &pdx, &pdy) < 0) {
+		sp.t += secs() - t;
+		strcpy (pbuf, "failed");
+	    } else {
+		sp.t += secs() - t;
+		err = sqrt((pdx-dx)*(pdx-dx) + (pdy-dy)*(pdy-dy));
+		sprintf (pbuf, "%8.2f %8.2f", pdx, pdy);
+		if (fabs(pdx-dx) <= PCTOL && fabs(pdy-dy) <= PCTOL) {
+		    sp.nok++;
+		    if (err > sp.maxerr)
+			sp.maxerr = err;
+		} else
+		    strcat (pbuf, " wrong");
+	    }
+
+	    printf ("  %7.2f %7.2f  %-16s  %s\n", dx, dy, obuf, pbuf);
+	}
+
+	report ("align2FITS", &so, OLDTOL);
+	report ("phaseAlignFITS", &sp, PCTOL);
+
+	old->n += so.n;
+	old->nok += so.nok;
+	old->t += so.t;
+	if (so.maxerr > old->maxerr)
+	    old->maxerr = so.maxerr;
+	pc->n += sp.n;
+	pc->nok += sp.nok;
+	pc->t += sp.t;
+	if (sp.maxerr > pc->maxerr)
+	    pc->maxerr = sp.maxerr;
+
+	free ((void *)im2);
+}
+
+/* stack a fractionally shifted copy of fip, less its sky, back onto it with
+ * alignAddFrac() at the shift phaseAlignFITS() finds, and with alignAdd() at
+ * the nearest whole shift, and compare how far each sum is from what it
+ * should be.
+ * return 0 if alignAddFrac() does better, else 1.
+ */
+static int
+checkAdd (char *name, FImage *fip)
+{
+	int w = fip->sw, h = fip->sh;
+	CamPixel *im1 = (CamPixel *)fip->image;
+	CamPixel *im2 = (CamPixel *) malloc (w*h*sizeof(CamPixel));
+	double dx = 20.5, dy = -10.25, pdx, pdy;
+	double rfrac, rint;
+	FImage sfrac, sint;
+	AOIStats st;
+	int i;
+
+	/* take the sky off the copy so the sums do not saturate */
+	aoiStatsFITS (fip->image, w, 0, 0, w, h, &st);
+	shiftImage (fip, dx, dy, im2);
+	for (i = 0; i < w*h; i++)
+	    im2[i] = im2[i] > st.median ? im2[i] - st.median : 0;
+	if (phaseAlignFITS (fip, (char *)im2, &pdx, &pdy) < 0) {
+	    printf ("%s: alignAddFrac: no alignment  FAIL\n", name);
+	    free ((void *)im2);
+	    return (1);
+	}
+
+	initFImage (&sfrac);
+	initFImage (&sint);
+	copyFITS (&sfrac, fip);
+	copyFITS (&sint, fip);
+	alignAddFrac (&sfrac, (char *)im2, pdx, pdy);
+	alignAdd (&sint, (char *)im2, (int)floor(pdx+0.5), (int)floor(pdy+0.5));
+	rfrac = sumResidual (im1, (CamPixel *)sfrac.image, w, h, dx, dy,
+								st.median);
+	rint = sumResidual (im1, (CamPixel *)sint.image, w, h, dx, dy,
+								st.median);
+	resetFImage (&sfrac);
+	resetFImage (&sint);
+	free ((void *)im2);
+
+	printf ("%s: stack rms error alignAddFrac %.1f, alignAdd %.1f\n", name,
+								rfrac, rint);
+	if (rfrac >= rint) {
+	    printf ("  FAIL\n");
+	    return (1);
+	}
+	return (0);
+}
+
+/* return the rms difference between sum and twice im less sky, both w x h,
+ * over the star pixels, where a copy of im shifted by dx,dy covers it.
+ */
+static double
+sumResidual (CamPixel *im, CamPixel *sum, int w, int h, double dx, double dy,
+int sky)
+{
+	int x0 = dx > 0 ? (int)ceil(dx) + 1 : 1;
+	int x1 = dx > 0 ? w - 1 : w + (int)floor(dx) - 1;
+	int y0 = dy > 0 ? (int)ceil(dy) + 1 : 1;
+	int y1 = dy > 0 ? h - 1 : h + (int)floor(dy) - 1;
+	double s2 = 0;
+	int x, y, n = 0;
+
+	for (y = y0; y < y1; y++)
+	    for (x = x0; x < x1; x++) {
+		double d = sum[y*w+x] - (2.0*im[y*w+x] - sky);
+
+		if (im[y*w+x] < sky + STARMIN)
+		    continue;
+
+		s2 += d*d;
+		n++;
+	    }
+	return (n > 0 ? sqrt(s2/n) : 0);
+}
+
+/* fill out with the pixels of fip shifted by dx,dy, ie, such that pixel x,y
+ * of out is x+dx,y+dy of fip, bilinearly, with NOISE added. pixels from
+ * beyond fip are its median.
+ */
+static void
+shiftImage (FImage *fip, double dx, double dy, CamPixel *out)
+{
+	CamPixel *in = (CamPixel *)fip->image;
+	int w = fip->sw, h = fip->sh;
+	AOIStats st;
+	int ix = (int)floor(dx), iy = (int)floor(dy);
+	double fx = dx - ix, fy = dy - iy;
+	int x, y;
+
+	aoiStatsFITS (fip->image, w, 0, 0, w, h, &st);
+
+	for (y = 0; y < h; y++)
+	    for (x = 0; x < w; x++) {
+		int x0 = x + ix, y0 = y + iy;
+		double v;
+
+		if (x0 < 0 || y0 < 0 || x0+1 >= w || y0+1 >= h)
+		    v = st.median;
+		else {
+		    CamPixel *p = &in[y0*w + x0];
+
+		    v = (1-fy)*((1-fx)*p[0] + fx*p[1])
+					+ fy*((1-fx)*p[w] + fx*p[w+1]);
+		}
+		v += NOISE*gauss();
+		out[y*w + x] = v < 0 ? 0 : (v > MAXCAMPIX ? MAXCAMPIX : v + 0.5);
+	    }
+}
+
+/* make fip a BIGW x BIGH field of NBIGSTARS gaussian stars on a sky */
+static void
+makeField (FImage *fip)
+{
+	CamPixel *im;
+	double *f;
+	int n = BIGW*BIGH;
+	int i, x, y;
+
+	f = (double *) malloc (n*sizeof(double));
+	for (i = 0; i < n; i++)
+	    f[i] = 1000;
+	for (i = 0; i < NBIGSTARS; i++) {
+	    double sx = BIGW*urand(), sy = BIGH*urand();
+	    double a = 300 + 20000*pow(urand(), 4.0);
+	    double s2 = 2*1.5*1.5;
+
+	    for (y = (int)sy - 6; y <= (int)sy + 6; y++)
+		for (x = (int)sx - 6; x <= (int)sx + 6; x++)
+		    if (x >= 0 && x < BIGW && y >= 0 && y < BIGH)
+			f[y*BIGW + x] += a*exp (-((x-sx)*(x-sx)
+						    + (y-sy)*(y-sy))/s2);
+	}
+
+	initFImage (fip);
+	setSimpleFITSHeader (fip);
+	setIntFITS (fip, "BITPIX", 16, NULL);
+	setIntFITS (fip, "NAXIS", 2, NULL);
+	setIntFITS (fip, "NAXIS1", BIGW, NULL);
+	setIntFITS (fip, "NAXIS2", BIGH, NULL);
+	fip->bitpix = 16;
+	fip->sw = BIGW;
+	fip->sh = BIGH;
+	fip->image = (char *) malloc (n*sizeof(CamPixel));
+	im = (CamPixel *)fip->image;
+	for (i = 0; i < n; i++) {
+	    double v = f[i] + NOISE*gauss();
+
+	    im[i] = v > MAXCAMPIX ? MAXCAMPIX : (CamPixel)(v + 0.5);
+	}
+	free ((void *)f);
+}
+
+static void
+report (char *name, Score *sp, double tol)
+{
+	printf ("  %-15s %2d/%2d within %.2f px, worst %.3f px, %7.2f ms each\n",
+			    name, sp->nok, sp->n, tol, sp->maxerr,
+			    sp->n ? 1e3*sp->t/sp->n : 0.0);
+}
+
+/* unit gaussian deviate */
+static double
+gauss (void)
+{
+	double u1 = urand(), u2 = urand();
+
+	return (sqrt(-2*log(u1 + 1e-300))*cos(2*PI*u2));
+}
+
+/* repeatable uniform deviate in [0,1) */
+static double
+urand (void)
+{
+	rseed ^= rseed << 13;
+	rseed ^= rseed >> 7;
+	rseed ^= rseed << 17;
+	return ((rseed >> 11) * (1.0/9007199254740992.0));
+}
+
+static double
+secs (void)
+{
+	struct timeval tv;
+
+	gettimeofday (&tv, NULL);
+	return (tv.tv_sec + tv.tv_usec*1e-6);
+}
@@ -0,0 +1,358 @@
+/* check that libastro and lstsqr give the same answers from many threads.
+ *
+ * a set of circumstances, rise/set, nutation and precession jobs is first
+ * computed on one thread with the classic API. then several threads, each
+ * with its own AstroCtx and each walking the jobs in a different order so
+ * their caches are hit and missed differently, compute them all again with
+ * the _r entry points. every answer must match the first exactly.
+ * lstsqr_r() is checked the same way with a small fit per thread.
+ * exit 0 if all agree, else 1.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+#include "P_.h"
+#include "astro.h"
+#include "circum.h"
+#include "lstsqr.h"
+
+#define	DEFNT	4		/* default number of threads */
+#define	DEFNTM	40		/* default number of times */
+#define	MAXNT	64		/* max threads */
+#define	NSITE	3		/* n observing sites */
+#define	NRES	12		/* answers per job */
+#define	NFIT	50		/* points in each lstsqr test fit */
+
+/* one unit of work */
+typedef struct {
+    int obj;			/* index into objs[] */
+    int site;			/* index into sites[] */
+    double t;			/* mjd */
+} Job;
+
+/* one thread's assignment and answers */
+typedef struct {
+    int id;			/* 0 .. nthr-1 */
+    double *res;		/* NRES answers for each job */
+    double fit[2];		/* lstsqr_r() answer */
+    int fitret;			/* lstsqr_r() return */
+} Worker;
+
+/* data for one lstsqr_r() fit */
+typedef struct {
+    double x[NFIT], y[NFIT];
+} FitData;
+
+static void usage (char *p);
+static void setup (int ntm);
+static void work (AstroCtx *cp, Job *jp, double res[NRES]);
+static void *worker (void *arg);
+static double fitchisqr (double p[], void *arg);
+static void fitdata (int id, FitData *fp);
+static double secs (void);
+
+static double sites[NSITE][2] = {	/* lat, long, degrees */
+    {31.7, -110.9},
+    {-30.2, -70.8},
+    {64.8, -147.7},
+};
+
+static char *fixeddb[] = {
+    "Vega,f|S|A0,18:36:56.3,38:47:01,0.03,2000",
+    "Canopus,f|S|F0,6:23:57.1,-52:41:44,-0.72,2000",
+    "Polaris,f|S|F7,2:31:48.7,89:15:51,2.02,2000",
+};
+#define	NFIXED	(sizeof(fixeddb)/sizeof(fixeddb[0]))
+#define	NOBJS	(MOON+1+NFIXED)
+
+static double fitscale[2] = {1.0, 1.0};	/* lstsqr_r() second guess */
+
+static Obj objs[NOBJS];
+static Job *jobs;
+static int njobs;
+static int nthr;
+
+int
+main (int ac, char *av[])
+{
+	char *progname = av[0];
+	Worker w[MAXNT];
+	pthread_t tid[MAXNT];
+	double *ref;
+	double ref_fit[2];
+	int ref_fitret;
+	double t0, tone, tall;
+	int ntm = DEFNTM;
+	int bad = 0;
+	int i, j;
+
+	nthr = DEFNT;
+
+	while ((--ac > 0) && ((*++av)[0] == '-')) {
+	    char *s;
+	    for (s = av[0]+1; *s != '\0'; s++)
+		switch (*s) {
+		case 'n':
+		    if (ac < 2)
+			usage(progname);
+		    ntm = atoi (*++av);
+		    ac--;
+		    break;
+		case 't':
+		    if (ac < 2)
+			usage(progname);
+		    nthr = atoi (*++av);
+		    ac--;
+		    break;
+		default:
+		    usage(progname);
+		}
+	}
+	if (ac > 0 || ntm < 1 || nthr < 1 || nthr > MAXNT)
+	    usage (progname);
+
+	setup (ntm);
+
+	/* reference answers, one thread, classic API */
+	ref = (double *) malloc (njobs * NRES * sizeof(double));
+	if (!ref) {
+	    fprintf (stderr, "No memory for %d jobs\n", njobs);
+	    return (1);
+	}
+	t0 = secs();
+	for (i = 0; i < njobs; i++)
+	    work (NULL, &jobs[i], &ref[i*NRES]);
+	tone = secs() - t0;
+	{
+	    FitData fd;
+	    fitdata (0, &fd);
+	    ref_fit[0] = 0;
+	    ref_fit[1] = 0;
+	    ref_fitret = lstsqr_r (fitchisqr, (void *)&fd, ref_fit,
+						fitscale, 2, 1e-8);
+	}
+
+	/* same again from nthr threads at once */
+	t0 = secs();
+	for (i = 0; i < nthr; i++) {
+	    w[i].id = i;
+	    w[i].res = (double *) malloc (njobs * NRES * sizeof(double));
+	    if (!w[i].res) {
+		fprintf (stderr, "No memory for thread %d\n", i);
+		return (1);
+	    }
+	    if (pthread_create (&tid[i], NULL, worker, (void *)&w[i]) != 0) {
+		fprintf (stderr, "Can not create thread %d\n", i);
+		return (1);
+	    }
+	}
+	for (i = 0; i < nthr; i++)
+	    pthread_join (tid[i], NULL);
+	tall = secs() - t0;
+
+	for (i = 0; i < nthr; i++) {
+	    int nbad = 0;
+
+	    for (j = 0; j < njobs*NRES; j++)
+		if (memcmp (&w[i].res[j], &ref[j], sizeof(double)))
+		    nbad++;
+	    if (w[i].fitret != ref_fitret || w[i].fit[0] != ref_fit[0]
+						|| w[i].fit[1] != ref_fit[1])
+		nbad++;
+	    if (nbad) {
+		printf ("Thread %d: %d answers differ  FAIL\n", i, nbad);
+		bad = 1;
+	    }
+	    free ((void *)w[i].res);
+	}
+
+	printf ("%d jobs: 1 thread %.3f secs, %d threads %.3f secs: %s\n",
+		njobs, tone, nthr, tall, bad ? "FAIL" : "all answers agree");
+
+	free ((void *)ref);
+	free ((void *)jobs);
+	return (bad);
+}
+
+static void
+usage (char *p)
+{
+	fprintf (stderr, "Usage: %s [options]\n", p);
+	fprintf (stderr, "Purpose: check libastro gives the same answers from many threads.\n");
+	fprintf (stderr, "Options:\n");
+	fprintf (stderr, " -n n   number of times; default %d\n", DEFNTM);
+	fprintf (stderr, " -t n   number of threads; default %d, max %d\n",
+							    DEFNT, MAXNT);
+	exit (1);
+}
+
+/* build objs[] and jobs[] */
+static void
+setup (int ntm)
+{
+	char whynot[1024];
+	int i, o, s;
+
+	for (o = 0; o <= MOON; o++) {
+	    memset ((void *)&objs[o], 0, sizeof(Obj));
+	    objs[o].o_type = PLANET;
+	    objs[o].pl.pl_code = o;
+	}
+	for (i = 0; i < NFIXED; i++) {
+	    char buf[128];
+
+	    (void) strcpy (buf, fixeddb[i]);
+	    if (db_crack_line (buf, &objs[MOON+1+i], whynot) < 0) {
+		fprintf (stderr, "%s: %s\n", fixeddb[i], whynot);
+		exit (1);
+	    }
+	}
+
+	/* runs of nearby times, as when following a night */
+	njobs = NOBJS*NSITE*ntm;
+	jobs = (Job *) malloc (njobs * sizeof(Job));
+	if (!jobs) {
+	    fprintf (stderr, "No memory for %d jobs\n", njobs);
+	    exit (1);
+	}
+	srand (1);
+	i = 0;
+	for (s = 0; s < ntm; s++) {
+	    double t;
+
+	    if (s % 10 == 0)
+		t = 36525.0 + 20*365.25*(double)rand()/RAND_MAX;
+	    else
+		t = jobs[i-1].t + 1.0/24;
+	    for (o = 0; o < NOBJS*NSITE; o++) {
+		jobs[i].obj = o % NOBJS;
+		jobs[i].site = o / NOBJS;
+		jobs[i].t = t;
+		i++;
+	    }
+	}
+}
+
+/* do the job at jp into res[], using cp or the classic API if NULL */
+static void
+work (AstroCtx *cp, Job *jp, double res[NRES])
+{
+	Now now, *np = &now;
+	Obj o;
+	RiseSet rs;
+	double ra, dec;
+
+	memset ((void *)np, 0, sizeof(now));
+	mjd = jp->t;
+	lat = degrad(sites[jp->site][0]);
+	lng = degrad(sites[jp->site][1]);
+	temp = 10.0;
+	pressure = 1010.0;
+	elev = 2000.0/ERAD;
+	dip = degrad(18.0);
+	epoch = J2000;
+	memcpy ((void *)&o, (void *)&objs[jp->obj], sizeof(o));
+	memset ((void *)&rs, 0, sizeof(rs));
+
+	if (cp) {
+	    (void) obj_cir_r (cp, np, &o);
+	    riset_cir_r (cp, np, &o, 0.0, &rs);
+	    nutation_r (cp, jp->t, &res[8], &res[9]);
+	} else {
+	    (void) obj_cir (np, &o);
+	    riset_cir (np, &o, 0.0, &rs);
+	    nutation (jp->t, &res[8], &res[9]);
+	}
+
+	res[0] = o.s_ra;
+	res[1] = o.s_dec;
+	res[2] = o.s_alt;
+	res[3] = o.s_az;
+	res[4] = rs.rs_flags;
+	res[5] = rs.rs_risetm;
+	res[6] = rs.rs_settm;
+	res[7] = rs.rs_trantm;
+
+	ra = o.s_ra;
+	dec = o.s_dec;
+	if (cp)
+	    precess_r (cp, jp->t, J2000, &ra, &dec);
+	else
+	    precess (jp->t, J2000, &ra, &dec);
+	res[10] = ra;
+	res[11] = dec;
+}
+
+/* thread entry: do every job with a private context, in an order which
+ * depends on our id.
+ */
+static void *
+worker (void *arg)
+{
+	Worker *wp = (Worker *)arg;
+	AstroCtx *cp = astro_ctx_new();
+	FitData fd;
+	int i;
+
+	if (!cp) {
+	    fprintf (stderr, "Thread %d: no memory for context\n", wp->id);
+	    exit (1);
+	}
+
+	for (i = 0; i < njobs; i++) {
+	    int j = (wp->id & 1) ? njobs-1-i : i;	/* odd ones backwards */
+
+	    j = (j + wp->id*(njobs/nthr)) % njobs;	/* staggered starts */
+	    work (cp, &jobs[j], &wp->res[j*NRES]);
+	}
+
+	fitdata (0, &fd);
+	wp->fit[0] = 0;
+	wp->fit[1] = 0;
+	wp->fitret = lstsqr_r (fitchisqr, (void *)&fd, wp->fit,
+						fitscale, 2, 1e-8);
+
+	astro_ctx_free (cp);
+	return (NULL);
+}
+
+/* chisqr of the line p[0] + p[1]*x to the data at arg */
+static double
+fitchisqr (double p[], void *arg)
+{
+	FitData *fp = (FitData *)arg;
+	double sum = 0;
+	int i;
+
+	for (i = 0; i < NFIT; i++) {
+	    double r = fp->y[i] - (p[0] + p[1]*fp->x[i]);
+	    sum += r*r;
+	}
+	return (sum);
+}
+
+/* fill fp with a noisy line, the same for the same id */
+static void
+fitdata (int id, FitData *fp)
+{
+	int i;
+
+	for (i = 0; i < NFIT; i++) {
+	    fp->x[i] = i;
+	    fp->y[i] = 3.0 + 0.5*i + 0.1*sin(i*7.0 + id);
+	}
+}
+
+static double
+secs (void)
+{
+	struct timeval tv;
+
+	gettimeofday (&tv, NULL);
+	return (tv.tv_sec + tv.tv_usec*1e-6);
+}
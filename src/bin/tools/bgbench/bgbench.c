@@ -0,0 +1,538 @@
+/* check and time the background surface engine against the amoeba fit that
+ * flatField() used to do.
+ *
+ * synthetic star fields are made over a known sky, one a pure quadratic and
+ * one with a broad lump added that no low order polynomial can follow. each
+ * sky is then modelled the old way, by lstsqr() on patch medians and pow()
+ * per pixel, and the new ways, by bgFitPoly() and bgFitSpline(), and the
+ * error of each against the true sky is reported along with its time.
+ * also checks that bgEvaluate() gives the same map with any number of
+ * threads, that bgRow() agrees with it, that flatField() leaves a flat sky,
+ * and how many of the stars findStars() finds when it uses the map.
+ * exit 0 if all ok, else 1.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/time.h>
+
+#include "P_.h"
+#include "astro.h"
+#include "fits.h"
+#include "lstsqr.h"
+
+#define	W		1536	/* synthetic field width, pixels */
+#define	H		1024	/* synthetic field height, pixels */
+#define	NSTARS		800	/* stars in each field */
+#define	SKY0		1500.0	/* sky at the center, counts */
+#define	NOISE		10.0	/* added noise sd, counts */
+#define	LUMP		150.0	/* peak of the lump in the lumpy sky, counts */
+#define	BORDER		32	/* border left out of comparisons, pixels */
+#define	ORDER		2	/* polynomial order */
+#define	POLYTOL		0.5	/* max rms error of bgFitPoly() on a quadratic sky, NOISE */
+#define	SPLTOL		0.5	/* max rms error of bgFitSpline() on the lumpy sky, NOISE */
+#define	FLATTOL		3.0	/* max sky range left by flatField(), NOISE */
+#define	FINDSNR		20.0	/* stars at least this bright must be found, NOISE */
+#define	FINDFRAC	0.95	/* fraction of them which must be found */
+
+/* one synthetic star */
+typedef struct {
+    double x, y;		/* center */
+    double a;			/* peak over sky */
+} Star;
+
+/* a patch for the old amoeba fit */
+typedef struct {
+    int x, y;			/* patch center */
+    double z;			/* patch median */
+} ImMed;
+
+static void usage (char *p);
+static void makeField (FImage *fip, double *sky, Star *stars, int lumpy);
+static double trueSky (int x, int y, int lumpy);
+static int benchSky (char *name, FImage *fip, double *sky, Star *stars,
+    int lumpy);
+static int checkThreads (BgMap *bp);
+static int checkFlat (FImage *fip);
+static int checkFind (FImage *fip, BgMap *bp, Star *stars);
+static int amoebaSky (FImage *fip, int order, float *map);
+static double surface_z (int x, int y, double p[]);
+static double surface_chisqr (double p[]);
+static void skyError (float *map, double *sky, double *rmsp, double *maxp);
+static double gauss (void);
+static double urand (void);
+static double secs (void);
+
+static unsigned long long rseed = 88172645463325252ULL;
+
+static ImMed *immed;		/* patches for amoeba fit */
+static int nimmed;		/* n immed[] */
+static int porder;		/* order of amoeba fit */
+
+int
+main (int ac, char *av[])
+{
+	Star stars[NSTARS];
+	double *sky;
+	FImage fim;
+	int bad = 0;
+
+	while ((--ac > 0) && ((*++av)[0] == '-')) {
+	    char *s;
+	    for (s = av[0]+1; *s != '\0'; s++)
+		switch (*s) {
+		case 'i':
+		    if (ac < 2)
+			usage ("bgbench");
+		    setIpCfgPath (*++av);
+		    ac--;
+		    break;
+		default:
+		    usage ("bgbench");
+		}
+	}
+	if (ac > 0)
+	    usage ("bgbench");
+
+	sky = (double *) malloc (W*H*sizeof(double));
+	if (!sky) {
+	    fprintf (stderr, "No memory\n");
+	    return (1);
+	}
+
+	makeField (&fim, sky, stars, 0);
+	bad |= benchSky ("quadratic sky", &fim, sky, stars, 0);
+	bad |= checkFlat (&fim);
+	resetFImage (&fim);
+
+	makeField (&fim, sky, stars, 1);
+	bad |= benchSky ("lumpy sky", &fim, sky, stars, 1);
+	resetFImage (&fim);
+
+	free ((void *)sky);
+	printf ("%s\n", bad ? "FAIL" : "background ok");
+	return (bad);
+}
+
+static void
+usage (char *p)
+{
+	fprintf (stderr, "Usage: %s [options]\n", p);
+	fprintf (stderr, "Purpose: check and time the background surface engine.\n");
+	fprintf (stderr, "Options:\n");
+	fprintf (stderr, " -i file: ip.cfg to use\n");
+	exit (1);
+}
+
+/* model the sky of fip each way and compare with the true sky[].
+ * return 0 if the new ways are good enough, else 1.
+ */
+static int
+benchSky (char *name, FImage *fip, double *sky, Star *stars, int lumpy)
+{
+	double t, rms, max, prms, srms;
+	float *map;
+	BgMap bg;
+	int bad = 0;
+
+	printf ("%s, %dx%d, noise %g:\n", name, W, H, NOISE);
+
+	map = (float *) malloc (W*H*sizeof(float));
+	t = secs();
+	if (!map || amoebaSky (fip, ORDER, map) < 0)
+	    printf ("  amoeba fit failed\n");
+	else {
+	    t = secs() - t;
+	    skyError (map, sky, &rms, &max);
+	    printf ("  amoeba poly     rms %6.2f max %6.2f noise, %8.2f ms\n",
+						    rms, max, 1e3*t);
+	}
+	if (map)
+	    free ((void *)map);
+
+	t = secs();
+	if (bgMeasure (fip->image, W, H, BORDER, 0, &bg) < 0) {
+	    printf ("  bgMeasure failed  FAIL\n");
+	    return (1);
+	}
+	t = secs() - t;
+	printf ("  %dx%d tiles of %dx%d measured in %.2f ms\n", bg.nx, bg.ny,
+						    bg.tw, bg.th, 1e3*t);
+
+	t = secs();
+	if (bgFitPoly (&bg, ORDER) < 0 || bgEvaluate (&bg, 1) < 0) {
+	    printf ("  bgFitPoly failed  FAIL\n");
+	    bgFree (&bg);
+	    return (1);
+	}
+	t = secs() - t;
+	skyError (bg.map, sky, &prms, &max);
+	printf ("  bgFitPoly       rms %6.2f max %6.2f noise, %8.2f ms\n",
+						    prms, max, 1e3*t);
+	if (!lumpy && prms > POLYTOL) {
+	    printf ("  polynomial sky rms over %g  FAIL\n", POLYTOL);
+	    bad = 1;
+	}
+	bad |= checkThreads (&bg);
+
+	t = secs();
+	if (bgFitSpline (&bg) < 0 || bgEvaluate (&bg, 1) < 0) {
+	    printf ("  bgFitSpline failed  FAIL\n");
+	    bgFree (&bg);
+	    return (1);
+	}
+	t = secs() - t;
+	skyError (bg.map, sky, &srms, &max);
+	printf ("  bgFitSpline     rms %6.2f max %6.2f noise, %8.2f ms\n",
+						    srms, max, 1e3*t);
+	if (lumpy && (srms > SPLTOL || srms > prms)) {
+	    printf ("  spline sky rms over %g or polynomial's  FAIL\n", SPLTOL);
+	    bad = 1;
+	}
+	bad |= checkThreads (&bg);
+	if (lumpy)
+	    bad |= checkFind (fip, &bg, stars);
+
+	bgFree (&bg);
+	return (bad);
+}
+
+/* check bgEvaluate() gives the same map with several threads, and that
+ * bgRow() agrees with it.
+ * return 0 if so, else 1.
+ */
+static int
+checkThreads (BgMap *bp)
+{
+	float *map1 = bp->map;
+	float row[W];
+	int y, bad = 0;
+
+	bp->map = NULL;
+	if (bgEvaluate (bp, 3) < 0) {
+	    printf ("  bgEvaluate with 3 threads failed  FAIL\n");
+	    bp->map = map1;
+	    return (1);
+	}
+	if (memcmp ((void *)map1, (void *)bp->map, W*H*sizeof(float))) {
+	    printf ("  map differs with 3 threads  FAIL\n");
+	    bad = 1;
+	}
+	for (y = 0; y < H; y += H/7) {
+	    bgRow (bp, y, row);
+	    if (memcmp ((void *)row, (void *)&map1[y*W], W*sizeof(float))) {
+		printf ("  bgRow %d differs from map  FAIL\n", y);
+		bad = 1;
+		break;
+	    }
+	}
+	free ((void *)map1);
+	return (bad);
+}
+
+/* check flatField() leaves fip with a flat sky.
+ * return 0 if so, else 1.
+ */
+static int
+checkFlat (FImage *fip)
+{
+	FImage to;
+	BgMap bg;
+	double t, lo, hi;
+	int i, bad = 0;
+
+	to = *fip;
+	to.image = (char *) malloc (W*H*sizeof(CamPixel));
+	t = secs();
+	if (!to.image || flatField (fip, &to, ORDER) < 0) {
+	    printf ("  flatField failed  FAIL\n");
+	    if (to.image)
+		free (to.image);
+	    return (1);
+	}
+	t = secs() - t;
+
+	if (bgMeasure (to.image, W, H, BORDER, 0, &bg) < 0) {
+	    printf ("  bgMeasure failed  FAIL\n");
+	    free (to.image);
+	    return (1);
+	}
+	lo = hi = bg.sky[0];
+	for (i = 1; i < bg.nx*bg.ny; i++) {
+	    if (bg.sky[i] < lo)
+		lo = bg.sky[i];
+	    if (bg.sky[i] > hi)
+		hi = bg.sky[i];
+	}
+	printf ("  flatField       sky range %5.2f noise, %8.2f ms\n",
+						    (hi-lo)/NOISE, 1e3*t);
+	if (hi - lo > FLATTOL*NOISE) {
+	    printf ("  flattened sky range over %g  FAIL\n", FLATTOL);
+	    bad = 1;
+	}
+	bgFree (&bg);
+	free (to.image);
+	return (bad);
+}
+
+/* count the stars findStars() finds in fip with and without bp.
+ * return 0 if it finds enough of the bright ones with bp, else 1.
+ */
+static int
+checkFind (FImage *fip, BgMap *bp, Star *stars)
+{
+	int nfound[2], nfalse[2], nbright;
+	double t[2];
+	int pass, i, j;
+
+	nbright = 0;
+	for (i = 0; i < NSTARS; i++)
+	    if (stars[i].a >= FINDSNR*NOISE)
+		nbright++;
+
+	for (pass = 0; pass < 2; pass++) {
+	    int *x, *y, n;
+	    CamPixel *b;
+
+	    useBgMap (pass ? bp : NULL);
+	    t[pass] = secs();
+	    n = findStars (fip->image, W, H, &x, &y, &b);
+	    t[pass] = secs() - t[pass];
+	    nfound[pass] = 0;
+	    nfalse[pass] = n;
+	    for (i = 0; i < NSTARS; i++) {
+		if (stars[i].a < FINDSNR*NOISE)
+		    continue;
+		for (j = 0; j < n; j++)
+		    if (fabs(x[j]-stars[i].x) < 2 && fabs(y[j]-stars[i].y) < 2)
+			break;
+		if (j < n)
+		    nfound[pass]++;
+	    }
+	    for (j = 0; j < n; j++)
+		for (i = 0; i < NSTARS; i++)
+		    if (fabs(x[j]-stars[i].x) < 3 && fabs(y[j]-stars[i].y) < 3){
+			nfalse[pass]--;
+			break;
+		    }
+	    if (n >= 0) {
+		free ((void *)x);
+		free ((void *)y);
+		free ((void *)b);
+	    }
+	}
+	useBgMap (NULL);
+
+	printf ("  findStars found %d/%d bright, %d others, %.2f ms; "
+			    "with map %d/%d, %d others, %.2f ms\n",
+			    nfound[0], nbright, nfalse[0], 1e3*t[0],
+			    nfound[1], nbright, nfalse[1], 1e3*t[1]);
+	if (nfound[1] < FINDFRAC*nbright) {
+	    printf ("  too few stars found with map  FAIL\n");
+	    return (1);
+	}
+	return (0);
+}
+
+/* model the sky of fip the way flatField() used to: fit an order-n
+ * polynomial in pixels to a grid of patch medians with lstsqr(), then
+ * evaluate it at each pixel.
+ * return 0 if ok, else -1.
+ */
+static int
+amoebaSky (FImage *fip, int order, float *map)
+{
+	CamPixel *im = (CamPixel *)fip->image;
+	int nterms = (order+1)*(order+1);
+	int nside = nterms+1;
+	int weach = (W - 2*BORDER)/nside;
+	int heach = (H - 2*BORDER)/nside;
+	double p0[64], p1[64];
+	double dx, dy, dz, z0;
+	ImMed *imp;
+	int i, j, n, x, y;
+
+	porder = order;
+	nimmed = nside*nside;
+	immed = (ImMed *) calloc (nimmed, sizeof(ImMed));
+	if (!immed)
+	    return (-1);
+	imp = immed;
+	for (x = BORDER; x < BORDER + nside*weach; x += weach)
+	    for (y = BORDER; y < BORDER + nside*heach; y += heach) {
+		AOIStats s;
+
+		aoiStatsFITS ((char *)im, W, x, y, weach, heach, &s);
+		imp->x = x + weach/2;
+		imp->y = y + heach/2;
+		imp->z = (double)s.median;
+		imp++;
+	    }
+
+	memset ((void *)p0, 0, sizeof(p0));
+	p0[0] = immed[nimmed/2].z;
+	n = 0;
+	dx = (nside-1)*weach;
+	dy = (nside-1)*heach;
+	z0 = immed[0].z;
+	dz = ((immed[nside-1].z-z0) + (immed[nimmed-1].z-z0))/2;
+	for (i = 0; i < order+1; i++)
+	    for (j = 0; j < order+1; j++)
+		p1[n++] = (i==0&&j==0) ? z0 :
+				dz / (pow(dx,(double)i) * pow(dy,(double)j));
+
+	if (lstsqr (surface_chisqr, p0, p1, nterms, 0.01) < 0) {
+	    free ((void *)immed);
+	    return (-1);
+	}
+
+	for (y = 0; y < H; y++)
+	    for (x = 0; x < W; x++)
+		*map++ = surface_z (x, y, p0);
+
+	free ((void *)immed);
+	return (0);
+}
+
+/* the old polynomial: p[0] + p[1]y + p[2]yy + ... p[porder+1]x + ... */
+static double
+surface_z (int x, int y, double p[])
+{
+	double X, Y, z;
+	int i, j, n;
+
+	X = 1;
+	n = 0;
+	z = 0;
+	for (i = 0; i < porder+1; i++) {
+	    Y = 1;
+	    for (j = 0; j < porder+1; j++) {
+		z += p[n++]*X*Y;
+		Y *= y;
+	    }
+	    X *= x;
+	}
+	return (z);
+}
+
+static double
+surface_chisqr (double p[])
+{
+	double cs = 0;
+	int i;
+
+	for (i = 0; i < nimmed; i++) {
+	    double c = surface_z (immed[i].x, immed[i].y, p) - immed[i].z;
+	    cs += c*c;
+	}
+	return (cs);
+}
+
+/* find the rms and max error of map against sky inside BORDER, in NOISE */
+static void
+skyError (float *map, double *sky, double *rmsp, double *maxp)
+{
+	double sum2 = 0, max = 0;
+	int x, y, n = 0;
+
+	for (y = BORDER; y < H - BORDER; y++)
+	    for (x = BORDER; x < W - BORDER; x++) {
+		double e = fabs (map[y*W + x] - sky[y*W + x]);
+
+		sum2 += e*e;
+		if (e > max)
+		    max = e;
+		n++;
+	    }
+	*rmsp = sqrt(sum2/n)/NOISE;
+	*maxp = max/NOISE;
+}
+
+/* make a W x H star field in fip over trueSky(), which is put in sky[]. */
+static void
+makeField (FImage *fip, double *sky, Star *stars, int lumpy)
+{
+	CamPixel *im;
+	double *f;
+	int i, x, y;
+
+	f = (double *) malloc (W*H*sizeof(double));
+	for (y = 0; y < H; y++)
+	    for (x = 0; x < W; x++)
+		f[y*W + x] = sky[y*W + x] = trueSky (x, y, lumpy);
+	for (i = 0; i < NSTARS; i++) {
+	    Star *sp = &stars[i];
+	    double s2 = 2*1.5*1.5;
+
+	    sp->x = BORDER + 8 + (W - 2*BORDER - 16)*urand();
+	    sp->y = BORDER + 8 + (H - 2*BORDER - 16)*urand();
+	    sp->a = 50 + 20000*pow(urand(), 4.0);
+	    for (y = (int)sp->y - 8; y <= (int)sp->y + 8; y++)
+		for (x = (int)sp->x - 8; x <= (int)sp->x + 8; x++)
+		    f[y*W + x] += sp->a*exp (-((x-sp->x)*(x-sp->x)
+					    + (y-sp->y)*(y-sp->y))/s2);
+	}
+
+	initFImage (fip);
+	setSimpleFITSHeader (fip);
+	setIntFITS (fip, "BITPIX", 16, NULL);
+	setIntFITS (fip, "NAXIS", 2, NULL);
+	setIntFITS (fip, "NAXIS1", W, NULL);
+	setIntFITS (fip, "NAXIS2", H, NULL);
+	fip->bitpix = 16;
+	fip->sw = W;
+	fip->sh = H;
+	fip->image = (char *) malloc (W*H*sizeof(CamPixel));
+	im = (CamPixel *)fip->image;
+	for (i = 0; i < W*H; i++) {
+	    double v = f[i] + NOISE*gauss();
+
+	    im[i] = v > MAXCAMPIX ? MAXCAMPIX : (CamPixel)(v + 0.5);
+	}
+	free ((void *)f);
+}
+
+/* the true sky at x,y: a quadratic, plus a broad lump if lumpy */
+static double
+trueSky (int x, int y, int lumpy)
+{
+	double u = (x - W/2.0)/(W/2.0);
+	double v = (y - H/2.0)/(H/2.0);
+	double z = SKY0 + 300*u + 200*v + 150*u*u - 100*u*v + 120*v*v;
+
+	if (lumpy) {
+	    double dx = x - 0.3*W, dy = y - 0.6*H;
+	    z += LUMP*exp (-(dx*dx + dy*dy)/(2*250.0*250.0));
+	}
+	return (z);
+}
+
+/* unit gaussian deviate */
+static double
+gauss (void)
+{
+	double u1 = urand(), u2 = urand();
+
+	return (sqrt(-2*log(u1 + 1e-300))*cos(2*PI*u2));
+}
+
+/* repeatable uniform deviate in [0,1) */
+static double
+urand (void)
+{
+	rseed ^= rseed << 13;
+	rseed ^= rseed >> 7;
+	rseed ^= rseed << 17;
+	return ((rseed >> 11) * (1.0/9007199254740992.0));
+}
+
+static double
+secs (void)
+{
+	struct timeval tv;
+
+	gettimeofday (&tv, NULL);
+	return (tv.tv_sec + tv.tv_usec*1e-6);
+}
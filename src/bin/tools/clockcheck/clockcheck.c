@@ -0,0 +1,151 @@
+/* check the simulated clock of simclock.c.
+ *
+ * a SimClock of our own is attached and started at speed n from a fixed
+ * sim0, as telescoped does with the one in TelStatShm. then secs_now(),
+ * time_now() and mjd_now() must start at sim0 and run n times as fast as
+ * gettimeofday(), and real_secs() must scale delays by 1/n. before it is
+ * attached and after it is stopped they must all be real time.
+ * exit 0 if all is well, else 1.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "P_.h"
+#include "astro.h"
+#include "circum.h"
+#include "misc.h"
+#include "simclock.h"
+
+#define	DEFSPEED	60.0		/* default simulated secs per real sec */
+#define	SIM0		946728000.0	/* 2000 Jan 1 12:00 UTC, secs since 1970 */
+#define	NAPUS		200000		/* real usecs over which to time the rate */
+#define	SLOP		0.05		/* allowed real secs between calls */
+#define	MAXRATE		1e-3		/* allowed relative rate error */
+
+static void usage (char *p);
+static int realTime (char *when);
+static int check (char *what, double got, double want, double tol);
+static double wall (void);
+
+int
+main (int ac, char *av[])
+{
+	char *progname = av[0];
+	double speed = DEFSPEED;
+	SimClock sc;
+	double w0, w1, t0, t1, t;
+	time_t tn;
+	int bad = 0;
+
+	while ((--ac > 0) && ((*++av)[0] == '-')) {
+	    char *s;
+	    for (s = av[0]+1; *s != '\0'; s++)
+		switch (*s) {
+		case 's':
+		    if (ac < 2)
+			usage(progname);
+		    speed = atof (*++av);
+		    ac--;
+		    break;
+		default:
+		    usage(progname);
+		}
+	}
+	if (ac > 0 || speed <= 0)
+	    usage (progname);
+
+	/* nothing attached is real time */
+	bad += realTime ("unattached");
+
+	/* attached and running from SIM0 at speed */
+	simclock_attach (&sc);
+	simclock_start (&sc, SIM0, speed);
+	bad += check ("speed", simclock_speed(), speed, 0);
+	bad += check ("secs_now() offset", secs_now(), SIM0, speed*SLOP);
+	bad += check ("mjd_now() offset", mjd_now(), 25567.5 + SIM0/SPD,
+							    speed*SLOP/SPD);
+	bad += check ("real_secs()", real_secs (10*speed), 10.0, 1e-9);
+
+	w0 = wall();
+	t0 = secs_now();
+	usleep (NAPUS);
+	t1 = secs_now();
+	w1 = wall();
+	bad += check ("secs_now() rate", (t1-t0)/(w1-w0), speed,
+							    speed*MAXRATE);
+
+	t = secs_now();
+	tn = time_now();
+	t1 = secs_now();
+	if (tn < (time_t)t || tn > (time_t)t1) {
+	    printf ("  time_now() %ld not within secs_now() %.3f .. %.3f  FAIL\n",
+							(long)tn, t, t1);
+	    bad++;
+	}
+
+	/* stopped is real time again */
+	simclock_stop (&sc);
+	bad += realTime ("stopped");
+	simclock_attach (NULL);
+
+	printf ("%s\n", bad ? "FAIL" : "ok");
+	return (bad > 0);
+}
+
+static void
+usage (char *p)
+{
+	fprintf (stderr, "Usage: %s [options]\n", p);
+	fprintf (stderr, "Purpose: check the simulated clock runs at its speed from its start.\n");
+	fprintf (stderr, "Options:\n");
+	fprintf (stderr, " -s x   simulated secs per real sec; default %g\n",
+								    DEFSPEED);
+	exit (1);
+}
+
+/* check the clock is real time now.
+ * return 0 if so, else the number of things wrong.
+ */
+static int
+realTime (char *when)
+{
+	char what[64];
+	int bad = 0;
+
+	sprintf (what, "%s speed", when);
+	bad += check (what, simclock_speed(), 1.0, 0);
+	sprintf (what, "%s secs_now()", when);
+	bad += check (what, secs_now(), wall(), SLOP);
+	sprintf (what, "%s time_now()", when);
+	bad += check (what, (double)time_now(), wall(), 1 + SLOP);
+	sprintf (what, "%s real_secs()", when);
+	bad += check (what, real_secs (10.0), 10.0, 0);
+	return (bad);
+}
+
+/* report got vs want, which must agree within tol.
+ * return 0 if they do, else 1.
+ */
+static int
+check (char *what, double got, double want, double tol)
+{
+	int bad = fabs (got - want) > tol;
+
+	printf ("  %-24s %.6f want %.6f%s\n", what, got, want,
+							bad ? "  FAIL" : "");
+	return (bad);
+}
+
+/* real secs since 1970 */
+static double
+wall ()
+{
+	struct timeval tv;
+
+	gettimeofday (&tv, NULL);
+	return (tv.tv_sec + tv.tv_usec*1e-6);
+}
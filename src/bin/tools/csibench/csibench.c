@@ -0,0 +1,276 @@
+/* time reading the positions of several csimc nodes one after another with
+ * csi_rix(), as telescoped used to, against all at once with csi_rixv().
+ *
+ * the nodes are a loopback stand-in for csimcd, run in this process, which
+ * answers "=epos;" and "=mpos;" on each connection after a set delay with a
+ * value which tells which node and which query it is, so the replies can be
+ * checked too. exit 0 if all replies are right, else 1.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include "csimc.h"
+
+#define	DEFNODES	3	/* default number of nodes, as HA, Dec and rot */
+#define	DEFDELAY	2000	/* default reply delay, us */
+#define	DEFCYCLES	200	/* default status cycles to time */
+#define	VALMUL		100000	/* reply is addr*VALMUL + query number */
+
+static void usage (char *p);
+static int startServer (void);
+static void *acceptThread (void *arg);
+static void *nodeThread (void *arg);
+static int runSerial (int fds[], int seq[], int n, int cycles);
+static int runSplit (int fds[], int seq[], int n, int cycles);
+static double secs (void);
+
+static int delay = DEFDELAY;
+
+int
+main (int ac, char *av[])
+{
+	char *progname = av[0];
+	int nnodes = DEFNODES, cycles = DEFCYCLES;
+	int fds[NNODES], seq[NNODES];
+	double t0, t1;
+	int port, i, bad;
+
+	while ((--ac > 0) && ((*++av)[0] == '-')) {
+	    char *s;
+	    for (s = av[0]+1; *s != '\0'; s++)
+		switch (*s) {
+		case 'c':
+		    if (ac < 2)
+			usage(progname);
+		    cycles = atoi (*++av);
+		    ac--;
+		    break;
+		case 'd':
+		    if (ac < 2)
+			usage(progname);
+		    delay = atoi (*++av);
+		    ac--;
+		    break;
+		case 'n':
+		    if (ac < 2)
+			usage(progname);
+		    nnodes = atoi (*++av);
+		    ac--;
+		    break;
+		default:
+		    usage(progname);
+		}
+	}
+	if (ac > 0 || nnodes < 1 || nnodes > NNODES || cycles < 1 || delay < 0)
+	    usage (progname);
+
+	port = startServer();
+	if (port < 0) {
+	    fprintf (stderr, "Can not start loopback nodes: %s\n",
+							    strerror(errno));
+	    return (1);
+	}
+	for (i = 0; i < nnodes; i++) {
+	    fds[i] = csi_open ("127.0.0.1", port, i);
+	    if (fds[i] < 0) {
+		fprintf (stderr, "csi_open(%d): %s\n", i, strerror(errno));
+		return (1);
+	    }
+	    seq[i] = 0;
+	}
+
+	t0 = secs();
+	bad = runSerial (fds, seq, nnodes, cycles);
+	t0 = secs() - t0;
+	t1 = secs();
+	bad += runSplit (fds, seq, nnodes, cycles);
+	t1 = secs() - t1;
+
+	printf ("%d nodes, %d us reply delay, %d cycles:\n", nnodes, delay,
+									cycles);
+	printf ("  one at a time %8.3f ms/cycle\n", 1e3*t0/cycles);
+	printf ("  all at once   %8.3f ms/cycle (%.1fx)\n", 1e3*t1/cycles,
+							    t1 > 0 ? t0/t1 : 0.0);
+	if (bad)
+	    printf ("%d wrong replies  FAIL\n", bad);
+	else
+	    printf ("csimc replies agree\n");
+
+	for (i = 0; i < nnodes; i++)
+	    csi_close (fds[i]);
+	return (bad ? 1 : 0);
+}
+
+static void
+usage (char *p)
+{
+	fprintf (stderr, "Usage: %s [options]\n", p);
+	fprintf (stderr, "Purpose: time serial against split-phase csimc position reads.\n");
+	fprintf (stderr, "Options:\n");
+	fprintf (stderr, " -c n   status cycles; default %d\n", DEFCYCLES);
+	fprintf (stderr, " -d us  node reply delay; default %d\n", DEFDELAY);
+	fprintf (stderr, " -n n   nodes; default %d, max %d\n", DEFNODES, NNODES);
+	exit (1);
+}
+
+/* read each node's position once per cycle, one after another.
+ * return number of wrong replies.
+ */
+static int
+runSerial (int fds[], int seq[], int n, int cycles)
+{
+	int c, i, bad = 0;
+
+	for (c = 0; c < cycles; c++)
+	    for (i = 0; i < n; i++)
+		if (csi_rix (fds[i], "=epos;") != i*VALMUL + seq[i]++)
+		    bad++;
+	return (bad);
+}
+
+/* read all the nodes' positions at once each cycle.
+ * return number of wrong replies.
+ */
+static int
+runSplit (int fds[], int seq[], int n, int cycles)
+{
+	char *exprs[NNODES];
+	int vals[NNODES];
+	int c, i, bad = 0;
+
+	for (i = 0; i < n; i++)
+	    exprs[i] = (i & 1) ? "=mpos;" : "=epos;";
+	for (c = 0; c < cycles; c++) {
+	    if (csi_rixv (n, fds, exprs, vals) < 0)
+		return (bad + n);
+	    for (i = 0; i < n; i++)
+		if (vals[i] != i*VALMUL + seq[i]++)
+		    bad++;
+	}
+	return (bad);
+}
+
+/* start the loopback stand-in on an unused port.
+ * return the port, else -1.
+ */
+static int
+startServer ()
+{
+	struct sockaddr_in sa;
+	socklen_t len = sizeof(sa);
+	pthread_t thr;
+	int *fdp;
+	int fd;
+
+	fd = socket (AF_INET, SOCK_STREAM, 0);
+	if (fd < 0)
+	    return (-1);
+	memset (&sa, 0, sizeof(sa));
+	sa.sin_family = AF_INET;
+	sa.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+	sa.sin_port = 0;
+	if (bind (fd, (struct sockaddr *)&sa, sizeof(sa)) < 0
+			|| listen (fd, NNODES) < 0
+			|| getsockname (fd, (struct sockaddr *)&sa, &len) < 0) {
+	    close (fd);
+	    return (-1);
+	}
+
+	fdp = (int *) malloc (sizeof(int));
+	*fdp = fd;
+	if (pthread_create (&thr, NULL, acceptThread, fdp)) {
+	    close (fd);
+	    return (-1);
+	}
+	pthread_detach (thr);
+	return (ntohs (sa.sin_port));
+}
+
+/* accept connections forever, each served by its own nodeThread() */
+static void *
+acceptThread (void *arg)
+{
+	int sfd = *(int *)arg;
+
+	free (arg);
+	for (;;) {
+	    pthread_t thr;
+	    int *fdp;
+	    int fd;
+
+	    fd = accept (sfd, NULL, NULL);
+	    if (fd < 0) {
+		if (errno == EINTR)
+		    continue;
+		break;
+	    }
+	    fdp = (int *) malloc (sizeof(int));
+	    *fdp = fd;
+	    if (pthread_create (&thr, NULL, nodeThread, fdp)) {
+		close (fd);
+		free (fdp);
+		continue;
+	    }
+	    pthread_detach (thr);
+	}
+	return (NULL);
+}
+
+/* be one node: take the csimcd preamble as common_open() sends it, then answer
+ * each ';'-terminated expression after the delay.
+ */
+static void *
+nodeThread (void *arg)
+{
+	int fd = *(int *)arg;
+	Byte pre[3], haddr;
+	char expr[128], reply[32];
+	int n = 0, nq = 0;
+	char c;
+
+	free (arg);
+	if (read (fd, pre, 3) != 3)
+	    goto out;
+	haddr = NNODES + pre[0];
+	if (write (fd, &haddr, 1) != 1)
+	    goto out;
+
+	while (read (fd, &c, 1) == 1) {
+	    if (n < sizeof(expr)-1)
+		expr[n++] = c;
+	    if (c != ';')
+		continue;
+	    expr[n] = '\0';
+	    n = 0;
+	    if (delay > 0)
+		usleep (delay);
+	    if (strstr (expr, "pos"))
+		sprintf (reply, "%d\n", pre[0]*VALMUL + nq++);
+	    else
+		strcpy (reply, "0\n");
+	    if (write (fd, reply, strlen(reply)) < 0)
+		break;
+	}
+
+    out:
+	close (fd);
+	return (NULL);
+}
+
+static double
+secs (void)
+{
+	struct timeval tv;
+
+	gettimeofday (&tv, NULL);
+	return (tv.tv_sec + tv.tv_usec*1e-6);
+}
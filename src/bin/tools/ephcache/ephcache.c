@@ -0,0 +1,258 @@
+/* check and precompute the libastro Chebyshev ephemeris cache.
+ *
+ * with -c compares positions from the cache against the full series at many
+ * random times and exits 1 if any differ by more than the tolerance.
+ * with -w fits all bodies over the date range and saves them in a file which
+ * may later be given to ephc_load(). with -r such a file is loaded first.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/time.h>
+
+#include "P_.h"
+#include "astro.h"
+
+#define	DEFMJD1	36525.0		/* default range start, 2000 Jan 1 */
+#define	DEFMJD2	(DEFMJD1 + 40*365.25)	/* default range end, 40 years on */
+#define	DEFN	20000		/* default n random times to check */
+
+static void usage (char *p);
+static int check (double mjd1, double mjd2, int n, double tolas);
+static void series (int obj, double mjd, double q[5]);
+static void cached (int obj, double mjd, double q[5]);
+static double secs (void);
+
+static char *bnames[] = {
+    "Mercury", "Venus", "Mars", "Jupiter", "Saturn", "Uranus", "Neptune",
+    "Pluto", "Sun", "Moon",
+};
+#define	NB	(sizeof(bnames)/sizeof(bnames[0]))
+
+int
+main (int ac, char *av[])
+{
+	char *progname = av[0];
+	double mjd1 = DEFMJD1, mjd2 = DEFMJD2;
+	double tolas = 0;
+	char *wfile = NULL;
+	char *rfile = NULL;
+	int cflag = 0;
+	int n = DEFN;
+	char msg[1024];
+
+	while ((--ac > 0) && ((*++av)[0] == '-')) {
+	    char *s;
+	    for (s = av[0]+1; *s != '\0'; s++)
+		switch (*s) {
+		case 'c':
+		    cflag++;
+		    break;
+		case 'n':
+		    if (ac < 2)
+			usage(progname);
+		    n = atoi (*++av);
+		    ac--;
+		    break;
+		case 'r':
+		    if (ac < 2)
+			usage(progname);
+		    rfile = *++av;
+		    ac--;
+		    break;
+		case 't':
+		    if (ac < 2)
+			usage(progname);
+		    tolas = atof (*++av);
+		    ac--;
+		    break;
+		case 'w':
+		    if (ac < 2)
+			usage(progname);
+		    wfile = *++av;
+		    ac--;
+		    break;
+		default:
+		    usage(progname);
+		}
+	}
+
+	/* optional date range */
+	if (ac == 2) {
+	    mjd1 = atof (av[0]);
+	    mjd2 = atof (av[1]);
+	} else if (ac != 0)
+	    usage (progname);
+	if (mjd2 <= mjd1 || (!cflag && !wfile))
+	    usage (progname);
+
+	if (tolas > 0)
+	    ephc_settol (tolas);
+	else
+	    tolas = 0.001;
+
+	if (rfile && ephc_load (rfile, msg) < 0) {
+	    fprintf (stderr, "%s\n", msg);
+	    return (1);
+	}
+
+	if (wfile) {
+	    double t0 = secs();
+	    if (ephc_save (wfile, mjd1, mjd2, msg) < 0) {
+		fprintf (stderr, "%s\n", msg);
+		return (1);
+	    }
+	    printf ("Wrote %s for MJD %g .. %g in %.2f secs\n", wfile, mjd1,
+							mjd2, secs() - t0);
+	}
+
+	if (cflag)
+	    return (check (mjd1, mjd2, n, tolas));
+
+	return (0);
+}
+
+static void
+usage (char *p)
+{
+	fprintf (stderr, "Usage: %s [options] [mjd1 mjd2]\n", p);
+	fprintf (stderr, "Purpose: check or precompute the ephemeris cache.\n");
+	fprintf (stderr, "Options:\n");
+	fprintf (stderr, " -c       check cache against full series\n");
+	fprintf (stderr, " -n n     number of random times to check; default %d\n", DEFN);
+	fprintf (stderr, " -r file  load fitted segments from file first\n");
+	fprintf (stderr, " -t as    tolerance, arc seconds; default 0.001\n");
+	fprintf (stderr, " -w file  save fitted segments over range to file\n");
+	fprintf (stderr, "Default range is MJD %g .. %g\n", DEFMJD1, DEFMJD2);
+	exit (1);
+}
+
+/* compare cache and series for every body at n random times in the range.
+ * night-long runs of nearby times are used since that is the real pattern.
+ * return 0 if all within tolas arc seconds, else 1.
+ */
+static int
+check (double mjd1, double mjd2, int n, double tolas)
+{
+	double tol = degrad(tolas/3600.0);
+	double *t = (double *) malloc (n * sizeof(double));
+	double maxerr[NB];
+	double tser, tcache;
+	long hits, fits, rejects, misses;
+	int bad = 0;
+	int b, i;
+
+	if (!t) {
+	    fprintf (stderr, "No memory for %d times\n", n);
+	    return (1);
+	}
+	srand (1);
+	for (i = 0; i < n; i++) {
+	    if (i % 100 == 0)
+		t[i] = mjd1 + (mjd2 - mjd1)*(double)rand()/RAND_MAX;
+	    else
+		t[i] = t[i-1] + 0.5/100;	/* 100 steps thru half a day */
+	}
+
+	for (b = 0; b < NB; b++) {
+	    maxerr[b] = 0;
+	    for (i = 0; i < n; i++) {
+		double qs[5], qc[5], d;
+		int j;
+
+		series (b, t[i], qs);
+		cached (b, t[i], qc);
+		for (j = 0; j < (b == MOON ? 5 : 3); j++) {
+		    d = qc[j] - qs[j];
+		    d -= 2*PI*floor(d/(2*PI) + 0.5);
+		    if (j == 2)
+			d = (qc[j] - qs[j])/qs[j];
+		    if (fabs(d) > maxerr[b])
+			maxerr[b] = fabs(d);
+		}
+	    }
+	    printf ("%-8s max error %9.6f\"%s\n", bnames[b],
+			raddeg(maxerr[b])*3600, maxerr[b] > tol ? "  FAIL" : "");
+	    if (maxerr[b] > tol)
+		bad = 1;
+	}
+
+	/* timing, series then cache, all bodies */
+	tser = secs();
+	for (i = 0; i < n; i++)
+	    for (b = 0; b < NB; b++) {
+		double q[5];
+		series (b, t[i], q);
+	    }
+	tser = secs() - tser;
+	tcache = secs();
+	for (i = 0; i < n; i++)
+	    for (b = 0; b < NB; b++) {
+		double q[5];
+		cached (b, t[i], q);
+	    }
+	tcache = secs() - tcache;
+
+	ephc_stats (&hits, &fits, &rejects, &misses);
+	printf ("%d x %d positions: series %.3f secs, cache %.3f secs\n", n,
+							(int)NB, tser, tcache);
+	printf ("cache: %ld hits, %ld fits, %ld rejected, %ld misses\n", hits,
+							fits, rejects, misses);
+
+	free ((void *)t);
+	return (bad);
+}
+
+/* body b from the full series */
+static void
+series (int obj, double mjd, double q[5])
+{
+	double ret[6];
+
+	switch (obj) {
+	case SUN:
+	    vsop87 (mjd, SUN, 0.0, ret);
+	    q[0] = ret[0] - PI;
+	    q[1] = -ret[1];
+	    q[2] = ret[2];
+	    break;
+	case MOON:
+	    moon_series (mjd, &q[0], &q[1], &q[2], &q[3], &q[4]);
+	    break;
+	default:
+	    plan_series (mjd, obj, 0.0, q);
+	    break;
+	}
+}
+
+/* body b from the cache, or the series if the cache declines */
+static void
+cached (int obj, double mjd, double q[5])
+{
+	switch (obj) {
+	case SUN:
+	    if (ephc_sun (mjd, &q[0], &q[2], &q[1]) < 0)
+		series (obj, mjd, q);
+	    break;
+	case MOON:
+	    if (ephc_moon (mjd, &q[0], &q[1], &q[2], &q[3], &q[4]) < 0)
+		series (obj, mjd, q);
+	    break;
+	default:
+	    if (ephc_planet (mjd, obj, q) < 0)
+		series (obj, mjd, q);
+	    break;
+	}
+}
+
+/* current time in seconds */
+static double
+secs (void)
+{
+	struct timeval tv;
+
+	gettimeofday (&tv, NULL);
+	return (tv.tv_sec + tv.tv_usec*1e-6);
+}
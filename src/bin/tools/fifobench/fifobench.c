@@ -0,0 +1,290 @@
+/* time a stream of tracking offsets sent over a fifo pair to a server that
+ * answers each, first as text, as the daemons have always taken them, then
+ * as binary frames, see cliserv.c. the server is a child process that reads
+ * and answers just as telescoped's fifoio.c does. also check the server got
+ * every offset, exactly in binary and to the printed precision in text, and
+ * that it refused a frame sent before asking for binary.
+ * exit 0 if all is well, else 1.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+
+#include "P_.h"
+#include "astro.h"
+#include "circum.h"
+#include "telstatshm.h"
+#include "cliserv.h"
+
+#define	DEFN	20000		/* default n messages each way */
+#define	MAXERR	1e-3		/* allowed text sum error, arcsecs */
+
+static void usage (char *p);
+static void server (int fd[2]);
+static void reply (int fd[2], int binary, int code, char *fmt, ...);
+static double offset (int i);
+static double secs (void);
+
+int
+main (int ac, char *av[])
+{
+	char *progname = av[0];
+	char *dir = "/tmp";
+	char name[64];
+	char buf[1024];
+	char msg[1024];
+	int sfd[2], cfd[2];
+	double tsum[2], bsum[2], want[2], got[4];
+	double tt, tb;
+	BinMsg bm;
+	BinOffset off;
+	int n = DEFN;
+	int code, status, bad = 0;
+	int i;
+	pid_t pid;
+
+	while ((--ac > 0) && ((*++av)[0] == '-')) {
+	    char *s;
+	    for (s = av[0]+1; *s != '\0'; s++)
+		switch (*s) {
+		case 'd':
+		    if (ac < 2)
+			usage(progname);
+		    dir = *++av;
+		    ac--;
+		    break;
+		case 'n':
+		    if (ac < 2)
+			usage(progname);
+		    n = atoi (*++av);
+		    ac--;
+		    break;
+		default:
+		    usage(progname);
+		}
+	}
+	if (ac > 0 || n < 1)
+	    usage (progname);
+
+	/* fifos live in $TELHOME/comm */
+	if (setenv ("TELHOME", dir, 1) < 0) {
+	    perror ("TELHOME");
+	    return (1);
+	}
+	sprintf (buf, "%s/comm", dir);
+	if (mkdir (buf, 0775) < 0 && errno != EEXIST) {
+	    perror (buf);
+	    return (1);
+	}
+	sprintf (name, "fifobench%d", (int)getpid());
+	if (serv_conn (name, sfd, msg) < 0) {
+	    fprintf (stderr, "%s\n", msg);
+	    return (1);
+	}
+
+	/* server in a child, us the client */
+	pid = fork();
+	if (pid < 0) {
+	    perror ("fork");
+	    dis_conn (name, sfd);
+	    return (1);
+	}
+	if (pid == 0)
+	    server (sfd);
+	(void) close (sfd[0]);
+	(void) close (sfd[1]);
+	if (cli_conn (name, cfd, msg) < 0) {
+	    fprintf (stderr, "%s\n", msg);
+	    kill (pid, SIGTERM);
+	    dis_conn (name, sfd);
+	    return (1);
+	}
+
+	/* as text, formatted as a person might type them */
+	want[0] = want[1] = 0;
+	tt = secs();
+	for (i = 0; i < n; i++) {
+	    sprintf (buf, "Offset %.4f,%.4f", offset(i), -offset(i));
+	    if (cli_write (cfd, buf, msg) < 0 || cli_read (cfd, &code, buf,
+							sizeof(buf)) < 0) {
+		fprintf (stderr, "text: %s\n", msg);
+		bad++;
+		break;
+	    }
+	    want[0] += offset(i);
+	    want[1] -= offset(i);
+	}
+	tt = secs() - tt;
+
+	/* a frame before the hello must be refused, in text, and not taken */
+	off.ha = off.dec = 1;
+	if (bin_write (cfd, BM_OFFSET, 0, &off, sizeof(off), msg) < 0
+			    || cli_read (cfd, &code, buf, sizeof(buf)) < 0
+			    || code >= 0) {
+	    fprintf (stderr, "frame before hello was not refused\n");
+	    bad++;
+	}
+
+	/* as binary frames */
+	tb = secs();
+	if (bin_hello (cfd, msg) < 0) {
+	    fprintf (stderr, "%s\n", msg);
+	    bad++;
+	} else {
+	    for (i = 0; i < n; i++) {
+		off.ha = offset(i);
+		off.dec = -offset(i);
+		if (bin_write (cfd, BM_OFFSET, 0, &off, sizeof(off), msg) < 0) {
+		    fprintf (stderr, "binary: %s\n", msg);
+		    bad++;
+		    break;
+		}
+		if (bin_read (cfd, &bm) < 0) {
+		    fprintf (stderr, "binary: %s\n", bm.u.text);
+		    bad++;
+		    break;
+		}
+	    }
+	}
+	tb = secs() - tb;
+
+	/* what the server saw */
+	if (cli_write (cfd, "Sums", msg) < 0
+			    || cli_read (cfd, &code, buf, sizeof(buf)) < 0
+			    || sscanf (buf, "%lf %lf %lf %lf", &got[0], &got[1],
+						    &got[2], &got[3]) != 4) {
+	    fprintf (stderr, "sums: %s\n", buf);
+	    bad++;
+	    got[0] = got[1] = got[2] = got[3] = 0;
+	}
+	tsum[0] = got[0];
+	tsum[1] = got[1];
+	bsum[0] = got[2];
+	bsum[1] = got[3];
+	(void) cli_write (cfd, "Quit", msg);
+	(void) waitpid (pid, &status, 0);
+	(void) close (cfd[0]);
+	(void) close (cfd[1]);
+	dis_conn (name, sfd);
+
+	printf ("%d offsets: text %.3f secs, %.0f/sec; binary %.3f secs, %.0f/sec; %.1fx\n",
+			    n, tt, tt > 0 ? n/tt : 0.0, tb, tb > 0 ? n/tb : 0.0,
+			    tb > 0 ? tt/tb : 0.0);
+	printf ("sums: text off by %.2g, binary by %.2g arcsecs\n",
+		    fmax (fabs(tsum[0]-want[0]), fabs(tsum[1]-want[1])),
+		    fmax (fabs(bsum[0]-want[0]), fabs(bsum[1]-want[1])));
+
+	/* text is only as good as its digits, binary must be exact */
+	if (fabs(tsum[0]-want[0]) > MAXERR || fabs(tsum[1]-want[1]) > MAXERR)
+	    bad++;
+	if (bsum[0] != want[0] || bsum[1] != want[1])
+	    bad++;
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+	    bad++;
+
+	return (bad > 0);
+}
+
+static void
+usage (char *p)
+{
+	fprintf (stderr, "Usage: %s [options]\n", p);
+	fprintf (stderr, "Purpose: time text vs binary fifo messages.\n");
+	fprintf (stderr, "Options:\n");
+	fprintf (stderr, " -d dir  TELHOME for the fifos; default /tmp\n");
+	fprintf (stderr, " -n n    offsets sent each way; default %d\n", DEFN);
+	exit (1);
+}
+
+/* read and answer offsets on fd as telescoped would, summing what comes in
+ * each way, until told to quit. never returns.
+ */
+static void
+server (int fd[2])
+{
+	double tsum[2], bsum[2];
+	int binary = 0;
+	int binok = 0;
+	BinMsg bm;
+	double a, b;
+	int n;
+
+	tsum[0] = tsum[1] = bsum[0] = bsum[1] = 0;
+	while (1) {
+	    n = serv_readbin (fd, &bm);
+	    if (n < 0) {
+		fprintf (stderr, "server: %s\n", bm.u.text);
+		exit (1);
+	    }
+	    binary = n;
+	    if (n == 0 && strcasecmp (bm.u.text, BIN_HELLO) == 0) {
+		reply (fd, 0, 0, "%s", BIN_HELLO);
+		binok = 1;
+	    } else if (n == 1 && !binok) {
+		reply (fd, 0, -1, "Binary frame before %s", BIN_HELLO);
+	    } else if (n == 0 && sscanf (bm.u.text, "Offset %lf,%lf", &a, &b)
+									== 2) {
+		tsum[0] += a;
+		tsum[1] += b;
+		reply (fd, binary, 0, "Offset %g,%g", a, b);
+	    } else if (n == 0 && strcmp (bm.u.text, "Sums") == 0) {
+		reply (fd, binary, 0, "%.17g %.17g %.17g %.17g", tsum[0],
+						    tsum[1], bsum[0], bsum[1]);
+	    } else if (n == 0 && strcmp (bm.u.text, "Quit") == 0) {
+		exit (0);
+	    } else if (n == 1 && bm.h.type == BM_OFFSET) {
+		bsum[0] += bm.u.offset.ha;
+		bsum[1] += bm.u.offset.dec;
+		reply (fd, binary, 0, "Offset %g,%g", bm.u.offset.ha,
+							    bm.u.offset.dec);
+	    } else
+		reply (fd, binary, -1, "Unknown command");
+	}
+}
+
+/* answer as fifoWrite() does */
+static void
+reply (int fd[2], int binary, int code, char *fmt, ...)
+{
+	char buf[1024];
+	char err[1024];
+	va_list ap;
+	int n;
+
+	va_start (ap, fmt);
+	vsprintf (buf, fmt, ap);
+	va_end (ap);
+
+	if (binary)
+	    n = bin_write (fd, BM_TEXT, code, buf, strlen(buf)+1, err);
+	else
+	    n = serv_write (fd, code, buf, err);
+	if (n < 0)
+	    fprintf (stderr, "server: %s\n", err);
+}
+
+/* the i'th offset, arcsecs, exact in text to 4 places */
+static double
+offset (int i)
+{
+	return (((i*37) % 2001 - 1000)/1e4);
+}
+
+static double
+secs (void)
+{
+	struct timeval tv;
+
+	gettimeofday (&tv, NULL);
+	return (tv.tv_sec + tv.tv_usec*1e-6);
+}
@@ -0,0 +1,674 @@
+/* compare the lmfit() Levenberg-Marquardt solver with the lstsqr() amoeba
+ * on the two nonlinear fits moved from one to the other: the 5 parameter
+ * mount model of tel_solve_axes() and the 1-d star profiles of gaussfit().
+ *
+ * the mount model is fit to a pointing mesh read from a file of "H D X Y"
+ * lines as used by mntmodel, or else to a synthetic mesh made from a known
+ * model. both solvers start from the same 2 star closed-form model.
+ *
+ * the gaussians are fit to row and column cutouts around each star found in
+ * a FITS file, or else to synthetic noisy star profiles.
+ *
+ * for each, reports function evaluations, wall time and goodness of fit.
+ * exit 0 if lmfit() fits at least as well as lstsqr() did, else 1.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "P_.h"
+#include "astro.h"
+#include "circum.h"
+#include "fits.h"
+#include "lstsqr.h"
+#include "misc.h"
+#include "strops.h"
+#include "telstatshm.h"
+
+extern void gaussfit (int pix[], int n, double *maxp, double *cenp,
+    double *fwhmp);
+
+#define	NMESH		40	/* synthetic mesh points */
+#define	MESHNOISE	10.0	/* synthetic mesh encoder noise, arcsec rms */
+#define	MFTOL		1e-6	/* mount model fractional tolerance */
+#define	NSTARS		500	/* synthetic stars */
+#define	NSPIX		15	/* synthetic cutout length, pixels */
+#define	GFTOL		.0001	/* gaussian fractional tolerance, as gaussfit.c */
+#define	RTOL		1.01	/* lmfit() must fit to within this of lstsqr() */
+
+/* a pointing mesh, with a count of model evaluations */
+typedef struct {
+    int n;
+    double *H, *D, *X, *Y;
+    TelAxes tax;		/* flags for the model */
+    int nevals;
+} Mesh;
+
+/* one cutout, with a count of model evaluations */
+typedef struct {
+    int n;
+    int *pix;
+    int nevals;
+} Cut;
+
+static void usage (char *p);
+static int readMesh (char *fn, Mesh *mp);
+static void mkMesh (Mesh *mp);
+static int benchMesh (Mesh *mp);
+static double meshChisqr (double p[], void *arg);
+static int meshResid (double p[], double r[], void *arg);
+static double meshRMS (Mesh *mp, double p[]);
+static int readCuts (char *fn, Cut **cpp, double **truep);
+static void mkCuts (Cut **cpp, double **truep);
+static int benchGauss (Cut *cuts, int ncuts, double *truecen);
+static void gaussGuess (Cut *cp, double p0[3], double p1[3]);
+static double gChisqr (double p[], void *arg);
+static int gResid (double p[], double r[], void *arg);
+static void gJac (double p[], double J[], void *arg);
+static double gauss (void);
+static double secs (void);
+
+int
+main (int ac, char *av[])
+{
+	char *meshfn = NULL, *ftsfn = NULL;
+	Mesh mesh;
+	Cut *cuts;
+	double *truecen;
+	int ncuts;
+	int bad = 0;
+
+	while ((--ac > 0) && ((*++av)[0] == '-')) {
+	    char *s;
+	    for (s = av[0]+1; *s != '\0'; s++)
+		switch (*s) {
+		case 'f':
+		    if (ac < 2)
+			usage ("fitbench");
+		    ftsfn = *++av;
+		    ac--;
+		    break;
+		case 'i':
+		    if (ac < 2)
+			usage ("fitbench");
+		    setIpCfgPath (*++av);
+		    ac--;
+		    break;
+		case 'm':
+		    if (ac < 2)
+			usage ("fitbench");
+		    meshfn = *++av;
+		    ac--;
+		    break;
+		default:
+		    usage ("fitbench");
+		}
+	}
+	if (ac > 0)
+	    usage ("fitbench");
+
+	srand (1);
+
+	memset ((void *)&mesh, 0, sizeof(mesh));
+	if (meshfn) {
+	    if (readMesh (meshfn, &mesh) < 0)
+		return (1);
+	} else
+	    mkMesh (&mesh);
+	bad |= benchMesh (&mesh);
+
+	if (ftsfn) {
+	    ncuts = readCuts (ftsfn, &cuts, &truecen);
+	    if (ncuts < 0)
+		return (1);
+	} else {
+	    mkCuts (&cuts, &truecen);
+	    ncuts = 2*NSTARS;
+	}
+	bad |= benchGauss (cuts, ncuts, truecen);
+
+	printf ("%s\n", bad ? "FAIL" : "lmfit ok");
+	return (bad);
+}
+
+static void
+usage (char *p)
+{
+	fprintf (stderr, "Usage: %s [options]\n", p);
+	fprintf (stderr, "Purpose: compare lmfit() with lstsqr() on mount models and star profiles.\n");
+	fprintf (stderr, "Options:\n");
+	fprintf (stderr, " -m file: pointing mesh of H D X Y lines, as for mntmodel; default is synthetic\n");
+	fprintf (stderr, " -f file: FITS frame whose stars to fit; default is synthetic\n");
+	fprintf (stderr, " -i file: ip.cfg to use with -f\n");
+	exit (1);
+}
+
+/* read "H D X Y" lines from fn into mp.
+ * return 0 if ok, else -1.
+ */
+static int
+readMesh (char *fn, Mesh *mp)
+{
+	char buf[1024];
+	FILE *fp;
+	int n;
+
+	fp = fopen (fn, "r");
+	if (!fp) {
+	    perror (fn);
+	    return (-1);
+	}
+	mp->H = (double *) malloc (sizeof(double));
+	mp->D = (double *) malloc (sizeof(double));
+	mp->X = (double *) malloc (sizeof(double));
+	mp->Y = (double *) malloc (sizeof(double));
+	for (n = 0; fgets (buf, sizeof(buf), fp); ) {
+	    if (sscanf (buf, "%lf %lf %lf %lf", &mp->H[n], &mp->D[n],
+						&mp->X[n], &mp->Y[n]) == 4) {
+		n++;
+		mp->H = (double *) realloc (mp->H, (n+1)*sizeof(double));
+		mp->D = (double *) realloc (mp->D, (n+1)*sizeof(double));
+		mp->X = (double *) realloc (mp->X, (n+1)*sizeof(double));
+		mp->Y = (double *) realloc (mp->Y, (n+1)*sizeof(double));
+	    }
+	}
+	fclose (fp);
+	if (n < 3) {
+	    fprintf (stderr, "%s: need 3 or more points but found %d\n", fn, n);
+	    return (-1);
+	}
+	mp->n = n;
+	printf ("mount model: %d points from %s\n", n, fn);
+	return (0);
+}
+
+/* make a mesh of NMESH points over the sky from a known model */
+static void
+mkMesh (Mesh *mp)
+{
+	TelAxes tax;
+	double s = degrad(MESHNOISE/3600.0);
+	int i;
+
+	memset ((void *)&tax, 0, sizeof(tax));
+	tax.HT = 0.01;
+	tax.DT = degrad(45.0);
+	tax.XP = 3.1;
+	tax.YC = 1.5;
+	tax.NP = 0.002;
+
+	mp->n = NMESH;
+	mp->H = (double *) malloc (NMESH*sizeof(double));
+	mp->D = (double *) malloc (NMESH*sizeof(double));
+	mp->X = (double *) malloc (NMESH*sizeof(double));
+	mp->Y = (double *) malloc (NMESH*sizeof(double));
+	for (i = 0; i < NMESH; i++) {
+	    double x, y;
+
+	    mp->H[i] = degrad(-75.0 + 150.0*rand()/RAND_MAX);
+	    mp->D[i] = degrad(-20.0 + 100.0*rand()/RAND_MAX);
+	    tel_hadec2xy (mp->H[i], mp->D[i], &tax, &x, &y);
+	    tel_ideal2realxy (&tax, &x, &y);
+	    mp->X[i] = x + s*gauss();
+	    mp->Y[i] = y + s*gauss();
+	}
+	printf ("mount model: %d synthetic points, %g\" noise\n", NMESH,
+								MESHNOISE);
+}
+
+/* fit the mesh with both solvers and with tel_solve_axes().
+ * return 0 if lmfit() does as well as lstsqr(), else 1.
+ */
+static int
+benchMesh (Mesh *mp)
+{
+	TelAxes seed, tax;
+	double p0[5], p1[5], pa[5], pl[5];
+	double *fit;
+	double ta, tl, tt, ra, rl, rt;
+	int i, sa, sl, st;
+
+	/* closed form seed from the first 2 points, as tel_solve_axes() */
+	memset ((void *)&seed, 0, sizeof(seed));
+	seed.HT = 0;
+	seed.DT = degrad(45.0);
+	seed.XP = 3;
+	seed.YC = 1.3;
+	fit = (double *) malloc (mp->n*sizeof(double));
+	if (tel_solve_axes (mp->H, mp->D, mp->X, mp->Y, 2, MFTOL, &seed,
+								fit) < 0) {
+	    printf ("mount model: no 2 point solution  FAIL\n");
+	    return (1);
+	}
+	mp->tax = seed;
+	p0[0] = seed.HT;
+	p0[1] = seed.DT;
+	p0[2] = seed.XP;
+	p0[3] = seed.YC;
+	p0[4] = seed.NP;
+
+	/* the amoeba as telaxes.c used it */
+	for (i = 0; i < 5; i++)
+	    pa[i] = p0[i];
+	p1[0] = 1.05*p0[0] + 0.05;
+	p1[1] = 1.05*p0[1] + 0.05;
+	p1[2] = 1.05*p0[2] + 0.05;
+	p1[3] = 1.05*p0[3] + 0.05;
+	p1[4] = p0[4] + 0.05;
+	mp->nevals = 0;
+	ta = secs();
+	sa = lstsqr_r (meshChisqr, (void *)mp, pa, p1, 5, MFTOL);
+	ta = secs() - ta;
+	ra = meshRMS (mp, pa);
+	if (sa < 0)
+	    printf ("mount model: lstsqr %6d evals %9.6f secs, did not converge, rms %8.2f\"\n",
+						    mp->nevals, ta, ra);
+	else
+	    printf ("mount model: lstsqr %6d evals %9.6f secs, rms %8.2f\"\n",
+						    mp->nevals, ta, ra);
+
+	/* levenberg-marquardt */
+	for (i = 0; i < 5; i++)
+	    pl[i] = p0[i];
+	mp->nevals = 0;
+	tl = secs();
+	sl = lmfit (meshResid, NULL, (void *)mp, pl, 5, 2*mp->n, MFTOL);
+	tl = secs() - tl;
+	rl = meshRMS (mp, pl);
+	printf ("mount model: lmfit  %6d evals %9.6f secs, %d steps, rms %8.2f\"\n",
+						mp->nevals, tl, sl, rl);
+
+	/* and the real thing */
+	tax = seed;
+	tt = secs();
+	st = tel_solve_axes (mp->H, mp->D, mp->X, mp->Y, mp->n, MFTOL, &tax,
+									fit);
+	tt = secs() - tt;
+	pl[0] = tax.HT;
+	pl[1] = tax.DT;
+	pl[2] = tax.XP;
+	pl[3] = tax.YC;
+	pl[4] = tax.NP;
+	rt = meshRMS (mp, pl);
+	printf ("mount model: tel_solve_axes   %9.6f secs, rms %8.2f\"\n",
+								    tt, rt);
+	free ((void *)fit);
+
+	if (sl < 0 || st < 0 || rl > RTOL*ra || rt > RTOL*ra) {
+	    printf ("mount model: lmfit worse than lstsqr  FAIL\n");
+	    return (1);
+	}
+	return (0);
+}
+
+/* the chisqr telaxes.c gave lstsqr() */
+static double
+meshChisqr (double p[], void *arg)
+{
+	Mesh *mp = (Mesh *)arg;
+	TelAxes tax = mp->tax;
+	double err = 0.0;
+	int i;
+
+	mp->nevals++;
+	tax.HT = p[0];
+	tax.DT = p[1];
+	tax.XP = p[2];
+	tax.YC = p[3];
+	tax.NP = p[4];
+	if (fabs(tax.DT) > degrad(90.0))
+	    return (100.0);
+	for (i = 0; i < mp->n; i++) {
+	    double x = mp->X[i];
+	    double y = mp->Y[i];
+	    double h, d, ca;
+
+	    tel_realxy2ideal (&tax, &x, &y);
+	    tel_xy2hadec (x, y, &tax, &h, &d);
+	    solve_sphere (h-mp->H[i], PI/2-mp->D[i], sin(d), cos(d), &ca, NULL);
+	    err += acos(ca);
+	}
+	return (err + 1);
+}
+
+/* the residuals telaxes.c gives lmfit() */
+static int
+meshResid (double p[], double r[], void *arg)
+{
+	Mesh *mp = (Mesh *)arg;
+	TelAxes tax = mp->tax;
+	int i;
+
+	mp->nevals++;
+	tax.HT = p[0];
+	tax.DT = p[1];
+	tax.XP = p[2];
+	tax.YC = p[3];
+	tax.NP = p[4];
+	if (fabs(tax.DT) > degrad(90.0))
+	    return (-1);
+	for (i = 0; i < mp->n; i++) {
+	    double x = mp->X[i];
+	    double y = mp->Y[i];
+	    double h, d;
+
+	    tel_realxy2ideal (&tax, &x, &y);
+	    tel_xy2hadec (x, y, &tax, &h, &d);
+	    h -= mp->H[i];
+	    haRange (&h);
+	    if (h > PI)
+		h -= 2*PI;
+	    r[2*i] = h*cos(mp->D[i]);
+	    r[2*i+1] = d - mp->D[i];
+	}
+	return (0);
+}
+
+/* rms angular error of model p over the mesh, arcsec */
+static double
+meshRMS (Mesh *mp, double p[])
+{
+	TelAxes tax = mp->tax;
+	double sum2 = 0;
+	int i;
+
+	tax.HT = p[0];
+	tax.DT = p[1];
+	tax.XP = p[2];
+	tax.YC = p[3];
+	tax.NP = p[4];
+	for (i = 0; i < mp->n; i++) {
+	    double x = mp->X[i];
+	    double y = mp->Y[i];
+	    double h, d, ca, e;
+
+	    tel_realxy2ideal (&tax, &x, &y);
+	    tel_xy2hadec (x, y, &tax, &h, &d);
+	    solve_sphere (h-mp->H[i], PI/2-mp->D[i], sin(d), cos(d), &ca, NULL);
+	    e = raddeg(acos(ca))*3600;
+	    sum2 += e*e;
+	}
+	return (sqrt(sum2/mp->n));
+}
+
+/* find the stars in FITS file fn and make a row and column cutout, less
+ * sky, across each, as starStats() does for gaussfit(). *truep is NULL.
+ * return number of cutouts, else -1.
+ */
+static int
+readCuts (char *fn, Cut **cpp, double **truep)
+{
+	char msg[1024];
+	StarStats *ssp;
+	CamPixel *im;
+	FImage fim;
+	Cut *cuts;
+	int fd, ns, nc, i;
+
+	fd = open (fn, O_RDONLY);
+	if (fd < 0) {
+	    perror (fn);
+	    return (-1);
+	}
+	initFImage (&fim);
+	if (readFITS (fd, &fim, msg) < 0) {
+	    fprintf (stderr, "%s: %s\n", fn, msg);
+	    close (fd);
+	    return (-1);
+	}
+	close (fd);
+
+	ns = findStatStars (fim.image, fim.sw, fim.sh, &ssp);
+	if (ns <= 0) {
+	    fprintf (stderr, "%s: no stars\n", fn);
+	    return (-1);
+	}
+
+	im = (CamPixel *)fim.image;
+	cuts = (Cut *) malloc (2*ns*sizeof(Cut));
+	for (nc = i = 0; i < ns; i++) {
+	    StarStats *sp = &ssp[i];
+	    int r = MINGAUSSR, n = 2*r+1, j;
+	    int *row, *col;
+
+	    if (sp->bx - r < 0 || sp->bx + r >= fim.sw || sp->by - r < 0
+						    || sp->by + r >= fim.sh)
+		continue;
+	    row = (int *) malloc (n*sizeof(int));
+	    col = (int *) malloc (n*sizeof(int));
+	    for (j = 0; j < n; j++) {
+		row[j] = (int)im[fim.sw*sp->by + sp->bx - r + j] - sp->Sky;
+		col[j] = (int)im[fim.sw*(sp->by - r + j) + sp->bx] - sp->Sky;
+	    }
+	    cuts[nc].n = n;
+	    cuts[nc++].pix = row;
+	    cuts[nc].n = n;
+	    cuts[nc++].pix = col;
+	}
+	free ((void *)ssp);
+	resetFImage (&fim);
+
+	printf ("star profiles: %d cutouts from %d stars in %s\n", nc, ns, fn);
+	*cpp = cuts;
+	*truep = NULL;
+	return (nc);
+}
+
+/* make 2*NSTARS synthetic cutouts of NSPIX with known centers in *truep */
+static void
+mkCuts (Cut **cpp, double **truep)
+{
+	Cut *cuts = (Cut *) malloc (2*NSTARS*sizeof(Cut));
+	double *tc = (double *) malloc (2*NSTARS*sizeof(double));
+	int i, j;
+
+	for (i = 0; i < 2*NSTARS; i++) {
+	    double amp = 200*pow (100.0, (double)rand()/RAND_MAX);
+	    double sig = 0.8 + 2.0*rand()/RAND_MAX;
+	    double cen = NSPIX/2 - 1 + 2.0*rand()/RAND_MAX;
+	    int *pix = (int *) malloc (NSPIX*sizeof(int));
+
+	    for (j = 0; j < NSPIX; j++) {
+		double dx = j - cen;
+		double v = amp*exp(-dx*dx/(2*sig*sig));
+
+		pix[j] = (int) floor (v + sqrt(v + 100)*gauss() + 0.5);
+	    }
+	    cuts[i].n = NSPIX;
+	    cuts[i].pix = pix;
+	    tc[i] = cen;
+	}
+
+	printf ("star profiles: %d synthetic cutouts of %d pixels\n",
+							    2*NSTARS, NSPIX);
+	*cpp = cuts;
+	*truep = tc;
+}
+
+/* fit each cutout with both solvers and with gaussfit().
+ * return 0 if lmfit() does as well as lstsqr(), else 1.
+ */
+static int
+benchGauss (Cut *cuts, int ncuts, double *truecen)
+{
+	double ta = 0, tl = 0, tg, t;
+	double ca = 0, cl = 0, dc2 = 0, ea2 = 0, el2 = 0;
+	int na = 0, nl = 0, fa = 0, fl = 0;
+	int i;
+
+	for (i = 0; i < ncuts; i++) {
+	    Cut *cp = &cuts[i];
+	    double p0[3], p1[3], pa[3], pl[3];
+	    int s;
+
+	    gaussGuess (cp, p0, p1);
+
+	    memcpy ((void *)pa, (void *)p0, sizeof(pa));
+	    cp->nevals = 0;
+	    t = secs();
+	    s = lstsqr_r (gChisqr, (void *)cp, pa, p1, 3, GFTOL);
+	    ta += secs() - t;
+	    na += cp->nevals;
+	    if (s < 0)
+		fa++;
+	    ca += gChisqr (pa, (void *)cp);
+
+	    memcpy ((void *)pl, (void *)p0, sizeof(pl));
+	    cp->nevals = 0;
+	    t = secs();
+	    s = lmfit (gResid, gJac, (void *)cp, pl, 3, cp->n, GFTOL);
+	    tl += secs() - t;
+	    nl += cp->nevals;
+	    if (s < 0)
+		fl++;
+	    cl += gChisqr (pl, (void *)cp);
+
+	    dc2 += (pa[1]-pl[1])*(pa[1]-pl[1]);
+	    if (truecen) {
+		ea2 += (pa[1]-truecen[i])*(pa[1]-truecen[i]);
+		el2 += (pl[1]-truecen[i])*(pl[1]-truecen[i]);
+	    }
+	}
+
+	tg = secs();
+	for (i = 0; i < ncuts; i++) {
+	    double max, cen, fwhm;
+	    gaussfit (cuts[i].pix, cuts[i].n, &max, &cen, &fwhm);
+	}
+	tg = secs() - tg;
+
+	printf ("star profiles: lstsqr %6.1f evals %8.2f us/fit, %d failed, sum chisqr %.6g\n",
+			(double)na/ncuts, 1e6*ta/ncuts, fa, ca);
+	printf ("star profiles: lmfit  %6.1f evals %8.2f us/fit, %d failed, sum chisqr %.6g\n",
+			(double)nl/ncuts, 1e6*tl/ncuts, fl, cl);
+	printf ("star profiles: gaussfit       %8.2f us/fit\n", 1e6*tg/ncuts);
+	printf ("star profiles: rms center difference %.4f pixels\n",
+							sqrt(dc2/ncuts));
+	if (truecen)
+	    printf ("star profiles: rms center error lstsqr %.4f lmfit %.4f pixels\n",
+				    sqrt(ea2/ncuts), sqrt(el2/ncuts));
+
+	if (fl > fa || cl > RTOL*ca) {
+	    printf ("star profiles: lmfit worse than lstsqr  FAIL\n");
+	    return (1);
+	}
+	return (0);
+}
+
+/* starting guesses for a cutout, as gaussfit() */
+static void
+gaussGuess (Cut *cp, double p0[3], double p1[3])
+{
+	int *pix = cp->pix, n = cp->n;
+	int min, max, avg, maxi, halfw;
+	double sigma;
+	int i;
+
+	maxi = 0;
+	min = max = pix[maxi];
+	for (i = 1; i < n; i++) {
+	    if (pix[i] > max) {
+		max = pix[i];
+		maxi = i;
+	    }
+	    if (pix[i] < min)
+		min = pix[i];
+	}
+	halfw = 1;
+	avg = (max+min)/2;
+	for (i = maxi+1; i < n; i++)
+	    if (pix[i] < avg) {
+		halfw = i-maxi;
+		break;
+	    }
+	for (i = maxi-1; i >= 0; --i)
+	    if (pix[i] < avg) {
+		if (maxi-i > halfw)
+		    halfw = maxi-i;
+		break;
+	    }
+	sigma = 0.85*sqrt((double)halfw);
+
+	p0[0] = (double)max;
+	p0[1] = (double)maxi;
+	p0[2] = sigma;
+	p1[0] = (double)max*1.1;
+	p1[1] = (double)maxi+2;
+	p1[2] = sigma+1.0;
+}
+
+/* the chisqr gaussfit.c gave lstsqr() */
+static double
+gChisqr (double p[], void *arg)
+{
+	Cut *cp = (Cut *)arg;
+	double cs = 0;
+	int i;
+
+	cp->nevals++;
+	for (i = 0; i < cp->n; i++) {
+	    double dx = i - p[1];
+	    double e = p[0]*exp(-(dx*dx)/(2*p[2]*p[2])) - cp->pix[i];
+	    cs += e*e;
+	}
+	return (cs);
+}
+
+/* the residuals and derivatives gaussfit.c gives lmfit() */
+static int
+gResid (double p[], double r[], void *arg)
+{
+	Cut *cp = (Cut *)arg;
+	int i;
+
+	cp->nevals++;
+	if (p[2] == 0)
+	    return (-1);
+	for (i = 0; i < cp->n; i++) {
+	    double dx = i - p[1];
+	    r[i] = p[0]*exp(-(dx*dx)/(2*p[2]*p[2])) - cp->pix[i];
+	}
+	return (0);
+}
+
+static void
+gJac (double p[], double J[], void *arg)
+{
+	Cut *cp = (Cut *)arg;
+	double s2 = p[2]*p[2];
+	int i;
+
+	cp->nevals++;
+	for (i = 0; i < cp->n; i++) {
+	    double dx = i - p[1];
+	    double e = exp(-(dx*dx)/(2*s2));
+
+	    J[3*i+0] = e;
+	    J[3*i+1] = p[0]*e*dx/s2;
+	    J[3*i+2] = p[0]*e*dx*dx/(s2*p[2]);
+	}
+}
+
+/* gaussian deviate with unit variance */
+static double
+gauss (void)
+{
+	double u1 = (rand() + 1.0)/(RAND_MAX + 2.0);
+	double u2 = (rand() + 1.0)/(RAND_MAX + 2.0);
+
+	return (sqrt(-2*log(u1))*cos(2*PI*u2));
+}
+
+static double
+secs (void)
+{
+	struct timeval tv;
+
+	gettimeofday (&tv, NULL);
+	return (tv.tv_sec + tv.tv_usec*1e-6);
+}
@@ -0,0 +1,656 @@
+/* plan a night's scans with the nightsched engine, allowing for slews, dome
+ * and filter changes, and compare with the slot greedy rules of telsched's
+ * sortscans().
+ *
+ * then, as a check on ns_next() as used by telrun -r, each plan is run
+ * with the weather closing in for a while a third of the way through the night,
+ * once in strict order, where each scan whose time has gone by is lost, and
+ * once picking what to do next with ns_next() each time a scan ends.
+ *
+ * the scans come from the New entries of a .sls file or, with -n, are made up.
+ * the site, limits and axis speeds come from telsched.cfg, telescoped.cfg and
+ * camera.cfg if they can be found, else are those of RAO; -t always uses the
+ * latter and a fixed night, and exits 0 only if both plans check out, the
+ * optimised one is worth at least as much as the greedy one and re-planning
+ * gets at least as much exposure as strict order.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <sys/time.h>
+
+#include "P_.h"
+#include "astro.h"
+#include "circum.h"
+#include "configfile.h"
+#include "telenv.h"
+#include "scan.h"
+#include "nightsched.h"
+
+#define	DEFNSCANS	300	/* default made up scans */
+#define	DEFITERS	20000	/* default moves per search */
+#define	TESTNSCANS	200	/* made up scans for -t */
+#define	TESTITERS	5000	/* moves per search for -t */
+#define	TESTTHREADS	2	/* searches for -t */
+#define	TESTMJD		45608.5	/* night for -t: 2024/11/13 */
+#define	DEFWX		1.0	/* default weather outage, hrs */
+
+static void usage (char *p);
+static void initSite (Now *np, NSSite *sp, int usecfg);
+static int readJobs (char *fn, Now *np, int wflag, SLSMap *mp, NSJob **jpp,
+    int **idxp);
+static int makeJobs (Now *np, NSSite *sp, int n, unsigned seed, NSJob **jpp);
+static void report (char *name, NSStats *stp, double night);
+static int replay (NSNight *nnp, NSSite *sp, NSJob *jobs, int n,
+    double plan[], char *name, double wx);
+static double lstat (NSSite *sp, double t);
+static int writeSLS (char *fn, SLSMap *mp, NSJob *jobs, int idx[], int n);
+static void pr1 (FILE *fp, Scan *sp);
+static double secs (void);
+
+static double CAMDIG_MAX = 5;	/* readout, secs */
+
+int
+main (int ac, char *av[])
+{
+	char *progname = av[0];
+	char *outfn = NULL;
+	int nthreads = 0, iters = DEFITERS, nscans = 0, test = 0;
+	int vflag = 0, wflag = 0;
+	unsigned seed = 1;
+	double night = 0, wx = DEFWX;
+	NSStats gst, ost;
+	SLSMap slsmap;
+	NSSite site;
+	NSJob *jobs;
+	NSNight *nnp;
+	int *idx = NULL;
+	char buf[1024];
+	double t0;
+	Now now;
+	double *gstart, *ostart;
+	int i, n, bad = 0;
+
+	while ((--ac > 0) && ((*++av)[0] == '-')) {
+	    char *s;
+	    for (s = av[0]+1; *s != '\0'; s++)
+		switch (*s) {
+		case 'd':
+		    if (ac < 2)
+			usage(progname);
+		    night = atof (*++av) - MJD0;
+		    ac--;
+		    break;
+		case 'i':
+		    if (ac < 2)
+			usage(progname);
+		    iters = atoi (*++av);
+		    ac--;
+		    break;
+		case 'j':
+		    if (ac < 2)
+			usage(progname);
+		    nthreads = atoi (*++av);
+		    ac--;
+		    break;
+		case 'n':
+		    if (ac < 2)
+			usage(progname);
+		    nscans = atoi (*++av);
+		    ac--;
+		    break;
+		case 'o':
+		    if (ac < 2)
+			usage(progname);
+		    outfn = *++av;
+		    ac--;
+		    break;
+		case 's':
+		    if (ac < 2)
+			usage(progname);
+		    seed = (unsigned) atoi (*++av);
+		    ac--;
+		    break;
+		case 't':
+		    test++;
+		    break;
+		case 'v':
+		    vflag++;
+		    break;
+		case 'w':
+		    wflag++;
+		    break;
+		case 'x':
+		    if (ac < 2)
+			usage(progname);
+		    wx = atof (*++av);
+		    ac--;
+		    break;
+		default:
+		    usage(progname);
+		}
+	}
+	if (ac > 1 || (!test && (ac == 1) == (nscans > 0)) || (outfn && ac != 1))
+	    usage (progname);
+	if (test) {
+	    night = TESTMJD;
+	    if (!nscans)
+		nscans = TESTNSCANS;
+	    iters = TESTITERS;
+	    nthreads = TESTTHREADS;
+	}
+
+	/* the night starting on the given day, else tonight */
+	memset ((void *)&now, 0, sizeof(now));
+	now.n_mjd = night ? mjd_day(night) : mjd_day(25567.5 + time(NULL)/SPD);
+	now.n_epoch = EOD;
+	initSite (&now, &site, !test);
+
+	memset ((void *)&slsmap, 0, sizeof(slsmap));
+	if (ac == 1)
+	    n = readJobs (av[0], &now, wflag, &slsmap, &jobs, &idx);
+	else
+	    n = makeJobs (&now, &site, nscans, seed, &jobs);
+	if (n < 0)
+	    return (1);
+
+	nnp = ns_open (&site, jobs, n);
+	if (!nnp) {
+	    fprintf (stderr, "No memory for %d scans\n", n);
+	    return (1);
+	}
+
+	fs_date (buf, mjd_day(site.dusk));
+	printf ("Night of %s: %.2f hrs dusk to dawn, %d scans\n", buf,
+					    (site.dawn - site.dusk)*24, n);
+
+	ns_greedy (nnp, &gst);
+	gstart = (double *) malloc ((n+1)*sizeof(double));
+	ostart = (double *) malloc ((n+1)*sizeof(double));
+	if (!gstart || !ostart) {
+	    fprintf (stderr, "No memory for %d scans\n", n);
+	    return (1);
+	}
+	for (i = 0; i < n; i++)
+	    gstart[i] = jobs[i].start;
+	report ("greedy", &gst, (site.dawn - site.dusk)*SPD);
+	if (ns_check (nnp, buf) < 0) {
+	    printf ("greedy plan is bad: %s\n", buf);
+	    bad++;
+	}
+
+	t0 = secs();
+	ns_optimise (nnp, nthreads, iters, seed, &ost);
+	t0 = secs() - t0;
+	report ("optimised", &ost, (site.dawn - site.dusk)*SPD);
+	if (ns_check (nnp, buf) < 0) {
+	    printf ("optimised plan is bad: %s\n", buf);
+	    bad++;
+	}
+	printf ("  value %.0f against %.0f (%+.1f%%), %d moves per search in %.2f secs\n",
+			ost.value, gst.value,
+			gst.value > 0 ? 100*(ost.value/gst.value - 1) : 0.0,
+			iters, t0);
+
+	if (vflag) {
+	    for (i = 0; i < n; i++)
+		if (jobs[i].start) {
+		    fs_sexa (buf, mjd_hr(jobs[i].start), 2, 3600);
+		    printf ("  %4d %s %6.0f %c\n", i, buf, jobs[i].dur,
+				    jobs[i].filter ? jobs[i].filter : '-');
+		}
+	}
+
+	if (wx > 0) {
+	    for (i = 0; i < n; i++)
+		ostart[i] = jobs[i].start;
+	    if (replay (nnp, &site, jobs, n, gstart, "greedy", wx) < 0
+		    || replay (nnp, &site, jobs, n, ostart, "optimised", wx) < 0) {
+		printf ("re-planning got less than strict order\n");
+		bad++;
+	    }
+	}
+
+	if (outfn && writeSLS (outfn, &slsmap, jobs, idx, n) < 0) {
+	    perror (outfn);
+	    bad++;
+	}
+
+	if (test && ost.value < gst.value) {
+	    printf ("optimised is worse than greedy\n");
+	    bad++;
+	}
+	if (test)
+	    printf (bad ? "nightsched FAIL\n" : "nightsched plans agree\n");
+
+	ns_close (nnp);
+	slsClose (&slsmap);
+	return (bad ? 1 : 0);
+}
+
+static void
+usage (char *p)
+{
+	fprintf (stderr, "Usage: %s [options] {file.sls | -n n | -t}\n", p);
+	fprintf (stderr, "Purpose: plan a night allowing for slews, against sortscans' greedy slots.\n");
+	fprintf (stderr, "Options:\n");
+	fprintf (stderr, " -d jd    night starting on this JD; default tonight\n");
+	fprintf (stderr, " -i n     moves per search; default %d\n", DEFITERS);
+	fprintf (stderr, " -j n     searches, one per thread; default one per cpu\n");
+	fprintf (stderr, " -n n     make up n scans\n");
+	fprintf (stderr, " -o f     write the optimised plan of file.sls to .sls file f\n");
+	fprintf (stderr, " -s n     random seed; default 1\n");
+	fprintf (stderr, " -t       self test on %d made up scans\n", TESTNSCANS);
+	fprintf (stderr, " -v       list the optimised plan\n");
+	fprintf (stderr, " -w       keep scans within their lstdelta of their start JD\n");
+	fprintf (stderr, " -x hrs   weather outage when replaying; default %g, 0 for no replay\n", DEFWX);
+	exit (1);
+}
+
+/* fill in *sp for the night starting np->n_mjd, from the config files if
+ * usecfg and they can be found, else as for RAO.
+ * also fill in np's site.
+ */
+static void
+initSite (Now *np, NSSite *sp, int usecfg)
+{
+	static double LONGITUDE, LATITUDE, ELEVATION, MINALT, MAXALT, MAXHA;
+	static double MAXDEC, SUNDOWN, HMAXVEL, HMAXACC, DMAXVEL, DMAXACC;
+	static CfgEntry tcfg[] = {
+	    {"LONGITUDE",	CFG_DBL, &LONGITUDE},
+	    {"LATITUDE",	CFG_DBL, &LATITUDE},
+	    {"ELEVATION",	CFG_DBL, &ELEVATION},
+	    {"MINALT",		CFG_DBL, &MINALT},
+	    {"MAXALT",		CFG_DBL, &MAXALT},
+	    {"MAXHA",		CFG_DBL, &MAXHA},
+	    {"MAXDEC",		CFG_DBL, &MAXDEC},
+	    {"SUNDOWN",		CFG_DBL, &SUNDOWN},
+	};
+	static CfgEntry dcfg[] = {
+	    {"HMAXVEL",		CFG_DBL, &HMAXVEL},
+	    {"HMAXACC",		CFG_DBL, &HMAXACC},
+	    {"DMAXVEL",		CFG_DBL, &DMAXVEL},
+	    {"DMAXACC",		CFG_DBL, &DMAXACC},
+	};
+	static CfgEntry ccfg[] = {
+	    {"CAMDIG_MAX",	CFG_DBL, &CAMDIG_MAX},
+	};
+	char fn[1024];
+	double dawn, dusk;
+	int status;
+
+	/* RAO */
+	LONGITUDE = degrad(114 + 17/60. + 28/3600.);	/* +W */
+	LATITUDE = degrad(50 + 52/60. + 6/3600.);
+	ELEVATION = 1287;
+	MINALT = degrad(20);
+	MAXALT = degrad(87);
+	MAXHA = hrrad(6);
+	MAXDEC = degrad(89);
+	SUNDOWN = degrad(12);
+	HMAXVEL = HMAXACC = DMAXVEL = DMAXACC = degrad(2);
+
+	if (usecfg) {
+	    telfixpath (fn, "archive/config/telsched.cfg");
+	    (void) readCfgFile (0, fn, tcfg, sizeof(tcfg)/sizeof(tcfg[0]));
+	    telfixpath (fn, "archive/config/telescoped.cfg");
+	    (void) readCfgFile (0, fn, dcfg, sizeof(dcfg)/sizeof(dcfg[0]));
+	    telfixpath (fn, "archive/config/camera.cfg");
+	    (void) readCfgFile (0, fn, ccfg, sizeof(ccfg)/sizeof(ccfg[0]));
+	}
+
+	np->n_lng = -LONGITUDE;
+	np->n_lat = LATITUDE;
+	np->n_elev = ELEVATION/ERAD;
+	np->n_temp = 10;
+	np->n_pressure = 1010;
+
+	/* as telsched: dusk today and the dawn after it */
+	twilight_cir (np, SUNDOWN, &dawn, &dusk, &status);
+	if (dawn < dusk) {
+	    Now tomorrow = *np;
+	    double tmp;
+
+	    tomorrow.n_mjd += 1;
+	    twilight_cir (&tomorrow, SUNDOWN, &dawn, &tmp, &status);
+	}
+
+	memset ((void *)sp, 0, sizeof(*sp));
+	sp->sitelat = LATITUDE;
+	sp->sitelng = -LONGITUDE;
+	sp->dusk = dusk;
+	sp->dawn = dawn;
+	sp->minalt = MINALT;
+	sp->maxalt = MAXALT;
+	sp->maxha = MAXHA;
+	sp->maxdec = MAXDEC;
+	sp->hvel = HMAXVEL;
+	sp->hacc = HMAXACC;
+	sp->dvel = DMAXVEL;
+	sp->dacc = DMAXACC;
+	sp->domevel = degrad(3);
+	sp->filtsecs = 10;
+	sp->settle = 5;
+	sp->setup = 5;
+	sp->readout = CAMDIG_MAX;
+	sp->ha0 = 0;
+	sp->dec0 = PI/2;
+
+	/* mid night, for apparent places */
+	np->n_mjd = (dusk + dawn)/2;
+}
+
+/* run the plan in plan[] with the weather bad for wx hrs from a third of
+ * the way through the night, in strict order and picking with ns_next(), as
+ * telrun does with and without -r, and report how each fares.
+ * return 0 if re-planning got at least as much exposure, else -1.
+ */
+static int
+replay (NSNight *nnp, NSSite *sp, NSJob *jobs, int n, double plan[],
+char *name, double wx)
+{
+	double wx0 = sp->dusk + (sp->dawn - sp->dusk)/3, wx1 = wx0 + wx/24;
+	char *done = (char *) malloc (n+1);
+	char *skip = (char *) malloc (n+1);
+	double strict = 0, gained = 0, moved = 0, lost = 0, ran = 0;
+	double t, t0, tpick = 0;
+	int i, npick = 0, nstrict = 0, nran = 0, last = -1;
+
+	if (!done || !skip) {
+	    fprintf (stderr, "No memory for %d scans\n", n);
+	    exit (1);
+	}
+
+	/* strict order: a scan the weather touches is lost, the rest run */
+	for (i = 0; i < n; i++) {
+	    double len = (jobs[i].dur + sp->readout)/SPD;
+
+	    done[i] = !plan[i];
+	    if (plan[i] && (plan[i] + len <= wx0 || plan[i] >= wx1)) {
+		strict += jobs[i].dur;
+		nstrict++;
+	    }
+	}
+
+	/* re-planned: each time a scan ends run the next in order if it can
+	 * still start on time, else the best which has lost its time, else the
+	 * best which fits before it.
+	 */
+	t = sp->dusk;
+	while (1) {
+	    double len, start = 0;
+	    NSHere here;
+	    int next = -1, j, late;
+
+	    if (t >= wx0 && t < wx1)
+		t = wx1;
+	    for (i = 0; i < n; i++)
+		if (!done[i] && plan[i] >= t + sp->setup/SPD
+				&& (next < 0 || plan[i] < plan[next]))
+		    next = i;
+
+	    here.now = t;
+	    here.ha = last < 0 ? sp->ha0 : lstat (sp, t) - jobs[last].ra;
+	    here.dec = last < 0 ? sp->dec0 : jobs[last].dec;
+	    here.filter = last < 0 ? 0 : jobs[last].filter;
+	    here.by = next < 0 ? 0 : plan[next];
+	    here.then = next;
+	    here.avoidw = here.avoidaz = 0;
+
+	    t0 = secs();
+	    for (i = 0; i < n; i++)
+		skip[i] = done[i] || plan[i] >= t + sp->setup/SPD;
+	    j = ns_next (nnp, &here, skip, &start);
+	    late = j >= 0;
+	    if (j < 0) {
+		for (i = 0; i < n; i++)
+		    skip[i] = done[i];
+		j = ns_next (nnp, &here, skip, &start);
+	    }
+	    tpick += secs() - t0;
+	    npick++;
+
+	    if (j < 0) {
+		if (next < 0)
+		    break;
+		j = next;
+		start = plan[j];
+	    }
+
+	    len = (jobs[j].dur + sp->readout)/SPD;
+	    done[j] = 1;
+	    if (start + len > wx0 && start < wx1) {
+		if (late || j != next)
+		    lost += jobs[j].dur;
+		t = start > wx0 ? start : wx0;
+		continue;
+	    }
+	    ran += jobs[j].dur;
+	    nran++;
+	    if (late)
+		gained += jobs[j].dur;
+	    else if (j != next)
+		moved += jobs[j].dur;
+	    t = start + len;
+	    if (!jobs[j].cal)
+		last = j;
+	}
+
+	printf ("Replay of %s plan with %.2f hrs of weather from %.2f hrs after dusk:\n",
+					name, wx, (wx0 - sp->dusk)*24);
+	printf ("  strict    %4d run, science %5.2f hrs\n", nstrict, strict/3600);
+	printf ("  re-plan   %4d run, science %5.2f hrs: %.2f hrs recovered, %.2f hrs moved up, %.2f hrs lost\n",
+			nran, ran/3600, gained/3600, moved/3600, lost/3600);
+	printf ("  %d picks, %.3f ms each\n", npick, npick ? 1e3*tpick/npick : 0.);
+
+	free ((void *)done);
+	free ((void *)skip);
+	return (ran >= strict ? 0 : -1);
+}
+
+/* local sidereal time at sp at t, mjd, rads */
+static double
+lstat (NSSite *sp, double t)
+{
+	double gst;
+
+	utc_gst (mjd_day(t), mjd_hr(t), &gst);
+	return (hrrad(gst) + sp->sitelng);
+}
+
+/* make jobs for each New scan in fn, held to start within startdt of
+ * starttm if wflag.
+ * return number of jobs with a malloced array at *jpp and which scan each is
+ * at *idxp, else -1.
+ */
+static int
+readJobs (char *fn, Now *np, int wflag, SLSMap *mp, NSJob **jpp, int **idxp)
+{
+	NSJob *jobs;
+	int *idx;
+	int i, n;
+
+	if (slsOpen (fn, mp) < 0) {
+	    perror (fn);
+	    return (-1);
+	}
+
+	jobs = (NSJob *) calloc (mp->nscans+1, sizeof(NSJob));
+	idx = (int *) calloc (mp->nscans+1, sizeof(int));
+	if (!jobs || !idx) {
+	    fprintf (stderr, "No memory for %d scans\n", mp->nscans);
+	    return (-1);
+	}
+
+	for (i = n = 0; i < mp->nscans; i++) {
+	    Scan s;
+	    NSJob *jp = &jobs[n];
+
+	    if (mp->status[i] != 'N')
+		continue;
+	    s = mp->scans[i];
+	    (void) obj_cir (np, &s.obj);
+	    jp->ra = s.obj.s_ra + s.rao;
+	    jp->dec = s.obj.s_dec + s.deco;
+	    jp->dur = s.dur;
+	    jp->filter = s.filter;
+	    jp->priority = s.priority;
+	    jp->cal = s.ccdcalib.data == CD_NONE;
+	    if (wflag && s.starttm) {
+		double t = 25567.5 + s.starttm/SPD;
+
+		jp->lo = t - s.startdt/SPD;
+		jp->hi = t + s.startdt/SPD;
+	    }
+	    idx[n++] = i;
+	}
+
+	*jpp = jobs;
+	*idxp = idx;
+	return (n);
+}
+
+/* make up n jobs, such as a survey would have, the same for the same seed.
+ * return n with a malloced array at *jpp.
+ */
+static int
+makeJobs (Now *np, NSSite *sp, int n, unsigned seed, NSJob **jpp)
+{
+	static double durs[] = {60, 120, 300, 600};
+	static int pris[] = {0, 50, 100};
+	unsigned long long r = 88172645463325252ULL ^ seed;
+	NSJob *jobs = (NSJob *) calloc (n+1, sizeof(NSJob));
+	int i;
+
+#define	RND()	(r ^= r << 13, r ^= r >> 7, r ^= r << 17, \
+					    (r >> 11)*(1.0/9007199254740992.0))
+
+	if (!jobs) {
+	    fprintf (stderr, "No memory for %d scans\n", n);
+	    exit (1);
+	}
+
+	for (i = 0; i < n; i++) {
+	    NSJob *jp = &jobs[i];
+
+	    jp->ra = 2*PI*RND();
+	    jp->dec = asin (sin(degrad(-20)) + RND()*(sin(degrad(85))
+							- sin(degrad(-20))));
+	    jp->dur = durs[(int)(RND()*4)];
+	    jp->filter = "BVRI"[(int)(RND()*4)];
+	    jp->priority = pris[(int)(RND()*3)];
+
+	    /* some calibration, some which must be at a given time */
+	    if (i % 25 == 0) {
+		jp->cal = 1;
+		jp->filter = 0;
+		jp->dur = 1;
+	    } else if (i % 20 == 0) {
+		double mid = sp->dusk + RND()*(sp->dawn - sp->dusk);
+		jp->lo = mid - 600/SPD;
+		jp->hi = mid + 600/SPD;
+	    }
+	}
+
+#undef	RND
+
+	*jpp = jobs;
+	return (n);
+}
+
+static void
+report (char *name, NSStats *stp, double night)
+{
+	printf ("  %-9s %4d run, %3d missed, science %5.2f hrs (%4.1f%%), overhead %5.2f hrs, idle %5.2f hrs\n",
+		    name, stp->nplanned, stp->nmissed, stp->science/3600,
+		    100*stp->science/night, stp->overhead/3600, stp->idle/3600);
+}
+
+/* write the planned scans of mp to fn in start order.
+ * return 0 if ok, else -1.
+ */
+static int
+writeSLS (char *fn, SLSMap *mp, NSJob *jobs, int idx[], int n)
+{
+	FILE *fp = fopen (fn, "w");
+	double last = 0;
+	int i;
+
+	if (!fp)
+	    return (-1);
+
+	/* n is small enough for this */
+	for (;;) {
+	    int first = -1;
+
+	    for (i = 0; i < n; i++)
+		if (jobs[i].start > last
+			    && (first < 0 || jobs[i].start < jobs[first].start))
+		    first = i;
+	    if (first < 0)
+		break;
+	    last = jobs[first].start;
+
+	    {
+		Scan s = mp->scans[idx[first]];
+
+		s.status = 'N';
+		s.starttm = (time_t)floor((last - 25567.5)*SPD + 0.5);
+		pr1 (fp, &s);
+	    }
+	}
+
+	return (fclose (fp) == 0 ? 0 : -1);
+}
+
+/* print *sp to fp in .sls format, as telsched does */
+static void
+pr1 (FILE *fp, Scan *sp)
+{
+	char raostr[32], decostr[32], dbline[1024];
+	int i = 0;
+
+	fs_sexa (raostr, radhr(sp->rao), 2, 36000);
+	fs_sexa (decostr, raddeg(sp->deco), 2, 36000);
+	db_write_line (&sp->obj, dbline);
+
+	fprintf (fp, "%2d            status: %c\n", i++, sp->status);
+	fprintf (fp, "%2d          start JD: %13.5f\n", i++,
+				    MJD0 + 25567.5 + sp->starttm/SPD);
+	fprintf (fp, "%2d    lstdelta, mins: %-6g\n",  i++, sp->startdt/60.);
+	fprintf (fp, "%2d           schedfn: %s\n",    i++, sp->schedfn);
+	fprintf (fp, "%2d             title: %s\n",    i++, sp->title);
+	fprintf (fp, "%2d          observer: %s\n",    i++, sp->observer);
+	fprintf (fp, "%2d           comment: %s\n",    i++, sp->comment);
+	fprintf (fp, "%2d               EDB: %s\n",    i++, dbline);
+	fprintf (fp, "%2d          RAOffset: %s\n",    i++, raostr);
+	fprintf (fp, "%2d         DecOffset: %s\n",    i++, decostr);
+	fprintf (fp, "%2d    frame position: %d+%d\n", i++, sp->sx, sp->sy);
+	fprintf (fp, "%2d        frame size: %dx%d\n", i++, sp->sw, sp->sh);
+	fprintf (fp, "%2d           binning: %dx%d\n", i++, sp->binx, sp->biny);
+	fprintf (fp, "%2d    duration, secs: %-6g\n",  i++, sp->dur);
+	fprintf (fp, "%2d           shutter: %s\n",    i++,
+						    ccdSO2Str(sp->shutter));
+	fprintf (fp, "%2d          ccdcalib: %s\n",    i++,
+						    ccdCalib2Str(sp->ccdcalib));
+	fprintf (fp, "%2d            filter: %c\n",    i++, sp->filter);
+	fprintf (fp, "%2d             hcomp: %d\n",    i++, sp->compress);
+	fprintf (fp, "%2d   Extended Action: %s\n",    i++,
+						    ccdExtAct2Str(sp->ccdcalib));
+	fprintf (fp, "%2d  Ext. Act. Values: %s\n",    i++, extActValueStr(sp));
+	fprintf (fp, "%2d          priority: %d\n",    i++, sp->priority);
+	fprintf (fp, "%2d          pathname: %s/%s\n", i++, sp->imagedn,
+								sp->imagefn);
+}
+
+static double
+secs (void)
+{
+	struct timeval tv;
+
+	gettimeofday (&tv, NULL);
+	return (tv.tv_sec + tv.tv_usec*1e-6);
+}
@@ -0,0 +1,477 @@
+/* check and time the higher order plate fits of findRegistrationD().
+ *
+ * for each of the 12 parameter quadratic, 20 parameter cubic and 26
+ * parameter DSS models, makes a synthetic field whose stars are distorted by
+ * a known model of that kind, with measuring noise, false matches and stars
+ * missing from either list. it then
+ *   1. fits the model to the true pairs both directly with linlsq() and by
+ *      searching with lstsqr(), as findregd.c used to, and reports the time
+ *      each takes and how well each recovers the true model;
+ *   2. runs findRegistrationD() on the whole field and checks the AMDX/AMDY
+ *      solution it leaves in the header against the true sky positions.
+ * exit 0 if every findRegistrationD() fit is good to MAXRMS and MAXERR, else 1.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/time.h>
+
+#include "P_.h"
+#include "astro.h"
+#include "fits.h"
+#include "wcs.h"
+#include "lstsqr.h"
+
+extern int findRegistrationD
+    (FImage *fip, double ra0, double dec0, double rot0,
+    double psx0, double psy0, double sx[], double sy[], int ns, double gr[],
+    double gd[], int ng,
+    int nparam, int TRYSTARS, double MATCHDIST, double *rhp, double *residp);
+
+#define	IMW	2048		/* image size, pixels */
+#define	SCALE	1.0		/* pixel size, arcsec */
+#define	NPAIR	300		/* stars in both lists */
+#define	NBAD	10		/* of those, image stars badly measured */
+#define	NXCAT	30		/* extra catalog stars */
+#define	NXIMG	20		/* extra image stars */
+#define	NOISE	0.05		/* image measuring noise, rms pixels */
+#define	DIST	1.5		/* distortion amplitude per term, pixels */
+#define	MATCHDIST 10.0		/* position match limit, arcsec */
+#define	MAXRMS	0.05		/* largest acceptable rms error, arcsec */
+#define	MAXERR	0.2		/* largest acceptable error anywhere, arcsec */
+#define	NGRID	21		/* grid points each way to check the fit */
+#define	FTOL	0.0005		/* as findregd.c */
+#define	NTIME	20		/* repeats when timing the direct fits */
+
+/* a plate model: xi on terms(x,y) and eta on terms(y,x), as findregd.c */
+typedef struct {
+    int nparam;			/* 12, 20 or 26 */
+    char *name;			/* for reports */
+    double rc, dc;		/* projection centre, rads */
+    double p[26];		/* xi coefficients then eta */
+} Model;
+
+/* pairs for the lstsqr() fit */
+typedef struct {
+    int nparam;
+    int n;
+    double *x, *y, *xi, *eta;
+} Pairs;
+
+static void usage (char *p);
+static void mkModel (Model *mp, int nparam);
+static void terms (int nparam, double x, double y, double f[]);
+static void model (Model *mp, double x, double y, double *xip, double *etap);
+static void xieta2RADec (double rc, double dc, double xi, double eta,
+    double *rp, double *dp);
+static double chisqr (double p[], void *arg);
+static int fitDirect (Pairs *pp, double p[]);
+static int fitSearch (Pairs *pp, Model *tp, double p[]);
+static double sepArcsec (double r1, double d1, double r2, double d2);
+static void modelErr (Model *tp, Model *fp, double *rmsp, double *maxp);
+static int fullFit (Model *tp);
+static double gauss (void);
+static double secs (void);
+
+int
+main (int ac, char *av[])
+{
+	static int nparams[3] = {12, 20, 26};
+	int bad = 0;
+	int i;
+
+	if (ac > 1)
+	    usage (av[0]);
+
+	srand (1);
+	printf ("%d stars on a %d pixel field, %g pixel noise, %g pixel distortion terms\n",
+						NPAIR, IMW, NOISE, DIST);
+
+	for (i = 0; i < 3; i++) {
+	    Model truth, dfit, sfit;
+	    double x[NPAIR], y[NPAIR], xi[NPAIR], eta[NPAIR];
+	    double td, ts, rms, max;
+	    Pairs pr;
+	    int j, ok;
+
+	    mkModel (&truth, nparams[i]);
+
+	    /* the true pairs, with noise but no mistakes */
+	    for (j = 0; j < NPAIR; j++) {
+		double tx = IMW*(double)rand()/RAND_MAX;
+		double ty = IMW*(double)rand()/RAND_MAX;
+
+		model (&truth, tx, ty, &xi[j], &eta[j]);
+		x[j] = tx + NOISE*gauss();
+		y[j] = ty + NOISE*gauss();
+	    }
+	    pr.nparam = truth.nparam;
+	    pr.n = NPAIR;
+	    pr.x = x;
+	    pr.y = y;
+	    pr.xi = xi;
+	    pr.eta = eta;
+
+	    dfit = truth;
+	    sfit = truth;
+
+	    td = secs();
+	    for (j = 0; j < NTIME; j++)
+		ok = fitDirect (&pr, dfit.p);
+	    td = (secs() - td)/NTIME;
+	    if (ok < 0)
+		printf ("%s: linlsq() failed\n", truth.name);
+	    else {
+		modelErr (&truth, &dfit, &rms, &max);
+		printf ("%s: linlsq  %8.5f secs, error rms %.4f max %.4f arcsec\n",
+						    truth.name, td, rms, max);
+	    }
+
+	    ts = secs();
+	    ok = fitSearch (&pr, &truth, sfit.p);
+	    ts = secs() - ts;
+	    if (ok < 0)
+		printf ("%s: lstsqr  %8.5f secs, did not converge\n",
+							    truth.name, ts);
+	    else {
+		modelErr (&truth, &sfit, &rms, &max);
+		printf ("%s: lstsqr  %8.5f secs, error rms %.4f max %.4f arcsec\n",
+						    truth.name, ts, rms, max);
+	    }
+
+	    bad |= fullFit (&truth);
+	}
+
+	printf ("%s\n", bad ? "FAIL" : "all fits good");
+	return (bad);
+}
+
+static void
+usage (char *p)
+{
+	fprintf (stderr, "Usage: %s\n", p);
+	fprintf (stderr, "Purpose: check and time the higher order plate fits of findRegistrationD().\n");
+	exit (1);
+}
+
+/* make a random model with nparam parameters of the kind findregd.c fits */
+static void
+mkModel (Model *mp, int nparam)
+{
+	double s = degrad(SCALE/3600.0);
+	double th = degrad(0.3);
+	double psx = -s, psy = -s;
+	double c = IMW/2.0;
+	double f[13];
+	int m = nparam/2;
+	int k;
+
+	memset ((void *)mp, 0, sizeof(*mp));
+	mp->nparam = nparam;
+	mp->name = nparam == 12 ? "quadratic" : (nparam == 20 ? "cubic    "
+							   : "DSS      ");
+	mp->rc = hrrad(10.0);
+	mp->dc = degrad(30.0);
+
+	/* scale and rotation about the image centre, as findregd.c */
+	mp->p[0] = cos(th)*psx;
+	mp->p[1] = -sin(th)*psy;
+	mp->p[2] = -mp->p[0]*c - mp->p[1]*c;
+	mp->p[m] = cos(th)*psy;
+	mp->p[m+1] = sin(th)*psx;
+	mp->p[m+2] = -mp->p[m]*c - mp->p[m+1]*c;
+
+	/* each higher term worth up to DIST pixels in the far corner */
+	terms (nparam, IMW, IMW, f);
+	for (k = 3; k < m; k++) {
+	    mp->p[k] = DIST*s*(2.0*rand()/RAND_MAX - 1)/f[k];
+	    mp->p[m+k] = DIST*s*(2.0*rand()/RAND_MAX - 1)/f[k];
+	}
+}
+
+/* the terms of xi at x,y in the order of the coefficients of the nparam
+ * parameter model in findregd.c.
+ */
+static void
+terms (int nparam, double x, double y, double f[])
+{
+	double x2y2 = x*x + y*y;
+
+	f[0] = x;
+	f[1] = y;
+	f[2] = 1;
+	f[3] = x*x;
+	f[4] = x*y;
+	f[5] = y*y;
+	if (nparam == 20) {
+	    f[6] = x*x*x;
+	    f[7] = x*x*y;
+	    f[8] = x*y*y;
+	    f[9] = y*y*y;
+	} else if (nparam == 26) {
+	    f[6] = x2y2;
+	    f[7] = x*x*x;
+	    f[8] = x*x*y;
+	    f[9] = x*y*y;
+	    f[10] = y*y*y;
+	    f[11] = x*x2y2;
+	    f[12] = x*x2y2*x2y2;
+	}
+}
+
+/* xi and eta at x,y according to mp */
+static void
+model (Model *mp, double x, double y, double *xip, double *etap)
+{
+	double f[13];
+	int m = mp->nparam/2;
+	int k;
+
+	*xip = *etap = 0;
+	terms (mp->nparam, x, y, f);
+	for (k = 0; k < m; k++)
+	    *xip += mp->p[k]*f[k];
+	terms (mp->nparam, y, x, f);
+	for (k = 0; k < m; k++)
+	    *etap += mp->p[m+k]*f[k];
+}
+
+/* standard coordinates about rc,dc to ra,dec, all rads */
+static void
+xieta2RADec (double rc, double dc, double xi, double eta, double *rp,
+double *dp)
+{
+	double cdc = cos(dc), sdc = sin(dc);
+	double den = cdc - eta*sdc;
+
+	*rp = rc + atan2 (xi, den);
+	*dp = atan2 (sdc + eta*cdc, sqrt(xi*xi + den*den));
+}
+
+/* sum of squared errors of the model p to the pairs at arg, arcsec^2 */
+static double
+chisqr (double p[], void *arg)
+{
+	Pairs *pp = (Pairs *)arg;
+	Model mo;
+	double r2as = raddeg(1)*3600;
+	double c2 = 0;
+	int i;
+
+	mo.nparam = pp->nparam;
+	memcpy ((void *)mo.p, (void *)p, pp->nparam*sizeof(double));
+	for (i = 0; i < pp->n; i++) {
+	    double xi, eta;
+
+	    model (&mo, pp->x[i], pp->y[i], &xi, &eta);
+	    xi = (pp->xi[i] - xi)*r2as;
+	    eta = (pp->eta[i] - eta)*r2as;
+	    c2 += xi*xi + eta*eta;
+	}
+	return (c2);
+}
+
+/* fit the model to the pairs directly, as findregd.c linfit(), holding the
+ * redundant DSS terms 6 and 11 at 0.
+ */
+static int
+fitDirect (Pairs *pp, double p[])
+{
+	int m = pp->nparam/2;
+	int nfree = pp->nparam == 26 ? m-2 : m;
+	double A[NPAIR*13], v[NPAIR], f[13], x[13];
+	int axis, i, j, k;
+
+	for (axis = 0; axis < 2; axis++) {
+	    for (i = 0; i < pp->n; i++) {
+		if (axis == 0) {
+		    terms (pp->nparam, pp->x[i], pp->y[i], f);
+		    v[i] = pp->xi[i];
+		} else {
+		    terms (pp->nparam, pp->y[i], pp->x[i], f);
+		    v[i] = pp->eta[i];
+		}
+		for (j = k = 0; j < m; j++)
+		    if (nfree == m || (j != 6 && j != 11))
+			A[i*nfree + k++] = f[j];
+	    }
+	    if (linlsq (A, v, pp->n, nfree, x) < 0)
+		return (-1);
+	    for (j = k = 0; j < m; j++)
+		p[axis*m + j] = (nfree == m || (j != 6 && j != 11)) ? x[k++] : 0;
+	}
+	return (0);
+}
+
+/* fit the model to the pairs with lstsqr() as findregd.c used to, starting
+ * from the true linear terms and the same second guesses.
+ */
+static int
+fitSearch (Pairs *pp, Model *tp, double p[])
+{
+	int np = pp->nparam;
+	int m = np/2;
+	double p1[26];
+	int i;
+
+	for (i = 0; i < np; i++) {
+	    p[i] = 0;
+	    p1[i] = np == 12 ? 1e-9 : 1e-12;
+	}
+	if (np > 12)
+	    for (i = 3; i < (np == 20 ? 6 : 7); i++)
+		p1[i] = p1[i+m] = 1e-9;
+	if (np == 26)
+	    p1[12] = p1[25] = 1e-19;
+	for (i = 0; i < 3; i++) {
+	    p[i] = tp->p[i];
+	    p[i+m] = tp->p[i+m];
+	    p1[i] = p[i] + 1e-6;
+	    p1[i+m] = p[i+m] + 1e-6;
+	}
+	p1[2] = p[2] + 1e-3;
+	p1[m+2] = p[m+2] + 1e-3;
+
+	return (lstsqr_r (chisqr, (void *)pp, p, p1, np, FTOL) < 0 ? -1 : 0);
+}
+
+/* angle between two positions, arcsec */
+static double
+sepArcsec (double r1, double d1, double r2, double d2)
+{
+	double c = sin(d1)*sin(d2) + cos(d1)*cos(d2)*cos(r1-r2);
+	double x = cos(d2)*sin(r1-r2);
+	double y = cos(d1)*sin(d2) - sin(d1)*cos(d2)*cos(r1-r2);
+
+	return (raddeg(atan2 (sqrt(x*x + y*y), c))*3600);
+}
+
+/* rms and max sky error of fp against tp over a grid on the image, arcsec */
+static void
+modelErr (Model *tp, Model *fp, double *rmsp, double *maxp)
+{
+	double sum2 = 0, max = 0;
+	int i, j;
+
+	for (i = 0; i < NGRID; i++)
+	    for (j = 0; j < NGRID; j++) {
+		double x = IMW*i/(NGRID-1.0), y = IMW*j/(NGRID-1.0);
+		double xi, eta, tr, td, fr, fd, e;
+
+		model (tp, x, y, &xi, &eta);
+		xieta2RADec (tp->rc, tp->dc, xi, eta, &tr, &td);
+		model (fp, x, y, &xi, &eta);
+		xieta2RADec (fp->rc, fp->dc, xi, eta, &fr, &fd);
+		e = sepArcsec (tr, td, fr, fd);
+		sum2 += e*e;
+		if (e > max)
+		    max = e;
+	    }
+	*rmsp = sqrt(sum2/(NGRID*NGRID));
+	*maxp = max;
+}
+
+/* make a field distorted by tp, with mistakes, and solve it with
+ * findRegistrationD(). check the AMDX/AMDY answer against tp.
+ * return 0 if good, else 1.
+ */
+static int
+fullFit (Model *tp)
+{
+	int ns = NPAIR + NXIMG, ng = NPAIR + NXCAT;
+	double sx[NPAIR+NXIMG], sy[NPAIR+NXIMG];
+	double gr[NPAIR+NXCAT], gd[NPAIR+NXCAT];
+	double psx = -degrad(SCALE/3600.0), psy = psx;
+	double rh = 1.0, r = 3.0;
+	double t, rms, max;
+	Model fit;
+	FImage fim;
+	int m = tp->nparam/2;
+	int i, s;
+
+	for (i = 0; i < ng; i++) {
+	    double x = IMW*(double)rand()/RAND_MAX;
+	    double y = IMW*(double)rand()/RAND_MAX;
+	    double xi, eta;
+
+	    model (tp, x, y, &xi, &eta);
+	    xieta2RADec (tp->rc, tp->dc, xi, eta, &gr[i], &gd[i]);
+	    if (i < NPAIR) {
+		sx[i] = x + NOISE*gauss();
+		sy[i] = y + NOISE*gauss();
+		if (i < NBAD) {
+		    sx[i] += 3 + 3.0*rand()/RAND_MAX;
+		    sy[i] -= 3 + 3.0*rand()/RAND_MAX;
+		}
+	    }
+	}
+	for (i = NPAIR; i < ns; i++) {
+	    sx[i] = IMW*(double)rand()/RAND_MAX;
+	    sy[i] = IMW*(double)rand()/RAND_MAX;
+	}
+
+	initFImage (&fim);
+	setLogicalFITS (&fim, "SIMPLE", 1, NULL);
+	setIntFITS (&fim, "BITPIX", 16, NULL);
+	setIntFITS (&fim, "NAXIS", 2, NULL);
+	setIntFITS (&fim, "NAXIS1", IMW, NULL);
+	setIntFITS (&fim, "NAXIS2", IMW, NULL);
+	fim.sw = fim.sh = IMW;
+
+	/* start a little off in place, rotation and scale */
+	t = secs();
+	s = findRegistrationD (&fim, tp->rc + degrad(3./3600), tp->dc
+		    - degrad(2./3600), degrad(0.25), psx*1.001, psy*1.001,
+		    sx, sy, ns, gr, gd, ng, tp->nparam, 20, MATCHDIST, &rh, &r);
+	t = secs() - t;
+	if (s < 0 || rh < 0) {
+	    printf ("%s: findRegistrationD failed  FAIL\n", tp->name);
+	    resetFImage (&fim);
+	    return (1);
+	}
+
+	/* read back the answer */
+	fit.nparam = tp->nparam;
+	fit.name = tp->name;
+	(void) getRealFITS (&fim, "AMDX0", &fit.rc);
+	(void) getRealFITS (&fim, "AMDY0", &fit.dc);
+	for (i = 0; i < m; i++) {
+	    /* map the DSS a[1..13] back to this model's terms */
+	    static int q[] = {1, 2, 3, 4, 5, 6, 8, 9, 10, 11};
+	    char name[16];
+	    int k = tp->nparam == 26 ? i+1 : q[i];
+
+	    sprintf (name, "AMDX%d", k);
+	    (void) getRealFITS (&fim, name, &fit.p[i]);
+	    sprintf (name, "AMDY%d", k);
+	    (void) getRealFITS (&fim, name, &fit.p[m+i]);
+	}
+	resetFImage (&fim);
+
+	modelErr (tp, &fit, &rms, &max);
+	printf ("%s: findRegistrationD %.4f secs, %.3f\" rms resid, error rms %.4f max %.4f arcsec%s\n",
+			    tp->name, t, rh, rms, max,
+			    rms > MAXRMS || max > MAXERR ? "  FAIL" : "");
+	return (rms > MAXRMS || max > MAXERR);
+}
+
+/* gaussian deviate with unit variance */
+static double
+gauss (void)
+{
+	double u1 = (rand() + 1.0)/(RAND_MAX + 2.0);
+	double u2 = (rand() + 1.0)/(RAND_MAX + 2.0);
+
+	return (sqrt(-2*log(u1))*cos(2*PI*u2));
+}
+
+static double
+secs (void)
+{
+	struct timeval tv;
+
+	gettimeofday (&tv, NULL);
+	return (tv.tv_sec + tv.tv_usec*1e-6);
+}
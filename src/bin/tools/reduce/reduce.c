@@ -0,0 +1,632 @@
+/* reduce a night of images without X.
+ *
+ * each FITS file goes through these stages, each of which may be skipped:
+ *   read, calib (correctFITS), badcol (removeBadColumns), fwhm (setFWHMFITS),
+ *   wcs (setWCSFITS), stars (writeStarList), write.
+ * each stage has its own threads and passes frames to the next through a
+ * queue of bounded length, so all cores stay busy without holding the whole
+ * night in memory. wcs uses the catalogs, which are not reentrant, so it
+ * always runs one frame at a time.
+ *
+ * files come from the command line, from each directory named there, or, if
+ * none are named, one path per line on stdin as they are created.
+ * results are written in place, or to an output directory, along with the
+ * binary star list of each, so later tools need not find its stars again.
+ * how fast each stage ran is reported at the end.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include "P_.h"
+#include "astro.h"
+#include "fits.h"
+#include "fitscorr.h"
+#include "wcs.h"
+#include "fieldstar.h"
+#include "strops.h"
+
+#define	MAXTHR		64	/* max threads in any one stage */
+#define	DEFHUNT		0.2	/* default wcs hunt radius, degrees */
+#define	NCORR		8	/* correction frames kept in memory */
+
+static char camcfg[] = "archive/config/camera.cfg";
+
+/* one image on its way through the pipeline */
+typedef struct {
+    char fn[1024];		/* source file */
+    char ofn[1024];		/* result file */
+    FImage fim;			/* pixels and header, once read */
+    int bad;			/* set if can not go on, later stages skip */
+} Frame;
+
+/* a bounded fifo of frames between two stages */
+typedef struct {
+    Frame **f;			/* ring of cap entries */
+    int cap;			/* max entries */
+    int head;			/* index of oldest */
+    int n;			/* entries in use */
+    int closed;			/* set when no more will be put */
+    pthread_mutex_t lock;
+    pthread_cond_t notempty, notfull;
+} Queue;
+
+/* one step of the reduction */
+typedef struct {
+    char *name;			/* for reports */
+    int (*fp)(Frame *frp, char msg[]);	/* 0 if ok, else -1 and msg */
+    int reent;			/* set if fp may run in several threads */
+    int on;			/* set if wanted */
+    int nthr;			/* threads running fp */
+    int nlive;			/* threads not yet finished */
+    Queue *in, *out;		/* frames to do, frames done or NULL */
+    int nframes, nfail;		/* frames done, failures */
+    double busy;		/* total secs inside fp, all threads */
+    pthread_mutex_t lock;	/* for nlive and the counters */
+} Stage;
+
+static void usage (char *p);
+static void addPath (Queue *qp, char *path);
+static void addFile (Queue *qp, char *fn);
+static int ftsname (char *fn);
+static int cmp_str (const void *p1, const void *p2);
+static void report (double wall);
+static void *worker (void *arg);
+static Queue *qnew (int cap);
+static void qput (Queue *qp, Frame *frp);
+static Frame *qget (Queue *qp);
+static void qclose (Queue *qp);
+static int s_read (Frame *frp, char msg[]);
+static int s_calib (Frame *frp, char msg[]);
+static int s_badcol (Frame *frp, char msg[]);
+static int s_fwhm (Frame *frp, char msg[]);
+static int s_wcs (Frame *frp, char msg[]);
+static int s_stars (Frame *frp, char msg[]);
+static int s_write (Frame *frp, char msg[]);
+static double secs (void);
+
+static Stage stages[] = {
+    {"read",   s_read,   1, 1},
+    {"calib",  s_calib,  1, 1},
+    {"badcol", s_badcol, 1, 1},
+    {"fwhm",   s_fwhm,   1, 1},
+    {"wcs",    s_wcs,    0, 1},
+    {"stars",  s_stars,  1, 1},
+    {"write",  s_write,  1, 1},
+};
+#define	NSTAGES	(sizeof(stages)/sizeof(stages[0]))
+
+/* stage indices, for turning them off */
+enum {S_READ, S_CALIB, S_BADCOL, S_FWHM, S_WCS, S_STARS, S_WRITE};
+
+static char *outdir;		/* put results here, else in place */
+static BADCOL *badmap;		/* bad column map, if any */
+static int nbadmap;		/* entries in badmap, plus a 0 terminator */
+static char badmapfn[1024];	/* name of badmap file, for header */
+static int wantusno;		/* use USNO for wcs, else GSC */
+static double hunt = DEFHUNT;	/* wcs hunt radius, rads after main */
+static int verbose;		/* report each frame */
+
+int
+main (int ac, char *av[])
+{
+	char *progname = av[0];
+	char *gscpath = NULL, *usnopath = NULL;
+	pthread_t tid[NSTAGES][MAXTHR];
+	char msg[1024];
+	Queue *first = NULL, *last = NULL;
+	int nthr = 0, qlen = 0;
+	double t0;
+	int nfail = 0;
+	int i, j;
+
+	while ((--ac > 0) && ((*++av)[0] == '-')) {
+	    char *s;
+	    for (s = av[0]+1; *s != '\0'; s++)
+		switch (*s) {
+		case 'b':
+		    stages[S_BADCOL].on = 0;
+		    break;
+		case 'c':
+		    stages[S_CALIB].on = 0;
+		    break;
+		case 'f':
+		    stages[S_FWHM].on = 0;
+		    break;
+		case 's':
+		    stages[S_STARS].on = 0;
+		    break;
+		case 'g':
+		    if (ac < 2)
+			usage (progname);
+		    gscpath = *++av;
+		    ac--;
+		    break;
+		case 'h':
+		    if (ac < 2)
+			usage (progname);
+		    hunt = atof (*++av);
+		    ac--;
+		    break;
+		case 'i':
+		    if (ac < 2)
+			usage (progname);
+		    setIpCfgPath (*++av);
+		    ac--;
+		    break;
+		case 'n':
+		    if (ac < 2)
+			usage (progname);
+		    nthr = atoi (*++av);
+		    ac--;
+		    break;
+		case 'o':
+		    if (ac < 2)
+			usage (progname);
+		    outdir = *++av;
+		    ac--;
+		    break;
+		case 'q':
+		    if (ac < 2)
+			usage (progname);
+		    qlen = atoi (*++av);
+		    ac--;
+		    break;
+		case 'u':
+		    if (ac < 2)
+			usage (progname);
+		    usnopath = *++av;
+		    ac--;
+		    break;
+		case 'v':
+		    verbose++;
+		    break;
+		default:
+		    usage (progname);
+		}
+	}
+
+	/* threads per reentrant stage, and frames waiting between stages */
+	if (nthr <= 0)
+	    nthr = (int) sysconf (_SC_NPROCESSORS_ONLN);
+	if (nthr <= 0)
+	    nthr = 1;
+	if (nthr > MAXTHR)
+	    nthr = MAXTHR;
+	if (qlen <= 0)
+	    qlen = 2*nthr;
+
+	/* load shared config once here, before any threads want it */
+	loadIpCfg();
+	if (stages[S_CALIB].on) {
+	    readCorrectionCfg (0, camcfg);
+	    setCorrCache (NCORR);
+	}
+	if (stages[S_BADCOL].on) {
+	    nbadmap = readMapFile (NULL, NULL, &badmap, badmapfn, msg);
+	    if (nbadmap <= 0) {
+		if (verbose)
+		    printf ("No bad column map, badcol skipped\n");
+		stages[S_BADCOL].on = 0;
+	    }
+	}
+	hunt = degrad (hunt);
+	if (usnopath) {
+	    if (USNOSetup (usnopath, gscpath != NULL, msg) < 0) {
+		fprintf (stderr, "USNO: %s\n", msg);
+		exit (1);
+	    }
+	    wantusno = 1;
+	}
+	if (gscpath && GSCSetup (NULL, gscpath, msg) < 0) {
+	    fprintf (stderr, "GSC: %s\n", msg);
+	    exit (1);
+	}
+	if (!gscpath && !usnopath)
+	    stages[S_WCS].on = 0;
+	if (outdir && mkdir (outdir, 0775) < 0 && errno != EEXIST) {
+	    fprintf (stderr, "%s: %s\n", outdir, strerror(errno));
+	    exit (1);
+	}
+
+	/* chain the stages that are on with queues, and start their threads */
+	for (i = 0; i < NSTAGES; i++) {
+	    Stage *sp = &stages[i];
+
+	    if (!sp->on)
+		continue;
+	    sp->in = last ? last : qnew (qlen);
+	    if (!first)
+		first = sp->in;
+	    last = sp->out = i < S_WRITE ? qnew (qlen) : NULL;
+	    sp->nthr = sp->nlive = sp->reent ? nthr : 1;
+	    pthread_mutex_init (&sp->lock, NULL);
+	}
+	t0 = secs();
+	for (i = 0; i < NSTAGES; i++)
+	    for (j = 0; stages[i].on && j < stages[i].nthr; j++)
+		if (pthread_create (&tid[i][j], NULL, worker, &stages[i])) {
+		    fprintf (stderr, "Can not start %s thread\n",stages[i].name);
+		    exit (1);
+		}
+
+	/* feed the first stage */
+	if (ac > 0) {
+	    while (ac-- > 0)
+		addPath (first, *av++);
+	} else {
+	    char line[1024];
+
+	    while (fgets (line, sizeof(line), stdin)) {
+		line[strcspn (line, "\r\n")] = '\0';
+		if (line[0])
+		    addPath (first, line);
+	    }
+	}
+	qclose (first);
+
+	/* wait for all to drain */
+	for (i = 0; i < NSTAGES; i++)
+	    for (j = 0; stages[i].on && j < stages[i].nthr; j++)
+		pthread_join (tid[i][j], NULL);
+
+	report (secs() - t0);
+	for (i = 0; i < NSTAGES; i++)
+	    nfail += stages[i].nfail;
+	return (nfail ? 1 : 0);
+}
+
+static void
+usage (char *p)
+{
+	fprintf (stderr, "Usage: %s [options] [file.fts|dir ...]\n", p);
+	fprintf (stderr, "Purpose: reduce FITS files through a parallel pipeline.\n");
+	fprintf (stderr, "  With no files, read their names from stdin as they arrive.\n");
+	fprintf (stderr, "Options:\n");
+	fprintf (stderr, " -b:       skip bad column repair\n");
+	fprintf (stderr, " -c:       skip bias/thermal/flat calibration\n");
+	fprintf (stderr, " -f:       skip FWHM\n");
+	fprintf (stderr, " -s:       skip star list\n");
+	fprintf (stderr, " -g dir:   GSC cache for WCS; no WCS without -g or -u\n");
+	fprintf (stderr, " -u dir:   USNO catalog for WCS\n");
+	fprintf (stderr, " -h degs:  WCS hunt radius; default %g\n", DEFHUNT);
+	fprintf (stderr, " -i file:  ip.cfg to use\n");
+	fprintf (stderr, " -n n:     threads per stage; default one per core\n");
+	fprintf (stderr, " -q n:     max frames waiting between stages; default 2n\n");
+	fprintf (stderr, " -o dir:   write results here; default is in place\n");
+	fprintf (stderr, " -v:       report each frame\n");
+	exit (1);
+}
+
+/* add path to qp: a FITS file, or each FITS file in a directory by name */
+static void
+addPath (Queue *qp, char *path)
+{
+	struct dirent *dep;
+	struct stat st;
+	char **names = NULL;
+	int nnames = 0;
+	DIR *dp;
+	int i;
+
+	if (stat (path, &st) < 0 || !S_ISDIR(st.st_mode)) {
+	    addFile (qp, path);
+	    return;
+	}
+
+	dp = opendir (path);
+	if (!dp) {
+	    fprintf (stderr, "%s: %s\n", path, strerror(errno));
+	    return;
+	}
+	while ((dep = readdir (dp)) != NULL) {
+	    if (!ftsname (dep->d_name))
+		continue;
+	    names = (char **) realloc (names, (nnames+1)*sizeof(char *));
+	    names[nnames] = malloc (strlen(path) + strlen(dep->d_name) + 2);
+	    sprintf (names[nnames++], "%s/%s", path, dep->d_name);
+	}
+	closedir (dp);
+
+	qsort ((void *)names, nnames, sizeof(char *), cmp_str);
+	for (i = 0; i < nnames; i++) {
+	    addFile (qp, names[i]);
+	    free ((void *)names[i]);
+	}
+	if (names)
+	    free ((void *)names);
+}
+
+/* start a new Frame for fn on qp */
+static void
+addFile (Queue *qp, char *fn)
+{
+	Frame *frp = (Frame *) calloc (1, sizeof(Frame));
+
+	if (!frp) {
+	    fprintf (stderr, "%s: no memory\n", fn);
+	    return;
+	}
+	strncpy (frp->fn, fn, sizeof(frp->fn)-1);
+	if (outdir)
+	    sprintf (frp->ofn, "%.500s/%.500s", outdir, basenm(fn));
+	else
+	    strcpy (frp->ofn, frp->fn);
+	initFImage (&frp->fim);
+	qput (qp, frp);
+}
+
+/* return 1 if fn looks like a FITS file, else 0 */
+static int
+ftsname (char *fn)
+{
+	char *dot = strrchr (fn, '.');
+
+	return (dot && (!strcasecmp (dot, ".fts") || !strcasecmp (dot, ".fits")
+						    || !strcasecmp (dot, ".fit")));
+}
+
+static int
+cmp_str (const void *p1, const void *p2)
+{
+	return (strcmp (*(char **)p1, *(char **)p2));
+}
+
+/* print how each stage did */
+static void
+report (double wall)
+{
+	int nframes = stages[S_READ].nframes - stages[S_READ].nfail;
+	int i;
+
+	printf ("%-7s %3s %7s %5s %9s %9s %6s\n", "stage", "thr", "frames",
+			    "fail", "ms/frame", "frames/s", "busy%");
+	for (i = 0; i < NSTAGES; i++) {
+	    Stage *sp = &stages[i];
+	    double mspf, fps, util;
+
+	    if (!sp->on)
+		continue;
+	    mspf = sp->nframes ? 1e3*sp->busy/sp->nframes : 0;
+	    fps = sp->busy > 0 ? sp->nframes*sp->nthr/sp->busy : 0;
+	    util = wall > 0 ? 100*sp->busy/(wall*sp->nthr) : 0;
+	    printf ("%-7s %3d %7d %5d %9.1f %9.1f %6.1f\n", sp->name, sp->nthr,
+			    sp->nframes, sp->nfail, mspf, fps, util);
+	}
+	printf ("%d frames in %.2f secs, %.1f frames/s\n", nframes, wall,
+						wall > 0 ? nframes/wall : 0.0);
+}
+
+/* thread body: run one stage on each frame from its input queue */
+static void *
+worker (void *arg)
+{
+	Stage *sp = (Stage *)arg;
+	Frame *frp;
+	int last;
+
+	while ((frp = qget (sp->in)) != NULL) {
+	    char msg[1024];
+	    double t;
+	    int s;
+
+	    if (!frp->bad) {
+		msg[0] = '\0';
+		t = secs();
+		s = (*sp->fp) (frp, msg);
+		t = secs() - t;
+		pthread_mutex_lock (&sp->lock);
+		sp->nframes++;
+		sp->busy += t;
+		if (s < 0)
+		    sp->nfail++;
+		pthread_mutex_unlock (&sp->lock);
+		if (s < 0)
+		    fprintf (stderr, "%s: %s: %s\n", frp->fn, sp->name, msg);
+		else if (verbose > 1)
+		    printf ("%s: %s %.1f ms\n", frp->fn, sp->name, 1e3*t);
+	    }
+
+	    if (sp->out)
+		qput (sp->out, frp);
+	    else {
+		if (verbose && !frp->bad)
+		    printf ("%s: done\n", frp->ofn);
+		resetFImage (&frp->fim);
+		free ((void *)frp);
+	    }
+	}
+
+	/* last one out tells the next stage there are no more */
+	pthread_mutex_lock (&sp->lock);
+	last = --sp->nlive == 0;
+	pthread_mutex_unlock (&sp->lock);
+	if (last && sp->out)
+	    qclose (sp->out);
+
+	return (NULL);
+}
+
+static Queue *
+qnew (int cap)
+{
+	Queue *qp = (Queue *) calloc (1, sizeof(Queue));
+
+	if (!qp || !(qp->f = (Frame **) malloc (cap*sizeof(Frame *)))) {
+	    fprintf (stderr, "No memory for queues\n");
+	    exit (1);
+	}
+	qp->cap = cap;
+	pthread_mutex_init (&qp->lock, NULL);
+	pthread_cond_init (&qp->notempty, NULL);
+	pthread_cond_init (&qp->notfull, NULL);
+	return (qp);
+}
+
+/* add frp to qp, waiting for room */
+static void
+qput (Queue *qp, Frame *frp)
+{
+	pthread_mutex_lock (&qp->lock);
+	while (qp->n == qp->cap)
+	    pthread_cond_wait (&qp->notfull, &qp->lock);
+	qp->f[(qp->head + qp->n++) % qp->cap] = frp;
+	pthread_cond_signal (&qp->notempty);
+	pthread_mutex_unlock (&qp->lock);
+}
+
+/* remove the oldest frame from qp, waiting for one.
+ * return NULL when qp is empty and closed.
+ */
+static Frame *
+qget (Queue *qp)
+{
+	Frame *frp = NULL;
+
+	pthread_mutex_lock (&qp->lock);
+	while (qp->n == 0 && !qp->closed)
+	    pthread_cond_wait (&qp->notempty, &qp->lock);
+	if (qp->n > 0) {
+	    frp = qp->f[qp->head];
+	    qp->head = (qp->head + 1) % qp->cap;
+	    qp->n--;
+	    pthread_cond_signal (&qp->notfull);
+	}
+	pthread_mutex_unlock (&qp->lock);
+	return (frp);
+}
+
+/* mark qp as getting no more frames, and wake everyone waiting on it */
+static void
+qclose (Queue *qp)
+{
+	pthread_mutex_lock (&qp->lock);
+	qp->closed = 1;
+	pthread_cond_broadcast (&qp->notempty);
+	pthread_mutex_unlock (&qp->lock);
+}
+
+static int
+s_read (Frame *frp, char msg[])
+{
+	int fd = open (frp->fn, O_RDONLY);
+	int s;
+
+	if (fd < 0) {
+	    strcpy (msg, strerror(errno));
+	    frp->bad = 1;
+	    return (-1);
+	}
+	s = readFITS (fd, &frp->fim, msg);
+	close (fd);
+	if (s < 0)
+	    frp->bad = 1;
+	return (s);
+}
+
+static int
+s_calib (Frame *frp, char msg[])
+{
+	return (correctFITS (&frp->fim, NULL, NULL, NULL, msg));
+}
+
+/* removeBadColumns() scribbles on the map, so each call gets its own copy */
+static int
+s_badcol (Frame *frp, char msg[])
+{
+	BADCOL *map = (BADCOL *) malloc ((nbadmap+1)*sizeof(BADCOL));
+	int s;
+
+	if (!map) {
+	    strcpy (msg, "No memory for bad column map");
+	    return (-1);
+	}
+	memcpy ((void *)map, (void *)badmap, (nbadmap+1)*sizeof(BADCOL));
+	s = removeBadColumns (&frp->fim, map, badmapfn, msg);
+	free ((void *)map);
+	return (s);
+}
+
+static int
+s_fwhm (Frame *frp, char msg[])
+{
+	return (setFWHMFITS (&frp->fim, msg));
+}
+
+static int
+s_wcs (Frame *frp, char msg[])
+{
+	if (setWCSFITS (&frp->fim, wantusno, hunt, NULL, 0, msg) < 0)
+	    return (-1);
+	if (verbose > 1 && msg[0])
+	    printf ("%s: wcs: %s\n", frp->fn, msg);
+	return (0);
+}
+
+/* write the star list sidecar beside the result, with RA/Dec if it has WCS */
+static int
+s_stars (Frame *frp, char msg[])
+{
+	FImage *fip = &frp->fim;
+	StarRec *sr;
+	int n, i, s;
+
+	n = measureStarList (fip, &sr);
+	if (n < 0) {
+	    strcpy (msg, "Error finding stars");
+	    return (-1);
+	}
+	for (i = 0; i < n; i++)
+	    if (xy2RADec (fip, sr[i].x, sr[i].y, &sr[i].ra, &sr[i].dec) == 0)
+		sr[i].flags |= SL_RADEC;
+	    else
+		break;		/* no WCS */
+	s = writeStarList (frp->ofn, fip, sr, n, msg);
+	free ((void *)sr);
+	return (s);
+}
+
+/* write to a temp file then rename, so ofn is never half done */
+static int
+s_write (Frame *frp, char msg[])
+{
+	char tmp[1100];
+	int fd, s;
+
+	sprintf (tmp, "%s.tmp", frp->ofn);
+	fd = open (tmp, O_WRONLY|O_CREAT|O_TRUNC, 0664);
+	if (fd < 0) {
+	    sprintf (msg, "%s: %s", tmp, strerror(errno));
+	    return (-1);
+	}
+	s = writeFITS (fd, &frp->fim, msg, 0);
+	if (close (fd) < 0 && s == 0) {
+	    sprintf (msg, "%s: %s", tmp, strerror(errno));
+	    s = -1;
+	}
+	if (s == 0 && rename (tmp, frp->ofn) < 0) {
+	    sprintf (msg, "%s: %s", frp->ofn, strerror(errno));
+	    s = -1;
+	}
+	if (s < 0)
+	    (void) unlink (tmp);
+	return (s);
+}
+
+static double
+secs (void)
+{
+	struct timeval tv;
+
+	gettimeofday (&tv, NULL);
+	return (tv.tv_sec + tv.tv_usec*1e-6);
+}
@@ -0,0 +1,180 @@
+/* benchmark and check riset_cir_batch() against riset_cir().
+ *
+ * makes a list of random fixed targets, plus the sun, moon and planets,
+ * finds their rise, set and transit circumstances for one day both ways,
+ * prints the times taken and the largest differences, and exits 1 if any
+ * event disagrees in kind or by more than the allowed time.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/time.h>
+
+#include "P_.h"
+#include "astro.h"
+#include "circum.h"
+
+#define	DEFN	10000		/* default n fixed targets */
+#define	DEFMJD	(36525.0 + 9000.5)	/* default date, 2024 Aug 21 */
+#define	DEFLAT	31.7		/* default latitude, degrees */
+#define	DEFLNG	(-110.9)	/* default longitude, degrees */
+#define	MAXDT	30.0		/* allowed time difference, seconds */
+#define	DIS	degrad(-20.0)	/* horizon, as telsched's MINALT */
+
+static void usage (char *p);
+static double secs (void);
+
+int
+main (int ac, char *av[])
+{
+	char *progname = av[0];
+	Now now, *np = &now;
+	Obj *objs, **ops;
+	RiseSet *rs1, *rsb;
+	double day = DEFMJD;
+	double la = DEFLAT;
+	double t1, tb;
+	double maxdt = 0;
+	int nthr = 0;
+	int n = DEFN;
+	int nflags = 0, nbad = 0;
+	int nobj, i;
+
+	while ((--ac > 0) && ((*++av)[0] == '-')) {
+	    char *s;
+	    for (s = av[0]+1; *s != '\0'; s++)
+		switch (*s) {
+		case 'd':
+		    if (ac < 2)
+			usage(progname);
+		    day = atof (*++av);
+		    ac--;
+		    break;
+		case 'l':
+		    if (ac < 2)
+			usage(progname);
+		    la = atof (*++av);
+		    ac--;
+		    break;
+		case 'n':
+		    if (ac < 2)
+			usage(progname);
+		    n = atoi (*++av);
+		    ac--;
+		    break;
+		case 't':
+		    if (ac < 2)
+			usage(progname);
+		    nthr = atoi (*++av);
+		    ac--;
+		    break;
+		default:
+		    usage(progname);
+		}
+	}
+	if (ac > 0 || n < 0)
+	    usage (progname);
+
+	memset ((void *)np, 0, sizeof(now));
+	mjd = day;
+	lat = degrad(la);
+	lng = degrad(DEFLNG);
+	tz = 7;
+	temp = 10.0;
+	pressure = 1010.0;
+	elev = 2000.0/ERAD;
+	dip = degrad(18.0);
+	epoch = J2000;
+
+	/* the sun, moon and planets then n random fixed targets */
+	nobj = MOON+1 + n;
+	objs = (Obj *) calloc (nobj, sizeof(Obj));
+	ops = (Obj **) malloc (nobj * sizeof(Obj *));
+	rs1 = (RiseSet *) calloc (nobj, sizeof(RiseSet));
+	rsb = (RiseSet *) calloc (nobj, sizeof(RiseSet));
+	if (!objs || !ops || !rs1 || !rsb) {
+	    fprintf (stderr, "No memory for %d objects\n", nobj);
+	    return (1);
+	}
+	for (i = 0; i <= MOON; i++) {
+	    objs[i].o_type = PLANET;
+	    objs[i].pl.pl_code = i;
+	}
+	srand (1);
+	for (i = MOON+1; i < nobj; i++) {
+	    Obj *op = &objs[i];
+
+	    op->o_type = FIXED;
+	    sprintf (op->o_name, "T%d", i);
+	    op->f_RA = (float)(2*PI*rand()/(RAND_MAX+1.0));
+	    op->f_dec = (float)asin(2.0*rand()/(RAND_MAX+1.0) - 1.0);
+	    op->f_epoch = (float)J2000;
+	}
+	for (i = 0; i < nobj; i++)
+	    ops[i] = &objs[i];
+
+	t1 = secs();
+	for (i = 0; i < nobj; i++)
+	    riset_cir (np, ops[i], DIS, &rs1[i]);
+	t1 = secs() - t1;
+
+	tb = secs();
+	riset_cir_batch (np, ops, nobj, DIS, rsb, nthr);
+	tb = secs() - tb;
+
+	for (i = 0; i < nobj; i++) {
+	    RiseSet *a = &rs1[i], *b = &rsb[i];
+	    double d = 0;
+
+	    if (a->rs_flags != b->rs_flags) {
+		nflags++;
+		continue;
+	    }
+	    if (!(a->rs_flags & (RS_NORISE|RS_CIRCUMPOLAR|RS_NEVERUP|RS_ERROR)))
+		d = fabs(a->rs_risetm - b->rs_risetm);
+	    if (!(a->rs_flags & (RS_NOSET|RS_CIRCUMPOLAR|RS_NEVERUP|RS_ERROR)))
+		d = fmax (d, fabs(a->rs_settm - b->rs_settm));
+	    if (!(a->rs_flags & (RS_NOTRANS|RS_NEVERUP|RS_ERROR)))
+		d = fmax (d, fabs(a->rs_trantm - b->rs_trantm));
+	    d *= SPD;
+	    if (d > maxdt)
+		maxdt = d;
+	    if (d > MAXDT) {
+		nbad++;
+		if (i <= MOON)
+		    printf ("Body %d differs by %.1f secs\n", i, d);
+	    }
+	}
+
+	printf ("%d objects: riset_cir %.3f secs, batch %.3f secs, %.1fx\n",
+					nobj, t1, tb, tb > 0 ? t1/tb : 0.0);
+	printf ("largest time difference %.2f secs; %d flags differ, %d over %g secs\n",
+						maxdt, nflags, nbad, MAXDT);
+
+	/* allow for objects grazing the horizon right at the day's edges */
+	return (nflags + nbad > nobj/1000);
+}
+
+static void
+usage (char *p)
+{
+	fprintf (stderr, "Usage: %s [options]\n", p);
+	fprintf (stderr, "Purpose: compare riset_cir_batch() with riset_cir().\n");
+	fprintf (stderr, "Options:\n");
+	fprintf (stderr, " -d mjd  day; default %g\n", DEFMJD);
+	fprintf (stderr, " -l lat  latitude, degrees; default %g\n", DEFLAT);
+	fprintf (stderr, " -n n    number of fixed targets; default %d\n", DEFN);
+	fprintf (stderr, " -t n    threads; default one per processor\n");
+	exit (1);
+}
+
+static double
+secs (void)
+{
+	struct timeval tv;
+
+	gettimeofday (&tv, NULL);
+	return (tv.tv_sec + tv.tv_usec*1e-6);
+}
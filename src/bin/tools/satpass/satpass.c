@@ -0,0 +1,586 @@
+/* predict the passes of every satellite in a TLE file over a site.
+ *
+ * each satellite is stepped through the period with obj_earthsat_times(),
+ * so its SGP4/SDP4 propagator is set up just once, and each rise, set and
+ * culmination is then refined with obj_earthsat(), which finds the same
+ * propagator in the cache.
+ *
+ * with -b the passes are also found with the propagator cache off, as
+ * obj_earthsat() always used to work, to compare the times taken and check
+ * the passes agree. with -t the same is done on a built-in set of near earth
+ * and deep space orbits, and every position is also checked to be the same
+ * with and without the cache, one time or many, one satellite or many.
+ * exit 0 if all ok, else 1.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <sys/time.h>
+
+#include "P_.h"
+#include "astro.h"
+#include "circum.h"
+
+#define	DEFMJD	(36525.0 + 9000.5)	/* default -t start, 2024 Aug 21 */
+#define	DEFLAT	31.7		/* default latitude, degrees */
+#define	DEFLNG	(-110.9)	/* default longitude, degrees */
+#define	DEFELEV	2000.0		/* default elevation, m */
+#define	DEFALT	10.0		/* default lowest altitude of a pass, degrees */
+#define	DEFDAYS	1.0		/* default days to search */
+#define	STEP	(30.0/SPD)	/* search step, days */
+#define	CHUNK	240		/* steps found at once */
+#define	TTOL	(0.5/SPD)	/* rise and set time tolerance, days */
+#define	NCHECK	400		/* -t times checked per satellite */
+#define	MAXSATS	4096		/* most satellites in a TLE file */
+
+/* one pass */
+typedef struct {
+    double rise, set;		/* times above minalt, mjd */
+    double risaz, setaz;	/* azimuths then, rads */
+    double top, topalt;		/* time and altitude of culmination */
+} Pass;
+
+/* built-in elements for -t: name, n, inc, raan, e, ap, M, decay, drag */
+typedef struct {
+    char *name;
+    double n, inc, raan, e, ap, M, decay, drag;
+} TestSat;
+
+static TestSat testsats[] = {
+    {"LEO",	15.50, 51.64, 120.0, 0.0005,  80.0, 200.0, 1e-4, 2e-4},
+    {"SSO",	14.20, 98.20,  40.0, 0.0012, 100.0,  10.0, 1e-6, 5e-5},
+    {"GPS",	 2.0056, 55.0, 300.0, 0.0100,  30.0, 150.0, 0, 0},
+    {"MOLNIYA",	 2.0060, 63.4, 200.0, 0.7200, 270.0,  20.0, 0, 0},
+    {"GEO",	 1.0027,  0.05, 90.0, 0.0002, 150.0, 250.0, 0, 0},
+    {"HEO",	 0.6000, 30.0,  10.0, 0.3000,  60.0,  90.0, 0, 0},
+};
+#define	NTESTSATS	(sizeof(testsats)/sizeof(testsats[0]))
+
+static void usage (char *p);
+static int readTLE (char *fn, Obj *objs, int max);
+static void testObjs (Obj *objs, double mjd0);
+static int checkSame (Now *np, Obj *objs, int nobj);
+static int findPasses (Now *np, Obj *op, double days, double minalt,
+    Pass **pp);
+static double altAt (Now *np, Obj *op, double t, double *azp);
+static double crossing (Now *np, Obj *op, double t0, double t1, double minalt,
+    double *azp);
+static double culmination (Now *np, Obj *op, double t0, double t1,
+    double *altp);
+static void printPass (Obj *op, Pass *pp);
+static void fmtTime (double m, char buf[]);
+static double urand (void);
+static double secs (void);
+
+static unsigned long long rseed = 88172645463325252ULL;
+
+int
+main (int ac, char *av[])
+{
+	char *progname = av[0];
+	double la = DEFLAT, lg = DEFLNG, el = DEFELEV;
+	double minalt = DEFALT, days = DEFDAYS;
+	double start = 0;
+	int bflag = 0, tflag = 0;
+	Now now, *np = &now;
+	Obj *objs;
+	int nobj, i, bad = 0;
+	long npass = 0;
+	double t0, t1;
+
+	while ((--ac > 0) && ((*++av)[0] == '-')) {
+	    char *s;
+	    for (s = av[0]+1; *s != '\0'; s++)
+		switch (*s) {
+		case 'a':
+		    if (ac < 2)
+			usage(progname);
+		    minalt = atof (*++av);
+		    ac--;
+		    break;
+		case 'b':
+		    bflag++;
+		    break;
+		case 'd':
+		    if (ac < 2)
+			usage(progname);
+		    days = atof (*++av);
+		    ac--;
+		    break;
+		case 'e':
+		    if (ac < 2)
+			usage(progname);
+		    el = atof (*++av);
+		    ac--;
+		    break;
+		case 'L':
+		    if (ac < 2)
+			usage(progname);
+		    lg = atof (*++av);
+		    ac--;
+		    break;
+		case 'l':
+		    if (ac < 2)
+			usage(progname);
+		    la = atof (*++av);
+		    ac--;
+		    break;
+		case 'm':
+		    if (ac < 2)
+			usage(progname);
+		    start = atof (*++av);
+		    ac--;
+		    break;
+		case 't':
+		    tflag++;
+		    break;
+		default:
+		    usage(progname);
+		}
+	}
+	if ((tflag && ac > 0) || (!tflag && ac != 1) || days <= 0)
+	    usage (progname);
+
+	objs = (Obj *) calloc (MAXSATS, sizeof(Obj));
+	if (!objs) {
+	    fprintf (stderr, "No memory\n");
+	    return (1);
+	}
+	if (tflag) {
+	    if (start == 0)
+		start = DEFMJD;
+	    testObjs (objs, start);
+	    nobj = NTESTSATS;
+	    bflag = 1;
+	} else {
+	    if (start == 0)
+		start = 25567.5 + time(NULL)/SPD;
+	    nobj = readTLE (av[0], objs, MAXSATS);
+	    if (nobj < 0)
+		return (1);
+	}
+
+	memset ((void *)np, 0, sizeof(now));
+	mjd = start;
+	lat = degrad(la);
+	lng = degrad(lg);
+	temp = 10.0;
+	pressure = 1010.0;
+	elev = el/ERAD;
+	epoch = EOD;
+
+	if (tflag)
+	    bad |= checkSame (np, objs, nobj);
+
+	/* the passes, timed, then again without the cache if asked */
+	esat_cache (1);
+	t0 = secs();
+	for (i = 0; i < nobj; i++) {
+	    Pass *pp;
+	    int j, n;
+
+	    n = findPasses (np, &objs[i], days, degrad(minalt), &pp);
+	    for (j = 0; j < n; j++)
+		printPass (&objs[i], &pp[j]);
+	    npass += n;
+	    if (pp)
+		free ((void *)pp);
+	}
+	t0 = secs() - t0;
+	printf ("%d satellites, %ld passes over %g days: %.3f secs\n", nobj,
+							npass, days, t0);
+
+	if (bflag) {
+	    long nhits, ninits;
+	    int ndiff = 0;
+
+	    esat_stats (&nhits, &ninits);
+	    t1 = 0;
+	    for (i = 0; i < nobj; i++) {
+		Pass *p0, *p1;
+		int n0, n1, j;
+		double t;
+
+		esat_cache (1);
+		n0 = findPasses (np, &objs[i], days, degrad(minalt), &p0);
+		esat_cache (0);
+		t = secs();
+		n1 = findPasses (np, &objs[i], days, degrad(minalt), &p1);
+		t1 += secs() - t;
+		if (n0 != n1)
+		    ndiff++;
+		else
+		    for (j = 0; j < n0; j++)
+			if (memcmp ((void *)&p0[j], (void *)&p1[j],
+							    sizeof(Pass))) {
+			    ndiff++;
+			    break;
+			}
+		if (p0)
+		    free ((void *)p0);
+		if (p1)
+		    free ((void *)p1);
+	    }
+	    esat_cache (1);
+	    printf ("without cache: %.3f secs, %.1fx slower; %ld set ups, %ld reused\n",
+			    t1, t0 > 0 ? t1/t0 : 0.0, ninits, nhits);
+	    if (ndiff) {
+		printf ("passes of %d satellites differ  FAIL\n", ndiff);
+		bad = 1;
+	    }
+	}
+
+	if (tflag)
+	    printf ("%s\n", bad ? "FAIL" : "satellite passes agree");
+	return (bad);
+}
+
+static void
+usage (char *p)
+{
+	fprintf (stderr, "Usage: %s [options] {-t | file.tle}\n", p);
+	fprintf (stderr, "Purpose: predict satellite passes over a site.\n");
+	fprintf (stderr, "Options:\n");
+	fprintf (stderr, " -a alt  lowest altitude of a pass, degrees; default %g\n", DEFALT);
+	fprintf (stderr, " -b      also find passes without the propagator cache and compare\n");
+	fprintf (stderr, " -d days search this long; default %g\n", DEFDAYS);
+	fprintf (stderr, " -e m    site elevation; default %g\n", DEFELEV);
+	fprintf (stderr, " -L lng  site longitude, degrees +E; default %g\n", DEFLNG);
+	fprintf (stderr, " -l lat  site latitude, degrees +N; default %g\n", DEFLAT);
+	fprintf (stderr, " -m mjd  start; default now, or %g with -t\n", DEFMJD);
+	fprintf (stderr, " -t      check and time with built-in satellites\n");
+	exit (1);
+}
+
+/* read up to max satellites from the TLE file fn into objs[].
+ * return how many, else -1.
+ */
+static int
+readTLE (char *fn, Obj *objs, int max)
+{
+	char l0[128], l1[128], l2[128];
+	FILE *fp;
+	int n = 0;
+
+	fp = fopen (fn, "r");
+	if (!fp) {
+	    perror (fn);
+	    return (-1);
+	}
+	l0[0] = l1[0] = '\0';
+	while (n < max && fgets (l2, sizeof(l2), fp)) {
+	    if (db_tle (l0, l1, l2, &objs[n]) == 0) {
+		n++;
+		l0[0] = l1[0] = l2[0] = '\0';
+	    }
+	    strcpy (l0, l1);
+	    strcpy (l1, l2);
+	}
+	fclose (fp);
+	if (n == 0)
+	    fprintf (stderr, "%s: no satellites\n", fn);
+	return (n > 0 ? n : -1);
+}
+
+/* fill objs[] with testsats[], their epoch a few days before mjd0 */
+static void
+testObjs (Obj *objs, double mjd0)
+{
+	int i;
+
+	for (i = 0; i < NTESTSATS; i++) {
+	    TestSat *tp = &testsats[i];
+	    Obj *op = &objs[i];
+
+	    memset ((void *)op, 0, sizeof(Obj));
+	    op->o_type = EARTHSAT;
+	    strcpy (op->o_name, tp->name);
+	    op->es_epoch = mjd0 - 2.5 - 0.37*i;
+	    op->es_n = tp->n;
+	    op->es_inc = (float)tp->inc;
+	    op->es_raan = (float)tp->raan;
+	    op->es_e = (float)tp->e;
+	    op->es_ap = (float)tp->ap;
+	    op->es_M = (float)tp->M;
+	    op->es_decay = (float)tp->decay;
+	    op->es_drag = (float)tp->drag;
+	    op->es_orbit = 1000 + i;
+	}
+}
+
+/* check every way of finding positions gives just what obj_earthsat() did
+ * without the cache, and time them.
+ * return 0 if so, else 1.
+ */
+static int
+checkSame (Now *np, Obj *objs, int nobj)
+{
+	double tnone = 0, tone = 0, ttimes = 0;
+	double mjds[NCHECK];
+	Obj *ref, *got, **ops;
+	Now now;
+	int i, j, bad = 0;
+
+	ref = (Obj *) malloc (NCHECK*sizeof(Obj));
+	got = (Obj *) malloc (NCHECK*sizeof(Obj));
+	ops = (Obj **) malloc (nobj*sizeof(Obj *));
+	if (!ref || !got || !ops) {
+	    printf ("No memory  FAIL\n");
+	    return (1);
+	}
+
+	now = *np;
+	for (i = 0; i < nobj; i++) {
+	    Obj *op = &objs[i];
+	    double t;
+
+	    /* random times over a week either side of the start */
+	    for (j = 0; j < NCHECK; j++)
+		mjds[j] = np->n_mjd + 14*(urand() - 0.5);
+
+	    esat_cache (0);
+	    t = secs();
+	    for (j = 0; j < NCHECK; j++) {
+		now.n_mjd = mjds[j];
+		ref[j] = *op;
+		obj_earthsat (&now, &ref[j]);
+	    }
+	    tnone += secs() - t;
+
+	    esat_cache (1);
+	    t = secs();
+	    for (j = 0; j < NCHECK; j++) {
+		now.n_mjd = mjds[j];
+		got[j] = *op;
+		obj_earthsat (&now, &got[j]);
+	    }
+	    tone += secs() - t;
+	    if (memcmp ((void *)ref, (void *)got, NCHECK*sizeof(Obj))) {
+		printf ("%s: cached obj_earthsat() differs  FAIL\n",
+								op->o_name);
+		bad = 1;
+	    }
+
+	    t = secs();
+	    obj_earthsat_times (np, op, mjds, NCHECK, got);
+	    ttimes += secs() - t;
+	    if (memcmp ((void *)ref, (void *)got, NCHECK*sizeof(Obj))) {
+		printf ("%s: obj_earthsat_times() differs  FAIL\n",
+								op->o_name);
+		bad = 1;
+	    }
+	}
+
+	/* all at once at a few times */
+	for (j = 0; j < 10; j++) {
+	    now.n_mjd = np->n_mjd + 14*(urand() - 0.5);
+	    for (i = 0; i < nobj; i++) {
+		esat_cache (0);
+		ref[i] = objs[i];
+		obj_earthsat (&now, &ref[i]);
+		esat_cache (1);
+		got[i] = objs[i];
+		ops[i] = &got[i];
+	    }
+	    obj_earthsat_many (&now, ops, nobj);
+	    if (memcmp ((void *)ref, (void *)got, nobj*sizeof(Obj))) {
+		printf ("obj_earthsat_many() differs  FAIL\n");
+		bad = 1;
+		break;
+	    }
+	}
+
+	printf ("%d positions each of %d satellites:\n", NCHECK, nobj);
+	printf ("  no cache %8.2f us, cached %8.2f us (%.1fx), times %8.2f us (%.1fx)\n",
+		1e6*tnone/(NCHECK*nobj), 1e6*tone/(NCHECK*nobj),
+		tone > 0 ? tnone/tone : 0.0, 1e6*ttimes/(NCHECK*nobj),
+		ttimes > 0 ? tnone/ttimes : 0.0);
+
+	free ((void *)ref);
+	free ((void *)got);
+	free ((void *)ops);
+	return (bad);
+}
+
+/* find the passes of op above minalt in the days from np, put them in a
+ * malloced *pp and return how many.
+ * N.B. caller must free *pp if not NULL.
+ */
+static int
+findPasses (Now *np, Obj *op, double days, double minalt, Pass **pp)
+{
+	double mjds[CHUNK];
+	Obj pos[CHUNK];
+	double t0 = np->n_mjd;
+	double tprev = t0;
+	double tbest = 0, abest = 0;
+	int nsteps = (int)ceil(days/STEP) + 1;
+	int up = 0, n = 0, nmalloc = 0;
+	Pass pass;
+	int i, j;
+
+	*pp = NULL;
+	memset ((void *)&pass, 0, sizeof(pass));
+	for (i = 0; i < nsteps; i += CHUNK) {
+	    int m = nsteps - i < CHUNK ? nsteps - i : CHUNK;
+
+	    for (j = 0; j < m; j++)
+		mjds[j] = t0 + (i+j)*STEP;
+	    obj_earthsat_times (np, op, mjds, m, pos);
+
+	    for (j = 0; j < m; j++) {
+		double t = mjds[j], a = pos[j].s_alt;
+
+		if (!up && a > minalt) {
+		    /* rising, unless up from the start */
+		    up = 1;
+		    if (i+j == 0) {
+			pass.rise = t;
+			pass.risaz = pos[j].s_az;
+		    } else
+			pass.rise = crossing (np, op, tprev, t, minalt,
+								&pass.risaz);
+		    tbest = t;
+		    abest = a;
+		} else if (up && a > abest) {
+		    tbest = t;
+		    abest = a;
+		} else if (up && a <= minalt) {
+		    /* set: refine the peak, then keep the pass */
+		    up = 0;
+		    pass.set = crossing (np, op, tprev, t, minalt, &pass.setaz);
+		    pass.top = culmination (np, op,
+					    tbest - STEP > pass.rise ?
+						    tbest - STEP : pass.rise,
+					    tbest + STEP < pass.set ?
+						    tbest + STEP : pass.set,
+					    &pass.topalt);
+		    if (n == nmalloc) {
+			nmalloc += 16;
+			*pp = (Pass *) realloc ((void *)*pp,
+						    nmalloc*sizeof(Pass));
+			if (!*pp)
+			    return (0);
+		    }
+		    (*pp)[n++] = pass;
+		}
+		tprev = t;
+	    }
+	}
+
+	return (n);
+}
+
+/* return the altitude of op at t, and its azimuth in *azp */
+static double
+altAt (Now *np, Obj *op, double t, double *azp)
+{
+	Now now = *np;
+	Obj o = *op;
+
+	now.n_mjd = t;
+	obj_earthsat (&now, &o);
+	if (azp)
+	    *azp = o.s_az;
+	return (o.s_alt);
+}
+
+/* find when op crosses minalt between t0 and t1, and its azimuth then */
+static double
+crossing (Now *np, Obj *op, double t0, double t1, double minalt, double *azp)
+{
+	int up0 = altAt (np, op, t0, NULL) > minalt;
+
+	while (t1 - t0 > TTOL) {
+	    double t = (t0 + t1)/2;
+
+	    if ((altAt (np, op, t, NULL) > minalt) == up0)
+		t0 = t;
+	    else
+		t1 = t;
+	}
+	(void) altAt (np, op, (t0 + t1)/2, azp);
+	return ((t0 + t1)/2);
+}
+
+/* find when op is highest between t0 and t1, by golden section */
+static double
+culmination (Now *np, Obj *op, double t0, double t1, double *altp)
+{
+	double g = (sqrt(5.0) - 1)/2;
+	double a = t1 - g*(t1 - t0), b = t0 + g*(t1 - t0);
+	double fa = altAt (np, op, a, NULL), fb = altAt (np, op, b, NULL);
+
+	while (t1 - t0 > TTOL) {
+	    if (fa > fb) {
+		t1 = b;
+		b = a;
+		fb = fa;
+		a = t1 - g*(t1 - t0);
+		fa = altAt (np, op, a, NULL);
+	    } else {
+		t0 = a;
+		a = b;
+		fa = fb;
+		b = t0 + g*(t1 - t0);
+		fb = altAt (np, op, b, NULL);
+	    }
+	}
+	*altp = altAt (np, op, (t0 + t1)/2, NULL);
+	return ((t0 + t1)/2);
+}
+
+static void
+printPass (Obj *op, Pass *pp)
+{
+	char rbuf[32], tbuf[32], sbuf[32];
+
+	fmtTime (pp->rise, rbuf);
+	fmtTime (pp->top, tbuf);
+	fmtTime (pp->set, sbuf);
+	printf ("%-13s rise %s az %5.1f  top %s alt %4.1f  set %s az %5.1f\n",
+			op->o_name, rbuf, raddeg(pp->risaz), tbuf,
+			raddeg(pp->topalt), sbuf, raddeg(pp->setaz));
+}
+
+/* format mjd m as UTC yyyy-mm-dd hh:mm:ss */
+static void
+fmtTime (double m, char buf[])
+{
+	double dy, s;
+	int mn, yr, d;
+
+	mjd_cal (m, &mn, &dy, &yr);
+	d = (int)dy;
+	s = floor ((dy - d)*SPD + 0.5);
+	if (s >= SPD) {
+	    /* rounded up into the next day */
+	    mjd_cal (floor(m - 0.5) + 1.5, &mn, &dy, &yr);
+	    d = (int)dy;
+	    s = 0;
+	}
+	sprintf (buf, "%04d-%02d-%02d %02d:%02d:%02d", yr, mn, d,
+		    (int)(s/3600), (int)fmod(s/60, 60.0), (int)fmod(s, 60.0));
+}
+
+/* repeatable uniform deviate in [0,1) */
+static double
+urand (void)
+{
+	rseed ^= rseed << 13;
+	rseed ^= rseed >> 7;
+	rseed ^= rseed << 17;
+	return ((rseed >> 11) * (1.0/9007199254740992.0));
+}
+
+static double
+secs (void)
+{
+	struct timeval tv;
+
+	gettimeofday (&tv, NULL);
+	return (tv.tv_sec + tv.tv_usec*1e-6);
+}
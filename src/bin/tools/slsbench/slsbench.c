@@ -0,0 +1,278 @@
+/* time finding the next New scan in a .sls file by cracking the text each
+ * time, as telrun used to, against looking in its compiled .slb with
+ * slsOpen(). also check the compiled scans agree with the text, that
+ * slsMark() marks both in place, and that changing the text recompiles it.
+ * exit 0 if all is well, else 1.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "P_.h"
+#include "astro.h"
+#include "circum.h"
+#include "scan.h"
+
+#define	DEFNSCANS	500	/* default scans in the test file */
+#define	DEFREPS		200	/* default lookups to time */
+
+static void usage (char *p);
+static int writeSLS (char *fn, int nscans, int ndone, char *how);
+static void pr1 (FILE *fp, int n, int done);
+static int findText (char *fn, Scan *sp);
+static int findMap (char *fn, SLSMap *mp, Scan *sp);
+static int check (char *fn, SLSMap *mp);
+static double secs (void);
+
+int
+main (int ac, char *av[])
+{
+	char *progname = av[0];
+	char *dir = "/tmp";
+	int nscans = DEFNSCANS, reps = DEFREPS;
+	char fn[1024];
+	SLSMap slsmap;
+	double t0, t1;
+	Scan s0, s1;
+	int i, bad;
+
+	while ((--ac > 0) && ((*++av)[0] == '-')) {
+	    char *s;
+	    for (s = av[0]+1; *s != '\0'; s++)
+		switch (*s) {
+		case 'd':
+		    if (ac < 2)
+			usage(progname);
+		    dir = *++av;
+		    ac--;
+		    break;
+		case 'n':
+		    if (ac < 2)
+			usage(progname);
+		    nscans = atoi (*++av);
+		    ac--;
+		    break;
+		case 'r':
+		    if (ac < 2)
+			usage(progname);
+		    reps = atoi (*++av);
+		    ac--;
+		    break;
+		default:
+		    usage(progname);
+		}
+	}
+	if (ac > 0 || nscans < 2 || reps < 1)
+	    usage (progname);
+
+	/* most are done already, as late in a night */
+	sprintf (fn, "%s/slsbench%d.sls", dir, (int)getpid());
+	if (writeSLS (fn, nscans, nscans*3/4, "w") < 0) {
+	    perror (fn);
+	    return (1);
+	}
+	memset ((void *)&slsmap, 0, sizeof(slsmap));
+
+	t0 = secs();
+	for (i = 0; i < reps; i++)
+	    if (findText (fn, &s0) < 0)
+		break;
+	t0 = secs() - t0;
+	t1 = secs();
+	for (i = 0; i < reps; i++)
+	    if (findMap (fn, &slsmap, &s1) < 0)
+		break;
+	t1 = secs() - t1;
+
+	printf ("%d scans, %d lookups:\n", nscans, reps);
+	printf ("  crack text  %9.3f ms/lookup\n", 1e3*t0/reps);
+	printf ("  compiled    %9.3f ms/lookup (%.0fx)\n", 1e3*t1/reps,
+							t1 > 0 ? t0/t1 : 0.0);
+
+	bad = memcmp ((void *)&s0, (void *)&s1, sizeof(Scan)) != 0;
+	if (bad)
+	    printf ("next New scans differ\n");
+	bad += check (fn, &slsmap);
+	if (bad)
+	    printf ("%d problems  FAIL\n", bad);
+	else
+	    printf ("compiled scans agree\n");
+
+	slsClose (&slsmap);
+	(void) unlink (fn);
+	strcpy (&fn[strlen(fn)-4], ".slb");
+	(void) unlink (fn);
+	return (bad ? 1 : 0);
+}
+
+static void
+usage (char *p)
+{
+	fprintf (stderr, "Usage: %s [options]\n", p);
+	fprintf (stderr, "Purpose: time and check compiled .sls scan lists.\n");
+	fprintf (stderr, "Options:\n");
+	fprintf (stderr, " -d dir  where to make the test files; default /tmp\n");
+	fprintf (stderr, " -n n    scans; default %d\n", DEFNSCANS);
+	fprintf (stderr, " -r n    lookups to time; default %d\n", DEFREPS);
+	exit (1);
+}
+
+/* write nscans to fn, opened with how, the first ndone marked Done.
+ * return 0 if ok, else -1.
+ */
+static int
+writeSLS (char *fn, int nscans, int ndone, char *how)
+{
+	FILE *fp = fopen (fn, how);
+	int i;
+
+	if (!fp)
+	    return (-1);
+	for (i = 0; i < nscans; i++)
+	    pr1 (fp, i, i < ndone);
+	return (fclose (fp) == 0 ? 0 : -1);
+}
+
+/* print scan n to fp in .sls format, as telsched does */
+static void
+pr1 (FILE *fp, int n, int done)
+{
+	int i = 0;
+
+	fprintf (fp, "%2d            status: %c\n", i++, done ? 'D' : 'N');
+	fprintf (fp, "%2d          start JD: %13.5f\n", i++,
+							2460000.5 + n/288.);
+	fprintf (fp, "%2d    lstdelta, mins: %-6g\n",  i++, 5.0);
+	fprintf (fp, "%2d           schedfn: %s\n",    i++, "bench.sch");
+	fprintf (fp, "%2d             title: Field %d\n", i++, n);
+	fprintf (fp, "%2d          observer: %s\n",    i++, "bench");
+	fprintf (fp, "%2d           comment: %s\n",    i++, "");
+	fprintf (fp, "%2d               EDB: F%d,f|S,%d:%02d:00,%+d:00:00,10,2000\n",
+					i++, n, (n/60)%24, n%60, n%90 - 45);
+	fprintf (fp, "%2d          RAOffset: %s\n",    i++, "0:00:00.0");
+	fprintf (fp, "%2d         DecOffset: %s\n",    i++, "0:00:00.0");
+	fprintf (fp, "%2d    frame position: %d+%d\n", i++, 0, 0);
+	fprintf (fp, "%2d        frame size: %dx%d\n", i++, 1024, 1024);
+	fprintf (fp, "%2d           binning: %dx%d\n", i++, 1+n%2, 1+n%2);
+	fprintf (fp, "%2d    duration, secs: %-6g\n",  i++, 30. + n%5*30);
+	fprintf (fp, "%2d           shutter: %s\n",    i++, "Open");
+	fprintf (fp, "%2d          ccdcalib: %s\n",    i++, "CATALOG");
+	fprintf (fp, "%2d            filter: %c\n",    i++, "BVRI"[n%4]);
+	fprintf (fp, "%2d             hcomp: %d\n",    i++, 0);
+	fprintf (fp, "%2d   Extended Action: %s\n",    i++, "");
+	fprintf (fp, "%2d  Ext. Act. Values: %s\n",    i++, "");
+	fprintf (fp, "%2d          priority: %d\n",    i++, n%3);
+	fprintf (fp, "%2d          pathname: /tmp/bench%04d.fts\n", i++, n);
+}
+
+/* find the first New scan in fn by cracking the text.
+ * return 0 if find one, else -1.
+ */
+static int
+findText (char *fn, Scan *sp)
+{
+	int found = 0;
+	FILE *fp;
+
+	fp = fopen (fn, "r");
+	if (!fp)
+	    return (-1);
+	while (readNextSLS (fp, sp, NULL) == 0)
+	    if (sp->status == 'N') {
+		found = 1;
+		break;
+	    }
+	(void) fclose (fp);
+	return (found ? 0 : -1);
+}
+
+/* find the first New scan in fn by way of mp.
+ * return 0 if find one, else -1.
+ */
+static int
+findMap (char *fn, SLSMap *mp, Scan *sp)
+{
+	int i;
+
+	if (slsOpen (fn, mp) < 0)
+	    return (-1);
+	for (i = 0; i < mp->nscans; i++)
+	    if (mp->status[i] == 'N') {
+		*sp = mp->scans[i];
+		return (0);
+	    }
+	return (-1);
+}
+
+/* check every compiled scan against the text, then mark one and add one.
+ * return number of problems.
+ */
+static int
+check (char *fn, SLSMap *mp)
+{
+	Scan s;
+	char *map;
+	FILE *fp;
+	int n, i, bad = 0;
+
+	if (slsOpen (fn, mp) < 0) {
+	    printf ("can not open %s\n", fn);
+	    return (1);
+	}
+	if (!mp->mapped) {
+	    printf ("%s was not written\n", fn);
+	    bad++;
+	}
+
+	/* each scan */
+	fp = fopen (fn, "r");
+	for (n = 0; fp && readNextSLS (fp, &s, NULL) == 0; n++)
+	    if (n >= mp->nscans || mp->status[n] != s.status
+		    || memcmp ((void *)&s, (void *)&mp->scans[n], sizeof(s))) {
+		printf ("scan %d differs\n", n);
+		bad++;
+	    }
+	if (fp)
+	    (void) fclose (fp);
+	if (n != mp->nscans) {
+	    printf ("%d scans in text, %d compiled\n", n, mp->nscans);
+	    return (bad + 1);
+	}
+
+	/* mark the first New one: the text should say so, and no recompile */
+	for (i = 0; i < n && mp->status[i] != 'N'; i++)
+	    continue;
+	map = mp->map;
+	if (i == n || slsMark (mp, i, 'F') < 0) {
+	    printf ("can not mark scan %d\n", i);
+	    bad++;
+	} else if (slsOpen (fn, mp) < 0 || mp->map != map) {
+	    printf ("marking scan %d recompiled\n", i);
+	    bad++;
+	} else if (findText (fn, &s) < 0 || !mp->scans[i+1].status
+			|| memcmp ((void *)&s, (void *)&mp->scans[i+1], sizeof(s))) {
+	    printf ("text does not show scan %d marked\n", i);
+	    bad++;
+	}
+
+	/* add one: should recompile */
+	if (writeSLS (fn, 1, 0, "a") < 0 || slsOpen (fn, mp) < 0
+						|| mp->nscans != n+1) {
+	    printf ("adding a scan was not seen\n");
+	    bad++;
+	}
+
+	return (bad);
+}
+
+static double
+secs (void)
+{
+	struct timeval tv;
+
+	gettimeofday (&tv, NULL);
+	return (tv.tv_sec + tv.tv_usec*1e-6);
+}
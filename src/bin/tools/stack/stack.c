@@ -0,0 +1,528 @@
+/* stack a sequence of FITS frames into one with stackFITS().
+ *
+ * each frame is aligned to the reference, by default the first, to a
+ * fraction of a pixel, and the frames are combined by mean, median or sigma
+ * clipping into the output file, which gets the header of the reference
+ * along with keywords telling how it was made.
+ *
+ * with -t, instead make a set of shifted synthetic frames, each with its own
+ * sky and a cosmic ray, in dir, and check each method finds the shifts,
+ * lowers the noise, and, for median and clipping, removes the cosmic rays;
+ * that small bands give the same result as one; and that clipping keeps good
+ * values where most frames agree exactly.
+ * exit 0 if all ok, else 1.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "P_.h"
+#include "astro.h"
+#include "fits.h"
+
+#define	TW		600	/* test frame width, pixels */
+#define	TH		400	/* test frame height, pixels */
+#define	TNSTARS		300	/* stars in test frames */
+#define	TSKY		1000	/* test sky, counts */
+#define	TNOISE		10.0	/* test noise sd, counts */
+#define	TCR		5000	/* test cosmic ray, counts */
+#define	TBORD		25	/* test border not covered by all frames */
+#define	SHIFTTOL	0.15	/* max test shift error, pixels */
+
+/* test frame shifts, pixels */
+static double tshifts[][2] = {
+    {0, 0},
+    {7.3, -4.6},
+    {-12.5, 9.25},
+    {20.1, 15.7},
+    {-3.6, -18.2},
+};
+#define	NTEST	(sizeof(tshifts)/sizeof(tshifts[0]))
+
+static void usage (char *p);
+static int doStack (char *fns[], int n, StackOpts *sop, char *outfn);
+static int doTest (char *dir, StackOpts *sop);
+static int testOne (char *fns[], StackOpts *sop, float *truth, int crx[],
+    int cry[], char *name);
+static int testTies (char *dir, StackOpts *sop, double stars[][3]);
+static int writeTest (char *fn, CamPixel *pix);
+static void render (float *truth, double stars[][3], double dx, double dy);
+static int clearSky (float *truth, int x0, int y0);
+static double gauss (void);
+static double urand (void);
+static double secs (void);
+
+static unsigned long long rseed = 88172645463325252ULL;
+
+int
+main (int ac, char *av[])
+{
+	StackOpts so;
+	char *outfn = NULL, *testdir = NULL;
+
+	memset ((void *)&so, 0, sizeof(so));
+
+	while ((--ac > 0) && ((*++av)[0] == '-')) {
+	    char *s;
+	    for (s = av[0]+1; *s != '\0'; s++)
+		switch (*s) {
+		case 'k':
+		    if (ac < 2)
+			usage ("stack");
+		    so.ksig = atof (*++av);
+		    ac--;
+		    break;
+		case 'm':
+		    if (ac < 2)
+			usage ("stack");
+		    ++av;
+		    ac--;
+		    if (!strcmp (*av, "mean"))
+			so.how = STK_MEAN;
+		    else if (!strcmp (*av, "median"))
+			so.how = STK_MEDIAN;
+		    else if (!strcmp (*av, "clip"))
+			so.how = STK_CLIP;
+		    else
+			usage ("stack");
+		    break;
+		case 'M':
+		    if (ac < 2)
+			usage ("stack");
+		    so.maxmem = atol (*++av) << 20;
+		    ac--;
+		    break;
+		case 'n':
+		    if (ac < 2)
+			usage ("stack");
+		    so.nthreads = atoi (*++av);
+		    ac--;
+		    break;
+		case 'o':
+		    if (ac < 2)
+			usage ("stack");
+		    outfn = *++av;
+		    ac--;
+		    break;
+		case 'r':
+		    if (ac < 2)
+			usage ("stack");
+		    so.ref = atoi (*++av);
+		    ac--;
+		    break;
+		case 't':
+		    if (ac < 2)
+			usage ("stack");
+		    testdir = *++av;
+		    ac--;
+		    break;
+		case 'w':
+		    so.weight = 1;
+		    break;
+		default:
+		    usage ("stack");
+		}
+	}
+
+	if (testdir)
+	    return (doTest (testdir, &so));
+	if (ac < 1 || !outfn)
+	    usage ("stack");
+	return (doStack (av, ac, &so, outfn));
+}
+
+static void
+usage (char *p)
+{
+	fprintf (stderr, "Usage: %s [options] -o out.fts file.fts ...\n", p);
+	fprintf (stderr, "       %s -t dir\n", p);
+	fprintf (stderr, "Purpose: align and combine a sequence of frames.\n");
+	fprintf (stderr, "Options:\n");
+	fprintf (stderr, " -k sd:   clip beyond this many sd, default 3\n");
+	fprintf (stderr, " -m how:  mean, median or clip; default mean\n");
+	fprintf (stderr, " -M MB:   frame pixels to hold at once, default 64\n");
+	fprintf (stderr, " -n n:    threads, default one per cpu\n");
+	fprintf (stderr, " -o file: write result to file\n");
+	fprintf (stderr, " -r i:    reference is the i'th file, from 0\n");
+	fprintf (stderr, " -t dir:  test with synthetic frames made in dir\n");
+	fprintf (stderr, " -w:      weight frames by inverse noise variance\n");
+	exit (1);
+}
+
+/* stack the n files fns[] into outfn.
+ * return 0 if ok, else 1.
+ */
+static int
+doStack (char *fns[], int n, StackOpts *sop, char *outfn)
+{
+	char msg[1024];
+	FImage fim;
+	double t;
+	int nused, fd;
+
+	t = secs();
+	nused = stackFITS (fns, n, sop, &fim, msg);
+	if (nused < 0) {
+	    fprintf (stderr, "%s\n", msg);
+	    return (1);
+	}
+	t = secs() - t;
+
+	fd = open (outfn, O_WRONLY|O_CREAT|O_TRUNC, 0664);
+	if (fd < 0) {
+	    perror (outfn);
+	    resetFImage (&fim);
+	    return (1);
+	}
+	if (writeFITS (fd, &fim, msg, 0) < 0) {
+	    fprintf (stderr, "%s: %s\n", outfn, msg);
+	    close (fd);
+	    resetFImage (&fim);
+	    return (1);
+	}
+	close (fd);
+	resetFImage (&fim);
+
+	printf ("%s: stacked %d of %d frames in %.2f s\n", outfn, nused, n, t);
+	return (nused < n);
+}
+
+/* make the test frames in dir and check each method on them.
+ * return 0 if all ok, else 1.
+ */
+static int
+doTest (char *dir, StackOpts *sop)
+{
+	double stars[TNSTARS][3];
+	char fnbuf[NTEST][1024];
+	char *fns[NTEST];
+	int crx[NTEST], cry[NTEST];
+	CamPixel *pix;
+	float *truth, *frame;
+	int i, j, bad = 0;
+
+	for (i = 0; i < TNSTARS; i++) {
+	    stars[i][0] = TW*urand();
+	    stars[i][1] = TH*urand();
+	    stars[i][2] = 200 + 20000*pow(urand(), 4.0);
+	}
+	truth = (float *) malloc (TW*TH*sizeof(float));
+	frame = (float *) malloc (TW*TH*sizeof(float));
+	pix = (CamPixel *) malloc (TW*TH*sizeof(CamPixel));
+	render (truth, stars, 0, 0);
+
+	/* each frame sees the sky shifted, with its own sky level, noise and
+	 * a cosmic ray, placed on clear sky in the reference so we can find
+	 * them there.
+	 */
+	for (i = 0; i < NTEST; i++) {
+	    double dx = tshifts[i][0], dy = tshifts[i][1];
+	    int x, y;
+
+	    do {
+		crx[i] = TBORD + (int)((TW - 2*TBORD - 3)*urand());
+		cry[i] = TBORD + (int)((TH - 2*TBORD - 3)*urand());
+	    } while (!clearSky (truth, crx[i], cry[i]));
+	    render (frame, stars, dx, dy);
+	    for (j = 0; j < TW*TH; j++) {
+		double v = frame[j] + 40*i + TNOISE*gauss();
+
+		pix[j] = v < 0 ? 0 : (v > MAXCAMPIX ? MAXCAMPIX : v + 0.5);
+	    }
+	    for (y = 0; y < 3; y++)
+		for (x = 0; x < 3; x++) {
+		    int px = (int)floor(crx[i] + x - dx);
+		    int py = (int)floor(cry[i] + y - dy);
+
+		    if (px >= 0 && px < TW && py >= 0 && py < TH)
+			pix[py*TW + px] += TCR;
+		}
+
+	    sprintf (fnbuf[i], "%s/stack%d.fts", dir, i);
+	    fns[i] = fnbuf[i];
+	    if (writeTest (fns[i], pix) < 0) {
+		free ((void *)truth);
+		free ((void *)frame);
+		free ((void *)pix);
+		return (1);
+	    }
+	}
+	free ((void *)pix);
+	free ((void *)frame);
+
+	sop->ref = 0;
+	sop->how = STK_MEAN;
+	bad |= testOne (fns, sop, truth, crx, cry, "mean");
+	sop->how = STK_MEDIAN;
+	bad |= testOne (fns, sop, truth, crx, cry, "median");
+	sop->how = STK_CLIP;
+	bad |= testOne (fns, sop, truth, crx, cry, "clip");
+	sop->weight = 1;
+	bad |= testOne (fns, sop, truth, crx, cry, "clip, weighted");
+	sop->weight = 0;
+	bad |= testTies (dir, sop, stars);
+
+	for (i = 0; i < NTEST; i++)
+	    (void) unlink (fns[i]);
+	free ((void *)truth);
+
+	printf ("%s\n", bad ? "FAIL" : "stacking ok");
+	return (bad);
+}
+
+/* stack the test frames fns[] as told by sop and check the result against
+ * truth, the noiseless frame, and the cosmic rays at crx[],cry[].
+ * return 0 if ok, else 1.
+ */
+static int
+testOne (char *fns[], StackOpts *sop, float *truth, int crx[], int cry[],
+char *name)
+{
+	StackOpts small = *sop;
+	char msg[1024], buf[128], key[16], fn[1024];
+	FImage fim, fim2;
+	CamPixel *p;
+	double t, s2, crmax, dx, dy;
+	int nused, n, i, x, y;
+	int bad = 0;
+
+	t = secs();
+	nused = stackFITS (fns, NTEST, sop, &fim, msg);
+	t = secs() - t;
+	if (nused < 0) {
+	    printf ("%-15s %s  FAIL\n", name, msg);
+	    return (1);
+	}
+	p = (CamPixel *)fim.image;
+
+	/* noise where there are no stars or cosmic rays, and worst cosmic ray
+	 * left.
+	 */
+	s2 = 0;
+	for (n = 0, y = TBORD; y < TH-TBORD; y++)
+	    for (x = TBORD; x < TW-TBORD; x++) {
+		for (i = 0; i < NTEST; i++)
+		    if (abs(x - crx[i] - 1) < 4 && abs(y - cry[i] - 1) < 4)
+			break;
+		if (i == NTEST && truth[y*TW+x] < TSKY + 1) {
+		    double d = p[y*TW+x] - truth[y*TW+x];
+
+		    s2 += d*d;
+		    n++;
+		}
+	    }
+	crmax = 0;
+	for (i = 0; i < NTEST; i++)
+	    for (y = cry[i]; y < cry[i]+3; y++)
+		for (x = crx[i]; x < crx[i]+3; x++)
+		    if (fabs(p[y*TW+x] - truth[y*TW+x]) > crmax)
+			crmax = fabs(p[y*TW+x] - truth[y*TW+x]);
+
+	printf ("%-15s %d frames in %6.1f ms, noise %.2f of %.2f, worst cosmic ray %5.0f\n",
+			    name, nused, 1e3*t, sqrt(s2/n), TNOISE, crmax);
+
+	if (nused != NTEST) {
+	    printf ("  only %d frames used  FAIL\n", nused);
+	    bad = 1;
+	}
+	if (sqrt(s2/n) > (sop->how == STK_MEDIAN ? 0.75 : 0.6)*TNOISE) {
+	    printf ("  noise too high  FAIL\n");
+	    bad = 1;
+	}
+	if (sop->how != STK_MEAN && crmax > 10*TNOISE) {
+	    printf ("  cosmic rays not removed  FAIL\n");
+	    bad = 1;
+	}
+
+	/* provenance records each shift */
+	for (i = 0; i < NTEST; i++) {
+	    sprintf (key, "STK%03d", i+1);
+	    if (getStringFITS (&fim, key, buf) < 0
+			    || sscanf (buf, "%s %lf %lf", fn, &dx, &dy) != 3
+			    || fabs (dx - tshifts[i][0]) > SHIFTTOL
+			    || fabs (dy - tshifts[i][1]) > SHIFTTOL) {
+		printf ("  %s: '%s' wrong  FAIL\n", key, buf);
+		bad = 1;
+	    }
+	}
+
+	/* many small bands in several threads must give the same result */
+	small.maxmem = 1;
+	small.nthreads = 3;
+	if (stackFITS (fns, NTEST, &small, &fim2, msg) < 0) {
+	    printf ("  small bands: %s  FAIL\n", msg);
+	    bad = 1;
+	} else {
+	    if (memcmp (fim.image, fim2.image, TW*TH*sizeof(CamPixel))) {
+		printf ("  small bands differ  FAIL\n");
+		bad = 1;
+	    }
+	    resetFImage (&fim2);
+	}
+
+	resetFImage (&fim);
+	return (bad);
+}
+
+/* clip three frames of stars[], the first two identical, so the median
+ * absolute deviation at every pixel is 0. the third frame must still be
+ * used wherever it is within the noise.
+ * return 0 if ok, else 1.
+ */
+static int
+testTies (char *dir, StackOpts *sop, double stars[][3])
+{
+	char fnbuf[3][1024], msg[1024];
+	char *fns[3];
+	StackOpts opts = *sop;
+	CamPixel *pix;
+	float *frame;
+	FImage fim;
+	int nused, nrej;
+	int i, j, bad = 0;
+
+	frame = (float *) malloc (TW*TH*sizeof(float));
+	pix = (CamPixel *) malloc (TW*TH*sizeof(CamPixel));
+	for (i = 0; i < 3; i++) {
+	    sprintf (fnbuf[i], "%s/ties%d.fts", dir, i);
+	    fns[i] = fnbuf[i];
+	    if (i != 1) {
+		render (frame, stars, i ? 3 : 0, i ? -2 : 0);
+		for (j = 0; j < TW*TH; j++)
+		    frame[j] += TNOISE*gauss();
+	    }
+	    for (j = 0; j < TW*TH; j++) {
+		double v = frame[j];
+
+		pix[j] = v < 0 ? 0 : (v > MAXCAMPIX ? MAXCAMPIX : v + 0.5);
+	    }
+	    if (writeTest (fns[i], pix) < 0) {
+		while (--i >= 0)
+		    (void) unlink (fns[i]);
+		free ((void *)frame);
+		free ((void *)pix);
+		return (1);
+	    }
+	}
+	free ((void *)frame);
+	free ((void *)pix);
+
+	opts.ref = 0;
+	opts.how = STK_CLIP;
+	nused = stackFITS (fns, 3, &opts, &fim, msg);
+	if (nused < 0) {
+	    printf ("%-15s %s  FAIL\n", "clip, ties", msg);
+	    bad = 1;
+	} else {
+	    if (getIntFITS (&fim, "STKNREJ", &nrej) < 0)
+		nrej = TW*TH;
+	    printf ("%-15s %d frames, %d of %d pixels clipped\n", "clip, ties",
+							nused, nrej, TW*TH);
+	    if (nused != 3) {
+		printf ("  only %d frames used  FAIL\n", nused);
+		bad = 1;
+	    }
+	    if (nrej > TW*TH/10) {
+		printf ("  good values clipped  FAIL\n");
+		bad = 1;
+	    }
+	    resetFImage (&fim);
+	}
+
+	for (i = 0; i < 3; i++)
+	    (void) unlink (fns[i]);
+	return (bad);
+}
+
+/* write the TW x TH pixels pix as a new FITS file fn.
+ * return 0 if ok, else -1.
+ */
+static int
+writeTest (char *fn, CamPixel *pix)
+{
+	int fd;
+
+	fd = open (fn, O_WRONLY|O_CREAT|O_TRUNC, 0664);
+	if (fd < 0) {
+	    perror (fn);
+	    return (-1);
+	}
+	if (writeSimpleFITS (fd, (char *)pix, TW, TH, 0, 0, 1000, 0) < 0) {
+	    fprintf (stderr, "%s: write error\n", fn);
+	    close (fd);
+	    return (-1);
+	}
+	close (fd);
+	return (0);
+}
+
+/* fill truth with the noiseless TW x TH frame of stars[] shifted by dx,dy, ie,
+ * with pixel x,y at x+dx,y+dy of the unshifted frame.
+ */
+static void
+render (float *truth, double stars[][3], double dx, double dy)
+{
+	double s2 = 2*1.5*1.5;
+	int i, x, y;
+
+	for (i = 0; i < TW*TH; i++)
+	    truth[i] = TSKY;
+	for (i = 0; i < TNSTARS; i++) {
+	    double sx = stars[i][0] - dx, sy = stars[i][1] - dy;
+
+	    for (y = (int)sy - 6; y <= (int)sy + 6; y++)
+		for (x = (int)sx - 6; x <= (int)sx + 6; x++)
+		    if (x >= 0 && x < TW && y >= 0 && y < TH)
+			truth[y*TW + x] += stars[i][2]*exp (-((x-sx)*(x-sx)
+						    + (y-sy)*(y-sy))/s2);
+	}
+}
+
+/* return whether the 3x3 pixels at x0,y0 of truth and those around them are
+ * clear of stars.
+ */
+static int
+clearSky (float *truth, int x0, int y0)
+{
+	int x, y;
+
+	for (y = y0-3; y < y0+6; y++)
+	    for (x = x0-3; x < x0+6; x++)
+		if (truth[y*TW+x] >= TSKY + 1)
+		    return (0);
+	return (1);
+}
+
+/* unit gaussian deviate */
+static double
+gauss (void)
+{
+	double u1 = urand(), u2 = urand();
+
+	return (sqrt(-2*log(u1 + 1e-300))*cos(2*PI*u2));
+}
+
+/* repeatable uniform deviate in [0,1) */
+static double
+urand (void)
+{
+	rseed ^= rseed << 13;
+	rseed ^= rseed >> 7;
+	rseed ^= rseed << 17;
+	return ((rseed >> 11) * (1.0/9007199254740992.0));
+}
+
+static double
+secs (void)
+{
+	struct timeval tv;
+
+	gettimeofday (&tv, NULL);
+	return (tv.tv_sec + tv.tv_usec*1e-6);
+}
@@ -0,0 +1,247 @@
+/* compare the STARFAST star measurements of starStats() with the full
+ * gaussfit() ones on real frames.
+ *
+ * for each FITS file, times starStats() on every star findStars() finds and
+ * fwhmFITS(), both ways, and reports how the centroids and FWHMs of the same
+ * stars differ.
+ * exit 0 if the fast answers agree with the full ones to within CENTOL and
+ * FWHMTOL in the median and fwhmFITS() agrees to FITSTOL, else 1.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "P_.h"
+#include "astro.h"
+#include "fits.h"
+
+#define	CENTOL		0.1	/* max median centroid difference, pixels */
+#define	FWHMTOL		0.1	/* max median fractional FWHM difference */
+#define	FITSTOL		0.15	/* max fractional fwhmFITS() difference */
+#define	NREP		3	/* repeats for timing */
+
+static void usage (char *p);
+static int bench (char *fn);
+static int stats (FImage *fip, int fast, int *x, int *y, int n,
+    StarStats *ss, int *ok);
+static double median (double a[], int n);
+static int cmp_dbl (const void *p1, const void *p2);
+static double secs (void);
+
+int
+main (int ac, char *av[])
+{
+	int bad = 0;
+
+	while ((--ac > 0) && ((*++av)[0] == '-')) {
+	    char *s;
+	    for (s = av[0]+1; *s != '\0'; s++)
+		switch (*s) {
+		case 'i':
+		    if (ac < 2)
+			usage ("starbench");
+		    setIpCfgPath (*++av);
+		    ac--;
+		    break;
+		default:
+		    usage ("starbench");
+		}
+	}
+	if (ac < 1)
+	    usage ("starbench");
+
+	/* load now so our STARFAST settings are not overwritten */
+	loadIpCfg();
+
+	while (ac-- > 0)
+	    bad |= bench (*av++);
+
+	printf ("%s\n", bad ? "FAIL" : "STARFAST agrees");
+	return (bad);
+}
+
+static void
+usage (char *p)
+{
+	fprintf (stderr, "Usage: %s [options] file.fts ...\n", p);
+	fprintf (stderr, "Purpose: compare STARFAST star stats with full gaussian fits.\n");
+	fprintf (stderr, "Options:\n");
+	fprintf (stderr, " -i file: ip.cfg to use\n");
+	exit (1);
+}
+
+/* compare both ways of measuring the stars in fn.
+ * return 0 if they agree, else 1.
+ */
+static int
+bench (char *fn)
+{
+	double tfind, tfull, tfast, hf, hsf, vf, vsf, hq, hsq, vq, vsq;
+	double *dc, *df;
+	StarStats *full, *fast;
+	int *okfull, *okfast;
+	char msg[1024];
+	FImage fim;
+	int *x, *y;
+	CamPixel *b;
+	int nfs, n, i, fd;
+	double mc, mf;
+	int bad = 0;
+
+	fd = open (fn, O_RDONLY);
+	if (fd < 0) {
+	    perror (fn);
+	    return (1);
+	}
+	initFImage (&fim);
+	if (readFITS (fd, &fim, msg) < 0) {
+	    fprintf (stderr, "%s: %s\n", fn, msg);
+	    close (fd);
+	    return (1);
+	}
+	close (fd);
+
+	tfind = secs();
+	nfs = findStars (fim.image, fim.sw, fim.sh, &x, &y, &b);
+	tfind = secs() - tfind;
+	if (nfs <= 0) {
+	    printf ("%s: no stars  FAIL\n", fn);
+	    resetFImage (&fim);
+	    return (1);
+	}
+
+	full = (StarStats *) malloc (nfs*sizeof(StarStats));
+	fast = (StarStats *) malloc (nfs*sizeof(StarStats));
+	okfull = (int *) malloc (nfs*sizeof(int));
+	okfast = (int *) malloc (nfs*sizeof(int));
+	tfull = 1e9;
+	tfast = 1e9;
+	for (i = 0; i < NREP; i++) {
+	    double t;
+
+	    t = secs();
+	    (void) stats (&fim, 0, x, y, nfs, full, okfull);
+	    t = secs() - t;
+	    if (t < tfull)
+		tfull = t;
+	    t = secs();
+	    (void) stats (&fim, 1, x, y, nfs, fast, okfast);
+	    t = secs() - t;
+	    if (t < tfast)
+		tfast = t;
+	}
+
+	dc = (double *) malloc (2*nfs*sizeof(double));
+	df = (double *) malloc (2*nfs*sizeof(double));
+	for (n = i = 0; i < nfs; i++) {
+	    if (!okfull[i] || !okfast[i])
+		continue;
+	    dc[2*n] = fabs (fast[i].x - full[i].x);
+	    dc[2*n+1] = fabs (fast[i].y - full[i].y);
+	    df[2*n] = fabs (fast[i].xfwhm - full[i].xfwhm)/full[i].xfwhm;
+	    df[2*n+1] = fabs (fast[i].yfwhm - full[i].yfwhm)/full[i].yfwhm;
+	    n++;
+	}
+	if (n == 0) {
+	    printf ("%s: no measurable stars  FAIL\n", fn);
+	    resetFImage (&fim);
+	    return (1);
+	}
+	mc = median (dc, 2*n);
+	mf = median (df, 2*n);
+
+	printf ("%s: %d stars, %d measured\n", fn, nfs, n);
+	printf ("  findStars %.2f ms\n", 1e3*tfind);
+	printf ("  starStats: full %8.2f ms, fast %8.2f ms, %.1fx\n",
+				1e3*tfull, 1e3*tfast, tfull/tfast);
+	printf ("  median centroid difference %.3f pixels, 90%% %.3f\n", mc,
+							dc[(int)(0.9*2*n)]);
+	printf ("  median FWHM difference %.1f%%, 90%% %.1f%%\n", 100*mf,
+						    100*df[(int)(0.9*2*n)]);
+
+	STARFAST = 0;
+	tfull = secs();
+	i = fwhmFITS (fim.image, fim.sw, fim.sh, &hf, &hsf, &vf, &vsf, msg);
+	tfull = secs() - tfull;
+	STARFAST = 1;
+	tfast = secs();
+	i |= fwhmFITS (fim.image, fim.sw, fim.sh, &hq, &hsq, &vq, &vsq, msg);
+	tfast = secs() - tfast;
+	if (i < 0)
+	    printf ("  fwhmFITS: %s\n", msg);
+	else
+	    printf ("  fwhmFITS: full %.2f x %.2f in %.2f ms, fast %.2f x %.2f in %.2f ms\n",
+			    hf, vf, 1e3*tfull, hq, vq, 1e3*tfast);
+
+	if (mc > CENTOL || mf > FWHMTOL || i < 0
+				|| fabs(hq-hf) > FITSTOL*hf
+				|| fabs(vq-vf) > FITSTOL*vf) {
+	    printf ("  FAIL\n");
+	    bad = 1;
+	}
+
+	free ((void *)dc);
+	free ((void *)df);
+	free ((void *)full);
+	free ((void *)fast);
+	free ((void *)okfull);
+	free ((void *)okfast);
+	free ((void *)x);
+	free ((void *)y);
+	free ((void *)b);
+	resetFImage (&fim);
+	return (bad);
+}
+
+/* run starStats() on each of the n stars at x[],y[] in fip with STARFAST
+ * set to fast, as findStatStars() does. set ok[i] if ss[i] is good.
+ * return number of good stars.
+ */
+static int
+stats (FImage *fip, int fast, int *x, int *y, int n, StarStats *ss, int *ok)
+{
+	char buf[1024];
+	StarDfn sd;
+	int i, ngood;
+
+	STARFAST = fast;
+	sd.rsrch = 0;
+	sd.rAp = 0;
+	sd.how = SSHOW_HERE;
+	for (ngood = i = 0; i < n; i++) {
+	    ok[i] = starStats ((CamPixel *)fip->image, fip->sw, fip->sh, &sd,
+						    x[i], y[i], &ss[i], buf) == 0;
+	    ngood += ok[i];
+	}
+	return (ngood);
+}
+
+/* sort a[] and return its median */
+static double
+median (double a[], int n)
+{
+	qsort ((void *)a, n, sizeof(double), cmp_dbl);
+	return (a[n/2]);
+}
+
+static int
+cmp_dbl (const void *p1, const void *p2)
+{
+	double d = *(double *)p1 - *(double *)p2;
+
+	return (d == 0 ? 0 : (d > 0 ? 1 : -1));
+}
+
+static double
+secs (void)
+{
+	struct timeval tv;
+
+	gettimeofday (&tv, NULL);
+	return (tv.tv_sec + tv.tv_usec*1e-6);
+}
@@ -0,0 +1,286 @@
+/* make, show or check the binary star list sidecars of FITS files.
+ *
+ * with -w, measure the stars of each file and write its list.
+ * with -t, also check that once the list is in use findStars() and
+ *   findStatStars() give what they do without it, that the list goes stale
+ *   when the pixels change, and report how much time it saves.
+ * else print each file's list as text, if it has a good one.
+ * exit 0 if all ok, else 1.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "P_.h"
+#include "astro.h"
+#include "fits.h"
+#include "strops.h"
+
+#define	POSTOL		1e-3	/* max centroid difference, pixels */
+
+static void usage (char *p);
+static int readFile (char *fn, FImage *fip);
+static int doWrite (char *fn, char *slfn, FImage *fip);
+static int doShow (char *fn, char *slfn, FImage *fip);
+static int doTest (char *fn, char *slfn, FImage *fip);
+static double secs (void);
+
+static char *outdir;
+
+int
+main (int ac, char *av[])
+{
+	int wflag = 0, tflag = 0;
+	int bad = 0;
+
+	while ((--ac > 0) && ((*++av)[0] == '-')) {
+	    char *s;
+	    for (s = av[0]+1; *s != '\0'; s++)
+		switch (*s) {
+		case 'i':
+		    if (ac < 2)
+			usage ("starlist");
+		    setIpCfgPath (*++av);
+		    ac--;
+		    break;
+		case 'o':
+		    if (ac < 2)
+			usage ("starlist");
+		    outdir = *++av;
+		    ac--;
+		    break;
+		case 't':
+		    tflag++;
+		    break;
+		case 'w':
+		    wflag++;
+		    break;
+		default:
+		    usage ("starlist");
+		}
+	}
+	if (ac < 1)
+	    usage ("starlist");
+
+	loadIpCfg();
+
+	while (ac-- > 0) {
+	    char *fn = *av++;
+	    char slfn[1024];
+	    FImage fim;
+
+	    if (outdir)
+		sprintf (slfn, "%s/%s", outdir, basenm(fn));
+	    else
+		strcpy (slfn, fn);
+	    if (readFile (fn, &fim) < 0) {
+		bad = 1;
+		continue;
+	    }
+	    if (tflag)
+		bad |= doTest (fn, slfn, &fim);
+	    else if (wflag)
+		bad |= doWrite (fn, slfn, &fim);
+	    else
+		bad |= doShow (fn, slfn, &fim);
+	    resetFImage (&fim);
+	}
+
+	if (tflag)
+	    printf ("%s\n", bad ? "FAIL" : "star lists agree");
+	return (bad);
+}
+
+static void
+usage (char *p)
+{
+	fprintf (stderr, "Usage: %s [options] file.fts ...\n", p);
+	fprintf (stderr, "Purpose: make, show or check binary star lists.\n");
+	fprintf (stderr, "Options:\n");
+	fprintf (stderr, " -i file: ip.cfg to use\n");
+	fprintf (stderr, " -o dir:  lists are in dir, not beside each file\n");
+	fprintf (stderr, " -t:      write then test each list against a fresh search\n");
+	fprintf (stderr, " -w:      measure and write each list\n");
+	exit (1);
+}
+
+static int
+readFile (char *fn, FImage *fip)
+{
+	char msg[1024];
+	int fd;
+
+	fd = open (fn, O_RDONLY);
+	if (fd < 0) {
+	    perror (fn);
+	    return (-1);
+	}
+	initFImage (fip);
+	if (readFITS (fd, fip, msg) < 0) {
+	    fprintf (stderr, "%s: %s\n", fn, msg);
+	    close (fd);
+	    return (-1);
+	}
+	close (fd);
+	return (0);
+}
+
+/* measure and write the list of fip as slfn's */
+static int
+doWrite (char *fn, char *slfn, FImage *fip)
+{
+	char msg[1024];
+	StarRec *sr;
+	int n, s;
+
+	n = measureStarList (fip, &sr);
+	if (n < 0) {
+	    fprintf (stderr, "%s: error finding stars\n", fn);
+	    return (1);
+	}
+	s = writeStarList (slfn, fip, sr, n, msg);
+	free ((void *)sr);
+	if (s < 0) {
+	    fprintf (stderr, "%s\n", msg);
+	    return (1);
+	}
+	return (0);
+}
+
+/* print the list of slfn, if it is good for fip */
+static int
+doShow (char *fn, char *slfn, FImage *fip)
+{
+	char msg[1024];
+	StarList *slp;
+	int i;
+
+	slp = openStarList (slfn, fip, msg);
+	if (!slp) {
+	    fprintf (stderr, "%s\n", msg);
+	    return (1);
+	}
+	printf ("# %s: %d stars\n", fn, slp->n);
+	printf ("#      x        y  xfwhm  yfwhm      Src    Sky      p  fl          RA          Dec\n");
+	for (i = 0; i < slp->n; i++) {
+	    StarRec *rp = &slp->s[i];
+	    char rabuf[32], decbuf[32];
+
+	    if (rp->flags & SL_RADEC) {
+		fs_sexa (rabuf, radhr(rp->ra), 3, 360000);
+		fs_sexa (decbuf, raddeg(rp->dec), 3, 36000);
+	    } else
+		rabuf[0] = decbuf[0] = '\0';
+	    printf ("%8.2f %8.2f %6.2f %6.2f %8d %6d %6d %3d %12s %12s\n",
+			    rp->x, rp->y, rp->xfwhm, rp->yfwhm, rp->Src,
+			    rp->Sky, rp->p, rp->flags, rabuf, decbuf);
+	}
+	closeStarList (slp);
+	return (0);
+}
+
+/* write the list for fip, then check findStars() and findStatStars() agree
+ * with and without it, and that it goes stale when a pixel changes or the
+ * rows are flipped.
+ */
+static int
+doTest (char *fn, char *slfn, FImage *fip)
+{
+	double tfind, tfast;
+	StarStats *ss0, *ss1;
+	int *x0, *y0, *x1, *y1;
+	CamPixel *b0, *b1;
+	int n0, n1, ns0, ns1, i;
+	CamPixel *pix;
+	int bad = 0;
+
+	tfind = secs();
+	n0 = findStars (fip->image, fip->sw, fip->sh, &x0, &y0, &b0);
+	ns0 = findStatStars (fip->image, fip->sw, fip->sh, &ss0);
+	tfind = secs() - tfind;
+	if (n0 <= 0 || ns0 <= 0) {
+	    printf ("%s: no stars  FAIL\n", fn);
+	    return (1);
+	}
+
+	if (doWrite (fn, slfn, fip) || useStarList (slfn, fip) < 0) {
+	    printf ("%s: list could not be written and used  FAIL\n", fn);
+	    return (1);
+	}
+
+	tfast = secs();
+	n1 = findStars (fip->image, fip->sw, fip->sh, &x1, &y1, &b1);
+	ns1 = findStatStars (fip->image, fip->sw, fip->sh, &ss1);
+	tfast = secs() - tfast;
+
+	printf ("%s: %d stars, %d measured\n", fn, n0, ns0);
+	printf ("  search %.2f ms, from list %.2f ms\n", 1e3*tfind, 1e3*tfast);
+
+	if (n1 != n0 || ns1 != ns0) {
+	    printf ("  list has %d stars, %d measured  FAIL\n", n1, ns1);
+	    bad = 1;
+	} else {
+	    for (i = 0; i < n0; i++)
+		if (x1[i] != x0[i] || y1[i] != y0[i] || b1[i] != b0[i])
+		    break;
+	    if (i < n0) {
+		printf ("  star %d differs  FAIL\n", i);
+		bad = 1;
+	    }
+	    for (i = 0; i < ns0; i++)
+		if (fabs(ss1[i].x - ss0[i].x) > POSTOL
+				    || fabs(ss1[i].y - ss0[i].y) > POSTOL
+				    || ss1[i].Src != ss0[i].Src
+				    || ss1[i].Sky != ss0[i].Sky)
+		    break;
+	    if (i < ns0) {
+		printf ("  stats of star %d differ  FAIL\n", i);
+		bad = 1;
+	    }
+	}
+	free ((void *)x1);
+	free ((void *)y1);
+	free ((void *)b1);
+	free ((void *)ss1);
+
+	/* any change to the pixels must make the list stale */
+	pix = (CamPixel *)fip->image;
+	pix[fip->sw*fip->sh/2] ^= 1;
+	if (getStarList (fip->image, fip->sw, fip->sh, NULL,
+						    (StarRec **)&ss1) >= 0) {
+	    printf ("  list still used after pixels changed  FAIL\n");
+	    free ((void *)ss1);
+	    bad = 1;
+	}
+	pix[fip->sw*fip->sh/2] ^= 1;
+
+	/* as must flipping, as camera does, which leaves every sum alone */
+	flipImgRows (pix, fip->sw, fip->sh);
+	if (getStarList (fip->image, fip->sw, fip->sh, NULL,
+						    (StarRec **)&ss1) >= 0) {
+	    printf ("  list still used after rows flipped  FAIL\n");
+	    free ((void *)ss1);
+	    bad = 1;
+	}
+	flipImgRows (pix, fip->sw, fip->sh);
+
+	free ((void *)x0);
+	free ((void *)y0);
+	free ((void *)b0);
+	free ((void *)ss0);
+	return (bad);
+}
+
+static double
+secs (void)
+{
+	struct timeval tv;
+
+	gettimeofday (&tv, NULL);
+	return (tv.tv_sec + tv.tv_usec*1e-6);
+}
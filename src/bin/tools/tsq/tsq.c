@@ -0,0 +1,489 @@
+/* query a time series store made with tseries.c, such as wxd -T keeps.
+ *
+ * prints each row, or the mean, min and max in bins, over a range of JD.
+ * with -t, instead builds a scratch store of 90 days of 10 second samples,
+ * checks every way of reading it back and reports the times taken.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "tseries.h"
+
+#define	JD1970	2440587.5	/* JD of 1970 Jan 1 0h UTC */
+#define	MAXCOLS	TS_MAXCOLS
+
+/* self test store */
+#define	TSTDAYS	90		/* days */
+#define	TSTDT	10		/* secs between samples */
+#define	TSTNC	5		/* columns */
+#define	TSTT0	1717200000.0	/* first time, 2024 Jun 1 0h UTC */
+
+static void usage (char *p);
+static int info (char *dir);
+static int selftest (void);
+static void tstRow (long i, double *tp, double v[TSTNC]);
+static int tstBins (char *dir, double t0, double t1, double step);
+static int sameVal (double a, double b);
+static void rmStore (char *dir);
+static double secs (void);
+
+int
+main (int ac, char *av[])
+{
+	char *progname = av[0];
+	char *colstr = NULL;
+	char *cols[MAXCOLS];
+	double jd0 = 0, jd1 = 0;
+	double step = 0;
+	TSResult r;
+	char msg[1024];
+	char *dir;
+	int iflag = 0;
+	int ncols = 0;
+	int i, c;
+
+	while ((--ac > 0) && ((*++av)[0] == '-')) {
+	    char *s;
+	    for (s = av[0]+1; *s != '\0'; s++)
+		switch (*s) {
+		case 'b':
+		    if (ac < 2)
+			usage(progname);
+		    jd0 = atof (*++av);
+		    ac--;
+		    break;
+		case 'c':
+		    if (ac < 2)
+			usage(progname);
+		    colstr = *++av;
+		    ac--;
+		    break;
+		case 'e':
+		    if (ac < 2)
+			usage(progname);
+		    jd1 = atof (*++av);
+		    ac--;
+		    break;
+		case 'i':
+		    iflag++;
+		    break;
+		case 's':
+		    if (ac < 2)
+			usage(progname);
+		    step = atof (*++av);
+		    ac--;
+		    break;
+		case 't':
+		    return (selftest());
+		default:
+		    usage(progname);
+		}
+	}
+	if (ac != 1 || step < 0)
+	    usage (progname);
+	dir = av[0];
+
+	if (iflag)
+	    return (info (dir));
+
+	if (colstr) {
+	    char *tok;
+	    for (tok = strtok (colstr, ","); tok; tok = strtok (NULL, ",")) {
+		if (ncols == MAXCOLS) {
+		    fprintf (stderr, "At most %d columns\n", MAXCOLS);
+		    return (1);
+		}
+		cols[ncols++] = tok;
+	    }
+	}
+
+	/* default to the whole store */
+	if (jd0 == 0 || jd1 == 0) {
+	    double t0, t1;
+	    long nrows, nbytes;
+
+	    if (tsSpan (dir, &t0, &t1, &nrows, &nbytes, msg) < 0) {
+		fprintf (stderr, "%s\n", msg);
+		return (1);
+	    }
+	    if (jd0 == 0)
+		jd0 = JD1970 + t0/86400.0;
+	    if (jd1 == 0)
+		jd1 = JD1970 + t1/86400.0;
+	}
+
+	if (tsQuery (dir, (jd0-JD1970)*86400.0, (jd1-JD1970)*86400.0, step,
+					    cols, ncols, &r, msg) < 0) {
+	    fprintf (stderr, "%s\n", msg);
+	    return (1);
+	}
+
+	/* heading, using the store's names if all columns */
+	if (ncols == 0) {
+	    char names[TS_MAXCOLS][TS_NAMELEN];
+
+	    (void) tsColumns (dir, names, msg);
+	    for (c = 0; c < r.ncols; c++)
+		cols[c] = strcpy ((char *) malloc (TS_NAMELEN), names[c]);
+	}
+	printf ("# JD");
+	if (step > 0) {
+	    printf (" N");
+	    for (c = 0; c < r.ncols; c++)
+		printf (" %s %s_min %s_max", cols[c], cols[c], cols[c]);
+	} else
+	    for (c = 0; c < r.ncols; c++)
+		printf (" %s", cols[c]);
+	printf ("\n");
+
+	for (i = 0; i < r.nrows; i++) {
+	    printf ("%14.6f", JD1970 + r.t[i]/86400.0);
+	    if (step > 0) {
+		printf (" %d", r.n[i]);
+		for (c = 0; c < r.ncols; c++)
+		    printf (" %g %g %g", r.v[i*r.ncols+c],
+				r.vmin[i*r.ncols+c], r.vmax[i*r.ncols+c]);
+	    } else
+		for (c = 0; c < r.ncols; c++)
+		    printf (" %g", r.v[i*r.ncols+c]);
+	    printf ("\n");
+	}
+
+	tsFreeResult (&r);
+	return (0);
+}
+
+static void
+usage (char *p)
+{
+	fprintf (stderr, "Usage: %s [options] dir\n", p);
+	fprintf (stderr, "   or: %s -t\n", p);
+	fprintf (stderr, "Purpose: print rows from the time series store in dir.\n");
+	fprintf (stderr, "Options:\n");
+	fprintf (stderr, " -b jd   first time; default start of store\n");
+	fprintf (stderr, " -e jd   last time; default end of store\n");
+	fprintf (stderr, " -c a,b  just these columns; default all\n");
+	fprintf (stderr, " -s secs mean, min and max in bins of secs\n");
+	fprintf (stderr, " -i      print columns, span and size of store\n");
+	fprintf (stderr, " -t      check the library with a scratch store, then exit\n");
+	exit (1);
+}
+
+/* print a summary of the store in dir */
+static int
+info (char *dir)
+{
+	char names[TS_MAXCOLS][TS_NAMELEN];
+	double t0, t1;
+	long nrows, nbytes;
+	char msg[1024];
+	int i, n;
+
+	n = tsColumns (dir, names, msg);
+	if (n < 0 || tsSpan (dir, &t0, &t1, &nrows, &nbytes, msg) < 0) {
+	    fprintf (stderr, "%s\n", msg);
+	    return (1);
+	}
+
+	printf ("Columns:");
+	for (i = 0; i < n; i++)
+	    printf (" %s", names[i]);
+	printf ("\n");
+	if (nrows > 0) {
+	    printf ("First:   %14.6f\n", JD1970 + t0/86400.0);
+	    printf ("Last:    %14.6f\n", JD1970 + t1/86400.0);
+	}
+	printf ("Rows:    %ld\n", nrows);
+	printf ("Bytes:   %ld, %.1f per row, %.1f per value\n", nbytes,
+				nrows ? (double)nbytes/nrows : 0.0,
+				nrows ? (double)nbytes/nrows/n : 0.0);
+	return (0);
+}
+
+/* build a scratch store, read it back every way and compare.
+ * return 0 if all is well, else 1.
+ */
+static int
+selftest (void)
+{
+	static char *tcols[TSTNC] = {"temp", "humidity", "pressure", "wspeed",
+									"aux0"};
+	char dir[] = "/tmp/tsqXXXXXX";
+	long nrows = TSTDAYS*86400L/TSTDT;
+	double t, tw, tq, v[TSTNC];
+	double t0, t1;
+	long nr, nbytes;
+	char msg[1024], fn[64];
+	TSWriter *wp;
+	TSResult r;
+	FILE *fp;
+	long i;
+	int bad = 0;
+	int c;
+
+	if (!mkdtemp (dir)) {
+	    perror (dir);
+	    return (1);
+	}
+
+	/* first half, then garbage as if a block was cut short, then the rest
+	 * after reopening.
+	 */
+	tw = secs();
+	wp = tsOpen (dir, tcols, TSTNC, msg);
+	for (i = 0; wp && i < nrows/2; i++) {
+	    tstRow (i, &t, v);
+	    if (tsAppend (wp, t, v, msg) < 0)
+		break;
+	}
+	tsClose (wp);
+	tstRow (i-1, &t, v);
+	{
+	    time_t lt = (time_t)t;
+	    struct tm *tmp = gmtime (&lt);
+
+	    sprintf (fn, "%s/%04d%02d%02d.tsd", dir, tmp->tm_year+1900,
+						tmp->tm_mon+1, tmp->tm_mday);
+	}
+	if (wp && (fp = fopen (fn, "a")) != NULL) {
+	    fprintf (fp, "garbage");
+	    fclose (fp);
+	}
+	wp = wp ? tsOpen (dir, tcols, TSTNC, msg) : NULL;
+	if (wp && tsAppend (wp, t - 1, v, msg) == 0) {
+	    printf ("Time going backwards was accepted  FAIL\n");
+	    bad = 1;
+	}
+	for (; wp && i < nrows; i++) {
+	    tstRow (i, &t, v);
+	    if (tsAppend (wp, t, v, msg) < 0)
+		break;
+	}
+	tsClose (wp);
+	tw = secs() - tw;
+	if (!wp || i < nrows) {
+	    printf ("Writing: %s  FAIL\n", msg);
+	    rmStore (dir);
+	    return (1);
+	}
+
+	if (tsSpan (dir, &t0, &t1, &nr, &nbytes, msg) < 0 || nr != nrows) {
+	    printf ("Span: %ld rows of %ld  FAIL\n", nr, nrows);
+	    rmStore (dir);
+	    return (1);
+	}
+	printf ("%ld rows of %d: wrote %.3f secs, %.2f bytes per row\n",
+				nrows, TSTNC, tw, (double)nbytes/nrows);
+
+	/* every row back exactly */
+	tq = secs();
+	if (tsQuery (dir, t0, t1, 0, NULL, 0, &r, msg) < 0) {
+	    printf ("Query: %s  FAIL\n", msg);
+	    rmStore (dir);
+	    return (1);
+	}
+	tq = secs() - tq;
+	if (r.nrows != nrows) {
+	    printf ("Read %d rows of %ld  FAIL\n", r.nrows, nrows);
+	    bad = 1;
+	} else {
+	    long nbad = 0;
+
+	    for (i = 0; i < nrows; i++) {
+		tstRow (i, &t, v);
+		if (fabs (r.t[i] - t) > 0.0005)
+		    nbad++;
+		for (c = 0; c < TSTNC; c++)
+		    if (!sameVal (r.v[i*TSTNC+c], v[c]))
+			nbad++;
+	    }
+	    if (nbad) {
+		printf ("%ld values differ  FAIL\n", nbad);
+		bad = 1;
+	    }
+	}
+	tsFreeResult (&r);
+	printf ("all rows: %.3f secs\n", tq);
+
+	/* one column over a few hours */
+	tq = secs();
+	{
+	    double q0 = t0 + 40*86400.0 + 1234.5;
+	    double q1 = q0 + 5*3600;
+	    char *one[1];
+	    int k = 0;
+
+	    one[0] = "pressure";
+	    if (tsQuery (dir, q0, q1, 0, one, 1, &r, msg) < 0) {
+		printf ("Query: %s  FAIL\n", msg);
+		bad = 1;
+	    } else {
+		tq = secs() - tq;
+		for (i = (long)((q0-t0)/TSTDT) - 1; i <= (q1-t0)/TSTDT + 1; i++){
+		    tstRow (i, &t, v);
+		    if (t < q0 - 0.0005 || t > q1 + 0.0005)
+			continue;
+		    if (k >= r.nrows || !sameVal (r.v[k], v[2]))
+			break;
+		    k++;
+		}
+		if (k != r.nrows || r.nrows < 5*360 - 1) {
+		    printf ("Pressure over 5 hours: %d rows  FAIL\n", r.nrows);
+		    bad = 1;
+		}
+		printf ("one column for 5 hours: %.5f secs\n", tq);
+		tsFreeResult (&r);
+	    }
+	}
+
+	/* bins, aligned with the blocks, not, and off the ends */
+	bad |= tstBins (dir, t0, t1, 3600.0);
+	bad |= tstBins (dir, t0, t1, 86400.0);
+	bad |= tstBins (dir, t0 + 123.4, t1 - 777.7, 900.0);
+	bad |= tstBins (dir, t0 - 86400.0, t1 + 86400.0, 7*86400.0);
+
+	rmStore (dir);
+	printf ("%s\n", bad ? "FAIL" : "all answers agree");
+	return (bad);
+}
+
+/* the test sample for row i */
+static void
+tstRow (long i, double *tp, double v[TSTNC])
+{
+	double dayfrac = fmod (i*(double)TSTDT/86400.0, 1.0);
+
+	*tp = TSTT0 + i*TSTDT + ((i*7919) % 50)/1000.0;
+	v[0] = floor (10*(10 + 8*sin(2*M_PI*dayfrac) + 0.5*sin(i*0.37)) + .5)/10;
+	v[1] = (int)(50 + 30*sin(i/5000.0));
+	v[2] = floor (10*(1010 + 5*sin(i/20000.0)) + .5)/10;
+	v[3] = (i/37) % 20;
+	v[4] = (i/1000) % 10 == 3 ? NAN : v[0] + 1.5;
+}
+
+/* check binned answers from t0 to t1 against those found directly.
+ * return 0 if all agree, else 1.
+ */
+static int
+tstBins (char *dir, double t0, double t1, double step)
+{
+	long nrows = TSTDAYS*86400L/TSTDT;
+	double t, v[TSTNC];
+	char msg[1024];
+	TSResult r;
+	double tq;
+	long i, nbad = 0;
+	int k = -1;		/* row in r of current bin */
+	long bin = -1;
+	int cn[TSTNC];
+	double sum[TSTNC], mn[TSTNC], mx[TSTNC];
+	int c, bn = 0;
+
+	tq = secs();
+	if (tsQuery (dir, t0, t1, step, NULL, 0, &r, msg) < 0) {
+	    printf ("Query: %s  FAIL\n", msg);
+	    return (1);
+	}
+	tq = secs() - tq;
+
+	/* walk the rows, checking each bin when the next one starts */
+	for (i = 0; i <= nrows; i++) {
+	    long b = -2;
+
+	    if (i < nrows) {
+		tstRow (i, &t, v);
+		if (t < t0 - 0.0005 || t > t1 + 0.0005)
+		    continue;
+		b = (long)floor ((floor(t*1000+.5) - floor(t0*1000+.5))
+						    / floor(step*1000+.5));
+	    }
+	    if (b != bin && bin >= 0) {
+		k++;
+		if (k >= r.nrows || r.n[k] != bn
+			|| fabs (r.t[k] - (t0 + bin*step)) > 0.001)
+		    nbad++;
+		else
+		    for (c = 0; c < TSTNC; c++) {
+			int j = k*TSTNC + c;
+			if (cn[c] == 0) {
+			    if (!isnan (r.v[j]))
+				nbad++;
+			} else if (fabs (r.v[j] - sum[c]/cn[c]) > 1e-9*fabs(sum[c])
+				    || r.vmin[j] != mn[c] || r.vmax[j] != mx[c])
+			    nbad++;
+		    }
+	    }
+	    if (i == nrows)
+		break;
+	    if (b != bin) {
+		bin = b;
+		bn = 0;
+		for (c = 0; c < TSTNC; c++) {
+		    cn[c] = 0;
+		    sum[c] = 0;
+		}
+	    }
+	    bn++;
+	    for (c = 0; c < TSTNC; c++) {
+		if (isnan (v[c]))
+		    continue;
+		if (cn[c] == 0 || v[c] < mn[c])
+		    mn[c] = v[c];
+		if (cn[c] == 0 || v[c] > mx[c])
+		    mx[c] = v[c];
+		sum[c] += v[c];
+		cn[c]++;
+	    }
+	}
+	if (k+1 != r.nrows)
+	    nbad++;
+
+	printf ("%g sec bins: %d bins, %.5f secs%s\n", step, r.nrows, tq,
+						nbad ? "  FAIL" : "");
+	tsFreeResult (&r);
+	return (nbad > 0);
+}
+
+/* 1 if a and b are the same value or both NaN, else 0 */
+static int
+sameVal (double a, double b)
+{
+	return (isnan(a) ? isnan(b) : a == b);
+}
+
+/* remove the scratch store in dir */
+static void
+rmStore (char *dir)
+{
+	struct dirent *dep;
+	char fn[1100];
+	DIR *dp;
+
+	dp = opendir (dir);
+	if (dp) {
+	    while ((dep = readdir (dp)) != NULL) {
+		if (dep->d_name[0] == '.')
+		    continue;
+		sprintf (fn, "%s/%s", dir, dep->d_name);
+		(void) unlink (fn);
+	    }
+	    (void) closedir (dp);
+	}
+	(void) rmdir (dir);
+}
+
+static double
+secs (void)
+{
+	struct timeval tv;
+
+	gettimeofday (&tv, NULL);
+	return (tv.tv_sec + tv.tv_usec*1e-6);
+}
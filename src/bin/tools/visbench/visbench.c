@@ -0,0 +1,313 @@
+/* time finding when a list of targets is up tonight by riset_cir() for each,
+ * as telsched used to, against a cold then a warm visibility cache, see
+ * viscache.c. also check the cached rise/set agree with riset_cir(), the
+ * night windows agree with stepping obj_cir() through the night, and that
+ * the warm cache read back from its file gives just what the cold one did.
+ * exit 0 if all is well, else 1.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "P_.h"
+#include "astro.h"
+#include "circum.h"
+#include "horizon.h"
+#include "viscache.h"
+
+#define	DEFN	5000		/* default n fixed targets */
+#define	DEFMJD	(36525.0 + 9000.5)	/* default date, 2024 Aug 21 */
+#define	DEFLAT	31.7		/* default latitude, degrees */
+#define	DEFLNG	(-110.9)	/* default longitude, degrees */
+#define	MINALT	degrad(20.0)	/* lowest altitude, as telsched.cfg */
+#define	SUNDOWN	degrad(18.0)	/* sun depression at dusk and dawn */
+#define	MAXDT	30.0		/* allowed rise/set difference, secs */
+#define	STEP	60.0		/* window grid step, as viscache.c, secs */
+#define	NCHECK	200		/* targets whose windows are checked */
+
+static void usage (char *p);
+static int same (VisWin *a, VisWin *b);
+static void brute (Now *np, Obj *op, double dusk, double dawn, double *upp,
+    double *downp);
+static double secs (void);
+
+int
+main (int ac, char *av[])
+{
+	char *progname = av[0];
+	Now now, *np = &now;
+	Obj *objs, **ops;
+	RiseSet *rs1;
+	VisWin *cold, *warm;
+	VisCache *vcp;
+	char *dir = "/tmp";
+	char *hznfn = NULL;
+	char msg[1024];
+	char fn[1024];
+	double day = DEFMJD;
+	double dusk, dawn, tmp;
+	double t1, tc, tw;
+	double maxdt = 0, maxwdt = 0;
+	int nthr = 0;
+	int n = DEFN;
+	int nflags = 0, nbad = 0, nwbad = 0, nhit, nmiss;
+	int nobj, status, i;
+
+	while ((--ac > 0) && ((*++av)[0] == '-')) {
+	    char *s;
+	    for (s = av[0]+1; *s != '\0'; s++)
+		switch (*s) {
+		case 'D':
+		    if (ac < 2)
+			usage(progname);
+		    day = atof (*++av);
+		    ac--;
+		    break;
+		case 'd':
+		    if (ac < 2)
+			usage(progname);
+		    dir = *++av;
+		    ac--;
+		    break;
+		case 'm':
+		    if (ac < 2)
+			usage(progname);
+		    hznfn = *++av;
+		    ac--;
+		    break;
+		case 'n':
+		    if (ac < 2)
+			usage(progname);
+		    n = atoi (*++av);
+		    ac--;
+		    break;
+		case 't':
+		    if (ac < 2)
+			usage(progname);
+		    nthr = atoi (*++av);
+		    ac--;
+		    break;
+		default:
+		    usage(progname);
+		}
+	}
+	if (ac > 0 || n < 0)
+	    usage (progname);
+	if (hznfn && hznLoad (hznfn, msg) < 0) {
+	    fprintf (stderr, "%s\n", msg);
+	    return (1);
+	}
+
+	memset ((void *)np, 0, sizeof(now));
+	mjd = day;
+	lat = degrad(DEFLAT);
+	lng = degrad(DEFLNG);
+	tz = 7;
+	temp = 10.0;
+	pressure = 1010.0;
+	elev = 2000.0/ERAD;
+	dip = SUNDOWN;
+	epoch = J2000;
+
+	/* tonight, as telsched finds it */
+	twilight_cir (np, SUNDOWN, &dawn, &dusk, &status);
+	if (dawn < dusk) {
+	    Now tomorrow = now;
+
+	    tomorrow.n_mjd += 1;
+	    twilight_cir (&tomorrow, SUNDOWN, &dawn, &tmp, &status);
+	}
+
+	/* the sun, moon and planets then n random fixed targets */
+	nobj = MOON+1 + n;
+	objs = (Obj *) calloc (nobj, sizeof(Obj));
+	ops = (Obj **) malloc (nobj * sizeof(Obj *));
+	rs1 = (RiseSet *) calloc (nobj, sizeof(RiseSet));
+	cold = (VisWin *) calloc (nobj, sizeof(VisWin));
+	warm = (VisWin *) calloc (nobj, sizeof(VisWin));
+	if (!objs || !ops || !rs1 || !cold || !warm) {
+	    fprintf (stderr, "No memory for %d objects\n", nobj);
+	    return (1);
+	}
+	for (i = 0; i <= MOON; i++) {
+	    objs[i].o_type = PLANET;
+	    objs[i].pl.pl_code = i;
+	}
+	srand (1);
+	for (i = MOON+1; i < nobj; i++) {
+	    Obj *op = &objs[i];
+
+	    op->o_type = FIXED;
+	    sprintf (op->o_name, "T%d", i);
+	    op->f_RA = (float)(2*PI*rand()/(RAND_MAX+1.0));
+	    op->f_dec = (float)asin(2.0*rand()/(RAND_MAX+1.0) - 1.0);
+	    op->f_epoch = (float)J2000;
+	}
+	for (i = 0; i < nobj; i++)
+	    ops[i] = &objs[i];
+
+	/* the old way */
+	t1 = secs();
+	for (i = 0; i < nobj; i++)
+	    riset_cir (np, ops[i], -MINALT, &rs1[i]);
+	t1 = secs() - t1;
+
+	/* cold, from nothing */
+	sprintf (fn, "%s/visbench%d.cache", dir, (int)getpid());
+	tc = secs();
+	vcp = vc_open (fn, np, dusk, dawn, MINALT, hznfn ? hznAlt : NULL, hznfn);
+	if (!vcp) {
+	    fprintf (stderr, "No memory for cache\n");
+	    return (1);
+	}
+	vc_get (vcp, np, ops, nobj, cold, nthr);
+	tc = secs() - tc;
+	if (vc_save (vcp) < 0) {
+	    perror (fn);
+	    return (1);
+	}
+	vc_close (vcp);
+
+	/* warm, as the next sort or the next run */
+	tw = secs();
+	vcp = vc_open (fn, np, dusk, dawn, MINALT, hznfn ? hznAlt : NULL, hznfn);
+	if (!vcp) {
+	    fprintf (stderr, "No memory for cache\n");
+	    return (1);
+	}
+	vc_get (vcp, np, ops, nobj, warm, nthr);
+	tw = secs() - tw;
+	vc_stats (vcp, &nhit, &nmiss);
+	vc_close (vcp);
+	(void) unlink (fn);
+
+	printf ("%d objects: riset_cir %.3f secs, cold cache %.3f secs, warm cache %.4f secs\n",
+							    nobj, t1, tc, tw);
+
+	/* rise and set as riset_cir() */
+	for (i = 0; i < nobj; i++) {
+	    RiseSet *a = &rs1[i], *b = &cold[i].rs;
+	    double d = 0;
+
+	    if (a->rs_flags != b->rs_flags) {
+		nflags++;
+		continue;
+	    }
+	    if (!(a->rs_flags & (RS_NORISE|RS_CIRCUMPOLAR|RS_NEVERUP|RS_ERROR)))
+		d = fabs(a->rs_risetm - b->rs_risetm);
+	    if (!(a->rs_flags & (RS_NOSET|RS_CIRCUMPOLAR|RS_NEVERUP|RS_ERROR)))
+		d = fmax (d, fabs(a->rs_settm - b->rs_settm));
+	    if (!(a->rs_flags & (RS_NOTRANS|RS_NEVERUP|RS_ERROR)))
+		d = fmax (d, fabs(a->rs_trantm - b->rs_trantm));
+	    d *= SPD;
+	    if (d > maxdt)
+		maxdt = d;
+	    if (d > MAXDT)
+		nbad++;
+	}
+	printf ("rise/set: largest difference %.2f secs; %d flags differ, %d over %g secs\n",
+						maxdt, nflags, nbad, MAXDT);
+
+	/* windows as stepping through the night, the planets and a sample */
+	for (i = 0; i < nobj; i += i <= MOON ? 1 : nobj/NCHECK + 1) {
+	    double up, down, d;
+
+	    brute (np, ops[i], dusk, dawn, &up, &down);
+	    if ((up == 0) != (cold[i].up == 0)) {
+		nwbad++;
+		printf ("%s: windows differ %g..%g %g..%g\n", objs[i].o_name,
+					    up, down, cold[i].up, cold[i].down);
+		continue;
+	    }
+	    d = fmax (fabs(up - cold[i].up), fabs(down - cold[i].down))*SPD;
+	    if (d > maxwdt)
+		maxwdt = d;
+	    if (d > STEP)
+		nwbad++;
+	}
+	printf ("windows: largest difference %.0f secs; %d over %g secs\n",
+							maxwdt, nwbad, STEP);
+
+	/* warm must be all hits and just the same */
+	printf ("warm: %d found, %d worked out, %.0fx faster than riset_cir\n",
+				nhit, nmiss, tw > 0 ? t1/tw : 0.0);
+	for (i = 0; i < nobj; i++)
+	    if (!same (&cold[i], &warm[i]))
+		break;
+	if (nhit != nobj || i < nobj) {
+	    printf ("warm cache differs from cold\n");
+	    return (1);
+	}
+
+	/* allow for objects grazing the horizon right at the day's edges */
+	return (nflags + nbad > nobj/1000 || nwbad > 0);
+}
+
+static void
+usage (char *p)
+{
+	fprintf (stderr, "Usage: %s [options]\n", p);
+	fprintf (stderr, "Purpose: time and check the visibility cache.\n");
+	fprintf (stderr, "Options:\n");
+	fprintf (stderr, " -D mjd  day; default %g\n", DEFMJD);
+	fprintf (stderr, " -d dir  where to make the cache file; default /tmp\n");
+	fprintf (stderr, " -m file horizon profile, as RAO.hzn; default flat\n");
+	fprintf (stderr, " -n n    number of fixed targets; default %d\n", DEFN);
+	fprintf (stderr, " -t n    threads; default one per processor\n");
+	exit (1);
+}
+
+/* return 1 if a and b are just the same, else 0 */
+static int
+same (VisWin *a, VisWin *b)
+{
+	return (a->up == b->up && a->down == b->down
+		&& a->rs.rs_flags == b->rs.rs_flags
+		&& a->rs.rs_risetm == b->rs.rs_risetm
+		&& a->rs.rs_riseaz == b->rs.rs_riseaz
+		&& a->rs.rs_trantm == b->rs.rs_trantm
+		&& a->rs.rs_tranalt == b->rs.rs_tranalt
+		&& a->rs.rs_settm == b->rs.rs_settm
+		&& a->rs.rs_setaz == b->rs.rs_setaz);
+}
+
+/* find the first and last times on the cache's grid op is up, the long way */
+static void
+brute (Now *np, Obj *op, double dusk, double dawn, double *upp,
+double *downp)
+{
+	int nstep = (int)ceil((dawn - dusk)*SPD/STEP);
+	Now n = *np;
+	Obj o = *op;
+	int i;
+
+	*upp = *downp = 0;
+	n.n_epoch = EOD;
+	for (i = 0; i <= nstep; i++) {
+	    double t = dusk + i*STEP/SPD;
+
+	    if (t > dawn)
+		t = dawn;
+	    n.n_mjd = t;
+	    if (obj_cir (&n, &o) < 0)
+		continue;
+	    if (o.s_alt < MINALT || o.s_alt < hznAlt (o.s_az))
+		continue;
+	    if (*upp == 0)
+		*upp = t;
+	    *downp = t;
+	}
+}
+
+static double
+secs (void)
+{
+	struct timeval tv;
+
+	gettimeofday (&tv, NULL);
+	return (tv.tv_sec + tv.tv_usec*1e-6);
+}
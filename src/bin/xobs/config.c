@@ -9,6 +9,7 @@
 #include "circum.h"
 #include "telstatshm.h"
 #include "configfile.h"
+#include "horizon.h"
 
 #include "xobs.h"
 
@@ -72,6 +73,7 @@ initCfg()
 	    {"BeepPeriod",	CFG_INT, &BeepPeriod},
 	    {"BANNER",		CFG_STR, BANNER, sizeof(BANNER)},
 	};
+	char hznfn[1024];
 	char buf[1024];
 	int n;
 
@@ -89,6 +91,12 @@ initCfg()
 	    die();
 	}
 
+	/* horizon profile, if any, from telsched.cfg */
+	if (hznCfg (tscfn, hznfn, buf) < 0) {
+	    fprintf (stderr, "%s\n", buf);
+	    die();
+	}
+
 	/* from dome.cfg */
 	n = read1CfgEntry (1, dfn, "DOMETOL", CFG_DBL, &DOMETOL, 0);
 	if (n < 0) {
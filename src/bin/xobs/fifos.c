@@ -139,6 +139,7 @@ void resetSW() {
   /* keep up with filter assignments */
   fillFilterMenu();
   afoc_initCfg();
+  skyMapReset();
 }
 
 /* shut down all activity */
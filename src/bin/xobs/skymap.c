@@ -8,6 +8,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/time.h>
 #include <time.h>
 #include <unistd.h>
 
@@ -34,10 +35,12 @@
 
 #include "P_.h"
 #include "astro.h"
+#include "catalogs.h"
 #include "circum.h"
 #include "cliserv.h"
 #include "configfile.h"
 #include "db.h"
+#include "horizon.h"
 #include "misc.h"
 #include "strops.h"
 #include "telenv.h"
@@ -46,7 +49,28 @@
 
 #include "xobs.h"
 
+/* the sky map is built in two pixmaps. bg_pm holds the layers that hardly
+ * change: the sky, grid, horizon, altitude limit, catalog stars, sun and
+ * moon. it is drawn only when the window size or config changes, or every
+ * SKYBG_DT as the sky turns. sky_pm is bg_pm with the overlays that follow
+ * the scope and dome drawn on top. each frame, just the rectangles the
+ * overlays leave or enter are restored from bg_pm, redrawn and copied to the
+ * window, and nothing at all is done if none moved.
+ */
+
 static void skyExpCB(Widget w, XtPointer client, XtPointer call);
+static void skyResizeCB(Widget w, XtPointer client, XtPointer call);
+static void mkSkyGC(Display *dsp, Window win);
+static int mkSkyPixmaps(Display *dsp, Window win);
+static void drawStatic(Display *dsp);
+static void drawStars(Display *dsp);
+static void drawHorizon(Display *dsp);
+static void placeOverlays(void);
+static void drawOverlays(Display *dsp, Drawable d);
+static int damage(XRectangle r[]);
+static void loadStars(void);
+static void frameStats(double dt, int npix);
+static double secs(void);
 static void aa2xy(double alt, double az, int *xp, int *yp);
 
 #define SKYSZ 100    /* size of sky map, pixels */
@@ -55,8 +79,36 @@ static void aa2xy(double alt, double az, int *xp, int *yp);
 #define SUNSZ 8      /* size of sun */
 #define MOONSZ SUNSZ /* size of moon */
 
+#define SKYBG_DT (120. / SPD) /* days between static redraws, < 1 pixel */
+#define SKYMAG 4.0            /* faintest catalog star drawn */
+#define HZNSTEP 2             /* horizon drawn in steps of this, degrees */
+#define SLITALT degrad(30.0)  /* dome slit marker reaches this alt */
+#define FSTATS_N 100          /* frames between frame time reports */
+
+/* the overlays, in the order they are drawn */
+typedef enum { OV_SLIT, OV_TARG, OV_TEL, OV_N } Overlay;
+
+typedef struct {
+  int on;       /* set when shown */
+  int x, y;     /* where, pixels; x1, y1 is the other end of the slit */
+  int x1, y1;
+  XRectangle r; /* area covered, if on */
+} OvState;
+
 static Widget skyda_w; /* sky symbol DA */
 static Pixmap sky_pm;  /* pixmap to make it update cleanly */
+static Pixmap bg_pm;   /* the static layers */
+static int skysz;      /* size of sky map, pixels */
+static int pmw, pmh;   /* size of both pixmaps */
+static int bgok;       /* set when bg_pm is good */
+static double bgmjd;   /* when bg_pm was drawn */
+
+static OvState ovnow[OV_N];  /* overlays as they should be */
+static OvState ovshow[OV_N]; /* overlays as in sky_pm */
+
+static Obj *stars;    /* catalog stars, if any */
+static int nstars;    /* n in stars[] */
+static int starsread; /* set once we have tried to read stars[] */
 
 static GC skyGC;        /* GC for skyda_w */
 static Pixel skybg_p;   /* color for overall background */
@@ -66,6 +118,10 @@ static Pixel skytarg_p; /* color for target */
 static Pixel skygrid_p; /* color for coord grid */
 static Pixel skysun_p;  /* color for sun */
 static Pixel skymoon_p; /* color for moon */
+static Pixel skyhzn_p;  /* color for ground above the horizon */
+static Pixel skylim_p;  /* color for the altitude limit */
+static Pixel skystar_p; /* color for catalog stars */
+static Pixel skyslit_p; /* color for the dome slit */
 
 Widget mkSky(Widget main_w) {
   Widget fr_w;
@@ -76,56 +132,181 @@ Widget mkSky(Widget main_w) {
                                     XmNresizePolicy, XmRESIZE_NONE, XmNwidth,
                                     SKYSZ, XmNheight, SKYSZ, NULL);
   XtAddCallback(skyda_w, XmNexposeCallback, skyExpCB, NULL);
+  XtAddCallback(skyda_w, XmNresizeCallback, skyResizeCB, NULL);
 
   return (fr_w);
 }
 
-/* draw the sky map.
+/* bring the sky map up to date.
  * N.B. do nothing gracefully if called before window is known
  */
 void showSkyMap() {
   Display *dsp = XtDisplay(skyda_w);
   Window win = XtWindow(skyda_w);
-  int x, y;
+  double now = telstatshmp->now.n_mjd;
+  XRectangle r[2 * OV_N];
+  double t0 = secs();
+  int npix = 0;
+  int nr, i;
+
+  if (!win)
+    return;
+  if (!sky_pm && mkSkyPixmaps(dsp, win) < 0)
+    return;
 
-  if (!win || !sky_pm)
+  /* the static layers, when due */
+  if (!bgok || fabs(now - bgmjd) > SKYBG_DT) {
+    drawStatic(dsp);
+    bgmjd = now;
+    bgok = 1;
+    for (i = 0; i < OV_N; i++)
+      ovshow[i].on = 0;
+    placeOverlays();
+    XCopyArea(dsp, bg_pm, sky_pm, skyGC, 0, 0, pmw, pmh, 0, 0);
+    drawOverlays(dsp, sky_pm);
+    XCopyArea(dsp, sky_pm, win, skyGC, 0, 0, pmw, pmh, 0, 0);
+    memcpy(ovshow, ovnow, sizeof(ovshow));
+    frameStats(secs() - t0, pmw * pmh);
     return;
+  }
+
+  /* just where the overlays have moved, if anywhere */
+  placeOverlays();
+  nr = damage(r);
+  if (nr > 0) {
+    for (i = 0; i < nr; i++) {
+      XCopyArea(dsp, bg_pm, sky_pm, skyGC, r[i].x, r[i].y, r[i].width,
+                r[i].height, r[i].x, r[i].y);
+      npix += r[i].width * r[i].height;
+    }
+    XSetClipRectangles(dsp, skyGC, 0, 0, r, nr, Unsorted);
+    drawOverlays(dsp, sky_pm);
+    XSetClipMask(dsp, skyGC, None);
+    for (i = 0; i < nr; i++)
+      XCopyArea(dsp, sky_pm, win, skyGC, r[i].x, r[i].y, r[i].width,
+                r[i].height, r[i].x, r[i].y);
+    memcpy(ovshow, ovnow, sizeof(ovshow));
+  }
+  frameStats(secs() - t0, npix);
+}
 
-  if (!skyGC) {
-    skyGC = XCreateGC(dsp, win, 0L, NULL);
-    XSetFont(dsp, skyGC, XLoadFont(dsp, "8x13bold"));
-    sky_p = getColor(toplevel_w, "#334");
-    skygrid_p = getColor(toplevel_w, "#777");
-    skytel_p = getColor(toplevel_w, "#ccf");
-    skytarg_p = getColor(toplevel_w, "green");
-    skysun_p = getColor(toplevel_w, "yellow");
-    skymoon_p = getColor(toplevel_w, "#ccc");
-    XtVaGetValues(skyda_w, XmNbackground, &skybg_p, NULL);
+/* call when the config may have changed to redraw the static layers */
+void skyMapReset() {
+  if (stars) {
+    free((void *)stars);
+    stars = NULL;
   }
+  nstars = 0;
+  starsread = 0;
+  bgok = 0;
+}
+
+/* callback for the sky drawing area expose */
+static void skyExpCB(Widget w, XtPointer client, XtPointer call) {
+  XmDrawingAreaCallbackStruct *s = (XmDrawingAreaCallbackStruct *)call;
+  XExposeEvent *evp = &s->event->xexpose;
+
+  if (!sky_pm || !bgok) {
+    showSkyMap();
+    return;
+  }
+
+  XCopyArea(evp->display, sky_pm, evp->window, skyGC, evp->x, evp->y,
+            evp->width, evp->height, evp->x, evp->y);
+}
+
+/* callback for the sky drawing area resize: start over at the new size */
+static void skyResizeCB(Widget w, XtPointer client, XtPointer call) {
+  Display *dsp = XtDisplay(w);
+
+  if (sky_pm) {
+    XFreePixmap(dsp, sky_pm);
+    XFreePixmap(dsp, bg_pm);
+    sky_pm = bg_pm = 0;
+  }
+  bgok = 0;
+}
+
+static void mkSkyGC(Display *dsp, Window win) {
+  skyGC = XCreateGC(dsp, win, 0L, NULL);
+  XSetFont(dsp, skyGC, XLoadFont(dsp, "8x13bold"));
+  sky_p = getColor(toplevel_w, "#334");
+  skygrid_p = getColor(toplevel_w, "#777");
+  skytel_p = getColor(toplevel_w, "#ccf");
+  skytarg_p = getColor(toplevel_w, "green");
+  skysun_p = getColor(toplevel_w, "yellow");
+  skymoon_p = getColor(toplevel_w, "#ccc");
+  skyhzn_p = getColor(toplevel_w, "#443");
+  skylim_p = getColor(toplevel_w, "#844");
+  skystar_p = getColor(toplevel_w, "#aaa");
+  skyslit_p = getColor(toplevel_w, "orange");
+  XtVaGetValues(skyda_w, XmNbackground, &skybg_p, NULL);
+}
+
+/* make sky_pm and bg_pm the size of win, and the GC if first time.
+ * return 0 if ok, else -1.
+ */
+static int mkSkyPixmaps(Display *dsp, Window win) {
+  Window root;
+  unsigned int bw, d;
+  unsigned int wid, hei;
+  int x, y;
+
+  if (!skyGC)
+    mkSkyGC(dsp, win);
+
+  if (!XGetGeometry(dsp, win, &root, &x, &y, &wid, &hei, &bw, &d) ||
+      wid == 0 || hei == 0)
+    return (-1);
+  sky_pm = XCreatePixmap(dsp, win, wid, hei, d);
+  bg_pm = XCreatePixmap(dsp, win, wid, hei, d);
+  pmw = wid;
+  pmh = hei;
+  skysz = wid < hei ? wid : hei;
+  bgok = 0;
+  return (0);
+}
+
+/* draw the static layers in bg_pm */
+static void drawStatic(Display *dsp) {
+  int x, y;
 
   /* background */
   XSetForeground(dsp, skyGC, skybg_p);
-  XFillRectangle(dsp, sky_pm, skyGC, 0, 0, SKYSZ, SKYSZ);
+  XFillRectangle(dsp, bg_pm, skyGC, 0, 0, pmw, pmh);
   XSetForeground(dsp, skyGC, sky_p);
-  XFillArc(dsp, sky_pm, skyGC, 0, 0, SKYSZ, SKYSZ, 0, 360 * 64);
-  XDrawString(dsp, sky_pm, skyGC, 0, 10, "NW", 2);
+  XFillArc(dsp, bg_pm, skyGC, 0, 0, skysz, skysz, 0, 360 * 64);
+  XDrawString(dsp, bg_pm, skyGC, 0, 10, "NW", 2);
+
+  /* catalog stars, then the horizon hides any below it */
+  drawStars(dsp);
+  drawHorizon(dsp);
 
   /* 30-degree grid */
   XSetForeground(dsp, skyGC, skygrid_p);
-  XDrawArc(dsp, sky_pm, skyGC, SKYSZ / 6, SKYSZ / 6, 2 * SKYSZ / 3,
-           2 * SKYSZ / 3, 0, 360 * 64);
-  XDrawArc(dsp, sky_pm, skyGC, SKYSZ / 3, SKYSZ / 3, SKYSZ / 3, SKYSZ / 3, 0,
+  XDrawArc(dsp, bg_pm, skyGC, skysz / 6, skysz / 6, 2 * skysz / 3,
+           2 * skysz / 3, 0, 360 * 64);
+  XDrawArc(dsp, bg_pm, skyGC, skysz / 3, skysz / 3, skysz / 3, skysz / 3, 0,
            360 * 64);
-  XDrawPoint(dsp, sky_pm, skyGC, SKYSZ / 2, SKYSZ / 2);
+  XDrawPoint(dsp, bg_pm, skyGC, skysz / 2, skysz / 2);
+
+  /* lowest altitude the scheduler will use */
+  if (MINALT > 0) {
+    int r = (int)(skysz / 2.0 * (1 - MINALT / (PI / 2)));
+
+    XSetForeground(dsp, skyGC, skylim_p);
+    XDrawArc(dsp, bg_pm, skyGC, skysz / 2 - r, skysz / 2 - r, 2 * r, 2 * r, 0,
+             360 * 64);
+  }
 
   /* crescent moon */
   if (moonobj.s_alt >= 0) {
     aa2xy(moonobj.s_alt, moonobj.s_az, &x, &y);
     XSetForeground(dsp, skyGC, skymoon_p);
-    XFillArc(dsp, sky_pm, skyGC, x - MOONSZ / 2, y - MOONSZ / 2, MOONSZ, MOONSZ,
+    XFillArc(dsp, bg_pm, skyGC, x - MOONSZ / 2, y - MOONSZ / 2, MOONSZ, MOONSZ,
              0, 360 * 64);
     XSetForeground(dsp, skyGC, sky_p);
-    XFillArc(dsp, sky_pm, skyGC, x - MOONSZ, y - MOONSZ / 2, MOONSZ, MOONSZ, 0,
+    XFillArc(dsp, bg_pm, skyGC, x - MOONSZ, y - MOONSZ / 2, MOONSZ, MOONSZ, 0,
              360 * 64);
   }
 
@@ -133,55 +314,240 @@ void showSkyMap() {
   if (sunobj.s_alt >= 0) {
     aa2xy(sunobj.s_alt, sunobj.s_az, &x, &y);
     XSetForeground(dsp, skyGC, skysun_p);
-    XFillArc(dsp, sky_pm, skyGC, x - SUNSZ / 2, y - SUNSZ / 2, SUNSZ, SUNSZ, 0,
+    XFillArc(dsp, bg_pm, skyGC, x - SUNSZ / 2, y - SUNSZ / 2, SUNSZ, SUNSZ, 0,
              360 * 64);
   }
+}
+
+/* draw the catalog stars above the horizon now in bg_pm */
+static void drawStars(Display *dsp) {
+  Now *np = &telstatshmp->now;
+  int i;
+
+  if (!starsread)
+    loadStars();
+  if (nstars == 0)
+    return;
+
+  XSetForeground(dsp, skyGC, skystar_p);
+  for (i = 0; i < nstars; i++) {
+    Obj *op = &stars[i];
+    int x, y;
+
+    if (obj_cir(np, op) < 0 || op->s_alt < 0)
+      continue;
+    aa2xy(op->s_alt, op->s_az, &x, &y);
+    if (get_mag(op) < 2.0)
+      XFillRectangle(dsp, bg_pm, skyGC, x, y, 2, 2);
+    else
+      XDrawPoint(dsp, bg_pm, skyGC, x, y);
+  }
+}
+
+/* shade the ground above the horizon profile in bg_pm, if one is loaded */
+static void drawHorizon(Display *dsp) {
+  int az;
+
+  if (!hznHave())
+    return;
+
+  XSetForeground(dsp, skyGC, skyhzn_p);
+  for (az = 0; az < 360; az += HZNSTEP) {
+    double az0 = degrad(az), az1 = degrad(az + HZNSTEP);
+    double alt0 = hznAlt(az0), alt1 = hznAlt(az1);
+    XPoint p[4];
+    int x, y;
+
+    if (alt0 <= 0 && alt1 <= 0)
+      continue;
+    aa2xy(0.0, az0, &x, &y);
+    p[0].x = x;
+    p[0].y = y;
+    aa2xy(0.0, az1, &x, &y);
+    p[1].x = x;
+    p[1].y = y;
+    aa2xy(alt1 > 0 ? alt1 : 0.0, az1, &x, &y);
+    p[2].x = x;
+    p[2].y = y;
+    aa2xy(alt0 > 0 ? alt0 : 0.0, az0, &x, &y);
+    p[3].x = x;
+    p[3].y = y;
+    XFillPolygon(dsp, bg_pm, skyGC, p, 4, Convex, CoordModeOrigin);
+  }
+}
+
+/* find where each overlay should be now, in ovnow[] */
+static void placeOverlays() {
+  OvState *op;
+  int x, y;
+
+  memset((void *)ovnow, 0, sizeof(ovnow));
+
+  /* dome slit, from the horizon up toward the zenith */
+  op = &ovnow[OV_SLIT];
+  if (telstatshmp->domestate != DS_ABSENT) {
+    aa2xy(0.0, telstatshmp->domeaz, &op->x, &op->y);
+    aa2xy(SLITALT, telstatshmp->domeaz, &op->x1, &op->y1);
+    op->r.x = (op->x < op->x1 ? op->x : op->x1) - 2;
+    op->r.y = (op->y < op->y1 ? op->y : op->y1) - 2;
+    op->r.width = abs(op->x - op->x1) + 5;
+    op->r.height = abs(op->y - op->y1) + 5;
+    op->on = 1;
+  }
 
   /* target */
+  op = &ovnow[OV_TARG];
   switch (telstatshmp->telstate) {
   case TS_SLEWING: /* FALLTHRU */
   case TS_HUNTING: /* FALLTHRU */
   case TS_TRACKING:
     aa2xy(telstatshmp->Dalt, telstatshmp->Daz, &x, &y);
-    XSetForeground(dsp, skyGC, skytarg_p);
-    XDrawLine(dsp, sky_pm, skyGC, x - TGSZ / 2, y - TGSZ / 2, x + TGSZ / 2,
-              y + TGSZ / 2);
-    XDrawLine(dsp, sky_pm, skyGC, x + TGSZ / 2, y - TGSZ / 2, x - TGSZ / 2,
-              y + TGSZ / 2);
+    op->x = x;
+    op->y = y;
+    op->r.x = x - TGSZ / 2;
+    op->r.y = y - TGSZ / 2;
+    op->r.width = op->r.height = TGSZ + 1;
+    op->on = 1;
     break;
   default:
     break;
   }
 
   /* telescope */
+  op = &ovnow[OV_TEL];
   aa2xy(telstatshmp->Calt, telstatshmp->Caz, &x, &y);
-  XSetForeground(dsp, skyGC, skytel_p);
-  XDrawArc(dsp, sky_pm, skyGC, x - TLSZ / 2, y - TLSZ / 2, TLSZ, TLSZ, 0,
-           360 * 64);
+  op->x = x;
+  op->y = y;
+  op->r.x = x - TLSZ / 2;
+  op->r.y = y - TLSZ / 2;
+  op->r.width = op->r.height = TLSZ + 1;
+  op->on = 1;
+}
+
+/* draw the overlays in ovnow[] in d */
+static void drawOverlays(Display *dsp, Drawable d) {
+  OvState *op;
+
+  op = &ovnow[OV_SLIT];
+  if (op->on) {
+    XSetForeground(dsp, skyGC, skyslit_p);
+    XSetLineAttributes(dsp, skyGC, 3, LineSolid, CapButt, JoinMiter);
+    XDrawLine(dsp, d, skyGC, op->x, op->y, op->x1, op->y1);
+    XSetLineAttributes(dsp, skyGC, 0, LineSolid, CapButt, JoinMiter);
+  }
+
+  op = &ovnow[OV_TARG];
+  if (op->on) {
+    XSetForeground(dsp, skyGC, skytarg_p);
+    XDrawLine(dsp, d, skyGC, op->x - TGSZ / 2, op->y - TGSZ / 2,
+              op->x + TGSZ / 2, op->y + TGSZ / 2);
+    XDrawLine(dsp, d, skyGC, op->x + TGSZ / 2, op->y - TGSZ / 2,
+              op->x - TGSZ / 2, op->y + TGSZ / 2);
+  }
+
+  op = &ovnow[OV_TEL];
+  if (op->on) {
+    XSetForeground(dsp, skyGC, skytel_p);
+    XDrawArc(dsp, d, skyGC, op->x - TLSZ / 2, op->y - TLSZ / 2, TLSZ, TLSZ, 0,
+             360 * 64);
+  }
+}
+
+/* fill r[] with the areas of each overlay that has moved, came or went,
+ * both where it was and where it is now. return how many.
+ */
+static int damage(XRectangle r[]) {
+  int nr = 0;
+  int i;
+
+  for (i = 0; i < OV_N; i++) {
+    OvState *was = &ovshow[i], *now = &ovnow[i];
+
+    if (!was->on && !now->on)
+      continue;
+    if (was->on && now->on && was->x == now->x && was->y == now->y &&
+        was->x1 == now->x1 && was->y1 == now->y1)
+      continue;
+    if (was->on)
+      r[nr++] = was->r;
+    if (now->on)
+      r[nr++] = now->r;
+  }
 
-  /* copy pixmap to screen */
-  XCopyArea(dsp, sky_pm, win, skyGC, 0, 0, SKYSZ, SKYSZ, 0, 0);
+  return (nr);
 }
 
-/* callback for the sky drawing area expose */
-static void skyExpCB(Widget w, XtPointer client, XtPointer call) {
-  if (!sky_pm) {
-    Display *dsp = XtDisplay(w);
-    Window win = XtWindow(w);
-    Window root;
-    unsigned int bw, d;
-    unsigned int wid, hei;
-    int x, y;
+/* read the stars brighter than SKYMAG from the catalog named by the
+ * SkyCatalog resource, if any. just skip them if trouble.
+ */
+static void loadStars() {
+  char *res = getXRes(toplevel_w, "SkyCatalog", NULL);
+  char fn[1024], buf[1024];
+  Obj *all;
+  int n, i;
+
+  starsread = 1;
+  if (!res || !res[0])
+    return;
 
-    XGetGeometry(dsp, win, &root, &x, &y, &wid, &hei, &bw, &d);
-    sky_pm = XCreatePixmap(dsp, win, wid, hei, d);
+  (void)sprintf(fn, "%.*s", (int)sizeof(fn) - 1, res);
+  n = readCatalog(fn, &all, buf);
+  if (n < 0) {
+    msg("SkyCatalog: %s", buf);
+    return;
+  }
+
+  for (i = 0; i < n; i++)
+    if (all[i].o_type == FIXED && get_mag(&all[i]) <= SKYMAG)
+      all[nstars++] = all[i];
+  if (nstars > 0)
+    stars = all;
+  else
+    free((void *)all);
+}
+
+/* count frames and the time they take, and report every FSTATS_N frames
+ * if the frameStats resource is set, such as by -fstats.
+ */
+static void frameStats(double dt, int npix) {
+  static int on = -1;
+  static int nframes, ndrawn;
+  static double sumdt, maxdt;
+  static double sumpix;
+
+  if (on < 0)
+    on = getXRes(toplevel_w, "frameStats", NULL) != NULL;
+  if (!on)
+    return;
+
+  nframes++;
+  if (npix > 0)
+    ndrawn++;
+  sumdt += dt;
+  if (dt > maxdt)
+    maxdt = dt;
+  sumpix += npix;
+
+  if (nframes == FSTATS_N) {
+    printf("skymap: %d frames, %d drawn, mean %.3f ms, max %.3f ms, "
+           "%.1f%% of map per frame\n",
+           nframes, ndrawn, 1e3 * sumdt / nframes, 1e3 * maxdt,
+           pmw * pmh > 0 ? 100.0 * sumpix / nframes / (pmw * pmh) : 0.0);
+    fflush(stdout);
+    nframes = ndrawn = 0;
+    sumdt = maxdt = sumpix = 0;
   }
+}
+
+static double secs() {
+  struct timeval tv;
 
-  showSkyMap();
+  gettimeofday(&tv, NULL);
+  return (tv.tv_sec + tv.tv_usec * 1e-6);
 }
 
 static void aa2xy(double alt, double az, int *xp, int *yp) {
   double tmp = PI / 2 - alt;
-  *xp = SKYSZ / 2.0 * (1 + tmp * sin(az) / (PI / 2));
-  *yp = SKYSZ / 2.0 * (1 - tmp * cos(az) / (PI / 2));
+  *xp = skysz / 2.0 * (1 + tmp * sin(az) / (PI / 2));
+  *yp = skysz / 2.0 * (1 - tmp * cos(az) / (PI / 2));
 }
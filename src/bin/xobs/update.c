@@ -129,6 +129,62 @@ void updateStatus(int force) {
   showHL();
 }
 
+/* update the parts of the display that show the sections of shm in
+ * changed, a mask of TSG_BIT()s as found by telshm_wait().
+ */
+void updateChanged(int changed) {
+  int tel = changed & TSG_BIT(TSG_TEL);
+
+  batchison = batchIsOn();
+
+  if (changed & TSG_BIT(TSG_WX)) {
+    showWx();
+    showTemps();
+  }
+
+  /* the flat lights are shown with the camera but are part of tel */
+  if (tel || (changed & TSG_BIT(TSG_CAM)))
+    showCamera();
+
+  if (changed & TSG_BIT(TSG_SCAN))
+    batchUpdate();
+
+  if (changed & TSG_BIT(TSG_DOME))
+    showDome();
+
+  if (tel) {
+    showSkyMap();
+    showFocus();
+    showFilter();
+    showScope();
+  }
+
+  if (tel || (changed & TSG_BIT(TSG_DOME)))
+    showHL();
+}
+
+/* update the parts of the display that change with time, not shm.
+ * called about once a second when shm changes are being announced.
+ * redraw everything now and then too, in case.
+ */
+void updateClock() {
+  static double last_slow;
+  Now *np = &telstatshmp->now;
+
+  batchison = batchIsOn();
+  soundIsOn();
+
+  if (mjd > last_slow + SLOW_DT) {
+    computeSunMoon();
+    showSunMoon();
+    updateChanged(TSG_ALL);
+    last_slow = mjd;
+  }
+
+  showTime();
+  batchUpdate();
+}
+
 static void curPos() {
   static int last_haver = -1;
   char buf[32];
@@ -56,6 +56,7 @@ static char version[] = "1.28";
 #include <sys/ipc.h>
 #include <sys/shm.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <time.h>
@@ -105,17 +106,24 @@ TelStatShm *telstatshmp;
 Obj sunobj, moonobj;
 int xobs_alone;
 
-#define SHMPOLL_PERIOD 100 /* statshm polling period, ms */
+#define SHMPOLL_PERIOD 100 /* statshm polling period if no notices, ms */
 
 static void chkDaemon(char *name, char *fifo, int required, int to);
 static void initShm(void);
+static void initNotify(void);
 static void onsig(int sn);
 static void periodic_check(void);
+static void clock_tick(void);
+static void shm_changed_cb(XtPointer client, int *fdp, XtInputId *idp);
+
+static unsigned int shmseen[TSG_N]; /* shm generations last displayed */
+static int shmpolling;              /* set when polling, not notified */
 
 static char *progname;
 
 static XrmOptionDescRec options[] = {
     {"-q", ".quiet", XrmoptionIsArg, NULL},
+    {"-fstats", ".frameStats", XrmoptionIsArg, NULL},
 };
 
 int main(int ac, char *av[]) {
@@ -165,8 +173,8 @@ int main(int ac, char *av[]) {
   if (xobs_alone && chkTelrun() < 0)
     initPipes();
 
-  /* start a periodic timer */
-  periodic_check();
+  /* follow shm changes as they are announced */
+  initNotify();
 
   /* up */
   XtRealizeWidget(toplevel_w);
@@ -254,6 +262,53 @@ static void chkDaemon(char *dname, char *fifo, int required, int to) {
 
 static void onsig(int sn) { die(); }
 
+/* arrange to be told when shm changes, else fall back to polling it */
+static void initNotify() {
+  int fd = telshm_notifyfd(telstatshmp, TSG_ALL);
+
+  if (fd < 0) {
+    shmpolling = 1;
+    periodic_check();
+    return;
+  }
+
+  XtAppAddInput(app, fd, (XtPointer)XtInputReadMask, shm_changed_cb, 0);
+  updateStatus(1);
+  clock_tick();
+}
+
+/* called when the notifier says some section of shm has changed */
+static void shm_changed_cb(XtPointer client, int *fdp, XtInputId *idp) {
+  char buf[64];
+  int changed;
+
+  if (read(*fdp, buf, sizeof(buf)) <= 0) {
+    /* notifier quit, poll instead */
+    XtRemoveInput(*idp);
+    close(*fdp);
+    shmpolling = 1;
+    periodic_check();
+    return;
+  }
+
+  changed = telshm_wait(telstatshmp, shmseen, TSG_ALL, 0);
+  if (changed > 0)
+    updateChanged(changed);
+}
+
+/* update what depends on the time, just after each second */
+static void clock_tick() {
+  struct timeval tv;
+
+  if (shmpolling)
+    return;
+
+  updateClock();
+  gettimeofday(&tv, NULL);
+  XtAppAddTimeOut(app, 1000 - tv.tv_usec / 1000 + 10,
+                  (XtTimerCallbackProc)clock_tick, 0);
+}
+
 static void periodic_check() {
   updateStatus(0);
   XtAppAddTimeOut(app, SHMPOLL_PERIOD, (XtTimerCallbackProc)periodic_check, 0);
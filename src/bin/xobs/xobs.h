@@ -143,6 +143,7 @@ extern void soundCB(Widget w, XtPointer client, XtPointer call);
 /* skymap.c */
 extern Widget mkSky(Widget p_w);
 extern void showSkyMap(void);
+extern void skyMapReset(void);
 
 /* telrun.c */
 extern int startTelrun(void);
@@ -157,6 +158,8 @@ extern void tip_seton(int whether);
 
 /* update.c */
 extern void updateStatus(int force);
+extern void updateChanged(int changed);
+extern void updateClock(void);
 
 /* xephem.c */
 extern void initXEphem(void);
@@ -6,6 +6,7 @@
 
 #include "P_.h"
 #include "astro.h"
+#include "astroctx.h"
 
 static void aaha_aux P_((double lat, double x, double y, double *p, double *q));
 
@@ -60,16 +61,17 @@ double lat;
 double x, y;
 double *p, *q;
 {
-	static double last_lat = -3434, slat, clat;
+	AstroCtx *cp = astro_cur();
 	double cap, B;
 
-	if (lat != last_lat) {
-	    slat = sin(lat);
-	    clat = cos(lat);
-	    last_lat = lat;
+	if (!cp->aaha.valid || lat != cp->aaha.lastlat) {
+	    cp->aaha.slat = sin(lat);
+	    cp->aaha.clat = cos(lat);
+	    cp->aaha.lastlat = lat;
+	    cp->aaha.valid = 1;
 	}
 
-	solve_sphere (-x, PI/2-y, slat, clat, &cap, &B);
+	solve_sphere (-x, PI/2-y, cp->aaha.slat, cp->aaha.clat, &cap, &B);
 	*p = B;
 	*q = PI/2 - acos(cap);
 }
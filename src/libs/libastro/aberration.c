@@ -14,6 +14,7 @@
 
 #include "P_.h"
 #include "astro.h"
+#include "astroctx.h"
 
 #define ABERR_CONST	(20.49552/3600./180.*PI)  /* aberr const in rad */
 #define AB_ECL_EOD	0
@@ -54,20 +55,22 @@ ab_aux (mjd, x, y, lsn, mode)
 double mjd, *x, *y, lsn;
 int mode;
 {
-	static double lastmjd = -10000;
-	static double eexc;	/* earth orbit excentricity */
-	static double leperi;	/* ... and longitude of perihelion */
-	static char dirty = 1;	/* flag for cached trig terms */
+	AstroCtx *ctx = astro_cur();
+	double eexc;		/* earth orbit excentricity */
+	double leperi;		/* ... and longitude of perihelion */
 
-	if (mjd != lastmjd) {
+	if (!ctx->ab.valid || mjd != ctx->ab.lastmjd) {
 	    double T;		/* centuries since J2000 */
 
 	    T = (mjd - J2000)/36525.;
-	    eexc = 0.016708617 - (42.037e-6 + 0.1236e-6 * T) * T;
-	    leperi = degrad(102.93735 + (0.71953 + 0.00046 * T) * T);
-	    lastmjd = mjd;
-	    dirty = 1;
+	    ctx->ab.eexc = 0.016708617 - (42.037e-6 + 0.1236e-6 * T) * T;
+	    ctx->ab.leperi = degrad(102.93735 + (0.71953 + 0.00046 * T) * T);
+	    ctx->ab.lastmjd = mjd;
+	    ctx->ab.valid = 1;
+	    ctx->ab.trig = 0;
 	}
+	eexc = ctx->ab.eexc;
+	leperi = ctx->ab.leperi;
 
 	switch (mode) {
 	case AB_ECL_EOD:		/* ecliptical coords */
@@ -90,19 +93,23 @@ int mode;
 	    {
 		double *ra = x, *dec = y;
 		double sr, cr, sd, cd, sls, cls;/* trig values coords */
-		static double cp, sp, ce, se;	/* .. and perihel/eclipic */
+		double cp, sp, ce, se;		/* .. and perihel/eclipic */
 		double dra, ddec;		/* changes in ra and dec */
 
-		if (dirty) {
+		if (!ctx->ab.trig) {
 		    double eps;
 
-		    cp = cos(leperi);
-		    sp = sin(leperi);
+		    ctx->ab.cp = cos(leperi);
+		    ctx->ab.sp = sin(leperi);
 		    obliquity(mjd, &eps);
-		    se = sin(eps);
-		    ce = cos(eps);
-		    dirty = 0;
+		    ctx->ab.se = sin(eps);
+		    ctx->ab.ce = cos(eps);
+		    ctx->ab.trig = 1;
 		}
+		cp = ctx->ab.cp;
+		sp = ctx->ab.sp;
+		ce = ctx->ab.ce;
+		se = ctx->ab.se;
 
 		sr = sin(*ra);
 		cr = cos(*ra);
@@ -60,6 +60,16 @@ extern void airmass P_((double aa, double *Xp));
 /* anomaly.c */
 extern void anomaly P_((double ma, double s, double *nu, double *ea));
 
+/* astroctx.c */
+typedef struct _AstroCtx AstroCtx;	/* opaque, see astroctx.h */
+extern AstroCtx *astro_ctx_new P_((void));
+extern void astro_ctx_free P_((AstroCtx *cp));
+extern void nutation_r P_((AstroCtx *cp, double mjd, double *deps,
+    double *dpsi));
+extern void nut_eq_r P_((AstroCtx *cp, double mjd, double *ra, double *dec));
+extern void precess_r P_((AstroCtx *cp, double mjd1, double mjd2, double *ra,
+    double *dec));
+
 /* chap95.c */
 extern int chap95 P_((double mjd, int obj, double prec, double *ret));
 
@@ -73,6 +83,19 @@ extern void comet P_((double mjd, double ep, double inc, double ap, double qp,
 /* deltat.c */
 extern double deltat P_((double mjd));
 
+/* ephcache.c */
+extern void ephc_enable P_((int on));
+extern void ephc_settol P_((double arcsec));
+extern void ephc_setspan P_((int obj, double days));
+extern void ephc_stats P_((long *hitsp, long *fitsp, long *rejectsp,
+    long *missesp));
+extern int ephc_planet P_((double mjd, int obj, double ret[3]));
+extern int ephc_sun P_((double mjd, double *lsn, double *rsn, double *bsn));
+extern int ephc_moon P_((double mjd, double *lam, double *bet, double *rho,
+    double *msp, double *mdp));
+extern int ephc_save P_((char *fn, double mjd1, double mjd2, char msg[]));
+extern int ephc_load P_((char *fn, char msg[]));
+
 /* eq_ecl.c */
 extern void eq_ecl P_((double mjd, double ra, double dec, double *lat,
     double *lng));
@@ -130,6 +153,8 @@ extern void range P_((double *v, double r));
 /* moon.c */
 extern void moon P_((double mjd, double *lam, double *bet, double *rho,
     double *msp, double *mdp));
+extern void moon_series P_((double mjd, double *lam, double *bet, double *rho,
+    double *msp, double *mdp));
 
 /* mooncolong.c */
 extern void moon_colong P_((double jd, double lt, double lg, double *cp, double *kp, double *ap, double *sp));
@@ -149,6 +174,7 @@ extern void ta_par P_((double tha, double tdec, double phi, double ht,
 extern void plans P_((double mjd, int p, double *lpd0, double *psi0,
     double *rp0, double *rho0, double *lam, double *bet, double *dia,
     double *mag));
+extern void plan_series P_((double mjd, int obj, double prec, double *ret));
 
 /* precess.c */
 extern void precess P_((double mjd1, double mjd2, double *ra, double *dec));
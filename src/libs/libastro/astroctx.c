@@ -0,0 +1,95 @@
+/* AstroCtx support: the per-caller caches which let libastro be used from
+ * several threads at once.
+ *
+ * every cache lookup goes through astro_cur(). a thread which has not
+ * installed a context of its own shares the process-wide default, which is
+ * just what the classic single-threaded API always had. the _r entry points
+ * install the caller's context around one call to their classic twin, so
+ * nothing below them needs to pass it along explicitly.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "P_.h"
+#include "astro.h"
+#include "astroctx.h"
+
+static AstroCtx defctx;			/* used when none is installed */
+static ASTRO_TLS AstroCtx *curctx;	/* installed for this thread, if any */
+
+/* return a new empty context, or NULL if no memory.
+ * free it with astro_ctx_free() when done.
+ */
+AstroCtx *
+astro_ctx_new()
+{
+	return ((AstroCtx *) calloc (1, sizeof(AstroCtx)));
+}
+
+/* free a context from astro_ctx_new(). */
+void
+astro_ctx_free (cp)
+AstroCtx *cp;
+{
+	if (cp && cp != &defctx)
+	    free ((void *)cp);
+}
+
+/* return the context in effect for the calling thread */
+AstroCtx *
+astro_cur()
+{
+	return (curctx ? curctx : &defctx);
+}
+
+/* make cp the context for the calling thread, NULL for the default, and
+ * return the one it replaces so the caller can put it back.
+ */
+AstroCtx *
+astro_use (cp)
+AstroCtx *cp;
+{
+	AstroCtx *was = curctx;
+
+	curctx = cp;
+	return (was);
+}
+
+/* nutation() using the caches in cp */
+void
+nutation_r (cp, mjd, deps, dpsi)
+AstroCtx *cp;
+double mjd;
+double *deps, *dpsi;
+{
+	AstroCtx *was = astro_use (cp);
+
+	nutation (mjd, deps, dpsi);
+	(void) astro_use (was);
+}
+
+/* nut_eq() using the caches in cp */
+void
+nut_eq_r (cp, mjd, ra, dec)
+AstroCtx *cp;
+double mjd, *ra, *dec;
+{
+	AstroCtx *was = astro_use (cp);
+
+	nut_eq (mjd, ra, dec);
+	(void) astro_use (was);
+}
+
+/* precess() using the caches in cp */
+void
+precess_r (cp, mjd1, mjd2, ra, dec)
+AstroCtx *cp;
+double mjd1, mjd2;
+double *ra, *dec;
+{
+	AstroCtx *was = astro_use (cp);
+
+	precess (mjd1, mjd2, ra, dec);
+	(void) astro_use (was);
+}
@@ -0,0 +1,148 @@
+/* private definition of the AstroCtx, the per-caller state libastro used to
+ * keep in function-level statics. each member is a small memo of the last
+ * inputs and results of one routine; a zeroed member means "nothing cached".
+ *
+ * the public routines use whatever context is current for the calling
+ * thread: normally the process-wide default, or the one installed by an _r
+ * entry point for the duration of that call. so two threads each using
+ * their own AstroCtx never touch the same cache.
+ *
+ * not for use outside libastro.
+ */
+
+#ifndef _ASTROCTX_H
+#define	_ASTROCTX_H
+
+#include "sattypes.h"
+#include "satlib.h"
+
+/* storage class for per-thread scratch which needs no context */
+#if defined(__GNUC__)
+#define	ASTRO_TLS	__thread
+#else
+#define	ASTRO_TLS
+#endif
+
+#define	ACTX_NUTMUL	4	/* max multiple of delaunay args, nutation.c */
+#define	ACTX_NEPH	(MOON+1)	/* bodies in ephcache.c */
+#define	ACTX_NESLOT	8	/* segments cached per body, power of 2 */
+#define	ACTX_NCOEF	14	/* chebyshev coefficients per coordinate */
+#define	ACTX_NQ		5	/* max coordinates per body */
+#define	ACTX_NSAT	16	/* satellite propagators kept, earthsat.c */
+
+/* one fitted chebyshev segment, see ephcache.c */
+typedef struct {
+    int valid;			/* 1 if fit is good, -1 if bad, 0 if empty */
+    long idx;			/* segment index, ie, floor(lastmjd/span) */
+    double c[ACTX_NQ][ACTX_NCOEF];	/* coefficients for each coordinate */
+} EphSeg;
+
+/* SGP4 or SDP4 propagator state */
+typedef union {
+    struct sgp4_data sgp4;
+    struct sdp4_data sdp4;
+} SatProp;
+
+/* one satellite's propagator as left by its set up, see earthsat.c */
+typedef struct {
+    int valid;			/* 1 if in use */
+    int deep;			/* 1 if SDP4, with ds, else SGP4 */
+    long used;			/* sat.clock when last used */
+    SatElem se;			/* elements, which are also the key */
+    SatProp prop;		/* propagator state */
+    struct deep_data ds;	/* deep space state, if deep */
+} EsatProp;
+
+struct _AstroCtx {
+    struct {				/* aa_hadec.c */
+	int valid;
+	double lastlat, slat, clat;
+    } aaha;
+
+    struct {				/* aberration.c */
+	int valid, trig;
+	double lastmjd, eexc, leperi;
+	double cp, sp, ce, se;
+    } ab;
+
+    struct {				/* deltat.c */
+	int valid;
+	double lastmjd, ans;
+    } dt;
+
+    struct {				/* eq_ecl.c */
+	int valid;
+	double lastmjd, seps, ceps;
+    } ecl;
+
+    struct {				/* misc.c now_lst() */
+	int valid;
+	double lastmjd, lastlng, lst;
+    } lst;
+
+    struct {				/* mjd.c */
+	int calvalid, mjdvalid, yrvalid;
+	double cm_mjd, cm_dy;		/* cal_mjd() */
+	int cm_mn, cm_yr;
+	double mc_mjd, mc_dy;		/* mjd_cal() */
+	int mc_mn, mc_yr;
+	double my_mjd, my_yr;		/* mjd_year() */
+    } cal;
+
+    struct {				/* nutation.c */
+	int valid, eqvalid;
+	double lastmjd, deps, dpsi;
+	double delcache[5][2*ACTX_NUTMUL+1];
+	double eqmjd, a[3][3];
+    } nut;
+
+    struct {				/* obliq.c */
+	int valid;
+	double lastmjd, eps;
+    } obl;
+
+    struct {				/* parallax.c */
+	int valid;
+	double phi, ht, xobs, zobs;
+    } par;
+
+    struct {				/* plans.c */
+	int valid;
+	double lastmjd, lsn, bsn, rsn, xsn, ysn, zsn;
+    } pl;
+
+    struct {				/* precess.c */
+	int valid1, valid2;
+	double mjd1, from, mjd2, to;
+    } pre;
+
+    struct {				/* sun.c */
+	int valid;
+	double lastmjd, lsn, rsn, bsn;
+    } sun;
+
+    struct {				/* utc_gst.c */
+	int gvalid, uvalid;
+	double gmjd, gt0, umjd, ut0;
+    } gst;
+
+    struct {				/* ephcache.c */
+	EphSeg slots[ACTX_NEPH][ACTX_NESLOT];
+	long gen;			/* ephc_gen when slots were fitted */
+	long nhits, nfits, nrejects, nmisses;
+    } eph;
+
+    struct {				/* earthsat.c */
+	EsatProp slots[ACTX_NSAT];
+	long clock;			/* counts uses, for lru */
+	long nhits, ninits;
+    } sat;
+};
+
+/* return the context in effect for the calling thread, never NULL */
+extern AstroCtx *astro_cur P_((void));
+
+/* install cp for the calling thread, NULL for the default; return previous */
+extern AstroCtx *astro_use P_((AstroCtx *cp));
+
+#endif /* _ASTROCTX_H */
@@ -15,6 +15,7 @@
 #include "P_.h"
 #include "astro.h"
 #include "circum.h"
+#include "astroctx.h"
 #include "preferences.h"
 
 
@@ -55,6 +56,22 @@ Obj *op;
 	}
 }
 
+/* same as obj_cir() but using the caches in cp. safe to call from several
+ * threads at once provided each uses its own cp.
+ */
+int
+obj_cir_r (cp, np, op)
+AstroCtx *cp;
+Now *np;
+Obj *op;
+{
+	AstroCtx *was = astro_use (cp);
+	int s = obj_cir (np, op);
+
+	(void) astro_use (was);
+	return (s);
+}
+
 static int
 obj_planet (np, op)
 Now *np;
@@ -417,9 +417,15 @@ extern double mm_mjed P_((Now *np));
 
 /* circum.c */
 extern int obj_cir P_((Now *np, Obj *op));
+extern int obj_cir_r P_((struct _AstroCtx *cp, Now *np, Obj *op));
 
 /* earthsat.c */
 extern int obj_earthsat P_((Now *np, Obj *op));
+extern int obj_earthsat_times P_((Now *np, Obj *op, double mjds[], int n,
+    Obj out[]));
+extern int obj_earthsat_many P_((Now *np, Obj *ops[], int n));
+extern void esat_cache P_((int on));
+extern void esat_stats P_((long *hitsp, long *initsp));
 
 /* dbfmt.c */
 extern int db_crack_line P_((char s[], Obj *op, char whynot[]));
@@ -436,5 +442,9 @@ extern int is_deepsky P_((Obj *op));
 
 /* riset_cir.c */
 extern void riset_cir P_((Now *np, Obj *op, double dis, RiseSet *rp));
+extern void riset_cir_r P_((struct _AstroCtx *cp, Now *np, Obj *op,
+    double dis, RiseSet *rp));
+extern void riset_cir_batch P_((Now *np, Obj *ops[], int nop, double dis,
+    RiseSet rps[], int nthr));
 extern void twilight_cir P_((Now *np, double dis, double *dawn, double *dusk,
     int *status));
@@ -74,11 +74,15 @@
  *   - replaced treatment after TABEND by linear extrapolation instead
  *	of second order version
  *   - installed lastmjd cache (made ans static)
+ *   - moved the cache to the AstroCtx, computation to dt_compute()
  *
  *   - no changes to table interpolation scheme and past extrapolations */
 
 #include "P_.h"
 #include "astro.h"
+#include "astroctx.h"
+
+static double dt_compute P_((double mjd));
 
 #define TABSTART 1620.0
 #define TABEND 2006.0
@@ -162,19 +166,26 @@ static short dt[TABSIZ] = {
  */
 double deltat(mjd)
 double mjd;
+{
+	AstroCtx *cp = astro_cur();
+
+	if (!cp->dt.valid || mjd != cp->dt.lastmjd) {
+	    cp->dt.ans = dt_compute (mjd);
+	    cp->dt.lastmjd = mjd;
+	    cp->dt.valid = 1;
+	}
+	return (cp->dt.ans);
+}
+
+static double dt_compute(mjd)
+double mjd;
 {
 	double Y;
 	double p, B;
 	int d[6];
 	int i, iy, k;
 	double floor();
-	static double ans;
-	static double lastmjd = -10000;
-
-	if (mjd == lastmjd) {
-	    return(ans);
-	}
-	lastmjd = mjd;
+	double ans;
 
 	Y = 2000.0 + (mjd - J2000)/365.25;
 
@@ -22,6 +22,7 @@
 #include <stdio.h>
 #include <math.h>
 #include <string.h>
+#include <pthread.h>
 
 #if defined(__STDC__)
 #include <stdlib.h>
@@ -35,14 +36,19 @@
 #include "vector.h"
 #include "sattypes.h"
 #include "satlib.h"
+#include "astroctx.h"
 
 
 #define ESAT_MAG        2       /* fake satellite magnitude */
+#define	MPD		1440.0		/* minutes per day */
 
 typedef double MAT3x3[3][3];
 
-static void esat_prop P_((Now *np, Obj *op, double *SatX, double *SatY, double
-    *SatZ, double *SatVX, double *SatVY, double *SatVZ));
+static int esat_sky P_((Now *np, Obj *op, EsatProp *pp));
+static EsatProp *esat_find P_((Obj *op));
+static void esat_elem P_((Obj *op, SatElem *sep));
+static void esat_prop P_((Now *np, Obj *op, EsatProp *pp, double *SatX,
+    double *SatY, double *SatZ, double *SatVX, double *SatVY, double *SatVZ));
 static void GetSatelliteParams P_((Obj *op));
 static void GetSiteParams P_((Now *np));
 static double Kepler P_((double MeanAnomaly, double Eccentricity));
@@ -126,17 +132,129 @@ static double SunEpochTime,SunInclination,SunRAAN,SunEccentricity,
 /* values for shadow geometry */
 static double SinPenumbra,CosPenumbra;
 
+static int esat_enabled = 1;	/* whether to cache propagator state */
+
+/* the orbit and site state above is shared, so each entry point holds this
+ * while it uses it.
+ */
+static pthread_mutex_t esat_lock = PTHREAD_MUTEX_INITIALIZER;
+
 
 /* given a Now and an Obj with info about an earth satellite in the es_* fields
  * fill in the s_* sky fields describing the satellite.
  * as usual, we compute the geocentric ra/dec precessed to np->n_epoch and
  * compute topocentric altitude accounting for refraction.
+ * the initialised SGP4/SDP4 state of the last ACTX_NSAT satellites is kept in
+ * the current AstroCtx, keyed on their elements, so tracking one satellite
+ * does not set up its propagator again at every step.
  * return 0 if all ok, else -1.
  */
 int
 obj_earthsat (np, op)
 Now *np;
 Obj *op;
+{
+	/* xephem uses noon 12/31/1899 as 0; orbit uses midnight 1/1/1900.
+	 * thus, xephem runs 12 hours, or 1/2 day, behind of what orbit wants.
+	 */
+	int s;
+
+	pthread_mutex_lock (&esat_lock);
+	InitOrbitRoutines(mjd + 0.5, 1);
+	GetSiteParams(np);
+	s = esat_sky (np, op, esat_find (op));
+	pthread_mutex_unlock (&esat_lock);
+	return (s);
+}
+
+/* fill in out[i] as obj_earthsat() would for op at each of the n times
+ * mjds[i], the rest of the circumstances being as in np. the propagator for
+ * op is set up just once for them all.
+ * return 0 if all ok, else -1.
+ */
+int
+obj_earthsat_times (np, op, mjds, n, out)
+Now *np;
+Obj *op;
+double mjds[];
+int n;
+Obj out[];
+{
+	EsatProp *pp;
+	Now now;
+	int i, ret = 0;
+
+	pthread_mutex_lock (&esat_lock);
+	pp = esat_find (op);
+	now = *np;
+	GetSiteParams(&now);
+	for (i = 0; i < n; i++) {
+	    now.n_mjd = mjds[i];
+	    InitOrbitRoutines(now.n_mjd + 0.5, 1);
+	    out[i] = *op;
+	    if (esat_sky (&now, &out[i], pp) < 0)
+		ret = -1;
+	}
+	pthread_mutex_unlock (&esat_lock);
+	return (ret);
+}
+
+/* call obj_earthsat() for each of the n satellites ops[] at np, doing the work
+ * which depends only on the time and place just once.
+ * N.B. propagators are cached as in obj_earthsat(), so for many satellites
+ *   over many times it is best to loop over the times within each satellite,
+ *   as obj_earthsat_times() does.
+ * return 0 if all ok, else -1.
+ */
+int
+obj_earthsat_many (np, ops, n)
+Now *np;
+Obj *ops[];
+int n;
+{
+	int i, ret = 0;
+
+	pthread_mutex_lock (&esat_lock);
+	InitOrbitRoutines(mjd + 0.5, 1);
+	GetSiteParams(np);
+	for (i = 0; i < n; i++)
+	    if (esat_sky (np, ops[i], esat_find (ops[i])) < 0)
+		ret = -1;
+	pthread_mutex_unlock (&esat_lock);
+	return (ret);
+}
+
+/* turn the propagator cache on or off. SGP4/SDP4 are set up afresh for every
+ * position when off, as they always used to be.
+ */
+void
+esat_cache (on)
+int on;
+{
+	esat_enabled = on;
+}
+
+/* report how many positions in the current AstroCtx used a cached propagator
+ * and how many had to set one up.
+ */
+void
+esat_stats (hitsp, initsp)
+long *hitsp, *initsp;
+{
+	AstroCtx *cp = astro_cur();
+
+	*hitsp = cp->sat.nhits;
+	*initsp = cp->sat.ninits;
+}
+
+/* obj_earthsat() once the orbit and site globals are set up for np.
+ * pp is the cached propagator for op, or NULL to set one up just for this.
+ */
+static int
+esat_sky (np, op, pp)
+Now *np;
+Obj *op;
+EsatProp *pp;
 {
 	double Radius;              /* From geocenter                  */
 	double SatX,SatY,SatZ;	    /* In Right Ascension based system */
@@ -161,20 +279,16 @@ Obj *op;
 	printf ("satellite mjd = %g\n", op->es_epoch);
 #endif /* ESAT_TRACE */
 
-	/* xephem uses noon 12/31/1899 as 0; orbit uses midnight 1/1/1900.
-	 * thus, xephem runs 12 hours, or 1/2 day, behind of what orbit wants.
-	 */
+	/* as set up by our callers */
 	CrntTime = mjd + 0.5;
 
 	/* extract the XEphem data forms into those used by orbit.
 	 * (we still use some functions and names from orbit, thank you).
 	 */
-	InitOrbitRoutines(CrntTime, 1);
 	GetSatelliteParams(op);
-	GetSiteParams(np);
 
 	/* propagate to np->n_mjd */
-	esat_prop (np, op, &SatX, &SatY, &SatZ, &SatVX, &SatVY, &SatVZ);
+	esat_prop (np, op, pp, &SatX, &SatY, &SatZ, &SatVX, &SatVY, &SatVZ);
 	Radius = sqrt (SatX*SatX + SatY*SatY + SatZ*SatZ);
 
 	/* find geocentric EOD equatorial directly from xyz vector */
@@ -263,12 +377,14 @@ Obj *op;
 }
 
 /* find position and velocity vector for given Obj at the given time.
+ * pp is its cached propagator, or NULL to set one up just for this.
  * set USE_ORBIT_PROPAGATOR depending on desired propagator to use.
  */
 static void
-esat_prop (np, op, SatX, SatY, SatZ, SatVX, SatVY, SatVZ)
+esat_prop (np, op, pp, SatX, SatY, SatZ, SatVX, SatVY, SatVZ)
 Now *np;
 Obj *op;
+EsatProp *pp;
 double *SatX,*SatY,*SatZ;
 double *SatVX,*SatVY,*SatVZ;
 {
@@ -322,65 +438,57 @@ double *SatVX,*SatVY,*SatVZ;
 #endif	/* ESAT_TRACE */
 
 #else	/* ! USE_ORBIT_PROPAGATOR */
-#define	MPD		1440.0		/* minutes per day */
 
 	SatElem se;
 	SatData sd;
 	Vec3 posvec, velvec;
-	double dy;
+	struct deep_data ds;
+	SatProp prop;
 	double dt;
-	int yr;
 
 	/* init */
-	memset ((void *)&se, 0, sizeof(se));
 	memset ((void *)&sd, 0, sizeof(sd));
-	sd.elem = &se;
-
-	/* se_EPOCH is packed as yr*1000 + dy, where yr is years since 1900
-	 * and dy is day of year, Jan 1 being 1
-	 */
-	mjd_dayno (op->es_epoch, &yr, &dy);
-	yr -= 1900;
-	dy += 1;
-	se.se_EPOCH = yr*1000 + dy;
-
-	/* others carry over with some change in units */
-	se.se_XNO = op->es_n * (2*PI/MPD);	/* revs/day to rads/min */
-	se.se_XINCL = (float)degrad(op->es_inc);
-	se.se_XNODEO = (float)degrad(op->es_raan);
-	se.se_EO = op->es_e;
-	se.se_OMEGAO = (float)degrad(op->es_ap);
-	se.se_XMO = (float)degrad(op->es_M);
-	se.se_BSTAR = op->es_drag;
-	se.se_XNDT20 = op->es_decay*(2*PI/MPD/MPD); /*rv/dy^^2 to rad/min^^2*/
-
-	se.se_id.orbit = op->es_orbit;
+	if (pp) {
+	    /* start from copies of the state just after set up */
+	    sd.elem = &pp->se;
+	    prop = pp->prop;
+	    sd.prop.sgp4 = &prop.sgp4;
+	    if (pp->deep) {
+		ds = pp->ds;
+		sd.deep = &ds;
+	    }
+	} else {
+	    esat_elem (op, &se);
+	    sd.elem = &se;
+	}
 
 	dt = (mjd-op->es_epoch)*MPD;
 
 #ifdef ESAT_TRACE
-	printf ("se_EPOCH  : %30.20f\n", se.se_EPOCH);
-	printf ("se_XNO    : %30.20f\n", se.se_XNO);
-	printf ("se_XINCL  : %30.20f\n", se.se_XINCL);
-	printf ("se_XNODEO : %30.20f\n", se.se_XNODEO);
-	printf ("se_EO     : %30.20f\n", se.se_EO);
-	printf ("se_OMEGAO : %30.20f\n", se.se_OMEGAO);
-	printf ("se_XMO    : %30.20f\n", se.se_XMO);
-	printf ("se_BSTAR  : %30.20f\n", se.se_BSTAR);
-	printf ("se_XNDT20 : %30.20f\n", se.se_XNDT20);
-	printf ("se_orbit  : %30d\n",    se.se_id.orbit);
+	printf ("se_EPOCH  : %30.20f\n", sd.elem->se_EPOCH);
+	printf ("se_XNO    : %30.20f\n", sd.elem->se_XNO);
+	printf ("se_XINCL  : %30.20f\n", sd.elem->se_XINCL);
+	printf ("se_XNODEO : %30.20f\n", sd.elem->se_XNODEO);
+	printf ("se_EO     : %30.20f\n", sd.elem->se_EO);
+	printf ("se_OMEGAO : %30.20f\n", sd.elem->se_OMEGAO);
+	printf ("se_XMO    : %30.20f\n", sd.elem->se_XMO);
+	printf ("se_BSTAR  : %30.20f\n", sd.elem->se_BSTAR);
+	printf ("se_XNDT20 : %30.20f\n", sd.elem->se_XNDT20);
+	printf ("se_orbit  : %30d\n",    sd.elem->se_id.orbit);
 	printf ("dt        : %30.20f\n", dt);
 #endif /* ESAT_TRACE */
 
 	/* compute the state vectors */
-	if (se.se_XNO >= (1.0/225.0))
+	if (sd.elem->se_XNO >= (1.0/225.0))
 	    sgp4(&sd, &posvec, &velvec, dt); /* NEO */
 	else
 	    sdp4(&sd, &posvec, &velvec, dt); /* GEO */
-	if (sd.prop.sgp4)
-	    free (sd.prop.sgp4);	/* sd.prop.sdp4 is in same union */
-	if (sd.deep)
-	    free (sd.deep);
+	if (!pp) {
+	    if (sd.prop.sgp4)
+		free (sd.prop.sgp4);	/* sd.prop.sdp4 is in same union */
+	    if (sd.deep)
+		free (sd.deep);
+	}
 
 	*SatX = ERAD*posvec.x/1000;	/* earth radii to km */
 	*SatY = ERAD*posvec.y/1000;
@@ -391,6 +499,104 @@ double *SatVX,*SatVY,*SatVZ;
 #endif
 }
 
+/* return the propagator for op cached in the current AstroCtx, setting one
+ * up in the least recently used slot if it is not there, or NULL if caching
+ * is off.
+ * N.B. the slot is only good until the next call.
+ */
+static EsatProp *
+esat_find (op)
+Obj *op;
+{
+	AstroCtx *cp = astro_cur();
+	EsatProp *pp, *lru;
+	SatData sd;
+	Vec3 posvec, velvec;
+	SatElem se;
+	int i;
+
+	if (!esat_enabled)
+	    return (NULL);
+
+	esat_elem (op, &se);
+	lru = &cp->sat.slots[0];
+	for (i = 0; i < ACTX_NSAT; i++) {
+	    pp = &cp->sat.slots[i];
+	    if (pp->valid && memcmp ((void *)&pp->se, (void *)&se,
+							    sizeof(se)) == 0) {
+		pp->used = ++cp->sat.clock;
+		cp->sat.nhits++;
+		return (pp);
+	    }
+	    if (lru->valid && (!pp->valid || pp->used < lru->used))
+		lru = pp;
+	}
+
+	/* set up by propagating to the epoch, as sdp4() does first itself,
+	 * then keep the state it leaves.
+	 */
+	memset ((void *)&sd, 0, sizeof(sd));
+	pp = lru;
+	pp->se = se;
+	pp->deep = se.se_XNO < (1.0/225.0);
+	sd.elem = &pp->se;
+	if (pp->deep)
+	    sdp4(&sd, &posvec, &velvec, 0.0);
+	else
+	    sgp4(&sd, &posvec, &velvec, 0.0);
+	if (!sd.prop.sgp4 || (pp->deep && !sd.deep)) {
+	    pp->valid = 0;
+	    pp = NULL;
+	} else {
+	    if (pp->deep) {
+		pp->prop.sdp4 = *sd.prop.sdp4;
+		pp->ds = *sd.deep;
+	    } else
+		pp->prop.sgp4 = *sd.prop.sgp4;
+	    pp->valid = 1;
+	    pp->used = ++cp->sat.clock;
+	    cp->sat.ninits++;
+	}
+	if (sd.prop.sgp4)
+	    free (sd.prop.sgp4);
+	if (sd.deep)
+	    free (sd.deep);
+	return (pp);
+}
+
+/* fill *sep with the SGP4/SDP4 form of the elements of op */
+static void
+esat_elem (op, sep)
+Obj *op;
+SatElem *sep;
+{
+	double dy;
+	int yr;
+
+	/* zeroed so it may be compared as a whole */
+	memset ((void *)sep, 0, sizeof(*sep));
+
+	/* se_EPOCH is packed as yr*1000 + dy, where yr is years since 1900
+	 * and dy is day of year, Jan 1 being 1
+	 */
+	mjd_dayno (op->es_epoch, &yr, &dy);
+	yr -= 1900;
+	dy += 1;
+	sep->se_EPOCH = yr*1000 + dy;
+
+	/* others carry over with some change in units */
+	sep->se_XNO = op->es_n * (2*PI/MPD);	/* revs/day to rads/min */
+	sep->se_XINCL = (float)degrad(op->es_inc);
+	sep->se_XNODEO = (float)degrad(op->es_raan);
+	sep->se_EO = op->es_e;
+	sep->se_OMEGAO = (float)degrad(op->es_ap);
+	sep->se_XMO = (float)degrad(op->es_M);
+	sep->se_BSTAR = op->es_drag;
+	sep->se_XNDT20 = op->es_decay*(2*PI/MPD/MPD); /*rv/dy^^2 to rad/min^^2*/
+
+	sep->se_id.orbit = op->es_orbit;
+}
+
 
 /* grab the xephem stuff from op and copy into orbit's globals.
  */
@@ -0,0 +1,472 @@
+/* Chebyshev cache of the planetary, solar and lunar series.
+ *
+ * time is cut into fixed segments per body, ephc_span[] days long. the first
+ * time a position is wanted within a segment the full series is evaluated at
+ * NCOEF Chebyshev nodes and a polynomial is fit to each coordinate. the fit
+ * is then checked against the full series between every pair of nodes and at
+ * both ends; if any coordinate is off by more than the tolerance the segment
+ * is marked bad and all requests in it go back to the full series. so every
+ * position served from the cache is within the tolerance of the series at
+ * least at the check points, and since the fits are very smooth, everywhere.
+ *
+ * segments may also be computed ahead of time over a range of dates and saved
+ * to a file with ephc_save(), then reloaded with ephc_load().
+ *
+ * coordinates are those returned by the series themselves: heliocentric
+ * l/b/r of date for the planets, geocentric l/b/r of date for the sun and
+ * l/b/r plus the two mean anomalies for the moon. angles that wrap are made
+ * continuous across each segment before fitting.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+
+#include "P_.h"
+#include "astro.h"
+#include "astroctx.h"
+
+#define	NCOEF	ACTX_NCOEF	/* coefficients per coordinate */
+#define	NQ	ACTX_NQ		/* max coordinates per body */
+#define	NBODY	ACTX_NEPH	/* MERCURY .. PLUTO, SUN, MOON */
+#define	NSLOT	ACTX_NESLOT	/* segments cached per body, power of 2 */
+#define	DEFTOL	0.001		/* default tolerance, arc seconds */
+#define	EPHCMAGIC "TalonEphCache1"	/* file magic, includes version */
+
+/* segments preloaded from a file */
+typedef struct {
+    EphSeg *segs;		/* malloced array of nsegs, or NULL */
+    long first;			/* index of segs[0] */
+    long nsegs;			/* n segs[] */
+} EphTable;
+
+/* days per segment. short enough for NCOEF to reach DEFTOL easily. */
+static double ephc_span[NBODY] = {
+    8.0,	/* MERCURY */
+    16.0,	/* VENUS */
+    16.0,	/* MARS */
+    32.0,	/* JUPITER */
+    32.0,	/* SATURN */
+    64.0,	/* URANUS */
+    64.0,	/* NEPTUNE */
+    64.0,	/* PLUTO */
+    16.0,	/* SUN */
+    4.0,	/* MOON */
+};
+
+/* number of coordinates and mask of those which are wrapping angles */
+static int ephc_nq[NBODY]   = {3, 3, 3, 3, 3, 3, 3, 3, 3, 5};
+static int ephc_wrap[NBODY] = {1, 1, 1, 1, 1, 1, 1, 1, 1, 1|8|16};
+
+/* the fitted segments and counters live in each AstroCtx; the settings and
+ * preloaded tables below are shared. ephc_gen changes with the settings so
+ * each context knows to discard segments fitted under the old ones.
+ */
+static EphTable tables[NBODY];		/* preloaded segments */
+static int enabled = 1;			/* whether to use the cache at all */
+static double tol = degrad(DEFTOL/3600.0);	/* tolerance, rads */
+static long ephc_gen = 1;		/* settings generation */
+
+static int ephc_get P_((int obj, double mjd, double q[NQ]));
+static void ephc_fit P_((int obj, long idx, EphSeg *sp));
+static void ephc_series P_((int obj, double mjd, double q[NQ]));
+static void ephc_eval P_((EphSeg *sp, int nq, double x, double q[NQ]));
+static void ephc_flush P_((int obj));
+
+/* turn the cache on or off. the series are always used when off. */
+void
+ephc_enable (on)
+int on;
+{
+	enabled = on;
+}
+
+/* set the tolerance, in arc seconds, each fitted segment must meet against
+ * the full series, for angles and for distance relative to itself.
+ * discards any segments already fitted.
+ */
+void
+ephc_settol (arcsec)
+double arcsec;
+{
+	int i;
+
+	tol = degrad(arcsec/3600.0);
+	for (i = 0; i < NBODY; i++)
+	    ephc_flush (i);
+}
+
+/* set the segment length, in days, for the given body.
+ * discards any segments already fitted for it.
+ */
+void
+ephc_setspan (obj, days)
+int obj;
+double days;
+{
+	if (obj < 0 || obj >= NBODY || days <= 0)
+	    return;
+	ephc_span[obj] = days;
+	ephc_flush (obj);
+}
+
+/* return counts of positions served from fits, segments fitted, segments
+ * rejected for failing the tolerance and positions sent back to the series,
+ * for the current context.
+ */
+void
+ephc_stats (hitsp, fitsp, rejectsp, missesp)
+long *hitsp, *fitsp, *rejectsp, *missesp;
+{
+	AstroCtx *cp = astro_cur();
+
+	*hitsp = cp->eph.nhits;
+	*fitsp = cp->eph.nfits;
+	*rejectsp = cp->eph.nrejects;
+	*missesp = cp->eph.nmisses;
+}
+
+/* find heliocentric l/b/r of planet obj, mean ecliptic of date, in ret[].
+ * return 0 if found from the cache, else -1 and caller must use the series.
+ */
+int
+ephc_planet (mjd, obj, ret)
+double mjd;
+int obj;
+double ret[3];
+{
+	double q[NQ];
+
+	if (obj < MERCURY || obj > PLUTO || ephc_get (obj, mjd, q) < 0)
+	    return (-1);
+	ret[0] = q[0];
+	ret[1] = q[1];
+	ret[2] = q[2];
+	return (0);
+}
+
+/* find the sun as per sunpos().
+ * return 0 if found from the cache, else -1 and caller must use the series.
+ */
+int
+ephc_sun (mjd, lsn, rsn, bsn)
+double mjd;
+double *lsn, *rsn, *bsn;
+{
+	double q[NQ];
+
+	if (ephc_get (SUN, mjd, q) < 0)
+	    return (-1);
+	*lsn = q[0];
+	range (lsn, 2*PI);
+	*bsn = q[1];
+	*rsn = q[2];
+	return (0);
+}
+
+/* find the moon as per moon().
+ * return 0 if found from the cache, else -1 and caller must use the series.
+ */
+int
+ephc_moon (mjd, lam, bet, rho, msp, mdp)
+double mjd;
+double *lam, *bet, *rho, *msp, *mdp;
+{
+	double q[NQ];
+
+	if (ephc_get (MOON, mjd, q) < 0)
+	    return (-1);
+	*lam = q[0];
+	range (lam, 2*PI);
+	*bet = q[1];
+	*rho = q[2];
+	*msp = q[3];
+	*mdp = q[4];
+	return (0);
+}
+
+/* fit every body over [mjd1,mjd2] and save in the named file.
+ * return 0 if ok, else -1 with excuse in msg[].
+ */
+int
+ephc_save (fn, mjd1, mjd2, msg)
+char *fn;
+double mjd1, mjd2;
+char msg[];
+{
+	FILE *fp;
+	int obj;
+
+	fp = fopen (fn, "w");
+	if (!fp) {
+	    sprintf (msg, "%s: %s", fn, strerror(errno));
+	    return (-1);
+	}
+
+	fprintf (fp, "%s %d %d %.6g\n", EPHCMAGIC, NCOEF, NQ,
+							raddeg(tol)*3600.0);
+	for (obj = 0; obj < NBODY; obj++) {
+	    long first = (long)floor(mjd1/ephc_span[obj]);
+	    long last = (long)floor(mjd2/ephc_span[obj]);
+	    long idx;
+	    EphSeg seg;
+
+	    fprintf (fp, "%d %.17g %ld %ld\n", obj, ephc_span[obj], first,
+								last-first+1);
+	    for (idx = first; idx <= last; idx++) {
+		ephc_fit (obj, idx, &seg);
+		if (fwrite (&seg, sizeof(seg), 1, fp) != 1) {
+		    sprintf (msg, "%s: %s", fn, strerror(errno));
+		    fclose (fp);
+		    return (-1);
+		}
+	    }
+	}
+
+	if (fclose (fp) < 0) {
+	    sprintf (msg, "%s: %s", fn, strerror(errno));
+	    return (-1);
+	}
+	return (0);
+}
+
+/* load segments saved with ephc_save() from the named file.
+ * the file's spans and tolerance replace the current ones.
+ * return 0 if ok, else -1 with excuse in msg[].
+ */
+int
+ephc_load (fn, msg)
+char *fn;
+char msg[];
+{
+	char line[128], magic[32];
+	int ncoef, nq, obj;
+	double arcsec;
+	FILE *fp;
+
+	fp = fopen (fn, "r");
+	if (!fp) {
+	    sprintf (msg, "%s: %s", fn, strerror(errno));
+	    return (-1);
+	}
+
+	/* N.B. use fgets for the text lines so no binary is skipped over */
+	if (!fgets (line, sizeof(line), fp)
+		|| sscanf (line, "%31s %d %d %lf", magic, &ncoef, &nq, &arcsec)!=4
+		|| strcmp (magic, EPHCMAGIC) || ncoef != NCOEF || nq != NQ) {
+	    sprintf (msg, "%s: not a compatible ephemeris cache file", fn);
+	    fclose (fp);
+	    return (-1);
+	}
+	ephc_settol (arcsec);
+
+	while (fgets (line, sizeof(line), fp)) {
+	    EphTable *tp;
+	    double span;
+	    long first, n;
+
+	    if (sscanf (line, "%d %lf %ld %ld", &obj, &span, &first, &n) != 4
+			|| obj < 0 || obj >= NBODY || span <= 0 || n < 0) {
+		sprintf (msg, "%s: bad body header", fn);
+		fclose (fp);
+		return (-1);
+	    }
+
+	    ephc_setspan (obj, span);
+	    tp = &tables[obj];
+	    tp->segs = (EphSeg *) malloc (n*sizeof(EphSeg) + 1);
+	    if (!tp->segs) {
+		sprintf (msg, "%s: no memory for %ld segments", fn, n);
+		fclose (fp);
+		return (-1);
+	    }
+	    if (fread (tp->segs, sizeof(EphSeg), n, fp) != n) {
+		sprintf (msg, "%s: short file", fn);
+		ephc_flush (obj);
+		fclose (fp);
+		return (-1);
+	    }
+	    tp->first = first;
+	    tp->nsegs = n;
+	}
+
+	fclose (fp);
+	return (0);
+}
+
+/* fill q[] for body obj at mjd from its segment, fitting it if necessary.
+ * return 0 if ok, -1 if the cache is off or the segment failed its check.
+ */
+static int
+ephc_get (obj, mjd, q)
+int obj;
+double mjd;
+double q[NQ];
+{
+	double span = ephc_span[obj];
+	long idx = (long)floor(mjd/span);
+	EphTable *tp = &tables[obj];
+	AstroCtx *cp = astro_cur();
+	EphSeg *sp;
+
+	if (!enabled)
+	    return (-1);
+
+	if (cp->eph.gen != ephc_gen) {
+	    memset (cp->eph.slots, 0, sizeof(cp->eph.slots));
+	    cp->eph.gen = ephc_gen;
+	}
+
+	if (tp->segs && idx >= tp->first && idx < tp->first + tp->nsegs)
+	    sp = &tp->segs[idx - tp->first];
+	else {
+	    sp = &cp->eph.slots[obj][idx & (NSLOT-1)];
+	    if (!sp->valid || sp->idx != idx)
+		ephc_fit (obj, idx, sp);
+	}
+
+	if (sp->valid < 0) {
+	    cp->eph.nmisses++;
+	    return (-1);
+	}
+
+	ephc_eval (sp, ephc_nq[obj], 2*(mjd - idx*span)/span - 1, q);
+	cp->eph.nhits++;
+	return (0);
+}
+
+/* fit segment idx of body obj into *sp and check it against the series */
+static void
+ephc_fit (obj, idx, sp)
+int obj;
+long idx;
+EphSeg *sp;
+{
+	double f[NCOEF][NQ];
+	double span = ephc_span[obj];
+	double t0 = idx*span;
+	int nq = ephc_nq[obj];
+	int wrap = ephc_wrap[obj];
+	int i, j, k;
+
+	/* sample at the Chebyshev nodes, earliest first, making angles
+	 * continuous from one node to the next.
+	 */
+	for (k = 0; k < NCOEF; k++) {
+	    double x = -cos(PI*(k+0.5)/NCOEF);
+
+	    ephc_series (obj, t0 + (x+1)*span/2, f[k]);
+	    if (k > 0)
+		for (i = 0; i < nq; i++)
+		    if (wrap & (1<<i))
+			f[k][i] += 2*PI*floor((f[k-1][i] - f[k][i])/(2*PI)+0.5);
+	}
+
+	/* find coefficients. node k is at x = cos(PI*(NCOEF-k-0.5)/NCOEF) */
+	for (i = 0; i < nq; i++) {
+	    for (j = 0; j < NCOEF; j++) {
+		double s = 0;
+		for (k = 0; k < NCOEF; k++)
+		    s += f[k][i]*cos(PI*j*(NCOEF-k-0.5)/NCOEF);
+		sp->c[i][j] = s*2/NCOEF;
+	    }
+	    sp->c[i][0] /= 2;
+	}
+	for (; i < NQ; i++)
+	    for (j = 0; j < NCOEF; j++)
+		sp->c[i][j] = 0;
+	sp->idx = idx;
+	sp->valid = 1;
+	astro_cur()->eph.nfits++;
+
+	/* check at both ends and midway between each pair of nodes */
+	for (k = 0; k <= NCOEF; k++) {
+	    double x = k == 0 ? -1 : (k == NCOEF ? 1
+		    : -(cos(PI*(k-0.5)/NCOEF) + cos(PI*(k+0.5)/NCOEF))/2);
+	    double qs[NQ], qc[NQ];
+
+	    ephc_series (obj, t0 + (x+1)*span/2, qs);
+	    ephc_eval (sp, nq, x, qc);
+	    for (i = 0; i < nq; i++) {
+		double d = qc[i] - qs[i];
+
+		if (wrap & (1<<i))
+		    d -= 2*PI*floor(d/(2*PI) + 0.5);
+		else if (i == 2)
+		    d /= qs[i];		/* distances are relative */
+		if (fabs(d) > tol) {
+		    sp->valid = -1;
+		    astro_cur()->eph.nrejects++;
+		    return;
+		}
+	    }
+	}
+}
+
+/* evaluate the full series for body obj at mjd */
+static void
+ephc_series (obj, mjd, q)
+int obj;
+double mjd;
+double q[NQ];
+{
+	double ret[6];
+
+	switch (obj) {
+	case SUN:
+	    vsop87 (mjd, SUN, 0.0, ret);	/* full precision earth pos */
+	    q[0] = ret[0] - PI;			/* revert to sun pos */
+	    q[1] = -ret[1];
+	    q[2] = ret[2];
+	    break;
+	case MOON:
+	    moon_series (mjd, &q[0], &q[1], &q[2], &q[3], &q[4]);
+	    break;
+	default:
+	    plan_series (mjd, obj, 0.0, ret);
+	    q[0] = ret[0];
+	    q[1] = ret[1];
+	    q[2] = ret[2];
+	    break;
+	}
+}
+
+/* evaluate the first nq polynomials of *sp at x, -1 .. 1, into q[] */
+static void
+ephc_eval (sp, nq, x, q)
+EphSeg *sp;
+int nq;
+double x;
+double q[NQ];
+{
+	int i, j;
+
+	for (i = 0; i < nq; i++) {
+	    double *c = sp->c[i];
+	    double b0 = 0, b1 = 0, b2;
+
+	    /* Clenshaw recurrence */
+	    for (j = NCOEF-1; j >= 1; j--) {
+		b2 = b1;
+		b1 = b0;
+		b0 = 2*x*b1 - b2 + c[j];
+	    }
+	    q[i] = x*b0 - b1 + c[0];
+	}
+}
+
+/* discard all fitted and loaded segments for body obj */
+static void
+ephc_flush (obj)
+int obj;
+{
+	EphTable *tp = &tables[obj];
+
+	ephc_gen++;
+	if (tp->segs)
+	    free ((void *)tp->segs);
+	tp->segs = NULL;
+	tp->nsegs = 0;
+}
@@ -3,6 +3,7 @@
 
 #include "P_.h"
 #include "astro.h"
+#include "astroctx.h"
 
 static void ecleq_aux P_((int sw, double mjd, double x, double y,
     double *p, double *q));
@@ -48,17 +49,20 @@ double mjd;
 double x, y;		/* sw==1: x==ra, y==dec.  sw==-1: x==lng, y==lat. */
 double *p, *q;		/* sw==1: p==lng, q==lat. sw==-1: p==ra, q==dec. */
 {
-	static double lastmjd = -10000;	/* last mjd calculated */
-	static double seps, ceps;	/* sin and cos of mean obliquity */
+	AstroCtx *cp = astro_cur();
+	double seps, ceps;		/* sin and cos of mean obliquity */
 	double sx, cx, sy, cy, ty;
 
-	if (mjd != lastmjd) {
+	if (!cp->ecl.valid || mjd != cp->ecl.lastmjd) {
 	    double eps;
 	    obliquity (mjd, &eps);		/* mean obliquity for date */
-    	    seps = sin(eps);
-	    ceps = cos(eps);
-	    lastmjd = mjd;
+    	    cp->ecl.seps = sin(eps);
+	    cp->ecl.ceps = cos(eps);
+	    cp->ecl.lastmjd = mjd;
+	    cp->ecl.valid = 1;
 	}
+	seps = cp->ecl.seps;
+	ceps = cp->ecl.ceps;
 
 	sy = sin(y);
 	cy = cos(y);				/* always non-negative */
@@ -16,6 +16,7 @@ extern double atof();
 #include "P_.h"
 #include "astro.h"
 #include "circum.h"
+#include "astroctx.h"
 
 /* zero from loc for len bytes */
 void
@@ -129,11 +130,11 @@ now_lst (np, lstp)
 Now *np;
 double *lstp;
 {
-	static double last_mjd = -23243, last_lng = 121212, last_lst;
+	AstroCtx *cp = astro_cur();
 	double eps, lst, deps, dpsi;
 
-	if (last_mjd == mjd && last_lng == lng) {
-	    *lstp = last_lst;
+	if (cp->lst.valid && cp->lst.lastmjd == mjd && cp->lst.lastlng == lng) {
+	    *lstp = cp->lst.lst;
 	    return;
 	}
 
@@ -146,9 +147,10 @@ double *lstp;
 
 	range (&lst, 24.0);
 
-	last_mjd = mjd;
-	last_lng = lng;
-	*lstp = last_lst = lst;
+	cp->lst.lastmjd = mjd;
+	cp->lst.lastlng = lng;
+	cp->lst.valid = 1;
+	*lstp = cp->lst.lst = lst;
 }
 
 /* convert ra to ha, in range -PI .. PI.
@@ -5,6 +5,7 @@
 
 #include "P_.h"
 #include "astro.h"
+#include "astroctx.h"
 
 /* given a date in months, mn, days, dy, years, yr,
  * return the modified Julian date (number of days elapsed since 1900 jan 0.5),
@@ -16,13 +17,13 @@ int mn, yr;
 double dy;
 double *mjd;
 {
-	static double last_mjd, last_dy;
-	static int last_mn, last_yr;
+	AstroCtx *cp = astro_cur();
 	int b, d, m, y;
 	long c;
 
-	if (mn == last_mn && yr == last_yr && dy == last_dy) {
-	    *mjd = last_mjd;
+	if (cp->cal.calvalid && mn == cp->cal.cm_mn && yr == cp->cal.cm_yr
+						&& dy == cp->cal.cm_dy) {
+	    *mjd = cp->cal.cm_mjd;
 	    return;
 	}
 
@@ -50,10 +51,11 @@ double *mjd;
 
 	*mjd = b + c + d + dy - 0.5;
 
-	last_mn = mn;
-	last_dy = dy;
-	last_yr = yr;
-	last_mjd = *mjd;
+	cp->cal.cm_mn = mn;
+	cp->cal.cm_dy = dy;
+	cp->cal.cm_yr = yr;
+	cp->cal.cm_mjd = *mjd;
+	cp->cal.calvalid = 1;
 }
 
 /* given the modified Julian date (number of days elapsed since 1900 jan 0.5,),
@@ -65,8 +67,7 @@ double mjd;
 int *mn, *yr;
 double *dy;
 {
-	static double last_mjd, last_dy;
-	static int last_mn, last_yr;
+	AstroCtx *cp = astro_cur();
 	double d, f;
 	double i, a, b, ce, g;
 
@@ -80,10 +81,10 @@ double *dy;
 	    return;
 	}
 
-	if (mjd == last_mjd) {
-	    *mn = last_mn;
-	    *yr = last_yr;
-	    *dy = last_dy;
+	if (cp->cal.mjdvalid && mjd == cp->cal.mc_mjd) {
+	    *mn = cp->cal.mc_mn;
+	    *yr = cp->cal.mc_yr;
+	    *dy = cp->cal.mc_dy;
 	    return;
 	}
 
@@ -114,10 +115,11 @@ double *dy;
 	if (*yr < 1)
 	    *yr -= 1;
 
-	last_mn = *mn;
-	last_dy = *dy;
-	last_yr = *yr;
-	last_mjd = mjd;
+	cp->cal.mc_mn = *mn;
+	cp->cal.mc_dy = *dy;
+	cp->cal.mc_yr = *yr;
+	cp->cal.mc_mjd = mjd;
+	cp->cal.mjdvalid = 1;
 }
 
 /* given an mjd, set *dow to 0..6 according to which day of the week it falls
@@ -191,13 +193,13 @@ mjd_year (mjd, yr)
 double mjd;
 double *yr;
 {
-	static double last_mjd, last_yr;
+	AstroCtx *cp = astro_cur();
 	int m, y;
 	double d;
 	double e0, e1;	/* mjd of start of this year, start of next year */
 
-	if (mjd == last_mjd) {
-	    *yr = last_yr;
+	if (cp->cal.yrvalid && mjd == cp->cal.my_mjd) {
+	    *yr = cp->cal.my_yr;
 	    return;
 	}
 
@@ -207,8 +209,9 @@ double *yr;
 	cal_mjd (1, 1.0, y+1, &e1);
 	*yr = y + (mjd - e0)/(e1 - e0);
 
-	last_mjd = mjd;
-	last_yr = *yr;
+	cp->cal.my_mjd = mjd;
+	cp->cal.my_yr = *yr;
+	cp->cal.yrvalid = 1;
 }
 
 /* given a decimal year, return mjd */
@@ -68,6 +68,7 @@ Sampling interval = 3.0 days
 
 #include "P_.h"
 #include "astro.h"
+#include "astroctx.h"
 
 #define CHAR short
 
@@ -100,19 +101,22 @@ static int gecmoon P_((double J, struct plantbl *lrtab,
 #define MOSHIER_END   (2798525.5 - MJD0) /* 2950.0; from libration table */
 
 
-static double Args[NARGS];
-static double LP_equinox;
-static double NF_arcsec;
-static double Ea_arcsec;
-static double pA_precession;
+/* scratch for one evaluation; no state survives between calls, so
+ * it is simply kept per thread.
+ */
+static ASTRO_TLS double Args[NARGS];
+static ASTRO_TLS double LP_equinox;
+static ASTRO_TLS double NF_arcsec;
+static ASTRO_TLS double Ea_arcsec;
+static ASTRO_TLS double pA_precession;
 
 
 /* This storage ought to be allocated dynamically.  */
-double ss[NARGS][30];
-double cc[NARGS][30];
+static ASTRO_TLS double ss[NARGS][30];
+static ASTRO_TLS double cc[NARGS][30];
 
 /* Time, in units of 10,000 Julian years from JED 2451545.0.  */
-static double T;
+static ASTRO_TLS double T;
 
 /* Conversion factors between degrees and radians */
 #define DTR 1.7453292519943295769e-2
@@ -3453,12 +3457,24 @@ double *msp, *mdp;
  *   further correct for parallax and refraction.
  * NB:  Do NOT correct for aberration - the geocentric moon frame moves
  *	along with the earth.
+ * served from the Chebyshev cache in ephcache.c when possible.
  */
 void
 moon (mjd, lam, bet, rho, msp, mdp)
 double mjd;
 double *lam, *bet, *rho;
 double *msp, *mdp;
+{
+	if (ephc_moon (mjd, lam, bet, rho, msp, mdp) < 0)
+	    moon_series (mjd, lam, bet, rho, msp, mdp);
+}
+
+/* same as moon() but always directly from the series */
+void
+moon_series (mjd, lam, bet, rho, msp, mdp)
+double mjd;
+double *lam, *bet, *rho;
+double *msp, *mdp;
 {
 	double pobj[3], dt;
 	double hp;
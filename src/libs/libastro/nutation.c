@@ -6,10 +6,11 @@
 
 #include "P_.h"
 #include "astro.h"
+#include "astroctx.h"
 
 #define NUT_SCALE	1e4
 #define NUT_SERIES	106
-#define NUT_MAXMUL	4
+#define NUT_MAXMUL	ACTX_NUTMUL
 #define SECPERCIRC	(3600.*360.)
 
 /* Delaunay arguments, in arc seconds; they differ slightly from ELP82B */
@@ -276,19 +277,20 @@ double mjd;
 double *deps;	/* on input:  precision parameter in arc seconds */
 double *dpsi;
 {
-	static double lastmjd = -10000, lastdeps, lastdpsi;
+	AstroCtx *cx = astro_cur();
+	double lastdeps, lastdpsi;
 	double T, T2, T3, T10;			/* jul cent since J2000 */
 	double prec;				/* series precis in arc sec */
 	int i, isecul;				/* index in term table */
-	static double delcache[5][2*NUT_MAXMUL+1];
+	double (*delcache)[2*NUT_MAXMUL+1] = cx->nut.delcache;
 			/* cache for multiples of delaunay args
 			 * [M',M,F,D,Om][-min*x, .. , 0, .., max*x]
-			 * make static to have unfilled fields cleared on init
+			 * kept in the context to have unfilled fields cleared
 			 */
 
-	if (mjd == lastmjd) {
-	    *deps = lastdeps;
-	    *dpsi = lastdpsi;
+	if (cx->nut.valid && mjd == cx->nut.lastmjd) {
+	    *deps = cx->nut.deps;
+	    *dpsi = cx->nut.dpsi;
 	    return;
 	}
 
@@ -361,7 +363,10 @@ double *dpsi;
 	lastdpsi = degrad(lastdpsi/3600./NUT_SCALE);
 	lastdeps = degrad(lastdeps/3600./NUT_SCALE);
 
-	lastmjd = mjd;
+	cx->nut.lastmjd = mjd;
+	cx->nut.deps = lastdeps;
+	cx->nut.dpsi = lastdpsi;
+	cx->nut.valid = 1;
 	*deps = lastdeps;
 	*dpsi = lastdpsi;
 }
@@ -373,11 +378,11 @@ void
 nut_eq (mjd, ra, dec)
 double mjd, *ra, *dec;
 {
-	static double lastmjd = -10000;
-	static double a[3][3];		/* rotation matrix */
+	AstroCtx *cx = astro_cur();
+	double (*a)[3] = cx->nut.a;	/* rotation matrix */
 	double xold, yold, zold, x, y, z;
 
-	if (mjd != lastmjd) {
+	if (!cx->nut.eqvalid || mjd != cx->nut.eqmjd) {
 	    double epsilon, dpsi, deps;
 	    double se, ce, sp, cp, sede, cede;
 
@@ -427,7 +432,8 @@ double mjd, *ra, *dec;
 	    a[2][1] = sede*cp*ce-cede*se;
 	    a[2][2] = sede*cp*se+cede*ce;
 
-	    lastmjd = mjd;
+	    cx->nut.eqmjd = mjd;
+	    cx->nut.eqvalid = 1;
 	}
 
 	sphcart(*ra, *dec, 1.0, &xold, &yold, &zold);
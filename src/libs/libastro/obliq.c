@@ -2,6 +2,7 @@
 
 #include "P_.h"
 #include "astro.h"
+#include "astroctx.h"
 
 /* given the modified Julian date, mjd, find the mean obliquity of the
  * ecliptic, *eps, in radians.
@@ -13,15 +14,16 @@ obliquity (mjd, eps)
 double mjd;
 double *eps;
 {
-	static double lastmjd = -16347, lasteps;
+	AstroCtx *cp = astro_cur();
 
-	if (mjd != lastmjd) {
+	if (!cp->obl.valid || mjd != cp->obl.lastmjd) {
 	    double t = (mjd - J2000)/36525.;	/* centuries from J2000 */
-	    lasteps = degrad(23.4392911 +	/* 23^ 26' 21".448 */
+	    cp->obl.eps = degrad(23.4392911 +	/* 23^ 26' 21".448 */
 			    t * (-46.8150 +
 			    t * ( -0.00059 +
 			    t * (  0.001813 )))/3600.0);
-	    lastmjd = mjd;
+	    cp->obl.lastmjd = mjd;
+	    cp->obl.valid = 1;
 	}
-	*eps = lasteps;
+	*eps = cp->obl.eps;
 }
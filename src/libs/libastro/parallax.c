@@ -3,6 +3,7 @@
 
 #include "P_.h"
 #include "astro.h"
+#include "astroctx.h"
 
 
 /* given true ha and dec, tha and tdec, the geographical latitude, phi, the
@@ -17,25 +18,26 @@ ta_par (tha, tdec, phi, ht, rho, aha, adec)
 double tha, tdec, phi, ht, *rho;
 double *aha, *adec;
 {
-	static double last_phi = 1000.0, last_ht = -1000.0, xobs, zobs;
+	AstroCtx *cp = astro_cur();
 	double x, y, z;	/* obj cartesian coord, in Earth radii */
 
 	/* avoid calcs involving the same phi and ht */
-	if (phi != last_phi || ht != last_ht) {
+	if (!cp->par.valid || phi != cp->par.phi || ht != cp->par.ht) {
 	    double cphi, sphi, robs, e2 = (2 - 1/298.257)/298.257;
 	    cphi = cos(phi);
 	    sphi = sin(phi);
 	    robs = 1/sqrt(1 - e2 * sphi * sphi);
 
 	    /* observer coordinates: x to meridian, y east, z north */
-	    xobs = (robs + ht) * cphi;
-	    zobs = (robs*(1-e2) + ht) * sphi;
-	    last_phi  =  phi;
-	    last_ht  =  ht;
+	    cp->par.xobs = (robs + ht) * cphi;
+	    cp->par.zobs = (robs*(1-e2) + ht) * sphi;
+	    cp->par.phi  =  phi;
+	    cp->par.ht  =  ht;
+	    cp->par.valid = 1;
 	}
 
 	sphcart(-tha, tdec, *rho, &x, &y, &z);
-	cartsph(x - xobs, y, z - zobs, aha, adec, rho);
+	cartsph(x - cp->par.xobs, y, z - cp->par.zobs, aha, adec, rho);
 	*aha *= -1;
 	range (aha, 2*PI);
 }
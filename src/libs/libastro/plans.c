@@ -6,12 +6,13 @@
 
 #include "P_.h"
 #include "astro.h"
+#include "astroctx.h"
 #include "vsop87.h"
 #include "chap95.h"
 
 static void pluto_ell P_((double mjd, double *ret));
 static void chap_trans P_((double mjd, double *ret));
-static void planpos P_((double mjd, int obj, double prec, double *ret));
+static void planpos P_((double mjd, int obj, double *ret));
 
 /* coordinate transformation
  * from:
@@ -77,10 +78,23 @@ double *ret;	/* ecliptic coordinates {l,b,r} at equinox of date */
 /*************************************************************/
 
 /* geometric heliocentric position of planet, mean ecliptic of date
- * (not corrected for light-time)
+ * (not corrected for light-time), from the Chebyshev cache if possible.
  */
 static void
-planpos (mjd, obj, prec, ret)
+planpos (mjd, obj, ret)
+double mjd;
+int obj;
+double *ret;
+{
+	if (ephc_planet (mjd, obj, ret) < 0)
+	    plan_series (mjd, obj, 0.0, ret);
+}
+
+/* geometric heliocentric position of planet, mean ecliptic of date
+ * (not corrected for light-time), directly from the series.
+ */
+void
+plan_series (mjd, obj, prec, ret)
 double mjd;
 int obj;
 double prec;
@@ -146,20 +160,24 @@ double mjd;
 int p;
 double *lpd0, *psi0, *rp0, *rho0, *lam, *bet, *dia, *mag;
 {
-	static double lastmjd = -10000;
-	static double lsn, bsn, rsn;	/* geometric geocentric coords of sun */
-	static double xsn, ysn, zsn;
+	AstroCtx *cp = astro_cur();
+	double xsn, ysn, zsn;		/* geometric geocentric sun, rect. */
 	double lp, bp, rp;		/* heliocentric coords of planet */
 	double xp, yp, zp, rho;		/* rect. coords and geocentric dist. */
 	double dt;			/* light time */
 	int pass;
 
 	/* get sun cartesian; needed only once at mjd */
-	if (mjd != lastmjd) {
-	    sunpos (mjd, &lsn, &rsn, &bsn);
-	    sphcart (lsn, bsn, rsn, &xsn, &ysn, &zsn);
-            lastmjd = mjd;
+	if (!cp->pl.valid || mjd != cp->pl.lastmjd) {
+	    sunpos (mjd, &cp->pl.lsn, &cp->pl.rsn, &cp->pl.bsn);
+	    sphcart (cp->pl.lsn, cp->pl.bsn, cp->pl.rsn,
+					&cp->pl.xsn, &cp->pl.ysn, &cp->pl.zsn);
+            cp->pl.lastmjd = mjd;
+	    cp->pl.valid = 1;
         }
+	xsn = cp->pl.xsn;
+	ysn = cp->pl.ysn;
+	zsn = cp->pl.zsn;
 
 	/* first find the true position of the planet at mjd.
 	 * then repeat a second time for a slightly different time based
@@ -174,7 +192,7 @@ double *lpd0, *psi0, *rp0, *rho0, *lam, *bet, *dia, *mag;
 	     * retarded for light time in second pass;
 	     * alternative option:  vsop allows calculating rates.
 	     */
-	    planpos(mjd - dt, p, 0.0, ret);
+	    planpos(mjd - dt, p, ret);
 
 	    lp = ret[0];
 	    bp = ret[1];
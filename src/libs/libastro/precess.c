@@ -3,6 +3,7 @@
 
 #include "P_.h"
 #include "astro.h"
+#include "astroctx.h"
 
 static void precess_hiprec P_((double mjd1, double mjd2, double *ra,
     double *dec));
@@ -45,8 +46,7 @@ precess_hiprec (mjd1, mjd2, ra, dec)
 double mjd1, mjd2;	/* initial and final epoch modified JDs */
 double *ra, *dec;	/* ra/dec for mjd1 in, for mjd2 out */
 {
-	static double last_mjd1 = -213.432, last_from;
-	static double last_mjd2 = -213.432, last_to;
+	AstroCtx *cp = astro_cur();
 	double zeta_A, z_A, theta_A;
 	double T;
 	double A, B, C;
@@ -58,19 +58,21 @@ double *ra, *dec;	/* ra/dec for mjd1 in, for mjd2 out */
 	/* convert mjds to years;
 	 * avoid the remarkably expensive calls to mjd_year()
 	 */
-	if (last_mjd1 == mjd1)
-	    from_equinox = last_from;
+	if (cp->pre.valid1 && cp->pre.mjd1 == mjd1)
+	    from_equinox = cp->pre.from;
 	else {
 	    mjd_year (mjd1, &from_equinox);
-	    last_mjd1 = mjd1;
-	    last_from = from_equinox;
+	    cp->pre.mjd1 = mjd1;
+	    cp->pre.from = from_equinox;
+	    cp->pre.valid1 = 1;
 	}
-	if (last_mjd2 == mjd2)
-	    to_equinox = last_to;
+	if (cp->pre.valid2 && cp->pre.mjd2 == mjd2)
+	    to_equinox = cp->pre.to;
 	else {
 	    mjd_year (mjd2, &to_equinox);
-	    last_mjd2 = mjd2;
-	    last_to = to_equinox;
+	    cp->pre.mjd2 = mjd2;
+	    cp->pre.to = to_equinox;
+	    cp->pre.valid2 = 1;
 	}
 
 	/* convert coords in rads to degs */
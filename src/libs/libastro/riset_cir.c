@@ -2,6 +2,8 @@
 
 #include <stdio.h>
 #include <math.h>
+#include <unistd.h>
+#include <pthread.h>
 #if defined(__STDC__)
 #include <stdlib.h>
 #include <string.h>
@@ -10,6 +12,7 @@
 #include "P_.h"
 #include "astro.h"
 #include "circum.h"
+#include "astroctx.h"
 
 #define	TMACC	(10./3600./24.0)	/* convergence accuracy, days */
 
@@ -19,6 +22,59 @@ static int find_transit P_((double dt, Now *np, Obj *op));
 static int find_max P_((Now *np, Obj *op, double tr, double ts, double *tp,
     double *alp));
 
+/* one share of a riset_cir_batch() */
+typedef struct {
+    Now *np;		/* the day, as for riset_cir() */
+    Obj **ops;		/* objects */
+    RiseSet *rps;	/* answers */
+    int n;		/* n ops[] and rps[] */
+    double dis;		/* as for riset_cir() */
+    int done;		/* set when rps[] are filled */
+} RSBatch;
+
+/* working state per object in a batch. positions are kept as quadratics in
+ * days from local noon fit to the geocentric apparent place at noon and
+ * noon +/- 12 hours. the grid search remembers the crossing nearest the
+ * time riset_cir() would start its own search from.
+ */
+typedef struct {
+    double ra[3], dec[3];	/* quadratic coefficients, rads */
+    double gr, gs, gt;		/* riset_cir() starting guesses, days */
+    double tr, ts, tt;		/* best crossings found, days, or NOGRID */
+    double f, s;		/* alt function and sin(ha) at last grid time */
+    int rss;			/* riset() status at noon */
+    int active;			/* still in the grid search */
+    int edge;			/* a crossing is near either end of the day */
+} RSObj;
+
+#define	NGRID	48		/* grid steps across the day */
+#define	NOGRID	99.0		/* marks no crossing found */
+#define	RSB_EDGE	0.01	/* days from ends of day left to riset_cir() */
+#define	RSB_MINPER	64	/* fewest objects worth a thread */
+#define	RSB_MAXTHR	64	/* most threads */
+
+static void rsb_chunk P_((RSBatch *bp));
+static void *rsb_thread P_((void *arg));
+static void rsb_pos P_((RSObj *rp, double t, double *ra, double *dec));
+static double rsb_wrap P_((double a));
+
+/* same as riset_cir() but using the caches in cp. safe to call from several
+ * threads at once provided each uses its own cp.
+ */
+void
+riset_cir_r (cp, np, op, dis, rp)
+AstroCtx *cp;
+Now *np;
+Obj *op;
+double dis;
+RiseSet *rp;
+{
+	AstroCtx *was = astro_use (cp);
+
+	riset_cir (np, op, dis, rp);
+	(void) astro_use (was);
+}
+
 /* find where and when an object, op, will rise and set and
  *   it's transit circumstances. all times are utc mjd, angles rads e of n.
  * dis is the angle down from an ideal horizon, in rads (see riset()).
@@ -382,3 +438,371 @@ double *tp, *alp;	/* time of max altitude, and that altitude */
 	*alp = op->s_alt;
 	return (0);
 }
+
+/* find rise, set and transit circumstances for each of nop objects, ops[],
+ *   for the same day and horizon riset_cir() would use with np and dis, and
+ *   put them in rps[].
+ * the work which depends only on time is shared: positions of each object are
+ *   found at just three times, altitudes are scanned on a common time grid
+ *   for all objects at once, and only the crossings found are refined. fixed
+ *   objects are refined from the same model, others with obj_cir() just as
+ *   riset_cir() does. earth satellites and any object whose events the grid
+ *   can not place are simply handed to riset_cir().
+ * the objects are shared among nthr threads, each with its own AstroCtx, or
+ *   as many as there are processors if nthr is 0.
+ */
+void
+riset_cir_batch (np, ops, nop, dis, rps, nthr)
+Now *np;
+Obj *ops[];
+int nop;
+double dis;
+RiseSet rps[];
+int nthr;
+{
+	RSBatch b[RSB_MAXTHR];
+	pthread_t tid[RSB_MAXTHR];
+	int started[RSB_MAXTHR];
+	int i, n0;
+
+	if (nthr <= 0)
+	    nthr = (int) sysconf (_SC_NPROCESSORS_ONLN);
+	if (nthr > nop/RSB_MINPER)
+	    nthr = nop/RSB_MINPER;
+	if (nthr > RSB_MAXTHR)
+	    nthr = RSB_MAXTHR;
+	if (nthr < 1)
+	    nthr = 1;
+
+	/* split into nthr nearly equal shares */
+	for (n0 = i = 0; i < nthr; i++) {
+	    int n = nop/nthr + (i < nop%nthr);
+
+	    b[i].np = np;
+	    b[i].ops = ops + n0;
+	    b[i].rps = rps + n0;
+	    b[i].n = n;
+	    b[i].dis = dis;
+	    b[i].done = 0;
+	    n0 += n;
+	}
+
+	/* just do it here if one share */
+	if (nthr == 1) {
+	    rsb_chunk (&b[0]);
+	    return;
+	}
+
+	for (i = 0; i < nthr; i++)
+	    started[i] = !pthread_create (&tid[i], NULL, rsb_thread,
+								(void *)&b[i]);
+	for (i = 0; i < nthr; i++)
+	    if (started[i])
+		pthread_join (tid[i], NULL);
+
+	/* mop up any share a thread could not do */
+	for (i = 0; i < nthr; i++)
+	    if (!b[i].done)
+		rsb_chunk (&b[i]);
+}
+
+/* thread to perform one share of a batch with a private context */
+static void *
+rsb_thread (arg)
+void *arg;
+{
+	RSBatch *bp = (RSBatch *)arg;
+	AstroCtx *cp = astro_ctx_new();
+	AstroCtx *was;
+
+	if (!cp)
+	    return (NULL);
+	was = astro_use (cp);
+	rsb_chunk (bp);
+	(void) astro_use (was);
+	astro_ctx_free (cp);
+	return (NULL);
+}
+
+/* perform one share of a batch in the current context */
+static void
+rsb_chunk (bp)
+RSBatch *bp;
+{
+	static double anch[3] = {0.0, -0.5, 0.5};	/* noon first */
+	Now n, *np = &n;	/* working copy, n_mjd moves around */
+	Obj o;			/* working copy of each object */
+	RSObj *rsp;
+	double mjdn;		/* mjd of local noon */
+	double lstn;		/* lst at local noon, rads */
+	double slat, clat;	/* sin and cos of latitude */
+	double sht;		/* sin of true altitude at the event */
+	double ht;
+	double rate = 2*PI/SIDRATE;	/* ha rads per day */
+	int i, a, k;
+
+	(void) memcpy ((void *)&n, (void *)bp->np, sizeof(n));
+
+	rsp = (RSObj *) malloc (bp->n * sizeof(RSObj) + 1);
+	if (!rsp) {
+	    for (i = 0; i < bp->n; i++)
+		riset_cir (bp->np, bp->ops[i], bp->dis, &bp->rps[i]);
+	    bp->done = 1;
+	    return;
+	}
+
+	/* same day as riset_cir() */
+	mjdn = mjd_day(mjd - tz/24.0) + tz/24.0 + 0.5;
+	mjd = mjdn;
+	now_lst (np, &lstn);
+	lstn = hrrad(lstn);
+	slat = sin(lat);
+	clat = cos(lat);
+	unrefract (pressure, temp, -bp->dis, &ht);
+	sht = sin(ht);
+
+	/* positions of every object at each anchor time in turn, so each
+	 * time-dependent step is computed once per anchor, not per object.
+	 * satellites go straight to riset_cir().
+	 */
+	for (i = 0; i < bp->n; i++) {
+	    rsp[i].active = bp->ops[i]->o_type != EARTHSAT;
+	    if (!rsp[i].active)
+		riset_cir (bp->np, bp->ops[i], bp->dis, &bp->rps[i]);
+	}
+	for (a = 0; a < 3; a++) {
+	    mjd = mjdn + anch[a];
+	    for (i = 0; i < bp->n; i++) {
+		RSObj *rp = &rsp[i];
+		RiseSet *rsetp = &bp->rps[i];
+
+		if (!rp->active)
+		    continue;
+		(void) memcpy ((void *)&o, (void *)bp->ops[i], sizeof(o));
+		if (obj_cir (np, &o) < 0) {
+		    rsetp->rs_flags = RS_ERROR;
+		    rp->active = 0;
+		    continue;
+		}
+		rp->ra[a] = o.s_gaera;
+		rp->dec[a] = o.s_gaedec;
+
+		/* same go/no-go and starting guesses as riset_cir() */
+		if (a == 0) {
+		    double lr, ls, ar, as;
+
+		    riset (o.s_gaera, o.s_gaedec, lat, bp->dis+.01, &lr, &ls,
+							&ar, &as, &rp->rss);
+		    rsetp->rs_flags = 0;
+		    switch (rp->rss) {
+		    case  0: break;
+		    case -1: rsetp->rs_flags = RS_CIRCUMPOLAR; break;
+		    case  1: rsetp->rs_flags = RS_NEVERUP; rp->active = 0; break;
+		    default: rsetp->rs_flags = RS_ERROR; rp->active = 0; break;
+		    }
+		    rp->gr = rsb_wrap (hrrad(lr) - lstn)/rate;
+		    rp->gs = rsb_wrap (hrrad(ls) - lstn)/rate;
+		    rp->gt = rsb_wrap ((double)o.s_gaera - lstn)/rate;
+		    rp->tr = rp->ts = rp->tt = NOGRID;
+		    rp->edge = 0;
+		}
+	    }
+	}
+
+	/* turn samples at 0, -.5, +.5 days into a + b*t + c*t*t */
+	for (i = 0; i < bp->n; i++) {
+	    RSObj *rp = &rsp[i];
+	    double *q;
+
+	    if (!rp->active)
+		continue;
+	    rp->ra[1] = rp->ra[0] + rsb_wrap (rp->ra[1] - rp->ra[0]);
+	    rp->ra[2] = rp->ra[0] + rsb_wrap (rp->ra[2] - rp->ra[0]);
+	    for (q = rp->ra; q; q = (q == rp->ra) ? rp->dec : NULL) {
+		double f0 = q[0], fm = q[1], fp = q[2];
+		q[1] = fp - fm;
+		q[2] = 2*(fp + fm - 2*f0);
+	    }
+	}
+
+	/* scan everything across the day together, noting the crossings of
+	 * the horizon and meridian nearest each starting guess.
+	 */
+	for (k = 0; k <= NGRID; k++) {
+	    double t = -0.5 + (double)k/NGRID;
+	    double lst = lstn + t*rate;
+
+	    for (i = 0; i < bp->n; i++) {
+		RSObj *rp = &rsp[i];
+		double ra, dec, ha, f, s, c, tc;
+
+		if (!rp->active)
+		    continue;
+		rsb_pos (rp, t, &ra, &dec);
+		ha = lst - ra;
+		s = sin(ha);
+		c = cos(ha);
+		f = slat*sin(dec) + clat*cos(dec)*c - sht;
+
+		if (k > 0) {
+		    double h = 1.0/NGRID;
+
+		    if (rp->f < 0 && f >= 0) {
+			tc = t - h + h*rp->f/(rp->f - f);
+			if (fabs(tc - rp->gr) < fabs(rp->tr - rp->gr))
+			    rp->tr = tc;
+			rp->edge |= fabs(tc) > 0.5 - RSB_EDGE;
+		    } else if (rp->f >= 0 && f < 0) {
+			tc = t - h + h*rp->f/(rp->f - f);
+			if (fabs(tc - rp->gs) < fabs(rp->ts - rp->gs))
+			    rp->ts = tc;
+			rp->edge |= fabs(tc) > 0.5 - RSB_EDGE;
+		    }
+		    if (rp->s < 0 && s >= 0 && c > 0) {
+			tc = t - h + h*rp->s/(rp->s - s);
+			if (fabs(tc - rp->gt) < fabs(rp->tt - rp->gt))
+			    rp->tt = tc;
+			rp->edge |= fabs(tc) > 0.5 - RSB_EDGE;
+		    }
+		}
+		rp->f = f;
+		rp->s = s;
+	    }
+	}
+
+	/* refine each crossing found */
+	for (i = 0; i < bp->n; i++) {
+	    RSObj *rp = &rsp[i];
+	    RiseSet *rsetp = &bp->rps[i];
+	    int updown = rp->rss == 0;
+	    int j;
+
+	    if (!rp->active)
+		continue;
+
+	    /* hand over anything the grid could not place, or where an event
+	     * may fall either end of the day and riset_cir() decides which.
+	     */
+	    if (rp->edge || rp->tt == NOGRID || (updown && (rp->tr == NOGRID
+							|| rp->ts == NOGRID))) {
+		riset_cir (bp->np, bp->ops[i], bp->dis, rsetp);
+		continue;
+	    }
+
+	    if (bp->ops[i]->o_type == FIXED) {
+		/* fixed objects barely move: solve the model directly */
+		double t, ra, dec, ha, alt, az;
+
+		for (j = 0; updown && j < 2; j++) {
+		    t = j ? rp->ts : rp->tr;
+		    for (k = 0; k < 4; k++) {
+			double ch, dt;
+
+			rsb_pos (rp, t, &ra, &dec);
+			ch = (sht - slat*sin(dec))/(clat*cos(dec));
+			if (ch < -1 || ch > 1)
+			    break;
+			ha = rsb_wrap (lstn + t*rate - ra);
+			dt = rsb_wrap ((j ? acos(ch) : -acos(ch)) - ha)/rate;
+			t += dt;
+			if (fabs(dt) < TMACC/100)
+			    break;
+		    }
+		    rsb_pos (rp, t, &ra, &dec);
+		    hadec_aa (lat, lstn + t*rate - ra, dec, &alt, &az);
+		    if (fabs(t) >= 0.5)
+			rsetp->rs_flags |= j ? RS_NOSET : RS_NORISE;
+		    else if (j) {
+			rsetp->rs_settm = mjdn + t;
+			rsetp->rs_setaz = az;
+		    } else {
+			rsetp->rs_risetm = mjdn + t;
+			rsetp->rs_riseaz = az;
+		    }
+		}
+
+		t = rp->tt;
+		for (k = 0; k < 4; k++) {
+		    double dt;
+
+		    rsb_pos (rp, t, &ra, &dec);
+		    dt = -rsb_wrap (lstn + t*rate - ra)/rate;
+		    t += dt;
+		    if (fabs(dt) < TMACC/100)
+			break;
+		}
+		rsb_pos (rp, t, &ra, &dec);
+		hadec_aa (lat, lstn + t*rate - ra, dec, &alt, &az);
+		refract (pressure, temp, alt, &alt);
+		if (fabs(t) >= 0.5)
+		    rsetp->rs_flags |= RS_NOTRANS;
+		else {
+		    rsetp->rs_trantm = mjdn + t;
+		    rsetp->rs_tranalt = alt;
+		}
+		continue;
+	    }
+
+	    /* others finish with the real circumstances, starting close */
+	    for (j = 0; updown && j < 2; j++) {
+		mjd = mjdn;
+		(void) memcpy ((void *)&o, (void *)bp->ops[i], sizeof(o));
+		switch (find_0alt ((j ? rp->ts : rp->tr)*24.0, bp->dis, np, &o)){
+		case 0: /* ok */
+		    if (j) {
+			rsetp->rs_settm = mjd;
+			rsetp->rs_setaz = o.s_az;
+		    } else {
+			rsetp->rs_risetm = mjd;
+			rsetp->rs_riseaz = o.s_az;
+		    }
+		    break;
+		case -1: /* obj_cir error */
+		    rsetp->rs_flags |= j ? RS_SETERR : RS_RISERR;
+		    break;
+		case -2: /* converged but not today */ /* FALLTHRU */
+		case -3: /* probably circumpolar or never up */
+		    rsetp->rs_flags |= j ? RS_NOSET : RS_NORISE;
+		    break;
+		}
+	    }
+
+	    mjd = mjdn;
+	    (void) memcpy ((void *)&o, (void *)bp->ops[i], sizeof(o));
+	    switch (find_transit (rp->tt*24.0, np, &o)) {
+	    case 0: /* ok */
+		rsetp->rs_trantm = mjd;
+		rsetp->rs_tranalt = o.s_alt;
+		break;
+	    case -1: /* did not converge */
+		rsetp->rs_flags |= RS_TRANSERR;
+		break;
+	    case -2: /* converged but not today */
+		rsetp->rs_flags |= RS_NOTRANS;
+		break;
+	    }
+	}
+
+	free ((void *)rsp);
+	bp->done = 1;
+}
+
+/* find the modeled ra and dec of rp at t days from noon */
+static void
+rsb_pos (rp, t, ra, dec)
+RSObj *rp;
+double t;
+double *ra, *dec;
+{
+	*ra = rp->ra[0] + t*(rp->ra[1] + t*rp->ra[2]);
+	*dec = rp->dec[0] + t*(rp->dec[1] + t*rp->dec[2]);
+}
+
+/* return angle a wrapped into -PI .. PI */
+static double
+rsb_wrap (a)
+double a;
+{
+	a -= 2*PI*floor(a/(2*PI) + 0.5);
+	return (a);
+}
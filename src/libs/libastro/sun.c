@@ -3,6 +3,7 @@
 
 #include "P_.h"
 #include "astro.h"
+#include "astroctx.h"
 #include "vsop87.h"
 
 /* given the modified JD, mjd, return the true geocentric ecliptic longitude
@@ -20,25 +21,29 @@ sunpos (mjd, lsn, rsn, bsn)
 double mjd;
 double *lsn, *rsn, *bsn;
 {
-	static double last_mjd = -3691, last_lsn, last_rsn, last_bsn;
+	AstroCtx *cp = astro_cur();
 	double ret[6];
 
-	if (mjd == last_mjd) {
-	    *lsn = last_lsn;
-	    *rsn = last_rsn;
-	    if (bsn) *bsn = last_bsn;
+	if (cp->sun.valid && mjd == cp->sun.lastmjd) {
+	    *lsn = cp->sun.lsn;
+	    *rsn = cp->sun.rsn;
+	    if (bsn) *bsn = cp->sun.bsn;
 	    return;
 	}
 
-	vsop87(mjd, SUN, 0.0, ret);	/* full precision earth pos */
+	if (ephc_sun (mjd, &cp->sun.lsn, &cp->sun.rsn, &cp->sun.bsn) < 0) {
+	    vsop87(mjd, SUN, 0.0, ret);	/* full precision earth pos */
 
-	*lsn = ret[0] - PI;		/* revert to sun pos */
-	range (lsn, 2*PI);		/* normalise */
+	    cp->sun.lsn = ret[0] - PI;	/* revert to sun pos */
+	    range (&cp->sun.lsn, 2*PI);	/* normalise */
+	    cp->sun.rsn = ret[2];
+	    cp->sun.bsn = -ret[1];
+	}
 
-	last_lsn = *lsn;		/* memorise */
-	last_rsn = *rsn = ret[2];
-	last_bsn = -ret[1];
-	last_mjd = mjd;
+	*lsn = cp->sun.lsn;		/* memorise */
+	*rsn = cp->sun.rsn;
+	cp->sun.lastmjd = mjd;
+	cp->sun.valid = 1;
 
-	if (bsn) *bsn = last_bsn;	/* assign only if non-NULL pointer */
+	if (bsn) *bsn = cp->sun.bsn;	/* assign only if non-NULL pointer */
 }
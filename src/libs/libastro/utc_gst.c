@@ -1,5 +1,6 @@
 #include "P_.h"
 #include "astro.h"
+#include "astroctx.h"
 
 static double gmst0 P_((double mjd));
 
@@ -13,14 +14,14 @@ double mjd;
 double utc;
 double *gst;
 {
-	static double lastmjd = -18981;
-	static double t0;
+	AstroCtx *cp = astro_cur();
 
-	if (mjd != lastmjd) {
-	    t0 = gmst0(mjd);
-	    lastmjd = mjd;
+	if (!cp->gst.gvalid || mjd != cp->gst.gmjd) {
+	    cp->gst.gt0 = gmst0(mjd);
+	    cp->gst.gmjd = mjd;
+	    cp->gst.gvalid = 1;
 	}
-	*gst = (1.0/SIDRATE)*utc + t0;
+	*gst = (1.0/SIDRATE)*utc + cp->gst.gt0;
 	range (gst, 24.0);
 }
 
@@ -34,14 +35,14 @@ double mjd;
 double gst;
 double *utc;
 {
-	static double lastmjd = -10000;
-	static double t0;
+	AstroCtx *cp = astro_cur();
 
-	if (mjd != lastmjd) {
-	    t0 = gmst0 (mjd);
-	    lastmjd = mjd;
+	if (!cp->gst.uvalid || mjd != cp->gst.umjd) {
+	    cp->gst.ut0 = gmst0 (mjd);
+	    cp->gst.umjd = mjd;
+	    cp->gst.uvalid = 1;
 	}
-	*utc = gst - t0;
+	*utc = gst - cp->gst.ut0;
 	range (utc, 24.0);
 	*utc *= SIDRATE;
 }
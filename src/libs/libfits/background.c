@@ -0,0 +1,791 @@
+/* model the sky background of an image as a smooth surface.
+ *
+ * bgMeasure() cuts the image into tiles and finds the sky of each by
+ * iterative sigma clipping about the median, so stars and cosmic rays do not
+ * pull it up, then median filters the grid of tile values to drop tiles
+ * spoiled by bright stars or nebulosity. the grid is then made into a
+ * surface one of two ways:
+ *   bgFitPoly() solves directly for the order-n 2-d polynomial of (n+1)^2
+ *     terms which best fits the tiles, with linlsq();
+ *   bgFitSpline() passes a natural bicubic spline through them, for skies
+ *     too lumpy for a low order polynomial.
+ * until then the tiles are just interpolated bilinearly.
+ *
+ * bgRow() evaluates one row of the surface. the y part of each term is folded
+ * once per row, leaving a short Horner polynomial or one spline segment per
+ * tile in x, which the inner loops run over contiguous floats so the compiler
+ * may vectorize them. bgEvaluate() fills a whole map using several threads,
+ * each taking the next band of rows.
+ *
+ * useBgMap() notes a map so findStars() takes its detection threshold from its
+ * sky and noise, rather than from its own coarse grid of noise boxes.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "P_.h"
+#include "astro.h"
+#include "fits.h"
+#include "lstsqr.h"
+
+#define	BGTILE		64	/* default tile size, pixels */
+#define	BGMINTILE	4	/* smallest tile we can get good stats from */
+#define	BGKSIG		3.0	/* clip beyond this many sd */
+#define	BGMAXCLIP	5	/* max clipping passes per tile */
+#define	BGMAXORDER	10	/* max polynomial order */
+#define	BGBAND		32	/* rows per bgEvaluate() work unit */
+#define	MAXTHR		64	/* max worker threads */
+#define	MADSD		1.4826	/* sd/MAD of a gaussian */
+#define	FILTSIG		1.0	/* filter tiles off by this many sd */
+
+/* pixel x and y of the center of tile k of bp */
+#define	TILEX(bp,k)	((bp)->x0 + ((k)%(bp)->nx + .5)*(bp)->tw - .5)
+#define	TILEY(bp,k)	((bp)->y0 + ((k)/(bp)->nx + .5)*(bp)->th - .5)
+
+/* whether tile row i, column j is within the grid of bp */
+#define	INGRID(bp,i,j)	((i) >= 0 && (i) < (bp)->ny && (j) >= 0 && (j) < (bp)->nx)
+
+/* per-thread working space for evaluating rows */
+typedef struct {
+    float *u;			/* w normalized x, for BG_POLY */
+    float *c;			/* order+1 x coefficients of this row */
+    double *f, *d2, *t;		/* knot values, their d2 and scratch */
+} BgTmp;
+
+/* shared by the bgEvaluate() workers */
+typedef struct {
+    BgMap *bp;			/* map to fill */
+    int next;			/* first row of next band */
+    int err;			/* set if a worker ran out of memory */
+    pthread_mutex_t lock;	/* guards next and err */
+} BgJob;
+
+static int tileStats (CamPixel *im, int w, int x0, int y0, int tw, int th,
+    float buf[], float tmp[], float *skyp, float *sigp);
+static float selectk (float v[], int n, int k);
+static void filterTiles (BgMap *bp);
+static int fitPoly (BgMap *bp, int order, int use[]);
+static double polyAt (BgMap *bp, double x, double y);
+static void splineD2 (double f[], int n, double d2[], double t[]);
+static double splineSlope (double f[], double d2[], int n, int right);
+static double splineAt (double f[], double d2[], int n, double t);
+static double linearAt (float f[], int stride, int n, double t);
+static void knotRow (BgMap *bp, double f[], double d2[], int ext, float row[]);
+static int tmpAlloc (BgMap *bp, BgTmp *tp);
+static void tmpFree (BgTmp *tp);
+static void evalRow (BgMap *bp, int y, BgTmp *tp, float row[]);
+static void *evalWorker (void *arg);
+
+static BgMap *bginuse;		/* map noted by useBgMap() */
+static pthread_mutex_t bglock = PTHREAD_MUTEX_INITIALIZER;
+
+/* measure the sky in a grid of tiles of about tsize pixels (0 for BGTILE)
+ * covering the w x h CamPixels at im inside border, and set up *bp with them.
+ * the surface is just bilinear through the tiles until bgFitPoly() or
+ * bgFitSpline() is used.
+ * return 0 if ok, else -1 if the image is too small or no memory.
+ * N.B. caller must bgFree(bp) if we return 0.
+ */
+int
+bgMeasure (char *im, int w, int h, int border, int tsize, BgMap *bp)
+{
+	CamPixel *pix = (CamPixel *)im;
+	float *buf, *tmp;
+	int aw = w - 2*border;
+	int ah = h - 2*border;
+	int i, j;
+
+	memset ((void *)bp, 0, sizeof(*bp));
+	if (tsize <= 0)
+	    tsize = BGTILE;
+	if (border < 0 || aw < BGMINTILE || ah < BGMINTILE)
+	    return (-1);
+
+	/* as many whole tiles as fit, centered within border */
+	bp->w = w;
+	bp->h = h;
+	bp->nx = aw/tsize > 0 ? aw/tsize : 1;
+	bp->ny = ah/tsize > 0 ? ah/tsize : 1;
+	bp->tw = aw/bp->nx;
+	bp->th = ah/bp->ny;
+	bp->x0 = border + (aw - bp->nx*bp->tw)/2;
+	bp->y0 = border + (ah - bp->ny*bp->th)/2;
+	bp->fit = BG_NONE;
+
+	bp->sky = (float *) malloc (bp->nx*bp->ny*sizeof(float));
+	bp->sig = (float *) malloc (bp->nx*bp->ny*sizeof(float));
+	buf = (float *) malloc (bp->tw*bp->th*sizeof(float));
+	tmp = (float *) malloc (bp->tw*bp->th*sizeof(float));
+	if (!bp->sky || !bp->sig || !buf || !tmp) {
+	    if (buf)
+		free ((void *)buf);
+	    if (tmp)
+		free ((void *)tmp);
+	    bgFree (bp);
+	    return (-1);
+	}
+
+	for (i = 0; i < bp->ny; i++)
+	    for (j = 0; j < bp->nx; j++) {
+		int k = i*bp->nx + j;
+
+		tileStats (pix, w, bp->x0 + j*bp->tw, bp->y0 + i*bp->th,
+				bp->tw, bp->th, buf, tmp, &bp->sky[k], &bp->sig[k]);
+	    }
+	free ((void *)buf);
+	free ((void *)tmp);
+
+	filterTiles (bp);
+	bp->pixhash = pixHashFITS (im, w, h);
+	return (0);
+}
+
+/* fit an order-n polynomial to the tiles of bp. the tiles that fit worst are
+ * dropped and the fit done again, in case the median filter missed any.
+ * return 0 if ok, else -1 if too few tiles or no memory.
+ */
+int
+bgFitPoly (BgMap *bp, int order)
+{
+	int ntiles = bp->nx*bp->ny;
+	int nterms = (order+1)*(order+1);
+	int *use;
+	int i, n, ret;
+
+	if (order < 0 || order > BGMAXORDER || ntiles < nterms)
+	    return (-1);
+	use = (int *) malloc (ntiles*sizeof(int));
+	if (!use)
+	    return (-1);
+	for (i = 0; i < ntiles; i++)
+	    use[i] = 1;
+
+	ret = fitPoly (bp, order, use);
+	if (ret == 0) {
+	    double rss = 0, lim;
+
+	    /* rms of the residuals, then drop tiles well beyond it */
+	    for (i = 0; i < ntiles; i++) {
+		double r = polyAt (bp, TILEX(bp,i), TILEY(bp,i)) - bp->sky[i];
+		rss += r*r;
+	    }
+	    lim = BGKSIG*BGKSIG*rss/ntiles;
+	    for (n = i = 0; i < ntiles; i++) {
+		double r = polyAt (bp, TILEX(bp,i), TILEY(bp,i)) - bp->sky[i];
+		use[i] = r*r <= lim;
+		n += use[i];
+	    }
+	    if (n < ntiles && n >= nterms)
+		ret = fitPoly (bp, order, use);
+	}
+
+	free ((void *)use);
+	return (ret);
+}
+
+/* make the surface of bp a natural bicubic spline through its tiles.
+ * coef gets the sky of each column of tiles, top down, then their d2 in y,
+ * so each row needs just one pass down each column.
+ * return 0 if ok, else -1 if no memory.
+ */
+int
+bgFitSpline (BgMap *bp)
+{
+	int nx = bp->nx, ny = bp->ny;
+	double *c, *t;
+	int i, j;
+
+	c = (double *) malloc (2*nx*ny*sizeof(double));
+	t = (double *) malloc (ny*sizeof(double));
+	if (!c || !t) {
+	    if (c)
+		free ((void *)c);
+	    if (t)
+		free ((void *)t);
+	    return (-1);
+	}
+
+	for (j = 0; j < nx; j++) {
+	    double *f = c + j*ny;
+
+	    for (i = 0; i < ny; i++)
+		f[i] = bp->sky[i*nx + j];
+	    splineD2 (f, ny, f + nx*ny, t);
+	}
+	free ((void *)t);
+
+	if (bp->coef)
+	    free ((void *)bp->coef);
+	bp->coef = c;
+	bp->fit = BG_SPLINE;
+	bp->order = 0;
+	return (0);
+}
+
+/* fill row[bp->w] with the surface of bp along row y */
+void
+bgRow (BgMap *bp, int y, float row[])
+{
+	BgTmp tmp;
+
+	if (tmpAlloc (bp, &tmp) == 0) {
+	    evalRow (bp, y, &tmp, row);
+	    tmpFree (&tmp);
+	}
+}
+
+/* fill row[bp->w] with the sky noise of bp along row y, bilinear between the
+ * tile centers and constant beyond them.
+ */
+void
+bgNoiseRow (BgMap *bp, int y, float row[])
+{
+	BgTmp tmp;
+	int i;
+
+	if (tmpAlloc (bp, &tmp) < 0)
+	    return;
+	for (i = 0; i < bp->nx; i++) {
+	    tmp.f[i] = linearAt (bp->sig + i, bp->nx, bp->ny,
+					    (y - bp->y0 + .5)/bp->th - .5);
+	    tmp.d2[i] = 0;
+	}
+	knotRow (bp, tmp.f, tmp.d2, 0, row);
+	tmpFree (&tmp);
+}
+
+/* fill bp->map with the whole surface, using nthreads (0 for one per cpu).
+ * return 0 if ok, else -1 if no memory.
+ */
+int
+bgEvaluate (BgMap *bp, int nthreads)
+{
+	pthread_t thr[MAXTHR];
+	BgJob job;
+	int i, n;
+
+	if (!bp->map) {
+	    bp->map = (float *) malloc ((long)bp->w*bp->h*sizeof(float));
+	    if (!bp->map)
+		return (-1);
+	}
+
+	if (nthreads <= 0)
+	    nthreads = (int) sysconf (_SC_NPROCESSORS_ONLN);
+	if (nthreads > (bp->h + BGBAND - 1)/BGBAND)
+	    nthreads = (bp->h + BGBAND - 1)/BGBAND;
+	if (nthreads > MAXTHR)
+	    nthreads = MAXTHR;
+
+	job.bp = bp;
+	job.next = 0;
+	job.err = 0;
+	pthread_mutex_init (&job.lock, NULL);
+	for (n = i = 0; i < nthreads; i++)
+	    if (pthread_create (&thr[n], NULL, evalWorker, (void *)&job) == 0)
+		n++;
+	if (n == 0)
+	    evalWorker ((void *)&job);
+	for (i = 0; i < n; i++)
+	    pthread_join (thr[i], NULL);
+	pthread_mutex_destroy (&job.lock);
+
+	return (job.err ? -1 : 0);
+}
+
+/* free the memory of bp and forget it if in use */
+void
+bgFree (BgMap *bp)
+{
+	pthread_mutex_lock (&bglock);
+	if (bginuse == bp)
+	    bginuse = NULL;
+	pthread_mutex_unlock (&bglock);
+
+	if (bp->sky)
+	    free ((void *)bp->sky);
+	if (bp->sig)
+	    free ((void *)bp->sig);
+	if (bp->coef)
+	    free ((void *)bp->coef);
+	if (bp->map)
+	    free ((void *)bp->map);
+	memset ((void *)bp, 0, sizeof(*bp));
+}
+
+/* note bp, or none if NULL, for findStars() to use on the pixels it was
+ * measured from.
+ * N.B. bp is not copied; it must stay valid until replaced or bgFree()d.
+ */
+void
+useBgMap (BgMap *bp)
+{
+	pthread_mutex_lock (&bglock);
+	bginuse = bp;
+	pthread_mutex_unlock (&bglock);
+}
+
+/* return the map noted by useBgMap() if it was measured from the w x h
+ * pixels at im, else NULL. hashp is as for pixHashOnce().
+ */
+BgMap *
+getBgMap (char *im, int w, int h, unsigned int *hashp)
+{
+	BgMap *bp;
+
+	pthread_mutex_lock (&bglock);
+	bp = bginuse;
+	pthread_mutex_unlock (&bglock);
+	if (bp && (bp->w != w || bp->h != h || bp->pixhash != pixHashOnce(im,w,h,hashp)))
+	    bp = NULL;
+	return (bp);
+}
+
+/* find the sky and its noise in the tw x th tile at x0,y0 of im, by clipping
+ * beyond BGKSIG sd about the median until none go, with the sd from the
+ * median absolute deviation. buf and tmp have room for the tile.
+ * return the number of pixels left.
+ */
+static int
+tileStats (CamPixel *im, int w, int x0, int y0, int tw, int th,
+float buf[], float tmp[], float *skyp, float *sigp)
+{
+	double sd = 0;
+	float med = 0;
+	int i, j, n, pass;
+
+	for (n = i = 0; i < th; i++) {
+	    CamPixel *p = &im[(long)(y0+i)*w + x0];
+	    for (j = 0; j < tw; j++)
+		buf[n++] = p[j];
+	}
+
+	for (pass = 0; pass < BGMAXCLIP; pass++) {
+	    float lo, hi;
+	    int m;
+
+	    med = selectk (buf, n, n/2);
+	    for (i = 0; i < n; i++)
+		tmp[i] = fabsf (buf[i] - med);
+	    sd = MADSD*selectk (tmp, n, n/2);
+	    if (sd == 0) {
+		/* over half the same, eg, flat or burned out: use rms */
+		double sum2 = 0;
+		for (i = 0; i < n; i++)
+		    sum2 += (double)tmp[i]*tmp[i];
+		sd = sqrt (sum2/n);
+	    }
+
+	    lo = med - BGKSIG*sd;
+	    hi = med + BGKSIG*sd;
+	    for (m = i = 0; i < n; i++)
+		if (buf[i] >= lo && buf[i] <= hi)
+		    buf[m++] = buf[i];
+	    if (m == n || m < 2)
+		break;
+	    n = m;
+	}
+
+	*skyp = med;
+	*sigp = (float)sd;
+	return (n);
+}
+
+/* return the k'th smallest of v[n], which get shuffled */
+static float
+selectk (float v[], int n, int k)
+{
+	int lo = 0, hi = n-1;
+
+	while (lo < hi) {
+	    float piv = v[(lo+hi)/2];
+	    int i = lo, j = hi;
+
+	    while (i <= j) {
+		while (v[i] < piv)
+		    i++;
+		while (v[j] > piv)
+		    j--;
+		if (i <= j) {
+		    float tmp = v[i];
+		    v[i++] = v[j];
+		    v[j--] = tmp;
+		}
+	    }
+	    if (k <= j)
+		hi = j;
+	    else if (k >= i)
+		lo = i;
+	    else
+		break;
+	}
+	return (v[k]);
+}
+
+/* replace each tile sky which is off by more than FILTSIG of its noise from
+ * what its neighbors predict with that prediction. each line of three tiles
+ * through or out from it predicts it linearly, and the median of these is
+ * used. this drops tiles spoiled by a bright star or nebulosity without
+ * flattening real gradients, even at the edges and corners.
+ */
+static void
+filterTiles (BgMap *bp)
+{
+	int nx = bp->nx, ny = bp->ny;
+	float *sky, v[12], pred;
+	int i, j, k, n;
+
+	sky = (float *) malloc (nx*ny*sizeof(float));
+	if (!sky)
+	    return;
+	memcpy ((void *)sky, (void *)bp->sky, nx*ny*sizeof(float));
+
+	for (i = 0; i < ny; i++)
+	    for (j = 0; j < nx; j++) {
+		for (n = 0, k = 0; k < 9; k++) {
+		    int di = k/3 - 1, dj = k%3 - 1;
+
+		    if ((di == 0 && dj == 0) || !INGRID(bp,i+di,j+dj))
+			continue;
+		    /* between each opposite pair, once */
+		    if (k < 4 && INGRID(bp,i-di,j-dj))
+			v[n++] = (sky[(i+di)*nx + j+dj]
+					    + sky[(i-di)*nx + j-dj])/2;
+		    /* out from each side */
+		    if (INGRID(bp,i+2*di,j+2*dj))
+			v[n++] = 2*sky[(i+di)*nx + j+dj]
+					    - sky[(i+2*di)*nx + j+2*dj];
+		}
+		if (n == 0)
+		    continue;
+		pred = selectk (v, n, n/2);
+		if (fabs (sky[i*nx + j] - pred) > FILTSIG*bp->sig[i*nx + j])
+		    bp->sky[i*nx + j] = pred;
+	    }
+
+	free ((void *)sky);
+}
+
+/* solve for the order-n polynomial through the tiles with use[] set.
+ * terms are in x and y normalized to -1..1 across the image, so the design
+ * matrix stays well conditioned.
+ * return 0 if ok, else -1.
+ */
+static int
+fitPoly (BgMap *bp, int order, int use[])
+{
+	int nterms = (order+1)*(order+1);
+	int ntiles = bp->nx*bp->ny;
+	double *A, *b, *x;
+	int i, j, k, m;
+	int ret = -1;
+
+	A = (double *) malloc (ntiles*nterms*sizeof(double));
+	b = (double *) malloc (ntiles*sizeof(double));
+	x = (double *) malloc (nterms*sizeof(double));
+	if (!A || !b || !x)
+	    goto out;
+
+	for (m = k = 0; k < ntiles; k++) {
+	    double u, v, up, vp;
+	    double *ap = &A[m*nterms];
+
+	    if (!use[k])
+		continue;
+	    u = bp->x0 + (k%bp->nx + .5)*bp->tw - .5;
+	    v = bp->y0 + (k/bp->nx + .5)*bp->th - .5;
+	    u = (u - bp->w/2.0)/(bp->w/2.0);
+	    v = (v - bp->h/2.0)/(bp->h/2.0);
+	    for (up = 1, i = 0; i <= order; i++, up *= u)
+		for (vp = 1, j = 0; j <= order; j++, vp *= v)
+		    *ap++ = up*vp;
+	    b[m++] = bp->sky[k];
+	}
+
+	if (linlsq (A, b, m, nterms, x) == 0) {
+	    if (bp->coef)
+		free ((void *)bp->coef);
+	    bp->coef = x;
+	    bp->fit = BG_POLY;
+	    bp->order = order;
+	    x = NULL;
+	    ret = 0;
+	}
+
+    out:
+	if (A)
+	    free ((void *)A);
+	if (b)
+	    free ((void *)b);
+	if (x)
+	    free ((void *)x);
+	return (ret);
+}
+
+/* evaluate the polynomial of bp at image x,y */
+static double
+polyAt (BgMap *bp, double x, double y)
+{
+	int o = bp->order;
+	double u = (x - bp->w/2.0)/(bp->w/2.0);
+	double v = (y - bp->h/2.0)/(bp->h/2.0);
+	double z = 0;
+	int i, j;
+
+	for (i = o; i >= 0; i--) {
+	    double c = 0;
+
+	    for (j = o; j >= 0; j--)
+		c = c*v + bp->coef[i*(o+1)+j];
+	    z = z*u + c;
+	}
+	return (z);
+}
+
+/* find the second derivatives d2[n] of the natural cubic spline through the
+ * n values f[] at unit spacing. t[n] is scratch, and may be f.
+ */
+static void
+splineD2 (double f[], int n, double d2[], double t[])
+{
+	int i;
+
+	d2[0] = d2[n-1] = 0;
+	if (n < 3)
+	    return;
+
+	/* d2[i-1] + 4 d2[i] + d2[i+1] = 6 (f[i-1] - 2 f[i] + f[i+1]) for each
+	 * inner knot: eliminate down, keeping each 1/pivot in t, then back up.
+	 */
+	t[0] = 0;
+	for (i = 1; i < n-1; i++) {
+	    t[i] = 1/(4 - t[i-1]);
+	    d2[i] = (6*(f[i-1] - 2*f[i] + f[i+1]) - d2[i-1])*t[i];
+	}
+	for (i = n-3; i >= 1; i--)
+	    d2[i] -= t[i]*d2[i+1];
+}
+
+/* slope of the natural cubic spline with knots f[n], d2[n] at its first knot,
+ * or its last if right.
+ */
+static double
+splineSlope (double f[], double d2[], int n, int right)
+{
+	if (n < 2)
+	    return (0);
+	if (right)
+	    return (f[n-1] - f[n-2] + (d2[n-2] + 2*d2[n-1])/6);
+	return (f[1] - f[0] - (2*d2[0] + d2[1])/6);
+}
+
+/* value at t of the natural cubic spline with knots f[n], d2[n] at 0..n-1,
+ * linear beyond the end knots.
+ */
+static double
+splineAt (double f[], double d2[], int n, double t)
+{
+	double a, b;
+	int k;
+
+	if (n == 1)
+	    return (f[0]);
+	if (t < 0)
+	    return (f[0] + t*splineSlope (f, d2, n, 0));
+	if (t > n-1)
+	    return (f[n-1] + (t-(n-1))*splineSlope (f, d2, n, 1));
+	k = (int)t;
+	if (k > n-2)
+	    k = n-2;
+	a = k + 1 - t;
+	b = t - k;
+	return (a*f[k] + b*f[k+1] + ((a*a*a - a)*d2[k] + (b*b*b - b)*d2[k+1])/6);
+}
+
+/* value at t of the n values f[0], f[stride], ... at 0..n-1, linear between
+ * and constant beyond.
+ */
+static double
+linearAt (float f[], int stride, int n, double t)
+{
+	int k;
+
+	if (t <= 0 || n == 1)
+	    return (f[0]);
+	if (t >= n-1)
+	    return (f[(n-1)*stride]);
+	k = (int)t;
+	t -= k;
+	return ((1-t)*f[k*stride] + t*f[(k+1)*stride]);
+}
+
+/* fill row[bp->w] from the spline with values f[] and d2[] at the nx tile
+ * centers, beyond which it is linear if ext, else constant. each segment
+ * between knots is done on its own so the loop over its pixels is simple.
+ */
+static void
+knotRow (BgMap *bp, double f[], double d2[], int ext, float row[])
+{
+	int nx = bp->nx, w = bp->w;
+	double c0 = bp->x0 + bp->tw/2.0 - .5;	/* pixel x of first knot */
+	double step = bp->tw;
+	float rstep = (float)(1.0/step);
+	int x, xa, xb, k;
+
+	xa = 0;
+	for (k = -1; k < nx; k++) {
+	    /* pixels from knot k to k+1 */
+	    xb = k < nx-1 ? (int)ceil (c0 + (k+1)*step) : w;
+	    if (xb > w)
+		xb = w;
+	    if (xb <= xa)
+		continue;
+
+	    if (k < 0 || k == nx-1) {
+		float e = k < 0 ? 0 : nx-1;
+		float z = (float)(k < 0 ? f[0] : f[nx-1]);
+		float s = ext ? (float)splineSlope (f, d2, nx, k >= 0) : 0;
+
+		for (x = xa; x < xb; x++)
+		    row[x] = z + s*((x - (float)c0)*rstep - e);
+	    } else {
+		float f0 = (float)f[k], f1 = (float)f[k+1];
+		float g0 = (float)(d2[k]/6), g1 = (float)(d2[k+1]/6);
+		float t0 = (float)(c0 + k*step);
+
+		for (x = xa; x < xb; x++) {
+		    float b = (x - t0)*rstep;
+		    float a = 1 - b;
+		    row[x] = a*f0 + b*f1 + (a*a*a - a)*g0 + (b*b*b - b)*g1;
+		}
+	    }
+	    xa = xb;
+	}
+}
+
+/* get working space for evaluating rows of bp.
+ * return 0 if ok, else -1.
+ */
+static int
+tmpAlloc (BgMap *bp, BgTmp *tp)
+{
+	int n = bp->nx > bp->ny ? bp->nx : bp->ny;
+	int x;
+
+	tp->u = (float *) malloc (bp->w*sizeof(float));
+	tp->c = (float *) malloc ((BGMAXORDER+1)*sizeof(float));
+	tp->f = (double *) malloc (3*n*sizeof(double));
+	if (!tp->u || !tp->c || !tp->f) {
+	    tmpFree (tp);
+	    return (-1);
+	}
+	tp->d2 = tp->f + n;
+	tp->t = tp->d2 + n;
+
+	for (x = 0; x < bp->w; x++)
+	    tp->u[x] = (float)((x - bp->w/2.0)/(bp->w/2.0));
+	return (0);
+}
+
+static void
+tmpFree (BgTmp *tp)
+{
+	if (tp->u)
+	    free ((void *)tp->u);
+	if (tp->c)
+	    free ((void *)tp->c);
+	if (tp->f)
+	    free ((void *)tp->f);
+	memset ((void *)tp, 0, sizeof(*tp));
+}
+
+/* fill row[bp->w] with the surface of bp along row y */
+static void
+evalRow (BgMap *bp, int y, BgTmp *tp, float row[])
+{
+	double ty = (y - bp->y0 + .5)/bp->th - .5;	/* tile row coord */
+	int w = bp->w;
+	int i, j, x;
+
+	switch (bp->fit) {
+	case BG_POLY: {
+	    int o = bp->order;
+	    double v = (y - bp->h/2.0)/(bp->h/2.0);
+	    float *u = tp->u, *c = tp->c;
+
+	    /* fold in y, leaving a polynomial in x for this row */
+	    for (i = 0; i <= o; i++) {
+		double ci = 0;
+		for (j = o; j >= 0; j--)
+		    ci = ci*v + bp->coef[i*(o+1)+j];
+		c[i] = (float)ci;
+	    }
+
+	    /* Horner across the row, one term at a time */
+	    for (x = 0; x < w; x++)
+		row[x] = c[o];
+	    for (i = o-1; i >= 0; i--) {
+		float ci = c[i];
+		for (x = 0; x < w; x++)
+		    row[x] = row[x]*u[x] + ci;
+	    }
+	    break;
+	    }
+
+	case BG_SPLINE: {
+	    double *col = bp->coef, *cold2 = bp->coef + bp->nx*bp->ny;
+
+	    /* spline down each column of tiles to this row, then across */
+	    for (i = 0; i < bp->nx; i++)
+		tp->f[i] = splineAt (col + i*bp->ny, cold2 + i*bp->ny, bp->ny, ty);
+	    splineD2 (tp->f, bp->nx, tp->d2, tp->t);
+	    knotRow (bp, tp->f, tp->d2, 1, row);
+	    break;
+	    }
+
+	default:
+	    for (i = 0; i < bp->nx; i++) {
+		tp->f[i] = linearAt (bp->sky + i, bp->nx, bp->ny, ty);
+		tp->d2[i] = 0;
+	    }
+	    knotRow (bp, tp->f, tp->d2, 0, row);
+	    break;
+	}
+}
+
+/* bgEvaluate() worker: fill bands of rows until none are left */
+static void *
+evalWorker (void *arg)
+{
+	BgJob *jp = (BgJob *)arg;
+	BgMap *bp = jp->bp;
+	BgTmp tmp;
+	int y, y0;
+
+	if (tmpAlloc (bp, &tmp) < 0) {
+	    pthread_mutex_lock (&jp->lock);
+	    jp->err = 1;
+	    pthread_mutex_unlock (&jp->lock);
+	    return (NULL);
+	}
+
+	for (;;) {
+	    pthread_mutex_lock (&jp->lock);
+	    y0 = jp->next;
+	    jp->next += BGBAND;
+	    pthread_mutex_unlock (&jp->lock);
+	    if (y0 >= bp->h)
+		break;
+	    for (y = y0; y < y0 + BGBAND && y < bp->h; y++)
+		evalRow (bp, y, &tmp, bp->map + (long)y*bp->w);
+	}
+
+	tmpFree (&tmp);
+	return (NULL);
+}
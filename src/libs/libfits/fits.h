@@ -97,6 +97,9 @@ extern void flipImgRows (CamPixel *img, int w, int h);
 extern void transposeXY(CamPixel *img, int w, int h, int dir);
 extern int align2FITS (FImage *fip1, char *image2, int *dxp, int *dyp);
 extern void alignAdd (FImage *fip1, char *image2, int dx, int dy);
+extern int phaseAlignFITS (FImage *fip1, char *image2, double *dxp,
+    double *dyp);
+extern void alignAddFrac (FImage *fip1, char *image2, double dx, double dy);
 extern void aoiStatsFITS (char *ip, int w, int x, int y, int nx, int ny,
 							    AOIStats *sp);
 extern int findStars (char *image, int w, int h, int **xa, int **ya,
@@ -155,11 +158,103 @@ extern void getStats (double *x, int ndata, double *mean, double *median,\
 extern int removeOutliers (int ndata, double *x, double *y, double *fr);
 extern int flatField (FImage *from, FImage *to, int order);
 
+/* one star in a star list sidecar; see starlist.c */
+typedef struct {
+    float x, y;		/* centroid */
+    float xfwhm, yfwhm;	/* gaussian FWHM, pixels */
+    float xmax, ymax;	/* gaussian peaks, with Sky */
+    float rmsSrc;	/* rms error of Src */
+    float rmsSky;	/* rms of Sky */
+    int bx, by;		/* brightest pixel, as found by findStars() */
+    int p;		/* value of brightest pixel */
+    int Src;		/* total counts due just to star in aperture */
+    int Sky;		/* median value of noise annulus */
+    int rAp;		/* aperture radius */
+    int flags;		/* SL_* */
+    int spare;
+    double ra, dec;	/* J2000, rads, iff SL_RADEC */
+} StarRec;
+
+#define	SL_OK		1	/* starStats() fields are set */
+#define	SL_RADEC	2	/* ra/dec are set */
+
+/* a star list mapped into memory */
+typedef struct {
+    int n;		/* number of stars */
+    StarRec *s;		/* s[n], within map */
+    int w, h;		/* image size */
+    unsigned int pixhash;	/* pixHashFITS() of the pixels */
+    void *map;		/* mapped file */
+    long maplen;	/* bytes in map */
+} StarList;
+
+extern unsigned int pixHashFITS (char *im, int w, int h);
+extern unsigned int pixHashOnce (char *im, int w, int h, unsigned int *hashp);
+extern void starListName (char *fitsfn, char slfn[]);
+extern int measureStarList (FImage *fip, StarRec **srp);
+extern int writeStarList (char *fitsfn, FImage *fip, StarRec *sr, int n,
+    char msg[]);
+extern StarList *openStarList (char *fitsfn, FImage *fip, char msg[]);
+extern void closeStarList (StarList *slp);
+extern int useStarList (char *fitsfn, FImage *fip);
+extern int getStarList (char *im, int w, int h, unsigned int *hashp,
+    StarRec **srp);
+
+/* how stackFITS() combines the frames at each pixel */
+typedef enum {
+    STK_MEAN, STK_MEDIAN, STK_CLIP
+} StackHow;
+
+/* how stackFITS() is to stack */
+typedef struct {
+    StackHow how;	/* combining method */
+    double ksig;	/* STK_CLIP rejects beyond this many sd, 0 for 3 */
+    int weight;		/* weight frames by their inverse noise variance */
+    int ref;		/* index of reference frame */
+    int nthreads;	/* worker threads, 0 for one per cpu */
+    long maxmem;	/* bytes of frame pixels held at once, 0 for 64MB */
+} StackOpts;
+
+extern int stackFITS (char *fns[], int n, StackOpts *sop, FImage *fip,
+    char msg[]);
+
+/* how a BgMap surface is made from its tiles */
+typedef enum {
+    BG_NONE, BG_POLY, BG_SPLINE
+} BgFit;
+
+/* sky background of an image; see background.c */
+typedef struct {
+    int w, h;		/* image size */
+    int x0, y0;		/* ul corner of the tiles */
+    int tw, th;		/* tile size */
+    int nx, ny;		/* tiles across and down */
+    float *sky;		/* nx*ny clipped sky of each tile, row by row */
+    float *sig;		/* nx*ny sky noise of each tile */
+    BgFit fit;		/* surface through the tiles, bilinear if BG_NONE */
+    int order;		/* polynomial order, if BG_POLY */
+    double *coef;	/* fit coefficients */
+    float *map;		/* w*h surface, once bgEvaluate() */
+    unsigned int pixhash;	/* pixHashFITS() of the pixels measured */
+} BgMap;
+
+extern int bgMeasure (char *im, int w, int h, int border, int tsize,
+    BgMap *bp);
+extern int bgFitPoly (BgMap *bp, int order);
+extern int bgFitSpline (BgMap *bp);
+extern void bgRow (BgMap *bp, int y, float row[]);
+extern void bgNoiseRow (BgMap *bp, int y, float row[]);
+extern int bgEvaluate (BgMap *bp, int nthreads);
+extern void bgFree (BgMap *bp);
+extern void useBgMap (BgMap *bp);
+extern BgMap *getBgMap (char *im, int w, int h, unsigned int *hashp);
+
 
 // ip.cfg control
 extern void loadIpCfg(void);
 extern char * getCurrentIpCfgPath(void);
 extern void setIpCfgPath(char *pathname);
+extern unsigned int ipCfgSum(void);
 
 // ip.cfg values
 // -- STAR FINDER --
@@ -178,6 +273,7 @@ extern double APGAP;
 extern double APSKYX;
 extern double MAXSKYPIX;
 extern int MINGAUSSR;
+extern int STARFAST;
 // -- FWHM STATS --
 extern int NFWHM;
 extern double FWHMSD;
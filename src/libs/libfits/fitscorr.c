@@ -15,6 +15,8 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
 
 #include "P_.h"
 #include "astro.h"
@@ -44,6 +46,26 @@ static int subimage (FImage *fip1, FImage *fip2, int *x0p, int *y0p, int *wp,  c
 static int isMapTerm(BADCOL *p); 
 static int findNextSuffix (char *dirname, char *prefix, int gap, char file[], char errmsg[], char suffix[]);
 static int nextbadcol(FILE *fp, BADCOL *bc);
+static int readCorrFile (char fn[], FImage *fip, char errmsg[]);
+
+/* correction frames kept in memory by readCorrFile(), when enabled.
+ * each is known by its full path and the size and times of the file it came
+ * from, so a frame is read again as soon as its file is replaced, even
+ * within the same second.
+ */
+typedef struct {
+    char path[1024];		/* full path, "" if unused */
+    struct timespec mtim;	/* file mod time when read */
+    struct timespec ctim;	/* file change time when read */
+    off_t size;			/* file size when read */
+    unsigned long used;		/* corrclock when last used */
+    FImage fim;			/* the frame */
+} CorrFrame;
+static CorrFrame *corrframes;	/* malloced cache */
+static int ncorrframes;		/* n corrframes[] */
+static unsigned long corrclock;	/* bumped on each use */
+static pthread_mutex_t corrlock = PTHREAD_MUTEX_INITIALIZER;
+static int corrSame (CorrFrame *cfp, char *path, struct stat *sp);
 
 /* STO 2002-10-07: These are now values (optionally) found in camera.cfg
  * If they are NOT defined in the config, they take the values of the previous defines
@@ -69,6 +91,30 @@ void readCorrectionCfg(int trace, char *cfgFile)
 	readCfgFile (trace, cfgFile, ccfg, sizeof(ccfg)/sizeof(ccfg[0]));
 }			
 
+/* keep the n most recently used correction frames in memory so repeated
+ * calls to correctFITS() need not read them again. 0 disables, the default.
+ */
+void
+setCorrCache (int n)
+{
+	int i;
+
+	pthread_mutex_lock (&corrlock);
+	for (i = 0; i < ncorrframes; i++)
+	    if (corrframes[i].path[0])
+		resetFImage (&corrframes[i].fim);
+	if (corrframes)
+	    free ((void *)corrframes);
+	corrframes = NULL;
+	ncorrframes = 0;
+	if (n > 0) {
+	    corrframes = (CorrFrame *) calloc (n, sizeof(CorrFrame));
+	    if (corrframes)
+		ncorrframes = n;
+	}
+	pthread_mutex_unlock (&corrlock);
+}
+
 /* apply bias/thermal/flat corrections to the given FITS file.
  * if any correction file names are NULL, try the standard places.
  * return 0 if ok else put a reason in errmsg and return -1.
@@ -836,26 +882,113 @@ int (*qualfp)(FImage *matchfip, FImage *fip, char errmsg[]);
 FImage *fip;
 char errmsg[];
 {
-	int fd;
+	initFImage (fip);
+	if (readCorrFile (fn, fip, errmsg) < 0)
+	    return (-1);
+	if ((*qualfp) (matchfip, fip, errmsg) < 0) {
+	    resetFImage (fip);
+	    return (-1);
+	}
+	return (0);
+}
+
+/* read the FITS file fn into fip, from the cache if it is enabled and holds
+ * a frame read from this same file since it last changed.
+ * the cache is not locked while reading a file, so other threads may use it
+ * meanwhile; if one read the same file first, its copy is kept.
+ * return 0 if ok, else fill errmsg and return -1.
+ */
+static int
+readCorrFile (char fn[], FImage *fip, char errmsg[])
+{
+	char path[1024];
+	struct stat st;
+	CorrFrame *cfp, *oldest;
+	int fd, i, s;
 
 	fd = telopen (fn, O_RDONLY);
 	if (fd < 0) {
 	    sprintf (errmsg, "Error opening %s: %s", fn, strerror(errno));
 	    return (-1);
 	}
-	initFImage (fip);
-	if (readFITS (fd, fip, errmsg) < 0) {
+
+	pthread_mutex_lock (&corrlock);
+	if (ncorrframes == 0 || fstat (fd, &st) < 0) {
+	    pthread_mutex_unlock (&corrlock);
+	    s = readFITS (fd, fip, errmsg);
 	    (void) close (fd);
-	    return (-1);
+	    return (s < 0 ? -1 : 0);
 	}
-	if ((*qualfp) (matchfip, fip, errmsg) < 0) {
-	    resetFImage (fip);
-	    (void) close (fd);
-	    return (-1);
+
+	telfixpath (path, fn);
+	for (i = 0; i < ncorrframes; i++) {
+	    cfp = &corrframes[i];
+	    if (corrSame (cfp, path, &st)) {
+		cfp->used = ++corrclock;
+		s = copyFITS (fip, &cfp->fim);
+		pthread_mutex_unlock (&corrlock);
+		(void) close (fd);
+		if (s < 0) {
+		    sprintf (errmsg, "No memory to copy %s", fn);
+		    return (-1);
+		}
+		return (0);
+	    }
 	}
+	pthread_mutex_unlock (&corrlock);
+
+	/* not cached: read without holding up the others */
+	s = readFITS (fd, fip, errmsg);
 	(void) close (fd);
+	if (s < 0)
+	    return (-1);
+
+	/* then replace the least recently used, unless another thread has
+	 * added this same frame meanwhile. the cache may have been resized.
+	 */
+	pthread_mutex_lock (&corrlock);
+	oldest = NULL;
+	for (i = 0; i < ncorrframes; i++) {
+	    cfp = &corrframes[i];
+	    if (corrSame (cfp, path, &st)) {
+		cfp->used = ++corrclock;
+		pthread_mutex_unlock (&corrlock);
+		return (0);
+	    }
+	    if (!oldest || cfp->used < oldest->used)
+		oldest = cfp;
+	}
+	if (!oldest) {
+	    pthread_mutex_unlock (&corrlock);
+	    return (0);
+	}
+	if (oldest->path[0]) {
+	    resetFImage (&oldest->fim);
+	    oldest->path[0] = '\0';
+	}
+	initFImage (&oldest->fim);
+	if (copyFITS (&oldest->fim, fip) == 0) {
+	    strncpy (oldest->path, path, sizeof(oldest->path)-1);
+	    oldest->mtim = st.st_mtim;
+	    oldest->ctim = st.st_ctim;
+	    oldest->size = st.st_size;
+	    oldest->used = ++corrclock;
+	}
+	pthread_mutex_unlock (&corrlock);
 	return (0);
 }
+
+/* return whether cfp holds the frame read from path as it is now, per *sp */
+static int
+corrSame (CorrFrame *cfp, char *path, struct stat *sp)
+{
+	return (strcmp (cfp->path, path) == 0 && cfp->size == sp->st_size
+			    && cfp->mtim.tv_sec == sp->st_mtim.tv_sec
+			    && cfp->mtim.tv_nsec == sp->st_mtim.tv_nsec
+			    && cfp->ctim.tv_sec == sp->st_ctim.tv_sec
+			    && cfp->ctim.tv_nsec == sp->st_ctim.tv_nsec);
+}
+
 /* STO20010405
    Modified to accept a different suffix, and made findLastFITS compatible
    Used by findMapFN
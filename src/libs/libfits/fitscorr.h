@@ -1,5 +1,6 @@
 /* function prototypes for using fitscorr.c */
 extern void readCorrectionCfg(int trace, char *cfgFile);
+extern void setCorrCache (int n);
 extern int correctFITS (FImage *fip, char biasfn[], char thermfn[],
     char flatfn[], char errmsg[]);
 extern unsigned short pixRange(double f);
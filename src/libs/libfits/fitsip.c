@@ -2,6 +2,7 @@
 
 #include <errno.h>
 #include <math.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -13,9 +14,19 @@
 #include "astro.h"
 #include "configfile.h"
 #include "fits.h"
+#include "lstsqr.h"
 #include "telenv.h"
 #include "wcs.h"
 
+/* storage class for the star finder's scratch, so threads may each work on
+ * their own image.
+ */
+#if defined(__GNUC__)
+#define IP_TLS __thread
+#else
+#define IP_TLS
+#endif
+
 /* image processing config params pulled from ipcfn whenever it changes */
 
 //
@@ -41,6 +52,7 @@ double APGAP = 2;       // radius gap between star and sky
 double APSKYX = 3;      // this many more pixels in sky than star
 double MAXSKYPIX = 200; // most pix we need for good sky stats
 int MINGAUSSR = 7;      // min radius when computing gaussian stats
+int STARFAST = 1;       // 1 to fit log parabola, gaussfit only as fallback
 // -- FWHM STATS --
 int NFWHM = 20;       // max stars to use for median FWHM
 double FWHMSD = 10;   // min SD to use in finding median FWHM
@@ -112,11 +124,18 @@ static CfgEntry ipcfg[] = {
 #define NIPCFG (sizeof(ipcfg) / sizeof(ipcfg[0]))
 
 static double getFWHMratio(CamPixel *im0, int w, int h, int x, int y);
+static int findStarsHash(char *im0, int w, int h, unsigned int *hashp,
+                         int **xa, int **ya, CamPixel **ba);
+static int findAllStars(char *im0, int w, int h, unsigned int *hashp, int **xa,
+                        int **ya, CamPixel **ba, StreakData **sa,
+                        int *numStreaks);
 
 extern void gaussfit(int pix[], int n, double *maxp, double *cenp,
                      double *fwhmp);
 
 static void starGauss(CamPixel *image, int w, int r, StarStats *ssp);
+static int quickGauss(int pix[], int n, double *maxp, double *cenp,
+                      double *fwhmp);
 static void brightSquare(CamPixel *imp, int w, int ix, int iy, int r, int *xp,
                          int *yp, CamPixel *bp);
 static int brightWalk(CamPixel *imp, int w, int x0, int y0, int maxr, int *xp,
@@ -130,6 +149,8 @@ static void ringStats(CamPixel *image, int w, int x0, int y0, int r, int *Ep,
                       double *sigp);
 static int skyStats(CamPixel *image, int w, int h, int x0, int y0, int r,
                     int *Ep, double *sigp);
+static void pixSelect(int pix[], int n, int k);
+static void pixPercentiles(int pix[], int n, int *p16p, int *p50p, int *p84p);
 static void circleCount(CamPixel *image, int w, int x0, int y0, int maxr,
                         int *np, int *sump);
 
@@ -727,11 +748,11 @@ double *mp, *dmp;
 /* support for bWalk */
 #define BW_FANR 2
 #define BW_NFAN ((2 * BW_FANR + 1) * (2 * BW_FANR + 1) - 1)
-static int bW_w, bW_h;
-static int *bW_fan;
-static int bW_thresh;
-static CamPixel *bW_im;
-static CamPixel *bW_bp;
+static IP_TLS int bW_w, bW_h;
+static IP_TLS int *bW_fan;
+static IP_TLS int bW_thresh;
+static IP_TLS CamPixel *bW_im;
+static IP_TLS CamPixel *bW_bp;
 
 /* scanning around bp, set bW_bp to the brightest member of bW_fan.
  */
@@ -837,8 +858,8 @@ static void findThresh(CamPixel *im0, int imw, int boxw, int boxh, int *tp) {
 /* scan around peak and count the number of contiguous neighbors above thresh.
  */
 static int connected(CamPixel *peak, int w, int thresh) {
-  static int lastw = -1;
-  static int fan[8];
+  static IP_TLS int lastw = -1;
+  static IP_TLS int fan[8];
   int i, n;
 
   if (lastw != w) {
@@ -869,8 +890,8 @@ static int connected(CamPixel *peak, int w, int thresh) {
  */
 
 static int ringAvg(CamPixel *peak) {
-  static int lastw = -1;
-  static int fan[8];
+  static IP_TLS int lastw = -1;
+  static IP_TLS int fan[8];
   int i, n;
 
   if (lastw != bW_w) {
@@ -926,8 +947,8 @@ static void blockWalk(CamPixel **pAddr, int dir, int dump) {
   int thresh = bW_thresh;
 
   // only need to set this up once
-  static int blockmap[BLOCKSIZE];
-  static int oldW;
+  static IP_TLS int blockmap[BLOCKSIZE];
+  static IP_TLS int oldW;
   if (oldW != bW_w) {
     int i;
     for (i = 0; i < BLOCKSIZE; i++) {
@@ -1212,7 +1233,7 @@ typedef struct {
   int bright;
 } SEGINFO;
 
-int dbon = 0;
+static IP_TLS int dbon = 0; // debug trace on for current pixel
 static void widthWalk(CamPixel *addr, double slope, int thresh,
                       SEGINFO *pSegment) {
   int x, y, i, val, sumval;
@@ -1493,15 +1514,60 @@ static int qualifyStreakData(CamPixel *im0, int w, StreakData *pStr) {
     // STO: create a couple versions of this so we can call for streaks or stars
     // and get the returns out how we want, but still stay backward compatible
     // original call; returns star data in xa,ya,ba with count via return
+    // if useStarList() has the stars of these pixels already, use them.
     int findStars(char *im0, int w, int h, int **xa, int **ya, CamPixel **ba) {
-      return findStarsAndStreaks(im0, w, h, xa, ya, ba, NULL, NULL);
+      unsigned int hash = 0;
+
+      return findStarsHash(im0, w, h, &hash, xa, ya, ba);
+    }
+
+    // findStars() with the pixel hash shared with our callers, as for
+    // pixHashOnce(), so one search hashes the image at most once.
+    static int findStarsHash(char *im0, int w, int h, unsigned int *hashp,
+                             int **xa, int **ya, CamPixel **ba) {
+      StarRec *sr;
+      int n, i;
+
+      n = getStarList(im0, w, h, hashp, &sr);
+      if (n < 0)
+        return findAllStars(im0, w, h, hashp, xa, ya, ba, NULL, NULL);
+
+      *xa = (int *)malloc((n + 1) * sizeof(int));
+      *ya = (int *)malloc((n + 1) * sizeof(int));
+      *ba = (CamPixel *)malloc((n + 1) * sizeof(CamPixel));
+      if (!*xa || !*ya || !*ba) {
+        if (*xa)
+          free((char *)*xa);
+        if (*ya)
+          free((char *)*ya);
+        if (*ba)
+          free((char *)*ba);
+        free((char *)sr);
+        return (-1);
+      }
+      for (i = 0; i < n; i++) {
+        (*xa)[i] = sr[i].bx;
+        (*ya)[i] = sr[i].by;
+        (*ba)[i] = sr[i].p;
+      }
+      free((char *)sr);
+      return (n);
     }
     // call that will return streak data (which also will contain star data) in sa
     // (if not null) and will also return old-style star data in xa,ya,ba (if not
     // null). old style star count via return, streak count (which includes stars it
     // found too) via the return pointer numStreaks.
+    // if useBgMap() has a map of these pixels, the detection threshold is
+    // its sky plus FSMINSD of its noise, rather than from the noise boxes.
     int findStarsAndStreaks(char *im0, int w, int h, int **xa, int **ya,
                             CamPixel **ba, StreakData **sa, int *numStreaks) {
+      return findAllStars(im0, w, h, NULL, xa, ya, ba, sa, numStreaks);
+    }
+
+    // findStarsAndStreaks() with the pixel hash as for findStarsHash().
+    static int findAllStars(char *im0, int w, int h, unsigned int *hashp,
+                            int **xa, int **ya, CamPixel **ba, StreakData **sa,
+                            int *numStreaks) {
       int dumpx, dumpy, dumpr;
       CamPixel *p0 = (CamPixel *)im0;
       int *xp = NULL, *yp = NULL;
@@ -1521,6 +1587,9 @@ static int qualifyStreakData(CamPixel *im0, int w, StreakData *pStr) {
       int *ytopr, *ybotr;   /* interpolated top and bottom rows this seg */
       int *ytoprp, *ybotrp; /* pointers to y rows, allows to flip */
       int ytop = 0;         /* y at top of current interpolation range */
+      BgMap *bgp;           /* background map to use, if any */
+      float *bgsky = NULL;  /* bgp sky along this row */
+      float *bgsig = NULL;  /* bgp noise along this row */
       int i;
       // flags for what mode(s) to use: determined by return pointers passed in
       int std_findstars = (xa && ya && ba) ? 1 : 0;
@@ -1529,6 +1598,15 @@ static int qualifyStreakData(CamPixel *im0, int w, StreakData *pStr) {
       /* get fresh imaging params */
       loadIpCfg();
 
+      /* use a background map of these pixels, if we have one */
+      bgp = getBgMap(im0, w, h, hashp);
+      if (bgp) {
+        bgsky = (float *)malloc(w * sizeof(bgsky[0]));
+        bgsig = (float *)malloc(w * sizeof(bgsig[0]));
+        if (!bgsky || !bgsig)
+          bgp = NULL;
+      }
+
       /* prepare for bWalk */
       i = 0;
       for (y = -BW_FANR; y <= BW_FANR; y++)
@@ -1596,7 +1674,14 @@ static int qualifyStreakData(CamPixel *im0, int w, StreakData *pStr) {
         /* at each boxh center set ytopr/botp to top/bottom y rows.
          * each is filled with interpolated values on their rows for all x.
          */
-        if (y == FSBORD) {
+        if (bgp) {
+          /* just read the map sky and noise along this row */
+          if (bgp->map)
+            memcpy(bgsky, bgp->map + (long)y * w, w * sizeof(bgsky[0]));
+          else
+            bgRow(bgp, y, bgsky);
+          bgNoiseRow(bgp, y, bgsig);
+        } else if (y == FSBORD) {
           /* special case to start: cover down to 3/2*boxh */
           ytoprp = ytopr;
           ybotrp = ybotr;
@@ -1620,7 +1705,9 @@ static int qualifyStreakData(CamPixel *im0, int w, StreakData *pStr) {
         for (x = FSBORD; x < w - FSBORD; x++) {
           int dump = ydump && x >= dumpx - dumpr && x <= dumpx + dumpr;
           int thresh =
-              ((double)(y)-ytop) * (ybotrp[x] - ytoprp[x]) / boxh + ytoprp[x];
+              bgp ? (int)(bgsky[x] + FSMINSD * bgsig[x])
+                  : ((double)(y)-ytop) * (ybotrp[x] - ytoprp[x]) / boxh +
+                        ytoprp[x];
           int brx, bry;
           CamPixel *peak;
 
@@ -1832,6 +1919,10 @@ static int qualifyStreakData(CamPixel *im0, int w, StreakData *pStr) {
       free((char *)boxes);
       free((char *)ytopr);
       free((char *)ybotr);
+      if (bgsky)
+        free((char *)bgsky);
+      if (bgsig)
+        free((char *)bgsig);
 
       // now do the second-pass processing of the streak data
       if (find_streaks) {
@@ -2214,14 +2305,54 @@ static int qualifyStreakData(CamPixel *im0, int w, StreakData *pStr) {
       int *x, *y;     /* malloced lists of star locations */
       CamPixel *b;    /* malloced list of brightest pixel in each */
       StarDfn sd;     /* for getting real star stats */
+      StarRec *sr;    /* malloced star list, if useStarList() has one */
+      unsigned int hash = 0; /* pixHashOnce() of im0 */
       int nfs;        /* number of raw stars from findStars() */
       int ngs;        /* number of really good stars */
       int i;
 
       loadIpCfg();
 
+      /* use the star list if we have one, it already has the good ones */
+      nfs = getStarList(im0, w, h, &hash, &sr);
+      if (nfs == 0) {
+        free((char *)sr);
+        return (-1);
+      }
+      if (nfs > 0) {
+        *sspp = (StarStats *)malloc(nfs * sizeof(StarStats));
+        if (!*sspp) {
+          free((char *)sr);
+          return (-1);
+        }
+        for (ngs = i = 0; i < nfs; i++) {
+          StarRec *rp = &sr[i];
+          StarStats *ssp = &(*sspp)[ngs];
+
+          if (!(rp->flags & SL_OK))
+            continue;
+          ssp->p = rp->p;
+          ssp->bx = rp->bx;
+          ssp->by = rp->by;
+          ssp->Src = rp->Src;
+          ssp->rmsSrc = rp->rmsSrc;
+          ssp->rAp = rp->rAp;
+          ssp->Sky = rp->Sky;
+          ssp->rmsSky = rp->rmsSky;
+          ssp->x = rp->x;
+          ssp->y = rp->y;
+          ssp->xfwhm = rp->xfwhm;
+          ssp->yfwhm = rp->yfwhm;
+          ssp->xmax = rp->xmax;
+          ssp->ymax = rp->ymax;
+          ngs++;
+        }
+        free((char *)sr);
+        return (ngs);
+      }
+
       /* get list */
-      nfs = findStars(im0, w, h, &x, &y, &b);
+      nfs = findStarsHash(im0, w, h, &hash, &x, &y, &b);
       if (nfs < 0)
         return (-1);
       if (nfs == 0) {
@@ -2259,7 +2390,58 @@ static int qualifyStreakData(CamPixel *im0, int w, StreakData *pStr) {
       return (ngs);
     }
 
+#define QGFRAC 0.1 /* fraction of peak down to which quickGauss() fits */
+
+    /* find the gaussian through the peak of the n pixels in pix[] directly,
+     * by fitting a parabola to the log of the pixels above QGFRAC of the peak,
+     * each weighted by its square as per Guo (2011).
+     * return 0 if the result is believable, else -1 so the caller can use
+     * gaussfit() instead.
+     */
+    static int quickGauss(int pix[], int n, double *maxp, double *cenp,
+                          double *fwhmp) {
+      double A[3 * 1024], b[1024], c[3];
+      double sig2, cen;
+      int maxi, lo, hi, m, i;
+
+      /* find peak, then the pixels about it above QGFRAC of it */
+      maxi = 0;
+      for (i = 1; i < n; i++)
+        if (pix[i] > pix[maxi])
+          maxi = i;
+      if (pix[maxi] <= 0 || maxi == 0 || maxi == n - 1)
+        return (-1);
+      for (lo = maxi; lo > 0 && pix[lo - 1] > QGFRAC * pix[maxi]; lo--)
+        continue;
+      for (hi = maxi; hi < n - 1 && pix[hi + 1] > QGFRAC * pix[maxi]; hi++)
+        continue;
+      if (lo == maxi || hi == maxi)
+        return (-1);
+
+      /* weighted least squares for ln(pix) = c0 + c1*u + c2*u*u */
+      for (m = 0, i = lo; i <= hi; i++, m++) {
+        double u = i - maxi, p = pix[i];
+        A[3 * m + 0] = p;
+        A[3 * m + 1] = p * u;
+        A[3 * m + 2] = p * u * u;
+        b[m] = p * log(p);
+      }
+      if (m < 3 || linlsq(A, b, m, 3, c) < 0 || c[2] >= 0)
+        return (-1);
+
+      sig2 = -1.0 / (2 * c[2]);
+      cen = -c[1] / (2 * c[2]);
+      if (fabs(cen) > 1 || sig2 > (double)n * n / 4)
+        return (-1);
+
+      *maxp = exp(c[0] - c[1] * c[1] / (4 * c[2]));
+      *cenp = maxi + cen;
+      *fwhmp = 2.354 * sqrt(sig2);
+      return (0);
+    }
+
     /* Compute the guassian stats for a star.
+     * STARFAST uses quickGauss() with gaussfit() only when it fails.
      * N.B. we assume all the other portions of ssp are already set.
      */
     static void starGauss(image, w, r, ssp) CamPixel *image; /* image array */
@@ -2282,7 +2464,8 @@ static int qualifyStreakData(CamPixel *im0, int w, StreakData *pStr) {
       imp = &image[w * ssp->by + ssp->bx - r]; /* left end of row */
       for (i = 0; i < n; i++)
         a[i] = (int)(*imp++) - med;
-      gaussfit(a, n, &max, &cen, &fwhm);
+      if (!STARFAST || quickGauss(a, n, &max, &cen, &fwhm) < 0)
+        gaussfit(a, n, &max, &cen, &fwhm);
       ssp->xmax = max + med;
       ssp->x = ssp->bx + cen - r;
       ssp->xfwhm = fwhm;
@@ -2292,7 +2475,8 @@ static int qualifyStreakData(CamPixel *im0, int w, StreakData *pStr) {
         a[i] = (int)(*imp) - med;
         imp += w;
       }
-      gaussfit(a, n, &max, &cen, &fwhm);
+      if (!STARFAST || quickGauss(a, n, &max, &cen, &fwhm) < 0)
+        gaussfit(a, n, &max, &cen, &fwhm);
       ssp->ymax = max + med;
       ssp->y = ssp->by + cen - r;
       ssp->yfwhm = fwhm;
@@ -2523,49 +2707,35 @@ static int qualifyStreakData(CamPixel *im0, int w, StreakData *pStr) {
     {
       int inrr = r * r;              /* inner radius, squared */
       int outrr = (r + 1) * (r + 1); /* outter radius, squared */
-      int hist[NCAMPIX];             /* histogram (big, but faster than sorting) */
+      int *pix;                      /* pixels in the annulus */
       CamPixel *ip;                  /* walks down center of box */
       int x, y;                      /* scanning coordinates */
       int p16, p50, p84;             /* pixel at 16, 50 and 84 percentiles */
       int npix;                      /* number of pixels */
-      int s16, s50, s84;             /* 16, 50 and 84% of npix */
-      int sum;                       /* running sum for stats */
-
-      /* zero the histogram */
-      (void)memset((void *)hist, 0, sizeof(hist));
 
-      /* scan a box for pixels with radius [r .. r+1] from [x0,y0] */
+      /* gather pixels with radius [r .. r+1] from [x0,y0] */
       r++;                            /* go to outter radius */
+      pix = (int *)malloc((2 * r + 1) * (2 * r + 1) * sizeof(int));
+      if (!pix) {
+        *Ep = 0;
+        *sigp = 0;
+        return;
+      }
       ip = &image[w * (y0 - r) + x0]; /* start at center of top row */
       npix = 0;
       for (y = -r; y <= r; y++) {
         int yrr = y * y;
         for (x = -r; x <= r; x++) {
           int xyrr = x * x + yrr;
-          if (xyrr >= inrr && xyrr < outrr) {
-            int p = (int)(ip[x]);
-            hist[p]++;
-            npix++;
-          }
+          if (xyrr >= inrr && xyrr < outrr)
+            pix[npix++] = (int)(ip[x]);
         }
         ip += w; /* next row, still centered */
       }
 
       /* find the pixels at the 16, 50 and 84 percentiles */
-      p16 = p50 = p84 = 0;
-      s16 = (int)floor(npix * 0.16 + 0.5);
-      s50 = (int)floor(npix * 0.50 + 0.5);
-      s84 = (int)floor(npix * 0.84 + 0.5);
-      sum = 0;
-      for (x = 0; x < NCAMPIX; x++) {
-        sum += hist[x];
-        if (p16 == 0 && sum >= s16)
-          p16 = x;
-        if (p50 == 0 && sum >= s50)
-          p50 = x;
-        if (p84 == 0 && sum >= s84)
-          p84 = x;
-      }
+      pixPercentiles(pix, npix, &p16, &p50, &p84);
+      free((void *)pix);
 
 #ifdef RING_TRACE
       printf("Ring: r=%2d npix=%4d p16=%5d p50=%5d p84=%5d\n", r - 1, npix, p16,
@@ -2589,23 +2759,23 @@ static int qualifyStreakData(CamPixel *im0, int w, StreakData *pStr) {
     int *Ep;      /* median pixel value within annulus */
     double *sigp; /* rms within annulus */
     {
-      int hist[NCAMPIX]; /* histogram (big, but faster than sorting) */
+      int *pix;          /* pixels in the annulus */
+      int npix;          /* total number of pixels */
+      int mpix;          /* room in pix[] */
       int x, y;          /* scanning coordinates */
       CamPixel *ip;      /* walks down center of box */
       int p16, p50, p84; /* pixel at 16, 50 and 84 percentiles */
-      int npix;          /* total number of pixels */
-      int s16, s50, s84; /* 16, 50 and 84% of npix */
-      int sum;           /* running sum for stats */
       int minpix;        /* need at least this many pixels */
       int k;             /* walking radius */
 
-      /* zero the histogram */
-      (void)memset((void *)hist, 0, sizeof(hist));
-
       npix = 0;
       minpix = (int)ceil(PI * r * r * APSKYX);
       if (minpix > MAXSKYPIX)
         minpix = MAXSKYPIX;
+      mpix = 2 * minpix + 64;
+      pix = (int *)malloc(mpix * sizeof(int));
+      if (!pix)
+        return (-1);
       for (k = r + APGAP; npix < minpix; k++) {
         int inrr = k * k;              /* inner radius, squared */
         int outrr = (k + 1) * (k + 1); /* outter radius, squared */
@@ -2614,40 +2784,37 @@ static int qualifyStreakData(CamPixel *im0, int w, StreakData *pStr) {
         if (x0 - k < 0 || x0 + k >= w || y0 - k < 0 || y0 + k >= h)
           break;
 
-        /* scan a box for pixels with radius [k .. k+1] from [x0,y0] */
+        /* gather pixels with radius [k .. k+1] from [x0,y0] */
         ip = &image[w * (y0 - k) + x0]; /* start at center of top row */
         for (y = -k; y <= k; y++) {
           int yy = y * y;
           for (x = -k; x <= k; x++) {
             int rr = x * x + yy;
             if (rr >= inrr && rr < outrr) {
-              int p = (int)(ip[x]);
-              hist[p]++;
-              npix++;
+              if (npix == mpix) {
+                int *newpix = (int *)realloc(pix, 2 * mpix * sizeof(int));
+                if (!newpix) {
+                  free((void *)pix);
+                  return (-1);
+                }
+                pix = newpix;
+                mpix *= 2;
+              }
+              pix[npix++] = (int)(ip[x]);
             }
           }
           ip += w; /* next row, still centered */
         }
       }
 
-      if (npix < minpix)
+      if (npix < minpix) {
+        free((void *)pix);
         return (-1); /* couldn't make it far enough out */
+      }
 
       /* find the pixels at the 16, 50 and 84 percentiles */
-      p16 = p50 = p84 = 0;
-      s16 = (int)floor(npix * 0.16 + 0.5);
-      s50 = (int)floor(npix * 0.50 + 0.5);
-      s84 = (int)floor(npix * 0.84 + 0.5);
-      sum = 0;
-      for (x = 0; x < NCAMPIX; x++) {
-        sum += hist[x];
-        if (p16 == 0 && sum >= s16)
-          p16 = x;
-        if (p50 == 0 && sum >= s50)
-          p50 = x;
-        if (p84 == 0 && sum >= s84)
-          p84 = x;
-      }
+      pixPercentiles(pix, npix, &p16, &p50, &p84);
+      free((void *)pix);
 
 #ifdef SKY_TRACE
       printf("Sky: r=%d npix=%d p16=%d p50=%d p84=%d\n", r, npix, p16, p50, p84);
@@ -2660,6 +2827,65 @@ static int qualifyStreakData(CamPixel *im0, int w, StreakData *pStr) {
       return (0);
     }
 
+    /* rearrange pix[0..n-1] just enough that pix[k] holds the value it would
+     * have if pix[] were sorted, with none larger before it nor smaller after.
+     */
+    static void pixSelect(int pix[], int n, int k) {
+      int lo = 0, hi = n - 1;
+
+      while (lo < hi) {
+        int pivot = pix[(lo + hi) / 2];
+        int i = lo, j = hi;
+
+        while (i <= j) {
+          while (pix[i] < pivot)
+            i++;
+          while (pix[j] > pivot)
+            j--;
+          if (i <= j) {
+            int t = pix[i];
+            pix[i++] = pix[j];
+            pix[j--] = t;
+          }
+        }
+        if (k <= j)
+          hi = j;
+        else if (k >= i)
+          lo = i;
+        else
+          break;
+      }
+    }
+
+    /* find the values at the 16, 50 and 84 percentiles of the n > 0 pix[],
+     * each being the smallest value with at least that fraction at or below
+     * it. this is the same answer a histogram gives but costs only O(n).
+     * N.B. pix[] is rearranged.
+     */
+    static void pixPercentiles(int pix[], int n, int *p16p, int *p50p,
+                               int *p84p) {
+      int s16 = (int)floor(n * 0.16 + 0.5) - 1;
+      int s50 = (int)floor(n * 0.50 + 0.5) - 1;
+      int s84 = (int)floor(n * 0.84 + 0.5) - 1;
+
+      if (s16 < 0)
+        s16 = 0;
+      if (s50 < 0)
+        s50 = 0;
+      if (s84 < 0)
+        s84 = 0;
+
+      pixSelect(pix, n, s50);
+      if (s16 < s50)
+        pixSelect(pix, s50, s16);
+      if (s84 > s50)
+        pixSelect(pix + s50 + 1, n - s50 - 1, s84 - s50 - 1);
+
+      *p16p = pix[s16];
+      *p50p = pix[s50];
+      *p84p = pix[s84];
+    }
+
     /* find the total number of pixels within a circle about [x0,y0] of radius r,
      * and the sum of those pixels.
      */
@@ -2695,12 +2921,17 @@ static int qualifyStreakData(CamPixel *im0, int w, StreakData *pStr) {
 
     /* reload ipcfn if never loaded before or it has been modified since last load.
      * exit if trouble.
+     * N.B. callers in several threads should each make their first call after
+     * one in the main thread, so the values never change while in use.
      */
     void loadIpCfg() {
+      static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
       static char telfn[sizeof(ipcfn) + 100];
       static time_t lastload;
       struct stat s;
 
+      pthread_mutex_lock(&lock);
+
       //	if (!lastload)
       telfixpath(telfn, ipcfn);
 
@@ -2714,8 +2945,12 @@ static int qualifyStreakData(CamPixel *im0, int w, StreakData *pStr) {
           cfgFileError(ipcfn, n, (CfgPrFp)printf, ipcfg, NIPCFG);
           exit(1);
         }
+        /* optional, older ip.cfg files do not have it */
+        (void)read1CfgEntry(0, ipcfn, "STARFAST", CFG_INT, &STARFAST, 0);
         lastload = s.st_mtime;
       }
+
+      pthread_mutex_unlock(&lock);
     }
 
     //
@@ -2729,6 +2964,33 @@ static int qualifyStreakData(CamPixel *im0, int w, StreakData *pStr) {
 
     char *getCurrentIpCfgPath(void) { return ipcfn; }
 
+    /* return a hash of the ip.cfg values that change what findStars() and
+     * starStats() find, so results saved with it can be checked later.
+     */
+    unsigned int ipCfgSum(void) {
+      unsigned int sum = 2166136261u;
+      unsigned char *p;
+      int i, j, n;
+
+      loadIpCfg();
+
+      /* all those before the FWHM STATS section, then STARFAST */
+      for (i = 0; i <= NIPCFG; i++) {
+        if (i < NIPCFG && strcmp(ipcfg[i].name, "NFWHM") == 0)
+          i = NIPCFG;
+        if (i == NIPCFG) {
+          p = (unsigned char *)&STARFAST;
+          n = sizeof(STARFAST);
+        } else {
+          p = (unsigned char *)ipcfg[i].valp;
+          n = ipcfg[i].type == CFG_DBL ? sizeof(double) : sizeof(int);
+        }
+        for (j = 0; j < n; j++)
+          sum = (sum ^ p[j]) * 16777619u;
+      }
+      return (sum);
+    }
+
     void setIpCfgPath(char *pathname) { strncpy(ipcfn, pathname, sizeof(ipcfn)); }
 
     /* For CVS Only -- Do Not Edit */
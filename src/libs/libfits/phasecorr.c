@@ -0,0 +1,445 @@
+/* align images by phase correlation, and co-add them at sub-pixel shifts.
+ *
+ * unlike align2FITS(), which compares row and column sums over +/- MAXSHIFT,
+ * phaseAlignFITS() correlates the whole of both images at once: each is
+ * cleared of sky, zero padded to a power-of-two square tile, transformed with
+ * a real-to-complex FFT, and the normalized cross-power spectrum transformed
+ * back gives a single sharp peak at the shift, which we interpolate to a
+ * fraction of a pixel. any shift that leaves some overlap can be found, and
+ * images too big for a PCMAXN tile are first aligned binned, then refined on
+ * a full resolution tile from the middle of the overlap.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "P_.h"
+#include "astro.h"
+#include "fits.h"
+
+#define	PCMAXN		1024	/* largest FFT tile side, pixels */
+#define	PCMINN		32	/* smallest overlap worth correlating, pixels */
+#define	PCSIGMA		3.0	/* use pixels this many sd above sky */
+#define	PCSMOOTH	1.0	/* gaussian sd of the correlation peak, pixels */
+#define	PCMINSNR	8.0	/* min peak/rms of correlation surface */
+
+typedef struct {
+    double re, im;
+} Cplx;
+
+static int correlate (CamPixel *im1, CamPixel *im2, int w, int x1, int y1,
+    int x2, int y2, int nx, int ny, int bin, double *sxp, double *syp);
+static void prepTile (CamPixel *im, int w, int x0, int y0, int nx, int ny,
+    int bin, int n, double *t);
+static double peakOffset (double cm, double c0, double cp);
+static void rfft2 (double *t, int n, Cplx *tw, Cplx *z, Cplx *s);
+static void irfft2 (Cplx *s, int n, Cplx *tw, Cplx *z, double *t);
+static void fft (Cplx *a, int n, Cplx *tw, int inv);
+
+/* find the shift dx and dy of image2 so it most closely matches fip1, ie,
+ * such that pixel x,y of image2 lies at x+dx,y+dy of fip1, to a fraction of
+ * a pixel.
+ * return 0 if ok, else -1 if no convincing match was found.
+ */
+int
+phaseAlignFITS (FImage *fip1, char *image2, double *dxp, double *dyp)
+{
+	CamPixel *im1 = (CamPixel *)fip1->image;
+	CamPixel *im2 = (CamPixel *)image2;
+	int w = fip1->sw, h = fip1->sh;
+	double sx, sy;
+	int bin, cx, cy, nx, ny, x1, y1;
+
+	/* first over all of both images, binned as need be to fit a tile */
+	for (bin = 1; w/bin > PCMAXN || h/bin > PCMAXN; bin *= 2)
+	    continue;
+	if (correlate (im1, im2, w, 0, 0, 0, 0, w, h, bin, &sx, &sy) < 0)
+	    return (-1);
+	*dxp = sx*bin;
+	*dyp = sy*bin;
+	if (bin == 1)
+	    return (0);
+
+	/* then refine at full resolution over the middle of the overlap */
+	cx = (int)floor(*dxp + 0.5);
+	cy = (int)floor(*dyp + 0.5);
+	nx = w - abs(cx);
+	ny = h - abs(cy);
+	if (nx > PCMAXN)
+	    nx = PCMAXN;
+	if (ny > PCMAXN)
+	    ny = PCMAXN;
+	if (nx < PCMINN || ny < PCMINN)
+	    return (0);
+	x1 = (w + cx - nx)/2;
+	y1 = (h + cy - ny)/2;
+	if (correlate (im1, im2, w, x1, y1, x1-cx, y1-cy, nx, ny, 1, &sx, &sy) < 0)
+	    return (0);
+	*dxp = cx + sx;
+	*dyp = cy + sy;
+	return (0);
+}
+
+/* add image2 to fip1 after shifting image2 by dx and dy pixels, as found by
+ * phaseAlignFITS(), resampling it bilinearly for the fractional part.
+ * pixels of fip1 that image2 does not cover are left alone.
+ */
+void
+alignAddFrac (FImage *fip1, char *image2, double dx, double dy)
+{
+	CamPixel *p1 = (CamPixel *)fip1->image;
+	CamPixel *p2 = (CamPixel *)image2;
+	int w = fip1->sw, h = fip1->sh;
+	int x10, x11, y10, y11;		/* range of fip1 covered by image2 */
+	int ix, iy, x, y;
+	double fx, fy;
+
+	/* pixel x of fip1 comes from x-dx of image2 = ix+fx, 0 <= fx < 1 */
+	ix = (int)floor(-dx);
+	fx = -dx - ix;
+	iy = (int)floor(-dy);
+	fy = -dy - iy;
+
+	/* need ix and ix+1 in image2 unless fx is 0 */
+	x10 = ix < 0 ? -ix : 0;
+	x11 = (fx > 0 ? w-1 : w) - ix;
+	if (x11 > w)
+	    x11 = w;
+	y10 = iy < 0 ? -iy : 0;
+	y11 = (fy > 0 ? h-1 : h) - iy;
+	if (y11 > h)
+	    y11 = h;
+
+	for (y = y10; y < y11; y++) {
+	    CamPixel *row1 = &p1[w*y];
+	    CamPixel *r0 = &p2[w*(y+iy)];
+	    CamPixel *r1 = fy > 0 ? r0 + w : r0;
+
+	    for (x = x10; x < x11; x++) {
+		int x2 = x + ix;
+		int x3 = fx > 0 ? x2 + 1 : x2;
+		double v = (1-fy)*((1-fx)*r0[x2] + fx*r0[x3])
+				    + fy*((1-fx)*r1[x2] + fx*r1[x3]);
+		int sum = row1[x] + (int)floor(v + 0.5);
+
+		row1[x] = sum > MAXCAMPIX ? MAXCAMPIX : sum;
+	    }
+	}
+}
+
+/* phase correlate the nx x ny region at x1,y1 of im1 with that at x2,y2 of
+ * im2, both of width w, binning each bin x bin.
+ * return 0 and the shift in binned pixels of the im2 region to match im1's in
+ * *sxp, *syp, else -1.
+ */
+static int
+correlate (CamPixel *im1, CamPixel *im2, int w, int x1, int y1, int x2, int y2,
+int nx, int ny, int bin, double *sxp, double *syp)
+{
+	int bnx = nx/bin, bny = ny/bin;
+	int n, nh, i, k, u, v, px, py, ok;
+	double *t1, *t2, *c, *taper;
+	Cplx *s1, *s2, *tw, *z;
+	double peak, sum2, rms, g;
+
+	if (bnx < PCMINN || bny < PCMINN)
+	    return (-1);
+	for (n = PCMINN; n < bnx || n < bny; n *= 2)
+	    continue;
+	nh = n/2 + 1;
+
+	t1 = (double *) malloc (n*n*sizeof(double));
+	t2 = (double *) malloc (n*n*sizeof(double));
+	s1 = (Cplx *) malloc (n*nh*sizeof(Cplx));
+	s2 = (Cplx *) malloc (n*nh*sizeof(Cplx));
+	taper = (double *) malloc (n*sizeof(double));
+	tw = (Cplx *) malloc (n/2*sizeof(Cplx));
+	z = (Cplx *) malloc (n*sizeof(Cplx));
+	if (!t1 || !t2 || !s1 || !s2 || !taper || !tw || !z) {
+	    if (t1) free ((void *)t1);
+	    if (t2) free ((void *)t2);
+	    if (s1) free ((void *)s1);
+	    if (s2) free ((void *)s2);
+	    if (taper) free ((void *)taper);
+	    if (tw) free ((void *)tw);
+	    if (z) free ((void *)z);
+	    return (-1);
+	}
+
+	prepTile (im1, w, x1, y1, bnx*bin, bny*bin, bin, n, t1);
+	prepTile (im2, w, x2, y2, bnx*bin, bny*bin, bin, n, t2);
+	for (i = 0; i < n/2; i++) {
+	    tw[i].re = cos (2*PI*i/n);
+	    tw[i].im = -sin (2*PI*i/n);
+	}
+	rfft2 (t1, n, tw, z, s1);
+	rfft2 (t2, n, tw, z, s2);
+
+	/* normalized cross-power spectrum, tapered by a gaussian so the peak
+	 * comes back with a known smooth shape we can interpolate.
+	 */
+	g = -2*PI*PI*PCSMOOTH*PCSMOOTH/((double)n*n);
+	for (v = 0; v < n; v++) {
+	    int fv = v <= n/2 ? v : v - n;
+	    taper[v] = exp (g*fv*fv);
+	}
+	for (v = 0; v < n; v++) {
+	    for (u = 0; u < nh; u++) {
+		Cplx *a = &s1[v*nh+u], *b = &s2[v*nh+u];
+		double re = a->re*b->re + a->im*b->im;
+		double im = a->im*b->re - a->re*b->im;
+		double mag = sqrt(re*re + im*im);
+
+		if (mag > 0) {
+		    double f = taper[u]*taper[v]/mag;
+
+		    s1[v*nh+u].re = re*f;
+		    s1[v*nh+u].im = im*f;
+		} else
+		    s1[v*nh+u].re = s1[v*nh+u].im = 0;
+	    }
+	}
+	c = t2;
+	irfft2 (s1, n, tw, z, c);
+
+	/* find the peak and how it stands above the rest */
+	k = 0;
+	sum2 = 0;
+	for (i = 0; i < n*n; i++) {
+	    sum2 += c[i]*c[i];
+	    if (c[i] > c[k])
+		k = i;
+	}
+	peak = c[k];
+	rms = sqrt(sum2/(n*n));
+	px = k % n;
+	py = k / n;
+
+	ok = peak > 0 && peak >= PCMINSNR*rms;
+	if (ok) {
+	    *sxp = px + peakOffset (c[py*n + (px+n-1)%n], peak,
+						    c[py*n + (px+1)%n]);
+	    *syp = py + peakOffset (c[((py+n-1)%n)*n + px], peak,
+						    c[((py+1)%n)*n + px]);
+	    if (*sxp > n/2)
+		*sxp -= n;
+	    if (*syp > n/2)
+		*syp -= n;
+	}
+
+	free ((void *)t1);
+	free ((void *)t2);
+	free ((void *)s1);
+	free ((void *)s2);
+	free ((void *)taper);
+	free ((void *)tw);
+	free ((void *)z);
+	return (ok ? 0 : -1);
+}
+
+/* fill the n x n tile t with the nx x ny region at x0,y0 of im, of width w,
+ * binned bin x bin, less the sky and with only what stands PCSIGMA above it,
+ * and zero elsewhere.
+ */
+static void
+prepTile (CamPixel *im, int w, int x0, int y0, int nx, int ny, int bin, int n,
+double *t)
+{
+	int bnx = nx/bin, bny = ny/bin, npix = bnx*bny;
+	int *hist;
+	int x, y, i, j, q1, q2, q3, cum;
+	double thresh;
+
+	memset ((void *)t, 0, n*n*sizeof(double));
+	for (y = 0; y < bny; y++) {
+	    double *trow = &t[y*n];
+
+	    for (j = 0; j < bin; j++) {
+		CamPixel *row = &im[(y0 + y*bin + j)*w + x0];
+
+		for (x = 0; x < bnx; x++)
+		    for (i = 0; i < bin; i++)
+			trow[x] += *row++;
+	    }
+	    for (x = 0; x < bnx; x++)
+		trow[x] /= bin*bin;
+	}
+
+	/* sky and its noise from the quartiles, so stars do not count */
+	hist = (int *) calloc (NCAMPIX, sizeof(int));
+	if (!hist)
+	    return;
+	for (y = 0; y < bny; y++)
+	    for (x = 0; x < bnx; x++)
+		hist[(int)t[y*n+x]]++;
+	q1 = q2 = q3 = -1;
+	for (cum = i = 0; i < NCAMPIX; i++) {
+	    cum += hist[i];
+	    if (q1 < 0 && cum >= npix/4)
+		q1 = i;
+	    if (q2 < 0 && cum >= npix/2)
+		q2 = i;
+	    if (q3 < 0 && cum >= 3*npix/4) {
+		q3 = i;
+		break;
+	    }
+	}
+	free ((void *)hist);
+
+	thresh = q2 + PCSIGMA*(q3 - q1 > 1 ? q3 - q1 : 1)/1.349;
+	for (y = 0; y < bny; y++)
+	    for (x = 0; x < bnx; x++) {
+		double *tp = &t[y*n+x];
+
+		*tp = *tp > thresh ? *tp - thresh : 0;
+	    }
+}
+
+/* given 3 samples of a peak centered on the middle one, return the offset of
+ * the true peak from the middle, assuming it is gaussian.
+ */
+static double
+peakOffset (double cm, double c0, double cp)
+{
+	double lm, l0, lp, d;
+
+	if (cm <= 0 || cp <= 0) {
+	    /* parabola if we can not take logs */
+	    d = cm - 2*c0 + cp;
+	    return (d < 0 ? 0.5*(cm - cp)/d : 0);
+	}
+	lm = log(cm);
+	l0 = log(c0);
+	lp = log(cp);
+	d = lm - 2*l0 + lp;
+	if (d >= 0)
+	    return (0);
+	d = 0.5*(lm - lp)/d;
+	return (d < -0.5 ? -0.5 : (d > 0.5 ? 0.5 : d));
+}
+
+/* real-to-complex FFT of the n x n tile t into the n x (n/2+1) half spectrum
+ * s, using the fft() twiddles tw and n scratch values at z. rows are done two
+ * at a time as the real and imaginary parts of one complex transform, then
+ * the n/2+1 columns.
+ * N.B. n must be a power of 2.
+ */
+static void
+rfft2 (double *t, int n, Cplx *tw, Cplx *z, Cplx *s)
+{
+	int nh = n/2 + 1;
+	int r, k;
+
+	for (r = 0; r < n; r += 2) {
+	    double *a = &t[r*n], *b = &t[(r+1)*n];
+	    Cplx *sa = &s[r*nh], *sb = &s[(r+1)*nh];
+
+	    for (k = 0; k < n; k++) {
+		z[k].re = a[k];
+		z[k].im = b[k];
+	    }
+	    fft (z, n, tw, 0);
+	    for (k = 0; k < nh; k++) {
+		Cplx *zk = &z[k], *znk = &z[(n-k)%n];
+
+		/* A = (Z[k] + conj Z[n-k])/2, B = (Z[k] - conj Z[n-k])/2i */
+		sa[k].re = 0.5*(zk->re + znk->re);
+		sa[k].im = 0.5*(zk->im - znk->im);
+		sb[k].re = 0.5*(zk->im + znk->im);
+		sb[k].im = -0.5*(zk->re - znk->re);
+	    }
+	}
+
+	for (k = 0; k < nh; k++) {
+	    for (r = 0; r < n; r++)
+		z[r] = s[r*nh+k];
+	    fft (z, n, tw, 0);
+	    for (r = 0; r < n; r++)
+		s[r*nh+k] = z[r];
+	}
+}
+
+/* inverse of rfft2(): complex-to-real FFT of the n x (n/2+1) half spectrum s,
+ * which is destroyed, into the n x n tile t, scaled by 1/(n*n). z is as for
+ * rfft2().
+ */
+static void
+irfft2 (Cplx *s, int n, Cplx *tw, Cplx *z, double *t)
+{
+	int nh = n/2 + 1;
+	double scale = 1.0/((double)n*n);
+	int r, k;
+
+	for (k = 0; k < nh; k++) {
+	    for (r = 0; r < n; r++)
+		z[r] = s[r*nh+k];
+	    fft (z, n, tw, 1);
+	    for (r = 0; r < n; r++)
+		s[r*nh+k] = z[r];
+	}
+
+	/* each pair of rows is real and imaginary of one complex transform */
+	for (r = 0; r < n; r += 2) {
+	    Cplx *sa = &s[r*nh], *sb = &s[(r+1)*nh];
+	    double *a = &t[r*n], *b = &t[(r+1)*n];
+
+	    for (k = 0; k < nh; k++) {
+		z[k].re = sa[k].re - sb[k].im;
+		z[k].im = sa[k].im + sb[k].re;
+	    }
+	    for (k = nh; k < n; k++) {
+		/* hermitian: row[k] = conj row[n-k] */
+		z[k].re = sa[n-k].re + sb[n-k].im;
+		z[k].im = -sa[n-k].im + sb[n-k].re;
+	    }
+	    fft (z, n, tw, 1);
+	    for (k = 0; k < n; k++) {
+		a[k] = z[k].re*scale;
+		b[k] = z[k].im*scale;
+	    }
+	}
+}
+
+/* in-place radix-2 complex FFT of the n values at a, or the inverse, without
+ * the 1/n, if inv. tw[k] must be exp(-2 pi i k/n), for k < n/2.
+ * N.B. n must be a power of 2.
+ */
+static void
+fft (Cplx *a, int n, Cplx *tw, int inv)
+{
+	double sgn = inv ? -1 : 1;
+	int i, j, m, len;
+
+	/* bit reverse */
+	for (i = 1, j = 0; i < n; i++) {
+	    for (m = n >> 1; j & m; m >>= 1)
+		j ^= m;
+	    j |= m;
+	    if (i < j) {
+		Cplx tmp = a[i];
+		a[i] = a[j];
+		a[j] = tmp;
+	    }
+	}
+
+	for (len = 2; len <= n; len <<= 1) {
+	    int half = len/2, step = n/len;
+
+	    for (i = 0; i < n; i += len) {
+		Cplx *p = &a[i], *q = &a[i+half];
+
+		for (j = 0; j < half; j++) {
+		    double cr = tw[j*step].re, ci = sgn*tw[j*step].im;
+		    double tr = q[j].re*cr - q[j].im*ci;
+		    double ti = q[j].re*ci + q[j].im*cr;
+
+		    q[j].re = p[j].re - tr;
+		    q[j].im = p[j].im - ti;
+		    p[j].re += tr;
+		    p[j].im += ti;
+		}
+	    }
+	}
+}
@@ -0,0 +1,572 @@
+/* stack a sequence of frames into one, shifting each to match a reference.
+ *
+ * stackFITS() first reads each frame once, in parallel, to find its shift
+ * from the reference with phaseAlignFITS(), its sky level and its noise. it
+ * then builds the result in bands of whole rows: each worker takes the next
+ * band, reads just the rows of every frame that land on it, resamples them
+ * at the sub-pixel shift into a float plane, and combines the planes pixel by
+ * pixel by mean, median or sigma clipping. so memory depends on the band
+ * size, which is chosen to fit StackOpts.maxmem, not on the number of frames.
+ *
+ * frames are offset to the sky of the reference before they are combined,
+ * and may be weighted by their inverse noise variance. the result is a frame
+ * like the reference, with provenance keywords telling how it was made.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "P_.h"
+#include "astro.h"
+#include "fits.h"
+#include "strops.h"
+
+#define	MAXTHR		64		/* max worker threads */
+#define	DEFMAXMEM	(64L<<20)	/* default StackOpts.maxmem, bytes */
+#define	MAXCLIP		5		/* max STK_CLIP rejection passes */
+
+/* what we know of each frame */
+typedef struct {
+    char *fn;			/* file name */
+    int fd;			/* open on fn for reading bands */
+    long data;			/* offset of pixels in fn */
+    double dx, dy;		/* pixel x,y of fn is x+dx,y+dy of ref */
+    double off;			/* add to bring sky to that of ref */
+    double wt;			/* combining weight */
+    int ok;			/* aligned and in use */
+    char msg[128];		/* why not, if !ok */
+} StkFrame;
+
+/* shared by the worker threads */
+typedef struct {
+    StackOpts *sop;		/* options */
+    FImage *ref;		/* reference frame */
+    StkFrame *fr;		/* all frames */
+    int n;			/* n fr[] */
+    int *use;			/* indices of fr[] in use */
+    int nuse;			/* n use[] */
+    double sky, noise;		/* sky level and noise of ref */
+    CamPixel *out;		/* result pixels */
+    int bh;			/* rows per band */
+    int next;			/* next frame to align, or band to build */
+    long nrej;			/* pixels rejected by STK_CLIP */
+    int err;			/* set if a worker failed */
+    char msg[1024];		/* why */
+    pthread_mutex_t lock;	/* guards next, nrej, err and msg */
+} StkJob;
+
+static void *alignWorker (void *arg);
+static void *bandWorker (void *arg);
+static int buildBand (StkJob *jp, int y0, int ny, CamPixel *rows, float *planes,
+    double *v, double *w, double *t, long *nrejp);
+static double combine (int how, double ksig, double noise, double v[],
+    double w[], double t[], int n, long *nrejp);
+static double median (double v[], int n);
+static void skyStats (CamPixel *im, int npix, double *skyp, double *noisep);
+static int runWorkers (int nthr, void *(*fn)(void *), StkJob *jp);
+
+/* stack the n FITS files fns[] into fip as told by sop.
+ * fip gets the header of fns[sop->ref] with provenance keywords added, and
+ * malloced pixels. frames that can not be read or aligned are left out and
+ * noted in the header.
+ * return number of frames used if ok, else -1 with excuse in msg.
+ * N.B. caller must resetFImage(fip) if we return >= 0.
+ */
+int
+stackFITS (char *fns[], int n, StackOpts *sop, FImage *fip, char msg[])
+{
+	StackOpts opts = *sop;
+	char buf[128];
+	FImage ref;
+	StkFrame *fr;
+	StkJob job;
+	int fd, i, nthr, w, h;
+	int ret = -1;
+	long maxmem;
+
+	if (n < 1 || opts.ref < 0 || opts.ref >= n) {
+	    sprintf (msg, "No reference frame");
+	    return (-1);
+	}
+
+	/* the reference sets the size, sky and header of the result */
+	fd = open (fns[opts.ref], O_RDONLY);
+	if (fd < 0) {
+	    sprintf (msg, "%s: %s", fns[opts.ref], strerror(errno));
+	    return (-1);
+	}
+	initFImage (&ref);
+	if (readFITS (fd, &ref, buf) < 0) {
+	    sprintf (msg, "%s: %s", fns[opts.ref], buf);
+	    close (fd);
+	    return (-1);
+	}
+	close (fd);
+	w = ref.sw;
+	h = ref.sh;
+
+	fr = (StkFrame *) calloc (n, sizeof(StkFrame));
+	job.use = (int *) malloc (n*sizeof(int));
+	job.out = (CamPixel *) malloc (w*h*sizeof(CamPixel));
+	if (!fr || !job.use || !job.out) {
+	    sprintf (msg, "No memory to stack %d frames", n);
+	    if (fr) free ((void *)fr);
+	    if (job.use) free ((void *)job.use);
+	    if (job.out) free ((void *)job.out);
+	    resetFImage (&ref);
+	    return (-1);
+	}
+	for (i = 0; i < n; i++) {
+	    fr[i].fn = fns[i];
+	    fr[i].fd = -1;
+	}
+
+	nthr = opts.nthreads > 0 ? opts.nthreads
+				 : (int) sysconf (_SC_NPROCESSORS_ONLN);
+	if (nthr < 1)
+	    nthr = 1;
+	if (nthr > MAXTHR)
+	    nthr = MAXTHR;
+	if (opts.ksig <= 0)
+	    opts.ksig = 3;
+
+	job.sop = &opts;
+	job.ref = &ref;
+	job.fr = fr;
+	job.n = n;
+	job.next = 0;
+	job.nrej = 0;
+	job.err = 0;
+	pthread_mutex_init (&job.lock, NULL);
+	skyStats ((CamPixel *)ref.image, w*h, &job.sky, &job.noise);
+
+	/* find each frame's shift, sky and noise */
+	if (runWorkers (nthr < n ? nthr : n, alignWorker, &job) < 0) {
+	    sprintf (msg, "Can not start threads");
+	    goto out;
+	}
+	job.nuse = 0;
+	for (i = 0; i < n; i++)
+	    if (fr[i].ok)
+		job.use[job.nuse++] = i;
+	if (!fr[opts.ref].ok) {
+	    sprintf (msg, "%s: %s", fr[opts.ref].fn, fr[opts.ref].msg);
+	    goto out;
+	}
+
+	/* as many rows per band as fit our share of maxmem */
+	maxmem = opts.maxmem > 0 ? opts.maxmem : DEFMAXMEM;
+	job.bh = maxmem/nthr/((long)job.nuse*w*(sizeof(float)+sizeof(CamPixel)));
+	if (job.bh < 1)
+	    job.bh = 1;
+	if (job.bh > h)
+	    job.bh = h;
+	if (nthr > (h + job.bh - 1)/job.bh)
+	    nthr = (h + job.bh - 1)/job.bh;
+
+	job.next = 0;
+	if (runWorkers (nthr, bandWorker, &job) < 0) {
+	    sprintf (msg, "Can not start threads");
+	    goto out;
+	}
+	if (job.err) {
+	    strcpy (msg, job.msg);
+	    goto out;
+	}
+
+	/* result is the reference header with the new pixels and provenance */
+	initFImage (fip);
+	copyFITSHeader (fip, &ref);
+	fip->image = (char *)job.out;
+	job.out = NULL;
+	setIntFITS (fip, "NCOMBINE", job.nuse, "Number of frames stacked");
+	setStringFITS (fip, "STKMETH", opts.how == STK_MEDIAN ? "median" :
+			    (opts.how == STK_CLIP ? "sigclip" : "mean"),
+			    "How stacked frames were combined");
+	if (opts.how == STK_CLIP) {
+	    setRealFITS (fip, "STKKSIG", opts.ksig, 3, "Clip at this many sd");
+	    setIntFITS (fip, "STKNREJ", (int)job.nrej,
+					    "Number of pixels clipped");
+	}
+	setLogicalFITS (fip, "STKWGHT", opts.weight,
+				    "Frames weighted by inverse noise variance");
+	setStringFITS (fip, "STKREF", basenm(fr[opts.ref].fn),
+						"Reference frame of stack");
+	for (i = 0; i < n; i++) {
+	    char name[16], val[128];
+
+	    sprintf (name, "STK%03d", i+1);
+	    if (fr[i].ok)
+		sprintf (val, "%.40s %.2f %.2f", basenm(fr[i].fn), fr[i].dx,
+								fr[i].dy);
+	    else
+		sprintf (val, "%.40s unused", basenm(fr[i].fn));
+	    setStringFITS (fip, name, val, fr[i].ok ? "Frame, dx, dy" : NULL);
+	}
+	sprintf (buf, "Stacked %d of %d frames", job.nuse, n);
+	setCommentFITS (fip, "HISTORY", buf);
+	ret = job.nuse;
+
+    out:
+	for (i = 0; i < n; i++)
+	    if (fr[i].fd >= 0)
+		close (fr[i].fd);
+	free ((void *)fr);
+	free ((void *)job.use);
+	if (job.out)
+	    free ((void *)job.out);
+	pthread_mutex_destroy (&job.lock);
+	resetFImage (&ref);
+	return (ret);
+}
+
+/* read, align and measure frames until there are no more */
+static void *
+alignWorker (void *arg)
+{
+	StkJob *jp = (StkJob *)arg;
+	FImage *ref = jp->ref;
+
+	while (1) {
+	    StkFrame *fp;
+	    double sky, noise;
+	    FImage fim;
+	    int i, fd;
+
+	    pthread_mutex_lock (&jp->lock);
+	    i = jp->next++;
+	    pthread_mutex_unlock (&jp->lock);
+	    if (i >= jp->n)
+		break;
+	    fp = &jp->fr[i];
+
+	    fd = open (fp->fn, O_RDONLY);
+	    if (fd < 0) {
+		sprintf (fp->msg, "%.100s", strerror(errno));
+		continue;
+	    }
+	    initFImage (&fim);
+	    if (readFITS (fd, &fim, fp->msg) < 0) {
+		close (fd);
+		continue;
+	    }
+	    if (fim.sw != ref->sw || fim.sh != ref->sh) {
+		sprintf (fp->msg, "must be %d x %d", ref->sw, ref->sh);
+		resetFImage (&fim);
+		close (fd);
+		continue;
+	    }
+
+	    if (i == jp->sop->ref) {
+		fp->dx = fp->dy = 0;
+	    } else if (phaseAlignFITS (ref, fim.image, &fp->dx, &fp->dy) < 0) {
+		sprintf (fp->msg, "can not be aligned");
+		resetFImage (&fim);
+		close (fd);
+		continue;
+	    }
+
+	    /* the header is whole FITS blocks, END included */
+	    fp->data = (long)((fim.nvar + FITS_HROWS)/FITS_HROWS)
+						    * FITS_HROWS*sizeof(FITSRow);
+	    skyStats ((CamPixel *)fim.image, fim.sw*fim.sh, &sky, &noise);
+	    fp->off = jp->sky - sky;
+	    fp->wt = jp->sop->weight ? 1.0/(noise*noise) : 1.0;
+	    fp->fd = fd;
+	    fp->ok = 1;
+	    resetFImage (&fim);
+	}
+
+	return (NULL);
+}
+
+/* build bands of the result until there are no more */
+static void *
+bandWorker (void *arg)
+{
+	StkJob *jp = (StkJob *)arg;
+	int w = jp->ref->sw, h = jp->ref->sh;
+	CamPixel *rows;
+	float *planes;
+	double *v, *wt, *t;
+	long nrej = 0;
+
+	rows = (CamPixel *) malloc ((jp->bh+2)*w*sizeof(CamPixel));
+	planes = (float *) malloc ((long)jp->nuse*jp->bh*w*sizeof(float));
+	v = (double *) malloc (jp->nuse*sizeof(double));
+	wt = (double *) malloc (jp->nuse*sizeof(double));
+	t = (double *) malloc (jp->nuse*sizeof(double));
+	if (!rows || !planes || !v || !wt || !t) {
+	    pthread_mutex_lock (&jp->lock);
+	    jp->err = 1;
+	    sprintf (jp->msg, "No memory for %d rows of %d frames", jp->bh,
+								    jp->nuse);
+	    pthread_mutex_unlock (&jp->lock);
+	} else {
+	    while (1) {
+		int y0;
+
+		pthread_mutex_lock (&jp->lock);
+		y0 = jp->err ? h : jp->next;
+		jp->next += jp->bh;
+		pthread_mutex_unlock (&jp->lock);
+		if (y0 >= h)
+		    break;
+		if (buildBand (jp, y0, y0 + jp->bh > h ? h - y0 : jp->bh, rows,
+						planes, v, wt, t, &nrej) < 0)
+		    break;
+	    }
+	}
+
+	pthread_mutex_lock (&jp->lock);
+	jp->nrej += nrej;
+	pthread_mutex_unlock (&jp->lock);
+
+	if (rows) free ((void *)rows);
+	if (planes) free ((void *)planes);
+	if (v) free ((void *)v);
+	if (wt) free ((void *)wt);
+	if (t) free ((void *)t);
+	return (NULL);
+}
+
+/* build the ny rows of the result starting at y0, adding to *nrejp the number
+ * of pixels clipped.
+ * rows and planes are scratch for (ny+2) rows of one frame and ny rows of all
+ * frames in use; v, w and t for one value, weight and temp of each.
+ * return 0 if ok, else -1 with jp->err and msg set.
+ */
+static int
+buildBand (StkJob *jp, int y0, int ny, CamPixel *rows, float *planes,
+double *v, double *w, double *t, long *nrejp)
+{
+	StackOpts *sop = jp->sop;
+	int sw = jp->ref->sw, sh = jp->ref->sh;
+	int npix = ny*sw;
+	int i, j, x, y;
+
+	/* resample the rows of each frame that fall on this band */
+	for (j = 0; j < jp->nuse; j++) {
+	    StkFrame *fp = &jp->fr[jp->use[j]];
+	    float *pl = &planes[(long)j*npix];
+	    int ix = (int)floor(-fp->dx), iy = (int)floor(-fp->dy);
+	    double fx = -fp->dx - ix, fy = -fp->dy - iy;
+	    int ry0 = y0 + iy, ry1 = y0 + ny + iy + 1;	/* rows we need */
+	    long nb;
+
+	    if (ry0 < 0)
+		ry0 = 0;
+	    if (ry1 > sh)
+		ry1 = sh;
+	    if (ry1 > ry0) {
+		nb = (long)(ry1 - ry0)*sw*sizeof(CamPixel);
+		if (pread (fp->fd, (void *)rows, nb,
+				fp->data + (long)ry0*sw*sizeof(CamPixel)) != nb) {
+		    pthread_mutex_lock (&jp->lock);
+		    jp->err = 1;
+		    sprintf (jp->msg, "%s: short read", fp->fn);
+		    pthread_mutex_unlock (&jp->lock);
+		    return (-1);
+		}
+		unFITSPixels ((char *)rows, (ry1 - ry0)*sw);
+	    }
+
+	    /* pixel x,y of the result is x-dx,y-dy = ix+fx,iy+fy of frame.
+	     * NAN where the frame does not cover it.
+	     */
+	    for (y = 0; y < ny; y++) {
+		int r = y0 + y + iy;
+		int r1 = fy > 0 ? r + 1 : r;
+		CamPixel *p0 = &rows[(r - ry0)*sw];
+		CamPixel *p1 = &rows[(r1 - ry0)*sw];
+		float *out = &pl[y*sw];
+
+		if (r < 0 || r1 >= sh) {
+		    for (x = 0; x < sw; x++)
+			out[x] = NAN;
+		    continue;
+		}
+		for (x = 0; x < sw; x++) {
+		    int c = x + ix;
+		    int c1 = fx > 0 ? c + 1 : c;
+
+		    if (c < 0 || c1 >= sw)
+			out[x] = NAN;
+		    else
+			out[x] = (1-fy)*((1-fx)*p0[c] + fx*p0[c1])
+				    + fy*((1-fx)*p1[c] + fx*p1[c1]) + fp->off;
+		}
+	    }
+	}
+
+	/* combine the frames that cover each pixel */
+	for (i = 0; i < npix; i++) {
+	    CamPixel *op = &jp->out[(long)y0*sw + i];
+	    double r;
+	    int k;
+
+	    for (k = j = 0; j < jp->nuse; j++) {
+		float p = planes[(long)j*npix + i];
+
+		if (!isnan(p)) {
+		    v[k] = p;
+		    w[k] = jp->fr[jp->use[j]].wt;
+		    k++;
+		}
+	    }
+	    r = combine (sop->how, sop->ksig, jp->noise, v, w, t, k, nrejp);
+	    *op = r < 0 ? 0 : (r > MAXCAMPIX ? MAXCAMPIX : (CamPixel)(r + 0.5));
+	}
+
+	return (0);
+}
+
+/* combine the n values v[] with weights w[] as told by how, using t[] as
+ * scratch for n values. noise is the sd of one frame, below which STK_CLIP
+ * never takes the spread of the values to be.
+ * if nrejp, add to it the number of values STK_CLIP rejected.
+ * N.B. v[] and w[] may be changed.
+ */
+static double
+combine (int how, double ksig, double noise, double v[], double w[],
+double t[], int n, long *nrejp)
+{
+	double sw, swv;
+	int i, k, pass;
+
+	if (n == 0)
+	    return (0);
+
+	switch (how) {
+	case STK_MEDIAN:
+	    return (median (v, n));
+
+	case STK_CLIP:
+	    /* drop values more than ksig sd from the median until none go.
+	     * sd is from the median absolute deviation, so the very outliers
+	     * we are after do not inflate it. but with whole pixel values that
+	     * is 0 whenever most of them agree, so it is never less than noise.
+	     */
+	    for (pass = 0; pass < MAXCLIP && n > 2; pass++) {
+		double m, sd, lim;
+
+		memcpy ((void *)t, (void *)v, n*sizeof(double));
+		m = median (t, n);
+		for (i = 0; i < n; i++)
+		    t[i] = fabs(v[i] - m);
+		sd = 1.4826*median (t, n);
+		lim = ksig*(sd > noise ? sd : noise);
+		for (k = i = 0; i < n; i++)
+		    if (fabs(v[i] - m) <= lim) {
+			v[k] = v[i];
+			w[k] = w[i];
+			k++;
+		    }
+		if (k == n)
+		    break;
+		if (nrejp)
+		    *nrejp += n - k;
+		n = k;
+	    }
+	    /* FALLTHRU */
+
+	default:
+	    sw = swv = 0;
+	    for (i = 0; i < n; i++) {
+		sw += w[i];
+		swv += w[i]*v[i];
+	    }
+	    return (sw > 0 ? swv/sw : 0);
+	}
+}
+
+/* return the median of the n values v[], which are reordered */
+static double
+median (double v[], int n)
+{
+	int lo = 0, hi = n-1, k = n/2;
+
+	/* quickselect the k'th smallest */
+	while (lo < hi) {
+	    double piv = v[(lo+hi)/2];
+	    int i = lo, j = hi;
+
+	    while (i <= j) {
+		while (v[i] < piv)
+		    i++;
+		while (v[j] > piv)
+		    j--;
+		if (i <= j) {
+		    double tmp = v[i];
+		    v[i++] = v[j];
+		    v[j--] = tmp;
+		}
+	    }
+	    if (k <= j)
+		hi = j;
+	    else if (k >= i)
+		lo = i;
+	    else
+		break;
+	}
+	return (v[k]);
+}
+
+/* find the sky level and its noise of the npix pixels at im from their
+ * quartiles, so stars do not count.
+ */
+static void
+skyStats (CamPixel *im, int npix, double *skyp, double *noisep)
+{
+	int *hist = (int *) calloc (NCAMPIX, sizeof(int));
+	int q1 = -1, q2 = -1, q3 = -1;
+	int i, cum;
+
+	if (!hist) {
+	    *skyp = 0;
+	    *noisep = 1;
+	    return;
+	}
+	for (i = 0; i < npix; i++)
+	    hist[im[i]]++;
+	for (cum = i = 0; i < NCAMPIX; i++) {
+	    cum += hist[i];
+	    if (q1 < 0 && cum >= npix/4)
+		q1 = i;
+	    if (q2 < 0 && cum >= npix/2)
+		q2 = i;
+	    if (q3 < 0 && cum >= 3*npix/4) {
+		q3 = i;
+		break;
+	    }
+	}
+	free ((void *)hist);
+
+	*skyp = q2;
+	*noisep = (q3 - q1 > 1 ? q3 - q1 : 1)/1.349;
+}
+
+/* run fn(jp) in nthr threads and wait for them all.
+ * return 0 if ok, else -1 if none could be started.
+ */
+static int
+runWorkers (int nthr, void *(*fn)(void *), StkJob *jp)
+{
+	pthread_t thr[MAXTHR];
+	int i, n;
+
+	for (n = i = 0; i < nthr; i++)
+	    if (pthread_create (&thr[n], NULL, fn, (void *)jp) == 0)
+		n++;
+	if (n == 0)
+	    return (-1);
+	for (i = 0; i < n; i++)
+	    pthread_join (thr[i], NULL);
+	return (0);
+}
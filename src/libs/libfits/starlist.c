@@ -0,0 +1,364 @@
+/* binary star list sidecars.
+ *
+ * a star list holds what findStars() and starStats() learn about each star in
+ * a frame, and optionally its RA/Dec, so they need be found only once, when
+ * the frame is reduced. it lives beside the FITS file, with the same name
+ * but suffix STARSFX, and is a StarListHdr followed by nstars StarRecs, in
+ * the order findStars() found them, ready to be mapped straight into memory.
+ *
+ * the header records the size and pixHashFITS() of the pixels and ipCfgSum()
+ * as they were when the stars were measured. a list is only used if all
+ * still match, so it goes stale by itself if the pixels or star finding
+ * parameters change. the hash depends on where each pixel is, so a frame
+ * that has since been flipped or otherwise rearranged does not match.
+ *
+ * useStarList() maps the list of a frame, if it has a good one, and notes it
+ * so later calls to findStars(), findStatStars() and setWCSFITS() on the same
+ * pixels use it rather than searching again.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "P_.h"
+#include "astro.h"
+#include "fits.h"
+
+#define	STARSFX		".stars"	/* suffix of star list files */
+#define	SLMAGIC		"TALONSL"	/* StarListHdr.magic */
+#define	SLVERSION	2		/* StarListHdr.version */
+#define	SLORDER		0x01020304	/* StarListHdr.order as written */
+#define	NUSE		8		/* max lists in use at once */
+
+/* the header at the front of each star list file */
+typedef struct {
+    char magic[8];		/* SLMAGIC */
+    int version;		/* SLVERSION */
+    int order;			/* SLORDER, to detect foreign byte order */
+    int hdrsize;		/* sizeof(StarListHdr) */
+    int recsize;		/* sizeof(StarRec) */
+    int w, h;			/* image size, pixels */
+    unsigned int pixhash;	/* pixHashFITS() of the pixels */
+    unsigned int cfgsum;	/* ipCfgSum() when measured */
+    int nstars;			/* number of StarRecs following */
+    int flags;			/* SL_RADEC if any stars have RA/Dec */
+} StarListHdr;
+
+static StarList *inuse[NUSE];	/* lists noted by useStarList(), newest 1st */
+static int ninuse;		/* n inuse[] */
+static pthread_mutex_t uselock = PTHREAD_MUTEX_INITIALIZER;
+
+/* return a hash of the w x h pixels at im that changes if any pixel changes
+ * or moves, unlike a FITS DATASUM. this is 64 bit FNV-1a over the pixels,
+ * folded to 32 bits.
+ */
+unsigned int
+pixHashFITS (char *im, int w, int h)
+{
+	CamPixel *p = (CamPixel *)im;
+	unsigned long long hash = 0xcbf29ce484222325ULL;
+	long n = (long)w*h;
+	long i;
+
+	for (i = 0; i < n; i++) {
+	    hash ^= p[i];
+	    hash *= 0x100000001b3ULL;
+	}
+	return ((unsigned int)(hash ^ (hash >> 32)));
+}
+
+/* return pixHashFITS() of the w x h pixels at im. if hashp is not NULL the
+ * hash is kept there so the callers of one search find it only once; *hashp
+ * of 0 means not found yet.
+ */
+unsigned int
+pixHashOnce (char *im, int w, int h, unsigned int *hashp)
+{
+	if (!hashp)
+	    return (pixHashFITS (im, w, h));
+	if (!*hashp)
+	    *hashp = pixHashFITS (im, w, h);
+	return (*hashp);
+}
+
+/* fill slfn with the name of the star list for the FITS file fitsfn */
+void
+starListName (char *fitsfn, char slfn[])
+{
+	char *dot, *slash;
+
+	strcpy (slfn, fitsfn);
+	dot = strrchr (slfn, '.');
+	slash = strrchr (slfn, '/');
+	if (dot && (!slash || dot > slash))
+	    *dot = '\0';
+	strcat (slfn, STARSFX);
+}
+
+/* find and measure all the stars in fip, as findStatStars() does, but keep
+ * every one findStars() finds, in its order, with SL_OK set for those
+ * starStats() could measure.
+ * return number of stars and set *srp to a malloced array of them, else -1.
+ * N.B. caller must free *srp if we return >= 0.
+ */
+int
+measureStarList (FImage *fip, StarRec **srp)
+{
+	char buf[1024];
+	StarRec *sr;
+	StarDfn sd;
+	int *x, *y;
+	CamPixel *b;
+	int n, i;
+
+	n = findStars (fip->image, fip->sw, fip->sh, &x, &y, &b);
+	if (n < 0)
+	    return (-1);
+	sr = (StarRec *) calloc (n > 0 ? n : 1, sizeof(StarRec));
+	if (!sr) {
+	    free ((void *)x);
+	    free ((void *)y);
+	    free ((void *)b);
+	    return (-1);
+	}
+
+	sd.rsrch = 0;
+	sd.rAp = 0;
+	sd.how = SSHOW_HERE;
+	for (i = 0; i < n; i++) {
+	    StarRec *rp = &sr[i];
+	    StarStats ss;
+
+	    rp->bx = x[i];
+	    rp->by = y[i];
+	    rp->p = b[i];
+	    rp->x = x[i];
+	    rp->y = y[i];
+	    if (starStats ((CamPixel *)fip->image, fip->sw, fip->sh, &sd, x[i],
+							y[i], &ss, buf) == 0) {
+		rp->x = ss.x;
+		rp->y = ss.y;
+		rp->xfwhm = ss.xfwhm;
+		rp->yfwhm = ss.yfwhm;
+		rp->xmax = ss.xmax;
+		rp->ymax = ss.ymax;
+		rp->rmsSrc = ss.rmsSrc;
+		rp->rmsSky = ss.rmsSky;
+		rp->Src = ss.Src;
+		rp->Sky = ss.Sky;
+		rp->rAp = ss.rAp;
+		rp->flags = SL_OK;
+	    }
+	}
+
+	free ((void *)x);
+	free ((void *)y);
+	free ((void *)b);
+	*srp = sr;
+	return (n);
+}
+
+/* write the n stars sr[] of fip as the star list for FITS file fitsfn.
+ * return 0 if ok, else -1 with excuse in msg.
+ */
+int
+writeStarList (char *fitsfn, FImage *fip, StarRec *sr, int n, char msg[])
+{
+	char fn[1024], tmp[1100];
+	StarListHdr hdr;
+	int fd, i, ok;
+
+	memset ((void *)&hdr, 0, sizeof(hdr));
+	strcpy (hdr.magic, SLMAGIC);
+	hdr.version = SLVERSION;
+	hdr.order = SLORDER;
+	hdr.hdrsize = sizeof(StarListHdr);
+	hdr.recsize = sizeof(StarRec);
+	hdr.w = fip->sw;
+	hdr.h = fip->sh;
+	hdr.pixhash = pixHashFITS (fip->image, fip->sw, fip->sh);
+	hdr.cfgsum = ipCfgSum();
+	hdr.nstars = n;
+	for (i = 0; i < n; i++)
+	    hdr.flags |= sr[i].flags & SL_RADEC;
+
+	/* write to a temp file then rename, so the list is never half done */
+	starListName (fitsfn, fn);
+	sprintf (tmp, "%s.tmp", fn);
+	fd = open (tmp, O_WRONLY|O_CREAT|O_TRUNC, 0664);
+	if (fd < 0) {
+	    sprintf (msg, "%s: %s", tmp, strerror(errno));
+	    return (-1);
+	}
+	ok = write (fd, (void *)&hdr, sizeof(hdr)) == sizeof(hdr)
+		    && write (fd, (void *)sr, n*sizeof(StarRec)) == n*sizeof(StarRec);
+	if (!ok)
+	    sprintf (msg, "%s: %s", tmp, strerror(errno));
+	if (close (fd) < 0 && ok) {
+	    sprintf (msg, "%s: %s", tmp, strerror(errno));
+	    ok = 0;
+	}
+	if (ok && rename (tmp, fn) < 0) {
+	    sprintf (msg, "%s: %s", fn, strerror(errno));
+	    ok = 0;
+	}
+	if (!ok) {
+	    (void) unlink (tmp);
+	    return (-1);
+	}
+	return (0);
+}
+
+/* map the star list of FITS file fitsfn, if it has one and it was made from
+ * the pixels now in fip with the current star finding parameters.
+ * return a malloced StarList, else NULL with excuse in msg.
+ * N.B. caller must closeStarList() when finished.
+ */
+StarList *
+openStarList (char *fitsfn, FImage *fip, char msg[])
+{
+	char fn[1024];
+	StarListHdr *hp;
+	StarList *slp;
+	struct stat st;
+	void *map;
+	int fd;
+
+	starListName (fitsfn, fn);
+	fd = open (fn, O_RDONLY);
+	if (fd < 0) {
+	    sprintf (msg, "%s: %s", fn, strerror(errno));
+	    return (NULL);
+	}
+	if (fstat (fd, &st) < 0 || st.st_size < sizeof(StarListHdr)) {
+	    sprintf (msg, "%s: too short", fn);
+	    close (fd);
+	    return (NULL);
+	}
+	map = mmap (NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close (fd);
+	if (map == MAP_FAILED) {
+	    sprintf (msg, "%s: %s", fn, strerror(errno));
+	    return (NULL);
+	}
+
+	hp = (StarListHdr *)map;
+	if (strcmp (hp->magic, SLMAGIC) || hp->order != SLORDER
+				|| hp->version != SLVERSION
+				|| hp->hdrsize != sizeof(StarListHdr)
+				|| hp->recsize != sizeof(StarRec)
+				|| hp->nstars < 0
+				|| st.st_size != sizeof(StarListHdr)
+						+ hp->nstars*sizeof(StarRec)) {
+	    sprintf (msg, "%s: not a star list for this version", fn);
+	    munmap (map, st.st_size);
+	    return (NULL);
+	}
+	if (hp->w != fip->sw || hp->h != fip->sh
+		    || hp->pixhash != pixHashFITS (fip->image, fip->sw, fip->sh)
+		    || hp->cfgsum != ipCfgSum()) {
+	    sprintf (msg, "%s: stale", fn);
+	    munmap (map, st.st_size);
+	    return (NULL);
+	}
+
+	slp = (StarList *) malloc (sizeof(StarList));
+	if (!slp) {
+	    sprintf (msg, "No memory for star list");
+	    munmap (map, st.st_size);
+	    return (NULL);
+	}
+	slp->n = hp->nstars;
+	slp->s = (StarRec *)((char *)map + sizeof(StarListHdr));
+	slp->w = hp->w;
+	slp->h = hp->h;
+	slp->pixhash = hp->pixhash;
+	slp->map = map;
+	slp->maplen = st.st_size;
+	return (slp);
+}
+
+/* unmap and free slp */
+void
+closeStarList (StarList *slp)
+{
+	munmap (slp->map, slp->maplen);
+	free ((void *)slp);
+}
+
+/* if FITS file fitsfn has a good star list for the pixels now in fip, keep
+ * it for later findStars(), findStatStars() and setWCSFITS() calls on these
+ * pixels. the oldest of NUSE such lists is forgotten to make room.
+ * return 0 if found, else -1.
+ */
+int
+useStarList (char *fitsfn, FImage *fip)
+{
+	char msg[1024];
+	StarList *slp = openStarList (fitsfn, fip, msg);
+	int i;
+
+	if (!slp)
+	    return (-1);
+
+	pthread_mutex_lock (&uselock);
+	for (i = 0; i < ninuse; i++)
+	    if (inuse[i]->pixhash == slp->pixhash && inuse[i]->w == slp->w
+						    && inuse[i]->h == slp->h)
+		break;
+	if (i == NUSE)
+	    i--;
+	if (i < ninuse)
+	    closeStarList (inuse[i]);
+	else
+	    ninuse++;
+	memmove (&inuse[1], &inuse[0], i*sizeof(StarList *));
+	inuse[0] = slp;
+	pthread_mutex_unlock (&uselock);
+	return (0);
+}
+
+/* if useStarList() has found the stars of the w x h pixels at im, set *srp to
+ * a malloced copy of them and return how many; else return -1.
+ * hashp is as for pixHashOnce().
+ * N.B. caller must free *srp if we return >= 0.
+ */
+int
+getStarList (char *im, int w, int h, unsigned int *hashp, StarRec **srp)
+{
+	unsigned int hash;
+	int i, any, n = -1;
+
+	/* hash the pixels outside the lock, and only if there is a list */
+	pthread_mutex_lock (&uselock);
+	any = ninuse > 0;
+	pthread_mutex_unlock (&uselock);
+	if (!any)
+	    return (-1);
+	hash = pixHashOnce (im, w, h, hashp);
+
+	pthread_mutex_lock (&uselock);
+	for (i = 0; i < ninuse; i++) {
+	    StarList *slp = inuse[i];
+
+	    if (slp->pixhash != hash || slp->w != w || slp->h != h)
+		continue;
+	    *srp = (StarRec *) malloc ((slp->n > 0 ? slp->n : 1)
+							    * sizeof(StarRec));
+	    if (*srp) {
+		memcpy ((void *)*srp, (void *)slp->s, slp->n*sizeof(StarRec));
+		n = slp->n;
+	    }
+	    break;
+	}
+	pthread_mutex_unlock (&uselock);
+	return (n);
+}
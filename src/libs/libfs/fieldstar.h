@@ -16,3 +16,27 @@ extern int GSCFetch (double ra0, double dec0, double fov, double fmag,
 extern int USNOSetup (char *cdpath, int wantgsc, char *msg);
 extern int USNOFetch (double ra0, double dec0, double fov, double fmag,
     FieldStar **spp, char msg[]);
+
+/* in-memory tile cache shared by GSCFetch() and USNOFetch() */
+#define	FSC_GSC		0	/* cache catalog ids */
+#define	FSC_USNO	1
+
+typedef struct {
+    long queries;	/* cone queries served */
+    long hits;		/* tiles found in the cache */
+    long misses;	/* tiles fetched from the catalog */
+    long evictions;	/* tiles discarded to stay within budget */
+    long ntiles;	/* tiles now cached */
+    long bytes;		/* memory now used */
+    long maxbytes;	/* memory budget, 0 when disabled */
+} FSCacheStats;
+
+typedef int (*FSRawFetch)(double ra0, double dec0, double fov, double fmag,
+    FieldStar **spp, char msg[]);
+
+extern void FSCacheSetup (long maxbytes);
+extern void FSCacheFlush (int cat);
+extern void FSCacheGetStats (FSCacheStats *sp);
+extern int FSCacheEnabled (void);
+extern int fsCacheFetch (int cat, FSRawFetch rawf, double ra0, double dec0,
+    double fov, double fmag, FieldStar **spp, int nspp, char msg[]);
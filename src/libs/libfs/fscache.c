@@ -0,0 +1,458 @@
+/* in-memory cache of field star tiles shared by GSCFetch() and USNOFetch().
+ *
+ * the sky is cut into a fixed grid of tiles, TILESZ tall in dec and roughly
+ * TILESZ wide in ra. the first time a tile is needed it is fetched from the
+ * catalog with one cone just large enough to enclose it and only the stars
+ * inside its boundaries are kept. cone queries are then assembled from the
+ * tiles they touch. tiles are kept on an LRU list and the least recently
+ * used are discarded whenever the total exceeds the memory budget.
+ *
+ * FSCacheSetup(): set the memory budget, 0 to disable caching altogether.
+ * FSCacheFlush(): discard all tiles of one catalog, or all if cat < 0.
+ * FSCacheGetStats(): report hit/miss counters and memory use.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "P_.h"
+#include "astro.h"
+#include "circum.h"
+#include "fieldstar.h"
+
+#define	TILESZ		degrad(1.0)	/* tile height, rads */
+#define	NDBANDS		180		/* PI/TILESZ */
+#define	NHASH		1024		/* tile hash table size, power of 2 */
+#define	DEFMAXBYTES	(16L*1024L*1024L)	/* default memory budget */
+#define	TILEHASH(c,b,r)	(((b)*397 + (r)*7 + (c)) & (NHASH-1))
+
+/* one cached tile */
+typedef struct _FSTile {
+    struct _FSTile *hnext;	/* next in same hash chain */
+    struct _FSTile *newer;	/* toward most recently used */
+    struct _FSTile *older;	/* toward least recently used */
+    int cat;			/* FSC_GSC or FSC_USNO */
+    int band;			/* dec band, 0 at south pole */
+    int cell;			/* ra cell within band, 0 at ra 0 */
+    double fmag;		/* faintest mag fetched */
+    FieldStar *stars;		/* malloced stars within tile, or NULL */
+    int nstars;			/* n stars[] */
+} FSTile;
+
+static FSTile *hashtab[NHASH];	/* tiles hashed by cat/band/cell */
+static FSTile *mru, *lru;	/* ends of the LRU list */
+static long maxbytes = DEFMAXBYTES;	/* memory budget */
+static FSCacheStats stats;	/* running totals */
+
+static FSTile *findTile (int cat, int band, int cell);
+static FSTile *loadTile (int cat, int band, int cell, double fmag,
+    FSRawFetch rawf, char msg[]);
+static void tileBounds (int band, int cell, double *rlop, double *rhip,
+    double *dlop, double *dhip);
+static int nCells (int band);
+static int bandOf (double dec);
+static double sepCos (double r1, double d1, double r2, double d2);
+static void touchTile (FSTile *tp);
+static void unlinkTile (FSTile *tp);
+static void freeTile (FSTile *tp);
+static void trimCache (FSTile *keep);
+static long tileBytes (FSTile *tp);
+static int addStar (FieldStar **spp, int *nmaxp, int n, FieldStar *sp);
+
+/* set the memory budget to maxb bytes. 0 disables the cache.
+ * any tiles beyond the new budget are discarded at once.
+ */
+void
+FSCacheSetup (long maxb)
+{
+	maxbytes = maxb > 0 ? maxb : 0;
+	trimCache (NULL);
+	stats.maxbytes = maxbytes;
+}
+
+/* discard all cached tiles for catalog cat, or for all catalogs if cat < 0.
+ * call whenever the underlying catalog or its options change.
+ */
+void
+FSCacheFlush (int cat)
+{
+	FSTile *tp, *nextp;
+
+	for (tp = lru; tp; tp = nextp) {
+	    nextp = tp->newer;
+	    if (cat < 0 || tp->cat == cat) {
+		unlinkTile (tp);
+		freeTile (tp);
+	    }
+	}
+}
+
+/* fill *sp with the current cache counters */
+void
+FSCacheGetStats (FSCacheStats *sp)
+{
+	stats.maxbytes = maxbytes;
+	*sp = stats;
+}
+
+/* return 1 if the cache is enabled, else 0 */
+int
+FSCacheEnabled (void)
+{
+	return (maxbytes > 0);
+}
+
+/* fetch the stars of catalog cat within fov/2 of ra0/dec0 and no fainter
+ * than fmag, using cached tiles whenever possible and rawf to fill new ones.
+ * append them to the malloced array *spp which already holds nspp stars, or
+ * just count them if spp is NULL.
+ * return new total count, or -1 with reason in msg[].
+ * N.B. *spp is only changed if we added any.
+ * N.B. callers only come here if FSCacheEnabled().
+ */
+int
+fsCacheFetch (int cat, FSRawFetch rawf, double ra0, double dec0, double fov,
+double fmag, FieldStar **spp, int nspp, char msg[])
+{
+	double rov = fov/2;
+	double crov = cos(rov);
+	double cdec0 = cos(dec0);
+	FieldStar *mem = spp ? *spp : NULL;
+	int nmax = nspp;
+	int n = nspp;
+	double dra;
+	int b0, b1, b;
+
+	msg[0] = '\0';
+	range (&ra0, 2*PI);
+	stats.queries++;
+
+	/* find the bands touched and the ra half-width of the cone.
+	 * dra < 0 means the cone covers a pole so we need every cell.
+	 */
+	b0 = bandOf (dec0 - rov);
+	b1 = bandOf (dec0 + rov);
+	if (dec0 + rov >= PI/2 || dec0 - rov <= -PI/2 || cdec0 <= sin(rov))
+	    dra = -1;
+	else
+	    dra = asin (sin(rov)/cdec0);
+
+	for (b = b0; b <= b1; b++) {
+	    int nc = nCells (b);
+	    double cw = 2*PI/nc;
+	    int c0, c1, c;
+
+	    if (dra < 0 || 2*dra + 2*cw >= 2*PI) {
+		c0 = 0;
+		c1 = nc - 1;
+	    } else {
+		c0 = (int)floor((ra0 - dra)/cw);
+		c1 = (int)floor((ra0 + dra)/cw);
+	    }
+
+	    for (c = c0; c <= c1; c++) {
+		int cell = ((c % nc) + nc) % nc;
+		FSTile *tp = findTile (cat, b, cell);
+		int i;
+
+		if (tp && tp->fmag >= fmag) {
+		    stats.hits++;
+		    touchTile (tp);
+		} else {
+		    stats.misses++;
+		    tp = loadTile (cat, b, cell, fmag, rawf, msg);
+		    if (!tp) {
+			if (spp && mem)
+			    *spp = mem;
+			return (-1);
+		    }
+		}
+
+		for (i = 0; i < tp->nstars; i++) {
+		    FieldStar *fsp = &tp->stars[i];
+
+		    if (fsp->mag > fmag)
+			continue;
+		    if (sepCos (ra0, dec0, fsp->ra, fsp->dec) < crov)
+			continue;
+		    if (!spp)
+			n++;
+		    else if ((n = addStar (&mem, &nmax, n, fsp)) < 0) {
+			if (mem)
+			    *spp = mem;
+			sprintf (msg, "No more memory");
+			return (-1);
+		    }
+		}
+
+		trimCache (tp);
+	    }
+	}
+
+	if (spp && mem)
+	    *spp = mem;
+	return (n);
+}
+
+/* return the cached tile for cat/band/cell, or NULL if none */
+static FSTile *
+findTile (int cat, int band, int cell)
+{
+	FSTile *tp;
+
+	for (tp = hashtab[TILEHASH(cat,band,cell)]; tp; tp = tp->hnext)
+	    if (tp->cat == cat && tp->band == band && tp->cell == cell)
+		return (tp);
+	return (NULL);
+}
+
+/* fetch a fresh copy of the given tile down to fmag with rawf and make it
+ * the most recently used, replacing any shallower copy.
+ * return the tile, or NULL with reason in msg[].
+ */
+static FSTile *
+loadTile (int cat, int band, int cell, double fmag, FSRawFetch rawf,
+char msg[])
+{
+	double rlo, rhi, dlo, dhi;
+	double rc, dc, crad;
+	FieldStar *raw = NULL;
+	FSTile *tp;
+	int nraw, i, j;
+
+	/* find the smallest circle around the center that holds the tile.
+	 * check the corners and edge midpoints, which bound it well enough
+	 * for tiles this small.
+	 */
+	tileBounds (band, cell, &rlo, &rhi, &dlo, &dhi);
+	rc = (rlo + rhi)/2;
+	dc = (dlo + dhi)/2;
+	crad = 1.0;
+	for (i = 0; i < 3; i++) {
+	    double r = i == 0 ? rlo : (i == 1 ? rc : rhi);
+	    for (j = 0; j < 3; j++) {
+		double d = j == 0 ? dlo : (j == 1 ? dc : dhi);
+		double cs = sepCos (rc, dc, r, d);
+		if (cs < crad)
+		    crad = cs;
+	    }
+	}
+	nraw = (*rawf) (rc, dc, 2*acos(crad) + degrad(0.01), fmag, &raw, msg);
+	if (nraw < 0) {
+	    if (raw)
+		free ((void *)raw);
+	    return (NULL);
+	}
+
+	/* keep only the stars strictly inside this tile so neighbors never
+	 * contribute the same star twice.
+	 */
+	j = 0;
+	for (i = 0; i < nraw; i++) {
+	    double r = raw[i].ra, d = raw[i].dec;
+
+	    range (&r, 2*PI);
+	    if (bandOf (d) != band)
+		continue;
+	    if ((int)floor(r/(2*PI/nCells(band))) % nCells(band) != cell)
+		continue;
+	    raw[j++] = raw[i];
+	}
+
+	/* reuse or create the tile */
+	tp = findTile (cat, band, cell);
+	if (tp) {
+	    stats.bytes -= tileBytes (tp);
+	    if (tp->stars)
+		free ((void *)tp->stars);
+	    unlinkTile (tp);
+	} else {
+	    int h = TILEHASH (cat, band, cell);
+
+	    tp = (FSTile *) calloc (1, sizeof(FSTile));
+	    if (!tp) {
+		if (raw)
+		    free ((void *)raw);
+		sprintf (msg, "No memory for star tile");
+		return (NULL);
+	    }
+	    tp->cat = cat;
+	    tp->band = band;
+	    tp->cell = cell;
+	    tp->hnext = hashtab[h];
+	    hashtab[h] = tp;
+	    stats.ntiles++;
+	}
+
+	if (j > 0) {
+	    tp->stars = (FieldStar *) realloc ((void *)raw, j*sizeof(FieldStar));
+	    if (!tp->stars)
+		tp->stars = raw;
+	} else {
+	    if (raw)
+		free ((void *)raw);
+	    tp->stars = NULL;
+	}
+	tp->nstars = j;
+	tp->fmag = fmag;
+
+	/* insert at the head of the LRU list */
+	tp->older = mru;
+	tp->newer = NULL;
+	if (mru)
+	    mru->newer = tp;
+	mru = tp;
+	if (!lru)
+	    lru = tp;
+	stats.bytes += tileBytes (tp);
+
+	return (tp);
+}
+
+/* find the ra and dec limits of the given tile, all rads */
+static void
+tileBounds (int band, int cell, double *rlop, double *rhip, double *dlop,
+double *dhip)
+{
+	double cw = 2*PI/nCells(band);
+
+	*dlop = -PI/2 + band*TILESZ;
+	*dhip = *dlop + TILESZ;
+	*rlop = cell*cw;
+	*rhip = *rlop + cw;
+}
+
+/* return the number of ra cells in the given dec band.
+ * cells are about TILESZ wide along the edge closest the equator.
+ */
+static int
+nCells (int band)
+{
+	double dlo = -PI/2 + band*TILESZ;
+	double dhi = dlo + TILESZ;
+	double d = dlo < 0 && dhi > 0 ? 0 : (fabs(dlo) < fabs(dhi) ? dlo : dhi);
+	int n = (int)ceil(2*PI*cos(d)/TILESZ);
+
+	return (n < 1 ? 1 : n);
+}
+
+/* return the dec band containing dec, clamped to the poles */
+static int
+bandOf (double dec)
+{
+	int b = (int)floor((dec + PI/2)/TILESZ);
+
+	if (b < 0)
+	    b = 0;
+	if (b >= NDBANDS)
+	    b = NDBANDS-1;
+	return (b);
+}
+
+/* cos of the angle between two locations, all rads */
+static double
+sepCos (double r1, double d1, double r2, double d2)
+{
+	return (sin(d1)*sin(d2) + cos(d1)*cos(d2)*cos(r1-r2));
+}
+
+/* move tp to the most recently used end of the LRU list */
+static void
+touchTile (FSTile *tp)
+{
+	if (tp == mru)
+	    return;
+
+	/* unlink from current spot */
+	if (tp->newer)
+	    tp->newer->older = tp->older;
+	if (tp->older)
+	    tp->older->newer = tp->newer;
+	if (tp == lru)
+	    lru = tp->newer;
+
+	/* link in at the head */
+	tp->older = mru;
+	tp->newer = NULL;
+	if (mru)
+	    mru->newer = tp;
+	mru = tp;
+}
+
+/* remove tp from the LRU list and the hash table */
+static void
+unlinkTile (FSTile *tp)
+{
+	FSTile **tpp = &hashtab[TILEHASH(tp->cat,tp->band,tp->cell)];
+
+	if (tp->newer)
+	    tp->newer->older = tp->older;
+	else
+	    mru = tp->older;
+	if (tp->older)
+	    tp->older->newer = tp->newer;
+	else
+	    lru = tp->newer;
+	tp->newer = tp->older = NULL;
+
+	for (; *tpp; tpp = &(*tpp)->hnext)
+	    if (*tpp == tp) {
+		*tpp = tp->hnext;
+		break;
+	    }
+}
+
+/* free tp, which must already be unlinked, and update the totals */
+static void
+freeTile (FSTile *tp)
+{
+	stats.bytes -= tileBytes (tp);
+	stats.ntiles--;
+	if (tp->stars)
+	    free ((void *)tp->stars);
+	free ((void *)tp);
+}
+
+/* discard least recently used tiles, other than keep, until the total is
+ * within budget.
+ */
+static void
+trimCache (FSTile *keep)
+{
+	while (stats.bytes > maxbytes && lru && lru != keep) {
+	    FSTile *tp = lru;
+
+	    unlinkTile (tp);
+	    freeTile (tp);
+	    stats.evictions++;
+	}
+}
+
+/* memory charged to the given tile */
+static long
+tileBytes (FSTile *tp)
+{
+	return ((long)sizeof(FSTile) + (long)tp->nstars*sizeof(FieldStar));
+}
+
+/* append *sp to the malloced array *spp of n, growing it as needed.
+ * return new count or -1 if no more memory.
+ */
+static int
+addStar (FieldStar **spp, int *nmaxp, int n, FieldStar *sp)
+{
+	if (n >= *nmaxp) {
+	    int newmax = *nmaxp + 64;
+	    char *newmem = *spp ? realloc ((void *)*spp, newmax*sizeof(FieldStar))
+				: malloc (newmax*sizeof(FieldStar));
+	    if (!newmem)
+		return (-1);
+	    *spp = (FieldStar *)newmem;
+	    *nmaxp = newmax;
+	}
+
+	(*spp)[n++] = *sp;
+	return (n);
+}
@@ -111,6 +111,10 @@ static int nocdrom;	/* set if don't wnat to use the cdrom */
 
 static char *lmsg;	/* local ptr to user's msg buffer */
 
+static int gscFetch P_((double ra0, double dec0, double fov, double fmag,
+    FieldStar **spp, int nspp, char msg[]));
+static int gscRawFetch P_((double ra0, double dec0, double fov, double fmag,
+    FieldStar **spp, char msg[]));
 static int handleRequest P_((Request *qp, GSCArray *ap));
 static int fetchRegion P_((GSCRegion *rp, Request *qp, GSCArray *ap));
 static int inFOV P_((Request *qp, GSCEntry *ep));
@@ -154,6 +158,9 @@ char *cdp;
 char *chp;
 char msg[];
 {
+	/* any cached tiles may have come from elsewhere */
+	FSCacheFlush (FSC_GSC);
+
 	/* set up the new paths and flags */
 	cdpath = cdp;
 	nocdrom = !cdpath;
@@ -214,6 +221,33 @@ double fmag;	/* faintest mag */
 FieldStar **spp;/* *spp will be a malloced array of FieldStar stars in region */
 int nspp;	/* if spp: initial number of FieldStar already in *spp */
 char msg[];	/* possible return error or status message */
+{
+	/* assemble from the in-memory tile cache if it is enabled */
+	if (FSCacheEnabled())
+	    return (fsCacheFetch (FSC_GSC, gscRawFetch, ra0, dec0, fov, fmag,
+							    spp, nspp, msg));
+	return (gscFetch (ra0, dec0, fov, fmag, spp, nspp, msg));
+}
+
+/* fetch from a fresh malloced array, as needed by the tile cache. */
+static int
+gscRawFetch (double ra0, double dec0, double fov, double fmag,
+FieldStar **spp, char msg[])
+{
+	*spp = NULL;
+	return (gscFetch (ra0, dec0, fov, fmag, spp, 0, msg));
+}
+
+/* GSCFetch() directly from the cache files and/or CDROM. */
+static int
+gscFetch (ra0, dec0, fov, fmag, spp, nspp, msg)
+double ra0;	/* center RA, rads */
+double dec0;	/* center Dec, rads */
+double fov;	/* field of view, rads */
+double fmag;	/* faintest mag */
+FieldStar **spp;/* *spp will be a malloced array of FieldStar stars in region */
+int nspp;	/* if spp: initial number of FieldStar already in *spp */
+char msg[];	/* possible return error or status message */
 {
 	Request q;
 	GSCArray sa;
@@ -38,6 +38,8 @@ typedef struct {
 
 #define	NINC	16	/* grow ObjFArray array this many at a time */
 
+static int usnoFetch (double r0, double d0, double fov, double fmag,
+    FieldStar **spp, char msg[]);
 static int corner (double r0, double d0, double rov, int *nr, double fr[2],
     double lr[2], int *nd, double fd[2], double ld[2], int zone[2], char msg[]);
 static int fetchSwath (int zone, double maxmag, double fr, double lr,
@@ -67,6 +69,9 @@ USNOSetup (char *cdp, int wantgsc, char msg[])
 	}
 	fclose (fp);
 
+	/* any cached tiles may have come from elsewhere or used other options */
+	FSCacheFlush (FSC_USNO);
+
 	/* store our own copy */
 	if (cdpath)
 	    free (cdpath);
@@ -86,7 +91,40 @@ USNOSetup (char *cdp, int wantgsc, char msg[])
  * if trouble fill msg[] with a short diagnostic and return -1.
  */
 int
-USNOFetch (
+USNOFetch (double r0, double d0, double fov, double fmag, FieldStar **spp,
+char msg[])
+{
+	int n, i;
+
+	/* insure there is a cdpath set up */
+	if (!cdpath) {
+	    strcpy (msg, "USNOFetch() called before USNOSetup()");
+	    return (-1);
+	}
+
+	if (!FSCacheEnabled())
+	    return (usnoFetch (r0, d0, fov, fmag, spp, msg));
+
+	/* assemble from the in-memory tile cache */
+	*spp = NULL;
+	n = fsCacheFetch (FSC_USNO, usnoFetch, r0, d0, fov, fmag, spp, 0, msg);
+	if (n <= 0) {
+	    if (*spp)
+		free ((void *)*spp);
+	    *spp = NULL;
+	    return (n);
+	}
+
+	/* names are just sequence numbers within one fetch */
+	for (i = 0; i < n; i++)
+	    snprintf ((*spp)[i].name, sizeof((*spp)[i].name), "SA1.0 %06d", i);
+
+	return (n);
+}
+
+/* USNOFetch() directly from the CDROM. */
+static int
+usnoFetch (
 double r0,	/* center RA, rads */
 double d0,	/* center Dec, rads */
 double fov,	/* field of view, rads */
@@ -10,12 +10,20 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <signal.h>
+#include <limits.h>
+#include <stddef.h>
 #include <unistd.h>
+#include <pthread.h>
 #include <sys/types.h>
+#include <sys/time.h>
 #include <sys/wait.h>
 #include <sys/stat.h>
 #include <sys/ipc.h>
 #include <sys/shm.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
 
 #include "P_.h"
 #include "astro.h"
@@ -28,6 +36,44 @@ static void sigalarm_dummy (int dummy);
 static void catch_alarm(void);
 static int alarm_wentoff;
 
+static int readline (int fd, char *buf, int n, int bufl);
+static int readn (int fd, char *buf, int n, char *err);
+static int readframe (int fd, BinMsg *bp);
+
+/* payload bytes of each typed BinType, 0 if any up to BIN_MAXLEN */
+static int binlen[BM_N] = {
+    0,				/* BM_TEXT */
+    sizeof(BinOffset),		/* BM_OFFSET */
+    sizeof(BinJog),		/* BM_JOG */
+    sizeof(BinRADec),		/* BM_RADEC */
+    sizeof(BinFocus),		/* BM_FOCUS */
+};
+
+/* the bytes of TelStatShm in each TelShmGen section, for telshm_publish() */
+typedef struct {
+    int gen;			/* TelShmGen */
+    size_t from, to;		/* byte offsets [from, to) */
+} ShmRange;
+static ShmRange shmranges[] = {
+    {TSG_TEL,  offsetof(TelStatShm, CJ2kRA), offsetof(TelStatShm, coolerstatus)},
+    {TSG_TEL,  offsetof(TelStatShm, filter), offsetof(TelStatShm, domeaz)},
+    {TSG_DOME, offsetof(TelStatShm, domeaz), offsetof(TelStatShm, scan)},
+    {TSG_CAM,  offsetof(TelStatShm, coolerstatus), offsetof(TelStatShm, filter)},
+    {TSG_WX,   offsetof(TelStatShm, wxs), offsetof(TelStatShm, gen)},
+    {TSG_SCAN, offsetof(TelStatShm, scan), offsetof(TelStatShm, wxs)},
+};
+#define	NSHMR	(sizeof(shmranges)/sizeof(shmranges[0]))
+
+/* what a telshm_notifyfd() thread needs */
+typedef struct {
+    TelStatShm *tp;		/* segment to watch */
+    int mask;			/* TSG_BIT()s to watch */
+    int fd;			/* pipe to write when any change */
+} NotifyArg;
+
+static void *notify_thread (void *arg);
+static int waitgen (unsigned int *addr, unsigned int val, int ms);
+
 /* used by a daemon to announce a fifo pair for communications.
  * fd[0] should be used to read commands from clients, fd[1] to write
  * responses. we always make fresh fifos each time, and open writer for
@@ -196,42 +242,17 @@ cli_write (int fd[2], char *msg, char *err)
 int
 serv_read (int fd[2], char *buf, int bufl)
 {
-	int found;
 	int n;
-	int s;
 
 	/* max time to wait for rest of message */
 	alarm_wentoff = 0;
 	alarm (5);
 
-	/* read until get EOS, get bufl chars or alarm goes off */
-	for (found = n = 0; 1; n++) {
-	    if (n >= bufl) {
-		sprintf (buf, "Buffer overflow");
-		break;
-	    }
-	    s = read (fd[0], &buf[n], 1);
-	    if (s < 0) {
-		if (alarm_wentoff)
-		    sprintf (buf, "Message timeout");
-		else
-		    sprintf (buf, "%s", strerror(errno));
-		break;
-	    }
-	    if (s == 0) {
-		sprintf (buf, "Fifo disappeared");
-		break;
-	    }
-	    if (buf[n] == '\0' || buf[n] == '\n') {
-		buf[n++] = '\0';
-		found = 1;
-		break;
-	    }
-	}
+	n = readline (fd[0], buf, 0, bufl);
 
 	alarm (0);				/* done with alarm */
 
-	return (found ? 0 : -1);
+	return (n < 0 ? -1 : 0);
 }
 
 /* used by a client to read from a server into buf[bufl].
@@ -247,49 +268,246 @@ cli_read (int fd[2], int *code, char *buf, int bufl)
 {
 	int n, v;
 	char *sp;
-	int found;
+
+	/* max time to wait for rest of message */
+	alarm_wentoff = 0;
+	alarm (5);
+
+	n = readline (fd[0], buf, 0, bufl);
+
+	alarm (0);				/* done with alarm */
+	if (n < 0)				/* if nothing good found */
+	    return (-1);			/* bail out */
+	v = atoi (buf);				/* leading status number */
+	sp = strchr (buf, ' ');			/* skip status code */
+	if (sp) {				/* if found space */
+	    while (*sp == ' ')			/* while over space */
+		sp++;				/* skip to first non-space */
+	    memmove (buf, sp, n-(sp-buf));	/* shift back over the number */
+	}					/* else return orig buf */
+	*code = v;
+	return (0);
+}
+
+/* binary framing.
+ *
+ * besides the text messages above, a client may send frames of a BinHdr
+ * then hdr.len bytes of payload over the same fifos. the first byte is
+ * always BIN_SOH, which no text message starts with, so a server can take
+ * either as they come with serv_readbin(). a frame is read with two read()s
+ * rather than one per byte, and the hot commands travel as the typed structs
+ * in cliserv.h so neither end formats or parses numbers. each frame is
+ * written with one write() so it stays whole in the fifo.
+ *
+ * a client asks with bin_hello(). a server that agrees answers in text and
+ * from then on takes frames and sends its direct reply to each as a BM_TEXT
+ * frame, code in the header. a frame that comes before the hello is refused
+ * with a text error, so a client never gets frames back it did not ask for. anything else, such as later progress or done messages,
+ * stays text, since a fifo can not tell its clients apart; bin_read() reads
+ * either. a client that sends frames must still be the only one reading the
+ * fifo, as with text.
+ */
+
+/* used by a client to ask the server on fd for binary framing.
+ * return 0 if it agrees, else -1 with an excuse in msg[].
+ * N.B. skips any responses left in the fifo from before.
+ */
+int
+bin_hello (int fd[2], char msg[])
+{
+	BinMsg bm;
+
+	if (cli_write (fd, BIN_HELLO, msg) < 0)
+	    return (-1);
+	while (bin_read (fd, &bm) == 0)
+	    if (bm.h.code == 0 && strcasecmp (bm.u.text, BIN_HELLO) == 0)
+		return (0);
+	sprintf (msg, "No binary: %s", bm.u.text);
+	return (-1);
+}
+
+/* write a frame of the given BinType and code with len bytes of body.
+ * (we pick the correct fd to use for you :-)
+ * return 0 if ok, else fill err[] with excuse and return -1.
+ */
+int
+bin_write (int fd[2], int type, int code, void *body, int len, char *err)
+{
+	char buf[sizeof(BinHdr) + BIN_MAXLEN];
+	BinHdr *hp = (BinHdr *)buf;
+	int l = sizeof(BinHdr) + len;
 	int s;
 
+	if (type < 0 || type >= BM_N || len < 0 || len > BIN_MAXLEN
+				    || (binlen[type] && len != binlen[type])) {
+	    sprintf (err, "Bad binary message type %d len %d", type, len);
+	    return (-1);
+	}
+	hp->soh = BIN_SOH;
+	hp->type = type;
+	hp->len = len;
+	hp->code = code;
+	memcpy (buf + sizeof(BinHdr), body, len);
+
+	s = write (fd[1], buf, l);
+	if (s < 0)
+	    sprintf (err, "%s", strerror(errno));
+	else if (s == 0)
+	    sprintf (err, "Fifo disappeared");
+	else if (s < l)
+	    sprintf (err, "Fifo write short");
+	else
+	    return (0);
+	return (-1);
+}
+
+/* used by a client to read a response from a server, binary or text.
+ * (we pick the correct fd to use for you :-)
+ * if ok, return 0 with the frame in *bp, a text response being put in
+ *   bp->u.text with its code in bp->h.code as if it came as BM_TEXT.
+ * else fill bp->u.text with excuse and return -1.
+ */
+int
+bin_read (int fd[2], BinMsg *bp)
+{
+	int code;
+	int n;
+
+	n = serv_readbin (fd, bp);
+	if (n <= 0) {
+	    char *sp;
+
+	    if (n < 0)
+		return (-1);
+	    code = atoi (bp->u.text);
+	    sp = strchr (bp->u.text, ' ');
+	    if (sp) {
+		while (*sp == ' ')
+		    sp++;
+		memmove (bp->u.text, sp, strlen(sp)+1);
+	    }
+	    bp->h.code = code;
+	}
+	return (0);
+}
+
+/* used by a server to read the next message from a client, binary or text.
+ * (we pick the correct fd to use for you :-)
+ * return 1 with a binary frame in *bp, NUL-terminated if BM_TEXT,
+ *   or 0 with a text message in bp->u.text and bp->h.type BM_TEXT,
+ *   else fill bp->u.text with excuse and return -1.
+ */
+int
+serv_readbin (int fd[2], BinMsg *bp)
+{
+	char *buf = bp->u.text;
+	int n;
+
 	/* max time to wait for rest of message */
 	alarm_wentoff = 0;
 	alarm (5);
 
-	/* read until get EOS, get bufl chars or alarm goes off */
-	for (found = n = 0; 1; n++) {
+	/* the first byte says which */
+	n = readn (fd[0], buf, 1, buf);
+	if (n == 0) {
+	    if ((unsigned char)buf[0] == BIN_SOH)
+		n = readframe (fd[0], bp) < 0 ? -1 : 1;
+	    else {
+		memset ((void *)&bp->h, 0, sizeof(bp->h));
+		bp->h.type = BM_TEXT;
+		if (buf[0] == '\0' || buf[0] == '\n')
+		    buf[0] = '\0';
+		else
+		    n = readline (fd[0], buf, 1, sizeof(bp->u.text));
+		if (n > 0)
+		    n = 0;
+	    }
+	}
+
+	alarm (0);				/* done with alarm */
+
+	return (n);
+}
+
+/* read from fd into buf[bufl] until get EOS, get bufl chars or the alarm
+ * goes off, allowing for the first n already being in buf[].
+ * return length including the \0 if ok, else -1 with excuse in buf[].
+ */
+static int
+readline (int fd, char *buf, int n, int bufl)
+{
+	int s;
+
+	for (; 1; n++) {
 	    if (n >= bufl) {
 		sprintf (buf, "Buffer overflow");
-		break;
+		return (-1);
 	    }
-	    s = read (fd[0], &buf[n], 1);
+	    s = read (fd, &buf[n], 1);
 	    if (s < 0) {
 		if (alarm_wentoff)
 		    sprintf (buf, "Message timeout");
 		else
 		    sprintf (buf, "%s", strerror(errno));
-		break;
+		return (-1);
 	    }
 	    if (s == 0) {
 		sprintf (buf, "Fifo disappeared");
-		break;
+		return (-1);
 	    }
 	    if (buf[n] == '\0' || buf[n] == '\n') {
 		buf[n++] = '\0';
-		found = 1;
-		break;
+		return (n);
 	    }
 	}
+}
 
-	alarm (0);				/* done with alarm */
-	if (!found)				/* if nothing good found */
-	    return (-1);			/* bail out */
-	v = atoi (buf);				/* leading status number */
-	sp = strchr (buf, ' ');			/* skip status code */
-	if (sp) {				/* if found space */
-	    while (*sp == ' ')			/* while over space */
-		sp++;				/* skip to first non-space */
-	    memmove (buf, sp, n-(sp-buf));	/* shift back over the number */
-	}					/* else return orig buf */
-	*code = v;
+/* read exactly n bytes from fd into buf.
+ * return 0 if ok, else -1 with excuse in err[], which may be buf.
+ */
+static int
+readn (int fd, char *buf, int n, char *err)
+{
+	int got, s;
+
+	for (got = 0; got < n; got += s) {
+	    s = read (fd, buf + got, n - got);
+	    if (s < 0) {
+		if (alarm_wentoff)
+		    sprintf (err, "Message timeout");
+		else
+		    sprintf (err, "%s", strerror(errno));
+		return (-1);
+	    }
+	    if (s == 0) {
+		sprintf (err, "Fifo disappeared");
+		return (-1);
+	    }
+	}
+	return (0);
+}
+
+/* read the rest of a frame whose BIN_SOH has been read from fd into *bp.
+ * return 0 if ok, else -1 with excuse in bp->u.text.
+ */
+static int
+readframe (int fd, BinMsg *bp)
+{
+	BinHdr *hp = &bp->h;
+
+	hp->soh = BIN_SOH;
+	if (readn (fd, (char *)hp + 1, sizeof(BinHdr) - 1, bp->u.text) < 0)
+	    return (-1);
+	if (hp->type >= BM_N || hp->len > BIN_MAXLEN
+			    || (binlen[hp->type] && hp->len != binlen[hp->type])) {
+	    sprintf (bp->u.text, "Bad binary frame type %d len %d", hp->type,
+								    hp->len);
+	    return (-1);
+	}
+	if (readn (fd, bp->u.text, hp->len, bp->u.text) < 0)
+	    return (-1);
+	if (hp->type == BM_TEXT)
+	    bp->u.text[hp->len < BIN_MAXLEN ? hp->len : BIN_MAXLEN-1] = '\0';
 	return (0);
 }
 
@@ -317,6 +535,54 @@ catch_alarm()
 	sigaction (SIGALRM, &act, NULL);
 }
 
+/* body of the telshm_notifyfd() thread. runs until can not wait. */
+static void *
+notify_thread (void *arg)
+{
+	NotifyArg *nap = (NotifyArg *)arg;
+	unsigned int seen[TSG_N];
+	char c = 0;
+	int n;
+
+	/* start from the generations now */
+	memset ((void *)seen, 0, sizeof(seen));
+	(void) telshm_wait (nap->tp, seen, nap->mask, 0);
+
+	while ((n = telshm_wait (nap->tp, seen, nap->mask, -1)) >= 0)
+	    if (n > 0 && write (nap->fd, &c, 1) < 0 && errno != EAGAIN)
+		break;
+
+	close (nap->fd);
+	free ((void *)nap);
+	return (NULL);
+}
+
+/* sleep until *addr no longer holds val, up to ms or forever if ms < 0.
+ * may return early. return 0 if ok, else -1.
+ */
+static int
+waitgen (unsigned int *addr, unsigned int val, int ms)
+{
+#ifdef __linux__
+	struct timespec ts, *tsp = NULL;
+
+	if (ms >= 0) {
+	    ts.tv_sec = ms/1000;
+	    ts.tv_nsec = (ms%1000)*1000000L;
+	    tsp = &ts;
+	}
+	if (syscall (SYS_futex, addr, FUTEX_WAIT, val, tsp, NULL, 0) < 0
+		    && errno != EAGAIN && errno != EINTR && errno != ETIMEDOUT)
+	    return (-1);
+#else
+	/* no futex: just poll */
+	if (ms < 0 || ms > 10)
+	    ms = 10;
+	usleep (ms*1000);
+#endif
+	return (0);
+}
+
 /* connect to the telstatshm shared memory segment.
  * same function for cli and serv.
  * return 0 and set *tpp if ok, else -1.
@@ -336,5 +602,164 @@ open_telshm(TelStatShm **tpp)
 	    return (-1);
 
 	*tpp = (TelStatShm *) addr;
+
+	/* run on its clock, which is real time unless simulating */
+	simclock_attach (&(*tpp)->simclock);
 	return (0);
 }
+
+/* used by a writer to announce it has just changed the TelShmGen sections
+ * of tp in mask. mask may be 0 just to wake the readers, such as after
+ * copying in a whole segment.
+ */
+void
+telshm_changed (TelStatShm *tp, int mask)
+{
+	int g;
+
+	for (g = 0; g < TSG_N; g++)
+	    if (mask & TSG_BIT(g))
+		(void) __sync_fetch_and_add (&tp->gen[g], 1);
+	(void) __sync_fetch_and_add (&tp->anygen, 1);
+#ifdef __linux__
+	(void) syscall (SYS_futex, &tp->anygen, FUTEX_WAKE, INT_MAX, NULL,
+								    NULL, 0);
+#endif
+}
+
+/* used by a writer which updates tp continuously, such as every pass through
+ * its main loop, to announce whichever sections in mask differ from when it
+ * last announced them. each is announced at most once per TSG_MINMS, so this
+ * must keep being called for the last change to be seen.
+ * N.B. compares against one private copy, so only one caller per process.
+ */
+void
+telshm_publish (TelStatShm *tp, int mask)
+{
+	static TelStatShm last;			/* as of each last announcement */
+	static struct timeval lasttv[TSG_N];
+	struct timeval tv;
+	int changed = 0;
+	int g, i;
+
+	gettimeofday (&tv, NULL);
+	for (g = 0; g < TSG_N; g++) {
+	    if (!(mask & TSG_BIT(g)))
+		continue;
+	    if ((tv.tv_sec - lasttv[g].tv_sec)*1000
+			    + (tv.tv_usec - lasttv[g].tv_usec)/1000 < TSG_MINMS)
+		continue;
+	    for (i = 0; i < NSHMR; i++) {
+		ShmRange *rp = &shmranges[i];
+		if (rp->gen == g && memcmp ((char *)tp + rp->from,
+				(char *)&last + rp->from, rp->to - rp->from)) {
+		    changed |= TSG_BIT(g);
+		    break;
+		}
+	    }
+	    if (!(changed & TSG_BIT(g)))
+		continue;
+	    for (i = 0; i < NSHMR; i++) {
+		ShmRange *rp = &shmranges[i];
+		if (rp->gen == g)
+		    memcpy ((char *)&last + rp->from, (char *)tp + rp->from,
+							    rp->to - rp->from);
+	    }
+	    lasttv[g] = tv;
+	}
+
+	if (changed)
+	    telshm_changed (tp, changed);
+}
+
+/* used by a reader to wait up to ms for any of the sections of tp in mask to
+ * change from the generations in seen[], or forever if ms < 0, or not at all
+ * if ms == 0. seen[] starts all 0, so the first call reports every section.
+ * return mask of sections that changed, and update seen[] to match, or 0 if
+ * none did in time, or -1 if can not wait.
+ */
+int
+telshm_wait (TelStatShm *tp, unsigned int seen[TSG_N], int mask, int ms)
+{
+	volatile unsigned int *gen = tp->gen;
+	struct timeval t0, tv;
+	int left = ms;
+
+	if (ms > 0)
+	    gettimeofday (&t0, NULL);
+
+	while (1) {
+	    unsigned int any = *(volatile unsigned int *)&tp->anygen;
+	    int changed = 0;
+	    int g;
+
+	    __sync_synchronize();	/* read anygen before gen[] */
+	    for (g = 0; g < TSG_N; g++) {
+		if ((mask & TSG_BIT(g)) && gen[g] != seen[g]) {
+		    seen[g] = gen[g];
+		    changed |= TSG_BIT(g);
+		}
+	    }
+	    if (changed)
+		return (changed);
+
+	    if (ms > 0) {
+		gettimeofday (&tv, NULL);
+		left = ms - ((tv.tv_sec - t0.tv_sec)*1000
+					+ (tv.tv_usec - t0.tv_usec)/1000);
+		if (left <= 0)
+		    return (0);
+	    } else if (ms == 0)
+		return (0);
+
+	    if (waitgen (&tp->anygen, any, left) < 0)
+		return (-1);
+	}
+}
+
+/* used by a reader with an event loop, such as select() or X, to learn of
+ * changes to the sections of tp in mask without polling.
+ * a thread waits with telshm_wait() and writes a byte to a pipe after each
+ * change. the caller reads whatever is there when the returned fd is
+ * readable then finds what changed with telshm_wait(...,0). EOF means
+ * notifications have stopped and the caller should go back to polling.
+ * return read end of pipe, else -1.
+ */
+int
+telshm_notifyfd (TelStatShm *tp, int mask)
+{
+	pthread_attr_t attr;
+	pthread_t tid;
+	NotifyArg *nap;
+	int p[2];
+
+	if (pipe (p) < 0)
+	    return (-1);
+	nap = (NotifyArg *) malloc (sizeof(NotifyArg));
+	if (!nap) {
+	    close (p[0]);
+	    close (p[1]);
+	    return (-1);
+	}
+
+	/* never let the thread block behind a slow reader, a pending byte
+	 * already says there is more to read.
+	 */
+	fcntl (p[1], F_SETFL, fcntl (p[1], F_GETFL) | O_NONBLOCK);
+
+	nap->tp = tp;
+	nap->mask = mask;
+	nap->fd = p[1];
+	pthread_attr_init (&attr);
+	pthread_attr_setdetachstate (&attr, PTHREAD_CREATE_DETACHED);
+	if (pthread_create (&tid, &attr, notify_thread, (void *)nap) != 0) {
+	    pthread_attr_destroy (&attr);
+	    free ((void *)nap);
+	    close (p[0]);
+	    close (p[1]);
+	    return (-1);
+	}
+	pthread_attr_destroy (&attr);
+
+	return (p[0]);
+}
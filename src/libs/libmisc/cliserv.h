@@ -11,7 +11,68 @@ extern int cli_write (int fd[2], char *msg, char *err);
 extern int cli_read (int fd[2], int *code, char *buf, int bufl);
 extern int serv_read (int fd[2], char *buf, int bufl);
 extern int serv_write (int fd[2], int code, char *msg, char *err);
+
+/* optional binary framing over the same fifo pairs, see cliserv.c */
+#define	BIN_SOH		0x01		/* first byte of each binary frame */
+#define	BIN_HELLO	"Binary"	/* text command asking for binary */
+#define	BIN_MAXLEN	1024		/* largest payload, bytes */
+
+typedef enum {
+    BM_TEXT,			/* payload is a text command or response */
+    BM_OFFSET,			/* BinOffset, as "Offset ha,dec" to Tel */
+    BM_JOG,			/* BinJog, as "jNSEW" to Tel */
+    BM_RADEC,			/* BinRADec, as "RA: Dec: Epoch:" to Tel */
+    BM_FOCUS,			/* BinFocus, as a number to Focus */
+    BM_N
+} BinType;
+
+typedef struct {
+    unsigned char soh;		/* always BIN_SOH */
+    unsigned char type;		/* BinType */
+    unsigned short len;		/* bytes of payload that follow */
+    int code;			/* response code, as serv_write() */
+} BinHdr;
+
+typedef struct {
+    double ha, dec;		/* tracking offset, arcsecs */
+} BinOffset;
+
+typedef struct {
+    char dir[8];		/* directions, as after the j */
+} BinJog;
+
+typedef struct {
+    double ra, dec;		/* astrometric place, rads */
+    double ep;		/* epoch, as a year */
+} BinRADec;
+
+typedef struct {
+    double um;			/* relative focus move, microns */
+} BinFocus;
+
+typedef struct {
+    BinHdr h;
+    union {
+	char text[BIN_MAXLEN];
+	BinOffset offset;
+	BinJog jog;
+	BinRADec radec;
+	BinFocus focus;
+    } u;
+} BinMsg;
+
+extern int bin_hello (int fd[2], char msg[]);
+extern int bin_write (int fd[2], int type, int code, void *body, int len,
+    char *err);
+extern int bin_read (int fd[2], BinMsg *bp);
+extern int serv_readbin (int fd[2], BinMsg *bp);
+
 extern int open_telshm(TelStatShm **tpp);
+extern void telshm_changed (TelStatShm *tp, int mask);
+extern void telshm_publish (TelStatShm *tp, int mask);
+extern int telshm_wait (TelStatShm *tp, unsigned int seen[TSG_N], int mask,
+    int ms);
+extern int telshm_notifyfd (TelStatShm *tp, int mask);
 
 
 
@@ -9,7 +9,9 @@
 #include <errno.h>
 
 #include <unistd.h>
+#include <poll.h>
 #include <sys/types.h>
+#include <sys/ioctl.h>
 #include <sys/stat.h>
 #include <sys/param.h>
 #include <sys/socket.h>
@@ -18,6 +20,11 @@
 
 #include "csimc.h"
 
+#define	CSI_MAXQ	NADDR	/* max queries in one csi_rixn() batch */
+#define	CSI_QLEN	32	/* longest integer reply kept, with '\0' */
+
+static int csi_rpart (int fd, char buf[], int *np, int buflen);
+
 /*** low-level server connections, not for applications ***********************/
 
 /* create the public csimcd server endpoint on this host with the given port.
@@ -387,3 +394,124 @@ csi_rix (int fd, char *fmt, ...)
 
 	return (strtol (buf, NULL, 0));
 }
+
+/* first half of a split-phase csi_rix(): send the expression to the node on fd
+ * but do not wait for its reply. collect it, and those of any other nodes
+ * queried the same way, with csi_rixn().
+ * since we do not return an error code we exit if fail.
+ */
+void
+csi_wix (int fd, char *fmt, ...)
+{
+	va_list ap;
+	char buf[1024];
+	int l;
+
+	va_start (ap, fmt);
+	l = vsprintf (buf, fmt, ap);
+	va_end (ap);
+
+	if (write (fd, buf, l) < 0) {
+	    fprintf (stderr, "csi_wix(%d, %s): %s\n", fd, buf, strerror(errno));
+	    exit(1);
+	}
+}
+
+/* second half of a split-phase csi_rix(): wait for the integer replies from
+ * each of the n fds[] sent an expression with csi_wix(), reading each one as
+ * it arrives, and crack them into vals[]. thus the round trips to all the
+ * nodes overlap rather than follow one another.
+ * N.B. each fd may appear at most once, and at most CSI_MAXQ in all.
+ * return 0 if all ok, else -1 with vals[] -1 for those which failed.
+ */
+int
+csi_rixn (int n, int fds[], int vals[])
+{
+	struct pollfd pfd[CSI_MAXQ];
+	char buf[CSI_MAXQ][CSI_QLEN];
+	int len[CSI_MAXQ];
+	int i, left, ret = 0;
+
+	if (n > CSI_MAXQ) {
+	    errno = EINVAL;
+	    return (-1);
+	}
+
+	for (i = 0; i < n; i++) {
+	    pfd[i].fd = fds[i];
+	    pfd[i].events = POLLIN;
+	    len[i] = 0;
+	}
+
+	for (left = n; left > 0; ) {
+	    if (poll (pfd, n, -1) < 0) {
+		if (errno == EINTR)
+		    continue;
+		for (i = 0; i < n; i++)
+		    if (pfd[i].fd >= 0)
+			vals[i] = -1;
+		return (-1);
+	    }
+
+	    for (i = 0; i < n; i++) {
+		int s;
+
+		if (pfd[i].fd < 0 || !pfd[i].revents)
+		    continue;
+		s = csi_rpart (fds[i], buf[i], &len[i], CSI_QLEN);
+		if (s == 0)
+		    continue;		/* more to come */
+		if (s < 0) {
+		    vals[i] = -1;
+		    ret = -1;
+		} else
+		    vals[i] = strtol (buf[i], NULL, 0);
+		pfd[i].fd = -1;		/* poll() now skips it */
+		left--;
+	    }
+	}
+
+	return (ret);
+}
+
+/* send each of the n exprs[] to its fds[] then collect all their integer
+ * replies into vals[], as csi_wix() then csi_rixn().
+ * return 0 if all ok, else -1 with vals[] -1 for those which failed.
+ */
+int
+csi_rixv (int n, int fds[], char *exprs[], int vals[])
+{
+	int i;
+
+	for (i = 0; i < n; i++)
+	    csi_wix (fds[i], "%s", exprs[i]);
+	return (csi_rixn (n, fds, vals));
+}
+
+/* read what is ready on fd into buf[*np], up through the next newline. bytes
+ * beyond buflen-1 are discarded. fd must be readable, ie, known to not block
+ * for the first byte.
+ * return 1 when the line is complete in buf[] with '\0' added, 0 if there is
+ * more to come, or -1 if EOF or error.
+ */
+static int
+csi_rpart (int fd, char buf[], int *np, int buflen)
+{
+	int avail;
+	char c;
+
+	do {
+	    if (read (fd, &c, 1) <= 0)
+		return (-1);
+	    if (c == '\n') {
+		if (*np < buflen-1)
+		    buf[(*np)++] = c;
+		buf[*np] = '\0';
+		return (1);
+	    }
+	    if (*np < buflen-1)
+		buf[(*np)++] = c;
+	} while (ioctl (fd, FIONREAD, &avail) == 0 && avail > 0);
+
+	return (0);
+}
@@ -118,6 +118,9 @@ extern int csi_rebootAll (char *host, int port);
 extern int csi_w (int fd, char *fmt, ...);
 extern int csi_r (int fd, char buf[], int buflen);
 extern int csi_rix (int fd, char *fmt, ...);
+extern void csi_wix (int fd, char *fmt, ...);
+extern int csi_rixn (int n, int fds[], int vals[]);
+extern int csi_rixv (int n, int fds[], char *exprs[], int vals[]);
 extern int csi_wr (int fd, char buf[], int buflen, char *fmt, ...);
 extern int csi_f2h (int fd);
 extern int csi_f2n (int fd);
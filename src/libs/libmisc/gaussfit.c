@@ -1,6 +1,7 @@
 /* given an array of pixels find the best-fit gaussian.
  * this is not really for external use -- just by starStats().
- * N.B. this is NOT reentrant.
+ * solved with lmfit() using the analytic derivatives of the gaussian; the
+ * pixels travel with each call so this is reentrant.
  */
 
 #include <stdio.h>
@@ -12,29 +13,51 @@
 
 #define	FRACERR		.0001		/* fractional error */
 
-/* storage so we can get at the pixels from g_chisqr() */
-static int g_npix;
-static int *g_pix;
+/* the pixels being fit */
+typedef struct {
+    int npix;
+    int *pix;
+} GPix;
 
-/* evaluate the chisqr of these parameters */
-static double
-g_chisqr (p)
-double p[];
+/* residuals of gaussian p = max, cen, sigma from the pixels */
+static int
+g_resid (double p[], double r[], void *arg)
 {
+	GPix *gp = (GPix *)arg;
 	double max = p[0];
 	double cen = p[1];
 	double sig = p[2];
-	double cs;
 	int i;
 
-	cs = 0.0;
-	for (i = 0; i < g_npix; i++) {
+	if (sig == 0)
+	    return (-1);
+	for (i = 0; i < gp->npix; i++) {
 	    double dx = i - cen;
-	    double e = max*exp(-(dx*dx)/(2*sig*sig)) - g_pix[i];
-	    cs += e*e;
+	    r[i] = max*exp(-(dx*dx)/(2*sig*sig)) - gp->pix[i];
 	}
 
-	return (cs);
+	return (0);
+}
+
+/* derivatives of each residual with respect to max, cen and sigma */
+static void
+g_jac (double p[], double J[], void *arg)
+{
+	GPix *gp = (GPix *)arg;
+	double max = p[0];
+	double cen = p[1];
+	double sig = p[2];
+	double s2 = sig*sig;
+	int i;
+
+	for (i = 0; i < gp->npix; i++) {
+	    double dx = i - cen;
+	    double e = exp(-(dx*dx)/(2*s2));
+
+	    J[3*i+0] = e;
+	    J[3*i+1] = max*e*dx/s2;
+	    J[3*i+2] = max*e*dx*dx/(s2*sig);
+	}
 }
 
 void
@@ -46,8 +69,9 @@ double *cenp;	/* return gaussian center pixel location */
 double *fwhmp;	/* return full width half max */
 {
 	int min, max, avg, maxi, halfw;
-	double p0[3], p1[3];
+	double p0[3];
 	double sigma;
+	GPix g;
 	int i;
 
 	/* make initial guesses */
@@ -85,12 +109,9 @@ double *fwhmp;	/* return full width half max */
 	p0[0] = (double)max;
 	p0[1] = (double)maxi;
 	p0[2] = sigma;
-	p1[0] = (double)max*1.1;
-	p1[1] = (double)maxi+2;
-	p1[2] = sigma+1.0;
-	g_pix = pix;
-	g_npix = n;
-	if (lstsqr (g_chisqr, p0, p1, 3, FRACERR) < 0) {
+	g.pix = pix;
+	g.npix = n;
+	if (lmfit (g_resid, g_jac, (void *)&g, p0, 3, n, FRACERR) < 0) {
 	    *gmaxp = (double)max;
 	    *cenp = (double)maxi;
 	    *fwhmp = sigma/2;
@@ -98,7 +119,7 @@ double *fwhmp;	/* return full width half max */
 	} else {
 	    *gmaxp = p0[0];
 	    *cenp = p0[1];
-	    *fwhmp = 2.354 * p0[2];
+	    *fwhmp = 2.354 * fabs(p0[2]);
 	}
 }
 
@@ -0,0 +1,215 @@
+/* the local horizon profile, as a fine table of altitude by azimuth.
+ *
+ * the profile is read once from a file of lines giving azimuth and altitude
+ * of the horizon, both in degrees, azimuth E of N, such as RAO.hzn. blank
+ * lines and those starting with # are skipped. between the given points the
+ * horizon is taken to run straight, wrapping through north.
+ *
+ * from that a table of HZN_N cells is made, each holding the highest the
+ * horizon gets anywhere within it, so looking up any azimuth is just an
+ * index and never lets a target through below the real horizon. hznAlt()
+ * may be passed as the hznf horizon function libastro and vc_open() take,
+ * and may be called from any number of threads once loaded.
+ *
+ * with no profile loaded the horizon is flat at 0.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+
+#include "P_.h"
+#include "astro.h"
+#include "configfile.h"
+#include "telenv.h"
+#include "horizon.h"
+
+#define	HZN_N		7200		/* cells, so each is 0.05 degrees */
+#define	HZN_MAXPTS	3600		/* most points in a profile file */
+
+typedef struct {
+    double az, alt;		/* rads */
+} HznPt;
+
+static double hzntab[HZN_N];	/* highest horizon alt in each cell, rads */
+static int hznloaded;		/* set once hzntab[] is good */
+
+static int ptcmp (const void *p1, const void *p2);
+static double interp (HznPt pts[], int i, double az);
+
+/* build the horizon table from the profile in fn.
+ * return 0 if ok, else -1 with a reason in whynot[] and the previous
+ * table, if any, still in use.
+ */
+int
+hznLoad (char *fn, char whynot[])
+{
+	static HznPt pts[HZN_MAXPTS+2];
+	double newtab[HZN_N];
+	char line[256];
+	int npts = 0;
+	int lineno = 0;
+	int i, j;
+	FILE *fp;
+
+	fp = telfopen (fn, "r");
+	if (!fp) {
+	    sprintf (whynot, "%s: %s", fn, strerror(errno));
+	    return (-1);
+	}
+	while (fgets (line, sizeof(line), fp)) {
+	    double az, alt;
+	    char *lp;
+
+	    lineno++;
+	    for (lp = line; *lp == ' ' || *lp == '\t'; lp++)
+		continue;
+	    if (*lp == '#' || *lp == '\n' || *lp == '\r' || *lp == '\0')
+		continue;
+	    if (sscanf (lp, "%lf %lf", &az, &alt) != 2
+					    || alt < -90 || alt > 90) {
+		sprintf (whynot, "%s: bad line %d", fn, lineno);
+		(void) fclose (fp);
+		return (-1);
+	    }
+	    if (npts == HZN_MAXPTS) {
+		sprintf (whynot, "%s: more than %d points", fn, HZN_MAXPTS);
+		(void) fclose (fp);
+		return (-1);
+	    }
+	    az = degrad(az);
+	    range (&az, 2*PI);
+	    npts++;
+	    pts[npts].az = az;
+	    pts[npts].alt = degrad(alt);
+	}
+	(void) fclose (fp);
+	if (npts == 0) {
+	    sprintf (whynot, "%s: no points", fn);
+	    return (-1);
+	}
+
+	/* in order of az, with the last wrapped before 0 and the first
+	 * after 2*PI so every az lies between two points.
+	 */
+	qsort ((void *)&pts[1], npts, sizeof(HznPt), ptcmp);
+	pts[0].az = pts[npts].az - 2*PI;
+	pts[0].alt = pts[npts].alt;
+	pts[npts+1].az = pts[1].az + 2*PI;
+	pts[npts+1].alt = pts[1].alt;
+
+	/* each cell is as high as its ends or any point within */
+	for (i = j = 0; i < HZN_N; i++) {
+	    double az0 = 2*PI*i/HZN_N;
+	    double az1 = 2*PI*(i+1)/HZN_N;
+	    double hi;
+
+	    while (pts[j+1].az <= az0)
+		j++;
+	    hi = interp (pts, j, az0);
+	    while (pts[j+1].az < az1) {
+		j++;
+		if (pts[j].alt > hi)
+		    hi = pts[j].alt;
+	    }
+	    hi = fmax (hi, interp (pts, j, az1));
+	    newtab[i] = hi;
+	}
+
+	memcpy ((void *)hzntab, (void *)newtab, sizeof(hzntab));
+	hznloaded = 1;
+	return (0);
+}
+
+/* load the profile named by HORIZON in config file cfn, if any, and put its
+ * full path in fn[], else leave the horizon flat and set fn[] to "".
+ * return 0 if ok or none is named, else -1 with a reason in whynot[].
+ */
+int
+hznCfg (char *cfn, char fn[], char whynot[])
+{
+	char name[1024];
+
+	fn[0] = '\0';
+	if (read1CfgEntry (0, cfn, "HORIZON", CFG_STR, name, sizeof(name)) < 0){
+	    hznloaded = 0;
+	    return (0);
+	}
+	telfixpath (fn, name);
+	if (hznLoad (fn, whynot) < 0) {
+	    fn[0] = '\0';
+	    return (-1);
+	}
+	return (0);
+}
+
+/* return 1 if a profile is loaded, else 0 */
+int
+hznHave()
+{
+	return (hznloaded);
+}
+
+/* return the altitude of the horizon at az, both in rads */
+double
+hznAlt (double az)
+{
+	int i;
+
+	if (!hznloaded)
+	    return (0.0);
+	i = (int)floor(az*(HZN_N/(2*PI))) % HZN_N;
+	if (i < 0)
+	    i += HZN_N;
+	return (hzntab[i]);
+}
+
+/* set up[i] to 1 if alt[i] and az[i] are above both minalt and the horizon,
+ * else 0, for each of n positions, all rads.
+ * return how many are up.
+ */
+int
+hznAbove (double alt[], double az[], int n, double minalt, char up[])
+{
+	double scale = HZN_N/(2*PI);
+	int nup = 0;
+	int i;
+
+	for (i = 0; i < n; i++) {
+	    int u = alt[i] >= minalt;
+
+	    if (u && hznloaded) {
+		int c = (int)floor(az[i]*scale) % HZN_N;
+
+		if (c < 0)
+		    c += HZN_N;
+		u = alt[i] >= hzntab[c];
+	    }
+	    up[i] = u;
+	    nup += u;
+	}
+	return (nup);
+}
+
+/* compare two HznPt by az, for qsort */
+static int
+ptcmp (const void *p1, const void *p2)
+{
+	double d = ((HznPt *)p1)->az - ((HznPt *)p2)->az;
+
+	return (d < 0 ? -1 : d > 0 ? 1 : 0);
+}
+
+/* altitude of the horizon at az, which lies from pts[i] to pts[i+1] */
+static double
+interp (HznPt pts[], int i, double az)
+{
+	HznPt *a = &pts[i], *b = &pts[i+1];
+	double daz = b->az - a->az;
+
+	if (daz <= 0)
+	    return (fmax (a->alt, b->alt));
+	return (a->alt + (b->alt - a->alt)*(az - a->az)/daz);
+}
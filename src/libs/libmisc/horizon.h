@@ -0,0 +1,13 @@
+/* the local horizon profile, see horizon.c */
+
+#ifndef _HORIZON_H
+#define	_HORIZON_H
+
+extern int hznLoad (char *fn, char whynot[]);
+extern int hznCfg (char *cfn, char fn[], char whynot[]);
+extern int hznHave (void);
+extern double hznAlt (double az);
+extern int hznAbove (double alt[], double az[], int n, double minalt,
+    char up[]);
+
+#endif /* _HORIZON_H */
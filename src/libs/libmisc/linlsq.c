@@ -0,0 +1,102 @@
+/* linear least squares solver.
+ * for models which are linear in their parameters, such as the plate
+ * polynomials, this finds the best fit directly instead of searching for it
+ * with lstsqr(). uses householder QR on the design matrix, which keeps the
+ * accuracy that forming the normal equations would square away. each column
+ * is first scaled to unit length so terms of very different size, like x
+ * and x*x*x*x*x in pixels, are treated alike.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "lstsqr.h"
+
+#define	MINRDIAG	1e-12	/* smallest useful |R[k][k]| of scaled columns */
+
+/* find x[n] which minimizes |A x - b| for the m rows of n terms in A[m*n],
+ * stored row by row, and the m values in b[].
+ * N.B. A[] and b[] are overwritten.
+ * return 0 if ok, else -1 if m < n, the columns of A are not independent,
+ * or no memory.
+ */
+int
+linlsq (double A[], double b[], int m, int n, double x[])
+{
+	double *scale, *rdiag;
+	int i, j, k;
+	int ret = -1;
+
+	if (n < 1 || m < n)
+	    return (-1);
+	scale = (double *) malloc (n * sizeof(double));
+	rdiag = (double *) malloc (n * sizeof(double));
+	if (!scale || !rdiag)
+	    goto out;
+
+	/* scale each column to unit length */
+	for (j = 0; j < n; j++) {
+	    double s = 0;
+
+	    for (i = 0; i < m; i++)
+		s += A[i*n+j]*A[i*n+j];
+	    if (s == 0)
+		goto out;
+	    scale[j] = sqrt(s);
+	    for (i = 0; i < m; i++)
+		A[i*n+j] /= scale[j];
+	}
+
+	/* reduce A to R with householder reflections, applying each to b too.
+	 * reflection k is left in column k below the diagonal.
+	 */
+	for (k = 0; k < n; k++) {
+	    double s = 0, v2, f;
+
+	    for (i = k; i < m; i++)
+		s += A[i*n+k]*A[i*n+k];
+	    s = sqrt(s);
+	    if (s < MINRDIAG)
+		goto out;
+	    if (A[k*n+k] > 0)
+		s = -s;
+	    rdiag[k] = s;
+	    A[k*n+k] -= s;
+	    v2 = -2*s*A[k*n+k];		/* |v|^2, for v = a - s*e_k */
+
+	    for (j = k+1; j < n; j++) {
+		f = 0;
+		for (i = k; i < m; i++)
+		    f += A[i*n+k]*A[i*n+j];
+		f = 2*f/v2;
+		for (i = k; i < m; i++)
+		    A[i*n+j] -= f*A[i*n+k];
+	    }
+	    f = 0;
+	    for (i = k; i < m; i++)
+		f += A[i*n+k]*b[i];
+	    f = 2*f/v2;
+	    for (i = k; i < m; i++)
+		b[i] -= f*A[i*n+k];
+	}
+
+	/* back substitute R x = Q'b then undo the column scaling */
+	for (k = n-1; k >= 0; k--) {
+	    double sum = b[k];
+
+	    for (j = k+1; j < n; j++)
+		sum -= A[k*n+j]*x[j];
+	    x[k] = sum/rdiag[k];
+	}
+	for (k = 0; k < n; k++)
+	    x[k] /= scale[k];
+	ret = 0;
+
+    out:
+	if (scale)
+	    free ((void *)scale);
+	if (rdiag)
+	    free ((void *)rdiag);
+	return (ret);
+}
@@ -0,0 +1,197 @@
+/* Levenberg-Marquardt least squares solver.
+ * where lstsqr() searches blindly for the minimum of a chisqr, this is
+ * given the vector of residuals whose sum of squares is to be minimized and,
+ * if the caller has them, their partial derivatives, and so usually needs far
+ * fewer evaluations. everything travels through the caller's arg so it is
+ * reentrant. each step solves the damped linear problem with linlsq().
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "lstsqr.h"
+
+#define	MAXITER		200	/* max accepted steps */
+#define	LAMBDA0		1e-3	/* initial damping */
+#define	MAXLAMBDA	1e16	/* damping beyond which no step can help */
+#define	DELTA		1e-7	/* fractional param change for numeric derivs */
+
+static int numjac (LMResid resid, void *arg, double p[], double r[], int np,
+    int nr, double J[], double rt[]);
+static double sumsq (double r[], int n);
+
+/* find the np params p[] which minimize the sum of squares of the nr
+ * residuals found by resid(p,r,arg). if jac is not NULL, jac(p,J,arg) fills
+ * J[nr*np], row by row, with dr[i]/dp[j]; else these are found numerically.
+ * resid() may return -1 to mark p as unacceptable, else it returns 0.
+ * stop when a step improves the sum of squares by less than fraction ftol.
+ * return number of steps taken if ok, else -1 if the initial p is not
+ * acceptable, no progress is possible from the start, ftol is not reached
+ * within MAXITER steps, or no memory.
+ * p[] is the best solution found in either case.
+ */
+int
+lmfit (
+LMResid resid,			/* fill r[] with residuals at p */
+LMJacob jac,			/* fill J[] with derivs at p, or NULL */
+void *arg,			/* passed to each call of resid() and jac() */
+double p[],			/* in: guess: back: best */
+int np,				/* entries in p[] */
+int nr,				/* number of residuals */
+double ftol)			/* desired fractional tolerance */
+{
+	double *J, *A, *b, *r, *rt, *pt, *D, *dp;
+	double lambda = LAMBDA0;
+	double c, ct;
+	int iter, i, j;
+	int ret = -1;
+
+	if (np < 1 || nr < np)
+	    return (-1);
+
+	J = (double *) malloc (nr*np*sizeof(double));
+	A = (double *) malloc ((nr+np)*np*sizeof(double));
+	b = (double *) malloc ((nr+np)*sizeof(double));
+	r = (double *) malloc (nr*sizeof(double));
+	rt = (double *) malloc (nr*sizeof(double));
+	pt = (double *) malloc (np*sizeof(double));
+	D = (double *) calloc (np, sizeof(double));
+	dp = (double *) malloc (np*sizeof(double));
+	if (!J || !A || !b || !r || !rt || !pt || !D || !dp)
+	    goto out;
+
+	if ((*resid) (p, r, arg) < 0)
+	    goto out;
+	c = sumsq (r, nr);
+
+	for (iter = 0; iter < MAXITER; iter++) {
+	    int accepted = 0;
+
+	    if (c == 0) {
+		ret = iter;
+		break;
+	    }
+
+	    if (jac)
+		(*jac) (p, J, arg);
+	    else if (numjac (resid, arg, p, r, np, nr, J, rt) < 0) {
+		if (iter > 0)
+		    ret = iter;
+		break;
+	    }
+
+	    /* damp each param by the largest its column has been so far,
+	     * which keeps the steps independent of the params' units.
+	     */
+	    for (j = 0; j < np; j++) {
+		double s = 0;
+
+		for (i = 0; i < nr; i++)
+		    s += J[i*np+j]*J[i*np+j];
+		if (s > D[j])
+		    D[j] = s;
+		if (D[j] == 0)
+		    D[j] = 1;
+	    }
+
+	    /* raise lambda until the step J dp = -r, damped by
+	     * sqrt(lambda D) dp = 0, improves the fit.
+	     */
+	    while (lambda < MAXLAMBDA) {
+		memcpy ((void *)A, (void *)J, nr*np*sizeof(double));
+		memset ((void *)&A[nr*np], 0, np*np*sizeof(double));
+		for (i = 0; i < nr; i++)
+		    b[i] = -r[i];
+		for (j = 0; j < np; j++) {
+		    A[(nr+j)*np+j] = sqrt(lambda*D[j]);
+		    b[nr+j] = 0;
+		}
+		if (linlsq (A, b, nr+np, np, dp) == 0) {
+		    for (j = 0; j < np; j++)
+			pt[j] = p[j] + dp[j];
+		    if ((*resid) (pt, rt, arg) == 0
+					&& (ct = sumsq (rt, nr)) < c) {
+			accepted = 1;
+			break;
+		    }
+		}
+		lambda *= 10;
+	    }
+
+	    /* no step helps: we are at the minimum as near as can be told */
+	    if (!accepted) {
+		if (iter > 0)
+		    ret = iter;
+		break;
+	    }
+
+	    memcpy ((void *)p, (void *)pt, np*sizeof(double));
+	    memcpy ((void *)r, (void *)rt, nr*sizeof(double));
+	    if (2*(c - ct) <= ftol*(c + ct)) {
+		ret = iter+1;
+		break;
+	    }
+	    c = ct;
+	    if (lambda > 1e-12)
+		lambda /= 10;
+	}
+
+    out:
+	if (J) free ((void *)J);
+	if (A) free ((void *)A);
+	if (b) free ((void *)b);
+	if (r) free ((void *)r);
+	if (rt) free ((void *)rt);
+	if (pt) free ((void *)pt);
+	if (D) free ((void *)D);
+	if (dp) free ((void *)dp);
+	return (ret);
+}
+
+/* fill J[] with forward difference derivatives of resid() at p, where the
+ * residuals are already r[]. rt[] is work space for nr residuals.
+ * return 0 if ok, else -1 if resid() rejects a nearby p.
+ */
+static int
+numjac (LMResid resid, void *arg, double p[], double r[], int np, int nr,
+double J[], double rt[])
+{
+	int i, j;
+
+	for (j = 0; j < np; j++) {
+	    double pj = p[j];
+	    double h = DELTA*fabs(pj);
+
+	    if (h == 0)
+		h = DELTA;
+	    p[j] = pj + h;
+	    h = p[j] - pj;	/* exactly representable step */
+	    if ((*resid) (p, rt, arg) < 0) {
+		/* try the other side */
+		h = -h;
+		p[j] = pj + h;
+		if ((*resid) (p, rt, arg) < 0) {
+		    p[j] = pj;
+		    return (-1);
+		}
+	    }
+	    p[j] = pj;
+	    for (i = 0; i < nr; i++)
+		J[i*np+j] = (rt[i] - r[i])/h;
+	}
+
+	return (0);
+}
+
+static double
+sumsq (double r[], int n)
+{
+	double s = 0;
+	int i;
+
+	for (i = 0; i < n; i++)
+	    s += r[i]*r[i];
+	return (s);
+}
@@ -1,7 +1,7 @@
 /* general purpose least squares solver.
  * Uses the Amoeba solver from Numerical Recipes.
- * N.B. due to the desire to let the caller user 0-based arrays and hence our
- *   having to provide an intermediate chisqr handler, this is _NOT_ reentrant.
+ * the caller's 0-based chisqr function and its argument travel with each
+ * call, so both lstsqr() and lstsqr_r() are reentrant.
  */
 
 #include <stdio.h>
@@ -11,16 +11,32 @@
 
 #include "lstsqr.h"
 
+/* the caller's function and its argument */
+typedef struct {
+    double (*chisqr)(double p[], void *arg);
+    void *arg;
+} LSFunc;
+
 /* from Numerical Recipes */
 static int amoeba(double **p, double *y, int ndim, double ftol,
-    double (*funk)(), int *nfunk);
+    LSFunc *funk, int *nfunk);
 
 /* this lets us map 1-based arrays into 0-based arrays */
-static double (*chisqr_0based)(double p[]);
 static double
-chisqr_1based (double p[])
+chisqr_1based (LSFunc *fp, double p[])
 {
-	return ((*chisqr_0based) (p+1));
+	return ((*fp->chisqr) (p+1, fp->arg));
+}
+
+/* lets lstsqr() use lstsqr_r(); arg is the caller's plain function */
+typedef struct {
+    double (*chisqr)(double p[]);
+} LSPlain;
+
+static double
+chisqr_plain (double p[], void *arg)
+{
+	return ((*((LSPlain *)arg)->chisqr) (p));
 }
 
 /* least squares solver.
@@ -33,6 +49,26 @@ double params0[],		/* in: guess: back: best */
 double params1[],		/* second guess to set characteristic scale */
 int np,				/* entries in params0[] and params1[] */
 double ftol)			/* desired fractional tolerance */
+{
+	LSPlain plain;
+
+	plain.chisqr = chisqr;
+	return (lstsqr_r (chisqr_plain, (void *)&plain, params0, params1, np,
+									ftol));
+}
+
+/* same as lstsqr() but chisqr is also handed arg, for callers which keep
+ * their data somewhere other than globals.
+ * returns number of iterations if solution converged, else -1.
+ */
+int
+lstsqr_r (
+double (*chisqr)(double p[], void *arg),/* evaluate chisqr with at p */
+void *arg,			/* passed to each call of chisqr() */
+double params0[],		/* in: guess: back: best */
+double params1[],		/* second guess to set characteristic scale */
+int np,				/* entries in params0[] and params1[] */
+double ftol)			/* desired fractional tolerance */
 {
 	/* set up the necessary temp arrays and call the amoeba() multivariat
 	 * solver. amoeba() was evidently transliterated from fortran because
@@ -43,9 +79,11 @@ double ftol)			/* desired fractional tolerance */
 	int iter;
 	int i, j;
 	int ret;
+	LSFunc f;
 
-	/* save the caller's 0-based chi sqr function */
-	chisqr_0based = chisqr;
+	/* the caller's 0-based chi sqr function */
+	f.chisqr = chisqr;
+	f.arg = arg;
 
 	/* fill p[][] with np+1 rows of each set of guesses of the np params.
 	 * fill y[] with chisqr() for each of these sets.
@@ -57,11 +95,11 @@ double ftol)			/* desired fractional tolerance */
 	    double *pi = p[i] = (double *) malloc ((np+1)*sizeof(double));
 	    for (j = 1; j <= np; j++)
 		pi[j] = (j == i-1) ? params1[j-1] : params0[j-1];
-	    y[i] = chisqr_1based(pi);
+	    y[i] = chisqr_1based(&f, pi);
 	}
 
 	/* solve */
-	ret = amoeba (p, y, np, ftol, chisqr_1based, &iter);
+	ret = amoeba (p, y, np, ftol, &f, &iter);
 
 	/* on return, each row i of p has solutions at p[1..np+1][i].
 	 * average them?? pick first one??
@@ -93,7 +131,7 @@ double ftol)			/* desired fractional tolerance */
 /* following are from Numerical Recipes in C */
 
 static double amotry(double **p, double *y, double *psum, int ndim,
-    double (*funk)(), int ihi, int *nfunk, double fac);
+    LSFunc *funk, int ihi, int *nfunk, double fac);
 static void nrerror( char error_text[]);
 static double *vector(int nl, int nh);
 static void free_vector(double *v, int nl, int nh);
@@ -110,7 +148,8 @@ static void free_vector(double *v, int nl, int nh);
 
 static int
 amoeba(p,y,ndim,ftol,funk,nfunk)
-double **p,y[],ftol,(*funk)();
+double **p,y[],ftol;
+LSFunc *funk;
 int ndim,*nfunk;
 {
 	int i,j,ilo,ihi,inhi,mpts=ndim+1;
@@ -151,7 +190,7 @@ int ndim,*nfunk;
 							psum[j]=0.5*(p[i][j]+p[ilo][j]);
 							p[i][j]=psum[j];
 						}
-						y[i]=(*funk)(psum);
+						y[i]=chisqr_1based(funk,psum);
 					}
 				}
 				*nfunk += ndim;
@@ -167,7 +206,8 @@ int ndim,*nfunk;
 
 static double
 amotry(p,y,psum,ndim,funk,ihi,nfunk,fac)
-double **p,*y,*psum,(*funk)(),fac;
+double **p,*y,*psum,fac;
+LSFunc *funk;
 int ndim,ihi,*nfunk;
 {
 	int j;
@@ -178,7 +218,7 @@ int ndim,ihi,*nfunk;
 	fac1=(1.0-fac)/ndim;
 	fac2=fac1-fac;
 	for (j=1;j<=ndim;j++) ptry[j]=psum[j]*fac1-p[ihi][j]*fac2;
-	ytry=(*funk)(ptry);
+	ytry=chisqr_1based(funk,ptry);
 	++(*nfunk);
 	if (ytry < y[ihi]) {
 		y[ihi]=ytry;
@@ -1,6 +1,17 @@
 /* lstsqr.c */
 extern int lstsqr (double (*chisqr)(double p[]), double params0[],
     double params1[], int np, double ftol);
+extern int lstsqr_r (double (*chisqr)(double p[], void *arg), void *arg,
+    double params0[], double params1[], int np, double ftol);
+
+/* lmfit.c */
+typedef int (*LMResid)(double p[], double r[], void *arg);
+typedef void (*LMJacob)(double p[], double J[], void *arg);
+extern int lmfit (LMResid resid, LMJacob jac, void *arg, double p[], int np,
+    int nr, double ftol);
+
+/* linlsq.c */
+extern int linlsq (double A[], double b[], int m, int n, double x[]);
 
 /* newton.c */
 extern int newton (double (*f)(double x), double x0, double err, double *zerop);
@@ -8,6 +8,7 @@
 #include "astro.h"
 #include "circum.h"
 #include "misc.h"
+#include "simclock.h"
 
 
 /* insure *hap is in range -PI .. PI and *decp -PI/2 .. PI/2, wrap as needed. */
@@ -43,22 +44,16 @@ haRange (double *hap)
 	    *hap -= 2*PI;
 }
 
-/* return the modified Julian date now
+/* return the modified Julian date now, simulated if in effect
  * (see astro.h for definition)
  */
 double
 mjd_now()
 {
-	struct timeval tv;
-	double t;
-
-	(void) gettimeofday (&tv, (struct timezone *)0);
-
-	/* tv is seconds since 00:00:00 1/1/1970 UTC on UNIX systems;
+	/* secs_now() is seconds since 00:00:00 1/1/1970 UTC;
 	 * mjd was 25567.5 then.
 	 */
-	t = (double)tv.tv_sec + tv.tv_usec/1000000.0;
-	return (25567.5 + t/SPD);
+	return (25567.5 + secs_now()/SPD);
 }
 
 /* given a Now, return UTC, in hours */
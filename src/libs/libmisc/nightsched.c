@@ -0,0 +1,955 @@
+/* plan a night's scans allowing for the time spent between them.
+ *
+ * sortscans() in telsched puts each scan in 20 sec slots as though the scope
+ * could be anywhere at once. here each change from one scan to the next takes
+ * the longest of the slew, with each axis accelerating at its max up to its
+ * max vel and then settling, the dome rotation and any filter change, and
+ * never less than site->setup.
+ *
+ * a plan is an order of all the jobs. it is run from dusk: each job starts as
+ * soon as the scope can get to it and it stays visible for all its exposure
+ * and readout; a job which can not is left out. the value of a plan is the
+ * exposure time it gets, each job's weighted 1/(1 + (priority-best)/NS_PRISCALE)
+ * so a job NS_PRISCALE worse in priority than the best is worth half as much.
+ *
+ * ns_greedy() places jobs by the same rules as sortscans() then runs them as
+ * telrun would, as the yardstick. ns_optimise() starts from that order and
+ * searches others by simulated annealing, one search per thread, keeping the
+ * best. visibility is worked out once per job on a grid of NS_STEP secs,
+ * above minalt and any horizon profile loaded with hznLoad().
+ *
+ * ns_next() is for when a plan has gone astray: from wherever the scope is
+ * now it picks the one job which gets the most value per sec from now until
+ * it is done, using the same grid, so it is quick enough to call each time a
+ * scan ends.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "P_.h"
+#include "astro.h"
+#include "horizon.h"
+#include "nightsched.h"
+
+#define	NS_STEP		60.0	/* visibility grid, secs */
+#define	NS_PRISCALE	100.0	/* priority difference which halves value */
+#define	NS_SLOT		20.0	/* sortscans() slot, secs */
+#define	NS_T0		0.5	/* starting temperature, as frac of mean value */
+#define	NS_T1		1e-3	/* final temperature, as frac of starting */
+#define	SIDRAD		(2*PI/86164.0905)	/* sidereal rate, rads/sec */
+
+struct _NSNight {
+    NSSite site;	/* copy of the site */
+    NSJob *jobs;	/* caller's jobs */
+    int njobs;		/* number of jobs */
+    double night;	/* secs from dusk to dawn */
+    int nsteps;		/* grid points from dusk to dawn */
+    double lst0;	/* lst at dusk, rads */
+    double az0;		/* az of ha0/dec0, rads */
+    double *len;	/* each job's exposure plus readout, secs */
+    double *worth;	/* each job's value per exposure sec */
+    double *lo, *hi;	/* each job's start window, secs after dusk */
+    int *run;		/* njobs*nsteps: visible grid points from each on */
+    float *az;		/* njobs*nsteps: az at each grid point, rads */
+    double *t;		/* last plan's start of each job, secs, or -1 */
+    int *greedy;	/* order found by ns_greedy(), all jobs */
+};
+
+/* where a plan has got to */
+typedef struct {
+    double t;		/* secs after dusk when free for the next job */
+    int pp;		/* job last pointed at, -1 if still at ha0/dec0 */
+    int filt;		/* filter in place, 0 if unknown */
+    double v;		/* value so far */
+} NSState;
+
+/* one annealing search */
+typedef struct {
+    NSNight *np;	/* the night */
+    int iters;		/* moves to try */
+    unsigned long long seed;	/* random seed */
+    int *order;		/* in: where to start; out: best found */
+    double best;	/* value of best */
+} NSSearch;
+
+static double ns_trap (double d, double v, double a);
+static double ns_wrap (double a);
+static double ns_az (NSSite *sp, double ha, double dec);
+static double ns_azat (NSNight *np, int j, double t);
+static double ns_move (NSNight *np, NSState *sp, int j);
+static double ns_when (NSNight *np, int j, double t);
+static int ns_step (NSNight *np, NSState *sp, int j, NSState *nxp,
+    double *startp, double *movep);
+static void ns_decode (NSNight *np, int order[], NSState st[], int k);
+static void ns_finish (NSNight *np, int order[], NSStats *stp);
+static void *ns_search (void *arg);
+static int ns_place (NSNight *np, int *slot, int nslots, int j, int s0,
+    int dir);
+static void ns_sort (int idx[], int n, double *key);
+static int ns_bykey (const void *p1, const void *p2);
+static double ns_rand (unsigned long long *sp);
+
+/* for ns_bykey() */
+static double *sortkey;
+static pthread_mutex_t sortlock = PTHREAD_MUTEX_INITIALIZER;
+
+/* get ready to plan jobs[njobs] on the night and site at *sp.
+ * return a handle for the other ns_ functions, else NULL if no memory.
+ * N.B. jobs[] must stay put until ns_close().
+ */
+NSNight *
+ns_open (NSSite *sp, NSJob jobs[], int njobs)
+{
+	NSNight *np = (NSNight *) calloc (1, sizeof(NSNight));
+	double gst, sl = sin(sp->sitelat), cl = cos(sp->sitelat);
+	double *alts, *azs;
+	char *up;
+	int pmin, i, k;
+
+	if (!np)
+	    return (NULL);
+	np->site = *sp;
+	np->jobs = jobs;
+	np->njobs = njobs;
+	np->night = (sp->dawn - sp->dusk)*SPD;
+	np->nsteps = (int)floor(np->night/NS_STEP) + 1;
+	np->len = (double *) malloc ((njobs+1)*sizeof(double));
+	np->worth = (double *) malloc ((njobs+1)*sizeof(double));
+	np->lo = (double *) malloc ((njobs+1)*sizeof(double));
+	np->hi = (double *) malloc ((njobs+1)*sizeof(double));
+	np->t = (double *) malloc ((njobs+1)*sizeof(double));
+	np->greedy = (int *) malloc ((njobs+1)*sizeof(int));
+	np->run = (int *) malloc ((njobs*np->nsteps+1)*sizeof(int));
+	np->az = (float *) malloc ((njobs*np->nsteps+1)*sizeof(float));
+	alts = (double *) malloc ((np->nsteps+1)*sizeof(double));
+	azs = (double *) malloc ((np->nsteps+1)*sizeof(double));
+	up = (char *) malloc (np->nsteps+1);
+	if (!np->len || !np->worth || !np->lo || !np->hi || !np->t
+				|| !np->greedy || !np->run || !np->az
+				|| !alts || !azs || !up) {
+	    if (alts)
+		free ((void *)alts);
+	    if (azs)
+		free ((void *)azs);
+	    if (up)
+		free ((void *)up);
+	    ns_close (np);
+	    return (NULL);
+	}
+
+	utc_gst (mjd_day(sp->dusk), mjd_hr(sp->dusk), &gst);
+	np->lst0 = hrrad(gst) + sp->sitelng;
+	np->az0 = ns_az (sp, sp->ha0, sp->dec0);
+
+	pmin = njobs > 0 ? jobs[0].priority : 0;
+	for (i = 1; i < njobs; i++)
+	    if (jobs[i].priority < pmin)
+		pmin = jobs[i].priority;
+
+	for (i = 0; i < njobs; i++) {
+	    NSJob *jp = &jobs[i];
+	    int *run = &np->run[i*np->nsteps];
+	    float *az = &np->az[i*np->nsteps];
+	    double sd = sin(jp->dec), cd = cos(jp->dec);
+
+	    np->len[i] = jp->dur + sp->readout;
+	    np->worth[i] = 1.0/(1.0 + (jp->priority - pmin)/NS_PRISCALE);
+	    if (jp->lo || jp->hi) {
+		np->lo[i] = (jp->lo - sp->dusk)*SPD;
+		np->hi[i] = (jp->hi - sp->dusk)*SPD;
+	    } else {
+		np->lo[i] = 0;
+		np->hi[i] = np->night;
+	    }
+	    jp->start = 0;
+	    np->t[i] = -1;
+
+	    /* whether visible at each point, then how many on from each */
+	    for (k = 0; k < np->nsteps; k++) {
+		double ha = ns_wrap (np->lst0 + k*NS_STEP*SIDRAD - jp->ra);
+		double ca = cos(ha);
+
+		if (jp->cal) {
+		    run[k] = 1;
+		    az[k] = 0;
+		} else {
+		    alts[k] = asin (sl*sd + cl*cd*ca);
+		    azs[k] = atan2 (-sin(ha)*cd, cl*sd - sl*cd*ca);
+		    run[k] = fabs(ha) <= sp->maxha && alts[k] <= sp->maxalt
+						    && jp->dec <= sp->maxdec;
+		    az[k] = (float) azs[k];
+		}
+	    }
+	    if (!jp->cal) {
+		(void) hznAbove (alts, azs, np->nsteps, sp->minalt, up);
+		for (k = 0; k < np->nsteps; k++)
+		    run[k] = run[k] && up[k];
+	    }
+	    for (k = np->nsteps-2; k >= 0; k--)
+		if (run[k])
+		    run[k] += run[k+1];
+	}
+
+	free ((void *)alts);
+	free ((void *)azs);
+	free ((void *)up);
+
+	ns_greedy (np, NULL);
+	return (np);
+}
+
+/* plan the jobs by the rules of sortscans(), by slot in order of priority,
+ * then run them in time order as telrun would: a job is missed if the one
+ * before is still going at its slot time or if, once the scope gets there,
+ * it is no longer visible or past its window.
+ * set each job's start, and *stp if stp.
+ */
+void
+ns_greedy (NSNight *np, NSStats *stp)
+{
+	int nslots = (int)floor(np->night/NS_SLOT);
+	int *slot = (int *) calloc (nslots+1, sizeof(int));
+	int *byp = (int *) malloc ((np->njobs+1)*sizeof(int));
+	int *xj = (int *) malloc ((np->njobs+1)*sizeof(int));
+	int *at = (int *) malloc ((np->njobs+1)*sizeof(int));
+	double *key = (double *) malloc ((np->njobs+1)*sizeof(double));
+	NSState st;
+	NSStats stats;
+	int i, n, b, pass;
+
+	if (!slot || !byp || !xj || !at || !key) {
+	    for (i = 0; i < np->njobs; i++)
+		np->greedy[i] = i;
+	    goto out;
+	}
+
+	for (i = 0; i < np->njobs; i++) {
+	    byp[i] = i;
+	    at[i] = -1;
+	    key[i] = np->jobs[i].priority;
+	}
+	ns_sort (byp, np->njobs, key);
+
+	/* each block of the same priority in turn */
+	for (b = 0; b < np->njobs; b += n) {
+	    int p = np->jobs[byp[b]].priority;
+
+	    for (n = 1; b+n < np->njobs && np->jobs[byp[b+n]].priority == p;)
+		n++;
+
+	    /* 0: windowed, around their middle; 1: evening, forwards from
+	     * dusk by set time; 2: morning, backwards from dawn by rise time;
+	     * 3: the rest, around transit.
+	     */
+	    for (pass = 0; pass < 4; pass++) {
+		int nx = 0;
+
+		for (i = b; i < b+n; i++) {
+		    int j = byp[i];
+		    NSJob *jp = &np->jobs[j];
+		    int *run = &np->run[j*np->nsteps];
+		    int last = np->nsteps-1;
+		    int want;
+
+		    if (at[j] >= 0 || (pass == 0) != (jp->lo || jp->hi))
+			continue;
+		    if (pass == 0)
+			want = 0;
+		    else if (jp->cal)
+			want = 1;
+		    else if (run[0]
+			    && ns_wrap (np->lst0 - jp->ra) > 0)
+			want = 1;
+		    else if (run[last]
+			    && ns_wrap (np->lst0+last*NS_STEP*SIDRAD-jp->ra) < 0)
+			want = 2;
+		    else
+			want = 3;
+		    if (want == pass)
+			xj[nx++] = j;
+		}
+
+		/* evening by increasing set, morning by decreasing rise */
+		if (pass == 1 || pass == 2) {
+		    for (i = 0; i < nx; i++) {
+			int *run = &np->run[xj[i]*np->nsteps];
+			int k;
+
+			if (pass == 1)
+			    key[xj[i]] = run[0];
+			else {
+			    for (k = 0; k < np->nsteps && !run[k]; k++)
+				continue;
+			    key[xj[i]] = -k;
+			}
+		    }
+		    ns_sort (xj, nx, key);
+		}
+
+		for (i = 0; i < nx; i++) {
+		    int j = xj[i];
+		    double tt;
+
+		    switch (pass) {
+		    case 0:
+			tt = (np->lo[j] + np->hi[j])/2;
+			at[j] = ns_place (np, slot, nslots, j,
+					(int)floor(tt/NS_SLOT + .5), 0);
+			if (at[j] >= 0 && (at[j]*NS_SLOT < np->lo[j]
+						|| at[j]*NS_SLOT > np->hi[j]))
+			    at[j] = -1;
+			break;
+		    case 1:
+			at[j] = ns_place (np, slot, nslots, j, 0, 1);
+			break;
+		    case 2:
+			at[j] = ns_place (np, slot, nslots, j, nslots, -1);
+			break;
+		    case 3:
+			tt = ns_wrap (np->jobs[j].ra - np->lst0)/SIDRAD;
+			if (tt < 0)
+			    tt += 2*PI/SIDRAD;
+			if (tt > np->night)
+			    tt = tt - np->night < 2*PI/SIDRAD - tt ? np->night : 0;
+			at[j] = ns_place (np, slot, nslots, j,
+						    (int)floor(tt/NS_SLOT), 0);
+			break;
+		    }
+		    if (at[j] >= 0) {
+			int s, e = at[j] + (int)ceil(np->len[j]/NS_SLOT);
+			for (s = at[j]; s < e; s++)
+			    slot[s] = j+1;
+		    }
+		}
+	    }
+	}
+
+	/* the order: placed ones by slot, then the rest by priority */
+	n = 0;
+	for (i = 0; i < nslots; i++)
+	    if (slot[i] && (i == 0 || slot[i-1] != slot[i]))
+		np->greedy[n++] = slot[i]-1;
+	for (i = 0; i < np->njobs; i++)
+	    if (at[byp[i]] < 0)
+		np->greedy[n++] = byp[i];
+
+	/* run it as telrun would */
+	memset ((void *)&stats, 0, sizeof(stats));
+	st.t = 0;
+	st.pp = -1;
+	st.filt = 0;
+	st.v = 0;
+	for (i = 0; i < np->njobs; i++) {
+	    int j = np->greedy[i];
+	    double plan, c, t;
+
+	    np->t[j] = -1;
+	    if (at[j] < 0)
+		continue;
+	    plan = at[j]*NS_SLOT;
+	    c = ns_move (np, &st, j);
+	    t = st.t + c > plan ? st.t + c : plan;
+	    if (st.t >= plan || t > np->hi[j] || ns_when (np, j, t) != t) {
+		stats.nmissed++;
+		continue;
+	    }
+	    np->t[j] = t;
+	    stats.nplanned++;
+	    stats.science += np->jobs[j].dur;
+	    stats.overhead += c + np->site.readout;
+	    st.v += np->worth[j]*np->jobs[j].dur;
+	    st.t = t + np->len[j];
+	    if (!np->jobs[j].cal)
+		st.pp = j;
+	    if (np->jobs[j].filter)
+		st.filt = np->jobs[j].filter;
+	}
+	stats.value = st.v;
+	stats.idle = np->night - stats.science - stats.overhead;
+	for (i = 0; i < np->njobs; i++)
+	    np->jobs[i].start = np->t[i] < 0 ? 0
+				    : np->site.dusk + np->t[i]/SPD;
+	if (stp)
+	    *stp = stats;
+
+	/* start searches with those which ran, in their order */
+	for (i = n = 0; i < np->njobs; i++)
+	    if (np->t[np->greedy[i]] >= 0)
+		xj[n++] = np->greedy[i];
+	for (i = 0; i < np->njobs; i++)
+	    if (np->t[np->greedy[i]] < 0)
+		xj[n++] = np->greedy[i];
+	memcpy ((void *)np->greedy, (void *)xj, np->njobs*sizeof(int));
+
+    out:
+	if (slot)
+	    free ((void *)slot);
+	if (byp)
+	    free ((void *)byp);
+	if (xj)
+	    free ((void *)xj);
+	if (at)
+	    free ((void *)at);
+	if (key)
+	    free ((void *)key);
+}
+
+/* search for the order of jobs which gets the most value, starting from the
+ * greedy order, with nthreads searches of iters moves each, 0 for one per
+ * cpu. the same seed and nthreads always give the same plan.
+ * set each job's start, and *stp if stp.
+ */
+void
+ns_optimise (NSNight *np, int nthreads, int iters, unsigned seed,
+NSStats *stp)
+{
+	NSSearch *ss;
+	pthread_t *thr;
+	int *made;
+	int i, best;
+
+	if (nthreads <= 0)
+	    nthreads = (int) sysconf (_SC_NPROCESSORS_ONLN);
+	if (nthreads <= 0)
+	    nthreads = 1;
+
+	ss = (NSSearch *) calloc (nthreads, sizeof(NSSearch));
+	thr = (pthread_t *) calloc (nthreads, sizeof(pthread_t));
+	made = (int *) calloc (nthreads, sizeof(int));
+	for (i = 0; ss && thr && made && i < nthreads; i++) {
+	    ss[i].np = np;
+	    ss[i].iters = iters;
+	    ss[i].seed = 88172645463325252ULL ^ ((unsigned long long)seed << 32)
+					    ^ (i + 1)*0x9E3779B97F4A7C15ULL;
+	    ss[i].order = (int *) malloc ((np->njobs+1)*sizeof(int));
+	    if (!ss[i].order)
+		break;
+	    memcpy ((void *)ss[i].order, (void *)np->greedy,
+						    np->njobs*sizeof(int));
+	}
+	if (!ss || !thr || !made || i < nthreads) {
+	    /* no memory: just the greedy order */
+	    ns_finish (np, np->greedy, stp);
+	    goto out;
+	}
+
+	/* the last, or any which can not be a thread, in this one */
+	for (i = 0; i < nthreads; i++) {
+	    if (i < nthreads-1)
+		made[i] = !pthread_create (&thr[i], NULL, ns_search, &ss[i]);
+	    if (!made[i])
+		(void) ns_search (&ss[i]);
+	}
+	for (i = 0; i < nthreads; i++)
+	    if (made[i])
+		pthread_join (thr[i], NULL);
+
+	for (best = 0, i = 1; i < nthreads; i++)
+	    if (ss[i].best > ss[best].best)
+		best = i;
+	ns_finish (np, ss[best].order, stp);
+
+    out:
+	for (i = 0; ss && i < nthreads; i++)
+	    if (ss[i].order)
+		free ((void *)ss[i].order);
+	if (ss)
+	    free ((void *)ss);
+	if (thr)
+	    free ((void *)thr);
+	if (made)
+	    free ((void *)made);
+}
+
+/* check the last plan made: each job starts within its window, is visible
+ * all through and leaves time to get to it from the one before.
+ * return 0 if all ok, else -1 with why in msg[].
+ */
+int
+ns_check (NSNight *np, char msg[])
+{
+	int *order = (int *) malloc ((np->njobs+1)*sizeof(int));
+	NSState st;
+	int i, n;
+
+	if (!order) {
+	    strcpy (msg, "No memory");
+	    return (-1);
+	}
+	for (i = n = 0; i < np->njobs; i++)
+	    if (np->t[i] >= 0)
+		order[n++] = i;
+	ns_sort (order, n, np->t);
+
+	st.t = 0;
+	st.pp = -1;
+	st.filt = 0;
+	st.v = 0;
+	for (i = 0; i < n; i++) {
+	    int j = order[i];
+	    double t = np->t[j];
+
+	    if (t < st.t + ns_move (np, &st, j) - 1e-6) {
+		sprintf (msg, "Job %d starts %.1f secs too soon", j,
+					    st.t + ns_move (np, &st, j) - t);
+		break;
+	    }
+	    if (t < np->lo[j] || t > np->hi[j]) {
+		sprintf (msg, "Job %d starts outside its window", j);
+		break;
+	    }
+	    if (ns_when (np, j, t) != t) {
+		sprintf (msg, "Job %d is not visible all through", j);
+		break;
+	    }
+	    st.t = t + np->len[j];
+	    if (!np->jobs[j].cal)
+		st.pp = j;
+	    if (np->jobs[j].filter)
+		st.filt = np->jobs[j].filter;
+	}
+
+	free ((void *)order);
+	return (i < n ? -1 : 0);
+}
+
+/* pick the job to do next from the state at *hp, ignoring those with skip[]
+ * set: of those which can be done and, if hp->then >= 0, still leave time to
+ * get to job hp->then by hp->by, the one with the most value per sec from now
+ * until it is done, the first such if several.
+ * return the job, with when it can start, mjd, at *startp, else -1.
+ */
+int
+ns_next (NSNight *np, NSHere *hp, char skip[], double *startp)
+{
+	NSNight here = *np;
+	double by = ((hp->by ? hp->by : np->site.dawn) - np->site.dusk)*SPD;
+	double rate = 0, start = 0;
+	NSState st, nx;
+	int j, best = -1;
+
+	/* the same night but starting from where the scope is now */
+	here.site.ha0 = hp->ha;
+	here.site.dec0 = hp->dec;
+	here.az0 = ns_az (&here.site, hp->ha, hp->dec);
+	st.t = (hp->now - np->site.dusk)*SPD;
+	st.pp = -1;
+	st.filt = hp->filter;
+	st.v = 0;
+	if (st.t < 0 || st.t >= np->night)
+	    return (-1);
+
+	for (j = 0; j < np->njobs; j++) {
+	    double t, r;
+
+	    if ((skip && skip[j]) || j == hp->then)
+		continue;
+	    if (ns_step (&here, &st, j, &nx, &t, NULL) < 0 || nx.t > by)
+		continue;
+	    if (hp->then >= 0 && nx.t + ns_move (&here, &nx, hp->then) > by)
+		continue;
+	    if (hp->avoidw > 0 && !np->jobs[j].cal
+		    && fabs(ns_wrap(ns_azat (np, j, t) - hp->avoidaz)) < hp->avoidw)
+		continue;
+	    r = nx.v/(nx.t - st.t);
+	    if (best < 0 || r > rate) {
+		best = j;
+		rate = r;
+		start = t;
+	    }
+	}
+
+	if (best >= 0)
+	    *startp = np->site.dusk + start/SPD;
+	return (best);
+}
+
+/* all done with np */
+void
+ns_close (NSNight *np)
+{
+	if (!np)
+	    return;
+	if (np->len)
+	    free ((void *)np->len);
+	if (np->worth)
+	    free ((void *)np->worth);
+	if (np->lo)
+	    free ((void *)np->lo);
+	if (np->hi)
+	    free ((void *)np->hi);
+	if (np->t)
+	    free ((void *)np->t);
+	if (np->greedy)
+	    free ((void *)np->greedy);
+	if (np->run)
+	    free ((void *)np->run);
+	if (np->az)
+	    free ((void *)np->az);
+	free ((void *)np);
+}
+
+/* secs to move d rads from rest to rest at up to vel v and acc a */
+static double
+ns_trap (double d, double v, double a)
+{
+	if (d <= 0 || v <= 0 || a <= 0)
+	    return (0.0);
+	if (d <= v*v/a)
+	    return (2*sqrt(d/a));
+	return (d/v + v/a);
+}
+
+/* a in range -PI..PI */
+static double
+ns_wrap (double a)
+{
+	a = fmod (a, 2*PI);
+	if (a > PI)
+	    a -= 2*PI;
+	if (a < -PI)
+	    a += 2*PI;
+	return (a);
+}
+
+/* az at sp of ha and dec, rads */
+static double
+ns_az (NSSite *sp, double ha, double dec)
+{
+	double sl = sin(sp->sitelat), cl = cos(sp->sitelat);
+
+	return (atan2 (-sin(ha)*cos(dec), cl*sin(dec) - sl*cos(dec)*cos(ha)));
+}
+
+/* az of job j t secs after dusk, from the grid */
+static double
+ns_azat (NSNight *np, int j, double t)
+{
+	int k = (int)floor(t/NS_STEP);
+
+	if (k < 0)
+	    k = 0;
+	if (k >= np->nsteps)
+	    k = np->nsteps-1;
+	return (np->az[j*np->nsteps + k]);
+}
+
+/* secs to get from *sp to job j */
+static double
+ns_move (NSNight *np, NSState *sp, int j)
+{
+	NSSite *sitep = &np->site;
+	NSJob *jp = &np->jobs[j];
+	double slew = 0, dome = 0, c = sitep->setup;
+
+	if (!jp->cal) {
+	    double dha, ddec, daz;
+
+	    if (sp->pp < 0) {
+		dha = ns_wrap (np->lst0 + sp->t*SIDRAD - jp->ra - sitep->ha0);
+		ddec = jp->dec - sitep->dec0;
+		daz = ns_azat (np, j, sp->t) - np->az0;
+	    } else {
+		NSJob *pp = &np->jobs[sp->pp];
+
+		dha = ns_wrap (pp->ra - jp->ra);
+		ddec = jp->dec - pp->dec;
+		daz = ns_azat (np, j, sp->t) - ns_azat (np, sp->pp, sp->t);
+	    }
+	    slew = ns_trap (fabs(dha), sitep->hvel, sitep->hacc);
+	    ddec = ns_trap (fabs(ddec), sitep->dvel, sitep->dacc);
+	    if (ddec > slew)
+		slew = ddec;
+	    if (slew > 0)
+		slew += sitep->settle;
+	    if (sitep->domevel > 0)
+		dome = fabs(ns_wrap(daz))/sitep->domevel;
+	}
+
+	if (slew > c)
+	    c = slew;
+	if (dome > c)
+	    c = dome;
+	if (jp->filter && jp->filter != sp->filt && sitep->filtsecs > c)
+	    c = sitep->filtsecs;
+	return (c);
+}
+
+/* return the earliest secs after dusk, not before t, at which job j can start
+ * and stay visible all through its exposure and readout, else -1.
+ */
+static double
+ns_when (NSNight *np, int j, double t)
+{
+	int *run = &np->run[j*np->nsteps];
+	int k = (int)floor(t/NS_STEP);
+
+	if (k < 0)
+	    k = 0;
+	while (k < np->nsteps) {
+	    int need = (int)ceil((t + np->len[j])/NS_STEP) - k + 1;
+
+	    if (run[k] >= need)
+		return (t);
+	    k += run[k] + 1;
+	    t = k*NS_STEP;
+	}
+	return (-1.0);
+}
+
+/* from *sp do job j if possible, leaving the new state in *nxp and, if
+ * wanted, its start and the time getting to it.
+ * return 0 if did it, else -1 with *nxp just *sp.
+ */
+static int
+ns_step (NSNight *np, NSState *sp, int j, NSState *nxp, double *startp,
+double *movep)
+{
+	NSJob *jp = &np->jobs[j];
+	double c = ns_move (np, sp, j);
+	double t = sp->t + c;
+
+	if (t < np->lo[j])
+	    t = np->lo[j];
+	t = ns_when (np, j, t);
+	if (t < 0 || t > np->hi[j]) {
+	    *nxp = *sp;
+	    return (-1);
+	}
+
+	nxp->t = t + np->len[j];
+	nxp->pp = jp->cal ? sp->pp : j;
+	nxp->filt = jp->filter ? jp->filter : sp->filt;
+	nxp->v = sp->v + np->worth[j]*jp->dur;
+	if (startp)
+	    *startp = t;
+	if (movep)
+	    *movep = c;
+	return (0);
+}
+
+/* run order[] from st[k], the state before order[k], filling in st[k+1..] */
+static void
+ns_decode (NSNight *np, int order[], NSState st[], int k)
+{
+	for (; k < np->njobs; k++)
+	    (void) ns_step (np, &st[k], order[k], &st[k+1], NULL, NULL);
+}
+
+/* run order[] for real, setting each job's start and *stp if stp */
+static void
+ns_finish (NSNight *np, int order[], NSStats *stp)
+{
+	NSStats stats;
+	NSState st;
+	int i;
+
+	memset ((void *)&stats, 0, sizeof(stats));
+	st.t = 0;
+	st.pp = -1;
+	st.filt = 0;
+	st.v = 0;
+	for (i = 0; i < np->njobs; i++) {
+	    int j = order[i];
+	    double start, c;
+
+	    np->t[j] = -1;
+	    if (ns_step (np, &st, j, &st, &start, &c) < 0)
+		continue;
+	    np->t[j] = start;
+	    stats.nplanned++;
+	    stats.science += np->jobs[j].dur;
+	    stats.overhead += c + np->site.readout;
+	}
+	stats.value = st.v;
+	stats.idle = np->night - stats.science - stats.overhead;
+
+	for (i = 0; i < np->njobs; i++)
+	    np->jobs[i].start = np->t[i] < 0 ? 0
+				    : np->site.dusk + np->t[i]/SPD;
+	if (stp)
+	    *stp = stats;
+}
+
+/* one annealing search, as a thread.
+ * moves are swapping two jobs, moving one elsewhere and reversing a run; each
+ * is run from the first job it changes.
+ */
+static void *
+ns_search (void *arg)
+{
+	NSSearch *ssp = (NSSearch *)arg;
+	NSNight *np = ssp->np;
+	int n = np->njobs;
+	NSState *st = (NSState *) malloc ((n+1)*sizeof(NSState));
+	NSState *save = (NSState *) malloc ((n+1)*sizeof(NSState));
+	int *order = ssp->order;
+	int *best = (int *) malloc ((n+1)*sizeof(int));
+	double cur, temp, cool, mean;
+	int it, i;
+
+	if (!st || !save || !best || n < 2) {
+	    ssp->best = 0;
+	    goto out;
+	}
+
+	st[0].t = 0;
+	st[0].pp = -1;
+	st[0].filt = 0;
+	st[0].v = 0;
+	ns_decode (np, order, st, 0);
+	cur = ssp->best = st[n].v;
+	memcpy ((void *)best, (void *)order, n*sizeof(int));
+
+	for (mean = 0, i = 0; i < n; i++)
+	    mean += np->worth[i]*np->jobs[i].dur;
+	temp = NS_T0*mean/n;
+	if (temp <= 0)
+	    temp = 1;
+	cool = ssp->iters > 0 ? pow (NS_T1, 1.0/ssp->iters) : 1;
+
+	for (it = 0; it < ssp->iters; it++, temp *= cool) {
+	    int a = (int)(ns_rand(&ssp->seed)*n);
+	    int b = (int)(ns_rand(&ssp->seed)*n);
+	    int m = (int)(ns_rand(&ssp->seed)*3);
+	    int k, x, y;
+	    double new;
+
+	    if (a == b)
+		continue;
+	    if (a > b && m != 1) {
+		k = a; a = b; b = k;
+	    }
+	    k = a < b ? a : b;
+	    memcpy ((void *)&save[k+1], (void *)&st[k+1],
+						    (n-k)*sizeof(NSState));
+
+	    /* try it */
+	    switch (m) {
+	    case 0:
+		x = order[a]; order[a] = order[b]; order[b] = x;
+		break;
+	    case 1:
+		x = order[a];
+		if (a < b)
+		    memmove (&order[a], &order[a+1], (b-a)*sizeof(int));
+		else
+		    memmove (&order[b+1], &order[b], (a-b)*sizeof(int));
+		order[b] = x;
+		break;
+	    case 2:
+		for (x = a, y = b; x < y; x++, y--) {
+		    int z = order[x]; order[x] = order[y]; order[y] = z;
+		}
+		break;
+	    }
+	    ns_decode (np, order, st, k);
+	    new = st[n].v;
+
+	    if (new >= cur || ns_rand(&ssp->seed) < exp((new - cur)/temp)) {
+		cur = new;
+		if (cur > ssp->best) {
+		    ssp->best = cur;
+		    memcpy ((void *)best, (void *)order, n*sizeof(int));
+		}
+		continue;
+	    }
+
+	    /* put it back */
+	    switch (m) {
+	    case 0:
+		x = order[a]; order[a] = order[b]; order[b] = x;
+		break;
+	    case 1:
+		x = order[b];
+		if (a < b)
+		    memmove (&order[a+1], &order[a], (b-a)*sizeof(int));
+		else
+		    memmove (&order[b], &order[b+1], (a-b)*sizeof(int));
+		order[a] = x;
+		break;
+	    case 2:
+		for (x = a, y = b; x < y; x++, y--) {
+		    int z = order[x]; order[x] = order[y]; order[y] = z;
+		}
+		break;
+	    }
+	    memcpy ((void *)&st[k+1], (void *)&save[k+1],
+						    (n-k)*sizeof(NSState));
+	}
+
+	memcpy ((void *)order, (void *)best, n*sizeof(int));
+
+    out:
+	if (st)
+	    free ((void *)st);
+	if (save)
+	    free ((void *)save);
+	if (best)
+	    free ((void *)best);
+	return (NULL);
+}
+
+/* find a slot for job j, from slot s0 forwards if dir > 0, backwards from
+ * the slot before s0 if dir < 0, else the nearest to s0 either way. a slot
+ * will do if it and enough after it are free and j is visible throughout.
+ * return the slot, else -1.
+ */
+static int
+ns_place (NSNight *np, int *slot, int nslots, int j, int s0, int dir)
+{
+	int need = (int)ceil(np->len[j]/NS_SLOT);
+	int d;
+
+	for (d = dir < 0 ? 1 : 0; d <= nslots; d++) {
+	    int tries[2], i;
+
+	    tries[0] = dir < 0 ? s0 - d : s0 + d;
+	    tries[1] = dir == 0 && d > 0 ? s0 - d : -1;
+	    for (i = 0; i < 2; i++) {
+		int s = tries[i], e;
+
+		if (s < 0 || s + need > nslots)
+		    continue;
+		for (e = s; e < s + need && !slot[e]; e++)
+		    continue;
+		if (e == s + need && ns_when (np, j, s*NS_SLOT) == s*NS_SLOT)
+		    return (s);
+	    }
+	}
+	return (-1);
+}
+
+/* sort the n job indices in idx[] by increasing key[], then index */
+static void
+ns_sort (int idx[], int n, double *key)
+{
+	pthread_mutex_lock (&sortlock);
+	sortkey = key;
+	qsort ((void *)idx, n, sizeof(int), ns_bykey);
+	pthread_mutex_unlock (&sortlock);
+}
+
+static int
+ns_bykey (const void *p1, const void *p2)
+{
+	int j1 = *(int *)p1, j2 = *(int *)p2;
+	double d = sortkey[j1] - sortkey[j2];
+
+	return (d < 0 ? -1 : d > 0 ? 1 : j1 - j2);
+}
+
+/* uniform 0..1 */
+static double
+ns_rand (unsigned long long *sp)
+{
+	*sp ^= *sp << 13;
+	*sp ^= *sp >> 7;
+	*sp ^= *sp << 17;
+	return ((*sp >> 11)*(1.0/9007199254740992.0));
+}
@@ -0,0 +1,70 @@
+/* plan a night's scans allowing for the time spent between them.
+ * see nightsched.c.
+ */
+
+#ifndef _NIGHTSCHED_H
+#define	_NIGHTSCHED_H
+
+/* one scan to plan */
+typedef struct {
+    double ra, dec;	/* apparent place, rads; ignored if cal */
+    double dur;		/* exposure, secs */
+    int filter;		/* filter code, 0 if any will do */
+    int priority;	/* lower values are worth more */
+    int cal;		/* set if camera only, so no pointing */
+    double lo, hi;	/* must start within lo..hi, mjd; both 0 if any time */
+
+    /* results */
+    double start;	/* planned start, mjd, else 0 if not planned */
+} NSJob;
+
+/* the site, the night and how fast things move */
+typedef struct {
+    double sitelat, sitelng;	/* site, rads +N +E */
+    double dusk, dawn;	/* the night, mjd */
+    double minalt;	/* lowest alt, rads */
+    double maxalt;	/* highest alt, rads, ie, edge of zenith hole */
+    double maxha;	/* greatest abs HA, rads */
+    double maxdec;	/* greatest dec, rads */
+    double hvel, hacc;	/* HA axis max vel, rads/sec, and acc, rads/sec/sec */
+    double dvel, dacc;	/* Dec axis likewise */
+    double domevel;	/* dome rate, rads/sec, 0 if no dome */
+    double filtsecs;	/* time to change filter, secs */
+    double settle;	/* time to settle after any slew, secs */
+    double setup;	/* least time between one scan and the next, secs */
+    double readout;	/* camera readout after each exposure, secs */
+    double ha0, dec0;	/* where the scope starts the night, rads */
+} NSSite;
+
+/* how a plan turned out */
+typedef struct {
+    int nplanned;	/* scans planned */
+    int nmissed;	/* planned but found too late, greedy only */
+    double science;	/* secs exposing */
+    double overhead;	/* secs slewing, changing filter and reading out */
+    double idle;	/* secs waiting */
+    double value;	/* the figure optimised, see nightsched.c */
+} NSStats;
+
+/* where things stand part way through the night, for ns_next() */
+typedef struct {
+    double now;		/* mjd */
+    double ha, dec;	/* where the scope is pointing, rads */
+    int filter;		/* filter in place, 0 if unknown */
+    double by;		/* mjd by which to be done, 0 for dawn */
+    int then;		/* job which must still be reached by 'by', else -1 */
+    double avoidaz;	/* az to keep away from, rads +E of N */
+    double avoidw;	/* by this much either way, rads; 0 if none */
+} NSHere;
+
+typedef struct _NSNight NSNight;
+
+extern NSNight *ns_open (NSSite *sp, NSJob jobs[], int njobs);
+extern void ns_greedy (NSNight *np, NSStats *stp);
+extern void ns_optimise (NSNight *np, int nthreads, int iters,
+    unsigned seed, NSStats *stp);
+extern int ns_check (NSNight *np, char msg[]);
+extern int ns_next (NSNight *np, NSHere *hp, char skip[], double *startp);
+extern void ns_close (NSNight *np);
+
+#endif /* _NIGHTSCHED_H */
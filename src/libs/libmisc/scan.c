@@ -5,6 +5,11 @@
 #include <string.h>
 #include <time.h>
 #include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 
 #include "P_.h"
 #include "astro.h"
@@ -19,8 +24,34 @@
 //#define	LASTLINE	19	/* last line number in a scan (0-based) */
 #define	LASTLINE	21	/* last line number in a scan (0-based) */
 
+/* a .sls file compiled to fixed records is kept beside it as .slb: an
+ * SLBHeader, then nscans Scans, then the offset of each status byte in the
+ * .sls, then the nscans status bytes. the .sls stays the one to edit; the
+ * .slb is made again whenever the .sls is not the one it was made from.
+ */
+#define	SLB_MAGIC	"SLB2"
+
+typedef struct {
+    char magic[4];	/* SLB_MAGIC */
+    int scansz;		/* sizeof(Scan) when made, since records are raw */
+    int nscans;		/* number of scans */
+    int pad;
+    long long dev, ino;	/* the .sls it was made from */
+    long long size;
+    long long mtime, mnsec;	/* st_mtim */
+    long long ctime, cnsec;	/* st_ctim, so a touch -m back is noticed */
+} SLBHeader;
+
 int getExtVal(char *bp, Scan *sp);
 
+static size_t slbSize (int nscans);
+static void slbName (char *slsfn, char *slbfn);
+static int slbStale (SLBHeader *hp, struct stat *sp);
+static void slbStat (SLBHeader *hp, struct stat *sp);
+static int slbMap (SLSMap *mp, struct stat *sp);
+static int slbCompile (SLSMap *mp);
+static void slbPoint (SLSMap *mp);
+
 /* read the next valid entry in the .sls file at fp.
  * if find one fill in *sp and return 0, else return -1.
  * call daemonLog() to report any really bogus lines.
@@ -226,6 +257,295 @@ readNextSLS (FILE *fp, Scan *sp, long *offset)
 	return (lineno == LASTLINE+1 ? 0 : -1);
 }
 
+/* make *mp describe the scans in slsfn, first compiling slsfn again if it
+ * has changed since its .slb was made. this is just a stat when nothing has
+ * changed, so call it each time before looking at mp.
+ * slsfn is found as telfopen() would. if the .slb can not be written the
+ * compiled image is just kept in memory.
+ * return 0 if ok, else -1.
+ */
+int
+slsOpen (char *slsfn, SLSMap *mp)
+{
+	char fn[1024];
+	struct stat s;
+
+	ACPYZ (fn, slsfn);
+	if (stat (fn, &s) < 0) {
+	    if (slsfn[0] == '/')
+		goto nosls;
+	    telfixpath (fn, slsfn);
+	    if (stat (fn, &s) < 0)
+		goto nosls;
+	}
+
+	if (mp->map && !strcmp (fn, mp->slsfn)
+				&& !slbStale ((SLBHeader *)mp->map, &s))
+	    return (0);
+
+	slsClose (mp);
+	ACPYZ (mp->slsfn, fn);
+	if (slbMap (mp, &s) == 0)
+	    return (0);
+	return (slbCompile (mp));
+
+    nosls:
+	slsClose (mp);
+	return (-1);
+}
+
+/* mark scan i in mp with code, one of N(ew)/D(one)/F(ail), with a single byte
+ * write to its .sls and in place in its .slb.
+ * return 0 if ok, else -1 if the .sls has changed since slsOpen().
+ */
+int
+slsMark (SLSMap *mp, int i, int code)
+{
+	SLBHeader *hp = (SLBHeader *)mp->map;
+	struct stat s;
+	FILE *fp;
+	int ok;
+
+	if (!hp || i < 0 || i >= mp->nscans)
+	    return (-1);
+	fp = fopen (mp->slsfn, "r+");
+	if (!fp)
+	    return (-1);
+
+	/* be sure it is still the byte we think it is */
+	if (fstat (fileno(fp), &s) < 0 || slbStale (hp, &s)
+				|| fseek (fp, mp->offsets[i], SEEK_SET) < 0
+				|| fgetc (fp) != mp->status[i]) {
+	    (void) fclose (fp);
+	    return (-1);
+	}
+
+	(void) fseek (fp, mp->offsets[i], SEEK_SET);
+	(void) fputc (code, fp);
+	ok = fflush (fp) == 0 && fstat (fileno(fp), &s) == 0;
+	(void) fclose (fp);
+
+	mp->status[i] = code;
+	mp->scans[i].status = code;
+	if (!ok)
+	    return (-1);
+
+	/* the .sls is now just as the .slb says */
+	slbStat (hp, &s);
+	return (0);
+}
+
+/* let go of whatever mp holds */
+void
+slsClose (SLSMap *mp)
+{
+	if (mp->map) {
+	    if (mp->mapped)
+		(void) munmap ((void *)mp->map, mp->maplen);
+	    else
+		free ((void *)mp->map);
+	}
+	memset ((void *)mp, 0, sizeof(*mp));
+}
+
+/* size of a .slb with nscans */
+static size_t
+slbSize (int nscans)
+{
+	return (sizeof(SLBHeader) + nscans*(sizeof(Scan) + sizeof(long) + 1));
+}
+
+/* the .slb name for slsfn: its .sls suffix, if any, replaced with .slb */
+static void
+slbName (char *slsfn, char *slbfn)
+{
+	int l = strlen (slsfn);
+
+	strcpy (slbfn, slsfn);
+	if (l >= 4 && !strcasecmp (&slbfn[l-4], ".sls"))
+	    slbfn[l-4] = '\0';
+	strcat (slbfn, ".slb");
+}
+
+/* return whether hp was made from other than the .sls described by *sp */
+static int
+slbStale (SLBHeader *hp, struct stat *sp)
+{
+	return (hp->dev != (long long)sp->st_dev
+			    || hp->ino != (long long)sp->st_ino
+			    || hp->size != (long long)sp->st_size
+			    || hp->mtime != (long long)sp->st_mtim.tv_sec
+			    || hp->mnsec != (long long)sp->st_mtim.tv_nsec
+			    || hp->ctime != (long long)sp->st_ctim.tv_sec
+			    || hp->cnsec != (long long)sp->st_ctim.tv_nsec);
+}
+
+/* record in hp that it was made from the .sls described by *sp */
+static void
+slbStat (SLBHeader *hp, struct stat *sp)
+{
+	hp->dev = sp->st_dev;
+	hp->ino = sp->st_ino;
+	hp->size = sp->st_size;
+	hp->mtime = sp->st_mtim.tv_sec;
+	hp->mnsec = sp->st_mtim.tv_nsec;
+	hp->ctime = sp->st_ctim.tv_sec;
+	hp->cnsec = sp->st_ctim.tv_nsec;
+}
+
+/* map the existing .slb for mp->slsfn, if it is good and up to date with *sp.
+ * return 0 if ok, else -1.
+ */
+static int
+slbMap (SLSMap *mp, struct stat *sp)
+{
+	char slbfn[1024];
+	SLBHeader *hp;
+	struct stat s;
+	char *map;
+	int fd;
+
+	slbName (mp->slsfn, slbfn);
+	fd = open (slbfn, O_RDWR);
+	if (fd < 0)
+	    return (-1);
+	if (fstat (fd, &s) < 0 || s.st_size < sizeof(SLBHeader)) {
+	    (void) close (fd);
+	    return (-1);
+	}
+	map = (char *) mmap (NULL, s.st_size, PROT_READ|PROT_WRITE, MAP_SHARED,
+									fd, 0);
+	(void) close (fd);
+	if (map == (char *) MAP_FAILED)
+	    return (-1);
+
+	hp = (SLBHeader *)map;
+	if (memcmp (hp->magic, SLB_MAGIC, 4) || hp->scansz != sizeof(Scan)
+			    || hp->nscans < 0 || s.st_size != slbSize(hp->nscans)
+			    || slbStale (hp, sp)) {
+	    (void) munmap ((void *)map, s.st_size);
+	    return (-1);
+	}
+
+	mp->map = map;
+	mp->maplen = s.st_size;
+	mp->mapped = 1;
+	slbPoint (mp);
+	return (0);
+}
+
+/* compile mp->slsfn and write it to its .slb, then map that. if the .slb can
+ * not be written or mapped, keep the image in memory instead.
+ * return 0 if ok, else -1.
+ */
+static int
+slbCompile (SLSMap *mp)
+{
+	char slbfn[1024], tmpfn[1100];
+	SLBHeader *hp;
+	Scan *scans = NULL;
+	long *offsets = NULL;
+	int nscans = 0, mscans = 0;
+	struct stat s;
+	long offset;
+	size_t len;
+	char *img;
+	FILE *fp;
+	Scan scan;
+	int fd, i;
+
+	/* crack every scan */
+	fp = fopen (mp->slsfn, "r");
+	if (!fp)
+	    return (-1);
+	if (fstat (fileno(fp), &s) < 0) {
+	    (void) fclose (fp);
+	    return (-1);
+	}
+	while (readNextSLS (fp, &scan, &offset) == 0) {
+	    if (nscans == mscans) {
+		Scan *newscans;
+		long *newoffsets;
+
+		mscans = mscans ? 2*mscans : 64;
+		newscans = (Scan *) realloc ((void *)scans, mscans*sizeof(Scan));
+		if (newscans)
+		    scans = newscans;
+		newoffsets = (long *) realloc ((void *)offsets,
+							    mscans*sizeof(long));
+		if (newoffsets)
+		    offsets = newoffsets;
+		if (!newscans || !newoffsets) {
+		    daemonLog ("No memory to compile %s", mp->slsfn);
+		    nscans = -1;
+		    break;
+		}
+	    }
+	    scans[nscans] = scan;
+	    offsets[nscans] = offset;
+	    nscans++;
+	}
+	(void) fclose (fp);
+
+	/* build the image */
+	len = nscans < 0 ? 0 : slbSize (nscans);
+	img = len ? (char *) calloc (len, 1) : NULL;
+	if (img) {
+	    hp = (SLBHeader *)img;
+	    memcpy (hp->magic, SLB_MAGIC, 4);
+	    hp->scansz = sizeof(Scan);
+	    hp->nscans = nscans;
+	    slbStat (hp, &s);
+	    mp->map = img;
+	    slbPoint (mp);
+	    for (i = 0; i < nscans; i++) {
+		mp->scans[i] = scans[i];
+		mp->offsets[i] = offsets[i];
+		mp->status[i] = scans[i].status;
+	    }
+	}
+	if (scans)
+	    free ((void *)scans);
+	if (offsets)
+	    free ((void *)offsets);
+	if (!img) {
+	    memset ((void *)mp, 0, sizeof(*mp));
+	    return (-1);
+	}
+
+	/* write it whole then rename, so others never see it part done */
+	slbName (mp->slsfn, slbfn);
+	sprintf (tmpfn, "%s.%d", slbfn, (int)getpid());
+	fd = open (tmpfn, O_WRONLY|O_CREAT|O_TRUNC, 0664);
+	if (fd >= 0) {
+	    int ok = write (fd, img, len) == (ssize_t)len;
+
+	    if (close (fd) < 0 || !ok || rename (tmpfn, slbfn) < 0)
+		(void) unlink (tmpfn);
+	    else if (slbMap (mp, &s) == 0) {
+		free ((void *)img);
+		return (0);
+	    }
+	}
+
+	/* just keep it in memory */
+	mp->maplen = len;
+	mp->mapped = 0;
+	return (0);
+}
+
+/* point mp's arrays into mp->map */
+static void
+slbPoint (SLSMap *mp)
+{
+	SLBHeader *hp = (SLBHeader *)mp->map;
+
+	mp->nscans = hp->nscans;
+	mp->scans = (Scan *)(mp->map + sizeof(SLBHeader));
+	mp->offsets = (long *)(mp->scans + mp->nscans);
+	mp->status = (char *)(mp->offsets + mp->nscans);
+}
+
 #ifdef SCAN_TRACE
 void
 pr_scan (Scan *sp)
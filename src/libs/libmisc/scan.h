@@ -72,8 +72,25 @@ typedef struct {
     char status;	/* .sls status code: N(ew)/D(one)/F(ail) */
 } Scan;
 
+/* a .sls file compiled to fixed records and mapped, see slsOpen().
+ * N.B. zero one before its first use.
+ */
+typedef struct {
+    char slsfn[1024];	/* full path of the .sls it came from */
+    char *map;		/* whole compiled image, or NULL */
+    size_t maplen;	/* bytes in map */
+    int mapped;		/* set if map is the .slb file, else malloced */
+    int nscans;		/* number of scans */
+    Scan *scans;	/* each scan, in file order */
+    long *offsets;	/* offset of each status byte in slsfn */
+    char *status;	/* each status, N(ew)/D(one)/F(ail) */
+} SLSMap;
+
 /* helper functions */
 extern int readNextSLS (FILE *fp, Scan *sp, long *offset);
+extern int slsOpen (char *slsfn, SLSMap *mp);
+extern int slsMark (SLSMap *mp, int i, int code);
+extern void slsClose (SLSMap *mp);
 extern char *ccdCalib2Str (CCDCalib);
 extern int ccdStr2Calib (char *s, CCDCalib *cp);
 extern int ccdStr2ExtAct(char *s, CCDCalib *cp);
@@ -0,0 +1,91 @@
+/* an observatory-wide simulated clock, so a night can be run in minutes.
+ *
+ * the clock lives in the status shared memory. telescoped starts it when
+ * asked, and open_telshm() attaches every other process to it, after which
+ * secs_now(), time_now() and mjd_now() all run at its speed from its start.
+ * until attached, or while it is off, they are simply real time.
+ *
+ * only the time of day is simulated: waits for i/o and select() timeouts are
+ * still real, so loops which poll do so just as often, each covering more
+ * simulated time. use real_secs() to turn a simulated delay into a real one.
+ */
+
+#include <stdio.h>
+#include <time.h>
+#include <sys/time.h>
+
+#include "simclock.h"
+
+static SimClock *simclock;	/* attached clock, or NULL for real time */
+
+static double wall_secs (void);
+
+/* use the clock at scp from now on, such as the one in TelStatShm.
+ * NULL goes back to real time.
+ */
+void
+simclock_attach (SimClock *scp)
+{
+	simclock = scp;
+}
+
+/* start scp running at speed times real time from sim0, secs since 1970 */
+void
+simclock_start (SimClock *scp, double sim0, double speed)
+{
+	scp->on = 0;
+	scp->speed = speed > 0 ? speed : 1.0;
+	scp->wall0 = wall_secs();
+	scp->sim0 = sim0;
+	scp->on = 1;
+}
+
+/* put scp back on real time */
+void
+simclock_stop (SimClock *scp)
+{
+	scp->on = 0;
+}
+
+/* return simulated secs per real sec, 1 if real time */
+double
+simclock_speed ()
+{
+	if (simclock && simclock->on)
+	    return (simclock->speed);
+	return (1.0);
+}
+
+/* return the time now, secs since 1970 UTC, simulated if in effect */
+double
+secs_now ()
+{
+	double t = wall_secs();
+
+	if (simclock && simclock->on)
+	    t = simclock->sim0 + (t - simclock->wall0)*simclock->speed;
+	return (t);
+}
+
+/* like time(NULL), simulated if in effect */
+time_t
+time_now ()
+{
+	return ((time_t) secs_now());
+}
+
+/* return how many real secs it takes for simsecs to go by */
+double
+real_secs (double simsecs)
+{
+	return (simsecs/simclock_speed());
+}
+
+static double
+wall_secs ()
+{
+	struct timeval tv;
+
+	gettimeofday (&tv, NULL);
+	return (tv.tv_sec + tv.tv_usec*1e-6);
+}
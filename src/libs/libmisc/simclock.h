@@ -0,0 +1,26 @@
+/* observatory-wide simulated clock, see simclock.c */
+
+#ifndef _SIMCLOCK_H
+#define	_SIMCLOCK_H
+
+#include <time.h>
+
+/* while on, simulated time is sim0 + (real time - wall0)*speed.
+ * kept in TelStatShm so every process runs on the same clock.
+ */
+typedef struct {
+    int on;			/* set when simulated time is in effect */
+    double speed;		/* simulated secs per real sec */
+    double wall0;		/* real time when started, secs since 1970 */
+    double sim0;		/* simulated time then, secs since 1970 */
+} SimClock;
+
+extern void simclock_attach (SimClock *scp);
+extern void simclock_start (SimClock *scp, double sim0, double speed);
+extern void simclock_stop (SimClock *scp);
+extern double simclock_speed (void);
+extern double secs_now (void);
+extern time_t time_now (void);
+extern double real_secs (double simsecs);
+
+#endif /* _SIMCLOCK_H */
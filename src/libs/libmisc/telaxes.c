@@ -53,61 +53,67 @@ fYCn (double yc)
 	return (-fYC(yc));
 }
 
-/* global for access by chisqr */
-static int g_nstars;
-static TelAxes *g_tap;
-static double *g_H;
-static double *g_D;
-static double *g_X;
-static double *g_Y;
-static double *g_fitp;
-
-static double
-chisqr (double v[5])
+/* the pointing data being fit */
+typedef struct {
+    int nstars;
+    TelAxes *tap;		/* model being refined, p[] is copied here */
+    double *H, *D, *X, *Y;
+} AxesData;
+
+/* residuals of model p = HT, DT, XP, YC, NP for each star: HA error times
+ * cos(Dec) then Dec error, rads, so their squares sum to the angular errors
+ * squared.
+ */
+static int
+axesResid (double p[], double r[], void *arg)
 {
-	TelAxes *tap = g_tap;
-	double err = 0.0;
+	AxesData *adp = (AxesData *)arg;
+	TelAxes tax = *adp->tap;
 	int i;
 
-	tap->HT = v[0];
-	tap->DT = v[1];
-	tap->XP = v[2];
-	tap->YC = v[3];
-	tap->NP = v[4];
+	tax.HT = p[0];
+	tax.DT = p[1];
+	tax.XP = p[2];
+	tax.YC = p[3];
+	tax.NP = p[4];
 
 	/* don't let Dec solution wander over the pole */
-	if (fabs(tap->DT) > degrad(90.0))
-	    return (100.0);
-
-	for (i = 0; i < g_nstars; i++) {
-	    double x = g_X[i];
-	    double y = g_Y[i];
-	    double h, d, ca;
+	if (fabs(tax.DT) > degrad(90.0))
+	    return (-1);
 
-	    tel_realxy2ideal (tap, &x, &y);
-	    tel_xy2hadec (x, y, tap, &h, &d);
-	    solve_sphere (h-g_H[i], PI/2-g_D[i], sin(d), cos(d), &ca, NULL);
-	    err += g_fitp[i] = acos(ca);
+	for (i = 0; i < adp->nstars; i++) {
+	    double x = adp->X[i];
+	    double y = adp->Y[i];
+	    double h, d;
+
+	    tel_realxy2ideal (&tax, &x, &y);
+	    tel_xy2hadec (x, y, &tax, &h, &d);
+	    h -= adp->H[i];
+	    haRange (&h);
+	    if (h > PI)
+		h -= 2*PI;
+	    r[2*i] = h*cos(adp->D[i]);
+	    r[2*i+1] = d - adp->D[i];
 	}
 
 #ifdef CHISQR_TRACE
-	fprintf (stderr, "HDXYN: %6.3f %6.3f %6.3f %6.3f %6.3f -> %10.7f\n",
-			    tap->HT, tap->DT, tap->XP, tap->YC, tap->NP, err);
+	fprintf (stderr, "HDXYN: %6.3f %6.3f %6.3f %6.3f %6.3f\n",
+			    tax.HT, tax.DT, tax.XP, tax.YC, tax.NP);
 #endif /* CHISQR_TRACE */
 
-	/* solver seems to work better if not driving towards 0 */
-	err += 1;
-
-	return (err);
+	return (0);
 }
 
-/* set up the necessary temp arrays and call the multivariat solver.
+/* refine the model at adp->tap with lmfit() to best fit all the stars and
+ * set fitp[] to the angular error of each.
+ * return 0 if ok, else -1.
  */
 static int
-call_lstsqr (double ftol)
+call_lmfit (AxesData *adp, double ftol, double fitp[])
 {
-	TelAxes *tap = g_tap;
-	double p0[5], p1[5];
+	TelAxes *tap = adp->tap;
+	double p0[5];
+	int i;
 
 	p0[0] = tap->HT;
 	p0[1] = tap->DT;
@@ -115,13 +121,7 @@ call_lstsqr (double ftol)
 	p0[3] = tap->YC;
 	p0[4] = tap->NP;
 
-	p1[0] = 1.05*tap->HT + 0.05;
-	p1[1] = 1.05*tap->DT + 0.05;
-	p1[2] = 1.05*tap->XP + 0.05;
-	p1[3] = 1.05*tap->YC + 0.05;
-	p1[4] = tap->NP + 0.05;
-
-	if (lstsqr (chisqr, p0, p1, 5, ftol) < 0)
+	if (lmfit (axesResid, NULL, (void *)adp, p0, 5, 2*adp->nstars, ftol)<0)
 	    return (-1);
 
 	tap->HT = p0[0];
@@ -130,6 +130,18 @@ call_lstsqr (double ftol)
 	tap->YC = p0[3];
 	tap->NP = p0[4];
 
+	for (i = 0; i < adp->nstars; i++) {
+	    double x = adp->X[i];
+	    double y = adp->Y[i];
+	    double h, d, ca;
+
+	    tel_realxy2ideal (tap, &x, &y);
+	    tel_xy2hadec (x, y, tap, &h, &d);
+	    solve_sphere (h-adp->H[i], PI/2-adp->D[i], sin(d), cos(d), &ca,
+									NULL);
+	    fitp[i] = acos(ca);
+	}
+
 	return (0);
 }
 
@@ -184,6 +196,7 @@ double fitp[]	/* angular residual for each star, rads */
 	double HT, sinDT, cosDT, XP, YC, NP;
 	double x, y;
 	double A, B;
+	AxesData ad;
 	int s;
 
 	/* need at least 2 */
@@ -275,17 +288,14 @@ double fitp[]	/* angular residual for each star, rads */
 	NP = (sin(y+YC) - sin(Y[2]+YC))/(cos(y+YC)*sin(x));
 	tap->NP = NP;
 
-	/* provide global access for the model */
-	g_nstars = nstars;
-	g_H = H;
-	g_D = D;
-	g_X = X;
-	g_Y = Y;
-	g_fitp = fitp;
-	g_tap = tap;
-
 	/* refine with least-squares minimization of all residuals */
-	s = call_lstsqr(ftol);
+	ad.nstars = nstars;
+	ad.tap = tap;
+	ad.H = H;
+	ad.D = D;
+	ad.X = X;
+	ad.Y = Y;
+	s = call_lmfit (&ad, ftol, fitp);
 
 #ifdef SOLVE_TRACE
 	fprintf (stderr, "Est2: HT/DT/XP/YC/NP: %10.7f %10.7f %10.7f %10.7f %10.7f\n",
@@ -85,7 +85,7 @@ addShmFITS (FImage *fip, TelStatShm *telstatshmp)
 					"Filter Motor, rads from home");
 
 	/* weather data if not too old */
-	if (time(NULL) - telstatshmp->wxs.updtime < 30) {
+	if (real_secs(time_now() - telstatshmp->wxs.updtime) < 30) {
 	    sprintf (buf, "Weather at UT %s", asctime(gmtime(&telstatshmp->wxs.updtime)));
 	    buf[strlen(buf)-1] = '\0';	/* chop off \n */
 	    setCommentFITS (fip, "COMMENT", buf);
@@ -5,6 +5,7 @@
 
 #include "ccdcamera.h"
 #include "scan.h"
+#include "simclock.h"
 
 /* shared memory key; can be anything unlikely ;-)
  * N.B. bug in some ipcrm's prevents removing it if it's greater than 1<<31.
@@ -142,6 +143,22 @@ typedef enum {
     CAM_READ			/* shutter closed, data being read to host */
 } CamState;
 
+/* sections of TelStatShm whose changes are announced to readers.
+ * see telshm_changed() and telshm_wait().
+ */
+typedef enum {
+    TSG_TEL,			/* scope position, motors, axes, lights */
+    TSG_DOME,			/* dome and shutter */
+    TSG_CAM,			/* camera and cooler */
+    TSG_WX,			/* weather, including now.n_temp/n_pressure */
+    TSG_SCAN,			/* telrun's current scan */
+    TSG_N			/* total number of sections */
+} TelShmGen;			/* index into gen[] */
+
+#define	TSG_BIT(g)	(1 << (g))		/* mask for section g */
+#define	TSG_ALL		(TSG_BIT(TSG_N) - 1)	/* mask for all sections */
+#define	TSG_MINMS	100	/* telshm_publish() min ms between bumps */
+
 /* current state of everything.
  * H refers to the telescope axis of "longitude", be it HA or Az.
  * D refers to the telescope axis of "latitude", be it Dec or Alt.
@@ -151,6 +168,7 @@ typedef struct {
     /* time info */
     Now now;			/* current time and location info */
     int dt;			/* update period, ms */
+    SimClock simclock;		/* simulated time, iff simclock.on */
 
     /* current position now .. what you'd really see centered in camera */
     double CJ2kRA, CJ2kDec;	/* J2000 astrometric RA/Dec, rads */
@@ -195,6 +213,18 @@ typedef struct {
     /* other weather stats */
     WxStats wxs;
 
+    /* change notification: writers bump gen[] of each section they change,
+     * then anygen, which is the word readers sleep on.
+     */
+    unsigned int gen[TSG_N];	/* generation of each TelShmGen section */
+    unsigned int anygen;	/* bumped after any gen[] */
+
+    /* post-processing, filled by ppd; announced as TSG_CAM */
+    int ppqueued;		/* frames waiting */
+    int ppbusy;			/* frames being processed now */
+    int ppdone;			/* frames finished since ppd started */
+    int ppfailed;		/* frames with trouble since ppd started */
+
 } TelStatShm;
 
 /* handy shortcuts that check things for being ready for normal observing */
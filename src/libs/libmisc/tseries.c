@@ -0,0 +1,1298 @@
+/* append-only binary time series store.
+ *
+ * a store is a directory holding a file named schema, which lists the names
+ * of its value columns, and a pair of segment files for each UTC day with
+ * data: YYYYMMDD.tsd holds the samples and YYYYMMDD.tsi indexes them.
+ *
+ * a writer buffers rows then seals them into a block appended to the day's
+ * .tsd file: a header followed by each column in turn. times are kept in ms
+ * and stored as varint delta-of-deltas, so a steady cadence costs one byte
+ * per row. values are doubles stored xor'd with the previous value of the
+ * same column, sending only the non-zero middle bytes after a control byte,
+ * so a slowly changing or repeating reading costs one to a few bytes.
+ *
+ * after each block is written, one fixed-size record is appended to the
+ * day's .tsi file giving the block's time span, file location and the count,
+ * sum, min and max of each column. a query reads just the index files of the
+ * days it spans, decodes only the blocks which overlap its ends, and when
+ * downsampling takes whole blocks straight from their index summaries, so
+ * months of 10 second samples answer in milliseconds.
+ *
+ * blocks are sealed every TS_BLKSECS, at TS_BLKROWS, at midnight UTC and by
+ * tsFlush(). a crash loses at most the rows still buffered; a block cut
+ * short by a crash is trimmed off when the day is next opened for writing.
+ * one writer per store; any number of readers may run at the same time.
+ *
+ * all multibyte fields are little-endian so stores may be copied between
+ * machines.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <time.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "tseries.h"
+
+#define	TS_BLKSECS	600		/* seal a block after this many secs */
+#define	TS_BLKROWS	1024		/* max rows in one block */
+#define	TS_MSPD		86400000LL	/* ms per day */
+#define	TS_NOTIME	(-(1LL<<62))	/* time before any other */
+
+static char schemafn[] = "schema";
+static char schemaid[] = "tseries 1";
+static char blkmagic[] = "TSB1";
+
+/* block header: magic, nrows, ncols, t0, then the byte count of the time
+ * column and of each value column.
+ */
+#define	BLKHDR(nc)	(4 + 4 + 4 + 8 + 4*(1+(nc)))
+
+/* index record: t0, t1, offset, nrows, nbytes, then count, sum, min and max
+ * of each column.
+ */
+#define	IDXHDR		(8 + 8 + 8 + 4 + 4)
+#define	IDXCOL		(4 + 8 + 8 + 8)
+#define	IDXREC(nc)	(IDXHDR + IDXCOL*(nc))
+
+/* summary of one column of one block */
+typedef struct {
+    int n;			/* samples which are not NaN */
+    double sum, min, max;	/* of those samples */
+} TSSum;
+
+/* one index record */
+typedef struct {
+    long long t0, t1;		/* first and last time in block, ms */
+    long long off;		/* offset of block in .tsd */
+    int nrows;			/* rows in block */
+    int nbytes;			/* size of block in .tsd */
+    TSSum s[TS_MAXCOLS];	/* per column */
+} TSIdx;
+
+struct _TSWriter {
+    char dir[1024];		/* store directory */
+    int ncols;			/* value columns */
+    long long day;		/* day of open segment, -1 if none */
+    int dfd, ifd;		/* open segment .tsd and .tsi */
+    long long dend, iend;	/* ends of valid data in dfd and ifd */
+    long long lastms;		/* latest time accepted */
+    int nrows;			/* rows buffered */
+    long long *bt;		/* TS_BLKROWS buffered times, ms */
+    double *bv;			/* TS_BLKROWS*ncols buffered values */
+    unsigned char *buf;		/* block being encoded */
+};
+
+/* state of one tsQuery() */
+typedef struct {
+    TSResult *rp;		/* answer being built */
+    int maxrows;		/* rows allocated in rp */
+    int map[TS_MAXCOLS];	/* answer column to schema column */
+    long long ms0, ms1;		/* time range wanted, ms */
+    long long stepms;		/* bin size, ms, or 0 for every row */
+    long long bin;		/* current bin, or -1 if empty */
+    int bn;			/* rows in current bin */
+    TSSum bs[TS_MAXCOLS];	/* current bin, by answer column */
+} TSQuery;
+
+static int readSchema (char *dir, char names[TS_MAXCOLS][TS_NAMELEN],
+    char msg[]);
+static int writeSchema (char *dir, char *cols[], int ncols, char msg[]);
+static int readIndex (char *dir, long long day, int ncols, TSIdx **ipp,
+    char msg[]);
+static int openSeg (TSWriter *wp, long long day, char msg[]);
+static void closeSeg (TSWriter *wp);
+static int sealBlock (TSWriter *wp, char msg[]);
+static int encodeBlock (TSWriter *wp, TSIdx *ip);
+static int scanBlock (TSQuery *qp, int fd, TSIdx *ip, int ncols,
+    unsigned char **bufp, int *nbufp, long long **tp, double **vp,
+    int *nscrp, char msg[]);
+static void addRow (TSQuery *qp, long long ms, double row[]);
+static void addSums (TSQuery *qp, TSIdx *ip);
+static void emitBin (TSQuery *qp);
+static int growResult (TSQuery *qp);
+static void segName (char *dir, long long day, char *suffix, char fn[]);
+static long long dayOf (long long ms);
+static long long toMs (double t);
+static int putVar (unsigned char *p, unsigned long long v);
+static int getVar (unsigned char *p, unsigned char *end,
+    unsigned long long *vp);
+static int putDbl (unsigned char *p, unsigned long long x);
+static int getDbl (unsigned char *p, unsigned char *end,
+    unsigned long long *xp);
+static void put32 (unsigned char *p, unsigned long v);
+static void put64 (unsigned char *p, unsigned long long v);
+static unsigned long get32 (unsigned char *p);
+static unsigned long long get64 (unsigned char *p);
+static unsigned long long dblBits (double d);
+static double bitsDbl (unsigned long long x);
+static void addSum (TSSum *sp, double v);
+static void mergeSum (TSSum *sp, TSSum *op);
+static int writeAll (int fd, unsigned char *p, int n, long long off);
+
+/* open or create the store in dir for appending rows of the ncols values
+ * named in cols[]. if the store already exists its columns must be the same.
+ * return a handle for tsAppend() and tsClose(), else NULL with excuse in msg.
+ */
+TSWriter *
+tsOpen (char *dir, char *cols[], int ncols, char msg[])
+{
+	char names[TS_MAXCOLS][TS_NAMELEN];
+	TSWriter *wp;
+	double t0, t1;
+	long nrows, nbytes;
+	int i, n;
+
+	if (ncols < 1 || ncols > TS_MAXCOLS) {
+	    sprintf (msg, "%s: %d columns, must be 1..%d", dir, ncols,
+								TS_MAXCOLS);
+	    return (NULL);
+	}
+	for (i = 0; i < ncols; i++) {
+	    int l = strlen (cols[i]);
+	    if (l < 1 || l >= TS_NAMELEN || strpbrk (cols[i], " \t\n,")) {
+		sprintf (msg, "%s: bad column name '%s'", dir, cols[i]);
+		return (NULL);
+	    }
+	}
+
+	if (mkdir (dir, 0775) < 0 && errno != EEXIST) {
+	    sprintf (msg, "%s: %s", dir, strerror(errno));
+	    return (NULL);
+	}
+
+	/* check or establish the schema */
+	n = readSchema (dir, names, msg);
+	if (n == 0) {
+	    if (writeSchema (dir, cols, ncols, msg) < 0)
+		return (NULL);
+	} else if (n < 0)
+	    return (NULL);
+	else {
+	    if (n != ncols) {
+		sprintf (msg, "%s: store has %d columns, not %d", dir, n,
+									ncols);
+		return (NULL);
+	    }
+	    for (i = 0; i < n; i++)
+		if (strcmp (names[i], cols[i])) {
+		    sprintf (msg, "%s: column %d is %s, not %s", dir, i+1,
+							names[i], cols[i]);
+		    return (NULL);
+		}
+	}
+
+	/* find latest time so far */
+	if (tsSpan (dir, &t0, &t1, &nrows, &nbytes, msg) < 0)
+	    return (NULL);
+
+	wp = (TSWriter *) calloc (1, sizeof(TSWriter));
+	if (!wp) {
+	    sprintf (msg, "%s: no memory", dir);
+	    return (NULL);
+	}
+	wp->bt = (long long *) malloc (TS_BLKROWS * sizeof(long long));
+	wp->bv = (double *) malloc (TS_BLKROWS * ncols * sizeof(double));
+	wp->buf = (unsigned char *) malloc (BLKHDR(ncols) +
+					    TS_BLKROWS*(10 + 9*ncols));
+	if (!wp->bt || !wp->bv || !wp->buf) {
+	    sprintf (msg, "%s: no memory", dir);
+	    tsClose (wp);
+	    return (NULL);
+	}
+	(void) strncpy (wp->dir, dir, sizeof(wp->dir)-1);
+	wp->ncols = ncols;
+	wp->day = -1;
+	wp->dfd = wp->ifd = -1;
+	wp->lastms = nrows > 0 ? toMs(t1) : TS_NOTIME;
+
+	return (wp);
+}
+
+/* add one row of values v[] at time t, secs since 1970 UTC. times must not
+ * go backwards. use NaN for a missing value.
+ * return 0 if ok, else -1 with excuse in msg. rows sealed but not written
+ * because of an error are discarded so the caller may carry on.
+ */
+int
+tsAppend (TSWriter *wp, double t, double v[], char msg[])
+{
+	long long ms = toMs (t);
+	int s = 0;
+
+	if (ms < wp->lastms) {
+	    sprintf (msg, "%s: time %.3f is before last, %.3f", wp->dir, t,
+							    wp->lastms/1000.0);
+	    return (-1);
+	}
+
+	if (wp->nrows > 0 && (wp->nrows == TS_BLKROWS
+			    || dayOf(ms) != dayOf(wp->bt[0])
+			    || ms - wp->bt[0] >= TS_BLKSECS*1000LL))
+	    s = sealBlock (wp, msg);
+
+	wp->bt[wp->nrows] = ms;
+	memcpy ((void *)&wp->bv[wp->nrows*wp->ncols], (void *)v,
+						    wp->ncols*sizeof(double));
+	wp->nrows++;
+	wp->lastms = ms;
+
+	return (s);
+}
+
+/* write out any buffered rows now.
+ * return 0 if ok, else -1 with excuse in msg.
+ */
+int
+tsFlush (TSWriter *wp, char msg[])
+{
+	return (sealBlock (wp, msg));
+}
+
+/* write any buffered rows and release wp. */
+void
+tsClose (TSWriter *wp)
+{
+	char msg[1024];
+
+	if (!wp)
+	    return;
+	if (wp->bt && wp->bv && wp->buf)
+	    (void) sealBlock (wp, msg);
+	closeSeg (wp);
+	if (wp->bt)
+	    free ((void *)wp->bt);
+	if (wp->bv)
+	    free ((void *)wp->bv);
+	if (wp->buf)
+	    free ((void *)wp->buf);
+	free ((void *)wp);
+}
+
+/* fill names[] with the column names of the store in dir.
+ * return number of columns, else -1 with excuse in msg.
+ */
+int
+tsColumns (char *dir, char names[TS_MAXCOLS][TS_NAMELEN], char msg[])
+{
+	int n = readSchema (dir, names, msg);
+
+	if (n == 0) {
+	    sprintf (msg, "%s: not a time series store", dir);
+	    return (-1);
+	}
+	return (n);
+}
+
+/* find the rows of the store in dir from t0 through t1, secs since 1970
+ * UTC, with the ncols values named in cols[], or all if ncols is 0.
+ * if step > 0 combine the rows into bins of step secs starting at t0 and
+ * return the mean, min and max of each column in each bin which has any.
+ * return 0 with the answer in *rp, free it with tsFreeResult(), else -1 with
+ * excuse in msg.
+ */
+int
+tsQuery (char *dir, double t0, double t1, double step, char *cols[],
+int ncols, TSResult *rp, char msg[])
+{
+	char names[TS_MAXCOLS][TS_NAMELEN];
+	TSQuery q;
+	unsigned char *buf = NULL;
+	long long *tscr = NULL;
+	double *vscr = NULL;
+	int nbuf = 0, nscr = 0;
+	long long day, day0, day1;
+	int nsc, i, j;
+	int s = 0;
+
+	memset ((void *)rp, 0, sizeof(*rp));
+	memset ((void *)&q, 0, sizeof(q));
+
+	nsc = tsColumns (dir, names, msg);
+	if (nsc < 0)
+	    return (-1);
+	if (ncols <= 0) {
+	    for (i = 0; i < nsc; i++)
+		q.map[i] = i;
+	    ncols = nsc;
+	} else {
+	    if (ncols > TS_MAXCOLS) {
+		sprintf (msg, "%s: too many columns", dir);
+		return (-1);
+	    }
+	    for (i = 0; i < ncols; i++) {
+		for (j = 0; j < nsc; j++)
+		    if (!strcmp (cols[i], names[j]))
+			break;
+		if (j == nsc) {
+		    sprintf (msg, "%s: no column %s", dir, cols[i]);
+		    return (-1);
+		}
+		q.map[i] = j;
+	    }
+	}
+
+	q.rp = rp;
+	q.ms0 = toMs (t0);
+	q.ms1 = toMs (t1);
+	q.stepms = step > 0 ? toMs (step) : 0;
+	if (step > 0 && q.stepms < 1) {
+	    sprintf (msg, "%s: step must be at least 1 ms", dir);
+	    return (-1);
+	}
+	q.bin = -1;
+	rp->ncols = ncols;
+
+	day0 = dayOf (q.ms0);
+	day1 = dayOf (q.ms1);
+	if (day1 - day0 > 100000) {
+	    sprintf (msg, "%s: time range too large", dir);
+	    return (-1);
+	}
+
+	for (day = day0; s == 0 && day <= day1; day++) {
+	    TSIdx *idx;
+	    int fd = -1;
+	    int n;
+
+	    n = readIndex (dir, day, nsc, &idx, msg);
+	    if (n < 0) {
+		s = -1;
+		break;
+	    }
+
+	    for (i = 0; i < n; i++) {
+		TSIdx *ip = &idx[i];
+
+		if (ip->t1 < q.ms0 || ip->t0 > q.ms1)
+		    continue;
+
+		/* whole block in one bin needs only its summary */
+		if (q.stepms > 0 && ip->t0 >= q.ms0 && ip->t1 <= q.ms1
+			&& (ip->t0-q.ms0)/q.stepms == (ip->t1-q.ms0)/q.stepms) {
+		    addSums (&q, ip);
+		    continue;
+		}
+
+		if (fd < 0) {
+		    char fn[1100];
+
+		    segName (dir, day, "tsd", fn);
+		    fd = open (fn, O_RDONLY);
+		    if (fd < 0) {
+			sprintf (msg, "%s: %s", fn, strerror(errno));
+			s = -1;
+			break;
+		    }
+		}
+		if (scanBlock (&q, fd, ip, nsc, &buf, &nbuf, &tscr, &vscr,
+							    &nscr, msg) < 0) {
+		    s = -1;
+		    break;
+		}
+		if (q.rp->nrows < 0) {
+		    sprintf (msg, "%s: no memory", dir);
+		    s = -1;
+		    break;
+		}
+	    }
+
+	    if (fd >= 0)
+		(void) close (fd);
+	    if (idx)
+		free ((void *)idx);
+	}
+
+	if (s == 0 && q.bin >= 0)
+	    emitBin (&q);
+	if (s == 0 && rp->nrows < 0) {
+	    sprintf (msg, "%s: no memory", dir);
+	    s = -1;
+	}
+
+	if (buf)
+	    free ((void *)buf);
+	if (tscr)
+	    free ((void *)tscr);
+	if (vscr)
+	    free ((void *)vscr);
+	if (s < 0)
+	    tsFreeResult (rp);
+	return (s);
+}
+
+/* free the memory in a TSResult from tsQuery() */
+void
+tsFreeResult (TSResult *rp)
+{
+	if (rp->t)
+	    free ((void *)rp->t);
+	if (rp->n)
+	    free ((void *)rp->n);
+	if (rp->v)
+	    free ((void *)rp->v);
+	if (rp->vmin)
+	    free ((void *)rp->vmin);
+	if (rp->vmax)
+	    free ((void *)rp->vmax);
+	memset ((void *)rp, 0, sizeof(*rp));
+}
+
+/* find the first and last times, total rows and data bytes in the store in
+ * dir. times are 0 if there are no rows.
+ * return 0 if ok, else -1 with excuse in msg.
+ */
+int
+tsSpan (char *dir, double *t0p, double *t1p, long *nrowsp, long *nbytesp,
+char msg[])
+{
+	char names[TS_MAXCOLS][TS_NAMELEN];
+	long long t0 = 0, t1 = 0;
+	struct dirent *dep;
+	DIR *dp;
+	int nc, s = 0;
+
+	*nrowsp = 0;
+	*nbytesp = 0;
+
+	nc = tsColumns (dir, names, msg);
+	if (nc < 0)
+	    return (-1);
+
+	dp = opendir (dir);
+	if (!dp) {
+	    sprintf (msg, "%s: %s", dir, strerror(errno));
+	    return (-1);
+	}
+	while (s == 0 && (dep = readdir (dp)) != NULL) {
+	    int y, m, d, i, n;
+	    char x[8];
+	    struct tm tm;
+	    long long day;
+	    TSIdx *idx;
+
+	    if (strlen (dep->d_name) != 12 || sscanf (dep->d_name,
+			"%4d%2d%2d.%3s", &y, &m, &d, x) != 4 || strcmp(x,"tsi"))
+		continue;
+	    memset ((void *)&tm, 0, sizeof(tm));
+	    tm.tm_year = y - 1900;
+	    tm.tm_mon = m - 1;
+	    tm.tm_mday = d;
+	    day = (long long)timegm (&tm) / 86400;
+
+	    n = readIndex (dir, day, nc, &idx, msg);
+	    if (n < 0) {
+		s = -1;
+		break;
+	    }
+	    for (i = 0; i < n; i++) {
+		if ((*nrowsp == 0 && i == 0) || idx[i].t0 < t0)
+		    t0 = idx[i].t0;
+		if ((*nrowsp == 0 && i == 0) || idx[i].t1 > t1)
+		    t1 = idx[i].t1;
+		*nrowsp += idx[i].nrows;
+		*nbytesp += idx[i].nbytes;
+	    }
+	    if (idx)
+		free ((void *)idx);
+	}
+	(void) closedir (dp);
+
+	*t0p = t0/1000.0;
+	*t1p = t1/1000.0;
+	return (s);
+}
+
+/* read the column names of the store in dir into names[].
+ * return number of columns, 0 if there is no schema, or -1 with excuse in msg.
+ */
+static int
+readSchema (char *dir, char names[TS_MAXCOLS][TS_NAMELEN], char msg[])
+{
+	char fn[1100], line[128];
+	FILE *fp;
+	int n = 0;
+
+	sprintf (fn, "%s/%s", dir, schemafn);
+	fp = fopen (fn, "r");
+	if (!fp) {
+	    if (errno == ENOENT)
+		return (0);
+	    sprintf (msg, "%s: %s", fn, strerror(errno));
+	    return (-1);
+	}
+
+	if (!fgets (line, sizeof(line), fp)
+			|| strncmp (line, schemaid, strlen(schemaid))) {
+	    sprintf (msg, "%s: not a time series schema", fn);
+	    fclose (fp);
+	    return (-1);
+	}
+	while (fgets (line, sizeof(line), fp)) {
+	    char name[128];
+
+	    if (sscanf (line, "%127s", name) != 1)
+		continue;
+	    if (n == TS_MAXCOLS || strlen (name) >= TS_NAMELEN) {
+		sprintf (msg, "%s: bad column %s", fn, name);
+		fclose (fp);
+		return (-1);
+	    }
+	    strcpy (names[n++], name);
+	}
+	fclose (fp);
+
+	if (n == 0) {
+	    sprintf (msg, "%s: no columns", fn);
+	    return (-1);
+	}
+	return (n);
+}
+
+/* create the schema file in dir.
+ * return 0 if ok, else -1 with excuse in msg.
+ */
+static int
+writeSchema (char *dir, char *cols[], int ncols, char msg[])
+{
+	char fn[1100];
+	FILE *fp;
+	int i;
+
+	sprintf (fn, "%s/%s", dir, schemafn);
+	fp = fopen (fn, "w");
+	if (!fp) {
+	    sprintf (msg, "%s: %s", fn, strerror(errno));
+	    return (-1);
+	}
+	fprintf (fp, "%s\n", schemaid);
+	for (i = 0; i < ncols; i++)
+	    fprintf (fp, "%s\n", cols[i]);
+	if (fclose (fp) != 0) {
+	    sprintf (msg, "%s: %s", fn, strerror(errno));
+	    return (-1);
+	}
+	return (0);
+}
+
+/* read the index for the given day of a store with ncols columns into a
+ * malloced array at *ipp. a partial last record, as may be left while a
+ * writer is busy or after a crash, is ignored.
+ * return number of records, 0 if none (and *ipp is NULL), else -1 with
+ * excuse in msg.
+ */
+static int
+readIndex (char *dir, long long day, int ncols, TSIdx **ipp, char msg[])
+{
+	int rl = IDXREC(ncols);
+	unsigned char *buf;
+	char fn[1100];
+	struct stat st;
+	TSIdx *idx;
+	int fd, n, i, j;
+
+	*ipp = NULL;
+
+	segName (dir, day, "tsi", fn);
+	fd = open (fn, O_RDONLY);
+	if (fd < 0) {
+	    if (errno == ENOENT)
+		return (0);
+	    sprintf (msg, "%s: %s", fn, strerror(errno));
+	    return (-1);
+	}
+	if (fstat (fd, &st) < 0) {
+	    sprintf (msg, "%s: %s", fn, strerror(errno));
+	    (void) close (fd);
+	    return (-1);
+	}
+	n = st.st_size / rl;
+	if (n == 0) {
+	    (void) close (fd);
+	    return (0);
+	}
+
+	buf = (unsigned char *) malloc (n*rl);
+	idx = (TSIdx *) malloc (n*sizeof(TSIdx));
+	if (!buf || !idx) {
+	    sprintf (msg, "%s: no memory", fn);
+	    if (buf)
+		free ((void *)buf);
+	    if (idx)
+		free ((void *)idx);
+	    (void) close (fd);
+	    return (-1);
+	}
+	if (pread (fd, buf, n*rl, 0) != n*rl) {
+	    sprintf (msg, "%s: short read", fn);
+	    free ((void *)buf);
+	    free ((void *)idx);
+	    (void) close (fd);
+	    return (-1);
+	}
+	(void) close (fd);
+
+	for (i = 0; i < n; i++) {
+	    unsigned char *p = buf + i*rl;
+	    TSIdx *ip = &idx[i];
+
+	    ip->t0 = (long long) get64 (p);
+	    ip->t1 = (long long) get64 (p+8);
+	    ip->off = (long long) get64 (p+16);
+	    ip->nrows = (int) get32 (p+24);
+	    ip->nbytes = (int) get32 (p+28);
+	    p += IDXHDR;
+	    for (j = 0; j < ncols; j++, p += IDXCOL) {
+		ip->s[j].n = (int) get32 (p);
+		ip->s[j].sum = bitsDbl (get64 (p+4));
+		ip->s[j].min = bitsDbl (get64 (p+12));
+		ip->s[j].max = bitsDbl (get64 (p+20));
+	    }
+	}
+	free ((void *)buf);
+
+	*ipp = idx;
+	return (n);
+}
+
+/* make the segment for the given day the one open for writing in wp,
+ * trimming off anything left beyond the last complete index record.
+ * return 0 if ok, else -1 with excuse in msg.
+ */
+static int
+openSeg (TSWriter *wp, long long day, char msg[])
+{
+	int rl = IDXREC(wp->ncols);
+	char dfn[1100], ifn[1100];
+	struct stat st;
+
+	closeSeg (wp);
+
+	segName (wp->dir, day, "tsd", dfn);
+	segName (wp->dir, day, "tsi", ifn);
+	wp->dfd = open (dfn, O_RDWR|O_CREAT, 0664);
+	if (wp->dfd < 0) {
+	    sprintf (msg, "%s: %s", dfn, strerror(errno));
+	    return (-1);
+	}
+	wp->ifd = open (ifn, O_RDWR|O_CREAT, 0664);
+	if (wp->ifd < 0) {
+	    sprintf (msg, "%s: %s", ifn, strerror(errno));
+	    closeSeg (wp);
+	    return (-1);
+	}
+
+	/* whole index records, and the data they cover */
+	if (fstat (wp->ifd, &st) < 0) {
+	    sprintf (msg, "%s: %s", ifn, strerror(errno));
+	    closeSeg (wp);
+	    return (-1);
+	}
+	wp->iend = (st.st_size / rl) * rl;
+	wp->dend = 0;
+	if (wp->iend > 0) {
+	    unsigned char rec[IDXHDR];
+
+	    if (pread (wp->ifd, rec, IDXHDR, wp->iend - rl) != IDXHDR) {
+		sprintf (msg, "%s: short read", ifn);
+		closeSeg (wp);
+		return (-1);
+	    }
+	    wp->dend = (long long)get64 (rec+16) + get32 (rec+28);
+	}
+	if (st.st_size > wp->iend && ftruncate (wp->ifd, wp->iend) < 0) {
+	    sprintf (msg, "%s: %s", ifn, strerror(errno));
+	    closeSeg (wp);
+	    return (-1);
+	}
+
+	if (fstat (wp->dfd, &st) < 0) {
+	    sprintf (msg, "%s: %s", dfn, strerror(errno));
+	    closeSeg (wp);
+	    return (-1);
+	}
+	if (st.st_size < wp->dend) {
+	    sprintf (msg, "%s: shorter than its index", dfn);
+	    closeSeg (wp);
+	    return (-1);
+	}
+	if (st.st_size > wp->dend && ftruncate (wp->dfd, wp->dend) < 0) {
+	    sprintf (msg, "%s: %s", dfn, strerror(errno));
+	    closeSeg (wp);
+	    return (-1);
+	}
+
+	wp->day = day;
+	return (0);
+}
+
+/* close the segment files open in wp, if any */
+static void
+closeSeg (TSWriter *wp)
+{
+	if (wp->dfd >= 0)
+	    (void) close (wp->dfd);
+	if (wp->ifd >= 0)
+	    (void) close (wp->ifd);
+	wp->dfd = wp->ifd = -1;
+	wp->day = -1;
+}
+
+/* encode the rows buffered in wp as one block and append it and its index
+ * record to the segment for their day. the buffer is empty when we return.
+ * return 0 if ok, else -1 with excuse in msg.
+ */
+static int
+sealBlock (TSWriter *wp, char msg[])
+{
+	unsigned char rec[IDXHDR + IDXCOL*TS_MAXCOLS];
+	long long day;
+	TSIdx idx;
+	int rl = IDXREC(wp->ncols);
+	unsigned char *p;
+	int nrows = wp->nrows;
+	int n, i;
+
+	if (nrows == 0)
+	    return (0);
+	wp->nrows = 0;
+
+	day = dayOf (wp->bt[0]);
+	if (day != wp->day && openSeg (wp, day, msg) < 0)
+	    return (-1);
+
+	wp->nrows = nrows;
+	n = encodeBlock (wp, &idx);
+	wp->nrows = 0;
+	idx.off = wp->dend;
+
+	p = rec;
+	put64 (p, (unsigned long long)idx.t0);
+	put64 (p+8, (unsigned long long)idx.t1);
+	put64 (p+16, (unsigned long long)idx.off);
+	put32 (p+24, (unsigned long)idx.nrows);
+	put32 (p+28, (unsigned long)idx.nbytes);
+	p += IDXHDR;
+	for (i = 0; i < wp->ncols; i++, p += IDXCOL) {
+	    put32 (p, (unsigned long)idx.s[i].n);
+	    put64 (p+4, dblBits (idx.s[i].sum));
+	    put64 (p+12, dblBits (idx.s[i].min));
+	    put64 (p+20, dblBits (idx.s[i].max));
+	}
+
+	/* data first, so an index record never points past it */
+	if (writeAll (wp->dfd, wp->buf, n, wp->dend) < 0
+			|| writeAll (wp->ifd, rec, rl, wp->iend) < 0) {
+	    sprintf (msg, "%s: lost %d rows: %s", wp->dir, nrows,
+							    strerror(errno));
+	    (void) ftruncate (wp->dfd, wp->dend);
+	    (void) ftruncate (wp->ifd, wp->iend);
+	    return (-1);
+	}
+	wp->dend += n;
+	wp->iend += rl;
+
+	return (0);
+}
+
+/* encode the rows buffered in wp into wp->buf and fill in the times, size
+ * and summaries of *ip.
+ * return number of bytes in the block.
+ */
+static int
+encodeBlock (TSWriter *wp, TSIdx *ip)
+{
+	int nc = wp->ncols;
+	int nrows = wp->nrows;
+	unsigned char *hdr = wp->buf;
+	unsigned char *p = hdr + BLKHDR(nc);
+	unsigned char *p0;
+	long long prev, prevd;
+	int r, c;
+
+	memcpy (hdr, blkmagic, 4);
+	put32 (hdr+4, (unsigned long)nrows);
+	put32 (hdr+8, (unsigned long)nc);
+	put64 (hdr+12, (unsigned long long)wp->bt[0]);
+
+	/* times, as zigzag delta of deltas */
+	p0 = p;
+	prev = wp->bt[0];
+	prevd = 0;
+	for (r = 0; r < nrows; r++) {
+	    long long d = wp->bt[r] - prev;
+	    long long dd = d - prevd;
+
+	    p += putVar (p, ((unsigned long long)dd << 1) ^ (dd < 0 ? ~0ULL : 0));
+	    prev = wp->bt[r];
+	    prevd = d;
+	}
+	put32 (hdr+20, (unsigned long)(p - p0));
+
+	/* each column, xor'd with its previous value */
+	for (c = 0; c < nc; c++) {
+	    unsigned long long last = 0;
+	    TSSum *sp = &ip->s[c];
+
+	    memset ((void *)sp, 0, sizeof(*sp));
+	    p0 = p;
+	    for (r = 0; r < nrows; r++) {
+		double v = wp->bv[r*nc + c];
+		unsigned long long x = dblBits (v);
+
+		p += putDbl (p, x ^ last);
+		last = x;
+		addSum (sp, v);
+	    }
+	    put32 (hdr+24+4*c, (unsigned long)(p - p0));
+	}
+
+	ip->t0 = wp->bt[0];
+	ip->t1 = wp->bt[nrows-1];
+	ip->nrows = nrows;
+	ip->nbytes = p - hdr;
+	return (ip->nbytes);
+}
+
+/* read the block at ip from fd and add its rows within the query range to
+ * qp. *bufp, *tp and *vp are scratch, grown as needed.
+ * return 0 if ok, else -1 with excuse in msg.
+ */
+static int
+scanBlock (TSQuery *qp, int fd, TSIdx *ip, int ncols, unsigned char **bufp,
+int *nbufp, long long **tp, double **vp, int *nscrp, char msg[])
+{
+	TSResult *rp = qp->rp;
+	int nc = rp->ncols;
+	int nrows = ip->nrows;
+	unsigned char *buf, *p, *end;
+	unsigned long long u;
+	double row[TS_MAXCOLS];
+	long long ms, d;
+	int r, c, k, l;
+
+	if (ip->nbytes > *nbufp) {
+	    unsigned char *nb = (unsigned char *) realloc (*bufp, ip->nbytes);
+	    if (!nb) {
+		strcpy (msg, "no memory for block");
+		return (-1);
+	    }
+	    *bufp = nb;
+	    *nbufp = ip->nbytes;
+	}
+	if (nrows > *nscrp) {
+	    long long *nt = (long long *) realloc (*tp,
+						nrows*sizeof(long long));
+	    double *nv;
+
+	    if (nt)
+		*tp = nt;
+	    nv = (double *) realloc (*vp, nrows*TS_MAXCOLS*sizeof(double));
+	    if (nv)
+		*vp = nv;
+	    if (!nt || !nv) {
+		strcpy (msg, "no memory for block");
+		return (-1);
+	    }
+	    *nscrp = nrows;
+	}
+
+	buf = *bufp;
+	if (ip->nbytes < BLKHDR(ncols)
+		|| pread (fd, buf, ip->nbytes, ip->off) != ip->nbytes
+		|| memcmp (buf, blkmagic, 4) || (int)get32 (buf+4) != nrows
+		|| (int)get32 (buf+8) != ncols
+		|| (long long)get64 (buf+12) != ip->t0) {
+	    sprintf (msg, "bad block at %lld", ip->off);
+	    return (-1);
+	}
+
+	/* times */
+	p = buf + BLKHDR(ncols);
+	end = p + get32 (buf+20);
+	if (end > buf + ip->nbytes) {
+	    sprintf (msg, "bad times in block at %lld", ip->off);
+	    return (-1);
+	}
+	ms = ip->t0;
+	d = 0;
+	for (r = 0; r < nrows; r++) {
+	    if ((l = getVar (p, end, &u)) < 0) {
+		sprintf (msg, "bad times in block at %lld", ip->off);
+		return (-1);
+	    }
+	    p += l;
+	    d += (long long)(u >> 1) ^ -(long long)(u & 1);
+	    ms += d;
+	    (*tp)[r] = ms;
+	}
+	p = end;
+
+	/* just the columns wanted, each into its own stretch of *vp */
+	for (k = 0; k < ncols; k++) {
+	    unsigned long long x = 0;
+	    double *v = *vp + k*nrows;
+
+	    end = p + get32 (buf+24+4*k);
+	    if (end > buf + ip->nbytes) {
+		sprintf (msg, "bad column in block at %lld", ip->off);
+		return (-1);
+	    }
+	    for (c = 0; c < nc; c++)
+		if (qp->map[c] == k)
+		    break;
+	    if (c < nc) {
+		for (r = 0; r < nrows; r++) {
+		    if ((l = getDbl (p, end, &u)) < 0) {
+			sprintf (msg, "bad values in block at %lld", ip->off);
+			return (-1);
+		    }
+		    p += l;
+		    x ^= u;
+		    v[r] = bitsDbl (x);
+		}
+	    }
+	    p = end;
+	}
+
+	for (r = 0; r < nrows; r++) {
+	    ms = (*tp)[r];
+	    if (ms < qp->ms0 || ms > qp->ms1)
+		continue;
+	    for (c = 0; c < nc; c++)
+		row[c] = (*vp)[qp->map[c]*nrows + r];
+	    addRow (qp, ms, row);
+	    if (rp->nrows < 0)
+		break;
+	}
+
+	return (0);
+}
+
+/* add one row to the query answer, directly or into its bin */
+static void
+addRow (TSQuery *qp, long long ms, double row[])
+{
+	TSResult *rp = qp->rp;
+	int nc = rp->ncols;
+	int c;
+
+	if (qp->stepms == 0) {
+	    if (growResult (qp) < 0)
+		return;
+	    rp->t[rp->nrows] = ms/1000.0;
+	    rp->n[rp->nrows] = 1;
+	    memcpy ((void *)&rp->v[rp->nrows*nc], (void *)row,
+							nc*sizeof(double));
+	    rp->nrows++;
+	    return;
+	}
+
+	if ((ms - qp->ms0)/qp->stepms != qp->bin) {
+	    if (qp->bin >= 0)
+		emitBin (qp);
+	    qp->bin = (ms - qp->ms0)/qp->stepms;
+	}
+	qp->bn++;
+	for (c = 0; c < nc; c++)
+	    addSum (&qp->bs[c], row[c]);
+}
+
+/* add the summary of a block lying wholly within one bin */
+static void
+addSums (TSQuery *qp, TSIdx *ip)
+{
+	int c;
+
+	if ((ip->t0 - qp->ms0)/qp->stepms != qp->bin) {
+	    if (qp->bin >= 0)
+		emitBin (qp);
+	    qp->bin = (ip->t0 - qp->ms0)/qp->stepms;
+	}
+	qp->bn += ip->nrows;
+	for (c = 0; c < qp->rp->ncols; c++)
+	    mergeSum (&qp->bs[c], &ip->s[qp->map[c]]);
+}
+
+/* add the current bin to the answer and start anew */
+static void
+emitBin (TSQuery *qp)
+{
+	TSResult *rp = qp->rp;
+	int nc = rp->ncols;
+	int c;
+
+	if (growResult (qp) < 0)
+	    return;
+	rp->t[rp->nrows] = (qp->ms0 + qp->bin*qp->stepms)/1000.0;
+	rp->n[rp->nrows] = qp->bn;
+	for (c = 0; c < nc; c++) {
+	    TSSum *sp = &qp->bs[c];
+	    int i = rp->nrows*nc + c;
+
+	    if (sp->n > 0) {
+		rp->v[i] = sp->sum/sp->n;
+		rp->vmin[i] = sp->min;
+		rp->vmax[i] = sp->max;
+	    } else
+		rp->v[i] = rp->vmin[i] = rp->vmax[i] = NAN;
+	}
+	rp->nrows++;
+
+	qp->bn = 0;
+	memset ((void *)qp->bs, 0, sizeof(qp->bs));
+	qp->bin = -1;
+}
+
+/* make sure the answer has room for one more row.
+ * return 0 if ok, else set nrows to -1 and return -1.
+ */
+static int
+growResult (TSQuery *qp)
+{
+	TSResult *rp = qp->rp;
+	int nc = rp->ncols;
+	int binned = qp->stepms > 0;
+	int m;
+
+	if (rp->nrows < 0)
+	    return (-1);
+	if (rp->nrows < qp->maxrows)
+	    return (0);
+
+	m = qp->maxrows ? 2*qp->maxrows : 1024;
+	if (!(rp->t = (double *) realloc (rp->t, m*sizeof(double)))
+		|| !(rp->n = (int *) realloc (rp->n, m*sizeof(int)))
+		|| !(rp->v = (double *) realloc (rp->v, m*nc*sizeof(double)))
+		|| (binned && !(rp->vmin = (double *) realloc (rp->vmin,
+						    m*nc*sizeof(double))))
+		|| (binned && !(rp->vmax = (double *) realloc (rp->vmax,
+						    m*nc*sizeof(double))))) {
+	    rp->nrows = -1;
+	    return (-1);
+	}
+	qp->maxrows = m;
+	return (0);
+}
+
+/* fill fn with the name of the segment file for day with the given suffix */
+static void
+segName (char *dir, long long day, char *suffix, char fn[])
+{
+	time_t t = (time_t)(day*86400);
+	struct tm tm;
+
+	(void) gmtime_r (&t, &tm);
+	sprintf (fn, "%s/%04d%02d%02d.%s", dir, tm.tm_year+1900, tm.tm_mon+1,
+							tm.tm_mday, suffix);
+}
+
+/* UTC day number containing ms since 1970 */
+static long long
+dayOf (long long ms)
+{
+	return (ms >= 0 ? ms/TS_MSPD : -((-ms + TS_MSPD - 1)/TS_MSPD));
+}
+
+/* secs since 1970 to nearest ms */
+static long long
+toMs (double t)
+{
+	return ((long long) floor (t*1000.0 + 0.5));
+}
+
+/* store v at p as a varint, 7 bits per byte, low first.
+ * return number of bytes used, 1..10.
+ */
+static int
+putVar (unsigned char *p, unsigned long long v)
+{
+	int n = 0;
+
+	while (v >= 0x80) {
+	    p[n++] = (unsigned char)(v | 0x80);
+	    v >>= 7;
+	}
+	p[n++] = (unsigned char)v;
+	return (n);
+}
+
+/* get a varint from p, not reading at or beyond end.
+ * return number of bytes used, or -1 if it runs off the end.
+ */
+static int
+getVar (unsigned char *p, unsigned char *end, unsigned long long *vp)
+{
+	unsigned long long v = 0;
+	int n, s;
+
+	for (n = 0, s = 0; p + n < end && s < 64; n++, s += 7) {
+	    v |= (unsigned long long)(p[n] & 0x7f) << s;
+	    if (!(p[n] & 0x80)) {
+		*vp = v;
+		return (n+1);
+	    }
+	}
+	return (-1);
+}
+
+/* store the xor of two successive doubles, x, at p as a control byte then
+ * its middle bytes, most significant first. the control byte is 0 if x is
+ * 0, else 0x80 | leading zero bytes << 3 | trailing zero bytes.
+ * return number of bytes used, 1..9.
+ */
+static int
+putDbl (unsigned char *p, unsigned long long x)
+{
+	int lead, trail, k, n;
+
+	if (x == 0) {
+	    *p = 0;
+	    return (1);
+	}
+	for (lead = 0; !(x >> (8*(7-lead)) & 0xff); lead++)
+	    continue;
+	for (trail = 0; !(x >> (8*trail) & 0xff); trail++)
+	    continue;
+
+	p[0] = (unsigned char)(0x80 | lead << 3 | trail);
+	n = 1;
+	for (k = 7 - lead; k >= trail; k--)
+	    p[n++] = (unsigned char)(x >> (8*k));
+	return (n);
+}
+
+/* get an xor from p as stored by putDbl(), not reading at or beyond end.
+ * return number of bytes used, or -1 if bad.
+ */
+static int
+getDbl (unsigned char *p, unsigned char *end, unsigned long long *xp)
+{
+	unsigned long long x = 0;
+	int lead, trail, k, n;
+
+	if (p >= end)
+	    return (-1);
+	if (p[0] == 0) {
+	    *xp = 0;
+	    return (1);
+	}
+	lead = (p[0] >> 3) & 7;
+	trail = p[0] & 7;
+	if (!(p[0] & 0x80) || lead + trail > 7 || p + 9-lead-trail > end)
+	    return (-1);
+
+	n = 1;
+	for (k = 7 - lead; k >= trail; k--)
+	    x |= (unsigned long long)p[n++] << (8*k);
+	*xp = x;
+	return (n);
+}
+
+static void
+put32 (unsigned char *p, unsigned long v)
+{
+	p[0] = (unsigned char)v;
+	p[1] = (unsigned char)(v >> 8);
+	p[2] = (unsigned char)(v >> 16);
+	p[3] = (unsigned char)(v >> 24);
+}
+
+static void
+put64 (unsigned char *p, unsigned long long v)
+{
+	put32 (p, (unsigned long)(v & 0xffffffffUL));
+	put32 (p+4, (unsigned long)(v >> 32));
+}
+
+static unsigned long
+get32 (unsigned char *p)
+{
+	return ((unsigned long)p[0] | (unsigned long)p[1] << 8
+			| (unsigned long)p[2] << 16 | (unsigned long)p[3] << 24);
+}
+
+static unsigned long long
+get64 (unsigned char *p)
+{
+	return ((unsigned long long)get32 (p)
+				| (unsigned long long)get32 (p+4) << 32);
+}
+
+static unsigned long long
+dblBits (double d)
+{
+	unsigned long long x;
+
+	memcpy ((void *)&x, (void *)&d, sizeof(x));
+	return (x);
+}
+
+static double
+bitsDbl (unsigned long long x)
+{
+	double d;
+
+	memcpy ((void *)&d, (void *)&x, sizeof(d));
+	return (d);
+}
+
+/* add v to the summary at sp unless it is NaN */
+static void
+addSum (TSSum *sp, double v)
+{
+	if (isnan (v))
+	    return;
+	if (sp->n == 0 || v < sp->min)
+	    sp->min = v;
+	if (sp->n == 0 || v > sp->max)
+	    sp->max = v;
+	sp->sum += v;
+	sp->n++;
+}
+
+/* add the summary at op to the one at sp */
+static void
+mergeSum (TSSum *sp, TSSum *op)
+{
+	if (op->n == 0)
+	    return;
+	if (sp->n == 0 || op->min < sp->min)
+	    sp->min = op->min;
+	if (sp->n == 0 || op->max > sp->max)
+	    sp->max = op->max;
+	sp->sum += op->sum;
+	sp->n += op->n;
+}
+
+/* write n bytes at p to fd at offset off.
+ * return 0 if ok, else -1 with errno set.
+ */
+static int
+writeAll (int fd, unsigned char *p, int n, long long off)
+{
+	while (n > 0) {
+	    int w = pwrite (fd, p, n, (off_t)off);
+
+	    if (w < 0) {
+		if (errno == EINTR)
+		    continue;
+		return (-1);
+	    }
+	    if (w == 0) {
+		errno = EIO;
+		return (-1);
+	    }
+	    p += w;
+	    n -= w;
+	    off += w;
+	}
+	return (0);
+}
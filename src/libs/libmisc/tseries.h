@@ -0,0 +1,36 @@
+/* append-only binary time series store, see tseries.c */
+
+#ifndef _TSERIES_H
+#define	_TSERIES_H
+
+#define	TS_MAXCOLS	32	/* max value columns in one store */
+#define	TS_NAMELEN	16	/* max column name length, including \0 */
+
+typedef struct _TSWriter TSWriter;
+
+/* answer from tsQuery().
+ * all times are secs since 1970 UTC; missing values are NaN.
+ */
+typedef struct {
+    int ncols;			/* values in each row */
+    int nrows;			/* n rows */
+    double *t;			/* row times; start of each bin if binned */
+    int *n;			/* samples in each row, 1 unless binned */
+    double *v;			/* nrows*ncols values by row; mean if binned */
+    double *vmin, *vmax;	/* same layout, min and max if binned else NULL */
+} TSResult;
+
+extern TSWriter *tsOpen (char *dir, char *cols[], int ncols, char msg[]);
+extern int tsAppend (TSWriter *wp, double t, double v[], char msg[]);
+extern int tsFlush (TSWriter *wp, char msg[]);
+extern void tsClose (TSWriter *wp);
+
+extern int tsColumns (char *dir, char names[TS_MAXCOLS][TS_NAMELEN],
+    char msg[]);
+extern int tsQuery (char *dir, double t0, double t1, double step,
+    char *cols[], int ncols, TSResult *rp, char msg[]);
+extern void tsFreeResult (TSResult *rp);
+extern int tsSpan (char *dir, double *t0p, double *t1p, long *nrowsp,
+    long *nbytesp, char msg[]);
+
+#endif /* _TSERIES_H */
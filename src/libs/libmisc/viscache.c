@@ -0,0 +1,544 @@
+/* a cache of when objects are up on a given night.
+ *
+ * for each object asked about, keep its rise, set and transit circumstances
+ * as riset_cir() would find them with the horizon at minalt, and the first
+ * and last times between dusk and dawn it is above both minalt and the local
+ * horizon profile, if any. objects are known by their database line and the
+ * day asked for, so an object edited in any way is simply a new one.
+ *
+ * all those not yet known are worked out together: the rise/set by
+ * riset_cir_batch(), the windows by stepping each through the night on a
+ * fixed grid, shared among threads each with its own AstroCtx. fixed objects
+ * are placed just once, at mid night, then only their altitude moves; others
+ * are placed at each step.
+ *
+ * the cache may be kept in a file between runs. it is only good for one site,
+ * night, minalt and horizon profile; if any differ when opened the file is
+ * ignored, and rewritten whole by the next vc_save().
+ *
+ * hznf, if used, is called from several threads at once so must not keep
+ * any state of its own.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "P_.h"
+#include "astro.h"
+#include "circum.h"
+#include "viscache.h"
+
+#define	VC_MAGIC	"VIS1"		/* file magic */
+#define	VC_STEP		60.0		/* window grid step, secs */
+#define	VC_MAXTHR	16		/* most threads used */
+#define	VC_MINPER	50		/* fewest objects worth a thread */
+
+/* what a cache depends on; all must match to use a file */
+typedef struct {
+    char magic[4];		/* VC_MAGIC */
+    int entsz;			/* sizeof(VCEntry) */
+    int nents;			/* entries following */
+    int pad;
+    double sitelat, sitelng;	/* site, rads */
+    double siteelev;		/* site elevation, earth radii */
+    double sitetemp, sitepres;	/* for refraction, C and mB */
+    double minalt;		/* rads */
+    double dusk, dawn;		/* the night, mjd */
+    unsigned long long hznhash;	/* hash of horizon profile file, 0 if none */
+} VCHeader;
+
+/* one object on one day */
+typedef struct {
+    unsigned long long key;	/* hash of db line and day, 0 if unused */
+    VisWin w;
+} VCEntry;
+
+struct _VisCache {
+    char *fn;			/* file, or NULL if none */
+    VCHeader h;			/* what entries are good for */
+    double (*hznf)(double az);	/* horizon altitude at az, or NULL */
+    double sminalt;		/* sin of minalt before refraction */
+    double lst0;		/* local sidereal time at dusk, rads */
+    VCEntry *tab;		/* open hash table */
+    int ntab;			/* size of tab[], power of 2 */
+    int nents;			/* entries used in tab[] */
+    int dirty;			/* set when entries added since saved */
+    int nhit, nmiss;		/* lookups found and worked out */
+};
+
+/* one thread's share of the windows to work out */
+typedef struct {
+    VisCache *vcp;
+    Now *np;
+    Obj **ops;
+    VisWin *wins;
+    int n;
+    int done;			/* set when finished */
+} VCShare;
+
+static unsigned long long fnv (unsigned long long h, void *p, int n);
+static unsigned long long hznHash (char *fn);
+static unsigned long long objKey (Obj *op, double day);
+static VCEntry *lookup (VisCache *vcp, unsigned long long key);
+static int insert (VisCache *vcp, unsigned long long key, VisWin *wp);
+static int grow (VisCache *vcp);
+static void readFile (VisCache *vcp);
+static void winShares (VisCache *vcp, Now *np, Obj *ops[], int nop,
+    VisWin wins[], int nthr);
+static void *winThread (void *arg);
+static void winChunk (AstroCtx *cp, VCShare *sp);
+static void window (AstroCtx *cp, VisCache *vcp, Now *np, Obj *op,
+    VisWin *wp);
+
+/* start a cache for the night dusk..dawn as seen from np with the horizon at
+ * minalt and, if hznf, also the profile it gives, as read from hznfn.
+ * if fn, load any entries it holds which are still good.
+ * return the cache, or NULL if no memory.
+ */
+VisCache *
+vc_open (char *fn, Now *np, double dusk, double dawn, double minalt,
+double (*hznf)(double az), char *hznfn)
+{
+	VisCache *vcp = (VisCache *) calloc (1, sizeof(VisCache));
+	Now n;
+
+	if (!vcp)
+	    return (NULL);
+	if (fn && !(vcp->fn = strdup (fn))) {
+	    free ((void *)vcp);
+	    return (NULL);
+	}
+
+	memcpy (vcp->h.magic, VC_MAGIC, 4);
+	vcp->h.entsz = sizeof(VCEntry);
+	vcp->h.sitelat = np->n_lat;
+	vcp->h.sitelng = np->n_lng;
+	vcp->h.siteelev = np->n_elev;
+	vcp->h.sitetemp = np->n_temp;
+	vcp->h.sitepres = np->n_pressure;
+	vcp->h.minalt = minalt;
+	vcp->h.dusk = dusk;
+	vcp->h.dawn = dawn;
+	vcp->h.hznhash = hznf ? hznHash (hznfn) : 0;
+	vcp->hznf = hznf;
+	unrefract (np->n_pressure, np->n_temp, minalt, &vcp->sminalt);
+	vcp->sminalt = sin (vcp->sminalt);
+	n = *np;
+	n.n_mjd = dusk;
+	now_lst (&n, &vcp->lst0);
+	vcp->lst0 = hrrad (vcp->lst0);
+
+	if (grow (vcp) < 0) {
+	    vc_close (vcp);
+	    return (NULL);
+	}
+	if (fn)
+	    readFile (vcp);
+	return (vcp);
+}
+
+/* fill wins[] with when each of nop ops[] is up, for the day of np.
+ * work out all those not yet in the cache, using nthr threads, or as many as
+ * there are processors if nthr is 0.
+ */
+void
+vc_get (VisCache *vcp, Now *np, Obj *ops[], int nop, VisWin wins[], int nthr)
+{
+	double day = mjd_day (np->n_mjd - np->n_tz/24.0);
+	unsigned long long *keys;
+	Obj **mops;
+	VisWin *mwins;
+	RiseSet *mrs;
+	int *which;
+	int nm = 0;
+	int i;
+
+	keys = (unsigned long long *) malloc (nop*sizeof(*keys) + 1);
+	mops = (Obj **) malloc (nop*sizeof(Obj *) + 1);
+	mwins = (VisWin *) calloc (nop+1, sizeof(VisWin));
+	mrs = (RiseSet *) malloc (nop*sizeof(RiseSet) + 1);
+	which = (int *) malloc (nop*sizeof(int) + 1);
+	if (!keys || !mops || !mwins || !mrs || !which) {
+	    /* no room to batch: as the long way, one at a time */
+	    for (i = 0; i < nop; i++) {
+		riset_cir (np, ops[i], -vcp->h.minalt, &wins[i].rs);
+		window (NULL, vcp, np, ops[i], &wins[i]);
+	    }
+	    vcp->nmiss += nop;
+	    goto out;
+	}
+
+	/* use what we know */
+	for (i = 0; i < nop; i++) {
+	    VCEntry *ep;
+
+	    keys[i] = objKey (ops[i], day);
+	    ep = lookup (vcp, keys[i]);
+	    if (ep->key) {
+		wins[i] = ep->w;
+		vcp->nhit++;
+	    } else {
+		mops[nm] = ops[i];
+		which[nm++] = i;
+	    }
+	}
+	if (nm == 0)
+	    goto out;
+
+	/* work out the rest together */
+	riset_cir_batch (np, mops, nm, -vcp->h.minalt, mrs, nthr);
+	winShares (vcp, np, mops, nm, mwins, nthr);
+	for (i = 0; i < nm; i++) {
+	    VisWin *wp = &wins[which[i]];
+
+	    *wp = mwins[i];
+	    wp->rs = mrs[i];
+	    (void) insert (vcp, keys[which[i]], wp);
+	}
+	vcp->nmiss += nm;
+
+    out:
+	if (keys)
+	    free ((void *)keys);
+	if (mops)
+	    free ((void *)mops);
+	if (mwins)
+	    free ((void *)mwins);
+	if (mrs)
+	    free ((void *)mrs);
+	if (which)
+	    free ((void *)which);
+}
+
+/* write the cache to its file if anything new has been added.
+ * the file is written whole then renamed, so others never see it part done.
+ * return 0 if ok or nothing to do, else -1.
+ */
+int
+vc_save (VisCache *vcp)
+{
+	char tmpfn[1100];
+	VCHeader h;
+	FILE *fp;
+	int i, ok;
+
+	if (!vcp->fn || !vcp->dirty)
+	    return (0);
+
+	sprintf (tmpfn, "%.1024s.%d", vcp->fn, (int)getpid());
+	fp = fopen (tmpfn, "w");
+	if (!fp)
+	    return (-1);
+	h = vcp->h;
+	h.nents = vcp->nents;
+	ok = fwrite ((void *)&h, sizeof(h), 1, fp) == 1;
+	for (i = 0; ok && i < vcp->ntab; i++)
+	    if (vcp->tab[i].key)
+		ok = fwrite ((void *)&vcp->tab[i], sizeof(VCEntry), 1, fp) == 1;
+	if (fclose (fp) != 0 || !ok || rename (tmpfn, vcp->fn) < 0) {
+	    (void) unlink (tmpfn);
+	    return (-1);
+	}
+
+	vcp->dirty = 0;
+	return (0);
+}
+
+/* report lookups found and worked out since vc_open() */
+void
+vc_stats (VisCache *vcp, int *nhitp, int *nmissp)
+{
+	*nhitp = vcp->nhit;
+	*nmissp = vcp->nmiss;
+}
+
+/* free all memory used by vcp. N.B. does not save. */
+void
+vc_close (VisCache *vcp)
+{
+	if (vcp->tab)
+	    free ((void *)vcp->tab);
+	if (vcp->fn)
+	    free ((void *)vcp->fn);
+	free ((void *)vcp);
+}
+
+/* continue FNV-1a hash h over n bytes at p */
+static unsigned long long
+fnv (unsigned long long h, void *p, int n)
+{
+	unsigned char *bp = (unsigned char *)p;
+
+	while (n-- > 0) {
+	    h ^= *bp++;
+	    h *= 1099511628211ULL;
+	}
+	return (h);
+}
+
+/* hash of the contents of the horizon profile file fn, or 1 if it can not
+ * be read, so a profile always differs from none.
+ */
+static unsigned long long
+hznHash (char *fn)
+{
+	unsigned long long h = 14695981039346656037ULL;
+	char buf[1024];
+	FILE *fp;
+	size_t n;
+
+	fp = fn ? fopen (fn, "r") : NULL;
+	if (!fp)
+	    return (1);
+	while ((n = fread (buf, 1, sizeof(buf), fp)) > 0)
+	    h = fnv (h, buf, (int)n);
+	(void) fclose (fp);
+	return (h ? h : 1);
+}
+
+/* key for object op on the given day, never 0 */
+static unsigned long long
+objKey (Obj *op, double day)
+{
+	unsigned long long h = 14695981039346656037ULL;
+	char line[1024];
+
+	/* planets are only known by name in a db line */
+	db_write_line (op, line);
+	h = fnv (h, line, strlen(line));
+	if (op->o_type == PLANET)
+	    h = fnv (h, (void *)&op->pl.pl_code, sizeof(op->pl.pl_code));
+	h = fnv (h, (void *)&day, sizeof(day));
+	return (h ? h : 1);
+}
+
+/* return the entry in vcp with key, else the empty one where it would go */
+static VCEntry *
+lookup (VisCache *vcp, unsigned long long key)
+{
+	int mask = vcp->ntab - 1;
+	int i = (int)(key ^ (key >> 32)) & mask;
+
+	while (vcp->tab[i].key && vcp->tab[i].key != key)
+	    i = (i + 1) & mask;
+	return (&vcp->tab[i]);
+}
+
+/* add *wp to vcp with key.
+ * return 0 if ok, else -1 if no memory.
+ */
+static int
+insert (VisCache *vcp, unsigned long long key, VisWin *wp)
+{
+	VCEntry *ep;
+
+	if (2*(vcp->nents+1) > vcp->ntab && grow (vcp) < 0)
+	    return (-1);
+	ep = lookup (vcp, key);
+	if (!ep->key) {
+	    ep->key = key;
+	    vcp->nents++;
+	}
+	ep->w = *wp;
+	vcp->dirty = 1;
+	return (0);
+}
+
+/* double the size of vcp's hash table, or start one.
+ * return 0 if ok, else -1 if no memory.
+ */
+static int
+grow (VisCache *vcp)
+{
+	VCEntry *old = vcp->tab;
+	int nold = vcp->ntab;
+	int i;
+
+	vcp->ntab = nold ? 2*nold : 1024;
+	vcp->tab = (VCEntry *) calloc (vcp->ntab, sizeof(VCEntry));
+	if (!vcp->tab) {
+	    vcp->tab = old;
+	    vcp->ntab = nold;
+	    return (-1);
+	}
+	for (i = 0; i < nold; i++)
+	    if (old[i].key)
+		*lookup (vcp, old[i].key) = old[i];
+	if (old)
+	    free ((void *)old);
+	return (0);
+}
+
+/* load the entries in vcp->fn if it was made for the same circumstances */
+static void
+readFile (VisCache *vcp)
+{
+	VCHeader h;
+	VCEntry e;
+	FILE *fp;
+	int i;
+
+	fp = fopen (vcp->fn, "r");
+	if (!fp)
+	    return;
+	if (fread ((void *)&h, sizeof(h), 1, fp) != 1 || h.nents < 0) {
+	    (void) fclose (fp);
+	    return;
+	}
+	i = h.nents;
+	h.nents = 0;
+	if (memcmp ((void *)&h, (void *)&vcp->h, sizeof(h)) == 0) {
+	    while (i-- > 0 && fread ((void *)&e, sizeof(e), 1, fp) == 1)
+		if (e.key && insert (vcp, e.key, &e.w) < 0)
+		    break;
+	}
+	(void) fclose (fp);
+	vcp->dirty = 0;
+}
+
+/* find the night windows of each of nop ops[] into wins[], shared among
+ * threads.
+ */
+static void
+winShares (VisCache *vcp, Now *np, Obj *ops[], int nop, VisWin wins[],
+int nthr)
+{
+	VCShare s[VC_MAXTHR];
+	pthread_t tid[VC_MAXTHR];
+	int started[VC_MAXTHR];
+	int i, n0;
+
+	if (nthr <= 0)
+	    nthr = (int) sysconf (_SC_NPROCESSORS_ONLN);
+	if (nthr > nop/VC_MINPER)
+	    nthr = nop/VC_MINPER;
+	if (nthr > VC_MAXTHR)
+	    nthr = VC_MAXTHR;
+	if (nthr < 1)
+	    nthr = 1;
+
+	for (n0 = i = 0; i < nthr; i++) {
+	    int n = nop/nthr + (i < nop%nthr);
+
+	    s[i].vcp = vcp;
+	    s[i].np = np;
+	    s[i].ops = ops + n0;
+	    s[i].wins = wins + n0;
+	    s[i].n = n;
+	    s[i].done = 0;
+	    n0 += n;
+	}
+
+	if (nthr == 1) {
+	    winChunk (NULL, &s[0]);
+	    return;
+	}
+
+	for (i = 0; i < nthr; i++)
+	    started[i] = !pthread_create (&tid[i], NULL, winThread,
+								(void *)&s[i]);
+	for (i = 0; i < nthr; i++)
+	    if (started[i])
+		pthread_join (tid[i], NULL);
+
+	/* mop up any share a thread could not do */
+	for (i = 0; i < nthr; i++)
+	    if (!s[i].done)
+		winChunk (NULL, &s[i]);
+}
+
+/* thread to find one share of windows with a private context */
+static void *
+winThread (void *arg)
+{
+	VCShare *sp = (VCShare *)arg;
+	AstroCtx *cp = astro_ctx_new();
+
+	if (!cp)
+	    return (NULL);
+	winChunk (cp, sp);
+	astro_ctx_free (cp);
+	return (NULL);
+}
+
+/* find one share of windows using cp, or the shared context if NULL */
+static void
+winChunk (AstroCtx *cp, VCShare *sp)
+{
+	int i;
+
+	for (i = 0; i < sp->n; i++)
+	    window (cp, sp->vcp, sp->np, sp->ops[i], &sp->wins[i]);
+	sp->done = 1;
+}
+
+/* find the first and last grid times between dusk and dawn op is above
+ * minalt and the horizon, into wp->up and down; both 0 if never.
+ */
+static void
+window (AstroCtx *cp, VisCache *vcp, Now *np, Obj *op, VisWin *wp)
+{
+	VCHeader *hp = &vcp->h;
+	int nstep = (int)ceil((hp->dawn - hp->dusk)*SPD/VC_STEP);
+	int fixed = op->o_type == FIXED;
+	double ra = 0, slat = 0, clat = 0, sdec = 0, cdec = 0;
+	Now n = *np;
+	Obj o = *op;
+	int i;
+
+	wp->up = wp->down = 0;
+	n.n_epoch = EOD;
+
+	/* fixed objects do not move in a night.
+	 * N.B. threads may only use libastro through cp, so work the rest out
+	 * here.
+	 */
+	if (fixed) {
+	    n.n_mjd = (hp->dusk + hp->dawn)/2;
+	    if ((cp ? obj_cir_r (cp, &n, &o) : obj_cir (&n, &o)) < 0)
+		return;
+	    ra = o.s_ra;
+	    slat = sin (hp->sitelat);
+	    clat = cos (hp->sitelat);
+	    sdec = sin (o.s_dec);
+	    cdec = cos (o.s_dec);
+	}
+
+	for (i = 0; i <= nstep; i++) {
+	    double t = hp->dusk + i*VC_STEP/SPD;
+
+	    if (t > hp->dawn)
+		t = hp->dawn;
+	    if (fixed) {
+		double ha = vcp->lst0 + 2*PI*(t - hp->dusk)/SIDRATE - ra;
+		double salt = slat*sdec + clat*cdec*cos(ha);
+		double alt, az;
+
+		/* most steps are settled by the unrefracted altitude alone */
+		if (salt < vcp->sminalt)
+		    continue;
+		if (vcp->hznf) {
+		    az = atan2 (-cdec*sin(ha), clat*sdec - slat*cdec*cos(ha));
+		    range (&az, 2*PI);
+		    refract (hp->sitepres, hp->sitetemp, asin(salt), &alt);
+		    if (alt < (*vcp->hznf)(az))
+			continue;
+		}
+	    } else {
+		n.n_mjd = t;
+		if ((cp ? obj_cir_r (cp, &n, &o) : obj_cir (&n, &o)) < 0)
+		    continue;
+		if (o.s_alt < hp->minalt
+			    || (vcp->hznf && o.s_alt < (*vcp->hznf)(o.s_az)))
+		    continue;
+	    }
+
+	    if (wp->up == 0)
+		wp->up = t;
+	    wp->down = t;
+	}
+}
@@ -0,0 +1,24 @@
+/* a cache of when objects are up on a given night, see viscache.c */
+
+#ifndef _VISCACHE_H
+#define	_VISCACHE_H
+
+/* when one object is up */
+typedef struct {
+    RiseSet rs;		/* as riset_cir() with dis -minalt on the day asked */
+    double up, down;	/* first and last mjd in the night above minalt and
+			 * the horizon, both 0 if never
+			 */
+} VisWin;
+
+typedef struct _VisCache VisCache;
+
+extern VisCache *vc_open (char *fn, Now *np, double dusk, double dawn,
+    double minalt, double (*hznf)(double az), char *hznfn);
+extern void vc_get (VisCache *vcp, Now *np, Obj *ops[], int nop,
+    VisWin wins[], int nthr);
+extern int vc_save (VisCache *vcp);
+extern void vc_stats (VisCache *vcp, int *nhitp, int *nmissp);
+extern void vc_close (VisCache *vcp);
+
+#endif /* _VISCACHE_H */
@@ -94,6 +94,8 @@ static int call_lstsqr (double *t_ra, double *t_dc, double *t_th, double *t_sx,
 static int call_lstsqr2 (double a[], double b[]);
 static int call_lstsqr3 (double a[], double b[]);
 static int call_lstsqrDSS (double a[], double b[]);
+static int linfit (int nparam, double p[]);
+static void hiterms (int nparam, double x, double y, double f[]);
 static void setFITSWCS (FImage *fip, double ra, double dec, double rot,
     double pixszw, double pixszh);
 static void setFITSastrom (FImage *fip, double a[], double b[]);
@@ -585,9 +587,9 @@ double *rp;       /* IN: max acceptable WCS residual (pixels)
 	  ct=cos(t_th); st=sin(t_th);
 	  a[1] = ct*t_sx; a[2] = -st*t_sy; a[3] = -ct*t_sx*xc+st*t_sy*yc;
 	  b[1] = ct*t_sy; b[2] =  st*t_sx; b[3] = -ct*t_sy*yc-st*t_sx*xc;
-	  /* will use these a1,a2,a3,b1,b2,b3 as initial guess (input to
-	   * least squares routine which will evaluate them more accurately
-	   * as well as determining further parameters a4 etc.)
+	  /* these a1,a2,a3,b1,b2,b3 are just the WCS fit in DSS terms; the
+	   * higher order fits are linear in their parameters and are solved
+	   * directly by linfit(), so need no starting guess.
 	   */
 	  RADec2xieta (rc, dc, ng, gr, gd,  gx, gy);
 	}
@@ -1074,40 +1076,28 @@ double *t_sy)
 }
 
 
-/* set up the necessary temp & global arrays and call the multivariate solver.
+/* solve for the 12 parameter quadratic fit and set the residual stats.
  * return 0 if ok, else -1.
- * Version for 12 parameter quadratic fit.
- * a[1-3],b[1-3]  IN: initial guess
- * initial guess for quadratic coefficients taken as zero
+ * the model is linear in its parameters so it is solved directly by linfit();
+ * a[1-3],b[1-3] from the WCS fit are not needed as a starting guess.
  * a[1-13],b[1-13]  OUT: least squares solution, nonzero terms 1-6
- *
- * offsets for second guess taken as 1E-3 for constant terms a3,b3 since
- * expect residuals from initial guess to be closer than 1E-3 radians;
- * offsets taken as 1E-6, 1E-9 for linear, quadratic terms since x,y of order
- * 1E3
  */
 static int
 call_lstsqr2 (double a[], double b[])
 {
-	double p0[12], p1[12];
+	double p0[12];
 	int i;
 
 	/* p0[0-5] are a1-a6 in Digitized Sky Survey notation
 	 * p0[6-11] are b1-b6
 	 */
 
-	for (i = 0; i < 12; i++) {p0[i] = 0; p1[i] = 1E-9;}
-	for (i = 0; i < 3; i++) {
-	  p0[i] = a[i+1]; p0[i+6] = b[i+1]; 
-	  p1[i] = a[i+1]+1E-6; p1[i+6] = b[i+1]+1E-6;
-	}
-	p1[2] = a[3]+1E-3; p1[8] = b[3]+1E-3;
-
 #ifdef CHSQR_TRACE
 	    printf ("CHSQR_TRACE:\n");
 #endif
-	if (lstsqr (chisqr2, p0, p1, 12, FTOL) < 0)
+	if (linfit (12, p0) < 0)
 	    return (-1);
+	(void) chisqr2 (p0);
 
 	for (i = 1; i < 14; i++) {a[i] = b[i] = 0;}
 	for (i = 1; i < 7; i++) {a[i] = p0[i-1]; b[i] = p0[i+5];}
@@ -1116,36 +1106,26 @@ call_lstsqr2 (double a[], double b[])
 }
 
 
-/* set up the necessary temp & global arrays and call the multivariate solver.
+/* solve for the 20 parameter cubic fit and set the residual stats.
  * return 0 if ok, else -1.
- * Version for 20 parameter cubic fit.
- * a[1-3],b[1-3]  IN: initial guess
- * initial guess for quadratic, cubic coefficients taken as zero
  * a[1-13],b[1-13]  OUT: least squares solution, nonzero terms 1-6,8-11
  */
 static int
 call_lstsqr3 (double a[], double b[])
 {
-	double p0[20], p1[20];
+	double p0[20];
 	int i;
 
 	/* p0[0-9] are a1-a6, a8-a11 in Digitized Sky Survey notation
 	 * p0[10-19] are b1-b6, b8-b11
 	 */
 
-	for (i = 0; i < 20; i++) {p0[i] = 0; p1[i] = 1E-12;}
-	for (i = 3; i < 6; i++) {p1[i] = 1E-9; p1[i+10] = 1E-9;}
-	for (i = 0; i < 3; i++) {
-	  p0[i] = a[i+1]; p0[i+10] = b[i+1]; 
-	  p1[i] = a[i+1]+1E-6; p1[i+10] = b[i+1]+1E-6;
-	}
-	p1[2] = a[3]+1E-3; p1[12] = b[3]+1E-3;
-
 #ifdef CHSQR_TRACE
 	    printf ("CHSQR_TRACE:\n");
 #endif
-	if (lstsqr (chisqr3, p0, p1, 20, FTOL) < 0)
+	if (linfit (20, p0) < 0)
 	    return (-1);
+	(void) chisqr3 (p0);
 
 	for (i = 1; i < 14; i++) {a[i] = b[i] = 0;}
 	for (i = 1; i < 7; i++)  {a[i] = p0[i-1]; b[i] = p0[i+9];}
@@ -1155,40 +1135,29 @@ call_lstsqr3 (double a[], double b[])
 }
 
 
-/* set up the necessary temp & global arrays and call the multivariate solver.
+/* solve for the 26 parameter 5th order fit and set the residual stats.
  * return 0 if ok, else -1.
- * Version for 26 parameter 5th order fit.
  * It is the 5th order fit defined in the Digitized Sky Survey, not a general
  * 5th order fit.  In fact, only 1 term in xi and 1 term in eta is 5th order.
  *
- * a[1-3],b[1-3]  IN: initial guess
- * initial guess for quadratic, cubic, quintic coefficients taken as zero
  * a[1-13],b[1-13]  OUT: least squares solution
  */
 static int
 call_lstsqrDSS (double a[], double b[])
 {
-	double p0[26], p1[26];
+	double p0[26];
 	int i;
 
 	/* p0[0-12] are a1-a13 in Digitized Sky Survey notation
 	 * p0[13-25] are b1-b13
 	 */
 
-	for (i = 0; i < 26; i++) {p0[i] = 0; p1[i] = 1E-12;}
-	for (i = 3; i < 7; i++) {p1[i] = 1E-9; p1[i+13] = 1E-9;}
-	for (i = 0; i < 3; i++) {
-	  p0[i] = a[i+1]; p0[i+13] = b[i+1]; 
-	  p1[i] = a[i+1]+1E-6; p1[i+13] = b[i+1]+1E-6;
-	}
-	p1[2] = a[3]+1E-3; p1[15] = b[3]+1E-3;
-	p1[12] = 1E-19; p1[25] = 1E-19;
-
 #ifdef CHSQR_TRACE
 	    printf ("CHSQR_TRACE:\n");
 #endif
-	if (lstsqr (chisqrDSS, p0, p1, 26, FTOL) < 0)
+	if (linfit (26, p0) < 0)
 	    return (-1);
+	(void) chisqrDSS (p0);
 
 	for (i = 1; i < 14; i++) {a[i] = p0[i-1]; b[i] = p0[i+12];}
 
@@ -1196,6 +1165,91 @@ call_lstsqrDSS (double a[], double b[])
 }
 
 
+/* solve the nparam parameter model of chisqr2, chisqr3 or chisqrDSS for
+ * the npair_g pairs in sx_g/sy_g and gx_g/gy_g directly, by linear least
+ * squares. xi and eta are independent: xi takes p[0..nparam/2-1] on the
+ * terms of hiterms(x,y) and eta takes the rest on the same terms with x and
+ * y swapped, just as in the chisqr functions.
+ * the DSS x2y2 and x*x2y2 terms are sums of other terms so they do not
+ * change the fit; they are held at 0 and the rest solved for.
+ * return 0 if ok, else -1 if the pairs do not determine the model.
+ */
+static int
+linfit (int nparam, double p[])
+{
+	int m = nparam/2;
+	int nfree = nparam == 26 ? m-2 : m;
+	double *A, *v;
+	double f[13], x[13];
+	int ok = -1;
+	int axis, i, j, k;
+
+	if (npair_g < nfree)
+	    return (-1);
+	A = (double *) malloc (npair_g * nfree * sizeof(double));
+	v = (double *) malloc (npair_g * sizeof(double));
+	if (!A || !v)
+	    goto out;
+
+	for (axis = 0; axis < 2; axis++) {
+	    for (i = 0; i < npair_g; i++) {
+		if (axis == 0) {
+		    hiterms (nparam, sx_g[i], sy_g[i], f);
+		    v[i] = gx_g[i];
+		} else {
+		    hiterms (nparam, sy_g[i], sx_g[i], f);
+		    v[i] = gy_g[i];
+		}
+		for (j = k = 0; j < m; j++)
+		    if (nfree == m || (j != 6 && j != 11))
+			A[i*nfree + k++] = f[j];
+	    }
+	    if (linlsq (A, v, npair_g, nfree, x) < 0)
+		goto out;
+	    for (j = k = 0; j < m; j++)
+		p[axis*m + j] = (nfree == m || (j != 6 && j != 11)) ? x[k++] : 0;
+	}
+
+	ok = 0;
+
+    out:
+	if (A)
+	    free ((void *)A);
+	if (v)
+	    free ((void *)v);
+	return (ok);
+}
+
+/* fill f[] with the nparam/2 terms of xi at x,y in the order of the
+ * coefficients in chisqr2, chisqr3 or chisqrDSS.
+ */
+static void
+hiterms (int nparam, double x, double y, double f[])
+{
+	double x2y2 = x*x + y*y;
+
+	f[0] = x;
+	f[1] = y;
+	f[2] = 1;
+	f[3] = x*x;
+	f[4] = x*y;
+	f[5] = y*y;
+	if (nparam == 20) {
+	    f[6] = x*x*x;
+	    f[7] = x*x*y;
+	    f[8] = x*y*y;
+	    f[9] = y*y*y;
+	} else if (nparam == 26) {
+	    f[6] = x2y2;
+	    f[7] = x*x*x;
+	    f[8] = x*x*y;
+	    f[9] = x*y*y;
+	    f[10] = y*y*y;
+	    f[11] = x*x2y2;
+	    f[12] = x*x2y2*x2y2;
+	}
+}
+
 static int
 d_cmp (const void *p1, const void *p2)
 {
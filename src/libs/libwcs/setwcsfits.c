@@ -58,6 +58,7 @@ static void nailIt (FImage *fip, int wantusno, double sx[], double sy[],int ns,
 static int getNominal (FImage *fip, int verbose, double *rap, double *decp,
     double *fovp, double *psxp, double *psyp, char msg[]);
 static void sortStars (double *sx, double *sy, double *sb, int ns);
+static StarRec *findStarRec (StarRec *sr, int n, int x, int y);
 
 static int (*bail_fp)(void);	/* call to see if user wants to bail out */
 
@@ -83,6 +84,8 @@ int verbose, char msg[])
 {
 	int *sx=0, *sy=0;	/* malloced star coords */
 	CamPixel *sb=0;		/* malloced star brightnest pixel */
+	StarRec *sr=0;		/* malloced star list, if any */
+	int nsr;		/* n sr[], or -1 */
 	double *sxd=0, *syd=0;	/* same as sx and sy but as doubles */
 	double *sbd=0;		/* same as sb but as doubles */
 	StarDfn sd;		/* used to refine star locs */
@@ -201,13 +204,25 @@ int verbose, char msg[])
 	free ((void *)sx); sx = 0;
 	free ((void *)sy); sy = 0;
 
-	/* get better positions */
+	/* get better positions, from the star list if there is one */
 	sd.rsrch = 0;
 	sd.rAp = 0; 
 	sd.how = SSHOW_HERE;
+	nsr = getStarList (fip->image, fip->sw, fip->sh, NULL, &sr);
 	for (i = 0; i < nbs; i++) {
+	    StarRec *rp = findStarRec (sr, nsr, (int)(sxd[i]+.5),
+							    (int)(syd[i]+.5));
 	    StarStats ss;
-	    starStats ((CamPixel *)(fip->image), fip->sw, fip->sh, &sd,
+	    if (rp) {
+		ss.x = rp->x;
+		ss.y = rp->y;
+		ss.xfwhm = rp->xfwhm;
+		ss.yfwhm = rp->yfwhm;
+		ss.xmax = rp->xmax;
+		ss.ymax = rp->ymax;
+		ss.Sky = rp->Sky;
+	    } else
+		starStats ((CamPixel *)(fip->image), fip->sw, fip->sh, &sd,
 				(int)(sxd[i]+.5), (int)(syd[i]+.5), &ss, msg);
 	    sxd[i] = ss.x;
 	    syd[i] = ss.y;
@@ -229,6 +244,16 @@ int verbose, char msg[])
 	/* hunt with this set */
 	ret = spiralToFit (fip, wantusno, hunt, sxd, syd, nbs, verbose, msg);
 
+	if (verbose) {
+	    FSCacheStats cs;
+
+	    FSCacheGetStats (&cs);
+	    printf ("star cache: %ld queries, %ld tile hits, %ld misses, "
+			"%ld evictions, %ld tiles, %ld/%ld bytes\n", cs.queries,
+			cs.hits, cs.misses, cs.evictions, cs.ntiles, cs.bytes,
+			cs.maxbytes);
+	}
+
     out:
 	if (sx)  free ((void *)sx);
 	if (sy)  free ((void *)sy);
@@ -236,10 +261,25 @@ int verbose, char msg[])
 	if (sxd) free ((void *)sxd);
 	if (syd) free ((void *)syd);
 	if (sbd) free ((void *)sbd);
+	if (sr)  free ((void *)sr);
 
 	return (ret);
 }
 
+/* return the measured star in the n sr[] whose brightest pixel is at x/y,
+ * else NULL.
+ */
+static StarRec *
+findStarRec (StarRec *sr, int n, int x, int y)
+{
+	int i;
+
+	for (i = 0; i < n; i++)
+	    if (sr[i].bx == x && sr[i].by == y)
+		return ((sr[i].flags & SL_OK) ? &sr[i] : NULL);
+	return (NULL);
+}
+
 /* hunt around in a spiral out to sprad looking for a fit.
  * if find set C* in fip and return 0, else -1.
  */